@@ -11,6 +11,7 @@ enum {
 	MAP_ANON = 0x20,
 	MAP_PRIVATE = 0x2,
 	MAP_FIXED = 0x10,
+	MADV_DONTNEED = 0x4,
 	SA_RESTART = 0x10000000,
 	SA_ONSTACK = 0x8000000,
 	SA_RESTORER = 0x4000000,
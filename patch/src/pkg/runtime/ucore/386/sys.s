@@ -122,33 +122,30 @@ TEXT runtime·munmap(SB),7,$0
 	INT $3
 	RET
 
-// uint32 runtime·sem_init(uint32 value)
-TEXT runtime·sem_init(SB),7,$0
-	MOVL	$40, AX		// sys_sem_init;
+TEXT runtime·madvise(SB),7,$0
+	MOVL	$24, AX	// sys_madvise
 	MOVL	4(SP), DX
+	MOVL	8(SP), CX
+	MOVL	12(SP), BX
 	INT	$0x80
+	// ignore failure - the range may have been unmapped
 	RET
 
-// uint32 runtime·sem_post(uint32 sema)
-TEXT runtime·sem_post(SB),7,$0
-	MOVL	$41, AX		// sys_sem_post;
-	MOVL	4(SP), DX
-	INT $0X80
-	RET
-
-// uint32 runtime·sem_wait(uint32 sema, uint timeout)
-TEXT runtime·sem_wait(SB),7,$0
-	MOVL	$42, AX		// sys_sem_wait;
+// int32 futex(uint32 *addr, int32 op, uint32 val, uint32 timeout);
+TEXT runtime·futex(SB),7,$0
+	MOVL	$55, AX		// sys_futex;
 	MOVL	4(SP), DX
 	MOVL	8(SP), CX
-	INT $0X80
+	MOVL	12(SP), BX
+	MOVL	16(SP), DI
+	INT	$0x80
 	RET
 
-// uint32 runtime·sem_free(uint32 sema)
-TEXT runtime·sem_free(SB),7,$0
-	MOVL	$43, AX		// sys_sem_free;
+// void usleep(uint32 usec);
+TEXT runtime·usleep(SB),7,$0
+	MOVL	$13, AX		// sys_usleep
 	MOVL	4(SP), DX
-	INT $0X80
+	INT	$0x80
 	RET
 
 // int32 clone(int32 flags, void *stack, M *m, G *g, void (*fn)(void));
@@ -3,10 +3,7 @@
 // license that can be found in the LICENSE file.
 
 // Ucore-specific system calls
-uint32 runtime·sem_init(uint32 value);
-uint32 runtime·sem_post(uint32 sema);
-uint32 runtime·sem_wait(uint32 sema, uint32 timeout);
-uint32 runtime·sem_free(uint32 sema);
+int32	runtime·futex(uint32*, int32, uint32, uint32);
 int32	runtime·clone(int32, void*, M*, G*, void(*)(void));
 
 struct Sigaction;
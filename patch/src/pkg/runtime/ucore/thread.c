@@ -9,47 +9,122 @@
 
 extern SigTab runtime·sigtab[];
 
-// Thread-safe allocation of a semaphore.
-// Psema points at a kernel semaphore key.
-// It starts out zero, meaning no semaphore.
-// Fill it in, being careful of others calling initsema
-// simultaneously.
+// ucore futex.
+//
+//	futexsleep(uint32 *addr, uint32 val)
+//	futexwakeup(uint32 *addr)
+//
+// Futexsleep atomically checks if *addr == val and if so, sleeps on addr.
+// Futexwakeup wakes up one thread sleeping on addr.
+// Futexsleep is allowed to wake up spuriously.
+
+enum
+{
+	FUTEX_WAIT = 0,
+	FUTEX_WAKE = 1,
+};
+
+// Atomically,
+//	if(*addr == val) sleep
+// Might be woken up spuriously; that's allowed.
 static void
-initsema(uint32 *psema, uint32 value)
+futexsleep(uint32 *addr, uint32 val)
 {
-	uint32 sema;
+	// The kernel returns -E_AGAIN if *addr != val, and
+	// -E_KILLED if the sleep was interrupted; both are
+	// spurious wakeups as far as the callers care.
+	runtime·futex(addr, FUTEX_WAIT, val, 0);
+}
 
-	if(*psema != 0)	// already have one
-		return;
+// If any procs are sleeping on addr, wake up at least one.
+static void
+futexwakeup(uint32 *addr)
+{
+	int32 ret;
 
-	sema = runtime·sem_init(value);
-	
-	// [MARK-PETER] runtime.cas:
-	// if (*psema == 0) {
-	//   *psema = sema;
-	//   return true;
-	// }
-	// else return false;
-	if(!runtime·cas(psema, 0, sema)){
-		// Someone else filled it in.  Use theirs.
-		runtime·sem_free(sema);
+	ret = runtime·futex(addr, FUTEX_WAKE, 1, 0);
+
+	if(ret >= 0)
 		return;
+
+	runtime·prints("futexwakeup addr=");
+	runtime·printpointer(addr);
+	runtime·prints(" returned ");
+	runtime·printint(ret);
+	runtime·prints("\n");
+	*(int32*)0x1006 = 0x1006;
+}
+
+
+// Lock and unlock.
+//
+// The lock state is a single 32-bit word that holds
+// a 31-bit count of threads waiting for the lock
+// and a single bit (the low bit) saying whether the lock is held.
+// The uncontended case runs entirely in user space.
+// When contention is detected, we defer to the kernel (futex).
+//
+// A reminder: compare-and-swap runtime·cas(addr, old, new) does
+//	if(*addr == old) { *addr = new; return 1; }
+//	else return 0;
+// but atomically.
+
+static void
+futexlock(Lock *l)
+{
+	uint32 v;
+
+again:
+	v = l->key;
+	if((v&1) == 0){
+		if(runtime·cas(&l->key, v, v|1)){
+			// Lock wasn't held; we grabbed it.
+			return;
+		}
+		goto again;
+	}
+
+	// Lock was held; try to add ourselves to the waiter count.
+	if(!runtime·cas(&l->key, v, v+2))
+		goto again;
+
+	// We're accounted for, now sleep in the kernel.
+	//
+	// We avoid the obvious lock/unlock race because
+	// the kernel won't put us to sleep if l->key has
+	// changed underfoot and is no longer v+2.
+	futexsleep(&l->key, v+2);
+
+	// We're awake: remove ourselves from the count.
+	for(;;){
+		v = l->key;
+		if(v < 2)
+			runtime·throw("bad lock key");
+		if(runtime·cas(&l->key, v, v-2))
+			break;
 	}
+
+	// Try for the lock again.
+	goto again;
 }
 
-// Blocking locks.
+static void
+futexunlock(Lock *l)
+{
+	uint32 v;
 
-// Implement Locks, using semaphores.
-// l->key is the number of threads who want the lock.
-// In a race, one thread increments l->key from 0 to 1
-// and the others increment it from >0 to >1.  The thread
-// who does the 0->1 increment gets the lock, and the
-// others wait on the semaphore.  When the 0->1 thread
-// releases the lock by decrementing l->key, l->key will
-// be >0, so it will increment the semaphore to wake up
-// one of the others.  This is the same algorithm used
-// in Plan 9's user-level locks.
+	// Atomically get value and clear lock bit.
+again:
+	v = l->key;
+	if((v&1) == 0)
+		runtime·throw("unlock of unlocked lock");
+	if(!runtime·cas(&l->key, v, v&~1))
+		goto again;
 
+	// If there were waiters, wake one.
+	if(v & ~1)
+		futexwakeup(&l->key);
+}
 
 void
 runtime·lock(Lock *l)
@@ -57,13 +132,7 @@ runtime·lock(Lock *l)
 	if(m->locks < 0)
 		runtime·throw("lock count");
 	m->locks++;
-	
-	if(runtime·xadd(&l->key, 1) > 1) {	// someone else has it; wait
-		// Allocate semaphore if needed.
-		if(l->sema == 0)
-			initsema(&l->sema, 0);
-		runtime·sem_wait(l->sema, 0);
-	}
+	futexlock(l);
 }
 
 void
@@ -72,22 +141,45 @@ runtime·unlock(Lock *l)
 	m->locks--;
 	if(m->locks < 0)
 		runtime·throw("lock count");
-	
-	if(runtime·xadd(&l->key, -1) > 0) {	// someone else is waiting
-		// Allocate semaphore if needed.
-		if(l->sema == 0)
-			initsema(&l->sema, 0);
-		runtime·sem_post(l->sema);
-	}
+	futexunlock(l);
 }
 
 void
-runtime·destroylock(Lock *l)
+runtime·destroylock(Lock*)
 {
-	if(l->sema != 0) {
-		runtime·sem_free(l->sema);
-		l->sema = 0;
-	}
+}
+
+
+// One-time notifications.
+//
+// Since the lock/unlock implementation already
+// takes care of sleeping in the kernel, we just reuse it.
+// (But it's a weird use, so it gets its own interface.)
+//
+// We use a lock to represent the event:
+// unlocked == event has happened.
+// Thus the lock starts out locked, and to wait for the
+// event you try to lock the lock.  To signal the event,
+// you unlock the lock.
+
+void
+runtime·noteclear(Note *n)
+{
+	n->lock.key = 0;	// memset(n, 0, sizeof *n)
+	futexlock(&n->lock);
+}
+
+void
+runtime·notewakeup(Note *n)
+{
+	futexunlock(&n->lock);
+}
+
+void
+runtime·notesleep(Note *n)
+{
+	futexlock(&n->lock);
+	futexunlock(&n->lock);	// Let other sleepers find out too.
 }
 
 
@@ -162,53 +254,6 @@ runtime·minit(void)
 	runtime·signalstack(m->gsignal->stackguard - StackGuard, 32*1024);
 }
 
-// User-level semaphore implementation:
-// try to do the operations in user space on u,
-// but when it's time to block, fall back on the kernel semaphore k.
-// This is the same algorithm used in Plan 9.
-void
-runtime·usemacquire(Usema *s)
-{
-	if((int32)runtime·xadd(&s->u, -1) < 0) {
-		if(s->k == 0)
-			initsema(&s->k, 0);
-		runtime·sem_wait(s->k, 0);
-	}
-}
-
-void
-runtime·usemrelease(Usema *s)
-{
-	if((int32)runtime·xadd(&s->u, 1) <= 0) {
-		if(s->k == 0)
-			initsema(&s->k, 0);
-		runtime·sem_post(s->k);
-	}
-}
-
-
-// Event notifications.
-void
-runtime·noteclear(Note *n)
-{
-	n->wakeup = 0;
-}
-
-void
-runtime·notesleep(Note *n)
-{
-	while(!n->wakeup)
-		runtime·usemacquire(&n->sema);
-}
-
-void
-runtime·notewakeup(Note *n)
-{
-	n->wakeup = 1;
-	runtime·usemrelease(&n->sema);
-}
-
-
 void
 runtime·sigpanic(void)
 {
@@ -0,0 +1,120 @@
+// Copyright 2009 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Fork, exec, wait, etc.
+
+package syscall
+
+import (
+	"sync"
+	"unsafe"
+)
+
+// Lock synchronizing creation of new file descriptors with fork.
+// See exec_unix.go.  The ucore exec keeps only descriptors 0 and 1,
+// so nothing leaks into the child, but the lock is part of the API.
+var ForkLock sync.RWMutex
+
+// Convert array of string to array
+// of NUL-terminated byte pointer.
+func StringArrayPtr(ss []string) []*byte {
+	bb := make([]*byte, len(ss)+1)
+	for i := 0; i < len(ss); i++ {
+		bb[i] = StringBytePtr(ss[i])
+	}
+	bb[len(ss)] = nil
+	return bb
+}
+
+func CloseOnExec(fd int) { fcntl(fd, F_SETFD, FD_CLOEXEC) }
+
+func SetNonblock(fd int, nonblocking bool) (errno int) {
+	flag, err := fcntl(fd, F_GETFL, 0)
+	if err != 0 {
+		return err
+	}
+	if nonblocking {
+		flag |= O_NONBLOCK
+	} else {
+		flag &= ^O_NONBLOCK
+	}
+	_, err = fcntl(fd, F_SETFL, flag)
+	return err
+}
+
+// The kernel takes its arguments in DX, CX, BX, DI, SI;
+// Syscall6 passes a1 through a5 in BX, CX, DX, SI, DI.
+func ucoreExec(trap uintptr, name *byte, argv []*byte, envv []*byte, fds *[2]_C_int) (r uintptr, err int) {
+	argc := len(argv) - 1
+	r, _, e1 := Syscall6(trap,
+		uintptr(unsafe.Pointer(&argv[0])),
+		uintptr(argc),
+		uintptr(unsafe.Pointer(name)),
+		uintptr(unsafe.Pointer(fds)),
+		uintptr(unsafe.Pointer(&envv[0])),
+		0)
+	return r, int(e1)
+}
+
+// forkExec starts the child with SYS_UCORE_SPAWN instead of fork and
+// exec: the child runs on our address space until the new program is
+// loaded, so nothing is copied however large we are, and the kernel
+// returns the error of a failed exec directly.  Only the first two
+// entries of fd can be passed, and dir and traceme are not supported.
+func forkExec(argv0 string, argv []string, envv []string, traceme bool, dir string, fd []int) (pid int, err int) {
+	if traceme || len(dir) > 0 {
+		return 0, ENOSYS
+	}
+	if len(argv) == 0 {
+		return 0, EINVAL
+	}
+	for i := 2; i < len(fd); i++ {
+		if fd[i] >= 0 && fd[i] != i {
+			return 0, EINVAL
+		}
+	}
+
+	fds := [2]_C_int{-1, -1}
+	for i := 0; i < len(fd) && i < len(fds); i++ {
+		fds[i] = _C_int(fd[i])
+	}
+
+	// The kernel opens argv[0], argv0 is only the name of the process.
+	namep := StringBytePtr(argv[0])
+	argvp := StringArrayPtr(argv)
+	argvp[0] = StringBytePtr(argv0)
+	envvp := StringArrayPtr(envv)
+
+	ForkLock.Lock()
+	r, err := ucoreExec(SYS_UCORE_SPAWN, namep, argvp, envvp, &fds)
+	ForkLock.Unlock()
+	if err != 0 {
+		return 0, err
+	}
+	return int(r), 0
+}
+
+func ForkExec(argv0 string, argv []string, envv []string, dir string, fd []int) (pid int, err int) {
+	return forkExec(argv0, argv, envv, false, dir, fd)
+}
+
+func PtraceForkExec(argv0 string, argv []string, envv []string, dir string, fd []int) (pid int, err int) {
+	return forkExec(argv0, argv, envv, true, dir, fd)
+}
+
+func Exec(argv0 string, argv []string, envv []string) (err int) {
+	if len(argv) == 0 {
+		return EINVAL
+	}
+	namep := StringBytePtr(argv[0])
+	argvp := StringArrayPtr(argv)
+	argvp[0] = StringBytePtr(argv0)
+	_, err = ucoreExec(SYS_UCORE_EXEC, namep, argvp, StringArrayPtr(envv), nil)
+	return err
+}
+
+func StartProcess(argv0 string, argv []string, envv []string, dir string, fd []int) (pid, handle int, err int) {
+	pid, err = forkExec(argv0, argv, envv, false, dir, fd)
+	return pid, 0, err
+}
@@ -5,6 +5,8 @@ package syscall
 
 const (
 	// For ucore
+	SYS_UCORE_EXEC             = 4
+	SYS_UCORE_SPAWN            = 6
 	SYS_UCORE_SLEEP			   = 11
 	SYS_UCORE_KILL			   = 12
 	SYS_UCORE_PUTC             = 30
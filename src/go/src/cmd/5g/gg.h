@@ -87,6 +87,7 @@ void	genconv(Type*, Type*);
 void	allocparams(void);
 void	checklabels();
 void	ginscall(Node*, int);
+void	cgen_wb(Node*);
 
 /*
  * cgen
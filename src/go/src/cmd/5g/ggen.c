@@ -203,6 +203,16 @@ ginscall(Node *f, int proc)
 	}
 }
 
+/*
+ * no write barrier: the arm runtime marks
+ * with the world stopped, see ../gc/gen.c:/^needwb.
+ */
+void
+cgen_wb(Node *n)
+{
+	fatal("cgen_wb %N", n);
+}
+
 /*
  * n is call to interface method.
  * generate res = n.
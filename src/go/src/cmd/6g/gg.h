@@ -58,6 +58,8 @@ EXTERN	Node*	deferreturn;
 EXTERN	Node*	panicindex;
 EXTERN	Node*	panicslice;
 EXTERN	Node*	throwreturn;
+EXTERN	Node*	markdirty;
+EXTERN	Node*	writebarrier;
 EXTERN	vlong	unmappedzero;
 
 /*
@@ -81,6 +83,7 @@ void	genconv(Type*, Type*);
 void	allocparams(void);
 void	checklabels();
 void	ginscall(Node*, int);
+void	cgen_wb(Node*);
 int	gen_as_init(Node*);
 
 /*
@@ -68,6 +68,8 @@ EXTERN	Node*	deferreturn;
 EXTERN	Node*	panicindex;
 EXTERN	Node*	panicslice;
 EXTERN	Node*	throwreturn;
+EXTERN	Node*	markdirty;
+EXTERN	Node*	writebarrier;
 EXTERN	int	maxstksize;
 extern	uint32	unmappedzero;
 
@@ -93,6 +95,7 @@ void	genconv(Type*, Type*);
 void	allocparams(void);
 void	checklabels();
 void	ginscall(Node*, int);
+void	cgen_wb(Node*);
 
 /*
  * cgen.c
@@ -26,6 +26,10 @@ compile(Node *fn)
 		panicindex = sysfunc("panicindex");
 		panicslice = sysfunc("panicslice");
 		throwreturn = sysfunc("throwreturn");
+		markdirty = sysfunc("markdirty");
+		writebarrier = newname(pkglookup("writebarrier", runtimepkg));
+		writebarrier->class = PEXTERN;
+		writebarrier->type = types[TUINT32];
 	}
 
 	if(fn->nbody == nil)
@@ -206,6 +210,50 @@ ginscall(Node *f, int proc)
 	}
 }
 
+/*
+ * write barrier after a store into n, see ../gc/gen.c:/^cgen_aswb:
+ *	if(runtime.writebarrier)
+ *		runtime.markdirty(&n, sizeof n);
+ */
+void
+cgen_wb(Node *n)
+{
+	Node n1, nsp, con, save[2];
+	Prog *p1;
+	int i;
+
+	nodconst(&con, types[TUINT32], 0);
+	gins(ACMPL, writebarrier, &con);
+	p1 = gbranch(AJEQ, T);
+
+	// the arguments go where the results of a call may still
+	// be waiting to be assigned, as in x.p, y = f().
+	nodindreg(&nsp, types[tptr], D_SP);
+	for(i=0; i<2; i++) {
+		tempname(&save[i], types[tptr]);
+		nsp.xoffset = i*widthptr;
+		gmove(&nsp, &save[i]);
+	}
+
+	regalloc(&n1, types[tptr], N);
+	agen(n, &n1);
+	nsp.xoffset = 0;
+	gmove(&n1, &nsp);
+	regfree(&n1);
+	nsp.xoffset = widthptr;
+	nodconst(&con, types[tptr], n->type->width);
+	gins(AMOVL, &con, &nsp);
+	ginscall(markdirty, 0);
+	if(maxarg < 2*widthptr)
+		maxarg = 2*widthptr;
+	for(i=0; i<2; i++) {
+		nsp.xoffset = i*widthptr;
+		gmove(&save[i], &nsp);
+	}
+
+	patch(p1, pc);
+}
+
 /*
  * n is call to interface method.
  * generate res = n.
@@ -805,6 +805,7 @@ stotype(NodeList *l, int et, Type **t, int funarg)
 		f = typ(TFIELD);
 		f->type = n->type;
 		f->note = note;
+		f->funarg = funarg;
 		f->width = BADWIDTH;
 		f->isddd = n->isddd;
 
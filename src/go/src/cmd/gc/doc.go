@@ -40,7 +40,13 @@ Flags:
 	-I dir1 -I dir2
 		add dir1 and dir2 to the list of paths to check for imported packages
 	-N
-		disable optimization
+		disable optimization, including escape analysis and inlining
+	-l
+		disable inlining
+	-m
+		print escape analysis and inlining decisions: which variables
+		move to the heap, which allocations stay on the stack, which
+		functions can be inlined and which calls are
 	-S
 		write assembly language text to standard output
 	-u
@@ -48,6 +54,9 @@ Flags:
 	-V
 		print the compiler version
 
+A comment //go:noinline on the line before a function declaration
+keeps that function from being inlined.
+
 There are also a number of debugging flags; run the command with no arguments
 to get a usage message.
 
@@ -0,0 +1,735 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+/*
+ * escape analysis
+ *
+ * every assignment, argument, return and closure capture in the
+ * package records a flow dst <- src.  afterwards the flows into
+ * each dst are walked backwards: an address (&x, new(T), &T{})
+ * that reaches a dst outliving it escapes.  the sink stands for
+ * everything that outlives the frame: globals, stores through
+ * pointers, results, goroutines.  loop depth tells apart the
+ * variables that live one iteration from those that live longer.
+ *
+ * the walk counts dereferences: x is reached at level-1 from &x,
+ * p at level+1 from *p, and only what is reached at level <= 0
+ * is really stored in dst.
+ *
+ * variables whose address escapes are moved to the heap with
+ * addrescapes, everything else stays in the frame.  calls to
+ * functions of this package link the arguments to the parameters;
+ * parameters that do not leak get a "noescape" tag in the export
+ * data, which calls from other packages trust instead.
+ */
+
+#include	"go.h"
+
+enum
+{
+	MinLevel = -2,		// below this, dereferences no longer matter
+	MaxStackAlloc = 64*1024,	// larger new(T) and &T{} always go to the heap
+};
+
+static void	escparams(Node *func, int depth);
+static void	escbody(Node *func, int depth);
+static void	escclosure(Node *n);
+static void	esclist(NodeList *l);
+static void	esc(Node *n);
+static void	escassign(Node *dst, Node *src);
+static void	esccall(Node *n);
+static void	escarg(Type *t, Node *arg, int inslice);
+static void	escsinkcall(Node *n);
+static void	escflows(Node *dst, Node *src);
+static void	escflood(Node *dst);
+static void	escwalk(int level, Node *dst, Node *src);
+static void	escmove(Node *n);
+static void	esctag(Node *func);
+static int	escptrs(Type *t);
+static Node*	escvar(Node *n);
+
+static Node	thesink;
+static NodeList*	dsts;		// nodes with flows into them
+static NodeList*	allocs;		// new(T) and &T{}, for -m
+static int	loopdepth;
+static int	walkgen;
+static Strlit*	safetag;	// tag on parameters that do not escape
+
+void
+escapes(NodeList *all)
+{
+	NodeList *l;
+	Node *n;
+
+	thesink.op = ONAME;
+	thesink.class = PEXTERN;
+	thesink.sym = lookup(".sink");
+	thesink.escloopdepth = -1;
+	if(safetag == nil)
+		safetag = strlit("noescape");
+
+	// set up the parameters of every function first,
+	// so that calls can be linked to callees declared later.
+	for(l=all; l; l=l->next)
+		if(l->n->op == ODCLFUNC && l->n->nbody != nil)
+			escparams(l->n, 1);
+	for(l=all; l; l=l->next)
+		if(l->n->op == ODCLFUNC && l->n->nbody != nil)
+			escbody(l->n, 1);
+
+	for(l=dsts; l; l=l->next)
+		escflood(l->n);
+
+	for(l=all; l; l=l->next)
+		if(l->n->op == ODCLFUNC && l->n->nbody != nil)
+			esctag(l->n);
+
+	if(debug['m']) {
+		for(l=allocs; l; l=l->next) {
+			n = l->n;
+			if(n->esc != EscNone)
+				continue;
+			if(n->op == ONEW)
+				warnl(n->lineno, "new(%T) does not escape", n->type->type);
+			else
+				warnl(n->lineno, "&%T literal does not escape", n->left->type);
+		}
+	}
+	dsts = nil;
+	allocs = nil;
+}
+
+static void
+escparams(Node *func, int depth)
+{
+	NodeList *ll;
+	Node *n;
+
+	for(ll=func->dcl; ll; ll=ll->next) {
+		n = ll->n;
+		if(n->op != ONAME)
+			continue;
+		n->curfn = func;
+		switch(n->class) {
+		case PPARAMOUT:
+			// results flow to the caller
+			n->escloopdepth = depth;
+			escflows(&thesink, n);
+			break;
+		case PPARAM:
+			n->escloopdepth = depth;
+			if(n->type != T && escptrs(n->type))
+				n->esc = EscNone;	// until escwalk finds it leaking
+			break;
+		}
+	}
+}
+
+static void
+escbody(Node *func, int depth)
+{
+	int saveld;
+
+	saveld = loopdepth;
+	loopdepth = depth;
+	esclist(func->nbody);
+	loopdepth = saveld;
+}
+
+/*
+ * the closure value holds the addresses of the captured variables.
+ * its body runs at some later time, maybe many times, so it is
+ * one level deeper than anything around it.
+ */
+static void
+escclosure(Node *n)
+{
+	NodeList *ll;
+
+	n->esc = EscNone;
+	n->escloopdepth = loopdepth;
+	for(ll=n->enter; ll; ll=ll->next) {
+		ll->n->esc = EscNone;
+		ll->n->escloopdepth = loopdepth;
+		escflows(n, ll->n);
+	}
+	escparams(n, loopdepth+1);
+	escbody(n, loopdepth+1);
+}
+
+static void
+esclist(NodeList *l)
+{
+	for(; l; l=l->next)
+		esc(l->n);
+}
+
+static void
+esc(Node *n)
+{
+	int lno;
+	NodeList *ll, *lr;
+	Node *a;
+	Type *t;
+
+	if(n == N)
+		return;
+
+	lno = setlineno(n);
+
+	if(n->op == OCLOSURE) {
+		escclosure(n);
+		lineno = lno;
+		return;
+	}
+
+	// ninit runs once, outside the loop
+	esclist(n->ninit);
+
+	if(n->op == ORANGE) {
+		// the iteration variables are shared by all iterations
+		for(ll=n->list; ll; ll=ll->next)
+			if(ll->n->op == ONAME && ll->n->defn == n)
+				ll->n->escloopdepth = loopdepth;
+	}
+	if(n->op == OFOR || n->op == ORANGE)
+		loopdepth++;
+
+	esc(n->left);
+	esc(n->right);
+	esc(n->ntest);
+	esc(n->nincr);
+	esclist(n->nbody);
+	esclist(n->nelse);
+	esclist(n->list);
+	esclist(n->rlist);
+
+	if(n->op == OFOR || n->op == ORANGE)
+		loopdepth--;
+
+	switch(n->op) {
+	case ODCL:
+		if(n->left)
+			n->left->escloopdepth = loopdepth;
+		break;
+
+	case ONAME:
+		if(n->class == PAUTO && n->escloopdepth == 0)
+			n->escloopdepth = loopdepth;
+		break;
+
+	case OLABEL:
+		// a backward goto makes the rest of the function a loop
+		loopdepth++;
+		break;
+
+	case ORANGE:
+		// the value variable gets the elements:
+		// a copy of them for arrays, a dereference for slices.
+		if(n->list == nil || n->list->next == nil || n->right->type == T)
+			break;
+		t = n->right->type;
+		if(isfixedarray(t))
+			escassign(n->list->next->n, n->right);
+		else if(isslice(t) || isptr[t->etype]) {
+			a = nod(OIND, n->right, N);
+			escassign(n->list->next->n, a);
+		}
+		break;
+
+	case OSWITCH:
+		if(n->ntest && n->ntest->op == OTYPESW) {
+			for(ll=n->list; ll; ll=ll->next) {
+				a = ll->n->nname;
+				if(a == N)
+					continue;
+				if(a->escloopdepth == 0)
+					a->escloopdepth = loopdepth;
+				escassign(a, n->ntest->right);
+			}
+		}
+		break;
+
+	case OAS:
+		escassign(n->left, n->right);
+		break;
+
+	case OAS2:	// x, y = a, b
+	case OAS2MAPW:	// m[k] = x, ok
+		if(count(n->list) == count(n->rlist))
+			for(ll=n->list, lr=n->rlist; ll; ll=ll->next, lr=lr->next)
+				escassign(ll->n, lr->n);
+		break;
+
+	case OAS2DOTTYPE:	// v, ok = x.(type)
+		escassign(n->list->n, n->rlist->n);
+		break;
+
+	case OSEND:
+		escassign(&thesink, n->right);
+		break;
+
+	case ODEFER:
+		// deferred calls at the top level run while the frame
+		// is still there, but those in a loop outlive the iteration.
+		if(loopdepth == 1)
+			break;
+	case OPROC:
+		escsinkcall(n->left);
+		break;
+
+	case ORETURN:
+		for(ll=n->list; ll; ll=ll->next)
+			escassign(&thesink, ll->n);
+		break;
+
+	case OPANIC:
+		escassign(&thesink, n->left);
+		break;
+
+	case OAPPEND:
+		// the appended values are copied into the slice's array
+		if(n->list != nil)
+			for(ll=n->list->next; ll; ll=ll->next)
+				escassign(&thesink, ll->n);
+		break;
+
+	case OCOPY:
+		if(n->right->type != T && isslice(n->right->type) && escptrs(n->right->type->type))
+			escassign(&thesink, n->right);
+		break;
+
+	case OCALLFUNC:
+	case OCALLMETH:
+	case OCALLINTER:
+		esccall(n);
+		break;
+
+	case OSTRUCTLIT:
+	case OARRAYLIT:
+		// a slice literal's array is allocated separately
+		for(ll=n->list; ll; ll=ll->next) {
+			a = ll->n;
+			if(a->op == OKEY)
+				a = a->right;
+			if(n->op == OARRAYLIT && isslice(n->type))
+				escassign(&thesink, a);
+			else
+				escassign(n, a);
+		}
+		break;
+
+	case OMAPLIT:
+		for(ll=n->list; ll; ll=ll->next) {
+			escassign(&thesink, ll->n->left);
+			escassign(&thesink, ll->n->right);
+		}
+		break;
+
+	case OADDR:
+	case ONEW:
+		n->esc = EscNone;
+		n->escloopdepth = loopdepth;
+		if(n->op == OADDR && n->left->op != OSTRUCTLIT && n->left->op != OARRAYLIT)
+			break;
+		t = n->type->type;
+		dowidth(t);
+		if(t->width > MaxStackAlloc)
+			n->esc = EscHeap;
+		allocs = list(allocs, n);
+		break;
+	}
+
+	lineno = lno;
+}
+
+/*
+ * record that the value of src may end up in dst.
+ */
+static void
+escassign(Node *dst, Node *src)
+{
+	if(dst == N || src == N || isblank(dst) || src->op == ONONAME || src->op == OXXX)
+		return;
+
+	switch(dst->op) {
+	default:
+		// stores through pointers, into slices and maps
+		dst = &thesink;
+		break;
+
+	case ONAME:
+		dst = escvar(dst);
+		if(dst->class == PEXTERN)
+			dst = &thesink;
+		break;
+
+	case ODOT:
+		escassign(dst->left, src);
+		return;
+
+	case OINDEX:
+		if(isfixedarray(dst->left->type)) {
+			escassign(dst->left, src);
+			return;
+		}
+		dst = &thesink;
+		break;
+
+	case OSTRUCTLIT:
+	case OARRAYLIT:
+	case OCLOSURE:
+		break;
+	}
+
+	if(src->type != T && !escptrs(src->type))
+		return;
+
+	switch(src->op) {
+	case ONAME:
+		src = escvar(src);
+		if(src->class == PEXTERN || src->class == PFUNC)
+			break;
+		escflows(dst, src);
+		break;
+
+	case OADDR:
+	case ONEW:
+	case OCLOSURE:
+	case OIND:
+	case ODOTPTR:
+	case OSTRUCTLIT:
+		escflows(dst, src);
+		break;
+
+	case OARRAYLIT:
+		if(!isslice(src->type))
+			escflows(dst, src);
+		break;
+
+	case OINDEX:
+		if(isfixedarray(src->left->type))
+			escassign(dst, src->left);
+		else if(isslice(src->left->type))
+			escflows(dst, src);
+		break;
+
+	case ODOT:
+	case OCONV:
+	case OCONVNOP:
+	case OCONVIFACE:
+	case ODOTTYPE:
+	case ODOTTYPE2:
+	case OSLICE:
+	case OSLICEARR:
+		escassign(dst, src->left);
+		break;
+
+	case OAPPEND:
+		escassign(dst, src->list->n);
+		break;
+
+	case OADD:
+	case OSUB:
+	case OOR:
+	case OXOR:
+	case OAND:
+	case OANDNOT:
+		// unsafe pointer arithmetic
+		if(src->type != T && src->type->etype == TUINTPTR) {
+			escassign(dst, src->left);
+			escassign(dst, src->right);
+		}
+		break;
+	}
+}
+
+static void
+esccall(Node *n)
+{
+	NodeList *ll;
+	Type *t, *fntype;
+	Node *fn;
+
+	switch(n->op) {
+	case OCALLFUNC:
+		fn = n->left;
+		if(fn->op != ONAME || fn->class != PFUNC) {
+			// call of a func value, nothing is known about the callee
+			escsinkcall(n);
+			return;
+		}
+		fntype = fn->type;
+		break;
+	case OCALLMETH:
+		fntype = n->left->type;
+		break;
+	default:
+		escsinkcall(n);
+		return;
+	}
+	if(fntype == T)
+		return;
+
+	ll = n->list;
+	if(ll != nil && ll->next == nil && ll->n->type != T && ll->n->type->etype == TSTRUCT && ll->n->type->funarg)
+		return;	// f(g()): results hold no addresses of locals
+
+	if(n->op == OCALLMETH)
+		escarg(getthisx(fntype)->type, n->left->left, 0);
+	for(t=getinargx(fntype)->type; t && ll; t=t->down) {
+		if(t->isddd && !n->isddd) {
+			// the rest go into a new slice
+			for(; ll; ll=ll->next)
+				escarg(t, ll->n, 1);
+			break;
+		}
+		escarg(t, ll->n, 0);
+		ll = ll->next;
+	}
+}
+
+static void
+escarg(Type *t, Node *arg, int inslice)
+{
+	Node *a;
+
+	if(t == T || arg == N)
+		return;
+	if(t->nname != N && t->nname->esc != EscUnknown && !inslice) {
+		// callee analyzed along with this package.
+		// the arguments outlive the call, so they are kept
+		// apart from the flows inside the callee; see escwalk.
+		a = nod(ONAME, N, N);
+		a->sym = lookup(".arg");
+		a->escloopdepth = loopdepth;
+		escassign(a, arg);
+		t->nname->escargsrc = list(t->nname->escargsrc, a);
+		return;
+	}
+	if(t->note != nil && t->note->len == safetag->len &&
+	   memcmp(t->note->s, safetag->s, safetag->len) == 0)
+		return;
+	escassign(&thesink, arg);
+}
+
+/*
+ * the callee may keep everything it gets.
+ */
+static void
+escsinkcall(Node *n)
+{
+	NodeList *ll;
+
+	switch(n->op) {
+	case OCALLFUNC:
+		escassign(&thesink, n->left);
+		break;
+	case OCALLMETH:
+	case OCALLINTER:
+		escassign(&thesink, n->left->left);
+		break;
+	}
+	for(ll=n->list; ll; ll=ll->next)
+		escassign(&thesink, ll->n);
+}
+
+static void
+escflows(Node *dst, Node *src)
+{
+	if(dst == N || src == N || dst == src)
+		return;
+	if(dst->escflowsrc == nil)
+		dsts = list(dsts, dst);
+	dst->escflowsrc = list(dst->escflowsrc, src);
+}
+
+static void
+escflood(Node *dst)
+{
+	NodeList *l;
+
+	walkgen++;
+	for(l=dst->escflowsrc; l; l=l->next)
+		escwalk(0, dst, l->n);
+}
+
+static void
+escwalk(int level, Node *dst, Node *src)
+{
+	NodeList *ll;
+	int leaks;
+
+	if(src->op == ONAME)
+		src = escvar(src);
+	if(src->walkgen == walkgen && src->esclevel <= level)
+		return;
+	src->walkgen = walkgen;
+	src->esclevel = level;
+
+	leaks = level <= 0 && dst->escloopdepth < src->escloopdepth;
+
+	switch(src->op) {
+	case ONAME:
+		if(src->class != PPARAM)
+			break;
+		if(leaks && src->esc == EscNone) {
+			src->esc = EscScope;
+			if(debug['m'])
+				warnl(src->lineno, "leaking param: %S", src->sym);
+		}
+		// the arguments outlive the callee's frame:
+		// they only matter once the parameter reaches the sink.
+		if(dst == &thesink)
+			for(ll=src->escargsrc; ll; ll=ll->next)
+				escwalk(level, dst, ll->n);
+		break;
+
+	case OADDR:
+		if(leaks) {
+			src->esc = EscHeap;
+			escmove(src->left);
+		}
+		escwalk(level > MinLevel ? level-1 : level, dst, src->left);
+		break;
+
+	case ONEW:
+	case OCLOSURE:
+		if(leaks)
+			src->esc = EscHeap;
+		break;
+
+	case OIND:
+	case ODOTPTR:
+		escwalk(level > MinLevel ? level+1 : level, dst, src->left);
+		break;
+
+	case OINDEX:
+		if(isfixedarray(src->left->type))
+			escwalk(level, dst, src->left);
+		else if(level > MinLevel)
+			escwalk(level+1, dst, src->left);
+		else
+			escwalk(level, dst, src->left);
+		break;
+
+	case ODOT:
+	case OCONV:
+	case OCONVNOP:
+	case OCONVIFACE:
+	case ODOTTYPE:
+	case ODOTTYPE2:
+	case OSLICE:
+	case OSLICEARR:
+		escwalk(level, dst, src->left);
+		break;
+	}
+
+	for(ll=src->escflowsrc; ll; ll=ll->next)
+		escwalk(level, dst, ll->n);
+}
+
+/*
+ * the address of n escapes: move the variable holding it to the heap.
+ */
+static void
+escmove(Node *n)
+{
+	Node *savefn;
+
+	while(n->op == ODOT || (n->op == OINDEX && isfixedarray(n->left->type)))
+		n = n->left;
+	if(n->op != ONAME)
+		return;
+	n = escvar(n);
+	switch(n->class) {
+	case PAUTO:
+	case PPARAM:
+	case PPARAMOUT:
+		break;
+	default:
+		return;
+	}
+	if(n->noescape)
+		return;
+	if(n->curfn == N)
+		fatal("escmove: no function for %S", n->sym);
+
+	savefn = curfn;
+	curfn = n->curfn;
+	addrescapes(n);
+	curfn = savefn;
+	if(debug['m'])
+		warnl(n->lineno, "moved to heap: %S", n->sym);
+}
+
+/*
+ * tag the parameters that did not leak,
+ * for calls from other packages.
+ */
+static void
+esctag(Node *func)
+{
+	Type *t;
+
+	if(func->type == T)
+		return;
+	for(t=getthisx(func->type)->type; t; t=t->down)
+		if(t->nname != N && t->nname->esc == EscNone)
+			t->note = safetag;
+	for(t=getinargx(func->type)->type; t; t=t->down)
+		if(t->nname != N && t->nname->esc == EscNone)
+			t->note = safetag;
+}
+
+/*
+ * can a value of type t hold an address?
+ * unlike haspointers, uintptr counts: unsafe code keeps addresses there.
+ */
+static int
+escptrs(Type *t)
+{
+	Type *t1;
+
+	switch(t->etype) {
+	case TINT:
+	case TUINT:
+	case TINT8:
+	case TUINT8:
+	case TINT16:
+	case TUINT16:
+	case TINT32:
+	case TUINT32:
+	case TINT64:
+	case TUINT64:
+	case TFLOAT32:
+	case TFLOAT64:
+	case TCOMPLEX64:
+	case TCOMPLEX128:
+	case TBOOL:
+		return 0;
+	case TARRAY:
+		if(t->bound < 0)	// slice
+			return 1;
+		return escptrs(t->type);
+	case TSTRUCT:
+		for(t1=t->type; t1!=T; t1=t1->down)
+			if(escptrs(t1->type))
+				return 1;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * inside a closure a captured variable is a PPARAMREF
+ * standing for the variable of the enclosing function.
+ */
+static Node*
+escvar(Node *n)
+{
+	while(n->op == ONAME && n->class == PPARAMREF && n->closure != N)
+		n = n->closure;
+	return n;
+}
@@ -150,11 +150,28 @@ dumpexportconst(Sym *s)
 	}
 }
 
+/*
+ * the body of t to inline, for the export data,
+ * after the functions it calls from other packages.
+ */
+static Strlit*
+dumpinl(Type *t)
+{
+	NodeList *l, *deps;
+	Strlit *s;
+
+	s = inlexport(t, &deps);
+	for(l=deps; l; l=l->next)
+		dumpsym(l->n->sym);
+	return s;
+}
+
 static void
 dumpexportvar(Sym *s)
 {
 	Node *n;
 	Type *t;
+	Strlit *inl;
 
 	n = s->def;
 	typecheck(&n, Erv);
@@ -166,10 +183,19 @@ dumpexportvar(Sym *s)
 	t = n->type;
 	dumpprereq(t);
 
+	// only bodies made here, not ones read from imports
+	inl = nil;
+	if(t->etype == TFUNC && n->class == PFUNC && s->pkg == localpkg)
+		inl = dumpinl(t);
+
 	Bprint(bout, "\t");
-	if(t->etype == TFUNC && n->class == PFUNC)
+	if(t->etype == TFUNC && n->class == PFUNC) {
 		Bprint(bout, "func %#S %#hhT", s, t);
-	else
+		if(inl != nil)
+			Bprint(bout, " { \"%Z\" }", inl);
+		else if(t->stackwalk)
+			Bprint(bout, " {}");
+	} else
 		Bprint(bout, "var %#S %#T", s, t);
 	Bprint(bout, "\n");
 }
@@ -206,6 +232,7 @@ dumpsym(Sym *s)
 {
 	Type *f, *t;
 	Type **m;
+	Strlit **inl;
 	int i, n;
 
 	if(s->flags & SymExported)
@@ -234,16 +261,29 @@ dumpsym(Sym *s)
 			n++;
 		}
 		m = mal(n*sizeof m[0]);
+		inl = mal(n*sizeof inl[0]);
 		i = 0;
 		for(f=t->method; f!=T; f=f->down)
 			m[i++] = f;
 		qsort(m, n, sizeof m[0], methcmp);
 
+		// the functions the bodies call go before the type:
+		// an unexported method name takes the package of
+		// the last qualified name the importer read.
+		if(s->pkg == localpkg)
+			for(i=0; i<n; i++)
+				inl[i] = dumpinl(m[i]->type);
+
 		dumpexporttype(s);
 		for(i=0; i<n; i++) {
 			f = m[i];
-			Bprint(bout, "\tfunc (%#T) %hS %#hhT\n",
+			Bprint(bout, "\tfunc (%#T) %hS %#hhT",
 				f->type->type->type, f->sym, f->type);
+			if(inl[i] != nil)
+				Bprint(bout, " { \"%Z\" }", inl[i]);
+			else if(f->type->stackwalk)
+				Bprint(bout, " {}");
+			Bprint(bout, "\n");
 		}
 		break;
 	case ONAME:
@@ -11,6 +11,8 @@
 
 static void	cgen_dcl(Node *n);
 static void	cgen_proc(Node *n, int proc);
+static int	needwb(Node *nl, Node *nr);
+static void	cgen_aswb(Node *nl, Node *nr);
 
 Node*
 sysfunc(char *name)
@@ -309,6 +311,10 @@ gen(Node *n)
 	case OAS:
 		if(gen_as_init(n))
 			break;
+		if(needwb(n->left, n->right)) {
+			cgen_aswb(n->left, n->right);
+			break;
+		}
 		cgen_as(n->left, n->right);
 		break;
 
@@ -583,6 +589,135 @@ ret:
 	;
 }
 
+/*
+ * write barrier.
+ * while the runtime marks concurrently with the program
+ * (see ../../pkg/runtime/mgc0.c) it must hear of every
+ * pointer stored into the heap: after such a store
+ * cgen_wb tests runtime.writebarrier and, if it is set,
+ * calls runtime.markdirty with the address and width.
+ */
+
+/*
+ * may n be in the heap?
+ */
+static int
+wbheap(Node *n)
+{
+	switch(n->op) {
+	case ONAME:
+		return (n->class & PHEAP) || n->class == PPARAMREF;
+	case OIND:
+	case ODOTPTR:
+		return 1;
+	case OINDEX:
+		if(isslice(n->left->type))
+			return 1;
+		return wbheap(n->left);
+	case ODOT:
+		return wbheap(n->left);
+	}
+	return 0;
+}
+
+/*
+ * is the value of n computed without loading from the heap?
+ */
+static int
+wbvalsafe(Node *n)
+{
+	switch(n->op) {
+	case OLITERAL:
+		return 1;
+	case ONAME:
+		return !(n->class & PHEAP) && n->class != PPARAMREF;
+	case ODOT:
+	case OCONV:
+	case OCONVNOP:
+	case OMINUS:
+		return wbvalsafe(n->left);
+	case OADD:
+	case OSUB:
+	case OMUL:
+	case OLSH:
+		return wbvalsafe(n->left) && wbvalsafe(n->right);
+	}
+	return 0;
+}
+
+/*
+ * is the address of n computed without loading from the heap,
+ * so that it is the same after a store into the heap?
+ */
+static int
+wbaddrsafe(Node *n)
+{
+	switch(n->op) {
+	case ONAME:
+		return 1;	// heap names are at heapaddr, on the stack
+	case ODOT:
+		return wbaddrsafe(n->left);
+	case OINDEX:
+		if(isslice(n->left->type))
+			return wbvalsafe(n->left) && wbvalsafe(n->right);
+		return wbaddrsafe(n->left) && wbvalsafe(n->right);
+	case OIND:
+	case ODOTPTR:
+		return wbvalsafe(n->left);
+	}
+	return 0;
+}
+
+/*
+ * does nl = nr need the write barrier?
+ * zeroing and constants store no pointer to the heap.
+ */
+static int
+needwb(Node *nl, Node *nr)
+{
+	if(thechar == '5')
+		return 0;	// arm marks with the world stopped
+	if(nr == N || isnil(nr) || nr->op == OLITERAL)
+		return 0;
+	if(nl->type == T || !haspointers(nl->type))
+		return 0;
+	return wbheap(nl);
+}
+
+/*
+ * generate nl = nr with the write barrier.
+ */
+static void
+cgen_aswb(Node *nl, Node *nr)
+{
+	Node tmp, a, *n;
+
+	if(wbaddrsafe(nl)) {
+		cgen_as(nl, nr);
+		cgen_wb(nl);
+		return;
+	}
+
+	// the store may change what the address of nl is
+	// computed from: take it first, after any call in nr.
+	if(nr->ullman >= UINF) {
+		tempname(&tmp, nr->type);
+		cgen_as(&tmp, nr);
+		nr = &tmp;
+	}
+	tempname(&a, types[tptr]);
+	n = nod(OADDR, nl, N);
+	n->type = types[tptr];
+	ullmancalc(n);
+	cgen(n, &a);
+
+	n = nod(OIND, &a, N);
+	n->type = nl->type;
+	ullmancalc(n);
+	cgen_as(n, nr);
+	cgen_wb(n);
+}
+
 /*
  * gather series of offsets
  * >=0 is direct addressed field
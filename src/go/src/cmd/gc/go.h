@@ -70,19 +70,16 @@ struct	Strlit
 typedef	struct	Hiter	Hiter;
 struct	Hiter
 {
-	uchar	data[8];		// return val from next
-	int32	elemsize;		// size of elements in table */
-	int32	changes;		// number of changes observed last time */
-	int32	i;			// stack pointer in subtable_state */
-	uchar	last[8];		// last hash value returned */
-	uchar	h[8];			// the hash table */
-	struct
-	{
-		uchar	sub[8];		// pointer into subtable */
-		uchar	start[8];	// pointer into start of subtable */
-		uchar	end[8];		// pointer into end of subtable */
-		uchar	pad[8];
-	} sub[4];
+	uchar	key[8];			// current key, nil at the end - must be first
+	uchar	value[8];		// current value
+	uchar	h[8];			// the hash table
+	uchar	buckets[8];		// bucket array at initialization
+	uchar	bptr[8];		// current bucket
+	uchar	bucket[8];		// next bucket index to visit
+	uchar	check_bucket[8];	// see hash_next
+	int32	i;			// next slot in bptr
+	uchar	B;			// log2 of the number of buckets at initialization
+	uchar	pad[3];
 };
 
 enum
@@ -165,6 +162,10 @@ struct	Type
 	uchar	outtuple;
 	uchar	intuple;
 	uchar	outnamed;
+	NodeList*	inl;		// body to inline, see inl.c
+	NodeList*	inldcl;		// local variables of inl
+	int32	inlcost;	// nodes in inl, against the budget
+	uchar	stackwalk;	// reaches runtime.Caller, see inl.c
 
 	Type*	method;
 	Type*	xmethod;
@@ -216,6 +217,8 @@ struct	Node
 	uchar	pun;		// don't registerize variable ONAME
 	uchar	readonly;
 	uchar	implicit;	// don't show in printout
+	uchar	esc;		// EscXXX, see esc.c
+	uchar	noinline;	// ODCLFUNC marked //go:noinline
 
 	// most nodes
 	Node*	left;
@@ -265,6 +268,17 @@ struct	Node
 	// OPACK
 	Pkg*	pkg;
 
+	// escape analysis, see esc.c
+	Node*	curfn;		// function for local variables
+	NodeList*	escflowsrc;	// flow(this, src)
+	NodeList*	escargsrc;	// call arguments passed to this param
+	int32	escloopdepth;	// -1: global, 0: not set, function top level: 1, +1 per loop
+	int32	esclevel;	// level of the last escwalk visit
+	int32	walkgen;
+
+	// inlining, see inl.c
+	Node*	inlvar;		// substitute for this ONAME in an inlined body
+
 	Sym*	sym;		// various
 	int32	vargen;		// unique name for OTYPE/ONAME
 	int32	lineno;
@@ -509,6 +523,14 @@ enum
 	PHEAP = 1<<7,
 };
 
+enum
+{
+	EscUnknown,
+	EscHeap,	// address or allocation leaks, goes to the heap
+	EscScope,	// param leaks out of the function
+	EscNone,	// does not escape, may stay on the stack
+};
+
 enum
 {
 	Etop = 1<<1,	// evaluated at statement level
@@ -767,6 +789,8 @@ EXTERN	int	noargnames;
 
 EXTERN	int	funcdepth;
 EXTERN	int	typecheckok;
+EXTERN	int	escdefer;	// leave addrescapes to escapes, see esc.c
+EXTERN	int	noinline;	// //go:noinline seen, for the next func
 EXTERN	int	packagequotes;
 EXTERN	int	longsymnames;
 EXTERN	int	compiling_runtime;
@@ -879,6 +903,11 @@ void	typedcl2(Type *pt, Type *t);
 Node*	typenod(Type *t);
 NodeList*	variter(NodeList *vl, Node *t, NodeList *el);
 
+/*
+ *	esc.c
+ */
+void	escapes(NodeList *all);
+
 /*
  *	export.c
  */
@@ -912,6 +941,15 @@ void	tempname(Node *n, Type *t);
 void	fninit(NodeList *n);
 Node*	renameinit(Node *n);
 
+/*
+ *	inl.c
+ */
+void	caninl(Node *fn);
+Strlit*	inlexport(Type *t, NodeList **deps);
+void	inlcalls(Node *fn);
+void	inlimport(Type *t, Strlit *body);
+void	inlstackwalk(NodeList *all);
+
 /*
  *	lex.c
  */
@@ -1013,6 +1051,7 @@ void	walkrange(Node *n);
  *	reflect.c
  */
 void	dumptypestructs(void);
+int	haspointers(Type *t);
 Type*	methodfunc(Type *f, Type*);
 Node*	typename(Type *t);
 Sym*	typesym(Type *t);
@@ -1134,6 +1173,7 @@ uint32	typehash(Type *t);
 void	ullmancalc(Node *n);
 void	umagic(Magic *m);
 void	warn(char *fmt, ...);
+void	warnl(int line, char *fmt, ...);
 void	yyerror(char *fmt, ...);
 void	yyerrorl(int line, char *fmt, ...);
 
@@ -1146,6 +1186,7 @@ void	walkswitch(Node *sw);
 /*
  *	typecheck.c
  */
+void	addrescapes(Node *n);
 int	exportassignok(Type *t, char *desc);
 int	islvalue(Node *n);
 Node*	typecheck(Node **np, int top);
@@ -1205,6 +1246,7 @@ void	cgen_asop(Node *n);
 void	cgen_call(Node *n, int proc);
 void	cgen_callinter(Node *n, Node *res, int proc);
 void	cgen_ret(Node *n);
+void	cgen_wb(Node *n);
 void	clearfat(Node *n);
 void	compile(Node*);
 int	dgostringptr(Sym*, int off, char *str);
@@ -76,7 +76,7 @@ static void fixlbrace(int);
 %type	<node>	indcl interfacetype structtype ptrtype
 %type	<node>	recvchantype non_recvchantype othertype fnret_type fntype
 
-%type	<val>	hidden_tag
+%type	<val>	hidden_tag ohidden_inl
 
 %type	<sym>	hidden_importsym hidden_pkg_importsym
 
@@ -1135,6 +1135,8 @@ xfndcl:
 			break;
 		$$->nbody = $3;
 		$$->endlineno = lineno;
+		$$->noinline = noinline;
+		noinline = 0;
 		funcbody($$);
 	}
 
@@ -1678,17 +1680,45 @@ hidden_import:
 	{
 		importtype($2, $3);
 	}
-|	LFUNC hidden_pkg_importsym '(' ohidden_funarg_list ')' ohidden_funres ';'
+|	LFUNC hidden_pkg_importsym '(' ohidden_funarg_list ')' ohidden_funres ohidden_inl ';'
 	{
-		importvar($2, functype(N, $4, $6), PFUNC);
+		Type *t;
+
+		t = functype(N, $4, $6);
+		if($7.ctype == CTSTR)
+			inlimport(t, $7.u.sval);
+		else if($7.ctype == CTBOOL)
+			t->stackwalk = 1;
+		importvar($2, t, PFUNC);
 	}
-|	LFUNC '(' hidden_funarg_list ')' sym '(' ohidden_funarg_list ')' ohidden_funres ';'
+|	LFUNC '(' hidden_funarg_list ')' sym '(' ohidden_funarg_list ')' ohidden_funres ohidden_inl ';'
 	{
+		Type *t;
+
 		if($3->next != nil || $3->n->op != ODCLFIELD) {
 			yyerror("bad receiver in method");
 			YYERROR;
 		}
-		importmethod($5, functype($3->n, $7, $9));
+		t = functype($3->n, $7, $9);
+		if($10.ctype == CTSTR)
+			inlimport(t, $10.u.sval);
+		else if($10.ctype == CTBOOL)
+			t->stackwalk = 1;
+		importmethod($5, t);
+	}
+
+ohidden_inl:
+	{
+		$$.ctype = CTxxx;
+	}
+|	'{' LLITERAL '}'	// body to inline, see inl.c
+	{
+		$$ = $2;
+	}
+|	'{' '}'	// not to be inlined, nor its callers
+	{
+		$$.ctype = CTBOOL;
+		$$.u.bval = 1;
 	}
 
 hidden_pkgtype:
@@ -1790,9 +1820,10 @@ hidden_opt_sym:
 	}
 
 hidden_dcl:
-	hidden_opt_sym hidden_type
+	hidden_opt_sym hidden_type hidden_tag
 	{
 		$$ = nod(ODCLFIELD, $1, typenod($2));
+		$$->val = $3;
 	}
 |	hidden_opt_sym LDDD
 	{
@@ -1807,7 +1838,7 @@ hidden_dcl:
 		$$->isddd = 1;
 	}
 
-|	hidden_opt_sym LDDD hidden_type
+|	hidden_opt_sym LDDD hidden_type hidden_tag
 	{
 		Type *t;
 		
@@ -1816,6 +1847,7 @@ hidden_dcl:
 		t->type = $3;
 		$$ = nod(ODCLFIELD, $1, typenod(t));
 		$$->isddd = 1;
+		$$->val = $4;
 	}
 
 hidden_structdcl:
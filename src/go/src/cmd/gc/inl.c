@@ -0,0 +1,1396 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+/*
+ * function inlining
+ *
+ * caninl decides whether a function is small and simple enough
+ * to be copied into its callers: no loops, closures, labels or
+ * &x of a local, calls only to functions known statically, and
+ * a single return as the last statement.  its parameters,
+ * locals and the arguments of its calls must fit in MaxFrame
+ * bytes, since they become part of the caller's frame.  a call
+ * counts against
+ * the budget as the body of its callee if that can be inlined,
+ * else as CallCost nodes.  it saves a copy of the typechecked
+ * body in the function type.
+ *
+ * inlcalls replaces the calls in a function by copies of the
+ * saved bodies, and the calls in those copies in turn, MaxDepth
+ * deep.  a call used as a value is replaced by the returned
+ * expression if that is the whole body and makes no calls; the
+ * arguments take the place of the parameters, so they must have
+ * no side effects.  a call used as a statement, or whose result
+ * is assigned or returned, becomes a block: the arguments are
+ * assigned to fresh variables, followed by the body.
+ *
+ * bodies of simple statements and expressions are also written
+ * to the export data, see inlexport, so that other packages can
+ * inline them.  parameters are numbered, $0 being the receiver
+ * of a method, and so are locals, which have predeclared types:
+ *
+ *	func (b *Buffer) Len() int { "(RETURN (SUB (LEN (DOT $0 buf@)) (DOT $0 off@)))" }
+ *	func (m *Mutex) Unlock() { "(DCL %0 int32) (AS %0 (CALL AddInt32@sync/atomic ...)) (IF ...)" }
+ *
+ * unexported field and method names carry the path of their
+ * package, empty for the package being imported; called
+ * functions always do.
+ *
+ * runtime.Caller and Callers count frames, so a function that
+ * reaches them, itself or through the functions it calls, keeps
+ * its frame: inlstackwalk marks it, and the export data says so.
+ *
+ *	func "runtime/debug".Stack() []byte {}
+ */
+
+#include	"go.h"
+
+enum
+{
+	MaxBudget = 40,		// nodes in an inlinable body
+	CallCost = 8,		// nodes a call to a function not inlined counts as
+	MaxDepth = 3,		// inlined bodies inlined into one another
+	MaxFrame = 256,		// bytes of parameters, results and locals
+};
+
+static vlong	inlwidth(Type *f);
+static int	ishairy(Node *n, int *budget);
+static int	ishairylist(NodeList *l, int *budget);
+static int	inladdr(Node *n);
+static int	ispure(Node *n);
+static int	inluses(Node *n, Node *v);
+static int	inlhascall(Node *n);
+static int	inlwalks(Node *n);
+static int	inlwalkslist(NodeList *l);
+static Type*	inlparam(Type *t, int i);
+static Type*	inlcallee(Node *n);
+static void	inltypecheck(Type *t);
+static Node*	inlvar(Node *var);
+static Node*	inlsubst(Node *n);
+static NodeList*	inlsubstlist(NodeList *l);
+static void	inlnode(Node **np, int top);
+static void	inlnodelist(NodeList *l, int top);
+static void	inlexpr(Node **np);
+static NodeList*	inlbody(Node *n, Node **rv);
+static int	inlsimple(Node *n);
+static int	enc(Fmt *fp, Node *n, Type *t);
+static int	enclist(Fmt *fp, NodeList *l, Type *t);
+static Node*	dec(Type *t);
+
+static int32	inlline;	// line of the call being inlined
+static Type*	inlfntype;	// type of the function caninl is looking at
+static vlong	inlframe;	// bytes of the arguments of its calls
+static int	inldepth;	// inlined bodies being inlined into
+
+static struct
+{
+	int	op;
+	char*	name;
+} inlops[] =
+{
+	OADD,		"ADD",
+	OSUB,		"SUB",
+	OMUL,		"MUL",
+	ODIV,		"DIV",
+	OMOD,		"MOD",
+	OAND,		"AND",
+	OOR,		"OR",
+	OXOR,		"XOR",
+	OLSH,		"LSH",
+	ORSH,		"RSH",
+	OANDNOT,	"ANDNOT",
+	OEQ,		"EQ",
+	ONE,		"NE",
+	OLT,		"LT",
+	OLE,		"LE",
+	OGT,		"GT",
+	OGE,		"GE",
+	OANDAND,	"ANDAND",
+	OOROR,		"OROR",
+	ONOT,		"NOT",
+	OMINUS,		"MINUS",
+	OPLUS,		"PLUS",
+	OCOM,		"COM",
+	OLEN,		"LEN",
+	OCAP,		"CAP",
+	OIND,		"IND",
+	OINDEX,		"INDEX",
+	OADDR,		"ADDR",
+};
+
+/*
+ * decide whether fn can be inlined,
+ * and if so save a copy of its body.
+ */
+void
+caninl(Node *fn)
+{
+	Type *t, *f;
+	NodeList *l;
+	Node *last;
+	int budget;
+	vlong w;
+
+	if(fn->op != ODCLFUNC)
+		fatal("caninl %N", fn);
+	t = fn->type;
+	if(t == T || fn->nbody == nil || fn->noinline || fn->nname == N)
+		return;
+	if(t->stackwalk)
+		return;
+	if(t->outtuple > 1)
+		return;
+	for(f=getinargx(t)->type; f; f=f->down)
+		if(f->isddd)
+			return;
+
+	last = fn->nbody->end->n;
+	if(t->outtuple > 0 && last->op != ORETURN)
+		return;
+
+	w = inlwidth(getthisx(t)->type) + inlwidth(getinargx(t)->type) + inlwidth(getoutargx(t)->type);
+	for(l=fn->dcl; l; l=l->next)
+		if(l->n->op == ONAME && l->n->class == PAUTO && l->n->type != T) {
+			dowidth(l->n->type);
+			w += l->n->type->width;
+		}
+
+	budget = MaxBudget;
+	inlfntype = t;
+	inlframe = 0;
+	for(l=fn->nbody; l; l=l->next) {
+		if(l->n == last && last->op == ORETURN) {
+			if(last->ninit != nil || ishairylist(last->list, &budget))
+				return;
+			continue;
+		}
+		if(ishairy(l->n, &budget))
+			return;
+	}
+
+	if(w + inlframe > MaxFrame)
+		return;
+
+	inlline = 0;
+	t->inl = inlsubstlist(fn->nbody);
+	t->inlcost = MaxBudget - budget;
+	last = t->inl->end->n;
+	if(last->op == ORETURN && last->list != nil)
+		last->list->n = assignconv(last->list->n, getoutargx(t)->type->type, "return");
+	t->inldcl = nil;
+	for(l=fn->dcl; l; l=l->next)
+		if(l->n->op == ONAME && (l->n->class == PAUTO || l->n->class == PPARAMOUT))
+			t->inldcl = list(t->inldcl, l->n);
+
+	if(debug['m'])
+		warnl(fn->lineno, "can inline %S", fn->nname->sym);
+}
+
+/*
+ * mark the functions in all that reach runtime.Caller or Callers.
+ */
+void
+inlstackwalk(NodeList *all)
+{
+	NodeList *l;
+	Node *fn;
+	int again;
+
+	do {
+		again = 0;
+		for(l=all; l; l=l->next) {
+			fn = l->n;
+			if(fn->op != ODCLFUNC || fn->type == T || fn->type->stackwalk)
+				continue;
+			if(inlwalkslist(fn->nbody)) {
+				fn->type->stackwalk = 1;
+				again = 1;
+			}
+		}
+	} while(again);
+}
+
+static int
+inlwalkslist(NodeList *l)
+{
+	for(; l; l=l->next)
+		if(inlwalks(l->n))
+			return 1;
+	return 0;
+}
+
+/*
+ * does n call runtime.Caller or Callers,
+ * or a function that reaches them?
+ */
+static int
+inlwalks(Node *n)
+{
+	Sym *s;
+
+	if(n == N)
+		return 0;
+	if(n->op == OCALLFUNC || n->op == OCALLMETH) {
+		if(n->left->type != T && n->left->type->stackwalk)
+			return 1;
+		s = n->left->sym;
+		if(n->left->op == ONAME && s != S && s->pkg == runtimepkg &&
+		   (strcmp(s->name, "Caller") == 0 || strcmp(s->name, "Callers") == 0))
+			return 1;
+	}
+	return inlwalks(n->left) ||
+		inlwalks(n->right) ||
+		inlwalkslist(n->list) ||
+		inlwalkslist(n->rlist) ||
+		inlwalkslist(n->ninit) ||
+		inlwalks(n->ntest) ||
+		inlwalks(n->nincr) ||
+		inlwalkslist(n->nbody) ||
+		inlwalkslist(n->nelse);
+}
+
+/*
+ * bytes in the list of fields f.
+ */
+static vlong
+inlwidth(Type *f)
+{
+	vlong w;
+
+	w = 0;
+	for(; f; f=f->down) {
+		dowidth(f->type);
+		w += f->type->width;
+	}
+	return w;
+}
+
+static int
+ishairylist(NodeList *l, int *budget)
+{
+	for(; l; l=l->next)
+		if(ishairy(l->n, budget))
+			return 1;
+	return 0;
+}
+
+static int
+ishairy(Node *n, int *budget)
+{
+	Type *t;
+
+	if(n == N)
+		return 0;
+
+	switch(n->op) {
+	case OCALLFUNC:
+		if(n->left->op != ONAME || n->left->class != PFUNC)
+			return 1;
+	case OCALLMETH:
+		t = n->left->type;
+		if(t == T || t == inlfntype)
+			return 1;
+		if(t->inl != nil)
+			*budget -= t->inlcost;
+		else
+			*budget -= CallCost;
+		inlframe += inlwidth(getthisx(t)->type) + inlwidth(getinargx(t)->type) + inlwidth(getoutargx(t)->type);
+		break;
+
+	case OADDR:
+		if(!inladdr(n->left))
+			return 1;
+		break;
+
+	case OCALL:
+	case OCALLINTER:
+	case OCLOSURE:
+	case OPANIC:
+	case ORECOVER:
+	case OPROC:
+	case ODEFER:
+	case OSELECT:
+	case OSWITCH:
+	case OFOR:
+	case ORANGE:
+	case OGOTO:
+	case OLABEL:
+	case OBREAK:
+	case OCONTINUE:
+	case OFALL:
+	case OXFALL:
+	case ORETURN:	// only as the last statement, see caninl
+	case ODCLTYPE:
+	case ODCLCONST:
+	case ODCLFUNC:
+	case ONEW:
+	case OAS2FUNC:
+	case OAS2RECV:
+	case OAS2DOTTYPE:
+	case OAS2MAPR:
+	case ORECV:
+	case OSEND:
+		return 1;
+	}
+
+	if(--*budget < 0)
+		return 1;
+
+	return ishairy(n->left, budget) ||
+		ishairy(n->right, budget) ||
+		ishairylist(n->list, budget) ||
+		ishairylist(n->rlist, budget) ||
+		ishairylist(n->ninit, budget) ||
+		ishairy(n->ntest, budget) ||
+		ishairy(n->nincr, budget) ||
+		ishairylist(n->nbody, budget) ||
+		ishairylist(n->nelse, budget);
+}
+
+/*
+ * is n outside the frame, so that taking its address
+ * does not need a parameter or local in memory?
+ */
+static int
+inladdr(Node *n)
+{
+	switch(n->op) {
+	case ONAME:
+		return n->class == PEXTERN;
+	case ODOTPTR:
+	case OIND:
+		return 1;
+	case ODOT:
+		return inladdr(n->left);
+	case OINDEX:
+		if(isslice(n->left->type))
+			return 1;
+		return isfixedarray(n->left->type) && inladdr(n->left);
+	}
+	return 0;
+}
+
+/*
+ * can n be evaluated at any time, any number of times,
+ * or not at all?
+ */
+static int
+ispure(Node *n)
+{
+	if(n == N)
+		return 1;
+
+	switch(n->op) {
+	case ONAME:
+	case OLITERAL:
+		return 1;
+
+	case OINDEX:
+	case ODOT:
+	case ODOTPTR:
+	case OIND:
+	case OADDR:
+	case OLEN:
+	case OCAP:
+	case OCONV:
+	case OCONVNOP:
+	case OADD:
+	case OSUB:
+	case OMUL:
+	case OAND:
+	case OOR:
+	case OXOR:
+	case OANDNOT:
+	case OEQ:
+	case ONE:
+	case OLT:
+	case OLE:
+	case OGT:
+	case OGE:
+	case OANDAND:
+	case OOROR:
+	case ONOT:
+	case OMINUS:
+	case OPLUS:
+	case OCOM:
+		return ispure(n->left) && ispure(n->right);
+	}
+	return 0;
+}
+
+/*
+ * number of uses of the variable v in n.
+ */
+static int
+inluses(Node *n, Node *v)
+{
+	NodeList *l;
+	int c;
+
+	if(n == N)
+		return 0;
+	if(n == v)
+		return 1;
+	c = inluses(n->left, v) + inluses(n->right, v);
+	for(l=n->list; l; l=l->next)
+		c += inluses(l->n, v);
+	return c;
+}
+
+/*
+ * does n make a call?
+ */
+static int
+inlhascall(Node *n)
+{
+	NodeList *l;
+
+	if(n == N)
+		return 0;
+	if(n->op == OCALLFUNC || n->op == OCALLMETH)
+		return 1;
+	if(inlhascall(n->left) || inlhascall(n->right))
+		return 1;
+	for(l=n->list; l; l=l->next)
+		if(inlhascall(l->n))
+			return 1;
+	return 0;
+}
+
+/*
+ * the i'th parameter of t, counting the receiver.
+ */
+static Type*
+inlparam(Type *t, int i)
+{
+	Type *f;
+
+	if(getthisx(t)->type != T) {
+		if(i == 0)
+			return getthisx(t)->type;
+		i--;
+	}
+	for(f=getinargx(t)->type; f; f=f->down)
+		if(i-- == 0)
+			return f;
+	return T;
+}
+
+/*
+ * the type of the function called by n,
+ * if it has a body to inline.
+ */
+static Type*
+inlcallee(Node *n)
+{
+	Type *t, *f;
+	int nin;
+
+	switch(n->op) {
+	case OCALLFUNC:
+		if(n->left->op != ONAME || n->left->class != PFUNC)
+			return T;
+		t = n->left->type;
+		break;
+	case OCALLMETH:
+		t = n->left->type;
+		break;
+	default:
+		return T;
+	}
+	if(t == T || t->inl == nil || n->isddd)
+		return T;
+	if(t->inl->n->typecheck == 0)
+		inltypecheck(t);
+	if(t->inl == nil)
+		return T;
+
+	// not f(g()) with g returning several results
+	nin = 0;
+	for(f=getinargx(t)->type; f; f=f->down)
+		nin++;
+	if(count(n->list) != nin)
+		return T;
+	return t;
+}
+
+/*
+ * typecheck a body read from the export data.
+ */
+static void
+inltypecheck(Type *t)
+{
+	NodeList *l;
+	Node *r;
+	Type *res;
+	int lno;
+
+	lno = lineno;
+	for(l=t->inl; l; l=l->next) {
+		r = l->n;
+		if(r->op != ORETURN) {
+			typecheck(&l->n, Etop);
+			continue;
+		}
+		r->typecheck = 1;
+		if(r->list == nil)
+			continue;
+		res = getoutargx(t)->type;
+		typecheck(&r->list->n, Erv);
+		if(res == T || r->list->n->type == T) {
+			t->inl = nil;
+			break;
+		}
+		r->list->n = assignconv(r->list->n, res->type, "return");
+	}
+	lineno = lno;
+}
+
+/*
+ * a new local variable of curfn standing for var.
+ */
+static Node*
+inlvar(Node *var)
+{
+	Node *n;
+
+	n = newname(var->sym);
+	n->type = var->type;
+	n->class = PAUTO;
+	n->used = 1;
+	n->typecheck = 1;
+	n->xoffset = BADWIDTH;
+	n->curfn = curfn;
+	curfn->dcl = list(curfn->dcl, n);
+	return n;
+}
+
+/*
+ * copy n, replacing the variables that have an inlvar.
+ */
+static Node*
+inlsubst(Node *n)
+{
+	Node *m;
+
+	if(n == N)
+		return N;
+
+	switch(n->op) {
+	case ONAME:
+		if(n->inlvar != N)
+			return n->inlvar;
+		return n;
+	case OLITERAL:
+	case OTYPE:
+		return n;
+	}
+
+	m = nod(OXXX, N, N);
+	*m = *n;
+	if(inlline != 0)
+		m->lineno = inlline;
+	m->left = inlsubst(n->left);
+	m->right = inlsubst(n->right);
+	m->list = inlsubstlist(n->list);
+	m->rlist = inlsubstlist(n->rlist);
+	m->ninit = inlsubstlist(n->ninit);
+	m->ntest = inlsubst(n->ntest);
+	m->nincr = inlsubst(n->nincr);
+	m->nbody = inlsubstlist(n->nbody);
+	m->nelse = inlsubstlist(n->nelse);
+	return m;
+}
+
+static NodeList*
+inlsubstlist(NodeList *l)
+{
+	NodeList *out;
+
+	out = nil;
+	for(; l; l=l->next)
+		out = list(out, inlsubst(l->n));
+	return out;
+}
+
+/*
+ * inline the calls in the body of fn.
+ */
+void
+inlcalls(Node *fn)
+{
+	Node *savefn;
+	int lno;
+
+	savefn = curfn;
+	lno = lineno;
+	curfn = fn;
+	inlnodelist(fn->nbody, Etop);
+	curfn = savefn;
+	lineno = lno;
+}
+
+static void
+inlnodelist(NodeList *l, int top)
+{
+	for(; l; l=l->next)
+		inlnode(&l->n, top);
+}
+
+static void
+inlnode(Node **np, int top)
+{
+	Node *n, *r;
+	NodeList *body;
+
+	n = *np;
+	if(n == N)
+		return;
+
+	switch(n->op) {
+	case ODEFER:
+	case OPROC:
+		// the call is made later
+	case OCLOSURE:
+		// compiled as a function of its own
+		return;
+	}
+
+	setlineno(n);
+	inlnodelist(n->ninit, Etop);
+	inlnode(&n->left, Erv);
+	inlnode(&n->right, Erv);
+	inlnodelist(n->list, n->op == OBLOCK ? Etop : Erv);
+	inlnodelist(n->rlist, Erv);
+	inlnode(&n->ntest, Erv);
+	inlnode(&n->nincr, Etop);
+	inlnodelist(n->nbody, Etop);
+	inlnodelist(n->nelse, Etop);
+
+	switch(n->op) {
+	case OCALLFUNC:
+	case OCALLMETH:
+		if(top == Erv) {
+			inlexpr(np);
+			break;
+		}
+		body = inlbody(n, &r);
+		if(body == nil)
+			break;
+		if(r != N) {
+			r = nod(OAS, nblank, r);
+			typecheck(&r, Etop);
+			body = list(body, r);
+		}
+		*np = liststmt(concat(n->ninit, body));
+		(*np)->typecheck = 1;
+		break;
+
+	case OAS:
+		// x = f(y): the body goes before the assignment.
+		// the destination must not need evaluating,
+		// since the body would then run before it.
+		if(n->right == N || (n->right->op != OCALLFUNC && n->right->op != OCALLMETH))
+			break;
+		if(!inlsimple(n->left))
+			break;
+		body = inlbody(n->right, &r);
+		if(body == nil || r == N)
+			break;
+		n->right = r;
+		*np = liststmt(list(body, n));
+		(*np)->typecheck = 1;
+		break;
+
+	case ORETURN:
+		if(n->list == nil || n->list->next != nil)
+			break;
+		if(n->list->n->op != OCALLFUNC && n->list->n->op != OCALLMETH)
+			break;
+		body = inlbody(n->list->n, &r);
+		if(body == nil || r == N)
+			break;
+		n->list->n = r;
+		*np = liststmt(list(body, n));
+		(*np)->typecheck = 1;
+		break;
+	}
+}
+
+/*
+ * destination of an assignment that can be
+ * evaluated after the inlined body.
+ */
+static int
+inlsimple(Node *n)
+{
+	switch(n->op) {
+	case ONAME:
+		return 1;
+	case ODOT:
+		return inlsimple(n->left);
+	}
+	return 0;
+}
+
+/*
+ * replace the call *np, used as a value, by the
+ * expression its callee returns.
+ */
+static void
+inlexpr(Node **np)
+{
+	Node *n, *r, *arg;
+	NodeList *l;
+	Type *t, *f;
+	int i;
+
+	n = *np;
+	t = inlcallee(n);
+	if(t == T || n->ninit != nil)
+		return;
+	r = t->inl->n;
+	if(t->inl->next != nil || r->op != ORETURN || count(r->list) != 1)
+		return;
+	// the arguments would be evaluated after the calls
+	if(inlhascall(r->list->n))
+		return;
+
+	// an argument takes the place of each use of its parameter
+	l = n->list;
+	for(i=0; (f = inlparam(t, i)) != T; i++) {
+		if(i == 0 && n->op == OCALLMETH)
+			arg = n->left->left;
+		else {
+			arg = l->n;
+			l = l->next;
+		}
+		if(!eqtype(arg->type, f->type))
+			return;
+		// the back ends cannot convert a floating point
+		// constant that typecheck has not folded.
+		if(arg->op == OLITERAL && (arg->val.ctype == CTINT || arg->val.ctype == CTBOOL))
+			continue;
+		if(arg->op == OLITERAL)
+			return;
+		if(arg->op == ONAME || (arg->op == OADDR && arg->left->op == ONAME))
+			continue;
+		if(!ispure(arg))
+			return;
+		if(f->nname != N && inluses(r->list->n, f->nname) > 1)
+			return;
+	}
+
+	l = n->list;
+	for(i=0; (f = inlparam(t, i)) != T; i++) {
+		if(i == 0 && n->op == OCALLMETH)
+			arg = n->left->left;
+		else {
+			arg = l->n;
+			l = l->next;
+		}
+		if(f->nname != N)
+			f->nname->inlvar = arg;
+	}
+	inlline = n->lineno;
+	r = inlsubst(r->list->n);
+	for(i=0; (f = inlparam(t, i)) != T; i++)
+		if(f->nname != N)
+			f->nname->inlvar = N;
+
+	if(!eqtype(r->type, n->type))
+		return;
+	if(debug['m'])
+		warnl(n->lineno, "inlining call to %#N", n->left);
+	*np = r;
+}
+
+/*
+ * the statements of the callee of n, with the arguments assigned
+ * to new variables first.  *rv is set to the returned value.
+ */
+static NodeList*
+inlbody(Node *n, Node **rv)
+{
+	Node *r, *arg, *v, *a;
+	NodeList *l, *out;
+	Type *t, *f;
+	int i;
+
+	*rv = N;
+	t = inlcallee(n);
+	if(t == T)
+		return nil;
+
+	l = n->list;
+	for(i=0; (f = inlparam(t, i)) != T; i++) {
+		if(i == 0 && n->op == OCALLMETH)
+			arg = n->left->left;
+		else {
+			arg = l->n;
+			l = l->next;
+		}
+		if(!eqtype(arg->type, f->type))
+			return nil;
+	}
+
+	out = nil;
+	l = n->list;
+	for(i=0; (f = inlparam(t, i)) != T; i++) {
+		if(i == 0 && n->op == OCALLMETH)
+			arg = n->left->left;
+		else {
+			arg = l->n;
+			l = l->next;
+		}
+		if(f->nname == N || isblank(f->nname)) {
+			a = nod(OAS, nblank, arg);
+		} else {
+			v = inlvar(f->nname);
+			f->nname->inlvar = v;
+			a = nod(OAS, v, arg);
+		}
+		typecheck(&a, Etop);
+		out = list(out, a);
+	}
+	for(l=t->inldcl; l; l=l->next) {
+		v = inlvar(l->n);
+		l->n->inlvar = v;
+		if(l->n->class == PPARAMOUT && t->outnamed) {
+			a = nod(OAS, v, N);
+			typecheck(&a, Etop);
+			out = list(out, a);
+		}
+	}
+
+	inlline = n->lineno;
+	for(l=t->inl; l; l=l->next) {
+		r = l->n;
+		if(r->op != ORETURN) {
+			out = list(out, inlsubst(r));
+			continue;
+		}
+		if(r->list != nil)
+			*rv = inlsubst(r->list->n);
+		else if(t->outnamed)
+			*rv = getoutargx(t)->type->nname->inlvar;
+	}
+
+	for(i=0; (f = inlparam(t, i)) != T; i++)
+		if(f->nname != N)
+			f->nname->inlvar = N;
+	for(l=t->inldcl; l; l=l->next)
+		l->n->inlvar = N;
+
+	if(debug['m'])
+		warnl(n->lineno, "inlining call to %#N", n->left);
+
+	// the copy can make calls that are inlined in turn
+	if(inldepth < MaxDepth) {
+		inldepth++;
+		inlnodelist(out, Etop);
+		if(*rv != N)
+			inlnode(rv, Erv);
+		inldepth--;
+	}
+
+	if(out == nil) {
+		a = nod(OEMPTY, N, N);
+		a->typecheck = 1;
+		out = list1(a);
+	}
+	return out;
+}
+
+/*
+ * the body of the function of type t for the export data,
+ * nil if it is not simple enough to write down.  *deps is
+ * set to the functions of other packages that it calls,
+ * which the export data must declare too.
+ */
+static NodeList*	encdeps;
+
+Strlit*
+inlexport(Type *t, NodeList **deps)
+{
+	Fmt fmt;
+	char *s;
+	Strlit *sl;
+
+	*deps = nil;
+	if(t->inl == nil)
+		return nil;
+
+	fmtstrinit(&fmt);
+	encdeps = nil;
+	if(!enclist(&fmt, t->inl, t)) {
+		free(fmtstrflush(&fmt));
+		return nil;
+	}
+	s = fmtstrflush(&fmt);
+	sl = strlit(s+1);	// each statement starts with a space
+	free(s);
+	*deps = encdeps;
+	return sl;
+}
+
+static int
+encbasic(Type *t)
+{
+	return t != T && t == types[t->etype] && t->sym != S;
+}
+
+static void
+encsym(Fmt *fp, Sym *s)
+{
+	if(exportname(s->name))
+		fmtprint(fp, "%s", s->name);
+	else if(s->pkg == localpkg)
+		fmtprint(fp, "%s@", s->name);
+	else
+		fmtprint(fp, "%s@%s", s->name, s->pkg->path->s);
+}
+
+/*
+ * the statements of l, each after its init statements.
+ */
+static int
+enclist(Fmt *fp, NodeList *l, Type *t)
+{
+	NodeList *ll;
+	Node *n;
+	int i;
+
+	for(; l; l=l->next) {
+		n = l->n;
+		if(!enclist(fp, n->ninit, t))
+			return 0;
+		fmtprint(fp, " ");
+		switch(n->op) {
+		case ODCL:
+			for(i=0, ll=t->inldcl; ll; i++, ll=ll->next)
+				if(ll->n == n->left)
+					break;
+			if(ll == nil || n->left->class != PAUTO || !encbasic(n->left->type))
+				return 0;
+			fmtprint(fp, "(DCL %%%d %s)", i, n->left->type->sym->name);
+			break;
+
+		case OAS:
+			if(isblank(n->left))
+				return 0;
+			fmtprint(fp, "(AS ");
+			if(!enc(fp, n->left, t))
+				return 0;
+			if(n->right != N) {
+				fmtprint(fp, " ");
+				if(!enc(fp, n->right, t))
+					return 0;
+			}
+			fmtprint(fp, ")");
+			break;
+
+		case OIF:
+			fmtprint(fp, "(IF ");
+			if(!enc(fp, n->ntest, t))
+				return 0;
+			fmtprint(fp, " (BLOCK");
+			if(!enclist(fp, n->nbody, t))
+				return 0;
+			fmtprint(fp, ")");
+			if(n->nelse != nil) {
+				fmtprint(fp, " (BLOCK");
+				if(!enclist(fp, n->nelse, t))
+					return 0;
+				fmtprint(fp, ")");
+			}
+			fmtprint(fp, ")");
+			break;
+
+		case ORETURN:
+			fmtprint(fp, "(RETURN");
+			if(n->list != nil) {
+				if(n->list->next != nil)
+					return 0;
+				fmtprint(fp, " ");
+				if(!enc(fp, n->list->n, t))
+					return 0;
+			}
+			fmtprint(fp, ")");
+			break;
+
+		case OCALLFUNC:
+		case OCALLMETH:
+			if(!enc(fp, n, t))
+				return 0;
+			break;
+
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+enc(Fmt *fp, Node *n, Type *t)
+{
+	NodeList *l;
+	Type *f;
+	Node *fn;
+	Sym *s;
+	int i;
+
+	if(n->ninit != nil)
+		return 0;
+
+	switch(n->op) {
+	case ONAME:
+		for(i=0; (f = inlparam(t, i)) != T; i++)
+			if(f->nname == n) {
+				fmtprint(fp, "$%d", i);
+				return 1;
+			}
+		for(i=0, l=t->inldcl; l; i++, l=l->next)
+			if(l->n == n && n->class == PAUTO) {
+				fmtprint(fp, "%%%d", i);
+				return 1;
+			}
+		return 0;
+
+	case OLITERAL:
+		switch(n->val.ctype) {
+		case CTINT:
+			fmtprint(fp, "#%B", n->val.u.xval);
+			return 1;
+		case CTBOOL:
+			fmtprint(fp, n->val.u.bval ? "true" : "false");
+			return 1;
+		}
+		return 0;
+
+	case ODOT:
+	case ODOTPTR:
+	case OXDOT:
+		s = n->right->sym;
+		if(s == S)
+			return 0;
+		fmtprint(fp, "(DOT ");
+		if(!enc(fp, n->left, t))
+			return 0;
+		fmtprint(fp, " ");
+		encsym(fp, s);
+		fmtprint(fp, ")");
+		return 1;
+
+	case OCONV:
+	case OCONVNOP:
+		// only to predeclared types
+		if(!encbasic(n->type))
+			return 0;
+		fmtprint(fp, "(CONV %s ", n->type->sym->name);
+		if(!enc(fp, n->left, t))
+			return 0;
+		fmtprint(fp, ")");
+		return 1;
+
+	case OCALLFUNC:
+		// an exported function, declared in the export
+		// data if it is from another package
+		fn = n->left;
+		if(n->isddd || fn->op != ONAME || fn->class != PFUNC || !exportname(fn->sym->name))
+			return 0;
+		fmtprint(fp, "(CALL %s@", fn->sym->name);
+		if(fn->sym->pkg != localpkg) {
+			fmtprint(fp, "%s", fn->sym->pkg->path->s);
+			encdeps = list(encdeps, fn);
+		}
+		goto args;
+
+	case OCALLMETH:
+		// the name of the method, not of its function
+		s = S;
+		if((f = methtype(n->left->left->type)) != T)
+			for(f=f->method; f; f=f->down)
+				if(f->type == n->left->type)
+					s = f->sym;
+		if(s == S || n->isddd)
+			return 0;
+		fmtprint(fp, "(CALLMETH ");
+		if(!enc(fp, n->left->left, t))
+			return 0;
+		fmtprint(fp, " ");
+		encsym(fp, s);
+	args:
+		for(l=n->list; l; l=l->next) {
+			fmtprint(fp, " ");
+			if(!enc(fp, l->n, t))
+				return 0;
+		}
+		fmtprint(fp, ")");
+		return 1;
+	}
+
+	for(i=0; i<nelem(inlops); i++)
+		if(inlops[i].op == n->op)
+			break;
+	if(i == nelem(inlops))
+		return 0;
+	fmtprint(fp, "(%s", inlops[i].name);
+	if(n->left != N) {
+		fmtprint(fp, " ");
+		if(!enc(fp, n->left, t))
+			return 0;
+	}
+	if(n->right != N) {
+		fmtprint(fp, " ");
+		if(!enc(fp, n->right, t))
+			return 0;
+	}
+	fmtprint(fp, ")");
+	return 1;
+}
+
+/*
+ * read a body written by inlexport for the function type t.
+ * it is typechecked when first inlined.
+ */
+static char*	decp;
+
+static int	decargs(Type *t, NodeList **lp);
+static Sym*	decsym(char *tok);
+
+void
+inlimport(Type *t, Strlit *body)
+{
+	NodeList *l;
+	Node *n;
+
+	decp = body->s;
+	l = nil;
+	for(;;) {
+		while(*decp == ' ')
+			decp++;
+		if(*decp == '\0')
+			break;
+		n = dec(t);
+		if(n == N) {
+			t->inldcl = nil;
+			return;
+		}
+		l = list(l, n);
+	}
+	t->inl = l;
+}
+
+static char*
+dectoken(void)
+{
+	static char buf[NSYMB];
+	char *p;
+
+	while(*decp == ' ')
+		decp++;
+	p = buf;
+	while(*decp != '\0' && *decp != ' ' && *decp != '(' && *decp != ')') {
+		if(p >= buf+sizeof(buf)-1)
+			return nil;
+		*p++ = *decp++;
+	}
+	*p = '\0';
+	if(p == buf)
+		return nil;
+	return buf;
+}
+
+static Sym*
+decsym(char *tok)
+{
+	char *at;
+	Pkg *p;
+
+	at = strchr(tok, '@');
+	if(at == nil)
+		return lookup(tok);
+	*at++ = '\0';
+	p = importpkg;
+	if(*at != '\0')
+		p = mkpkg(strlit(at));
+	return pkglookup(tok, p);
+}
+
+/*
+ * the operands up to the closing parenthesis.
+ */
+static int
+decargs(Type *t, NodeList **lp)
+{
+	Node *n;
+
+	for(;;) {
+		while(*decp == ' ')
+			decp++;
+		if(*decp == ')')
+			return 1;
+		if((n = dec(t)) == N)
+			return 0;
+		*lp = list(*lp, n);
+	}
+}
+
+static Node*
+dec(Type *t)
+{
+	char *tok;
+	Node *n, *x;
+	NodeList *l;
+	Type *f;
+	Sym *s;
+	Val v;
+	int i;
+
+	while(*decp == ' ')
+		decp++;
+	if(*decp == '(') {
+		decp++;
+		tok = dectoken();
+		if(tok == nil)
+			return N;
+
+		if(strcmp(tok, "DOT") == 0) {
+			x = dec(t);
+			if(x == N || (tok = dectoken()) == nil)
+				return N;
+			n = nod(OXDOT, x, newname(decsym(tok)));
+		} else if(strcmp(tok, "CONV") == 0) {
+			if((tok = dectoken()) == nil)
+				return N;
+			s = pkglookup(tok, builtinpkg);
+			if(s->def == N || s->def->op != OTYPE)
+				return N;
+			x = dec(t);
+			if(x == N)
+				return N;
+			n = nod(OCONV, x, N);
+			n->type = s->def->type;
+		} else if(strcmp(tok, "CALL") == 0) {
+			// resolved by typecheck, when the
+			// whole export data has been read
+			if((tok = dectoken()) == nil || strchr(tok, '@') == nil)
+				return N;
+			x = newname(decsym(tok));
+			x->op = ONONAME;
+			n = nod(OCALL, x, N);
+			if(!decargs(t, &n->list))
+				return N;
+		} else if(strcmp(tok, "CALLMETH") == 0) {
+			x = dec(t);
+			if(x == N || (tok = dectoken()) == nil)
+				return N;
+			n = nod(OCALL, nod(OXDOT, x, newname(decsym(tok))), N);
+			if(!decargs(t, &n->list))
+				return N;
+		} else if(strcmp(tok, "DCL") == 0) {
+			if((tok = dectoken()) == nil || tok[0] != '%' || atoi(tok+1) != count(t->inldcl))
+				return N;
+			snprint(namebuf, sizeof(namebuf), "inl_%d", count(t->inldcl));
+			x = newname(lookup(namebuf));
+			if((tok = dectoken()) == nil)
+				return N;
+			s = pkglookup(tok, builtinpkg);
+			if(s->def == N || s->def->op != OTYPE)
+				return N;
+			x->type = s->def->type;
+			x->class = PAUTO;
+			x->typecheck = 1;
+			t->inldcl = list(t->inldcl, x);
+			n = nod(ODCL, x, N);
+		} else if(strcmp(tok, "AS") == 0) {
+			n = nod(OAS, N, N);
+			if((n->left = dec(t)) == N)
+				return N;
+			while(*decp == ' ')
+				decp++;
+			if(*decp != ')' && (n->right = dec(t)) == N)
+				return N;
+		} else if(strcmp(tok, "IF") == 0) {
+			n = nod(OIF, N, N);
+			if((n->ntest = dec(t)) == N || (x = dec(t)) == N || x->op != OBLOCK)
+				return N;
+			n->nbody = x->list;
+			while(*decp == ' ')
+				decp++;
+			if(*decp != ')') {
+				if((x = dec(t)) == N || x->op != OBLOCK)
+					return N;
+				n->nelse = x->list;
+			}
+		} else if(strcmp(tok, "BLOCK") == 0) {
+			n = nod(OBLOCK, N, N);
+			if(!decargs(t, &n->list))
+				return N;
+		} else if(strcmp(tok, "RETURN") == 0) {
+			n = nod(ORETURN, N, N);
+			if(!decargs(t, &n->list) || count(n->list) > 1)
+				return N;
+		} else {
+			for(i=0; i<nelem(inlops); i++)
+				if(strcmp(inlops[i].name, tok) == 0)
+					break;
+			if(i == nelem(inlops))
+				return N;
+			n = nod(inlops[i].op, N, N);
+			while(*decp == ' ')
+				decp++;
+			if(*decp != ')' && (n->left = dec(t)) == N)
+				return N;
+			while(*decp == ' ')
+				decp++;
+			if(*decp != ')' && (n->right = dec(t)) == N)
+				return N;
+		}
+		while(*decp == ' ')
+			decp++;
+		if(*decp != ')')
+			return N;
+		decp++;
+		return n;
+	}
+
+	tok = dectoken();
+	if(tok == nil)
+		return N;
+	switch(tok[0]) {
+	case '$':
+		f = inlparam(t, atoi(tok+1));
+		if(f == T)
+			return N;
+		if(f->nname == N)
+			f->nname = newname(lookup("_"));
+		n = f->nname;
+		n->type = f->type;
+		n->class = PPARAM;
+		n->typecheck = 1;
+		return n;
+
+	case '%':
+		i = atoi(tok+1);
+		for(l=t->inldcl; l && i > 0; l=l->next)
+			i--;
+		if(l == nil)
+			return N;
+		return l->n;
+
+	case '#':
+		v.ctype = CTINT;
+		v.u.xval = mal(sizeof(*v.u.xval));
+		mpatofix(v.u.xval, tok+1);
+		return nodlit(v);
+	}
+	if(strcmp(tok, "true") == 0)
+		return nodbool(1);
+	if(strcmp(tok, "false") == 0)
+		return nodbool(0);
+	return N;
+}
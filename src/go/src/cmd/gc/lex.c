@@ -81,6 +81,8 @@ usage(void)
 	print("  -e no limit on number of errors printed\n");
 	print("  -f print stack frame structure\n");
 	print("  -h panic on an error\n");
+	print("  -l disable inlining\n");
+	print("  -m print escape analysis and inlining decisions\n");
 	print("  -o file specify output file\n");
 	print("  -S print the assembly language\n");
 	print("  -V print the compiler version\n");
@@ -245,6 +247,10 @@ main(int argc, char *argv[])
 	// Phase 2: Variable assignments.
 	//   To check interface assignments, depends on phase 1.
 	// Phase 3: Function bodies.
+	// Phase 4: Inlining of small functions into their callers.
+	// Phase 5: Escape analysis over all the bodies, so that
+	//   addresses that do not outlive their frame stay on the stack.
+	// Phase 6: Compile function bodies.
 	defercheckwidth();
 	for(l=xtop; l; l=l->next)
 		if(l->n->op != ODCL && l->n->op != OAS)
@@ -253,6 +259,30 @@ main(int argc, char *argv[])
 		if(l->n->op == ODCL || l->n->op == OAS)
 			typecheck(&l->n, Etop);
 	resumecheckwidth();
+	escdefer = !debug['N'];
+	for(l=xtop; l; l=l->next) {
+		if(l->n->op == ODCLFUNC) {
+			// assign parameter offsets
+			checkwidth(l->n->type);
+			curfn = l->n;
+			typechecklist(l->n->nbody, Etop);
+			curfn = nil;
+		}
+	}
+	escdefer = 0;
+	if(nerrors == 0 && !debug['N'] && !debug['l']) {
+		// decide first, so that calls to functions
+		// declared later in the file are inlined too.
+		inlstackwalk(xtop);
+		for(l=xtop; l; l=l->next)
+			if(l->n->op == ODCLFUNC)
+				caninl(l->n);
+		for(l=xtop; l; l=l->next)
+			if(l->n->op == ODCLFUNC)
+				inlcalls(l->n);
+	}
+	if(nerrors == 0 && !debug['N'])
+		escapes(xtop);
 	for(l=xtop; l; l=l->next)
 		if(l->n->op == ODCLFUNC)
 			funccompile(l->n, 0);
@@ -1205,6 +1235,10 @@ caseout:
  * //line parse.y:15
  * as a discontinuity in sequential line numbers.
  * the next line of input comes from parse.y:15
+ *
+ * also
+ * //go:noinline
+ * which keeps the next function from being inlined.
  */
 static int
 getlinepragma(void)
@@ -1213,7 +1247,21 @@ getlinepragma(void)
 	char *cp, *ep;
 	Hist *h;
 
-	for(i=0; i<5; i++) {
+	c = getr();
+	if(c == 'g') {
+		for(i=1; i<11; i++) {
+			c = getr();
+			if(c != "go:noinline"[i])
+				goto out;
+		}
+		c = getr();
+		if(c == '\n' || c == ' ' || c == '\t' || c == EOF)
+			noinline = 1;
+		goto out;
+	}
+	if(c != 'l')
+		goto out;
+	for(i=1; i<5; i++) {
 		c = getr();
 		if(c != "line "[i])
 			goto out;
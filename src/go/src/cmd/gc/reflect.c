@@ -519,7 +519,7 @@ typestruct(Type *t)
 	return pkglookup(name, typepkg);
 }
 
-static int
+int
 haspointers(Type *t)
 {
 	Type *t1;
@@ -538,6 +538,8 @@ haspointers(Type *t)
 	case TUINTPTR:
 	case TFLOAT32:
 	case TFLOAT64:
+	case TCOMPLEX64:
+	case TCOMPLEX128:
 	case TBOOL:
 		return 0;
 	case TARRAY:
@@ -562,6 +564,188 @@ haspointers(Type *t)
 	}
 }
 
+enum {
+	MaxGCWords = 1024,	// largest type described word by word
+	MapBucketSize = 8,	// BUCKETSIZE in ../../pkg/runtime/hashmap.c
+	MapMaxValueSize = 128,	// MAXVALUESIZE in ../../pkg/runtime/hashmap.c
+};
+
+/*
+ * set the bits of the words that hold pointers
+ * in a value of type t at offset off.
+ */
+static void
+gcbits(Type *t, vlong off, uchar *bits)
+{
+	Type *t1;
+	vlong i;
+
+	switch(t->etype) {
+	case TPTR32:
+	case TPTR64:
+	case TUNSAFEPTR:
+	case TSTRING:
+	case TCHAN:
+	case TMAP:
+	case TFUNC:
+		i = off/widthptr;
+		bits[i/8] |= 1<<(i%8);
+		break;
+	case TINTER:
+		// the type word, then the data word,
+		// which may hold a pointer.
+		i = off/widthptr;
+		bits[i/8] |= 1<<(i%8);
+		i++;
+		bits[i/8] |= 1<<(i%8);
+		break;
+	case TARRAY:
+		if(t->bound < 0) {	// slice
+			i = off/widthptr;
+			bits[i/8] |= 1<<(i%8);
+			break;
+		}
+		if(!haspointers(t->type))
+			break;
+		for(i=0; i<t->bound; i++)
+			gcbits(t->type, off + i*t->type->width, bits);
+		break;
+	case TSTRUCT:
+		for(t1=t->type; t1!=T; t1=t1->down)
+			gcbits(t1->type, off + t1->width, bits);
+		break;
+	}
+}
+
+/*
+ * the symbol of the pointer bitmap named fmt for t.
+ */
+static Sym*
+gclookup(char *fmt, Type *t)
+{
+	static Pkg *gcpkg;
+	Sym *s;
+	char *p;
+
+	if(gcpkg == nil) {
+		gcpkg = mkpkg(strlit("gcbits"));
+		gcpkg->name = "gcbits";
+		gcpkg->prefix = "gcbits";
+	}
+	p = smprint(fmt, t);
+	s = pkglookup(p, gcpkg);
+	free(p);
+	return s;
+}
+
+/*
+ * a bitmap for nw words.  the collector may load it
+ * a whole word at a time, so pad it to a word boundary.
+ */
+static uchar*
+gcalloc(vlong nw)
+{
+	return mal(rnd((nw+7)/8, widthptr));
+}
+
+/*
+ * emit the bitmap bits of nw words in s.
+ */
+static Sym*
+dgcbits(Sym *s, vlong nw, uchar *bits)
+{
+	vlong i;
+	int ot;
+
+	ot = duintptr(s, 0, nw);
+	for(i=0; i<rnd((nw+7)/8, widthptr); i++)
+		ot = duint8(s, ot, bits[i]);
+	ggloblsym(s, ot, 1);
+	return s;
+}
+
+/*
+ * the pointer bitmap of t for the garbage collector,
+ * ../../pkg/runtime/mgc0.c:/scanblock: the number of
+ * words described, then a bit for each word.  an array
+ * is described by its element; the collector repeats
+ * the bitmap over the whole object.  nil if t has no
+ * pointers, or is too big: the collector then scans
+ * every word of the object.
+ */
+static Sym*
+dgcsym(Type *t)
+{
+	Sym *s;
+	uchar *bits;
+	vlong nw;
+
+	if(!haspointers(t))
+		return nil;
+	while(t->etype == TARRAY && t->bound >= 0)
+		t = t->type;
+	nw = t->width/widthptr;
+	if(nw == 0 || nw > MaxGCWords)
+		return nil;
+
+	s = gclookup("%#-T", t);
+	if(s->flags & SymSiggen)
+		return s;
+	s->flags |= SymSiggen;
+
+	bits = gcalloc(nw);
+	gcbits(t, 0, bits);
+	return dgcbits(s, nw, bits);
+}
+
+/*
+ * the pointer bitmap of a bucket of the map type t,
+ * ../../pkg/runtime/hashmap.c:/Bucket: the top bytes of
+ * the hashes of its MapBucketSize keys and the overflow
+ * pointer, then the keys, then the values, each a
+ * pointer to the value if it is larger than MapMaxValueSize.
+ */
+static Sym*
+dgcmapbucket(Type *t)
+{
+	Sym *s;
+	uchar *bits;
+	vlong keysize, valsize, off, nw, i, w;
+	int indirect;
+
+	dowidth(t->down);
+	dowidth(t->type);
+	keysize = t->down->width;
+	valsize = t->type->width;
+	indirect = valsize > MapMaxValueSize;
+	if(indirect)
+		valsize = widthptr;
+	off = MapBucketSize + widthptr;
+	nw = (off + MapBucketSize*(keysize + valsize))/widthptr;
+	if(nw > MaxGCWords)
+		return nil;
+
+	s = gclookup("bucket.%#-T", t);
+	if(s->flags & SymSiggen)
+		return s;
+	s->flags |= SymSiggen;
+
+	bits = gcalloc(nw);
+	w = MapBucketSize/widthptr;
+	bits[w/8] |= 1<<(w%8);
+	for(i=0; i<MapBucketSize; i++)
+		gcbits(t->down, off + i*keysize, bits);
+	off += MapBucketSize*keysize;
+	for(i=0; i<MapBucketSize; i++) {
+		if(indirect) {
+			w = (off + i*valsize)/widthptr;
+			bits[w/8] |= 1<<(w%8);
+		} else
+			gcbits(t->type, off + i*valsize, bits);
+	}
+	return dgcbits(s, nw, bits);
+}
+
 /*
  * commonType
  * ../../pkg/runtime/type.go:/commonType
@@ -572,6 +756,7 @@ dcommontype(Sym *s, int ot, Type *t)
 	int i;
 	Sym *s1;
 	Sym *sptr;
+	Sym *sgc;
 	char *p;
 
 	dowidth(t);
@@ -583,6 +768,7 @@ dcommontype(Sym *s, int ot, Type *t)
 		sptr = weaktypesym(ptrto(t));
 
 	s1 = dextratype(t);
+	sgc = dgcsym(t);
 
 	// empty interface pointing at this type.
 	// all the references that we emit are *interface{};
@@ -602,7 +788,8 @@ dcommontype(Sym *s, int ot, Type *t)
 	//		kind uint8;
 	//		string *string;
 	//		*extraType;
-	//		ptrToThis *Type
+	//		ptrToThis *Type;
+	//		gc unsafe.Pointer;
 	//	}
 	ot = duintptr(s, ot, t->width);
 	ot = duint32(s, ot, typehash(t));
@@ -625,6 +812,10 @@ dcommontype(Sym *s, int ot, Type *t)
 	else
 		ot = duintptr(s, ot, 0);
 	ot = dsymptr(s, ot, sptr, 0);  // ptr to type
+	if(sgc)
+		ot = dsymptr(s, ot, sgc, 0);	// pointer bitmap
+	else
+		ot = duintptr(s, ot, 0);
 	return ot;
 }
 
@@ -692,7 +883,7 @@ static Sym*
 dtypesym(Type *t)
 {
 	int ot, n, isddd, dupok;
-	Sym *s, *s1, *s2;
+	Sym *s, *s1, *s2, *s3;
 	Sig *a, *m;
 	Type *t1, *tbase;
 
@@ -805,9 +996,14 @@ ok:
 		// ../../pkg/runtime/type.go:/MapType
 		s1 = dtypesym(t->down);
 		s2 = dtypesym(t->type);
+		s3 = dgcmapbucket(t);
 		ot = dcommontype(s, ot, t);
 		ot = dsymptr(s, ot, s1, 0);
 		ot = dsymptr(s, ot, s2, 0);
+		if(s3)
+			ot = dsymptr(s, ot, s3, 0);
+		else
+			ot = duintptr(s, ot, 0);
 		break;
 
 	case TPTR32:
@@ -86,12 +86,30 @@ typecheckselect(Node *sel)
 	lineno = lno;
 }
 
+// Size of the runtime's Select for size cases, followed by its
+// lockorder and pollorder arrays.  Keep in sync with
+// ../../pkg/runtime/chan.c.
+static vlong
+selectsize(int size)
+{
+	vlong sudog, scase, sel;
+
+	sudog = 4*widthptr;	// g, selgen, link, elem
+	scase = sudog + 4*widthptr;	// chan, pc, kind+so, receivedp
+	sel = 3*widthptr + scase;	// tcase+ncase, pollorder, lockorder, scase[1]
+	if(size > 1)
+		sel += (size-1)*scase;
+	return sel + size*widthptr + size*2;
+}
+
 void
 walkselect(Node *sel)
 {
 	int lno, i;
-	Node *n, *r, *a, *tmp, *var, *cas, *dflt, *ch;
+	vlong size;
+	Node *n, *r, *a, *tmp, *var, *selv, *cas, *dflt, *ch;
 	NodeList *l, *init;
+	Type *t;
 	
 	if(sel->list == nil && sel->xoffset != 0)
 		fatal("double walkselect");	// already rewrote
@@ -282,12 +300,29 @@ walkselect(Node *sel)
 	init = sel->ninit;
 	sel->ninit = nil;
 
-	// generate sel-struct
+	// generate sel-struct on the stack
+	size = selectsize(sel->xoffset);
+	t = typ(TARRAY);
+	t->type = types[TUINTPTR];
+	t->bound = (size + widthptr - 1) / widthptr;
+	dowidth(t);
+	selv = nod(OXXX, N, N);
+	tempname(selv, t);
+	a = nod(OADDR, selv, N);
+	a->etype = 1;  // pointer does not escape
+	typecheck(&a, Erv);
+	a = nod(OCONV, a, N);
+	a->type = types[TUNSAFEPTR];
+	typecheck(&a, Erv);
+	a = nod(OCONV, a, N);
+	a->type = ptrto(types[TUINT8]);
+	typecheck(&a, Erv);
 	var = nod(OXXX, N, N);
 	tempname(var, ptrto(types[TUINT8]));
-	r = nod(OAS, var, mkcall("newselect", var->type, nil, nodintconst(sel->xoffset)));
+	r = nod(OAS, var, a);
 	typecheck(&r, Etop);
 	init = list(init, r);
+	init = list(init, mkcall("newselect", T, nil, var, nodintconst(size), nodintconst(sel->xoffset)));
 
 	// register cases
 	for(l=sel->list; l; l=l->next) {
@@ -309,9 +344,24 @@ walkselect(Node *sel)
 				fatal("select %O", n->op);
 	
 			case OSEND:
-				// selectsend(sel *byte, hchan *chan any, elem any) (selected bool);
-				r->ntest = mkcall1(chanfn("selectsend", 2, n->left->type), types[TBOOL],
-					&init, var, n->left, n->right);
+				// selectsend(sel *byte, hchan *chan any, elem *any) (selected bool);
+				// evaluate the channel, then the value into a temporary
+				// that lives as long as the select.
+				ch = nod(OXXX, N, N);
+				tempname(ch, n->left->type);
+				a = nod(OAS, ch, n->left);
+				typecheck(&a, Etop);
+				init = list(init, a);
+				tmp = nod(OXXX, N, N);
+				tempname(tmp, ch->type->type);
+				a = nod(OAS, tmp, n->right);
+				typecheck(&a, Etop);
+				init = list(init, a);
+				a = nod(OADDR, tmp, N);
+				a->etype = 1;  // pointer does not escape
+				typecheck(&a, Erv);
+				r->ntest = mkcall1(chanfn("selectsend", 2, ch->type), types[TBOOL],
+					&init, var, ch, a);
 				break;
 
 			case OSELRECV:
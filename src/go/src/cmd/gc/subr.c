@@ -196,6 +196,16 @@ warn(char *fmt, ...)
 	hcrash();
 }
 
+void
+warnl(int line, char *fmt, ...)
+{
+	va_list arg;
+
+	va_start(arg, fmt);
+	adderr(line, fmt, arg);
+	va_end(arg);
+}
+
 void
 fatal(char *fmt, ...)
 {
@@ -1289,7 +1299,8 @@ Tpretty(Fmt *fp, Type *t)
 			fmtprint(fp, "...%T", t->type->type);
 		else
 			fmtprint(fp, "%T", t->type);
-		if(t->note) {
+		// parameters only carry escape tags, see esc.c
+		if(t->note && (exporting || !t->funarg)) {
 			fmtprint(fp, " ");
 			if(exporting)
 				fmtprint(fp, ":");
@@ -22,7 +22,6 @@ static void	typecheckaste(int, Node*, int, Type*, NodeList*, char*);
 static Type*	lookdot1(Sym *s, Type *t, Type *f, int);
 static int	nokeys(NodeList*);
 static void	typecheckcomplit(Node**);
-static void	addrescapes(Node*);
 static void	typecheckas2(Node*);
 static void	typecheckas(Node*);
 static void	typecheckfunc(Node*);
@@ -504,7 +503,10 @@ reswitch:
 		l = n->left;
 		if((t = l->type) == T)
 			goto error;
-		if(!(top & Eindir) && !n->etype)
+		// top&Eindir means this is &x in *&x.  (or the arrow part of x->y)
+		// n->etype means code generator flagged it as non-escaping.
+		// escdefer means escape analysis decides later.
+		if(!(top & Eindir) && !n->etype && !escdefer)
 			addrescapes(n->left);
 		n->type = ptrto(t);
 		goto ret;
@@ -1551,7 +1553,8 @@ lookdot(Node *n, Type *t, int dostrcmp)
 		if(!eqtype(rcvr, tt)) {
 			if(rcvr->etype == tptr && eqtype(rcvr->type, tt)) {
 				checklvalue(n->left, "call pointer method on");
-				addrescapes(n->left);
+				if(!escdefer)
+					addrescapes(n->left);
 				n->left = nod(OADDR, n->left, N);
 				n->left->implicit = 1;
 				typecheck(&n->left, Etype|Erv);
@@ -2115,7 +2118,7 @@ error:
  * the current function returns.  mark any local vars
  * as needing to move to the heap.
  */
-static void
+void
 addrescapes(Node *n)
 {
 	char buf[100];
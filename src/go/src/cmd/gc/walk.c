@@ -8,6 +8,7 @@ static	Node*	walkprint(Node*, NodeList**, int);
 static	Node*	conv(Node*, Type*);
 static	Node*	mapfn(char*, Type*);
 static	Node*	makenewvar(Type*, NodeList**, Node**);
+static	Node*	stackaddr(Node*);
 static	Node*	ascompatee1(int, Node*, Node*, NodeList**);
 static	NodeList*	ascompatee(int, NodeList*, NodeList*, NodeList**);
 static	NodeList*	ascompatet(int, NodeList*, Type**, int, NodeList**);
@@ -653,6 +654,13 @@ walkexpr(Node **np, NodeList **init)
 			nodconst(n, n->type, t->bound);
 			n->typecheck = 1;
 		}
+		// the runtime computes the length of a channel
+		// from its send and receive positions.
+		if(n->op == OLEN && t->etype == TCHAN) {
+			fn = syslook("lenchan", 1);
+			argtype(fn, n->left->type);
+			n = mkcall1(fn, n->type, init, n->left);
+		}
 		goto ret;
 	
 	case OLSH:
@@ -1088,7 +1096,30 @@ walkexpr(Node **np, NodeList **init)
 		if(n->etype == 1)
 			goto ret;
 		t = n->left->type;
-		n = mkcall1(mapfn("mapaccess1", t), t->type, init, n->left, n->right);
+		p = nil;
+		if(t->type->width <= 128) {	// MAXVALUESIZE in ../../pkg/runtime/hashmap.c
+			switch(simsimtype(t->down)) {
+			case TINT32:
+			case TUINT32:
+				p = "mapaccess1_fast32";
+				break;
+			case TINT64:
+			case TUINT64:
+				p = "mapaccess1_fast64";
+				break;
+			case TSTRING:
+				p = "mapaccess1_faststr";
+				break;
+			}
+		}
+		if(p != nil) {
+			// The fast versions return a pointer to the value.
+			n = mkcall1(mapfn(p, t), ptrto(t->type), init, n->left, n->right);
+			n = nod(OIND, n, N);
+			n->type = t->type;
+			n->typecheck = 1;
+		} else
+			n = mkcall1(mapfn("mapaccess1", t), t->type, init, n->left, n->right);
 		goto ret;
 
 	case ORECV:
@@ -1197,8 +1228,17 @@ walkexpr(Node **np, NodeList **init)
 		// and replace expression with nvar
 		switch(n->left->op) {
 		case OARRAYLIT:
-		case OMAPLIT:
 		case OSTRUCTLIT:
+			if(n->esc == EscNone) {
+				// escape analysis says the literal
+				// does not outlive this frame.
+				nvar = nod(OXXX, N, N);
+				tempname(nvar, n->left->type);
+				anylit(0, n->left, nvar, init);
+				n = stackaddr(nvar);
+				goto ret;
+			}
+		case OMAPLIT:
 			nvar = makenewvar(n->type, init, &nstar);
 			anylit(0, n->left, nstar, init);
 			n = nvar;
@@ -1209,6 +1249,17 @@ walkexpr(Node **np, NodeList **init)
 		goto ret;
 
 	case ONEW:
+		if(n->esc == EscNone) {
+			// zeroed stack temporary instead of an allocation
+			nvar = nod(OXXX, N, N);
+			tempname(nvar, n->type->type);
+			r = nod(OAS, nvar, N);
+			typecheck(&r, Etop);
+			walkexpr(&r, init);
+			*init = list(*init, r);
+			n = stackaddr(nvar);
+			goto ret;
+		}
 		n = callnew(n->type->type);
 		goto ret;
 
@@ -1321,8 +1372,7 @@ walkexpr(Node **np, NodeList **init)
 		argtype(fn, t->type);	// any-2
 
 		n = mkcall1(fn, n->type, init,
-			typename(t->down),	// key type
-			typename(t->type),		// value type
+			typename(t),
 			conv(n->left, types[TINT64]));
 		goto ret;
 
@@ -1413,6 +1463,21 @@ ret:
 	*np = n;
 }
 
+/*
+ * address of a stack temporary that escape analysis
+ * showed does not outlive the frame.
+ */
+static Node*
+stackaddr(Node *nvar)
+{
+	Node *n;
+
+	n = nod(OADDR, nvar, N);
+	n->etype = 1;	// pointer does not escape
+	typecheck(&n, Erv);
+	return n;
+}
+
 static Node*
 makenewvar(Type *t, NodeList **init, Node **nstar)
 {
@@ -1900,7 +1965,7 @@ callnew(Type *t)
 	dowidth(t);
 	fn = syslook("new", 1);
 	argtype(fn, t);
-	return mkcall1(fn, ptrto(t), nil, nodintconst(t->width));
+	return mkcall1(fn, ptrto(t), nil, typename(t));
 }
 
 static Node*
@@ -774,7 +774,7 @@ enum {
 	KindNoPointers = 1<<7,
 
 	// size of Type interface header + CommonType structure.
-	CommonSize = 2*PtrSize+ 4*PtrSize + 8,
+	CommonSize = 2*PtrSize+ 5*PtrSize + 8,
 };
 
 static Reloc*
@@ -852,7 +852,7 @@ decodetype_size(Sym *s)
 static Sym*
 decodetype_arrayelem(Sym *s)
 {
-	return decode_reloc_sym(s, CommonSize);	// 0x1c / 0x30
+	return decode_reloc_sym(s, CommonSize);	// 0x24 / 0x40
 }
 
 static vlong
@@ -865,26 +865,26 @@ decodetype_arraylen(Sym *s)
 static Sym*
 decodetype_ptrelem(Sym *s)
 {
-	return decode_reloc_sym(s, CommonSize);	// 0x1c / 0x30
+	return decode_reloc_sym(s, CommonSize);	// 0x24 / 0x40
 }
 
 // Type.MapType.key, elem
 static Sym*
 decodetype_mapkey(Sym *s)
 {
-	return decode_reloc_sym(s, CommonSize);	// 0x1c / 0x30
+	return decode_reloc_sym(s, CommonSize);	// 0x24 / 0x40
 }
 static Sym*
 decodetype_mapvalue(Sym *s)
 {
-	return decode_reloc_sym(s, CommonSize+PtrSize);	// 0x20 / 0x38
+	return decode_reloc_sym(s, CommonSize+PtrSize);	// 0x28 / 0x48
 }
 
 // Type.ChanType.elem
 static Sym*
 decodetype_chanelem(Sym *s)
 {
-	return decode_reloc_sym(s, CommonSize);	// 0x1c / 0x30
+	return decode_reloc_sym(s, CommonSize);	// 0x24 / 0x40
 }
 
 // Type.FuncType.dotdotdot
@@ -1290,30 +1290,41 @@ mkinternaltypename(char *base, char *arg1, char *arg2)
 
 // synthesizemaptypes is way too closely married to runtime/hashmap.c
 enum {
-	MaxValsize = 256 - 64
+	BucketSize = 8,
+	MaxValSize = 128,
 };
 
+// Construct an array type of BucketSize elements of type elem.
+static DWDie*
+mkbucketarray(char *name, char *kname, char *vname, DWDie *elem, int elemsize)
+{
+	DWDie *die, *fld;
+
+	die = newdie(&dwtypes, DW_ABRV_ARRAYTYPE, mkinternaltypename(name, kname, vname));
+	newattr(die, DW_AT_byte_size, DW_CLS_CONSTANT, BucketSize * elemsize, 0);
+	newrefattr(die, DW_AT_type, elem);
+	fld = newdie(die, DW_ABRV_ARRAYRANGE, "range");
+	newattr(fld, DW_AT_upper_bound, DW_CLS_CONSTANT, BucketSize, 0);
+	newrefattr(fld, DW_AT_type, find_or_diag(&dwtypes, "uintptr"));
+	return die;
+}
+
 static void
 synthesizemaptypes(DWDie *die)
 {
 
-	DWDie *hash, *hash_subtable, *hash_entry,
-		*dwh, *dwhs, *dwhe, *dwhash, *keytype, *valtype, *fld;
-	int hashsize, keysize, valsize, datsize, valsize_in_hash, datavo;
+	DWDie *hash, *bucket, *dwh, *dwhb, *dwhk, *dwhv, *keytype, *valtype, *fld;
+	int keysize, valsize, bucketsize;
+	char *kname, *vname;
 	DWAttr *a;
 
 	hash		= defgotype(lookup_or_diag("type.runtime.hmap"));
-	hash_subtable	= defgotype(lookup_or_diag("type.runtime.hash_subtable"));
-	hash_entry	= defgotype(lookup_or_diag("type.runtime.hash_entry"));
+	bucket		= defgotype(lookup_or_diag("type.runtime.bucket"));
 
-	if (hash == nil || hash_subtable == nil || hash_entry == nil)
+	if (hash == nil || bucket == nil)
 		return;
 
-	dwhash = (DWDie*)getattr(find_or_diag(hash_entry, "hash"), DW_AT_type)->data;
-	if (dwhash == nil)
-		return;
-
-	hashsize = getattr(dwhash, DW_AT_byte_size)->value;
+	bucketsize = getattr(bucket, DW_AT_byte_size)->value;
 
 	for (; die != nil; die = die->link) {
 		if (die->abbrev != DW_ABRV_MAPTYPE)
@@ -1321,6 +1332,8 @@ synthesizemaptypes(DWDie *die)
 
 		keytype = (DWDie*) getattr(die, DW_AT_internal_key_type)->data;
 		valtype = (DWDie*) getattr(die, DW_AT_internal_val_type)->data;
+		kname = getattr(keytype, DW_AT_name)->data;
+		vname = getattr(valtype, DW_AT_name)->data;
 
 		a = getattr(keytype, DW_AT_byte_size);
 		keysize = a ? a->value : PtrSize;  // We don't store size with Pointers
@@ -1328,57 +1341,35 @@ synthesizemaptypes(DWDie *die)
 		a = getattr(valtype, DW_AT_byte_size);
 		valsize = a ? a->value : PtrSize;
 
-		// This is what happens in hash_init and makemap_c
-		valsize_in_hash = valsize;
-		if (valsize > MaxValsize)
-			valsize_in_hash = PtrSize;
-		datavo = keysize;
-		if (valsize_in_hash >= PtrSize)
-			datavo = rnd(keysize, PtrSize);
-		datsize = datavo + valsize_in_hash;
-		if (datsize < PtrSize)
-			datsize = PtrSize;
-		datsize = rnd(datsize, PtrSize);
-
-		// Construct struct hash_entry<K,V>
-		dwhe = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
-			mkinternaltypename("hash_entry",
-				getattr(keytype, DW_AT_name)->data,
-				getattr(valtype, DW_AT_name)->data));
-
-		fld = newdie(dwhe, DW_ABRV_STRUCTFIELD, "hash");
-		newrefattr(fld, DW_AT_type, dwhash);
-		newmemberoffsetattr(fld, 0);
-
-		fld = newdie(dwhe, DW_ABRV_STRUCTFIELD, "key");
-		newrefattr(fld, DW_AT_type, keytype);
-		newmemberoffsetattr(fld, hashsize);
-
-		fld = newdie(dwhe, DW_ABRV_STRUCTFIELD, "val");
-		if (valsize > MaxValsize)
+		// This is what happens in makemap_c
+		if (valsize > MaxValSize) {
 			valtype = defptrto(valtype);
-		newrefattr(fld, DW_AT_type, valtype);
-		newmemberoffsetattr(fld, hashsize + datavo);
-		newattr(dwhe, DW_AT_byte_size, DW_CLS_CONSTANT, hashsize + datsize, NULL);
-
-		// Construct hash_subtable<hash_entry<K,V>>
-		dwhs = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
-			mkinternaltypename("hash_subtable",
-				getattr(keytype, DW_AT_name)->data,
-				getattr(valtype, DW_AT_name)->data));
-		copychildren(dwhs, hash_subtable);
-		substitutetype(dwhs, "end", defptrto(dwhe));
-		substitutetype(dwhs, "entry", dwhe);  // todo: []hash_entry with dynamic size
-		newattr(dwhs, DW_AT_byte_size, DW_CLS_CONSTANT,
-			getattr(hash_subtable, DW_AT_byte_size)->value, NULL);
+			valsize = PtrSize;
+		}
+
+		// Construct bucket<K,V>: the header, then the keys, then the values.
+		dwhk = mkbucketarray("[]key", kname, vname, keytype, keysize);
+		dwhv = mkbucketarray("[]val", kname, vname, valtype, valsize);
+
+		dwhb = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
+			mkinternaltypename("bucket", kname, vname));
+		copychildren(dwhb, bucket);
+		fld = newdie(dwhb, DW_ABRV_STRUCTFIELD, "keys");
+		newrefattr(fld, DW_AT_type, dwhk);
+		newmemberoffsetattr(fld, bucketsize);
+		fld = newdie(dwhb, DW_ABRV_STRUCTFIELD, "values");
+		newrefattr(fld, DW_AT_type, dwhv);
+		newmemberoffsetattr(fld, bucketsize + BucketSize * keysize);
+		newattr(dwhb, DW_AT_byte_size, DW_CLS_CONSTANT,
+			bucketsize + BucketSize * (keysize + valsize), NULL);
+		substitutetype(dwhb, "overflow", defptrto(dwhb));
 
 		// Construct hash<K,V>
 		dwh = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
-			mkinternaltypename("hash",
-				getattr(keytype, DW_AT_name)->data,
-				getattr(valtype, DW_AT_name)->data));
+			mkinternaltypename("hash", kname, vname));
 		copychildren(dwh, hash);
-		substitutetype(dwh, "st", defptrto(dwhs));
+		substitutetype(dwh, "buckets", defptrto(dwhb));
+		substitutetype(dwh, "oldbuckets", defptrto(dwhb));
 		newattr(dwh, DW_AT_byte_size, DW_CLS_CONSTANT,
 			getattr(hash, DW_AT_byte_size)->value, NULL);
 
@@ -1389,36 +1380,28 @@ synthesizemaptypes(DWDie *die)
 static void
 synthesizechantypes(DWDie *die)
 {
-	DWDie *sudog, *waitq, *link, *hchan,
-		*dws, *dww, *dwl, *dwh, *elemtype;
-	DWAttr *a;
-	int elemsize, linksize, sudogsize;
+	DWDie *sudog, *waitq, *hchan,
+		*dws, *dww, *dwh, *elemtype;
 
 	sudog = defgotype(lookup_or_diag("type.runtime.sudog"));
 	waitq = defgotype(lookup_or_diag("type.runtime.waitq"));
-	link  = defgotype(lookup_or_diag("type.runtime.link"));
 	hchan = defgotype(lookup_or_diag("type.runtime.hchan"));
-	if (sudog == nil || waitq == nil || link == nil || hchan == nil)
+	if (sudog == nil || waitq == nil || hchan == nil)
 		return;
 
-	sudogsize = getattr(sudog, DW_AT_byte_size)->value;
-	linksize = getattr(link, DW_AT_byte_size)->value;
-
 	for (; die != nil; die = die->link) {
 		if (die->abbrev != DW_ABRV_CHANTYPE)
 			continue;
 		elemtype = (DWDie*) getattr(die, DW_AT_internal_elem_type)->data;
-		a = getattr(elemtype, DW_AT_byte_size);
-		elemsize = a ? a->value : PtrSize;
 
 		// sudog<T>
 		dws = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
 			mkinternaltypename("sudog",
 				getattr(elemtype, DW_AT_name)->data, NULL));
 		copychildren(dws, sudog);
-		substitutetype(dws, "elem", elemtype);
+		substitutetype(dws, "elem", defptrto(elemtype));
 		newattr(dws, DW_AT_byte_size, DW_CLS_CONSTANT,
-			sudogsize + (elemsize > 8 ? elemsize - 8 : 0), NULL);
+			getattr(sudog, DW_AT_byte_size)->value, NULL);
 
 		// waitq<T>
 		dww = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
@@ -1429,24 +1412,13 @@ synthesizechantypes(DWDie *die)
 		newattr(dww, DW_AT_byte_size, DW_CLS_CONSTANT,
 			getattr(waitq, DW_AT_byte_size)->value, NULL);
 
-		// link<T>
-		dwl = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
-			mkinternaltypename("link", getattr(elemtype, DW_AT_name)->data, NULL));
-		copychildren(dwl, link);
-		substitutetype(dwl, "link", defptrto(dwl));
-		substitutetype(dwl, "elem", elemtype);
-		newattr(dwl, DW_AT_byte_size, DW_CLS_CONSTANT,
-			linksize + (elemsize > 8 ? elemsize - 8 : 0), NULL);
-
 		// hchan<T>
 		dwh = newdie(&dwtypes, DW_ABRV_STRUCTTYPE,
 			mkinternaltypename("hchan", getattr(elemtype, DW_AT_name)->data, NULL));
 		copychildren(dwh, hchan);
-		substitutetype(dwh, "senddataq", defptrto(dwl));
-		substitutetype(dwh, "recvdataq", defptrto(dwl));
+		substitutetype(dwh, "buf", defptrto(elemtype));
 		substitutetype(dwh, "recvq", dww);
 		substitutetype(dwh, "sendq", dww);
-		substitutetype(dwh, "free", dws);
 		newattr(dwh, DW_AT_byte_size, DW_CLS_CONSTANT,
 			getattr(hchan, DW_AT_byte_size)->value, NULL);
 
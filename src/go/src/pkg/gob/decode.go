@@ -706,8 +706,10 @@ func (dec *Decoder) decodeInterface(ityp *reflect.InterfaceType, state *decoderS
 	// Tread carefully; it might not satisfy the interface.
 	setInterfaceValue(ivalue, value)
 	// Copy the representation of the interface value to the target.
-	// This is horribly unsafe and special.
-	*(*[2]uintptr)(unsafe.Pointer(p)) = ivalue.Get()
+	// This is horribly unsafe and special.  The words are stored as
+	// pointers for the collector's write barrier to see them.
+	iv := ivalue.Get()
+	*(*[2]unsafe.Pointer)(unsafe.Pointer(p)) = *(*[2]unsafe.Pointer)(unsafe.Pointer(&iv))
 }
 
 // ignoreInterface discards the data for an interface value with no destination.
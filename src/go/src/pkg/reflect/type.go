@@ -50,6 +50,7 @@ type commonType struct {
 	string     *string
 	*uncommonType
 	ptrToThis *runtime.Type
+	gc        unsafe.Pointer
 }
 
 type method struct {
@@ -151,6 +152,7 @@ type MapType struct {
 	commonType "map"
 	key        *runtime.Type
 	elem       *runtime.Type
+	bucket     unsafe.Pointer
 }
 
 // PtrType represents a pointer type.
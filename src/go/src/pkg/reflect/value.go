@@ -15,8 +15,8 @@ const cannotSet = "cannot set value obtained from unexported struct field"
 
 type addr unsafe.Pointer
 
-// TODO: This will have to go away when
-// the new gc goes in.
+// memmove copies through uintptrs, which the compiler's write
+// barrier does not see, so it tells the collector itself.
 func memmove(adst, asrc addr, n uintptr) {
 	dst := uintptr(adst)
 	src := uintptr(asrc)
@@ -39,8 +39,12 @@ func memmove(adst, asrc addr, n uintptr) {
 			*(*uintptr)(addr(dst + i)) = *(*uintptr)(addr(src + i))
 		}
 	}
+	markdirty(adst, n)
 }
 
+// implemented in ../runtime/reflect.goc
+func markdirty(dst addr, n uintptr)
+
 // Value is the common interface to reflection values.
 // The implementations of Value (e.g., ArrayValue, StructValue)
 // have additional type-specific methods.
@@ -481,8 +485,6 @@ func AppendSlice(s, t *SliceValue) *SliceValue {
 // It returns the number of elements copied.
 // The arrays dst and src must have the same element type.
 func Copy(dst, src ArrayOrSliceValue) int {
-	// TODO: This will have to move into the runtime
-	// once the real gc goes in.
 	de := dst.Type().(ArrayOrSliceType).Elem()
 	se := src.Type().(ArrayOrSliceType).Elem()
 	typesMustMatch(de, se)
@@ -580,6 +582,7 @@ func (v *SliceValue) Set(x *SliceValue) {
 	}
 	typesMustMatch(v.typ, x.typ)
 	*v.slice() = *x.slice()
+	markdirty(v.value.addr, ptrSize)
 }
 
 // Set sets v to the value x.
@@ -660,6 +663,7 @@ func (v *ChanValue) Set(x *ChanValue) {
 	}
 	typesMustMatch(v.typ, x.typ)
 	*(*uintptr)(v.addr) = *(*uintptr)(x.addr)
+	markdirty(v.addr, ptrSize)
 }
 
 // Set sets v to the value x.
@@ -789,6 +793,7 @@ func (v *FuncValue) Set(x *FuncValue) {
 	}
 	typesMustMatch(v.typ, x.typ)
 	*(*uintptr)(v.addr) = *(*uintptr)(x.addr)
+	markdirty(v.addr, ptrSize)
 }
 
 // Set sets v to the value x.
@@ -1027,6 +1032,7 @@ func (v *MapValue) Set(x *MapValue) {
 	}
 	typesMustMatch(v.typ, x.typ)
 	*(*uintptr)(v.addr) = *(*uintptr)(x.addr)
+	markdirty(v.addr, ptrSize)
 }
 
 // Set sets v to the value x.
@@ -1150,9 +1156,8 @@ func (v *PtrValue) Set(x *PtrValue) {
 		panic("cannot copy pointer obtained from unexported struct field")
 	}
 	typesMustMatch(v.typ, x.typ)
-	// TODO: This will have to move into the runtime
-	// once the new gc goes in
 	*(*uintptr)(v.addr) = *(*uintptr)(x.addr)
+	markdirty(v.addr, ptrSize)
 }
 
 // Set sets v to the value x.
@@ -1175,9 +1180,8 @@ func (v *PtrValue) PointTo(x Value) {
 		panic("cannot set x; cannot point to x")
 	}
 	typesMustMatch(v.typ.(*PtrType).Elem(), x.Type())
-	// TODO: This will have to move into the runtime
-	// once the new gc goes in.
 	*(*uintptr)(v.addr) = x.UnsafeAddr()
+	markdirty(v.addr, ptrSize)
 }
 
 // Elem returns the value that v points to.
@@ -1215,8 +1219,6 @@ type StructValue struct {
 // Set assigns x to v.
 // The new value x must have the same type as v.
 func (v *StructValue) Set(x *StructValue) {
-	// TODO: This will have to move into the runtime
-	// once the gc goes in.
 	if !v.CanSet() {
 		panic(cannotSet)
 	}
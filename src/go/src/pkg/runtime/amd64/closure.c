@@ -40,7 +40,7 @@ runtime·closure(int32 siz, byte *fn, byte *arg0)
 	if(n%8)
 		n += 8 - n%8;
 
-	p = runtime·mal(n);
+	p = runtime·malclosure(n, siz);
 	*ret = p;
 	q = p + n - siz;
 
@@ -73,7 +73,7 @@ runtime·closure(int32 siz, byte *fn, byte *arg0)
 	// store args aligned after code, so gc can find them.
 	n += siz;
 
-	p = runtime·mal(n);
+	p = runtime·malclosure(n, siz);
 	*ret = p;
 	q = p + n - siz;
 
@@ -3,24 +3,25 @@
 // license that can be found in the LICENSE file.
 
 #include "runtime.h"
+#include "malloc.h"
 #include "type.h"
 
 static	int32	debug	= 0;
 
-typedef	struct	Link	Link;
 typedef	struct	WaitQ	WaitQ;
 typedef	struct	SudoG	SudoG;
 typedef	struct	Select	Select;
 typedef	struct	Scase	Scase;
 
+// A SudoG is a goroutine waiting on a channel.  It lives on the
+// waiting goroutine's stack, or in its Select, and stays valid
+// until the goroutine is woken and has dequeued it.
 struct	SudoG
 {
 	G*	g;		// g and selgen constitute
 	uint32	selgen;		// a weak pointer to g
-	int16	offset;		// offset of case number
-	int8	isfree;		// offset of case number
 	SudoG*	link;
-	byte	elem[8];	// synch data element (+ more)
+	byte*	elem;		// data element, read by a receiver or written by a sender
 };
 
 struct	WaitQ
@@ -29,28 +30,32 @@ struct	WaitQ
 	SudoG*	last;
 };
 
+// The buffer of an asynchronous channel is a ring of mask+1 slots,
+// mask+1 being dataqsiz rounded up to a power of two.  Senders and
+// receivers claim positions in it with a cas on sendx and recvx, without
+// taking the lock.  The sequence number of each slot says whose turn it
+// is: a slot with seq == pos is free for the send at position pos, and one
+// with seq == pos+1 holds the element for the receive at pos.  The lock
+// only protects the wait queues, and goroutines only queue up when the
+// buffer is full or empty.  See bufsend and asynch in chansend.
 struct	Hchan
 {
-	uint32	qcount;			// total data in the q
-	uint32	dataqsiz;		// size of the circular q
+	uint32	sendx;			// next send position
+	uint32	dataqsiz;		// size of the circular q - must be second (cap)
+	uint32	recvx;			// next receive position
+	uint32	mask;			// number of slots - 1
+	uint32	nwait;			// goroutines queued on a buffered channel
 	uint16	elemsize;
 	bool	closed;
 	uint8	elemalign;
 	Alg*	elemalg;		// interface for element type
-	Link*	senddataq;		// pointer for sender
-	Link*	recvdataq;		// pointer for receiver
+	uint32*	seq;			// slot sequence numbers
+	byte*	buf;			// slot elements
 	WaitQ	recvq;			// list of recv waiters
 	WaitQ	sendq;			// list of send waiters
-	SudoG*	free;			// freelist
 	Lock;
 };
 
-struct	Link
-{
-	Link*	link;			// asynch queue circular linked list
-	byte	elem[8];		// asynch queue data element (+ more)
-};
-
 enum
 {
 	// Scase.kind
@@ -61,33 +66,31 @@ enum
 
 struct	Scase
 {
+	SudoG	sg;			// must be first member (cast from Scase)
 	Hchan*	chan;			// chan
 	byte*	pc;			// return pc
 	uint16	kind;
 	uint16	so;			// vararg of selected bool
-	union {
-		byte	elem[2*sizeof(void*)];	// element (send)
-		struct {
-			byte*	elemp;		// pointer to element (recv)
-			bool*	receivedp;	// pointer to received bool (recv2)
-		} recv;
-	} u;
+	bool*	receivedp;		// pointer to received bool (recv2)
 };
 
+// The compiler allocates a Select on the stack of the function
+// containing the select statement, followed by its lockorder and
+// pollorder arrays.  Keep selectsize in ../../cmd/gc/select.c in sync.
 struct	Select
 {
 	uint16	tcase;			// total count of scase[]
 	uint16	ncase;			// currently filled scase[]
-	Select*	link;			// for freelist
-	uint16*	order;
-	Scase*	scase[1];		// one per case
+	uint16*	pollorder;		// case poll order
+	Hchan**	lockorder;		// channel lock order
+	Scase	scase[1];		// one per case (in order of appearance)
 };
 
-static	void	dequeueg(WaitQ*, Hchan*);
+static	void	dequeuesg(WaitQ*, Hchan*, SudoG*);
 static	SudoG*	dequeue(WaitQ*, Hchan*);
-static	void	enqueue(WaitQ*, SudoG*);
-static	SudoG*	allocsg(Hchan*);
-static	void	freesg(Hchan*, SudoG*);
+static	void	enqueue(WaitQ*, Hchan*, SudoG*);
+static	void	wakeup(Hchan*, WaitQ*);
+static	void	wakeuplocked(Hchan*, WaitQ*);
 static	uint32	fastrandn(uint32);
 static	void	destroychan(Hchan*);
 
@@ -95,7 +98,8 @@ Hchan*
 runtime·makechan_c(Type *elem, int64 hint)
 {
 	Hchan *c;
-	int32 i;
+	uint32 i, n;
+	uintptr off;
 
 	if(hint < 0 || (int32)hint != hint || hint > ((uintptr)-1) / elem->size)
 		runtime·panicstring("makechan: size out of range");
@@ -105,7 +109,21 @@ runtime·makechan_c(Type *elem, int64 hint)
 		runtime·throw("runtime.makechan: unsupported elem type");
 	}
 
-	c = runtime·mal(sizeof(*c));
+	// allocate the sequence numbers of the slots together with
+	// the channel, and the slots with their type, so that the
+	// garbage collector finds the pointers they hold.
+	// bufrecv needs at least two to tell a slot it just
+	// emptied from one that is ready for the next lap.
+	n = 0;
+	off = sizeof(*c);
+	if(hint > 0) {
+		for(n=2; n<hint; n<<=1)
+			;
+		if(n > ((uintptr)-1) / elem->size)
+			runtime·panicstring("makechan: size out of range");
+		off = sizeof(*c) + n*sizeof(c->seq[0]);
+	}
+	c = runtime·mal(off);
 	runtime·addfinalizer(c, destroychan, 0);
 
 	c->elemsize = elem->size;
@@ -113,22 +131,11 @@ runtime·makechan_c(Type *elem, int64 hint)
 	c->elemalign = elem->align;
 
 	if(hint > 0) {
-		Link *d, *b, *e;
-
-		// make a circular q
-		b = nil;
-		e = nil;
-		for(i=0; i<hint; i++) {
-			d = runtime·mal(sizeof(*d) + c->elemsize - sizeof(d->elem));
-			if(e == nil)
-				e = d;
-			d->link = b;
-			b = d;
-		}
-		e->link = b;
-		c->recvdataq = b;
-		c->senddataq = b;
-		c->qcount = 0;
+		c->seq = (uint32*)(c+1);
+		c->buf = runtime·cnew(elem, n);
+		for(i=0; i<n; i++)
+			c->seq[i] = i;
+		c->mask = n-1;
 		c->dataqsiz = hint;
 	}
 
@@ -154,6 +161,78 @@ runtime·makechan(Type *elem, int64 hint, Hchan *ret)
 	FLUSH(&ret);
 }
 
+// Copy the element at ep into the buffer of c, without taking the lock.
+// Returns false if the buffer is full.  Ends with a full memory barrier,
+// so that a sender that then finds c->nwait == 0 knows that any receiver
+// that queued up afterwards will see the element (see asynch in chanrecv).
+static bool
+bufsend(Hchan *c, byte *ep)
+{
+	uint32 pos, seq;
+
+	for(;;) {
+		pos = c->sendx;
+		seq = c->seq[pos & c->mask];
+		if(seq == pos) {
+			if((int32)(pos - c->recvx) >= (int32)c->dataqsiz)
+				return false;
+			if(runtime·cas(&c->sendx, pos, pos+1))
+				break;
+		} else if((int32)(seq - pos) < 0)
+			return false;	// slot still holds the element from the last lap
+		// else another sender claimed pos; retry
+	}
+	c->elemalg->copy(c->elemsize, c->buf + (pos & c->mask)*c->elemsize, ep);
+	runtime·cas(&c->seq[pos & c->mask], pos, pos+1);	// cannot fail
+	return true;
+}
+
+// Move the next element of the buffer of c to ep, without taking
+// the lock.  Returns false if the buffer is empty.  Like bufsend,
+// ends with a full memory barrier.
+static bool
+bufrecv(Hchan *c, byte *ep)
+{
+	uint32 pos, seq;
+	byte *e;
+
+	for(;;) {
+		pos = c->recvx;
+		seq = c->seq[pos & c->mask];
+		if(seq == pos+1) {
+			if(runtime·cas(&c->recvx, pos, pos+1))
+				break;
+		} else if((int32)(seq - (pos+1)) < 0)
+			return false;	// slot not yet written
+		// else another receiver claimed pos; retry
+	}
+	e = c->buf + (pos & c->mask)*c->elemsize;
+	if(ep != nil)
+		c->elemalg->copy(c->elemsize, ep, e);
+	c->elemalg->copy(c->elemsize, e, nil);
+	runtime·cas(&c->seq[pos & c->mask], pos+1, pos+c->mask+1);	// free for the next lap; cannot fail
+	return true;
+}
+
+// Report whether bufsend or bufrecv would succeed now.
+static bool
+bufcansend(Hchan *c)
+{
+	uint32 pos;
+
+	pos = c->sendx;
+	return c->seq[pos & c->mask] == pos && (int32)(pos - c->recvx) < (int32)c->dataqsiz;
+}
+
+static bool
+bufcanrecv(Hchan *c)
+{
+	uint32 pos;
+
+	pos = c->recvx;
+	return c->seq[pos & c->mask] == pos+1;
+}
+
 /*
  * generic single channel send/recv
  * if the bool pointer is nil,
@@ -172,6 +251,7 @@ void
 runtime·chansend(Hchan *c, byte *ep, bool *pres)
 {
 	SudoG *sg;
+	SudoG mysg;
 	G* gp;
 
 	if(c == nil)
@@ -186,17 +266,24 @@ runtime·chansend(Hchan *c, byte *ep, bool *pres)
 		runtime·prints("\n");
 	}
 
+	if(c->dataqsiz > 0)
+		goto asynch;
+
+	// Fail a non-blocking send without the lock
+	// if there is obviously no receiver.
+	if(pres != nil && !c->closed && c->recvq.first == nil) {
+		*pres = false;
+		return;
+	}
+
 	runtime·lock(c);
 loop:
 	if(c->closed)
 		goto closed;
 
-	if(c->dataqsiz > 0)
-		goto asynch;
-
 	sg = dequeue(&c->recvq, c);
 	if(sg != nil) {
-		if(ep != nil)
+		if(sg->elem != nil)
 			c->elemalg->copy(c->elemsize, sg->elem, ep);
 
 		gp = sg->g;
@@ -215,58 +302,55 @@ loop:
 		return;
 	}
 
-	sg = allocsg(c);
-	if(ep != nil)
-		c->elemalg->copy(c->elemsize, sg->elem, ep);
+	mysg.elem = ep;
+	mysg.g = g;
+	mysg.selgen = g->selgen;
 	g->param = nil;
 	g->status = Gwaiting;
-	enqueue(&c->sendq, sg);
+	enqueue(&c->sendq, c, &mysg);
 	runtime·unlock(c);
 	runtime·gosched();
 
-	runtime·lock(c);
-	sg = g->param;
-	if(sg == nil)
+	if(g->param == nil) {
+		runtime·lock(c);
 		goto loop;
-	freesg(c, sg);
-	runtime·unlock(c);
+	}
 	return;
 
 asynch:
 	if(c->closed)
-		goto closed;
+		runtime·panicstring("send on closed channel");
 
-	if(c->qcount >= c->dataqsiz) {
-		if(pres != nil) {
-			runtime·unlock(c);
-			*pres = false;
-			return;
-		}
-		sg = allocsg(c);
-		g->status = Gwaiting;
-		enqueue(&c->sendq, sg);
-		runtime·unlock(c);
-		runtime·gosched();
+	if(bufsend(c, ep)) {
+		if(c->nwait != 0)
+			wakeup(c, &c->recvq);
+		if(pres != nil)
+			*pres = true;
+		return;
+	}
 
-		runtime·lock(c);
-		goto asynch;
+	if(pres != nil) {
+		*pres = false;
+		return;
 	}
-	if(ep != nil)
-		c->elemalg->copy(c->elemsize, c->senddataq->elem, ep);
-	c->senddataq = c->senddataq->link;
-	c->qcount++;
 
-	sg = dequeue(&c->recvq, c);
-	if(sg != nil) {
-		gp = sg->g;
-		freesg(c, sg);
-		runtime·unlock(c);
-		runtime·ready(gp);
-	} else
+	// The buffer is full.  Queue up, then look again in case
+	// a receiver made room without seeing us.  Either it sees
+	// c->nwait != 0 and wakes us, or we see the room.
+	runtime·lock(c);
+	mysg.elem = nil;
+	mysg.g = g;
+	mysg.selgen = g->selgen;
+	enqueue(&c->sendq, c, &mysg);
+	if(c->closed || bufcansend(c)) {
+		dequeuesg(&c->sendq, c, &mysg);
 		runtime·unlock(c);
-	if(pres != nil)
-		*pres = true;
-	return;
+		goto asynch;
+	}
+	g->status = Gwaiting;
+	runtime·unlock(c);
+	runtime·gosched();
+	goto asynch;
 
 closed:
 	runtime·unlock(c);
@@ -277,7 +361,9 @@ void
 runtime·chanrecv(Hchan* c, byte *ep, bool *selected, bool *received)
 {
 	SudoG *sg;
+	SudoG mysg;
 	G *gp;
+	bool closed;
 
 	if(c == nil)
 		runtime·panicstring("receive from nil channel");
@@ -288,12 +374,18 @@ runtime·chanrecv(Hchan* c, byte *ep, bool *selected, bool *received)
 	if(debug)
 		runtime·printf("chanrecv: chan=%p\n", c);
 
-	runtime·lock(c);
-
-loop:
 	if(c->dataqsiz > 0)
 		goto asynch;
 
+	// Fail a non-blocking receive without the lock
+	// if there is obviously no sender.
+	if(selected != nil && !c->closed && c->sendq.first == nil) {
+		*selected = false;
+		return;
+	}
+
+	runtime·lock(c);
+loop:
 	if(c->closed)
 		goto closed;
 
@@ -301,7 +393,6 @@ loop:
 	if(sg != nil) {
 		if(ep != nil)
 			c->elemalg->copy(c->elemsize, ep, sg->elem);
-		c->elemalg->copy(c->elemsize, sg->elem, nil);
 
 		gp = sg->g;
 		gp->param = sg;
@@ -321,65 +412,64 @@ loop:
 		return;
 	}
 
-	sg = allocsg(c);
+	mysg.elem = ep;
+	mysg.g = g;
+	mysg.selgen = g->selgen;
 	g->param = nil;
 	g->status = Gwaiting;
-	enqueue(&c->recvq, sg);
+	enqueue(&c->recvq, c, &mysg);
 	runtime·unlock(c);
 	runtime·gosched();
 
-	runtime·lock(c);
-	sg = g->param;
-	if(sg == nil)
+	if(g->param == nil) {
+		runtime·lock(c);
 		goto loop;
+	}
 
-	if(ep != nil)
-		c->elemalg->copy(c->elemsize, ep, sg->elem);
-	c->elemalg->copy(c->elemsize, sg->elem, nil);
 	if(received != nil)
 		*received = true;
-	freesg(c, sg);
-	runtime·unlock(c);
 	return;
 
 asynch:
-	if(c->qcount <= 0) {
-		if(c->closed)
-			goto closed;
-
-		if(selected != nil) {
-			runtime·unlock(c);
-			*selected = false;
-			return;
-		}
-		sg = allocsg(c);
-		g->status = Gwaiting;
-		enqueue(&c->recvq, sg);
-		runtime·unlock(c);
-		runtime·gosched();
+	// Read closed before the buffer: the sends that
+	// happened before the close are in it by then.
+	closed = c->closed;
+	if(bufrecv(c, ep)) {
+		if(c->nwait != 0)
+			wakeup(c, &c->sendq);
+		if(selected != nil)
+			*selected = true;
+		if(received != nil)
+			*received = true;
+		return;
+	}
 
+	if(closed) {
 		runtime·lock(c);
-		goto asynch;
+		goto closed;
 	}
-	if(ep != nil)
-		c->elemalg->copy(c->elemsize, ep, c->recvdataq->elem);
-	c->elemalg->copy(c->elemsize, c->recvdataq->elem, nil);
-	c->recvdataq = c->recvdataq->link;
-	c->qcount--;
-	sg = dequeue(&c->sendq, c);
-	if(sg != nil) {
-		gp = sg->g;
-		freesg(c, sg);
-		runtime·unlock(c);
-		runtime·ready(gp);
-	} else
-		runtime·unlock(c);
 
-	if(selected != nil)
-		*selected = true;
-	if(received != nil)
-		*received = true;
-	return;
+	if(selected != nil) {
+		*selected = false;
+		return;
+	}
+
+	// The buffer is empty.  Queue up, then look again;
+	// see asynch in chansend.
+	runtime·lock(c);
+	mysg.elem = nil;
+	mysg.g = g;
+	mysg.selgen = g->selgen;
+	enqueue(&c->recvq, c, &mysg);
+	if(c->closed || bufcanrecv(c)) {
+		dequeuesg(&c->recvq, c, &mysg);
+		runtime·unlock(c);
+		goto asynch;
+	}
+	g->status = Gwaiting;
+	runtime·unlock(c);
+	runtime·gosched();
+	goto asynch;
 
 closed:
 	if(ep != nil)
@@ -526,49 +616,41 @@ runtime·selectnbrecv2(byte *v, bool *received, Hchan *c, bool selected)
 	runtime·chanrecv(c, v, &selected, received);
 }	
 
-static void newselect(int32, Select**);
-
-// newselect(size uint32) (sel *byte);
-#pragma textflag 7
-void
-runtime·newselect(int32 size, ...)
-{
-	int32 o;
-	Select **selp;
-
-	o = runtime·rnd(sizeof(size), Structrnd);
-	selp = (Select**)((byte*)&size + o);
-	newselect(size, selp);
-}
-
-static void
-newselect(int32 size, Select **selp)
+static uintptr
+selectsize(int32 size)
 {
-	int32 n;
-	Select *sel;
+	uintptr n;
 
 	n = 0;
 	if(size > 1)
 		n = size-1;
+	return sizeof(Select) + n*sizeof(Scase) + size*sizeof(Hchan*) + size*sizeof(uint16);
+}
 
-	sel = runtime·mal(sizeof(*sel) + n*sizeof(sel->scase[0]) + size*sizeof(sel->order[0]));
-
+// newselect(sel *byte, selsize int64, size int32);
+void
+runtime·newselect(Select *sel, int64 selsize, int32 size)
+{
+	if(selsize != selectsize(size)) {
+		runtime·printf("runtime: bad select size %D, want %D\n", selsize, (int64)selectsize(size));
+		runtime·throw("bad select size");
+	}
 	sel->tcase = size;
 	sel->ncase = 0;
-	sel->order = (void*)(sel->scase + size);
-	*selp = sel;
+	sel->lockorder = (void*)(sel->scase + size);
+	sel->pollorder = (void*)(sel->lockorder + size);
+
 	if(debug)
 		runtime·printf("newselect s=%p size=%d\n", sel, size);
 }
 
-// selectsend(sel *byte, hchan *chan any, elem any) (selected bool);
+// selectsend(sel *byte, hchan *chan any, elem *any) (selected bool);
 #pragma textflag 7
 void
-runtime·selectsend(Select *sel, Hchan *c, ...)
+runtime·selectsend(Select *sel, Hchan *c, void *elem, bool selected)
 {
-	int32 i, eo;
+	int32 i;
 	Scase *cas;
-	byte *ae;
 
 	// nil cases do not compete
 	if(c == nil)
@@ -578,19 +660,14 @@ runtime·selectsend(Select *sel, Hchan *c, ...)
 	if(i >= sel->tcase)
 		runtime·throw("selectsend: too many cases");
 	sel->ncase = i+1;
-	cas = runtime·mal(sizeof *cas + c->elemsize - sizeof(cas->u.elem));
-	sel->scase[i] = cas;
+	cas = &sel->scase[i];
 
 	cas->pc = runtime·getcallerpc(&sel);
 	cas->chan = c;
-
-	eo = runtime·rnd(sizeof(sel), sizeof(c));
-	eo = runtime·rnd(eo+sizeof(c), c->elemsize);
-	cas->so = runtime·rnd(eo+c->elemsize, Structrnd);
+	cas->so = (byte*)&selected - (byte*)&sel;
 	cas->kind = CaseSend;
-
-	ae = (byte*)&sel + eo;
-	c->elemalg->copy(c->elemsize, cas->u.elem, ae);
+	cas->sg.elem = elem;
+	runtime·markdirty(cas, sizeof *cas);
 
 	if(debug)
 		runtime·printf("selectsend s=%p pc=%p chan=%p so=%d\n",
@@ -613,15 +690,15 @@ runtime·selectrecv(Select *sel, Hchan *c, void *elem, bool selected)
 	if(i >= sel->tcase)
 		runtime·throw("selectrecv: too many cases");
 	sel->ncase = i+1;
-	cas = runtime·mal(sizeof *cas);
-	sel->scase[i] = cas;
+	cas = &sel->scase[i];
 	cas->pc = runtime·getcallerpc(&sel);
 	cas->chan = c;
 
 	cas->so = (byte*)&selected - (byte*)&sel;
 	cas->kind = CaseRecv;
-	cas->u.recv.elemp = elem;
-	cas->u.recv.receivedp = nil;
+	cas->sg.elem = elem;
+	cas->receivedp = nil;
+	runtime·markdirty(cas, sizeof *cas);
 
 	if(debug)
 		runtime·printf("selectrecv s=%p pc=%p chan=%p so=%d\n",
@@ -644,34 +721,26 @@ runtime·selectrecv2(Select *sel, Hchan *c, void *elem, bool *received, bool sel
 	if(i >= sel->tcase)
 		runtime·throw("selectrecv: too many cases");
 	sel->ncase = i+1;
-	cas = runtime·mal(sizeof *cas);
-	sel->scase[i] = cas;
+	cas = &sel->scase[i];
 	cas->pc = runtime·getcallerpc(&sel);
 	cas->chan = c;
 
 	cas->so = (byte*)&selected - (byte*)&sel;
 	cas->kind = CaseRecv;
-	cas->u.recv.elemp = elem;
-	cas->u.recv.receivedp = received;
+	cas->sg.elem = elem;
+	cas->receivedp = received;
+	runtime·markdirty(cas, sizeof *cas);
 
 	if(debug)
 		runtime·printf("selectrecv2 s=%p pc=%p chan=%p so=%d elem=%p recv=%p\n",
-			sel, cas->pc, cas->chan, cas->so, cas->u.recv.elemp, cas->u.recv.receivedp);
+			sel, cas->pc, cas->chan, cas->so, cas->sg.elem, cas->receivedp);
 }
 
 
-static void selectdefault(Select*, void*, int32);
-
 // selectdefault(sel *byte) (selected bool);
 #pragma textflag 7
 void
 runtime·selectdefault(Select *sel, bool selected)
-{
-	selectdefault(sel, runtime·getcallerpc(&sel), (byte*)&selected - (byte*)&sel);
-}
-
-static void
-selectdefault(Select *sel, void *callerpc, int32 so)
 {
 	int32 i;
 	Scase *cas;
@@ -680,12 +749,11 @@ selectdefault(Select *sel, void *callerpc, int32 so)
 	if(i >= sel->tcase)
 		runtime·throw("selectdefault: too many cases");
 	sel->ncase = i+1;
-	cas = runtime·mal(sizeof *cas);
-	sel->scase[i] = cas;
-	cas->pc = callerpc;
+	cas = &sel->scase[i];
+	cas->pc = runtime·getcallerpc(&sel);
 	cas->chan = nil;
 
-	cas->so = so;
+	cas->so = (byte*)&selected - (byte*)&sel;
 	cas->kind = CaseDefault;
 
 	if(debug)
@@ -693,26 +761,17 @@ selectdefault(Select *sel, void *callerpc, int32 so)
 			sel, cas->pc, cas->so);
 }
 
-static void
-freesel(Select *sel)
-{
-	uint32 i;
-
-	for(i=0; i<sel->ncase; i++)
-		runtime·free(sel->scase[i]);
-	runtime·free(sel);
-}
-
 static void
 sellock(Select *sel)
 {
 	uint32 i;
-	Hchan *c;
+	Hchan *c, *c0;
 
 	c = nil;
 	for(i=0; i<sel->ncase; i++) {
-		if(sel->scase[i]->chan != c) {
-			c = sel->scase[i]->chan;
+		c0 = sel->lockorder[i];
+		if(c0 && c0 != c) {
+			c = c0;
 			runtime·lock(c);
 		}
 	}
@@ -722,12 +781,13 @@ static void
 selunlock(Select *sel)
 {
 	uint32 i;
-	Hchan *c;
+	Hchan *c, *c0;
 
 	c = nil;
 	for(i=sel->ncase; i>0; i--) {
-		if(sel->scase[i-1]->chan && sel->scase[i-1]->chan != c) {
-			c = sel->scase[i-1]->chan;
+		c0 = sel->lockorder[i-1];
+		if(c0 && c0 != c) {
+			c = c0;
 			runtime·unlock(c);
 		}
 	}
@@ -763,7 +823,7 @@ selectgo(Select **selp)
 	SudoG *sg;
 	G *gp;
 	byte *as;
-	void *pc;
+	bool closed, ready;
 
 	sel = *selp;
 	if(runtime·gcwaiting)
@@ -782,20 +842,20 @@ selectgo(Select **selp)
 
 	// generate permuted order
 	for(i=0; i<sel->ncase; i++)
-		sel->order[i] = i;
+		sel->pollorder[i] = i;
 	for(i=1; i<sel->ncase; i++) {
-		o = sel->order[i];
+		o = sel->pollorder[i];
 		j = fastrandn(i+1);
-		sel->order[i] = sel->order[j];
-		sel->order[j] = o;
+		sel->pollorder[i] = sel->pollorder[j];
+		sel->pollorder[j] = o;
 	}
 
 	// sort the cases by Hchan address to get the locking order.
-	for(i=1; i<sel->ncase; i++) {
-		cas = sel->scase[i];
-		for(j=i; j>0 && sel->scase[j-1]->chan >= cas->chan; j--)
-			sel->scase[j] = sel->scase[j-1];
-		sel->scase[j] = cas;
+	for(i=0; i<sel->ncase; i++) {
+		c = sel->scase[i].chan;
+		for(j=i; j>0 && sel->lockorder[j-1] >= c; j--)
+			sel->lockorder[j] = sel->lockorder[j-1];
+		sel->lockorder[j] = c;
 	}
 	sellock(sel);
 
@@ -803,20 +863,24 @@ loop:
 	// pass 1 - look for something already waiting
 	dfl = nil;
 	for(i=0; i<sel->ncase; i++) {
-		o = sel->order[i];
-		cas = sel->scase[o];
+		o = sel->pollorder[i];
+		cas = &sel->scase[o];
 		c = cas->chan;
 
 		switch(cas->kind) {
 		case CaseRecv:
 			if(c->dataqsiz > 0) {
-				if(c->qcount > 0)
+				// read closed first, see asynch in chanrecv
+				closed = c->closed;
+				if(bufrecv(c, cas->sg.elem))
 					goto asyncrecv;
-			} else {
-				sg = dequeue(&c->sendq, c);
-				if(sg != nil)
-					goto syncrecv;
+				if(closed)
+					goto rclose;
+				break;
 			}
+			sg = dequeue(&c->sendq, c);
+			if(sg != nil)
+				goto syncrecv;
 			if(c->closed)
 				goto rclose;
 			break;
@@ -825,7 +889,7 @@ loop:
 			if(c->closed)
 				goto sclose;
 			if(c->dataqsiz > 0) {
-				if(c->qcount < c->dataqsiz)
+				if(bufsend(c, cas->sg.elem))
 					goto asyncsend;
 			} else {
 				sg = dequeue(&c->recvq, c);
@@ -848,51 +912,66 @@ loop:
 
 	// pass 2 - enqueue on all chans
 	for(i=0; i<sel->ncase; i++) {
-		o = sel->order[i];
-		cas = sel->scase[o];
+		o = sel->pollorder[i];
+		cas = &sel->scase[o];
 		c = cas->chan;
-		sg = allocsg(c);
-		sg->offset = o;
+		sg = &cas->sg;
+		sg->g = g;
+		sg->selgen = g->selgen;
 
 		switch(cas->kind) {
 		case CaseRecv:
-			enqueue(&c->recvq, sg);
+			enqueue(&c->recvq, c, sg);
 			break;
-		
+
 		case CaseSend:
-			if(c->dataqsiz == 0)
-				c->elemalg->copy(c->elemsize, sg->elem, cas->u.elem);
-			enqueue(&c->sendq, sg);
+			enqueue(&c->sendq, c, sg);
 			break;
 		}
 	}
 
-	g->param = nil;
-	g->status = Gwaiting;
-	selunlock(sel);
-	runtime·gosched();
+	// look again at the buffered channels, in case an operation
+	// that did not take the lock changed them before we queued up.
+	// see asynch in chansend.
+	ready = false;
+	for(i=0; i<sel->ncase; i++) {
+		cas = &sel->scase[i];
+		c = cas->chan;
+		if(c->dataqsiz == 0)
+			continue;
+		if(c->closed ||
+		   (cas->kind == CaseRecv && bufcanrecv(c)) ||
+		   (cas->kind == CaseSend && bufcansend(c)))
+			ready = true;
+	}
 
-	sellock(sel);
+	if(!ready) {
+		g->param = nil;
+		g->status = Gwaiting;
+		selunlock(sel);
+		runtime·gosched();
+
+		sellock(sel);
+	}
 	sg = g->param;
 
 	// pass 3 - dequeue from unsuccessful chans
 	// otherwise they stack up on quiet channels
 	for(i=0; i<sel->ncase; i++) {
-		if(sg == nil || i != sg->offset) {
-			cas = sel->scase[i];
+		cas = &sel->scase[i];
+		if(ready || sg != &cas->sg) {
 			c = cas->chan;
 			if(cas->kind == CaseSend)
-				dequeueg(&c->sendq, c);
+				dequeuesg(&c->sendq, c, &cas->sg);
 			else
-				dequeueg(&c->recvq, c);
+				dequeuesg(&c->recvq, c, &cas->sg);
 		}
 	}
 
-	if(sg == nil)
+	if(ready || sg == nil)
 		goto loop;
 
-	o = sg->offset;
-	cas = sel->scase[o];
+	cas = (Scase*)sg;
 	c = cas->chan;
 
 	if(c->dataqsiz > 0) {
@@ -901,60 +980,39 @@ loop:
 	}
 
 	if(debug)
-		runtime·printf("wait-return: sel=%p c=%p cas=%p kind=%d o=%d\n",
-			sel, c, cas, cas->kind, o);
+		runtime·printf("wait-return: sel=%p c=%p cas=%p kind=%d\n",
+			sel, c, cas, cas->kind);
 
+	// the other side copied the element
 	if(cas->kind == CaseRecv) {
-		if(cas->u.recv.receivedp != nil)
-			*cas->u.recv.receivedp = true;
-		if(cas->u.recv.elemp != nil)
-			c->elemalg->copy(c->elemsize, cas->u.recv.elemp, sg->elem);
-		c->elemalg->copy(c->elemsize, sg->elem, nil);
+		if(cas->receivedp != nil)
+			*cas->receivedp = true;
 	}
 
-	freesg(c, sg);
 	goto retc;
 
 asyncrecv:
-	// can receive from buffer
-	if(cas->u.recv.receivedp != nil)
-		*cas->u.recv.receivedp = true;
-	if(cas->u.recv.elemp != nil)
-		c->elemalg->copy(c->elemsize, cas->u.recv.elemp, c->recvdataq->elem);
-	c->elemalg->copy(c->elemsize, c->recvdataq->elem, nil);
-	c->recvdataq = c->recvdataq->link;
-	c->qcount--;
-	sg = dequeue(&c->sendq, c);
-	if(sg != nil) {
-		gp = sg->g;
-		freesg(c, sg);
-		runtime·ready(gp);
-	}
+	// received from buffer
+	if(cas->receivedp != nil)
+		*cas->receivedp = true;
+	if(c->nwait != 0)
+		wakeuplocked(c, &c->sendq);
 	goto retc;
 
 asyncsend:
-	// can send to buffer
-	if(cas->u.elem != nil)
-		c->elemalg->copy(c->elemsize, c->senddataq->elem, cas->u.elem);
-	c->senddataq = c->senddataq->link;
-	c->qcount++;
-	sg = dequeue(&c->recvq, c);
-	if(sg != nil) {
-		gp = sg->g;
-		freesg(c, sg);
-		runtime·ready(gp);
-	}
+	// sent to buffer
+	if(c->nwait != 0)
+		wakeuplocked(c, &c->recvq);
 	goto retc;
 
 syncrecv:
 	// can receive from sleeping sender (sg)
 	if(debug)
 		runtime·printf("syncrecv: sel=%p c=%p o=%d\n", sel, c, o);
-	if(cas->u.recv.receivedp != nil)
-		*cas->u.recv.receivedp = true;
-	if(cas->u.recv.elemp != nil)
-		c->elemalg->copy(c->elemsize, cas->u.recv.elemp, sg->elem);
-	c->elemalg->copy(c->elemsize, sg->elem, nil);
+	if(cas->receivedp != nil)
+		*cas->receivedp = true;
+	if(cas->sg.elem != nil)
+		c->elemalg->copy(c->elemsize, cas->sg.elem, sg->elem);
 	gp = sg->g;
 	gp->param = sg;
 	runtime·ready(gp);
@@ -962,10 +1020,10 @@ syncrecv:
 
 rclose:
 	// read at end of closed channel
-	if(cas->u.recv.receivedp != nil)
-		*cas->u.recv.receivedp = false;
-	if(cas->u.recv.elemp != nil)
-		c->elemalg->copy(c->elemsize, cas->u.recv.elemp, nil);
+	if(cas->receivedp != nil)
+		*cas->receivedp = false;
+	if(cas->sg.elem != nil)
+		c->elemalg->copy(c->elemsize, cas->sg.elem, nil);
 	goto retc;
 
 syncsend:
@@ -974,7 +1032,8 @@ syncsend:
 		runtime·printf("syncsend: sel=%p c=%p o=%d\n", sel, c, o);
 	if(c->closed)
 		goto sclose;
-	c->elemalg->copy(c->elemsize, sg->elem, cas->u.elem);
+	if(sg->elem != nil)
+		c->elemalg->copy(c->elemsize, sg->elem, cas->sg.elem);
 	gp = sg->g;
 	gp->param = sg;
 	runtime·ready(gp);
@@ -983,11 +1042,9 @@ retc:
 	selunlock(sel);
 
 	// return to pc corresponding to chosen case
-	pc = cas->pc;
 	as = (byte*)selp + cas->so;
-	freesel(sel);
 	*as = true;
-	return pc;
+	return cas->pc;
 
 sclose:
 	// send on closed channel
@@ -1021,7 +1078,6 @@ runtime·closechan(Hchan *c)
 			break;
 		gp = sg->g;
 		gp->param = nil;
-		freesg(c, sg);
 		runtime·ready(gp);
 	}
 
@@ -1032,7 +1088,6 @@ runtime·closechan(Hchan *c)
 			break;
 		gp = sg->g;
 		gp->param = nil;
-		freesg(c, sg);
 		runtime·ready(gp);
 	}
 
@@ -1048,7 +1103,24 @@ runtime·chanclose(Hchan *c)
 int32
 runtime·chanlen(Hchan *c)
 {
-	return c->qcount;
+	int32 n;
+
+	if(c == nil || c->dataqsiz == 0)
+		return 0;
+	n = c->sendx - c->recvx;
+	if(n < 0)
+		n = 0;	// read a stale sendx
+	if(n > c->dataqsiz)
+		n = c->dataqsiz;
+	return n;
+}
+
+// lenchan(hchan any) (len int);
+void
+runtime·lenchan(Hchan *c, int32 len)
+{
+	len = runtime·chanlen(c);
+	FLUSH(&len);
 }
 
 int32
@@ -1067,11 +1139,12 @@ loop:
 	if(sgp == nil)
 		return nil;
 	q->first = sgp->link;
+	if(c->dataqsiz > 0)
+		runtime·xadd(&c->nwait, -1);
 
 	// if sgp is stale, ignore it
 	if(!runtime·cas(&sgp->g->selgen, sgp->selgen, sgp->selgen + 1)) {
 		//prints("INVALID PSEUDOG POINTER\n");
-		freesg(c, sgp);
 		goto loop;
 	}
 
@@ -1079,22 +1152,31 @@ loop:
 }
 
 static void
-dequeueg(WaitQ *q, Hchan *c)
+dequeuesg(WaitQ *q, Hchan *c, SudoG *sg)
 {
-	SudoG **l, *sgp;
-	
+	SudoG **l, *sgp, *prev;
+
+	prev = nil;
 	for(l=&q->first; (sgp=*l) != nil; l=&sgp->link) {
-		if(sgp->g == g) {
+		if(sgp == sg) {
 			*l = sgp->link;
-			freesg(c, sgp);
+			if(q->last == sgp)
+				q->last = prev;
+			if(c->dataqsiz > 0)
+				runtime·xadd(&c->nwait, -1);
 			break;
 		}
+		prev = sgp;
 	}
 }
 
 static void
-enqueue(WaitQ *q, SudoG *sgp)
+enqueue(WaitQ *q, Hchan *c, SudoG *sgp)
 {
+	// on a buffered channel, the xadd also orders the enqueue
+	// before the look at the buffer that follows it.
+	if(c->dataqsiz > 0)
+		runtime·xadd(&c->nwait, 1);
 	sgp->link = nil;
 	if(q->first == nil) {
 		q->first = sgp;
@@ -1105,34 +1187,32 @@ enqueue(WaitQ *q, SudoG *sgp)
 	q->last = sgp;
 }
 
-static SudoG*
-allocsg(Hchan *c)
+// Wake a goroutine waiting in q for the buffer of c to change.
+static void
+wakeup(Hchan *c, WaitQ *q)
 {
-	SudoG* sg;
+	SudoG *sg;
+	G *gp;
 
-	sg = c->free;
-	if(sg != nil) {
-		c->free = sg->link;
-	} else
-		sg = runtime·mal(sizeof(*sg) + c->elemsize - sizeof(sg->elem));
-	sg->selgen = g->selgen;
-	sg->g = g;
-	sg->offset = 0;
-	sg->isfree = 0;
-
-	return sg;
+	gp = nil;
+	runtime·lock(c);
+	sg = dequeue(q, c);
+	if(sg != nil)
+		gp = sg->g;
+	runtime·unlock(c);
+	if(gp != nil)
+		runtime·ready(gp);
 }
 
+// Same, with c already locked.
 static void
-freesg(Hchan *c, SudoG *sg)
+wakeuplocked(Hchan *c, WaitQ *q)
 {
-	if(sg != nil) {
-		if(sg->isfree)
-			runtime·throw("chan.freesg: already free");
-		sg->isfree = 1;
-		sg->link = c->free;
-		c->free = sg;
-	}
+	SudoG *sg;
+
+	sg = dequeue(q, c);
+	if(sg != nil)
+		runtime·ready(sg->g);
 }
 
 static uint32
@@ -0,0 +1,223 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+package runtime_test
+
+import (
+	"runtime"
+	"testing"
+)
+
+func TestChanSendRecv(t *testing.T) {
+	defer runtime.GOMAXPROCS(runtime.GOMAXPROCS(4))
+	const n = 10000
+	for _, size := range []int{1, 2, 3, 10, 100} {
+		for _, p := range []int{1, 4} {
+			c := make(chan int, size)
+			done := make(chan int64)
+			for i := 0; i < p; i++ {
+				go func() {
+					for j := 1; j <= n; j++ {
+						c <- j
+					}
+					done <- 0
+				}()
+			}
+			for i := 0; i < p; i++ {
+				go func() {
+					var sum int64
+					for v := range c {
+						sum += int64(v)
+					}
+					done <- sum
+				}()
+			}
+			for i := 0; i < p; i++ {
+				<-done
+			}
+			close(c)
+			var sum int64
+			for i := 0; i < p; i++ {
+				sum += <-done
+			}
+			if want := int64(p) * n * (n + 1) / 2; sum != want {
+				t.Errorf("size=%d, %d senders and receivers: got sum %d, want %d", size, p, sum, want)
+			}
+		}
+	}
+}
+
+func TestChanLenCap(t *testing.T) {
+	c := make(chan int, 3)
+	for i := 0; i < 3; i++ {
+		if len(c) != i || cap(c) != 3 {
+			t.Fatalf("len=%d cap=%d, want %d 3", len(c), cap(c), i)
+		}
+		c <- i
+	}
+	select {
+	case c <- 3:
+		t.Fatalf("send to full channel succeeded")
+	default:
+	}
+	close(c)
+	for i := 0; i < 3; i++ {
+		if v, ok := <-c; v != i || !ok {
+			t.Fatalf("received %d %v, want %d true", v, ok, i)
+		}
+	}
+	if v, ok := <-c; v != 0 || ok {
+		t.Fatalf("received %d %v from closed channel", v, ok)
+	}
+}
+
+func TestSelectFairness(t *testing.T) {
+	const n = 10000
+	c1 := make(chan int, n)
+	c2 := make(chan int, n)
+	for i := 0; i < n; i++ {
+		c1 <- 1
+		c2 <- 2
+	}
+	var cnt [3]int
+	for i := 0; i < n; i++ {
+		select {
+		case v := <-c1:
+			cnt[v]++
+		case v := <-c2:
+			cnt[v]++
+		}
+	}
+	if cnt[1] < n/3 || cnt[2] < n/3 {
+		t.Fatalf("unfair select: %d %d", cnt[1], cnt[2])
+	}
+}
+
+func BenchmarkChanUncontended(b *testing.B) {
+	c := make(chan int, 100)
+	for i := 0; i < b.N; i++ {
+		for j := 0; j < 100; j++ {
+			c <- j
+		}
+		for j := 0; j < 100; j++ {
+			<-c
+		}
+	}
+}
+
+func BenchmarkChanSync(b *testing.B) {
+	c := make(chan int)
+	done := make(chan bool)
+	go func() {
+		for i := 0; i < b.N; i++ {
+			<-c
+			c <- i
+		}
+		done <- true
+	}()
+	for i := 0; i < b.N; i++ {
+		c <- i
+		<-c
+	}
+	<-done
+}
+
+func benchmarkChanProdCons(b *testing.B, size int) {
+	c := make(chan int, size)
+	done := make(chan bool)
+	go func() {
+		for _ = range c {
+		}
+		done <- true
+	}()
+	for i := 0; i < b.N; i++ {
+		c <- i
+	}
+	close(c)
+	<-done
+}
+
+func BenchmarkChanProdCons0(b *testing.B) {
+	benchmarkChanProdCons(b, 0)
+}
+
+func BenchmarkChanProdCons10(b *testing.B) {
+	benchmarkChanProdCons(b, 10)
+}
+
+func BenchmarkChanProdCons100(b *testing.B) {
+	benchmarkChanProdCons(b, 100)
+}
+
+func BenchmarkChanFanIn(b *testing.B) {
+	const p = 4
+	c := make(chan int, 100)
+	for i := 0; i < p; i++ {
+		go func() {
+			for j := 0; j < b.N/p; j++ {
+				c <- j
+			}
+		}()
+	}
+	for i := 0; i < b.N/p*p; i++ {
+		<-c
+	}
+}
+
+func BenchmarkSelectUncontended(b *testing.B) {
+	c1 := make(chan int, 1)
+	c2 := make(chan int, 1)
+	c1 <- 0
+	for i := 0; i < b.N; i++ {
+		select {
+		case <-c1:
+			c2 <- 0
+		case <-c2:
+			c1 <- 0
+		}
+	}
+}
+
+func BenchmarkSelectProdCons(b *testing.B) {
+	c := make(chan int, 100)
+	quit := make(chan bool)
+	done := make(chan bool)
+	go func() {
+		for {
+			select {
+			case <-c:
+			case <-quit:
+				done <- true
+				return
+			}
+		}
+	}()
+	for i := 0; i < b.N; i++ {
+		select {
+		case c <- i:
+		case <-quit:
+		}
+	}
+	quit <- true
+	<-done
+}
+
+func BenchmarkSelectNonblock(b *testing.B) {
+	c1 := make(chan int)
+	c2 := make(chan int, 1)
+	for i := 0; i < b.N; i++ {
+		select {
+		case <-c1:
+		default:
+		}
+		select {
+		case c2 <- 0:
+		default:
+		}
+		select {
+		case <-c2:
+		default:
+		}
+	}
+}
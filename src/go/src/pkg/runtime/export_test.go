@@ -15,3 +15,7 @@ var F32to64 = f32to64
 var Fcmp64 = fcmp64
 var Fintto64 = fintto64
 var F64toint = f64toint
+
+func scavenge()
+
+var Scavenge = scavenge
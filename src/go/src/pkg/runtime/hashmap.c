@@ -3,28 +3,54 @@
 // license that can be found in the LICENSE file.
 
 #include "runtime.h"
+#include "malloc.h"
 #include "hashmap.h"
 #include "type.h"
 
-/* Return a pointer to the struct/union of type "type"
-   whose "field" field is addressed by pointer "p". */
+// A map is a hash table of 2^B buckets.  The low B bits of a key's
+// hash select its bucket.  Each bucket holds up to BUCKETSIZE
+// key/value pairs, followed by a chain of overflow buckets when
+// more keys hash to it.  The keys of a bucket are stored together,
+// then its values, so that lookups touch as few cache lines as
+// possible and no padding is needed between keys and values.
+// Each slot also records the top 8 bits of its key's hash, so a
+// lookup compares a byte before calling the key's equality function.
+// Each map hashes with its own random seed, so that which keys
+// collide cannot be known in advance.
+//
+// When the average load of a bucket exceeds LOAD2/2, the table
+// doubles.  The old buckets are not copied all at once: each insert
+// or delete evacuates the old bucket it touches and one more, so the
+// cost of growing is spread across the following updates.
+// An evacuated bucket keeps its data, for the iterators that are
+// still walking it.
+
+typedef struct Bucket Bucket;
+
+enum
+{
+	BUCKETSIZE = 8,		// key/value pairs per bucket; keep in sync with ../../cmd/gc/reflect.c
+	MAXKEYSIZE = 128,
+	MAXVALUESIZE = 128,	// larger values are allocated separately; keep in sync with ../../cmd/gc/walk.c and reflect.c
+	LOAD2 = 13,		// twice the average bucket load that triggers growth
 
-struct Hmap {	   /* a hash table; initialize with hash_init() */
-	uint32 count;	  /* elements in table - must be first */
+	IndirectValue = 1,	// Hmap.flags: buckets hold pointers to the values
+};
 
-	uint8 datasize;   /* amount of data to store in entry */
-	uint8 max_power;  /* max power of 2 to create sub-tables */
-	uint8 max_probes; /* max entries to probe before rehashing */
-	uint8 indirectval; /* storing pointers to values */
-	int32 changes;	      /* inc'ed whenever a subtable is created/grown */
-	hash_hash_t (*data_hash) (uint32, void *a);  /* return hash of *a */
-	uint32 (*data_eq) (uint32, void *a, void *b);   /* return whether *a == *b */
-	void (*data_del) (uint32, void *arg, void *data);  /* invoked on deletion */
-	struct hash_subtable *st;    /* first-level table */
+struct Hmap
+{
+	uint32	count;		// live entries - must be first (len)
+	uint8	B;		// log2 of the number of buckets
+	uint8	flags;
+	uint16	keysize;	// size of a key slot
+	uint16	valuesize;	// size of a value slot
+	uint16	bucketsize;	// size of a bucket, header and slots
+	uint32	hash0;		// seed of the key hashes
+	byte*	buckets;	// array of 2^B Buckets
+	byte*	oldbuckets;	// half-size previous array, non-nil only while growing
+	uintptr	nevacuate;	// old buckets below this have been evacuated
 
-	uint32	keysize;
-	uint32	valsize;
-	uint32	datavo;
+	uint32	valsize;	// size of the value type
 
 	// three sets of offsets: the digit counts how many
 	// of key, value are passed as inputs:
@@ -41,666 +67,381 @@ struct Hmap {	   /* a hash table; initialize with hash_init() */
 	uint32	po2;
 	Alg*	keyalg;
 	Alg*	valalg;
+	MapType*	type;	// for the pointer bitmaps of the buckets and values
 };
 
-struct hash_entry {
-	hash_hash_t hash;     /* hash value of data */
-	byte data[1];	 /* user data has "datasize" bytes */
-};
-
-struct hash_subtable {
-	uint8 power;	 /* bits used to index this table */
-	uint8 used;	  /* bits in hash used before reaching this table */
-	uint8 datasize;      /* bytes of client data in an entry */
-	uint8 max_probes;    /* max number of probes when searching */
-	int16 limit_bytes;	   /* max_probes * (datasize+sizeof (hash_hash_t)) */
-	struct hash_entry *end;      /* points just past end of entry[] */
-	struct hash_entry entry[1];  /* 2**power+max_probes-1 elements of elemsize bytes */
+// The keys of a bucket follow the header, then its values.
+struct Bucket
+{
+	uint8	tophash[BUCKETSIZE];	// top byte of each key's hash; 0 if the slot is free
+	Bucket*	overflow;		// next bucket in the chain; low bit set once evacuated
 };
 
-#define HASH_DATA_EQ(h,x,y) ((*h->data_eq) (h->keysize, (x), (y)))
-
-#define HASH_REHASH 0x2       /* an internal flag */
-/* the number of bits used is stored in the flags word too */
-#define HASH_USED(x)      ((x) >> 2)
-#define HASH_MAKE_USED(x) ((x) << 2)
-
-#define HASH_LOW	6
-#define HASH_ONE	(((hash_hash_t)1) << HASH_LOW)
-#define HASH_MASK       (HASH_ONE - 1)
-#define HASH_ADJUST(x)  (((x) < HASH_ONE) << HASH_LOW)
+#define BUCKET(a, i)	((Bucket*)((a) + (i)*h->bucketsize))
+#define KEY(b, i)	((byte*)((b)+1) + (i)*h->keysize)
+#define VALUE(b, i)	((byte*)((b)+1) + BUCKETSIZE*h->keysize + (i)*h->valuesize)
+#define OVERFLOW(b)	((Bucket*)((uintptr)(b)->overflow & ~(uintptr)1))
+#define EVACUATED(b)	(((uintptr)(b)->overflow & 1) != 0)
+#define HASH(k)		(h->keyalg->hash(h->keysize, (k), h->hash0))
+#define INDIRECT(v)	((h->flags & IndirectValue) ? *(byte**)(v) : (byte*)(v))
 
-#define HASH_BITS       (sizeof (hash_hash_t) * 8)
+// alg->copy(s, dst, src), with a word copied inline: every Alg's copy
+// of a non-nil src is a plain copy of its s bytes.
+#define COPY(alg, s, dst, src)	if((s) == sizeof(uintptr)) *(uintptr*)(dst) = *(uintptr*)(src); else (alg)->copy((s), (dst), (src))
 
-#define HASH_SUBHASH    HASH_MASK
-#define HASH_NIL	0
-#define HASH_NIL_MEMSET 0
+// The top byte of hash, as kept in Bucket.tophash: 0 marks a free
+// slot, so a zero top byte is kept as 1.
+#define TOPHASH(hash)	((uint8)((hash) >> (sizeof(uintptr)*8 - 8)) | ((hash) >> (sizeof(uintptr)*8 - 8) == 0))
 
-#define HASH_OFFSET(base, byte_offset) \
-	  ((struct hash_entry *) (((byte *) (base)) + (byte_offset)))
+// Returned by the fast lookups for a missing key.
+static byte empty_value[MAXVALUESIZE];
 
+static	int32	debug	= 0;
 
-/* return a hash layer with 2**power empty entries */
-static struct hash_subtable *
-hash_subtable_new (Hmap *h, int32 power, int32 used)
+// Return the first bucket of the chain that holds keys with this hash.
+// LOOKUPBUCKET is the same, with the common case inline.
+#define LOOKUPBUCKET(hash)	(h->oldbuckets == nil ? BUCKET(h->buckets, (hash) & (((uintptr)1 << h->B) - 1)) : lookupbucket(h, (hash)))
+static Bucket*
+lookupbucket(Hmap *h, uintptr hash)
 {
-	int32 elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
-	int32 bytes = elemsize << power;
-	struct hash_subtable *st;
-	int32 limit_bytes = h->max_probes * elemsize;
-	int32 max_probes = h->max_probes;
-
-	if (bytes < limit_bytes) {
-		limit_bytes = bytes;
-		max_probes = 1 << power;
+	uintptr m;
+	Bucket *b, *oldb;
+
+	m = ((uintptr)1 << h->B) - 1;
+	b = BUCKET(h->buckets, hash & m);
+	if(h->oldbuckets != nil) {
+		oldb = BUCKET(h->oldbuckets, hash & (m >> 1));
+		if(!EVACUATED(oldb))
+			b = oldb;
 	}
-	bytes += limit_bytes - elemsize;
-	st = malloc (offsetof (struct hash_subtable, entry[0]) + bytes);
-	st->power = power;
-	st->used = used;
-	st->datasize = h->datasize;
-	st->max_probes = max_probes;
-	st->limit_bytes = limit_bytes;
-	st->end = HASH_OFFSET (st->entry, bytes);
-	memset (st->entry, HASH_NIL_MEMSET, bytes);
-	return (st);
+	return b;
 }
 
+// Copy the n bytes of a key or value slot from src to dst, forward
+// and a word at a time if they are aligned.  runtime·memmove copies
+// backward, and slowly, when dst is above src, as new buckets mostly are.
 static void
-init_sizes (int64 hint, int32 *init_power, int32 *max_power)
+copyslot(byte *dst, byte *src, uintptr n)
 {
-	int32 log = 0;
-	int32 i;
+	uintptr i;
 
-	for (i = 32; i != 0; i >>= 1) {
-		if ((hint >> (log + i)) != 0) {
-			log += i;
-		}
-	}
-	log += 1 + (((hint << 3) >> log) >= 11);  /* round up for utilization */
-	if (log <= 14) {
-		*init_power = log;
+	if((((uintptr)dst | (uintptr)src | n) & (sizeof(uintptr)-1)) == 0) {
+		for(i=0; i<n; i+=sizeof(uintptr))
+			*(uintptr*)(dst+i) = *(uintptr*)(src+i);
 	} else {
-		*init_power = 12;
+		for(i=0; i<n; i++)
+			dst[i] = src[i];
 	}
-	*max_power = 12;
+	runtime·markdirty(dst, n);
 }
 
+// Move the entries of old bucket oldbucket to the two new buckets
+// they now hash to, and advance h->nevacuate past the evacuated buckets.
 static void
-hash_init (Hmap *h,
-		int32 datasize,
-		hash_hash_t (*data_hash) (uint32, void *),
-		uint32 (*data_eq) (uint32, void *, void *),
-		void (*data_del) (uint32, void *, void *),
-		int64 hint)
-{
-	int32 init_power;
-	int32 max_power;
-
-	if(datasize < sizeof (void *))
-		datasize = sizeof (void *);
-	datasize = runtime·rnd(datasize, sizeof (void *));
-	init_sizes (hint, &init_power, &max_power);
-	h->datasize = datasize;
-	h->max_power = max_power;
-	h->max_probes = 15;
-	assert (h->datasize == datasize);
-	assert (h->max_power == max_power);
-	assert (sizeof (void *) <= h->datasize || h->max_power == 255);
-	h->count = 0;
-	h->changes = 0;
-	h->data_hash = data_hash;
-	h->data_eq = data_eq;
-	h->data_del = data_del;
-	h->st = hash_subtable_new (h, init_power, 0);
-}
-
-static void
-hash_remove_n (struct hash_subtable *st, struct hash_entry *dst_e, int32 n)
-{
-	int32 elemsize = st->datasize + offsetof (struct hash_entry, data[0]);
-	struct hash_entry *src_e = HASH_OFFSET (dst_e, n * elemsize);
-	struct hash_entry *end_e = st->end;
-	int32 shift = HASH_BITS - (st->power + st->used);
-	int32 index_mask = (((hash_hash_t)1) << st->power) - 1;
-	int32 dst_i = (((byte *) dst_e) - ((byte *) st->entry)) / elemsize;
-	int32 src_i = dst_i + n;
-	hash_hash_t hash;
-	int32 skip;
-	int32 bytes;
-
-	while (dst_e != src_e) {
-		if (src_e != end_e) {
-			struct hash_entry *cp_e = src_e;
-			int32 save_dst_i = dst_i;
-			while (cp_e != end_e && (hash = cp_e->hash) != HASH_NIL &&
-			     ((hash >> shift) & index_mask) <= dst_i) {
-				cp_e = HASH_OFFSET (cp_e, elemsize);
-				dst_i++;
-			}
-			bytes = ((byte *) cp_e) - (byte *) src_e;
-			memmove (dst_e, src_e, bytes);
-			dst_e = HASH_OFFSET (dst_e, bytes);
-			src_e = cp_e;
-			src_i += dst_i - save_dst_i;
-			if (src_e != end_e && (hash = src_e->hash) != HASH_NIL) {
-				skip = ((hash >> shift) & index_mask) - dst_i;
-			} else {
-				skip = src_i - dst_i;
+evacuate(Hmap *h, uintptr oldbucket)
+{
+	Bucket *b, *nextb, *x, *y, *nb;
+	uintptr newbit, hash;
+	byte *k;
+	int32 i, xi, yi;
+
+	b = BUCKET(h->oldbuckets, oldbucket);
+	newbit = (uintptr)1 << (h->B - 1);
+	if(!EVACUATED(b)) {
+		x = BUCKET(h->buckets, oldbucket);
+		y = BUCKET(h->buckets, oldbucket + newbit);
+		xi = 0;
+		yi = 0;
+		for(; b != nil; b = nextb) {
+			nextb = b->overflow;
+			for(i = 0; i < BUCKETSIZE; i++) {
+				if(b->tophash[i] == 0)
+					continue;
+				k = KEY(b, i);
+				hash = HASH(k);
+				if((hash & newbit) == 0) {
+					if(xi == BUCKETSIZE) {
+						nb = runtime·malgc(h->bucketsize, h->type->bucket);
+						x->overflow = nb;
+						runtime·markdirty(&x->overflow, sizeof x->overflow);
+						x = nb;
+						xi = 0;
+					}
+					x->tophash[xi] = b->tophash[i];
+					copyslot(KEY(x, xi), k, h->keysize);
+					copyslot(VALUE(x, xi), VALUE(b, i), h->valuesize);
+					xi++;
+				} else {
+					if(yi == BUCKETSIZE) {
+						nb = runtime·malgc(h->bucketsize, h->type->bucket);
+						y->overflow = nb;
+						runtime·markdirty(&y->overflow, sizeof y->overflow);
+						y = nb;
+						yi = 0;
+					}
+					y->tophash[yi] = b->tophash[i];
+					copyslot(KEY(y, yi), k, h->keysize);
+					copyslot(VALUE(y, yi), VALUE(b, i), h->valuesize);
+					yi++;
+				}
 			}
-		} else {
-			skip = src_i - dst_i;
+			b->overflow = (Bucket*)((uintptr)nextb | 1);
 		}
-		bytes = skip * elemsize;
-		memset (dst_e, HASH_NIL_MEMSET, bytes);
-		dst_e = HASH_OFFSET (dst_e, bytes);
-		dst_i += skip;
 	}
-}
-
-static int32
-hash_insert_internal (struct hash_subtable **pst, int32 flags, hash_hash_t hash,
-		Hmap *h, void *data, void **pres);
 
-static void
-hash_conv (Hmap *h,
-		struct hash_subtable *st, int32 flags,
-		hash_hash_t hash,
-		struct hash_entry *e)
-{
-	int32 new_flags = (flags + HASH_MAKE_USED (st->power)) | HASH_REHASH;
-	int32 shift = HASH_BITS - HASH_USED (new_flags);
-	hash_hash_t prefix_mask = (-(hash_hash_t)1) << shift;
-	int32 elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
-	void *dummy_result;
-	struct hash_entry *de;
-	int32 index_mask = (1 << st->power) - 1;
-	hash_hash_t e_hash;
-	struct hash_entry *pe = HASH_OFFSET (e, -elemsize);
-
-	while (e != st->entry && (e_hash = pe->hash) != HASH_NIL && (e_hash & HASH_MASK) != HASH_SUBHASH) {
-		e = pe;
-		pe = HASH_OFFSET (pe, -elemsize);
-	}
-
-	de = e;
-	while (e != st->end &&
-	    (e_hash = e->hash) != HASH_NIL &&
-	    (e_hash & HASH_MASK) != HASH_SUBHASH) {
-		struct hash_entry *target_e = HASH_OFFSET (st->entry, ((e_hash >> shift) & index_mask) * elemsize);
-		struct hash_entry *ne = HASH_OFFSET (e, elemsize);
-		hash_hash_t current = e_hash & prefix_mask;
-		if (de < target_e) {
-			memset (de, HASH_NIL_MEMSET, ((byte *) target_e) - (byte *) de);
-			de = target_e;
-		}
-		if ((hash & prefix_mask) == current ||
-		   (ne != st->end && (e_hash = ne->hash) != HASH_NIL &&
-		   (e_hash & prefix_mask) == current)) {
-			struct hash_subtable *new_st = hash_subtable_new (h, 1, HASH_USED (new_flags));
-			int32 rc = hash_insert_internal (&new_st, new_flags, e->hash, h, e->data, &dummy_result);
-			assert (rc == 0);
-			memcpy(dummy_result, e->data, h->datasize);
-			e = ne;
-			while (e != st->end && (e_hash = e->hash) != HASH_NIL && (e_hash & prefix_mask) == current) {
-				assert ((e_hash & HASH_MASK) != HASH_SUBHASH);
-				rc = hash_insert_internal (&new_st, new_flags, e_hash, h, e->data, &dummy_result);
-				assert (rc == 0);
-				memcpy(dummy_result, e->data, h->datasize);
-				e = HASH_OFFSET (e, elemsize);
-			}
-			memset (de->data, HASH_NIL_MEMSET, h->datasize);
-			*(struct hash_subtable **)de->data = new_st;
-			de->hash = current | HASH_SUBHASH;
-		} else {
-			if (e != de) {
-				memcpy (de, e, elemsize);
-			}
-			e = HASH_OFFSET (e, elemsize);
-		}
-		de = HASH_OFFSET (de, elemsize);
-	}
-	if (e != de) {
-		hash_remove_n (st, de, (((byte *) e) - (byte *) de) / elemsize);
+	if(oldbucket == h->nevacuate) {
+		while(++oldbucket < newbit && EVACUATED(BUCKET(h->oldbuckets, oldbucket)))
+			;
+		h->nevacuate = oldbucket;
+		if(oldbucket == newbit)
+			h->oldbuckets = nil;	// growing is done
 	}
 }
 
+// Before an update of bucket, evacuate its old bucket,
+// and one more to make progress on the growth.
 static void
-hash_grow (Hmap *h, struct hash_subtable **pst, int32 flags)
-{
-	struct hash_subtable *old_st = *pst;
-	int32 elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
-	*pst = hash_subtable_new (h, old_st->power + 1, HASH_USED (flags));
-	struct hash_entry *end_e = old_st->end;
-	struct hash_entry *e;
-	void *dummy_result;
-	int32 used = 0;
-
-	flags |= HASH_REHASH;
-	for (e = old_st->entry; e != end_e; e = HASH_OFFSET (e, elemsize)) {
-		hash_hash_t hash = e->hash;
-		if (hash != HASH_NIL) {
-			int32 rc = hash_insert_internal (pst, flags, e->hash, h, e->data, &dummy_result);
-			assert (rc == 0);
-			memcpy(dummy_result, e->data, h->datasize);
-			used++;
-		}
-	}
-	free (old_st);
-}
-
-static int32
-hash_lookup (Hmap *h, void *data, void **pres)
+growwork(Hmap *h, uintptr bucket)
 {
-	int32 elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
-	hash_hash_t hash = (*h->data_hash) (h->keysize, data) & ~HASH_MASK;
-	struct hash_subtable *st = h->st;
-	int32 used = 0;
-	hash_hash_t e_hash;
-	struct hash_entry *e;
-	struct hash_entry *end_e;
-
-	hash += HASH_ADJUST (hash);
-	for (;;) {
-		int32 shift = HASH_BITS - (st->power + used);
-		int32 index_mask = (1 << st->power) - 1;
-		int32 i = (hash >> shift) & index_mask;	   /* i is the natural position of hash */
-
-		e = HASH_OFFSET (st->entry, i * elemsize); /* e points to element i */
-		e_hash = e->hash;
-		if ((e_hash & HASH_MASK) != HASH_SUBHASH) {      /* a subtable */
-			break;
-		}
-		used += st->power;
-		st = *(struct hash_subtable **)e->data;
-	}
-	end_e = HASH_OFFSET (e, st->limit_bytes);
-	while (e != end_e && (e_hash = e->hash) != HASH_NIL && e_hash < hash) {
-		e = HASH_OFFSET (e, elemsize);
-	}
-	while (e != end_e && ((e_hash = e->hash) ^ hash) < HASH_SUBHASH) {
-		if (HASH_DATA_EQ (h, data, e->data)) {    /* a match */
-			*pres = e->data;
-			return (1);
-		}
-		e = HASH_OFFSET (e, elemsize);
-	}
-	USED(e_hash);
-	*pres = 0;
-	return (0);
+	evacuate(h, bucket & (((uintptr)1 << (h->B - 1)) - 1));
+	if(h->oldbuckets != nil)
+		evacuate(h, h->nevacuate);
 }
 
-static int32
-hash_remove (Hmap *h, void *data, void *arg)
+static void
+hash_grow(Hmap *h)
 {
-	int32 elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
-	hash_hash_t hash = (*h->data_hash) (h->keysize, data) & ~HASH_MASK;
-	struct hash_subtable *st = h->st;
-	int32 used = 0;
-	hash_hash_t e_hash;
-	struct hash_entry *e;
-	struct hash_entry *end_e;
-
-	hash += HASH_ADJUST (hash);
-	for (;;) {
-		int32 shift = HASH_BITS - (st->power + used);
-		int32 index_mask = (1 << st->power) - 1;
-		int32 i = (hash >> shift) & index_mask;	   /* i is the natural position of hash */
-
-		e = HASH_OFFSET (st->entry, i * elemsize); /* e points to element i */
-		e_hash = e->hash;
-		if ((e_hash & HASH_MASK) != HASH_SUBHASH) {      /* a subtable */
-			break;
-		}
-		used += st->power;
-		st = *(struct hash_subtable **)e->data;
-	}
-	end_e = HASH_OFFSET (e, st->limit_bytes);
-	while (e != end_e && (e_hash = e->hash) != HASH_NIL && e_hash < hash) {
-		e = HASH_OFFSET (e, elemsize);
-	}
-	while (e != end_e && ((e_hash = e->hash) ^ hash) < HASH_SUBHASH) {
-		if (HASH_DATA_EQ (h, data, e->data)) {    /* a match */
-			(*h->data_del) (h->datavo, arg, e->data);
-			hash_remove_n (st, e, 1);
-			h->count--;
-			return (1);
-		}
-		e = HASH_OFFSET (e, elemsize);
-	}
-	USED(e_hash);
-	return (0);
+	if(h->oldbuckets != nil)
+		runtime·throw("hash_grow: evacuation not done in time");
+	h->oldbuckets = h->buckets;
+	h->B++;
+	h->buckets = runtime·malgc((uintptr)h->bucketsize << h->B, h->type->bucket);
+	h->nevacuate = 0;
+	runtime·markdirty(h, sizeof *h);
 }
 
-static int32
-hash_insert_internal (struct hash_subtable **pst, int32 flags, hash_hash_t hash,
-				 Hmap *h, void *data, void **pres)
+// Return a pointer to the value slot for key, or nil if key is not in h.
+static byte*
+hash_lookup(Hmap *h, byte *key)
 {
-	int32 elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
+	uintptr hash;
+	uint8 top;
+	Bucket *b;
+	int32 i;
 
-	if ((flags & HASH_REHASH) == 0) {
-		hash += HASH_ADJUST (hash);
-		hash &= ~HASH_MASK;
-	}
-	for (;;) {
-		struct hash_subtable *st = *pst;
-		int32 shift = HASH_BITS - (st->power + HASH_USED (flags));
-		int32 index_mask = (1 << st->power) - 1;
-		int32 i = (hash >> shift) & index_mask;	   /* i is the natural position of hash */
-		struct hash_entry *start_e =
-			HASH_OFFSET (st->entry, i * elemsize);    /* start_e is the pointer to element i */
-		struct hash_entry *e = start_e;		   /* e is going to range over [start_e, end_e) */
-		struct hash_entry *end_e;
-		hash_hash_t e_hash = e->hash;
-
-		if ((e_hash & HASH_MASK) == HASH_SUBHASH) {      /* a subtable */
-			pst = (struct hash_subtable **) e->data;
-			flags += HASH_MAKE_USED (st->power);
-			continue;
-		}
-		end_e = HASH_OFFSET (start_e, st->limit_bytes);
-		while (e != end_e && (e_hash = e->hash) != HASH_NIL && e_hash < hash) {
-			e = HASH_OFFSET (e, elemsize);
-			i++;
-		}
-		if (e != end_e && e_hash != HASH_NIL) {
-			/* ins_e ranges over the elements that may match */
-			struct hash_entry *ins_e = e;
-			int32 ins_i = i;
-			hash_hash_t ins_e_hash;
-			while (ins_e != end_e && ((e_hash = ins_e->hash) ^ hash) < HASH_SUBHASH) {
-				if (HASH_DATA_EQ (h, data, ins_e->data)) {    /* a match */
-					*pres = ins_e->data;
-					return (1);
+	hash = HASH(key);
+	top = TOPHASH(hash);
+	for(b = LOOKUPBUCKET(hash); b != nil; b = OVERFLOW(b))
+		for(i = 0; i < BUCKETSIZE; i++)
+			if(b->tophash[i] == top && h->keyalg->equal(h->keysize, key, KEY(b, i)))
+				return VALUE(b, i);
+	return nil;
+}
+
+// Return a pointer to the value slot for key, inserting key if it
+// is not in h.  Set *hit to whether it was.
+static byte*
+hash_insert(Hmap *h, byte *key, bool *hit)
+{
+	uintptr hash, bucket;
+	uint8 top;
+	Bucket *b, *insertb;
+	int32 i, inserti;
+	byte *v;
+
+	hash = HASH(key);
+	top = TOPHASH(hash);
+again:
+	bucket = hash & (((uintptr)1 << h->B) - 1);
+	if(h->oldbuckets != nil)
+		growwork(h, bucket);
+	b = BUCKET(h->buckets, bucket);
+	insertb = nil;
+	inserti = 0;
+	for(;;) {
+		for(i = 0; i < BUCKETSIZE; i++) {
+			if(b->tophash[i] != top) {
+				if(b->tophash[i] == 0 && insertb == nil) {
+					insertb = b;
+					inserti = i;
 				}
-				assert (e_hash != hash || (flags & HASH_REHASH) == 0);
-				hash += (e_hash == hash);	   /* adjust hash if it collides */
-				ins_e = HASH_OFFSET (ins_e, elemsize);
-				ins_i++;
-				if (e_hash <= hash) {	       /* set e to insertion point */
-					e = ins_e;
-					i = ins_i;
-				}
-			}
-			/* set ins_e to the insertion point for the new element */
-			ins_e = e;
-			ins_i = i;
-			ins_e_hash = 0;
-			/* move ins_e to point at the end of the contiguous block, but
-			   stop if any element can't be moved by one up */
-			while (ins_e != st->end && (ins_e_hash = ins_e->hash) != HASH_NIL &&
-			       ins_i + 1 - ((ins_e_hash >> shift) & index_mask) < st->max_probes &&
-			       (ins_e_hash & HASH_MASK) != HASH_SUBHASH) {
-				ins_e = HASH_OFFSET (ins_e, elemsize);
-				ins_i++;
-			}
-			if (e == end_e || ins_e == st->end || ins_e_hash != HASH_NIL) {
-				e = end_e;    /* can't insert; must grow or convert to subtable */
-			} else {	      /* make space for element */
-				memmove (HASH_OFFSET (e, elemsize), e, ((byte *) ins_e) - (byte *) e);
+				continue;
 			}
+			if(!h->keyalg->equal(h->keysize, key, KEY(b, i)))
+				continue;
+			h->keyalg->copy(h->keysize, KEY(b, i), key);
+			*hit = true;
+			return VALUE(b, i);
 		}
-		if (e != end_e) {
-			e->hash = hash;
-			*pres = e->data;
-			return (0);
-		}
-		h->changes++;
-		if (st->power < h->max_power) {
-			hash_grow (h, pst, flags);
-		} else {
-			hash_conv (h, st, flags, hash, start_e);
-		}
-	}
-}
-
-static int32
-hash_insert (Hmap *h, void *data, void **pres)
-{
-	int32 rc = hash_insert_internal (&h->st, 0, (*h->data_hash) (h->keysize, data), h, data, pres);
-
-	h->count += (rc == 0);    /* increment count if element didn't previously exist */
-	return (rc);
-}
-
-static uint32
-hash_count (Hmap *h)
-{
-	return (h->count);
-}
-
-static void
-iter_restart (struct hash_iter *it, struct hash_subtable *st, int32 used)
-{
-	int32 elemsize = it->elemsize;
-	hash_hash_t last_hash = it->last_hash;
-	struct hash_entry *e;
-	hash_hash_t e_hash;
-	struct hash_iter_sub *sub = &it->subtable_state[it->i];
-	struct hash_entry *end;
-
-	for (;;) {
-		int32 shift = HASH_BITS - (st->power + used);
-		int32 index_mask = (1 << st->power) - 1;
-		int32 i = (last_hash >> shift) & index_mask;
-
-		end = st->end;
-		e = HASH_OFFSET (st->entry, i * elemsize);
-		sub->start = st->entry;
-		sub->end = end;
-
-		if ((e->hash & HASH_MASK) != HASH_SUBHASH) {
+		if(b->overflow == nil)
 			break;
-		}
-		sub->e = HASH_OFFSET (e, elemsize);
-		sub = &it->subtable_state[++(it->i)];
-		used += st->power;
-		st = *(struct hash_subtable **)e->data;
-	}
-	while (e != end && ((e_hash = e->hash) == HASH_NIL || e_hash <= last_hash)) {
-		e = HASH_OFFSET (e, elemsize);
+		b = b->overflow;
 	}
-	sub->e = e;
-}
 
-static void *
-hash_next (struct hash_iter *it)
-{
-	int32 elemsize = it->elemsize;
-	struct hash_iter_sub *sub = &it->subtable_state[it->i];
-	struct hash_entry *e = sub->e;
-	struct hash_entry *end = sub->end;
-	hash_hash_t e_hash = 0;
-
-	if (it->changes != it->h->changes) {    /* hash table's structure changed; recompute */
-		it->changes = it->h->changes;
-		it->i = 0;
-		iter_restart (it, it->h->st, 0);
-		sub = &it->subtable_state[it->i];
-		e = sub->e;
-		end = sub->end;
-	}
-	if (e != sub->start && it->last_hash != HASH_OFFSET (e, -elemsize)->hash) {
-		struct hash_entry *start = HASH_OFFSET (e, -(elemsize * it->h->max_probes));
-		struct hash_entry *pe = HASH_OFFSET (e, -elemsize);
-		hash_hash_t last_hash = it->last_hash;
-		if (start < sub->start) {
-			start = sub->start;
-		}
-		while (e != start && ((e_hash = pe->hash) == HASH_NIL || last_hash < e_hash)) {
-			e = pe;
-			pe = HASH_OFFSET (pe, -elemsize);
-		}
-		while (e != end && ((e_hash = e->hash) == HASH_NIL || e_hash <= last_hash)) {
-			e = HASH_OFFSET (e, elemsize);
-		}
+	// Not found.  Grow the table if it is too full, and try again.
+	if(h->oldbuckets == nil && h->count >= BUCKETSIZE &&
+	   2*(uint64)h->count >= ((uint64)LOAD2 << h->B)) {
+		hash_grow(h);
+		goto again;
 	}
 
-	for (;;) {
-		while (e != end && (e_hash = e->hash) == HASH_NIL) {
-			e = HASH_OFFSET (e, elemsize);
-		}
-		if (e == end) {
-			if (it->i == 0) {
-				it->last_hash = HASH_OFFSET (e, -elemsize)->hash;
-				sub->e = e;
-				return (0);
-			} else {
-				it->i--;
-				sub = &it->subtable_state[it->i];
-				e = sub->e;
-				end = sub->end;
-			}
-		} else if ((e_hash & HASH_MASK) != HASH_SUBHASH) {
-			it->last_hash = e->hash;
-			sub->e = HASH_OFFSET (e, elemsize);
-			return (e->data);
-		} else {
-			struct hash_subtable *st =
-				*(struct hash_subtable **)e->data;
-			sub->e = HASH_OFFSET (e, elemsize);
-			it->i++;
-			assert (it->i < sizeof (it->subtable_state) /
-					sizeof (it->subtable_state[0]));
-			sub = &it->subtable_state[it->i];
-			sub->e = e = st->entry;
-			sub->start = st->entry;
-			sub->end = end = st->end;
-		}
+	if(insertb == nil) {
+		insertb = runtime·malgc(h->bucketsize, h->type->bucket);
+		b->overflow = insertb;
+		runtime·markdirty(&b->overflow, sizeof b->overflow);
+		inserti = 0;
 	}
+	insertb->tophash[inserti] = top;
+	h->keyalg->copy(h->keysize, KEY(insertb, inserti), key);
+	v = VALUE(insertb, inserti);
+	if(h->flags & IndirectValue) {
+		*(byte**)v = runtime·cnew(h->type->elem, 1);
+		runtime·markdirty(v, sizeof(byte*));
+	}
+	h->count++;
+	*hit = false;
+	return v;
 }
 
 static void
-hash_iter_init (Hmap *h, struct hash_iter *it)
+hash_remove(Hmap *h, byte *key)
 {
-	it->elemsize = h->datasize + offsetof (struct hash_entry, data[0]);
-	it->changes = h->changes;
-	it->i = 0;
-	it->h = h;
-	it->last_hash = 0;
-	it->subtable_state[0].e = h->st->entry;
-	it->subtable_state[0].start = h->st->entry;
-	it->subtable_state[0].end = h->st->end;
-}
+	uintptr hash, bucket;
+	uint8 top;
+	Bucket *b;
+	int32 i;
 
-static void
-clean_st (struct hash_subtable *st, int32 *slots, int32 *used)
-{
-	int32 elemsize = st->datasize + offsetof (struct hash_entry, data[0]);
-	struct hash_entry *e = st->entry;
-	struct hash_entry *end = st->end;
-	int32 lslots = (((byte *) end) - (byte *) e) / elemsize;
-	int32 lused = 0;
-
-	while (e != end) {
-		hash_hash_t hash = e->hash;
-		if ((hash & HASH_MASK) == HASH_SUBHASH) {
-			clean_st (*(struct hash_subtable **)e->data, slots, used);
-		} else {
-			lused += (hash != HASH_NIL);
+	hash = HASH(key);
+	top = TOPHASH(hash);
+	bucket = hash & (((uintptr)1 << h->B) - 1);
+	if(h->oldbuckets != nil)
+		growwork(h, bucket);
+	for(b = BUCKET(h->buckets, bucket); b != nil; b = b->overflow) {
+		for(i = 0; i < BUCKETSIZE; i++) {
+			if(b->tophash[i] != top || !h->keyalg->equal(h->keysize, key, KEY(b, i)))
+				continue;
+			// Clear the slot so the collector does not
+			// retain what the key and value pointed at.
+			b->tophash[i] = 0;
+			runtime·memclr(KEY(b, i), h->keysize);
+			runtime·memclr(VALUE(b, i), h->valuesize);
+			h->count--;
+			return;
 		}
-		e = HASH_OFFSET (e, elemsize);
 	}
-	free (st);
-	*slots += lslots;
-	*used += lused;
 }
 
 static void
-hash_destroy (Hmap *h)
+hash_iter_init(Hmap *h, struct hash_iter *it)
 {
-	int32 slots = 0;
-	int32 used = 0;
-
-	clean_st (h->st, &slots, &used);
-	free (h);
+	it->h = h;
+	it->buckets = h->buckets;
+	it->B = h->B;
+	it->bptr = nil;
+	it->bucket = 0;
+	it->check_bucket = -1;
+	it->i = 0;
+	runtime·markdirty(it, sizeof *it);
 }
 
+// Advance it->key and it->value to the next entry, or to nil at the end.
+// The entries are visited in bucket order of the table as it was when the
+// iterator started.  If the table was growing then, the iterator walks an
+// old bucket that is not yet evacuated in place of its two new buckets,
+// once for each, returning only the keys that belong to that new bucket
+// (it->check_bucket).  If the table grew after the iterator started, the
+// buckets it walks have been evacuated and may be stale, so each key is
+// looked up again for its current value, and skipped if it was deleted.
 static void
-hash_visit_internal (struct hash_subtable *st,
-		int32 used, int32 level,
-		void (*data_visit) (void *arg, int32 level, void *data),
-		void *arg)
+hash_next(struct hash_iter *it)
 {
-	int32 elemsize = st->datasize + offsetof (struct hash_entry, data[0]);
-	struct hash_entry *e = st->entry;
-	int32 shift = HASH_BITS - (used + st->power);
-	int32 i = 0;
-
-	while (e != st->end) {
-		int32 index = ((e->hash >> (shift - 1)) >> 1) & ((1 << st->power) - 1);
-		if ((e->hash & HASH_MASK) == HASH_SUBHASH) {
-			  (*data_visit) (arg, level, e->data);
-			  hash_visit_internal (*(struct hash_subtable **)e->data,
-				used + st->power, level + 1, data_visit, arg);
-		} else {
-			  (*data_visit) (arg, level, e->data);
+	Hmap *h;
+	Bucket *b;
+	uintptr bucket, oldbucket, hash;
+	intptr check_bucket;
+	uint32 i;
+	byte *k, *v;
+
+	h = it->h;
+	b = it->bptr;
+	bucket = it->bucket;
+	check_bucket = it->check_bucket;
+	i = it->i;
+
+next:
+	if(b == nil) {
+		if(bucket == ((uintptr)1 << it->B)) {
+			it->key = nil;
+			it->value = nil;
+			return;
+		}
+		check_bucket = -1;
+		b = BUCKET(it->buckets, bucket);
+		if(h->oldbuckets != nil && it->B == h->B) {
+			oldbucket = bucket & (((uintptr)1 << (it->B - 1)) - 1);
+			if(!EVACUATED(BUCKET(h->oldbuckets, oldbucket))) {
+				b = BUCKET(h->oldbuckets, oldbucket);
+				check_bucket = bucket;
+			}
 		}
-		if (e->hash != HASH_NIL) {
-			  assert (i < index + st->max_probes);
-			  assert (index <= i);
+		bucket++;
+		i = 0;
+	}
+	if(check_bucket < 0 && !EVACUATED(b)) {
+		// The common case: the bucket holds current data.
+		for(; i < BUCKETSIZE; i++) {
+			if(b->tophash[i] == 0)
+				continue;
+			v = VALUE(b, i);
+			goto found;
 		}
-		e = HASH_OFFSET (e, elemsize);
-		i++;
 	}
-}
-
-static void
-hash_visit (Hmap *h, void (*data_visit) (void *arg, int32 level, void *data), void *arg)
-{
-	hash_visit_internal (h->st, 0, 0, data_visit, arg);
+	for(; i < BUCKETSIZE; i++) {
+		if(b->tophash[i] == 0)
+			continue;
+		k = KEY(b, i);
+		if(check_bucket >= 0) {
+			hash = HASH(k);
+			if((hash & (((uintptr)1 << it->B) - 1)) != check_bucket)
+				continue;
+		}
+		if(!EVACUATED(b))
+			v = VALUE(b, i);
+		else if((v = hash_lookup(h, k)) == nil)
+			continue;
+	found:
+		it->key = KEY(b, i);
+		it->value = INDIRECT(v);
+		it->bptr = b;
+		it->bucket = bucket;
+		it->check_bucket = check_bucket;
+		it->i = i+1;
+		runtime·markdirty(it, sizeof *it);
+		return;
+	}
+	b = OVERFLOW(b);
+	i = 0;
+	goto next;
 }
 
 //
 /// interfaces to go runtime
 //
 
-// hash requires < 256 bytes of data (key+value) stored inline.
-// Only basic types can be key - biggest is complex128 (16 bytes).
-// Leave some room to grow, just in case.
-enum {
-	MaxValsize = 256 - 64
-};
-
-static void
-donothing(uint32 s, void *a, void *b)
-{
-	USED(s);
-	USED(a);
-	USED(b);
-}
-
-static void
-freedata(uint32 datavo, void *a, void *b)
-{
-	void *p;
-
-	USED(a);
-	p = *(void**)((byte*)b + datavo);
-	free(p);
-}
-
-static void**
-hash_indirect(Hmap *h, void *p)
-{
-	if(h->indirectval)
-		p = *(void**)p;
-	return p;
-}	
-
-static	int32	debug	= 0;
 
-// makemap(key, val *Type, hint uint32) (hmap *map[any]any);
+// makemap(mapType *Type, hint uint32) (hmap *map[any]any);
 Hmap*
-runtime·makemap_c(Type *key, Type *val, int64 hint)
+runtime·makemap_c(MapType *t, int64 hint)
 {
 	Hmap *h;
-	int32 keyalg, valalg, keysize, valsize, valsize_in_hash;
-	void (*data_del)(uint32, void*, void*);
+	Type *key, *val;
+	int32 keyalg, valalg, keysize, valsize;
 
 	if(hint < 0 || (int32)hint != hint)
 		runtime·panicstring("makemap: size out of range");
 
+	key = t->key;
+	val = t->elem;
 	keyalg = key->alg;
 	valalg = val->alg;
 	keysize = key->size;
@@ -716,30 +457,31 @@ runtime·makemap_c(Type *key, Type *val, int64 hint)
 		runtime·throw("runtime.makemap: unsupported map value type");
 	}
 
-	h = runtime·mal(sizeof(*h));
+	if(keysize > MAXKEYSIZE) {
+		runtime·printf("map(keysize=%d)\n", keysize);
+		runtime·throw("runtime.makemap: unsupported map key type");
+	}
 
-	valsize_in_hash = valsize;
-	data_del = donothing;
-	if (valsize > MaxValsize) {
-		h->indirectval = 1;
-		data_del = freedata;
-		valsize_in_hash = sizeof(void*);
-	} 
-
-	// align value inside data so that mark-sweep gc can find it.
-	// might remove in the future and just assume datavo == keysize.
-	h->datavo = keysize;
-	if(valsize_in_hash >= sizeof(void*))
-		h->datavo = runtime·rnd(keysize, sizeof(void*));
-
-	hash_init(h, h->datavo+valsize_in_hash,
-		runtime·algarray[keyalg].hash,
-		runtime·algarray[keyalg].equal,
-		data_del,
-		hint);
+	h = runtime·mal(sizeof(*h));
 
+	h->type = t;
+	h->hash0 = runtime·fastrand1();
 	h->keysize = keysize;
 	h->valsize = valsize;
+	h->valuesize = valsize;
+	if(valsize > MAXVALUESIZE) {
+		h->flags |= IndirectValue;
+		h->valuesize = sizeof(void*);
+	}
+	h->bucketsize = sizeof(Bucket) + BUCKETSIZE*(h->keysize + h->valuesize);
+	if(t->bucket != nil && t->bucket[0]*sizeof(uintptr) != h->bucketsize)
+		runtime·throw("runtime.makemap: bucket bitmap does not match");
+
+	// Enough buckets for hint entries at the maximum load.
+	while(hint > BUCKETSIZE && 2*(uint64)hint > ((uint64)LOAD2 << h->B))
+		h->B++;
+	h->buckets = runtime·malgc((uintptr)h->bucketsize << h->B, h->type->bucket);
+
 	h->keyalg = &runtime·algarray[keyalg];
 	h->valalg = &runtime·algarray[valalg];
 
@@ -768,11 +510,11 @@ runtime·makemap_c(Type *key, Type *val, int64 hint)
 	return h;
 }
 
-// makemap(key, val *Type, hint int64) (hmap *map[any]any);
+// makemap(mapType *Type, hint int64) (hmap *map[any]any);
 void
-runtime·makemap(Type *key, Type *val, int64 hint, Hmap *ret)
+runtime·makemap(MapType *t, int64 hint, Hmap *ret)
 {
-	ret = runtime·makemap_c(key, val, hint);
+	ret = runtime·makemap_c(t, hint);
 	FLUSH(&ret);
 }
 
@@ -787,10 +529,10 @@ runtime·mapaccess(Hmap *h, byte *ak, byte *av, bool *pres)
 	if(runtime·gcwaiting)
 		runtime·gosched();
 
-	res = nil;
-	if(hash_lookup(h, ak, (void**)&res)) {
+	res = hash_lookup(h, ak);
+	if(res != nil) {
 		*pres = true;
-		h->valalg->copy(h->valsize, av, hash_indirect(h, res+h->datavo));
+		h->valalg->copy(h->valsize, av, INDIRECT(res));
 	} else {
 		*pres = false;
 		h->valalg->copy(h->valsize, av, nil);
@@ -859,7 +601,7 @@ void
 runtime·mapassign(Hmap *h, byte *ak, byte *av)
 {
 	byte *res;
-	int32 hit;
+	bool hit;
 
 	if(h == nil)
 		runtime·panicstring("assignment to entry in nil map");
@@ -867,17 +609,13 @@ runtime·mapassign(Hmap *h, byte *ak, byte *av)
 	if(runtime·gcwaiting)
 		runtime·gosched();
 
-	res = nil;
 	if(av == nil) {
-		hash_remove(h, ak, (void**)&res);
+		hash_remove(h, ak);
 		return;
 	}
 
-	hit = hash_insert(h, ak, (void**)&res);
-	if(!hit && h->indirectval)
-		*(void**)(res+h->datavo) = runtime·mal(h->valsize);
-	h->keyalg->copy(h->keysize, res, ak);
-	h->valalg->copy(h->valsize, hash_indirect(h, res+h->datavo), av);
+	res = hash_insert(h, ak, &hit);
+	h->valalg->copy(h->valsize, INDIRECT(res), av);
 
 	if(debug) {
 		runtime·prints("mapassign: map=");
@@ -887,7 +625,7 @@ runtime·mapassign(Hmap *h, byte *ak, byte *av)
 		runtime·prints("; val=");
 		h->valalg->print(h->valsize, av);
 		runtime·prints("; hit=");
-		runtime·printint(hit);
+		runtime·printbool(hit);
 		runtime·prints("; res=");
 		runtime·printpointer(res);
 		runtime·prints("\n");
@@ -943,18 +681,18 @@ void
 runtime·mapiterinit(Hmap *h, struct hash_iter *it)
 {
 	if(h == nil) {
-		it->data = nil;
+		it->key = nil;
 		return;
 	}
 	hash_iter_init(h, it);
-	it->data = hash_next(it);
+	hash_next(it);
 	if(debug) {
 		runtime·prints("runtime.mapiterinit: map=");
 		runtime·printpointer(h);
 		runtime·prints("; iter=");
 		runtime·printpointer(it);
-		runtime·prints("; data=");
-		runtime·printpointer(it->data);
+		runtime·prints("; key=");
+		runtime·printpointer(it->key);
 		runtime·prints("\n");
 	}
 }
@@ -976,12 +714,12 @@ runtime·mapiternext(struct hash_iter *it)
 	if(runtime·gcwaiting)
 		runtime·gosched();
 
-	it->data = hash_next(it);
+	hash_next(it);
 	if(debug) {
 		runtime·prints("runtime.mapiternext: iter=");
 		runtime·printpointer(it);
-		runtime·prints("; data=");
-		runtime·printpointer(it->data);
+		runtime·prints("; key=");
+		runtime·printpointer(it->key);
 		runtime·prints("\n");
 	}
 }
@@ -997,11 +735,11 @@ runtime·mapiter1(struct hash_iter *it, ...)
 	h = it->h;
 	ak = (byte*)&it + h->ko0;
 
-	res = it->data;
+	res = it->key;
 	if(res == nil)
 		runtime·throw("runtime.mapiter1: key:val nil pointer");
 
-	h->keyalg->copy(h->keysize, ak, res);
+	COPY(h->keyalg, h->keysize, ak, res);
 
 	if(debug) {
 		runtime·prints("mapiter2: iter=");
@@ -1019,10 +757,11 @@ runtime·mapiterkey(struct hash_iter *it, void *ak)
 	byte *res;
 
 	h = it->h;
-	res = it->data;
+	res = it->key;
 	if(res == nil)
 		return false;
-	h->keyalg->copy(h->keysize, ak, res);
+	COPY(h->keyalg, h->keysize, ak, res);
+	runtime·markdirty(ak, h->keysize);
 	return true;
 }
 
@@ -1038,12 +777,12 @@ runtime·mapiter2(struct hash_iter *it, ...)
 	ak = (byte*)&it + h->ko0;
 	av = (byte*)&it + h->vo0;
 
-	res = it->data;
+	res = it->key;
 	if(res == nil)
 		runtime·throw("runtime.mapiter2: key:val nil pointer");
 
-	h->keyalg->copy(h->keysize, ak, res);
-	h->valalg->copy(h->valsize, av, hash_indirect(h, res+h->datavo));
+	COPY(h->keyalg, h->keysize, ak, res);
+	COPY(h->valalg, h->valsize, av, it->value);
 
 	if(debug) {
 		runtime·prints("mapiter2: iter=");
@@ -1053,3 +792,101 @@ runtime·mapiter2(struct hash_iter *it, ...)
 		runtime·prints("\n");
 	}
 }
+
+// Lookups specialized for the common key types.  The compiler calls
+// them for m[k] when the key is a 32- or 64-bit integer (or pointer)
+// or a string and the value is at most MAXVALUESIZE bytes, so that the
+// value is in the bucket.  They compare keys inline and return a
+// pointer to the value, or to a zero value if the key is missing.
+
+// mapaccess1_fast32(hmap map[any]any, key any) (val *any);
+void
+runtime·mapaccess1_fast32(Hmap *h, uint32 key, byte *value)
+{
+	uintptr hash;
+	uint8 top;
+	Bucket *b;
+	int32 i;
+
+	if(h == nil)
+		runtime·panicstring("lookup in nil map");
+	if(runtime·gcwaiting)
+		runtime·gosched();
+
+	value = empty_value;
+	hash = h->keyalg->hash(sizeof key, &key, h->hash0);
+	top = TOPHASH(hash);
+	for(b = LOOKUPBUCKET(hash); b != nil; b = OVERFLOW(b)) {
+		for(i = 0; i < BUCKETSIZE; i++) {
+			if(b->tophash[i] == top && ((uint32*)(b+1))[i] == key) {
+				value = VALUE(b, i);
+				goto done;
+			}
+		}
+	}
+done:
+	FLUSH(&value);
+}
+
+// mapaccess1_fast64(hmap map[any]any, key any) (val *any);
+void
+runtime·mapaccess1_fast64(Hmap *h, uint64 key, byte *value)
+{
+	uintptr hash;
+	uint8 top;
+	Bucket *b;
+	int32 i;
+
+	if(h == nil)
+		runtime·panicstring("lookup in nil map");
+	if(runtime·gcwaiting)
+		runtime·gosched();
+
+	value = empty_value;
+	hash = h->keyalg->hash(sizeof key, &key, h->hash0);
+	top = TOPHASH(hash);
+	for(b = LOOKUPBUCKET(hash); b != nil; b = OVERFLOW(b)) {
+		for(i = 0; i < BUCKETSIZE; i++) {
+			if(b->tophash[i] == top && ((uint64*)(b+1))[i] == key) {
+				value = VALUE(b, i);
+				goto done;
+			}
+		}
+	}
+done:
+	FLUSH(&value);
+}
+
+// mapaccess1_faststr(hmap map[any]any, key any) (val *any);
+void
+runtime·mapaccess1_faststr(Hmap *h, String key, byte *value)
+{
+	uintptr hash;
+	uint8 top;
+	Bucket *b;
+	String *k;
+	int32 i, j;
+
+	if(h == nil)
+		runtime·panicstring("lookup in nil map");
+	if(runtime·gcwaiting)
+		runtime·gosched();
+
+	value = empty_value;
+	hash = h->keyalg->hash(sizeof key, &key, h->hash0);
+	top = TOPHASH(hash);
+	for(b = LOOKUPBUCKET(hash); b != nil; b = OVERFLOW(b)) {
+		for(i = 0, k = (String*)(b+1); i < BUCKETSIZE; i++, k++) {
+			if(b->tophash[i] != top || k->len != key.len)
+				continue;
+			for(j = 0; j < key.len && k->str[j] == key.str[j]; j++)
+				;
+			if(j == key.len) {
+				value = VALUE(b, i);
+				goto done;
+			}
+		}
+	}
+done:
+	FLUSH(&value);
+}
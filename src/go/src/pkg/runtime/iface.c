@@ -157,7 +157,7 @@ copyin(Type *t, void *src, void **dst)
 	if(wid <= sizeof(*dst))
 		runtime·algarray[alg].copy(wid, dst, src);
 	else {
-		p = runtime·mal(wid);
+		p = runtime·cnew(t, 1);
 		runtime·algarray[alg].copy(wid, p, src);
 		*dst = p;
 	}
@@ -513,13 +513,13 @@ runtime·assertE2E2(InterfaceType* inter, Eface e, Eface ret, bool ok)
 }
 
 static uintptr
-ifacehash1(void *data, Type *t)
+ifacehash1(void *data, Type *t, uintptr seed)
 {
 	int32 alg, wid;
 	Eface err;
 
 	if(t == nil)
-		return 0;
+		return seed;
 
 	alg = t->alg;
 	wid = t->size;
@@ -530,22 +530,22 @@ ifacehash1(void *data, Type *t)
 		runtime·panic(err);
 	}
 	if(wid <= sizeof(data))
-		return runtime·algarray[alg].hash(wid, &data);
-	return runtime·algarray[alg].hash(wid, data);
+		return runtime·algarray[alg].hash(wid, &data, seed);
+	return runtime·algarray[alg].hash(wid, data, seed);
 }
 
 uintptr
-runtime·ifacehash(Iface a)
+runtime·ifacehash(Iface a, uintptr seed)
 {
 	if(a.tab == nil)
-		return 0;
-	return ifacehash1(a.data, a.tab->type);
+		return seed;
+	return ifacehash1(a.data, a.tab->type, seed);
 }
 
 uintptr
-runtime·efacehash(Eface a)
+runtime·efacehash(Eface a, uintptr seed)
 {
-	return ifacehash1(a.data, a.type);
+	return ifacehash1(a.data, a.type, seed);
 }
 
 static bool
@@ -666,7 +666,7 @@ unsafe·Reflect(Eface e, Eface rettype, void *retaddr)
 		} else {
 			// Already a pointer, but still make a copy,
 			// to preserve value semantics for interface data.
-			p = runtime·mal(e.type->size);
+			p = runtime·cnew(e.type, 1);
 			runtime·algarray[e.type->alg].copy(e.type->size, p, e.data);
 		}
 		retaddr = p;
@@ -708,17 +708,13 @@ unsafe·New(Eface typ, void *ret)
 	// type structure sits before the data pointer.
 	t = (Type*)((Eface*)typ.data-1);
 
-	if(t->kind&KindNoPointers)
-		ret = runtime·mallocgc(t->size, FlagNoPointers, 1, 1);
-	else
-		ret = runtime·mal(t->size);
+	ret = runtime·cnew(t, 1);
 	FLUSH(&ret);
 }
 
 void
 unsafe·NewArray(Eface typ, uint32 n, void *ret)
 {
-	uint64 size;
 	Type *t;
 
 	// Reflect library has reinterpreted typ
@@ -727,10 +723,6 @@ unsafe·NewArray(Eface typ, uint32 n, void *ret)
 	// type structure sits before the data pointer.
 	t = (Type*)((Eface*)typ.data-1);
 	
-	size = n*t->size;
-	if(t->kind&KindNoPointers)
-		ret = runtime·mallocgc(size, FlagNoPointers, 1, 1);
-	else
-		ret = runtime·mal(size);
+	ret = runtime·cnew(t, n);
 	FLUSH(&ret);
 }
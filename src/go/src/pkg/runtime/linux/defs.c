@@ -29,6 +29,8 @@ enum {
 	$MAP_PRIVATE = MAP_PRIVATE,
 	$MAP_FIXED = MAP_FIXED,
 
+	$MADV_DONTNEED = MADV_DONTNEED,
+
 	$SA_RESTART = SA_RESTART,
 	$SA_ONSTACK = SA_ONSTACK,
 	$SA_RESTORER = SA_RESTORER,
@@ -206,6 +206,20 @@ runtime·notesleep(Note *n)
 	futexunlock(&n->lock);	// Let other sleepers find out too.
 }
 
+// Sleep for usec microseconds, or less if a signal comes in:
+// a futex wait on a word nobody else knows about times out.
+void
+runtime·usleep(uint32 usec)
+{
+	Timespec ts;
+	uint32 w;
+
+	ts.tv_sec = usec/1000000;
+	ts.tv_nsec = (usec%1000000)*1000;
+	w = 0;
+	runtime·futex(&w, FUTEX_WAIT, 0, &ts, nil, 0);
+}
+
 
 // Clone, the Linux rfork.
 enum
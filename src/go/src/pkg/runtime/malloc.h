@@ -26,15 +26,18 @@
 // Allocating a small object proceeds up a hierarchy of caches:
 //
 //	1. Round the size up to one of the small size classes
-//	   and look in the corresponding MCache free list.
-//	   If the list is not empty, allocate an object from it.
-//	   This can all be done without acquiring a lock.
+//	   and look at the free list of the span the MCache owns
+//	   for that class.  If the list is not empty, allocate
+//	   an object from it.  This can all be done without
+//	   acquiring a lock or using atomic instructions.
 //
-//	2. If the MCache free list is empty, replenish it by
-//	   taking a bunch of objects from the MCentral free list.
-//	   Moving a bunch amortizes the cost of acquiring the MCentral lock.
+//	2. If the span has no free objects left, take those other
+//	   threads freed into it, or else hand it back to the MCentral
+//	   and take another span with free objects from it, sweeping
+//	   the garbage of the last collection as needed.  Moving a
+//	   whole span amortizes the cost of acquiring the MCentral lock.
 //
-//	3. If the MCentral free list is empty, replenish it by
+//	3. If the MCentral has no span with free objects, replenish it by
 //	   allocating a run of pages from the MHeap and then
 //	   chopping that memory into a objects of the given size.
 //	   Allocating many objects amortizes the cost of locking
@@ -47,14 +50,16 @@
 //
 // Freeing a small object proceeds up the same hierarchy:
 //
-//	1. Look up the size class for the object and add it to
-//	   the MCache free list.
+//	1. Look up the span of the object.  If the MCache owns it,
+//	   add the object to the span's free list.
 //
-//	2. If the MCache free list is too long or the MCache has
-//	   too much memory, return some to the MCentral free lists.
+//	2. If another MCache owns the span, push the object on the
+//	   span's freebuf without locking, for that MCache to take.
+//	   Otherwise add it to the span's free list under the
+//	   MCentral lock.
 //
 //	3. If all the objects in a given span have returned to
-//	   the MCentral list, return that span to the page heap.
+//	   the MCentral, return that span to the page heap.
 //
 //	4. If the heap has too much memory, return some to the
 //	   operating system.
@@ -86,6 +91,7 @@ typedef struct MHeap	MHeap;
 typedef struct MSpan	MSpan;
 typedef struct MStats	MStats;
 typedef struct MLink	MLink;
+typedef struct MTypes	MTypes;
 
 enum
 {
@@ -108,10 +114,11 @@ enum
 	MaxSmallSize = 32<<10,
 
 	FixAllocChunk = 128<<10,	// Chunk size for FixAlloc
-	MaxMCacheListLen = 256,		// Maximum objects on MCacheList
-	MaxMCacheSize = 2<<20,		// Maximum bytes in one MCache
 	MaxMHeapList = 1<<(20 - PageShift),	// Maximum page length for fixed-size list in MHeap.
 	HeapAllocChunk = 1<<20,		// Chunk size for heap growth
+	NumPauseHist = 32,		// Buckets of MStats.pause_hist
+	MTypesTab = 16,			// Types recorded in an MTypes itself
+	MTypesMax = 256,		// Types recorded per span, see MTypes
 
 	// Number of bits in page to span calculations (4k pages).
 	// On 64-bit, we limit the arena to 16G, so 22 bits suffices.
@@ -137,7 +144,8 @@ struct MLink
 // SysUnused notifies the operating system that the contents
 // of the memory region are no longer needed and can be reused
 // for other purposes.  The program reserves the right to start
-// accessing those pages in the future.
+// accessing those pages in the future; they must then read
+// either as zeros or as they were, the whole region alike.
 //
 // SysFree returns it unconditionally; this is only used if
 // an out-of-memory error has been detected midway through
@@ -200,6 +208,7 @@ struct MStats
 	uint64	heap_sys;	// bytes obtained from system
 	uint64	heap_idle;	// bytes in idle spans
 	uint64	heap_inuse;	// bytes in non-idle spans
+	uint64	heap_released;	// bytes of idle spans released to the OS
 	uint64	heap_objects;	// total number of allocated objects
 
 	// Statistics about allocation of low-level fixed-size structures.
@@ -215,8 +224,10 @@ struct MStats
 	// Statistics about garbage collector.
 	// Protected by stopping the world during GC.
 	uint64	next_gc;	// next GC (in heap_alloc time)
+	uint64	last_gc;	// last GC (in absolute time)
 	uint64	pause_total_ns;
-	uint64	pause_ns[256];
+	uint64	pause_ns[256];	// both pauses of a concurrent collection
+	uint64	pause_hist[NumPauseHist];	// pauses of [2^i, 2^(i+1)) microseconds, the first and last open ended
 	uint32	numgc;
 	bool	enablegc;
 	bool	debuggc;
@@ -243,38 +254,30 @@ extern MStats mstats;
 // class_to_size[i] = largest size in class i
 // class_to_allocnpages[i] = number of pages to allocate when
 // 	making new objects in class i
-// class_to_transfercount[i] = number of objects to move when
-//	taking a bunch of objects out of the central lists
-//	and putting them in the thread free list.
+// class_to_typeshift[i] = log2 of the largest power of two
+//	dividing class_to_size[i], see MTypes.
 
 int32	runtime·SizeToClass(int32);
 extern	int32	runtime·class_to_size[NumSizeClasses];
 extern	int32	runtime·class_to_allocnpages[NumSizeClasses];
-extern	int32	runtime·class_to_transfercount[NumSizeClasses];
+extern	int32	runtime·class_to_typeshift[NumSizeClasses];
 extern	void	runtime·InitSizes(void);
 
 
 // Per-thread (in Go, per-M) cache for small objects.
-// No locking needed because it is per-thread (per-M).
-typedef struct MCacheList MCacheList;
-struct MCacheList
-{
-	MLink *list;
-	uint32 nlist;
-	uint32 nlistmin;
-};
-
+// No locking needed because it is per-thread (per-M):
+// the MCache owns one span of each size class at a time
+// and allocates from the span's free list.
 struct MCache
 {
-	MCacheList list[NumSizeClasses];
-	uint64 size;
+	MSpan *alloc[NumSizeClasses];	// span to allocate from, or nil
 	int64 local_alloc;	// bytes allocated (or freed) since last lock of heap
 	int64 local_objects;	// objects allocated (or freed) since last lock of heap
 	int32 next_sample;	// trigger heap sample after allocating this many bytes
 };
 
 void*	runtime·MCache_Alloc(MCache *c, int32 sizeclass, uintptr size, int32 zeroed);
-void	runtime·MCache_Free(MCache *c, void *p, int32 sizeclass, uintptr size);
+void	runtime·MCache_Free(MCache *c, MSpan *s, void *p, int32 sizeclass, uintptr size);
 void	runtime·MCache_ReleaseAll(MCache *c);
 
 // An MSpan is a run of pages.
@@ -293,13 +296,44 @@ struct MSpan
 	PageID	start;		// starting page number
 	uintptr	npages;		// number of pages in span
 	MLink	*freelist;	// list of free objects
+	MLink	*freebuf;	// objects freed by other Ms while in an MCache, see MCentral_Free
 	uint32	ref;		// number of allocated objects in this span
 	uint32	sizeclass;	// size class
 	uint32	state;		// MSpanInUse etc
 	byte	*limit;	// end of data in span
+	uint32	sweepgen;	// see MHeap.sweepgen
+	uintptr	types;	// see MTypes
+	int64	unusedsince;	// when the span was last freed, see MHeap_Scavenger
+	uintptr	npreleased;	// number of pages released to the OS
 };
 
 void	runtime·MSpan_Init(MSpan *span, PageID start, uintptr npages);
+void	runtime·MSpan_SetType(MSpan *span, void *v, uintptr *gc);
+
+// The types of the objects in a span, for the garbage collector
+// to find their pointers (see mgc0.c:/scanblock), kept as the
+// pointer bitmaps of the types (see type.h:/gc).
+// span->types is
+//	0: no object with pointers was allocated from the span
+//	a bitmap: the type of every object with pointers in the span;
+//		the single object of a large span always has this form
+//	an MTypes, with the MTypesTable bit set: a table of the types
+//		of the objects of a small span of mixed types.
+// The object at offset off in the span has the bitmap
+// gc[idx[off>>class_to_typeshift[sizeclass]]].  gc points at tab,
+// or at a table of MTypesMax entries once tab is full; gc[0] is
+// for the objects allocated without a type, which are scanned
+// conservatively, like the ones whose type did not fit in gc.
+enum
+{
+	MTypesTable = 1,
+};
+struct MTypes
+{
+	uintptr	**gc;
+	uintptr	*tab[MTypesTab];
+	byte	idx[1];
+};
 
 // Every MSpan is in one doubly-linked list,
 // either one of the MHeap's free lists or one of the
@@ -315,14 +349,18 @@ struct MCentral
 {
 	Lock;
 	int32 sizeclass;
-	MSpan nonempty;
-	MSpan empty;
+	MSpan nonempty;	// spans with free objects
+	MSpan empty;	// spans without, or owned by an MCache
+	MSpan unswept;
 	int32 nfree;
 };
 
 void	runtime·MCentral_Init(MCentral *c, int32 sizeclass);
-int32	runtime·MCentral_AllocList(MCentral *c, int32 n, MLink **first);
-void	runtime·MCentral_FreeList(MCentral *c, int32 n, MLink *first);
+MSpan*	runtime·MCentral_CacheSpan(MCentral *c);
+void	runtime·MCentral_UncacheSpan(MCentral *c, MSpan *s);
+void	runtime·MCentral_Free(MCentral *c, MSpan *s, void *v);
+void	runtime·MCentral_FreeSpan(MCentral *c, MSpan *s, int32 n, MLink *first, MLink *last);
+void	runtime·MCentral_StartSweep(MCentral *c);
 
 // Main malloc heap.
 // The heap itself is the "free[]" and "large" arrays,
@@ -334,8 +372,15 @@ struct MHeap
 	MSpan large;			// free lists length >= MaxMHeapList
 	MSpan *allspans;
 
+	// sweep generation, incremented by 2 each GC:
+	// if s->sweepgen == sweepgen - 2, the span needs sweeping;
+	// if s->sweepgen == sweepgen - 1, the span is being swept;
+	// if s->sweepgen == sweepgen, the span is swept and ready to use.
+	uint32 sweepgen;
+
 	// span lookup
 	MSpan *map[1<<MHeapMap_Bits];
+	byte dirty[1<<MHeapMap_Bits];	// pages stored into while marking, see mgc0.c
 
 	// range of addresses we might see in the heap
 	byte *bitmap;
@@ -355,6 +400,8 @@ struct MHeap
 
 	FixAlloc spanalloc;	// allocator for Span*
 	FixAlloc cachealloc;	// allocator for MCache*
+	FixAlloc typesalloc[NumSizeClasses];	// allocator for MTypes*, by size class
+	FixAlloc typestaballoc;	// allocator for MTypes.gc beyond MTypesTab
 };
 extern MHeap runtime·mheap;
 
@@ -366,10 +413,15 @@ MSpan*	runtime·MHeap_LookupMaybe(MHeap *h, void *v);
 void	runtime·MGetSizeClassInfo(int32 sizeclass, uintptr *size, int32 *npages, int32 *nobj);
 void*	runtime·MHeap_SysAlloc(MHeap *h, uintptr n);
 void	runtime·MHeap_MapBits(MHeap *h);
+void	runtime·MHeap_Scavenger(void);
 
 void*	runtime·mallocgc(uintptr size, uint32 flag, int32 dogc, int32 zeroed);
+void*	runtime·cnew(Type *t, uintptr n);
+void*	runtime·malgc(uintptr size, uintptr *gc);
+void	runtime·settype(void *v, uintptr *gc);
 int32	runtime·mlookup(void *v, byte **base, uintptr *size, MSpan **s);
 void	runtime·gc(int32 force);
+bool	runtime·gcassist(uintptr size);
 void	runtime·markallocated(void *v, uintptr n, bool noptr);
 void	runtime·checkallocated(void *v, uintptr n);
 void	runtime·markfreed(void *v, uintptr n);
@@ -377,6 +429,9 @@ void	runtime·checkfreed(void *v, uintptr n);
 int32	runtime·checking;
 void	runtime·markspan(void *v, uintptr size, uintptr n, bool leftover);
 void	runtime·unmarkspan(void *v, uintptr size);
+uintptr	runtime·sweepone(void);
+void	runtime·MSpan_Sweep(MSpan *s);
+void	runtime·MSpan_EnsureSwept(MSpan *s);
 bool	runtime·blockspecial(void*);
 void	runtime·setblockspecial(void*);
 
@@ -386,6 +441,7 @@ enum
 	FlagNoPointers = 1<<0,	// no pointers here
 	FlagNoProfiling = 1<<1,	// must not profile
 	FlagNoGC = 1<<2,	// must not free or scan for pointers
+	FlagTyped = 1<<3,	// caller records the type, see runtime·settype
 };
 
 void	runtime·MProf_Malloc(void*, uintptr);
@@ -410,3 +466,4 @@ struct Finalizer
 };
 
 Finalizer*	runtime·getfinalizer(void*, bool);
+int32	runtime·queuefinalizers(bool (*fn)(void*), Finalizer **q);
@@ -0,0 +1,110 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+package runtime_test
+
+import (
+	"runtime"
+	"testing"
+)
+
+type node struct {
+	next  *node
+	value int
+}
+
+// Allocate lists of nodes on several Ms at once, letting the collector
+// reuse the spans of each other's garbage, and check nothing got
+// handed out twice.
+func TestMallocParallel(t *testing.T) {
+	defer runtime.GOMAXPROCS(runtime.GOMAXPROCS(4))
+	const p = 4
+	done := make(chan bool)
+	for i := 0; i < p; i++ {
+		go func(id int) {
+			ok := true
+			for round := 0; round < 20; round++ {
+				var list *node
+				for j := 0; j < 5000; j++ {
+					list = &node{list, id<<16 | j}
+				}
+				for j := 4999; j >= 0; j-- {
+					if list.value != id<<16|j {
+						ok = false
+					}
+					list = list.next
+				}
+			}
+			done <- ok
+		}(i)
+	}
+	for i := 0; i < p; i++ {
+		if !<-done {
+			t.Errorf("a list got corrupted by another allocation")
+		}
+	}
+}
+
+var sink interface{}
+
+func BenchmarkMalloc8(b *testing.B) {
+	var x *int64
+	for i := 0; i < b.N; i++ {
+		x = new(int64)
+	}
+	sink = x
+}
+
+func BenchmarkMalloc16(b *testing.B) {
+	var x *[2]int64
+	for i := 0; i < b.N; i++ {
+		x = new([2]int64)
+	}
+	sink = x
+}
+
+func BenchmarkMallocTypeInfo16(b *testing.B) {
+	var x *node
+	for i := 0; i < b.N; i++ {
+		x = new(node)
+	}
+	sink = x
+}
+
+func BenchmarkMallocLarge(b *testing.B) {
+	var x []byte
+	for i := 0; i < b.N; i++ {
+		x = make([]byte, 1024)
+	}
+	sink = x
+}
+
+func BenchmarkMallocParallel(b *testing.B) {
+	defer runtime.GOMAXPROCS(runtime.GOMAXPROCS(4))
+	const p = 4
+	done := make(chan bool)
+	for i := 0; i < p; i++ {
+		go func() {
+			var x *node
+			for j := 0; j < b.N/p; j++ {
+				x = new(node)
+			}
+			done <- x != nil
+		}()
+	}
+	for i := 0; i < p; i++ {
+		<-done
+	}
+}
+
+func deferred() {
+	defer func() {}()
+}
+
+// Each defer allocates its record and frees it on return.
+func BenchmarkMallocFreeDefer(b *testing.B) {
+	for i := 0; i < b.N; i++ {
+		deferred()
+	}
+}
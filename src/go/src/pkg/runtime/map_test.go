@@ -0,0 +1,134 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+package runtime_test
+
+import (
+	"strconv"
+	"testing"
+)
+
+const mapSize = 1 << 16
+
+// Maps with the same keys hash them with different seeds,
+// so they do not all iterate in the same order.
+func TestMapHashSeed(t *testing.T) {
+	order := func() string {
+		m := make(map[int]bool)
+		for i := 0; i < 64; i++ {
+			m[i] = true
+		}
+		s := ""
+		for k := range m {
+			s += strconv.Itoa(k) + " "
+		}
+		return s
+	}
+	first := order()
+	for i := 0; i < 10; i++ {
+		if order() != first {
+			return
+		}
+	}
+	t.Errorf("11 maps iterate in the same order: %s", first)
+}
+
+func BenchmarkMapInt32Lookup(b *testing.B) {
+	b.StopTimer()
+	m := make(map[int32]int32)
+	for i := int32(0); i < mapSize; i++ {
+		m[i] = i
+	}
+	b.StartTimer()
+	for i := 0; i < b.N; i++ {
+		_ = m[int32(i&(mapSize-1))]
+	}
+}
+
+func BenchmarkMapInt64Lookup(b *testing.B) {
+	b.StopTimer()
+	m := make(map[int64]int64)
+	for i := int64(0); i < mapSize; i++ {
+		m[i] = i
+	}
+	b.StartTimer()
+	for i := 0; i < b.N; i++ {
+		_ = m[int64(i&(mapSize-1))]
+	}
+}
+
+func BenchmarkMapStringLookup(b *testing.B) {
+	b.StopTimer()
+	keys := make([]string, mapSize)
+	m := make(map[string]int)
+	for i := range keys {
+		keys[i] = strconv.Itoa(i)
+		m[keys[i]] = i
+	}
+	b.StartTimer()
+	for i := 0; i < b.N; i++ {
+		_ = m[keys[i&(mapSize-1)]]
+	}
+}
+
+func BenchmarkMapStringMiss(b *testing.B) {
+	b.StopTimer()
+	m := make(map[string]int)
+	for i := 0; i < mapSize; i++ {
+		m[strconv.Itoa(i)] = i
+	}
+	b.StartTimer()
+	for i := 0; i < b.N; i++ {
+		_ = m["miss"]
+	}
+}
+
+func BenchmarkMapInterfaceLookup(b *testing.B) {
+	b.StopTimer()
+	m := make(map[interface{}]int)
+	for i := 0; i < mapSize; i++ {
+		m[i] = i
+	}
+	b.StartTimer()
+	for i := 0; i < b.N; i++ {
+		_ = m[i&(mapSize-1)]
+	}
+}
+
+func BenchmarkMapInsert(b *testing.B) {
+	m := make(map[int]int)
+	for i := 0; i < b.N; i++ {
+		m[i] = i
+	}
+}
+
+func BenchmarkMapInsertDelete(b *testing.B) {
+	m := make(map[int]int)
+	for i := 0; i < b.N; i++ {
+		m[i&(mapSize-1)] = i
+		m[(i+mapSize/2)&(mapSize-1)] = 0, false
+	}
+}
+
+func BenchmarkMapIncrement(b *testing.B) {
+	m := make(map[string]int)
+	keys := []string{"GGT", "GGTA", "GGTATT", "GGTATTTTAATT"}
+	for i := 0; i < b.N; i++ {
+		m[keys[i&3]]++
+	}
+}
+
+func BenchmarkMapIterate(b *testing.B) {
+	b.StopTimer()
+	m := make(map[int]int)
+	for i := 0; i < 1000; i++ {
+		m[i] = i
+	}
+	b.StartTimer()
+	for i := 0; i < b.N; i++ {
+		for _, v := range m {
+			_ = v
+		}
+	}
+}
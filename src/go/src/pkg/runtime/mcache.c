@@ -9,29 +9,52 @@
 #include "runtime.h"
 #include "malloc.h"
 
+// Get a span with free objects of the given size class:
+// the one c owns, if other Ms have freed objects into it,
+// or a new one from the central lists.
+static MSpan*
+MCache_Refill(MCache *c, int32 sizeclass)
+{
+	MSpan *s;
+	MLink *v, *p;
+
+	s = c->alloc[sizeclass];
+	if(s != nil) {
+		// Take the objects other Ms freed into s (see MCentral_Free).
+		for(;;) {
+			v = s->freebuf;
+			if(v == nil || runtime·casp((void**)&s->freebuf, v, nil))
+				break;
+		}
+		if(v != nil) {
+			s->freelist = v;
+			for(p=v; p; p=p->next)
+				s->ref--;
+			return s;
+		}
+		runtime·MCentral_UncacheSpan(&runtime·mheap.central[sizeclass], s);
+	}
+	s = runtime·MCentral_CacheSpan(&runtime·mheap.central[sizeclass]);
+	c->alloc[sizeclass] = s;
+	return s;
+}
+
 void*
 runtime·MCache_Alloc(MCache *c, int32 sizeclass, uintptr size, int32 zeroed)
 {
-	MCacheList *l;
-	MLink *first, *v;
-	int32 n;
+	MSpan *s;
+	MLink *v;
 
-	// Allocate from list.
-	l = &c->list[sizeclass];
-	if(l->list == nil) {
-		// Replenish using central lists.
-		n = runtime·MCentral_AllocList(&runtime·mheap.central[sizeclass],
-			runtime·class_to_transfercount[sizeclass], &first);
-		l->list = first;
-		l->nlist = n;
-		c->size += n*size;
+	// Allocate from the free list of the span we own.
+	s = c->alloc[sizeclass];
+	if(s == nil || s->freelist == nil) {
+		s = MCache_Refill(c, sizeclass);
+		if(s == nil)
+			return nil;
 	}
-	v = l->list;
-	l->list = v->next;
-	l->nlist--;
-	if(l->nlist < l->nlistmin)
-		l->nlistmin = l->nlist;
-	c->size -= size;
+	v = s->freelist;
+	s->freelist = v->next;
+	s->ref++;
 
 	// v is zeroed except for the link pointer
 	// that we used above; zero that.
@@ -51,81 +74,35 @@ runtime·MCache_Alloc(MCache *c, int32 sizeclass, uintptr size, int32 zeroed)
 	return v;
 }
 
-// Take n elements off l and return them to the central free list.
-static void
-ReleaseN(MCache *c, MCacheList *l, int32 n, int32 sizeclass)
-{
-	MLink *first, **lp;
-	int32 i;
-
-	// Cut off first n elements.
-	first = l->list;
-	lp = &l->list;
-	for(i=0; i<n; i++)
-		lp = &(*lp)->next;
-	l->list = *lp;
-	*lp = nil;
-	l->nlist -= n;
-	if(l->nlist < l->nlistmin)
-		l->nlistmin = l->nlist;
-	c->size -= n*runtime·class_to_size[sizeclass];
-
-	// Return them to central free list.
-	runtime·MCentral_FreeList(&runtime·mheap.central[sizeclass], n, first);
-}
-
+// Free v, an object of the span s.
 void
-runtime·MCache_Free(MCache *c, void *v, int32 sizeclass, uintptr size)
+runtime·MCache_Free(MCache *c, MSpan *s, void *v, int32 sizeclass, uintptr size)
 {
-	int32 i, n;
-	MCacheList *l;
 	MLink *p;
 
-	// Put back on list.
-	l = &c->list[sizeclass];
-	p = v;
-	p->next = l->list;
-	l->list = p;
-	l->nlist++;
-	c->size += size;
 	c->local_alloc -= size;
 	c->local_objects--;
 
-	if(l->nlist >= MaxMCacheListLen) {
-		// Release a chunk back.
-		ReleaseN(c, l, runtime·class_to_transfercount[sizeclass], sizeclass);
-	}
-
-	if(c->size >= MaxMCacheSize) {
-		// Scavenge.
-		for(i=0; i<NumSizeClasses; i++) {
-			l = &c->list[i];
-			n = l->nlistmin;
-
-			// n is the minimum number of elements we've seen on
-			// the list since the last scavenge.  If n > 0, it means that
-			// we could have gotten by with n fewer elements
-			// without needing to consult the central free list.
-			// Move toward that situation by releasing n/2 of them.
-			if(n > 0) {
-				if(n > 1)
-					n /= 2;
-				ReleaseN(c, l, n, i);
-			}
-			l->nlistmin = l->nlist;
-		}
+	if(s == c->alloc[sizeclass]) {
+		// Ours: put back on its free list.
+		p = v;
+		p->next = s->freelist;
+		s->freelist = p;
+		s->ref--;
+		return;
 	}
+	runtime·MCentral_Free(&runtime·mheap.central[sizeclass], s, v);
 }
 
 void
 runtime·MCache_ReleaseAll(MCache *c)
 {
 	int32 i;
-	MCacheList *l;
 
 	for(i=0; i<NumSizeClasses; i++) {
-		l = &c->list[i];
-		ReleaseN(c, l, l->nlist, i);
-		l->nlistmin = 0;
+		if(c->alloc[i] != nil) {
+			runtime·MCentral_UncacheSpan(&runtime·mheap.central[i], c->alloc[i]);
+			c->alloc[i] = nil;
+		}
 	}
 }
@@ -8,18 +8,19 @@
 //
 // The MCentral doesn't actually contain the list of free objects; the MSpan does.
 // Each MCentral is two lists of MSpans: those with free objects (c->nonempty)
-// and those that are completely allocated (c->empty).
-//
-// TODO(rsc): tcmalloc uses a "transfer cache" to split the list
-// into sections of class_to_transfercount[sizeclass] objects
-// so that it is faster to move those lists between MCaches and MCentrals.
+// and those that are completely allocated or owned by an MCache (c->empty).
+// A third list holds the spans not yet swept since the last garbage
+// collection (c->unswept); they move to one of the other two, or back to
+// the heap, as they are swept.  MCaches take whole spans, so the lock is
+// taken once per span of objects allocated, not once per object.
 
 #include "runtime.h"
 #include "malloc.h"
 
 static bool MCentral_Grow(MCentral *c);
-static void* MCentral_Alloc(MCentral *c);
-static void MCentral_Free(MCentral *c, void *v);
+static bool MCentral_Sweep(MCentral *c);
+static void MCentral_ReturnToHeap(MCentral *c, MSpan *s);
+static void MSpanList_Move(MSpan *to, MSpan *from);
 
 // Initialize a single central free list.
 void
@@ -28,97 +29,100 @@ runtime·MCentral_Init(MCentral *c, int32 sizeclass)
 	c->sizeclass = sizeclass;
 	runtime·MSpanList_Init(&c->nonempty);
 	runtime·MSpanList_Init(&c->empty);
+	runtime·MSpanList_Init(&c->unswept);
 }
 
-// Allocate up to n objects from the central free list.
-// Return the number of objects allocated.
-// The objects are linked together by their first words.
-// On return, *pstart points at the first object and *pend at the last.
-int32
-runtime·MCentral_AllocList(MCentral *c, int32 n, MLink **pfirst)
+// Spans owned by an MCache have s->freebuf open for the other Ms
+// to push the objects they free without locking; the others have it
+// closed, set to SpanUncached, and frees go to s->freelist under the lock.
+#define SpanUncached ((MLink*)1)
+
+// Take a span with free objects out of c for an MCache to allocate from,
+// preferring the garbage of the last collection to new memory.
+// The MCache owns s->freelist until it hands s back with MCentral_UncacheSpan.
+MSpan*
+runtime·MCentral_CacheSpan(MCentral *c)
 {
-	MLink *first, *last, *v;
-	int32 i;
+	MSpan *s;
+	int32 npages, n;
+	uintptr size;
 
 	runtime·lock(c);
-	// Replenish central list if empty.
-	if(runtime·MSpanList_IsEmpty(&c->nonempty)) {
+	if(runtime·MSpanList_IsEmpty(&c->nonempty) && !MCentral_Sweep(c)) {
 		if(!MCentral_Grow(c)) {
 			runtime·unlock(c);
-			*pfirst = nil;
-			return 0;
+			return nil;
 		}
 	}
-
-	// Copy from list, up to n.
-	// First one is guaranteed to work, because we just grew the list.
-	first = MCentral_Alloc(c);
-	last = first;
-	for(i=1; i<n && (v = MCentral_Alloc(c)) != nil; i++) {
-		last->next = v;
-		last = v;
-	}
-	last->next = nil;
-	c->nfree -= i;
-
-	runtime·unlock(c);
-	*pfirst = first;
-	return i;
-}
-
-// Helper: allocate one object from the central free list.
-static void*
-MCentral_Alloc(MCentral *c)
-{
-	MSpan *s;
-	MLink *v;
-
-	if(runtime·MSpanList_IsEmpty(&c->nonempty))
-		return nil;
 	s = c->nonempty.next;
-	s->ref++;
-	v = s->freelist;
-	s->freelist = v->next;
-	if(s->freelist == nil) {
-		runtime·MSpanList_Remove(s);
-		runtime·MSpanList_Insert(&c->empty, s);
-	}
-	return v;
+	runtime·MGetSizeClassInfo(c->sizeclass, &size, &npages, &n);
+	c->nfree -= n - s->ref;
+	runtime·MSpanList_Remove(s);
+	runtime·MSpanList_Insert(&c->empty, s);
+	s->freebuf = nil;
+	runtime·unlock(c);
+	return s;
 }
 
-// Free n objects back into the central free list.
-// Return the number of objects allocated.
-// The objects are linked together by their first words.
-// On return, *pstart points at the first object and *pend at the last.
+// Take back the span s from an MCache, with the objects
+// it did not allocate and those other Ms freed into it.
 void
-runtime·MCentral_FreeList(MCentral *c, int32 n, MLink *start)
+runtime·MCentral_UncacheSpan(MCentral *c, MSpan *s)
 {
 	MLink *v, *next;
-
-	// Assume next == nil marks end of list.
-	// n and end would be useful if we implemented
-	// the transfer cache optimization in the TODO above.
-	USED(n);
+	int32 npages, n;
+	uintptr size;
 
 	runtime·lock(c);
-	for(v=start; v; v=next) {
+	for(;;) {
+		v = s->freebuf;
+		if(runtime·casp((void**)&s->freebuf, v, SpanUncached))
+			break;
+	}
+	for(; v; v=next) {
 		next = v->next;
-		MCentral_Free(c, v);
+		v->next = s->freelist;
+		s->freelist = v;
+		s->ref--;
+	}
+	runtime·MGetSizeClassInfo(c->sizeclass, &size, &npages, &n);
+	c->nfree += n - s->ref;
+	if(s->ref == 0) {
+		MCentral_ReturnToHeap(c, s);
+		return;
+	}
+	if(s->freelist != nil) {
+		runtime·MSpanList_Remove(s);
+		runtime·MSpanList_Insert(&c->nonempty, s);
 	}
 	runtime·unlock(c);
 }
 
-// Helper: free one object back into the central free list.
-static void
-MCentral_Free(MCentral *c, void *v)
+// Free v, an object of the span s, into c.
+// If s is owned by an MCache, push v on s->freebuf
+// for the MCache to take when it runs out of objects.
+void
+runtime·MCentral_Free(MCentral *c, MSpan *s, void *v)
 {
-	MSpan *s;
-	MLink *p;
-	int32 size;
+	MLink *p, *old;
+
+	p = v;
+	for(;;) {
+		old = s->freebuf;
+		if(old != SpanUncached) {
+			p->next = old;
+			if(runtime·casp((void**)&s->freebuf, old, p))
+				return;
+			continue;
+		}
+		// Only MCentral_CacheSpan reopens s->freebuf, under the lock.
+		runtime·lock(c);
+		if(s->freebuf == SpanUncached)
+			break;
+		runtime·unlock(c);
+	}
 
-	// Find span for v.
-	s = runtime·MHeap_Lookup(&runtime·mheap, v);
-	if(s == nil || s->ref == 0)
+	if(s->ref == 0)
 		runtime·throw("invalid free");
 
 	// Move to nonempty if necessary.
@@ -128,23 +132,107 @@ MCentral_Free(MCentral *c, void *v)
 	}
 
 	// Add v back to s's free list.
-	p = v;
 	p->next = s->freelist;
 	s->freelist = p;
 	c->nfree++;
 
 	// If s is completely freed, return it to the heap.
 	if(--s->ref == 0) {
-		size = runtime·class_to_size[c->sizeclass];
-		runtime·MSpanList_Remove(s);
-		runtime·unmarkspan((byte*)(s->start<<PageShift), s->npages<<PageShift);
-		*(uintptr*)(s->start<<PageShift) = 1;  // needs zeroing
-		s->freelist = nil;
-		c->nfree -= (s->npages << PageShift) / size;
+		MCentral_ReturnToHeap(c, s);
+		return;
+	}
+	runtime·unlock(c);
+}
+
+// Helper: return the completely free span s to the heap.
+// Called with c locked, returns with c unlocked.
+static void
+MCentral_ReturnToHeap(MCentral *c, MSpan *s)
+{
+	int32 size;
+
+	size = runtime·class_to_size[c->sizeclass];
+	runtime·MSpanList_Remove(s);
+	runtime·unmarkspan((byte*)(s->start<<PageShift), s->npages<<PageShift);
+	*(uintptr*)(s->start<<PageShift) = 1;  // needs zeroing
+	s->freelist = nil;
+	c->nfree -= (s->npages << PageShift) / size;
+	runtime·unlock(c);
+	runtime·MHeap_Free(&runtime·mheap, s, 0);
+}
+
+// Give the n objects from first to last, found free by the sweep of span s,
+// back to s and mark s swept.  Called by MSpan_Sweep.
+void
+runtime·MCentral_FreeSpan(MCentral *c, MSpan *s, int32 n, MLink *first, MLink *last)
+{
+	runtime·lock(c);
+	if(n > 0) {
+		last->next = s->freelist;
+		s->freelist = first;
+		s->ref -= n;
+		c->nfree += n;
+	}
+	// Under the lock, so MCentral_Sweep does not see
+	// a span being swept on c->unswept.
+	s->sweepgen = runtime·mheap.sweepgen;
+	if(s->ref == 0) {
+		MCentral_ReturnToHeap(c, s);
+		return;
+	}
+	runtime·MSpanList_Remove(s);
+	runtime·MSpanList_Insert(s->freelist != nil ? &c->nonempty : &c->empty, s);
+	runtime·unlock(c);
+}
+
+// Move all the spans of c to c->unswept: the collection
+// that just finished will free their unmarked objects.
+// Called with the world stopped.
+void
+runtime·MCentral_StartSweep(MCentral *c)
+{
+	MSpanList_Move(&c->unswept, &c->nonempty);
+	MSpanList_Move(&c->unswept, &c->empty);
+}
+
+// Helper: move all the spans of list from to the front of list to.
+static void
+MSpanList_Move(MSpan *to, MSpan *from)
+{
+	MSpan *first, *last;
+
+	if(runtime·MSpanList_IsEmpty(from))
+		return;
+	first = from->next;
+	last = from->prev;
+	last->next = to->next;
+	to->next->prev = last;
+	to->next = first;
+	first->prev = to;
+	runtime·MSpanList_Init(from);
+}
+
+// Sweep spans of c left by the last collection until one has free objects.
+// Called and returns with c locked; false if there are none left to sweep.
+static bool
+MCentral_Sweep(MCentral *c)
+{
+	MSpan *s;
+	uint32 sg;
+
+	sg = runtime·mheap.sweepgen;
+	while(runtime·MSpanList_IsEmpty(&c->nonempty)) {
+		// Spans being swept by other Ms leave the list soon.
+		for(s = c->unswept.next; s != &c->unswept; s = s->next)
+			if(runtime·cas(&s->sweepgen, sg-2, sg-1))
+				break;
+		if(s == &c->unswept)
+			return false;
 		runtime·unlock(c);
-		runtime·MHeap_Free(&runtime·mheap, s, 0);
+		runtime·MSpan_Sweep(s);
 		runtime·lock(c);
 	}
+	return true;
 }
 
 void
@@ -191,6 +279,7 @@ MCentral_Grow(MCentral *c)
 		p += size;
 	}
 	*tailp = nil;
+	s->freebuf = SpanUncached;
 	runtime·markspan((byte*)(s->start<<PageShift), size, n, size*n < (s->npages<<PageShift));
 
 	runtime·lock(c);
@@ -17,11 +17,12 @@ type MemStatsType struct {
 	Frees      uint64 // number of frees
 
 	// Main allocation heap statistics.
-	HeapAlloc   uint64 // bytes allocated and still in use
-	HeapSys     uint64 // bytes obtained from system
-	HeapIdle    uint64 // bytes in idle spans
-	HeapInuse   uint64 // bytes in non-idle span
-	HeapObjects uint64 // total number of allocated objects
+	HeapAlloc    uint64 // bytes allocated and still in use
+	HeapSys      uint64 // bytes obtained from system
+	HeapIdle     uint64 // bytes in idle spans
+	HeapInuse    uint64 // bytes in non-idle span
+	HeapReleased uint64 // bytes of idle spans released to the OS
+	HeapObjects  uint64 // total number of allocated objects
 
 	// Low-level fixed-size structure allocator statistics.
 	//	Inuse is bytes used now.
@@ -36,8 +37,10 @@ type MemStatsType struct {
 
 	// Garbage collector statistics.
 	NextGC       uint64
+	LastGC       uint64 // end time of last GC, in nanoseconds since the epoch
 	PauseTotalNs uint64
 	PauseNs      [256]uint64 // most recent GC pause times
+	PauseHist    [32]uint64  // GC pauses of [2^i, 2^(i+1)) µs; first and last buckets are open ended
 	NumGC        uint32
 	EnableGC     bool
 	DebugGC      bool
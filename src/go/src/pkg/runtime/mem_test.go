@@ -0,0 +1,49 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+package runtime_test
+
+import (
+	"runtime"
+	"testing"
+)
+
+const n = 1 << 20
+
+// touch allocates n bytes and dirties them, leaving no pointer to
+// them in the caller's frame.  The collector may still find the
+// last block allocated, and on 32-bit systems a word of data, such
+// as a float in a table, may happen to point into any of them, so
+// touch a few small blocks rather than one big one.
+func touch() {
+	b := make([]byte, n)
+	for i := 0; i < n; i += 4096 {
+		b[i] = 1
+	}
+}
+
+func TestHeapReleased(t *testing.T) {
+	for i := 0; i < 4; i++ {
+		touch()
+	}
+	runtime.Scavenge()
+	st := &runtime.MemStats
+	if st.HeapIdle+st.HeapInuse != st.HeapSys {
+		t.Errorf("HeapIdle %d + HeapInuse %d != HeapSys %d", st.HeapIdle, st.HeapInuse, st.HeapSys)
+	}
+	if st.HeapReleased < n || st.HeapReleased > st.HeapIdle {
+		t.Errorf("HeapReleased %d, want between %d and HeapIdle %d", st.HeapReleased, n, st.HeapIdle)
+	}
+
+	// The released pages come back zeroed.
+	b := make([]byte, n)
+	for i := 0; i < n; i += 512 {
+		if b[i] != 0 {
+			t.Fatalf("b[%d] = %d in a new slice", i, b[i])
+		}
+	}
+	if st.HeapReleased > st.HeapIdle {
+		t.Errorf("HeapReleased %d > HeapIdle %d after reuse", st.HeapReleased, st.HeapIdle)
+	}
+}
@@ -52,6 +52,7 @@ addfintab(Fintab *t, void *k, Finalizer *v)
 ret:
 	t->key[i] = k;
 	t->val[i] = v;
+	runtime·markdirty(&t->val[i], sizeof t->val[i]);
 }
 
 static Finalizer*
@@ -179,3 +180,30 @@ runtime·walkfintab(void (*fn)(void*))
 			fn(*key);
 	runtime·unlock(&finlock);
 }
+
+// Remove the finalizers of the blocks for which fn returns true
+// from the table and push them onto *q, with arg set to the block.
+// Returns the number of finalizers queued.
+int32
+runtime·queuefinalizers(bool (*fn)(void*), Finalizer **q)
+{
+	int32 i, n;
+	Finalizer *f;
+
+	n = 0;
+	runtime·lock(&finlock);
+	for(i=0; i<fintab.max; i++) {
+		if(fintab.key[i] == nil || fintab.key[i] == (void*)-1 || !fn(fintab.key[i]))
+			continue;
+		f = fintab.val[i];
+		f->arg = fintab.key[i];
+		f->next = *q;
+		*q = f;
+		fintab.key[i] = (void*)-1;
+		fintab.val[i] = nil;
+		fintab.ndead++;
+		n++;
+	}
+	runtime·unlock(&finlock);
+	return n;
+}
@@ -3,18 +3,48 @@
 // license that can be found in the LICENSE file.
 
 // Garbage collector.
+//
+// A collection marks what is reachable from data and bss, the goroutine
+// stacks and the blocks with finalizers, and frees the rest.  The sweep
+// runs afterward, concurrently with the program and on any number of Ms
+// (see sweep below).
+//
+// On 386 and amd64 most of the mark runs concurrently too.  A first
+// pause scans the roots and sets runtime·writebarrier.  The blocks they
+// reach are then scanned by the Ms that allocate, in proportion to what
+// they allocate (see gcassist), and by a background goroutine.  While
+// the barrier is set, the pages that pointers are stored into are kept
+// dirty (see markdirty): 8g and 6g test the barrier after each store
+// that may put a pointer in the heap (see ../../cmd/gc/gen.c), and the
+// C runtime and reflect call markdirty after theirs.  A second pause
+// scans the roots again, the G and M structures, and the marked blocks
+// on the dirty pages, and finishes the mark.  The blocks allocated in
+// between are not marked; if they are still reachable, that pause
+// finds them.
+//
+// 5g emits no barrier, so on arm the mark stops the world, as it does
+// everywhere for runtime.GC.  With $GOGCVERIFY set, each concurrent
+// mark is checked against one with the world stopped.
 
 #include "runtime.h"
+#include "arch.h"
 #include "malloc.h"
+#include "type.h"
 
 enum {
 	Debug = 0,
 	UseCas = 1,
 	PtrSize = sizeof(void*),
+	WordBits = 8*sizeof(uintptr),
 	
 	// Four bits per word (see #defines below).
 	wordsPerBitmapWord = sizeof(void*)*8/4,
 	bitShift = sizeof(void*)*8/4,
+
+	// The concurrent mark.
+	MarkSlack = 8,	// the heap may grow by 1/MarkSlack of $GOGC while marking
+	AssistWords = 4096,	// least an assist scans, see gcassist
+	BgmarkWords = 16384,	// what bgmark scans between goscheds
 };
 
 // Bits in per-word bitmap.
@@ -53,7 +83,10 @@ enum {
 static uint64 nlookup;
 static uint64 nsizelookup;
 static uint64 naddrlookup;
+static uint64 nscanwords;
+static uint64 ntypedwords;
 static int32 gctrace;
+static int32 gcverify;
 
 typedef struct Workbuf Workbuf;
 struct Workbuf
@@ -63,31 +96,131 @@ struct Workbuf
 	byte *w[2048-2];
 };
 
+static struct {
+	Workbuf	*full;
+	Workbuf	*empty;
+	byte	*chunk;
+	uintptr	nchunk;
+
+	// The concurrent mark.
+	uint32	token;	// held by the M scanning, see drain
+	uint32	done;	// the queue is empty
+	uint32	ratio;	// words to scan per byte allocated
+	uint32	debt;	// words the assists are behind
+	G	*g;	// background marker
+	bool	parked;
+	uint64	heap0;	// heap_alloc at the first pause
+	uint64	obj0;
+	int64	pause0;	// length of the first pause
+	int64	tstart;	// end of the first pause
+} work;
+
+// Set between the two pauses of a concurrent mark.
+uint32 runtime·writebarrier;
+
 extern byte data[];
 extern byte etext[];
 extern byte end[];
 
 static G *fing;
+static G *scvg;
 static Finalizer *finq;
 static int32 fingwait;
 
+// Semaphore, not Lock, so that the goroutine
+// reschedules when there is contention rather
+// than spinning.
+static uint32 gcsema = 1;
+
+// Initialized from $GOGC.  GOGC=off means no gc.
+//
+// Next gc is after we've allocated an extra amount of
+// memory proportional to the amount already in use.
+// If gcpercent=100 and we're using 4M, we'll gc again
+// when we get to 8M.  This keeps the gc cost in linear
+// proportion to the allocation cost.  Adjusting gcpercent
+// just changes the linear constant (and also the amount of
+// extra memory used).
+static int32 gcpercent = -2;
+
 static void runfinq(void);
 static Workbuf* getempty(Workbuf*);
 static Workbuf* getfull(Workbuf*);
 
+// Set the mark bit of the block at bitp, shift; false if it was set.
+// While the mark runs concurrently, the Ms of the program set and
+// clear the other bits of the word (see markallocated).
+static bool
+setmarked(uintptr *bitp, uintptr shift)
+{
+	uintptr obits;
+
+	if(!runtime·writebarrier || runtime·gomaxprocs == 1) {
+		*bitp |= bitMarked<<shift;
+		return true;
+	}
+	for(;;) {
+		obits = *bitp;
+		if((obits & (bitMarked<<shift)) != 0)
+			return false;
+		if(runtime·casp((void**)bitp, (void*)obits, (void*)(obits | bitMarked<<shift)))
+			return true;
+	}
+}
+
+// The pointer bits of the WordBits words starting at word i
+// of an object whose type has the pointer bitmap gc, which
+// the collector repeats over the whole object.
+static uintptr
+ptrmask(uintptr *gc, uintptr i)
+{
+	uintptr unit, m, j, k;
+
+	unit = gc[0];
+	j = i % unit;
+	if(j%WordBits == 0 && j+WordBits <= unit)
+		return gc[1+j/WordBits];
+	if(j == 0 && unit <= WordBits) {
+		// Double the bitmap until it fills the word.
+		m = gc[1];
+		for(k=unit; k<WordBits; k+=k)
+			m |= m<<k;
+		return m;
+	}
+	m = 0;
+	for(k=0; k<WordBits; k++) {
+		m |= ((gc[1+j/WordBits]>>(j%WordBits)) & 1) << k;
+		if(++j == unit)
+			j = 0;
+	}
+	return m;
+}
+
 // scanblock scans a block of n bytes starting at pointer b for references
 // to other objects, scanning any it finds recursively until there are no
 // unscanned objects left.  Instead of using an explicit recursion, it keeps
 // a work list in the Workbuf* structures and loops in the main function
 // body.  Keeping an explicit work list is easier on the stack allocator and
 // more efficient.
+//
+// The objects allocated with a type (see malloc.goc:/runtime·malgc)
+// are scanned precisely: only the words that the type's pointer
+// bitmap, repeated over the object, marks as holding pointers.
+// The block b and the objects allocated without a type are scanned
+// conservatively, every word being a possible pointer.  The words
+// are taken WordBits at a time, with a mask of those to look at.
+//
+// A budget of 0 or more stops the scan once budget words have been
+// scanned, leaving the rest queued: 0 scans only b.
 static void
-scanblock(byte *b, int64 n)
+scanblock(byte *b, int64 n, int64 budget)
 {
-	byte *obj, *arena_start, *p;
+	byte *obj, *arena_start, *p, *spanlo, *spanhi;
 	void **vp;
-	uintptr size, *bitp, bits, shift, i, j, x, xbits, off;
+	uintptr size, *bitp, bits, shift, i, j, x, xbits, off, nw, ptrs, *gc, *lastgc, lastptrs;
+	uintptr spansize, spanshift, spantypes;
 	MSpan *s;
+	MTypes *mt;
 	PageID k;
 	void **bw, **w, **ew;
 	Workbuf *wbuf;
@@ -99,6 +232,14 @@ scanblock(byte *b, int64 n)
 	ew = nil;  // end of work buffer
 	bw = nil;  // beginning of work buffer
 	w = nil;  // current pointer into work buffer
+	gc = nil;  // pointer bitmap of the type of b
+	lastgc = nil;  // last bitmap given to ptrmask for word 0
+	lastptrs = 0;  // and what it returned
+	spanlo = nil;  // span of the last block popped
+	spanhi = nil;
+	spansize = 0;
+	spanshift = 0;
+	spantypes = 0;
 
 	// Align b to a word boundary.
 	off = (uintptr)b & (PtrSize-1);
@@ -113,96 +254,128 @@ scanblock(byte *b, int64 n)
 		if(Debug > 1)
 			runtime·printf("scanblock %p %D\n", b, n);
 
-		vp = (void**)b;
-		n /= PtrSize;
-		for(i=0; i<n; i++) {
-			obj = (byte*)vp[i];
+		nw = (uintptr)n/PtrSize;
+		nscanwords += nw;
+		if(gc != nil)
+			ntypedwords += nw;
+		for(i=0; i<nw; i+=WordBits) {
+			if(gc == nil)
+				ptrs = ~(uintptr)0;
+			else if(i != 0)
+				ptrs = ptrmask(gc, i);
+			else if(gc == lastgc)
+				ptrs = lastptrs;
+			else {
+				lastgc = gc;
+				ptrs = lastptrs = ptrmask(gc, 0);
+			}
+			if(nw-i < WordBits)
+				ptrs &= ((uintptr)1<<(nw-i)) - 1;
+			for(vp=(void**)b+i; ptrs!=0; vp++, ptrs>>=1) {
+				if((ptrs & 1) == 0)
+					continue;
+				obj = *vp;
 			
-			// Words outside the arena cannot be pointers.
-			if((byte*)obj < arena_start || (byte*)obj >= runtime·mheap.arena_used)
-				continue;
+				// Words outside the arena cannot be pointers.
+				if((byte*)obj < arena_start || (byte*)obj >= runtime·mheap.arena_used)
+					continue;
 			
-			// obj may be a pointer to a live object.
-			// Try to find the beginning of the object.
+				// obj may be a pointer to a live object.
+				// Try to find the beginning of the object.
 			
-			// Round down to word boundary.
-			obj = (void*)((uintptr)obj & ~((uintptr)PtrSize-1));
-
-			// Find bits for this word.
-			off = (uintptr*)obj - (uintptr*)arena_start;
-			bitp = (uintptr*)arena_start - off/wordsPerBitmapWord - 1;
-			shift = off % wordsPerBitmapWord;
-			xbits = *bitp;
-			bits = xbits >> shift;
-
-			// Pointing at the beginning of a block?
-			if((bits & (bitAllocated|bitBlockBoundary)) != 0)
-				goto found;
-
-			// Pointing just past the beginning?
-			// Scan backward a little to find a block boundary.
-			for(j=shift; j-->0; ) {
-				if(((xbits>>j) & (bitAllocated|bitBlockBoundary)) != 0) {
-					obj = (byte*)obj - (shift-j)*PtrSize;
-					shift = j;
-					bits = xbits>>shift;
+				// Round down to word boundary.
+				obj = (void*)((uintptr)obj & ~((uintptr)PtrSize-1));
+
+				// Find bits for this word.
+				off = (uintptr*)obj - (uintptr*)arena_start;
+				bitp = (uintptr*)arena_start - off/wordsPerBitmapWord - 1;
+				shift = off % wordsPerBitmapWord;
+				xbits = *bitp;
+				bits = xbits >> shift;
+
+				// Pointing at the beginning of a block?
+				if((bits & (bitAllocated|bitBlockBoundary)) != 0)
 					goto found;
+
+				// Pointing just past the beginning?
+				// Scan backward a little to find a block boundary.
+				for(j=shift; j-->0; ) {
+					if(((xbits>>j) & (bitAllocated|bitBlockBoundary)) != 0) {
+						obj = (byte*)obj - (shift-j)*PtrSize;
+						shift = j;
+						bits = xbits>>shift;
+						goto found;
+					}
 				}
-			}
 
-			// Otherwise consult span table to find beginning.
-			// (Manually inlined copy of MHeap_LookupMaybe.)
-			nlookup++;
-			naddrlookup++;
-			k = (uintptr)obj>>PageShift;
-			x = k;
-			if(sizeof(void*) == 8)
-				x -= (uintptr)arena_start>>PageShift;
-			s = runtime·mheap.map[x];
-			if(s == nil || k < s->start || k - s->start >= s->npages || s->state != MSpanInUse)
-				continue;
-			p =  (byte*)((uintptr)s->start<<PageShift);
-			if(s->sizeclass == 0) {
-				obj = p;
-			} else {
-				if((byte*)obj >= (byte*)s->limit)
+				// Otherwise consult span table to find beginning.
+				// (Manually inlined copy of MHeap_LookupMaybe.)
+				nlookup++;
+				naddrlookup++;
+				k = (uintptr)obj>>PageShift;
+				x = k;
+				if(sizeof(void*) == 8)
+					x -= (uintptr)arena_start>>PageShift;
+				s = runtime·mheap.map[x];
+				if(s == nil || k < s->start || k - s->start >= s->npages || s->state != MSpanInUse)
 					continue;
-				size = runtime·class_to_size[s->sizeclass];
-				int32 i = ((byte*)obj - p)/size;
-				obj = p+i*size;
-			}
+				p =  (byte*)((uintptr)s->start<<PageShift);
+				if(s->sizeclass == 0) {
+					obj = p;
+				} else {
+					if((byte*)obj >= (byte*)s->limit)
+						continue;
+					size = runtime·class_to_size[s->sizeclass];
+					obj = p + ((byte*)obj - p)/size*size;
+				}
 
-			// Now that we know the object header, reload bits.
-			off = (uintptr*)obj - (uintptr*)arena_start;
-			bitp = (uintptr*)arena_start - off/wordsPerBitmapWord - 1;
-			shift = off % wordsPerBitmapWord;
-			xbits = *bitp;
-			bits = xbits >> shift;
-
-		found:
-			// Now we have bits, bitp, and shift correct for
-			// obj pointing at the base of the object.
-			// If not allocated or already marked, done.
-			if((bits & bitAllocated) == 0 || (bits & bitMarked) != 0)
-				continue;
-			*bitp |= bitMarked<<shift;
+				// Now that we know the object header, reload bits.
+				off = (uintptr*)obj - (uintptr*)arena_start;
+				bitp = (uintptr*)arena_start - off/wordsPerBitmapWord - 1;
+				shift = off % wordsPerBitmapWord;
+				xbits = *bitp;
+				bits = xbits >> shift;
+
+			found:
+				// Now we have bits, bitp, and shift correct for
+				// obj pointing at the base of the object.
+				// If not allocated or already marked, done.
+				if((bits & bitAllocated) == 0 || (bits & bitMarked) != 0)
+					continue;
+				if(!setmarked(bitp, shift))
+					continue;
 
-			// If object has no pointers, don't need to scan further.
-			if((bits & bitNoPointers) != 0)
-				continue;
+				// If object has no pointers, don't need to scan further.
+				if((bits & bitNoPointers) != 0)
+					continue;
 
-			// If buffer is full, get a new one.
-			if(w >= ew) {
-				wbuf = getempty(wbuf);
-				bw = wbuf->w;
-				w = bw;
-				ew = bw + nelem(wbuf->w);
+				// If buffer is full, get a new one.
+				if(w >= ew) {
+					wbuf = getempty(wbuf);
+					bw = wbuf->w;
+					w = bw;
+					ew = bw + nelem(wbuf->w);
+				}
+				*w++ = obj;
 			}
-			*w++ = obj;
 		}
 		
-		// Done scanning [b, b+n).  Prepare for the next iteration of
-		// the loop by setting b and n to the parameters for the next block.
+		// Done scanning [b, b+n).  Stop if that was the budget,
+		// putting the rest of the work buffer back on the queue.
+		if(budget >= 0 && (budget -= nw) <= 0) {
+			if(wbuf != nil && w > bw) {
+				wbuf->nw = w - bw;
+				wbuf->next = work.full;
+				work.full = wbuf;
+			} else if(wbuf != nil) {
+				wbuf->next = work.empty;
+				work.empty = wbuf;
+			}
+			break;
+		}
+
+		// Prepare for the next iteration of the loop
+		// by setting b and n to the parameters for the next block.
 
 		// Fetch b from the work buffers.
 		if(w <= bw) {
@@ -215,69 +388,46 @@ scanblock(byte *b, int64 n)
 			w = bw+wbuf->nw;
 		}
 		b = *--w;
-	
-		// Figure out n = size of b.  Start by loading bits for b.
-		off = (uintptr*)b - (uintptr*)arena_start;
-		bitp = (uintptr*)arena_start - off/wordsPerBitmapWord - 1;
-		shift = off % wordsPerBitmapWord;
-		xbits = *bitp;
-		bits = xbits >> shift;
-		
-		// Might be small; look for nearby block boundary.
-		// A block boundary is marked by either bitBlockBoundary
-		// or bitAllocated being set (see notes near their definition).
-		enum {
-			boundary = bitBlockBoundary|bitAllocated
-		};
-		// Look for a block boundary both after and before b
-		// in the same bitmap word.
-		//
-		// A block boundary j words after b is indicated by
-		//	bits>>j & boundary
-		// assuming shift+j < bitShift.  (If shift+j >= bitShift then
-		// we'll be bleeding other bit types like bitMarked into our test.)
-		// Instead of inserting the conditional shift+j < bitShift into the loop,
-		// we can let j range from 1 to bitShift as long as we first
-		// apply a mask to keep only the bits corresponding
-		// to shift+j < bitShift aka j < bitShift-shift.
-		bits &= (boundary<<(bitShift-shift)) - boundary;
-		
-		// A block boundary j words before b is indicated by
-		//	xbits>>(shift-j) & boundary
-		// (assuming shift >= j).  There is no cleverness here
-		// avoid the test, because when j gets too large the shift
-		// turns negative, which is undefined in C.		
-
-		for(j=1; j<bitShift; j++) {
-			if(((bits>>j)&boundary) != 0 || shift>=j && ((xbits>>(shift-j))&boundary) != 0) {
-				n = j*PtrSize;
-				goto scan;
+
+		// Find the size and the pointer bitmap of b in its span,
+		// which is often the span of the last block.
+		if(b < spanlo || b >= spanhi) {
+			// (Manually inlined copy of MHeap_Lookup.)
+			nlookup++;
+			nsizelookup++;
+			x = (uintptr)b>>PageShift;
+			if(sizeof(void*) == 8)
+				x -= (uintptr)arena_start>>PageShift;
+			s = runtime·mheap.map[x];
+			if(s == nil || s->state != MSpanInUse) {
+				// Freed (runtime·free) since it was queued,
+				// while the program ran.
+				spanlo = nil;
+				spanhi = nil;
+				gc = nil;
+				n = 0;
+				continue;
+			}
+			spanlo = (byte*)((uintptr)s->start<<PageShift);
+			spanhi = spanlo + (s->npages<<PageShift);
+			spantypes = s->types;
+			if(s->sizeclass == 0) {
+				spansize = s->npages<<PageShift;
+				spanshift = 0;
+			} else {
+				spansize = runtime·class_to_size[s->sizeclass];
+				spanshift = runtime·class_to_typeshift[s->sizeclass];
 			}
 		}
-		
-		// Fall back to asking span about size class.
-		// (Manually inlined copy of MHeap_Lookup.)
-		nlookup++;
-		nsizelookup++;
-		x = (uintptr)b>>PageShift;
-		if(sizeof(void*) == 8)
-			x -= (uintptr)arena_start>>PageShift;
-		s = runtime·mheap.map[x];
-		if(s->sizeclass == 0)
-			n = s->npages<<PageShift;
-		else
-			n = runtime·class_to_size[s->sizeclass];
-	scan:;
+		n = spansize;
+		gc = (uintptr*)spantypes;
+		if(spantypes & MTypesTable) {
+			mt = (MTypes*)(spantypes & ~MTypesTable);
+			gc = mt->gc[mt->idx[(b - spanlo) >> spanshift]];
+		}
 	}
 }
 
-static struct {
-	Workbuf	*full;
-	Workbuf	*empty;
-	byte	*chunk;
-	uintptr	nchunk;
-} work;
-
 // Get an empty work buffer off the work.empty list,
 // allocating new buffers as needed.
 static Workbuf*
@@ -321,7 +471,7 @@ getfull(Workbuf *b)
 
 // Scanstack calls scanblock on each of gp's stack segments.
 static void
-scanstack(G *gp)
+scanstack(G *gp, int64 budget)
 {
 	Stktop *stk;
 	byte *sp;
@@ -334,7 +484,7 @@ scanstack(G *gp)
 		runtime·printf("scanstack %d %p\n", gp->goid, sp);
 	stk = (Stktop*)gp->stackbase;
 	while(stk) {
-		scanblock(sp, (byte*)stk - sp);
+		scanblock(sp, (byte*)stk - sp, budget);
 		sp = stk->gobuf.sp;
 		stk = (Stktop*)stk->stackbase;
 	}
@@ -352,20 +502,21 @@ markfin(void *v)
 		runtime·throw("mark - finalizer inconsistency");
 
 	// do not mark the finalizer block itself.  just mark the things it points at.
-	scanblock(v, size);
+	scanblock(v, size, -1);
 }
 
-// Mark 
+// Mark data+bss and the stacks, and what they point at;
+// with a budget of 0, only queue what they point at.
 static void
-mark(void)
+markroots(int64 budget)
 {
 	G *gp;
 
 	// mark data+bss.
 	// skip runtime·mheap itself, which has no interesting pointers
 	// and is mostly zeroed and would not otherwise be paged in.
-	scanblock(data, (byte*)&runtime·mheap - data);
-	scanblock((byte*)(&runtime·mheap+1), end - (byte*)(&runtime·mheap+1));
+	scanblock(data, (byte*)&runtime·mheap - data, budget);
+	scanblock((byte*)(&runtime·mheap+1), end - (byte*)(&runtime·mheap+1), budget);
 
 	// mark stacks
 	for(gp=runtime·allg; gp!=nil; gp=gp->alllink) {
@@ -378,114 +529,434 @@ mark(void)
 		case Grunning:
 			if(gp != g)
 				runtime·throw("mark - world not stopped");
-			scanstack(gp);
+			scanstack(gp, budget);
 			break;
 		case Grunnable:
 		case Gsyscall:
 		case Gwaiting:
-			scanstack(gp);
+			scanstack(gp, budget);
 			break;
 		}
 	}
+}
+
+// Mark with the world stopped.
+static void
+mark(void)
+{
+	markroots(-1);
 
 	// mark things pointed at by objects with finalizers
 	runtime·walkfintab(markfin);
 }
 
-// Sweep frees or calls finalizers for blocks not marked in the mark phase.
-// It clears the mark bits in preparation for the next GC round.
+// Record that the n bytes at p were stored into while marking.
+// The second pause scans again the marked blocks on those pages:
+// they may have been scanned before the store.
+void
+runtime·markdirty(void *p, uintptr n)
+{
+	uintptr x, ex;
+
+	if(!runtime·writebarrier || n == 0)
+		return;
+	if((byte*)p < runtime·mheap.arena_start || (byte*)p >= runtime·mheap.arena_used)
+		return;
+	x = (uintptr)p>>PageShift;
+	ex = ((uintptr)p+n-1)>>PageShift;
+	if(sizeof(void*) == 8) {
+		x -= (uintptr)runtime·mheap.arena_start>>PageShift;
+		ex -= (uintptr)runtime·mheap.arena_start>>PageShift;
+	}
+	for(; x<=ex; x++)
+		runtime·mheap.dirty[x] = 1;
+}
+
+// Queue the words of the marked blocks on the dirty pages,
+// and clean the pages.
 static void
-sweep(void)
+scandirty(void)
 {
+	uintptr x, size, off, *bitp, shift, bits;
+	byte *p, *ep, *b, *eb, *lo, *hi;
 	MSpan *s;
-	int32 cl, n, npages;
-	uintptr size;
+
+	ep = runtime·mheap.arena_used;
+	for(p=runtime·mheap.arena_start; p<ep; p+=PageSize) {
+		x = (uintptr)p>>PageShift;
+		if(sizeof(void*) == 8)
+			x -= (uintptr)runtime·mheap.arena_start>>PageShift;
+		if(!runtime·mheap.dirty[x])
+			continue;
+		runtime·mheap.dirty[x] = 0;
+		s = runtime·mheap.map[x];
+		if(s == nil || s->state != MSpanInUse)
+			continue;
+		b = (byte*)((uintptr)s->start<<PageShift);
+		eb = b + (s->npages<<PageShift);
+		if(s->sizeclass == 0)
+			size = eb - b;
+		else {
+			size = runtime·class_to_size[s->sizeclass];
+			b += (p - b)/size*size;
+			eb = s->limit;
+		}
+		for(; b<p+PageSize && b<eb; b+=size) {
+			off = (uintptr*)b - (uintptr*)runtime·mheap.arena_start;
+			bitp = (uintptr*)runtime·mheap.arena_start - off/wordsPerBitmapWord - 1;
+			shift = off % wordsPerBitmapWord;
+			bits = *bitp >> shift;
+			if((bits & (bitAllocated|bitMarked|bitNoPointers)) != (bitAllocated|bitMarked))
+				continue;
+			lo = b < p ? p : b;
+			hi = b+size > p+PageSize ? p+PageSize : b+size;
+			scanblock(lo, hi - lo, 0);
+		}
+	}
+}
+
+// Scan at most budget words of the queue, unless another M is
+// scanning.  Reports whether the queue is empty.
+static bool
+drain(int64 budget)
+{
+	bool empty;
+
+	if(!runtime·cas(&work.token, 0, 1))
+		return false;
+	// The lock keeps the spans and their types
+	// from being freed under scanblock.
+	runtime·lock(&runtime·mheap);
+	scanblock(nil, 0, budget);
+	empty = work.full == nil;
+	runtime·unlock(&runtime·mheap);
+	runtime·cas(&work.token, 1, 0);
+	return empty;
+}
+
+// The first pause of a concurrent mark: queue what the roots
+// point at, and set the barrier.
+static void
+markstart(void)
+{
+	work.done = 0;
+	work.debt = 0;
+	work.ratio = 1 + MarkSlack*100/(PtrSize*gcpercent);
+	mstats.next_gc = mstats.heap_alloc + mstats.heap_alloc*gcpercent/(100*MarkSlack);
+	runtime·writebarrier = 1;
+	markroots(0);
+}
+
+// The second pause: scan again what the program may
+// have changed since the first, and finish the mark.
+static void
+markfinish(void)
+{
+	G *gp;
+	M *mp;
+
+	runtime·writebarrier = 0;
+	markroots(0);
+	for(gp=runtime·allg; gp!=nil; gp=gp->alllink)
+		scanblock((byte*)gp, sizeof *gp, 0);
+	for(mp=runtime·allm; mp!=nil; mp=mp->alllink)
+		scanblock((byte*)mp, sizeof *mp, 0);
+	scandirty();
+	runtime·walkfintab(markfin);
+	scanblock(nil, 0, -1);
+}
+
+// Mallocgc calls gcassist while the mark runs concurrently, to scan
+// in proportion to the size bytes allocated: enough for the mark to be
+// done before the heap has grown by 1/MarkSlack of $GOGC, assuming all
+// of it is reachable.  Reports whether the queue is empty, for mallocgc
+// to finish the mark.
+bool
+runtime·gcassist(uintptr size)
+{
+	uint32 debt;
+
+	if(work.done)
+		return true;
+	if(size > (1<<30)/work.ratio)
+		size = (1<<30)/work.ratio;
+	debt = runtime·xadd(&work.debt, size*work.ratio);
+	if(debt < AssistWords)
+		return false;
+	runtime·xadd(&work.debt, -(int32)debt);
+	if(drain(debt))
+		work.done = 1;
+	return work.done;
+}
+
+// The background marker scans while the program gives
+// it the chance, and finishes the mark if it empties the queue.
+static void
+bgmark(void)
+{
+	for(;;) {
+		while(runtime·writebarrier && !work.done) {
+			if(drain(BgmarkWords))
+				work.done = 1;
+			runtime·gosched();
+		}
+		if(runtime·writebarrier)
+			runtime·gc(0);
+		// Like bgsweep.
+		work.parked = 1;
+		g->status = Gwaiting;
+		runtime·gosched();
+	}
+}
+
+// With $GOGCVERIFY set, check after the second pause that the
+// concurrent mark marked all that a mark with the world stopped
+// does: a block it missed would be freed while still in use.
+static void
+verifymark(void)
+{
+	uintptr *b, *save, mask, nw, i, j, x, off;
+
+	mask = 0;
+	for(j=0; j<wordsPerBitmapWord; j++)
+		mask |= bitMarked<<j;
+	nw = (runtime·mheap.arena_used - runtime·mheap.arena_start)/PtrSize/wordsPerBitmapWord;
+	b = (uintptr*)runtime·mheap.arena_start - nw;
+	save = runtime·SysAlloc(nw*sizeof save[0]);
+	for(i=0; i<nw; i++) {
+		save[i] = b[i] & mask;
+		b[i] &= ~mask;
+	}
+	mark();
+	for(i=0; i<nw; i++) {
+		x = b[i] & mask & ~save[i];
+		if(x != 0) {
+			for(j=0; (x & (bitMarked<<j)) == 0; j++)
+				;
+			off = (nw-1-i)*wordsPerBitmapWord + j;
+			runtime·printf("gc: concurrent mark missed block %p\n", (uintptr*)runtime·mheap.arena_start + off);
+			runtime·throw("gc: concurrent mark missed a reachable block");
+		}
+		b[i] |= save[i];
+	}
+	runtime·SysFree(save, nw*sizeof save[0]);
+}
+
+// The sweep of the heap runs after each collection, concurrently with the
+// program: the Ms sweep spans as they need memory (MCentral_CacheSpan,
+// MHeap_Alloc, free) and a background goroutine sweeps the rest.
+// The spans are claimed one at a time through s->sweepgen (see malloc.h),
+// and the next collection finishes the sweep before it marks.
+static struct {
+	Lock;
+	MSpan	*spans;	// next span in mheap.allspans to sweep
+	G	*g;	// background sweeper
+	bool	parked;
+	uint32	nbgsweep;	// spans swept by g since the last collection
+	uint32	npausesweep;	// spans left for the next collection to sweep
+} sweep;
+
+// Clear the mark bit of the block at bitp, shift.
+static void
+unmarkbit(uintptr *bitp, uintptr shift)
+{
+	uintptr obits;
+
+	for(;;) {
+		obits = *bitp;
+		if(runtime·gomaxprocs == 1) {
+			*bitp = obits & ~(bitMarked<<shift);
+			break;
+		} else {
+			// gomaxprocs > 1: use atomic op
+			if(runtime·casp((void**)bitp, (void*)obits, (void*)(obits & ~(bitMarked<<shift))))
+				break;
+		}
+	}
+}
+
+// Account for n blocks of size bytes freed by the sweep.
+// The next collection was planned from the heap size before
+// the sweep, move it by the share of the freed memory.
+static void
+sweepfreed(int32 cl, int32 n, uintptr size)
+{
+	uint64 d;
+
+	runtime·lock(&sweep);
+	mstats.alloc -= n*size;
+	mstats.nfree += n;
+	if(cl != 0)
+		mstats.by_size[cl].nfree += n;
+	d = (uint64)n*size;
+	d += d*gcpercent/100;
+	if(mstats.next_gc > d)
+		mstats.next_gc -= d;
+	else
+		mstats.next_gc = 0;
+	runtime·unlock(&sweep);
+}
+
+// Sweep frees blocks of s not marked in the mark phase,
+// and clears the mark bits in preparation for the next GC round.
+// The caller has claimed s by moving s->sweepgen to mheap.sweepgen-1.
+void
+runtime·MSpan_Sweep(MSpan *s)
+{
+	int32 cl, n, npages, nfree;
+	uintptr size, off, *bitp, shift, bits;
 	byte *p;
 	MCache *c;
-	Finalizer *f;
+	MLink *first, *last;
+
+	p = (byte*)(s->start << PageShift);
+	cl = s->sizeclass;
+	if(cl == 0) {
+		size = s->npages<<PageShift;
+		n = 1;
+	} else {
+		// Chunk full of small blocks.
+		size = runtime·class_to_size[cl];
+		npages = runtime·class_to_allocnpages[cl];
+		n = (npages << PageShift) / size;
+	}
+	c = m->mcache;
+	nfree = 0;
+	first = nil;
+	last = nil;
+
+	// sweep through n objects of given size starting at p.
+	for(; n > 0; n--, p += size) {
+		off = (uintptr*)p - (uintptr*)runtime·mheap.arena_start;
+		bitp = (uintptr*)runtime·mheap.arena_start - off/wordsPerBitmapWord - 1;
+		shift = off % wordsPerBitmapWord;
+		bits = *bitp>>shift;
 
-	for(s = runtime·mheap.allspans; s != nil; s = s->allnext) {
-		if(s->state != MSpanInUse)
+		if((bits & bitAllocated) == 0)
 			continue;
 
-		p = (byte*)(s->start << PageShift);
-		cl = s->sizeclass;
+		if((bits & bitMarked) != 0) {
+			unmarkbit(bitp, shift);
+			continue;
+		}
+
+		// Special means it has a finalizer or is being profiled.
+		// Blocks with finalizers to run were marked by the collection.
+		if((bits & bitSpecial) != 0)
+			runtime·MProf_Free(p, size);
+
+		// Mark freed; restore block boundary bit.
+		runtime·markfreed(p, size);
+
 		if(cl == 0) {
-			size = s->npages<<PageShift;
-			n = 1;
-		} else {
-			// Chunk full of small blocks.
-			size = runtime·class_to_size[cl];
-			npages = runtime·class_to_allocnpages[cl];
-			n = (npages << PageShift) / size;
+			// Free large span.
+			runtime·unmarkspan(p, 1<<PageShift);
+			*(uintptr*)p = 1;	// needs zeroing
+			s->sweepgen = runtime·mheap.sweepgen;
+			runtime·MHeap_Free(&runtime·mheap, s, 1);
+			sweepfreed(0, 1, size);
+			return;
 		}
-	
-		// sweep through n objects of given size starting at p.
-		for(; n > 0; n--, p += size) {
-			uintptr off, *bitp, shift, bits;
 
-			off = (uintptr*)p - (uintptr*)runtime·mheap.arena_start;
-			bitp = (uintptr*)runtime·mheap.arena_start - off/wordsPerBitmapWord - 1;
-			shift = off % wordsPerBitmapWord;
-			bits = *bitp>>shift;
+		// Free small object.
+		if(size > sizeof(uintptr))
+			((uintptr*)p)[1] = 1;	// mark as "needs to be zeroed"
+		if(first == nil)
+			first = (MLink*)p;
+		else
+			last->next = (MLink*)p;
+		last = (MLink*)p;
+		nfree++;
+	}
 
-			if((bits & bitAllocated) == 0)
-				continue;
+	if(cl == 0) {
+		s->sweepgen = runtime·mheap.sweepgen;
+		return;
+	}
+	if(nfree > 0) {
+		c->local_alloc -= nfree*size;
+		c->local_objects -= nfree;
+		sweepfreed(cl, nfree, size);
+	}
+	runtime·MCentral_FreeSpan(&runtime·mheap.central[cl], s, nfree, first, last);
+}
 
-			if((bits & bitMarked) != 0) {
-				*bitp &= ~(bitMarked<<shift);
-				continue;
-			}
+// Sweep the next unswept span of the heap.
+// Returns its number of pages, or -1 if the sweep is done.
+uintptr
+runtime·sweepone(void)
+{
+	MSpan *s;
+	uint32 sg;
+	uintptr npages;
 
-			if((bits & bitSpecial) != 0) {
-				// Special means it has a finalizer or is being profiled.
-				f = runtime·getfinalizer(p, 1);
-				if(f != nil) {
-					f->arg = p;
-					f->next = finq;
-					finq = f;
-					continue;
-				}
-				runtime·MProf_Free(p, size);
-			}
+	sg = runtime·mheap.sweepgen;
+	for(;;) {
+		s = sweep.spans;
+		if(s == nil)
+			return -1;
+		if(!runtime·casp((void**)&sweep.spans, s, s->allnext))
+			continue;
+		if(s->state != MSpanInUse || s->sweepgen != sg-2)
+			continue;
+		if(!runtime·cas(&s->sweepgen, sg-2, sg-1))
+			continue;
+		npages = s->npages;	// s may go back to the heap
+		runtime·MSpan_Sweep(s);
+		return npages;
+	}
+}
 
-			// Mark freed; restore block boundary bit.
-			*bitp = (*bitp & ~(bitMask<<shift)) | (bitBlockBoundary<<shift);
+// Make sure the mark bits of s are those of the last collection,
+// sweeping s or waiting for the M that sweeps it.
+void
+runtime·MSpan_EnsureSwept(MSpan *s)
+{
+	uint32 sg;
 
-			if(s->sizeclass == 0) {
-				// Free large span.
-				runtime·unmarkspan(p, 1<<PageShift);
-				*(uintptr*)p = 1;	// needs zeroing
-				runtime·MHeap_Free(&runtime·mheap, s, 1);
-			} else {
-				// Free small object.
-				c = m->mcache;
-				if(size > sizeof(uintptr))
-					((uintptr*)p)[1] = 1;	// mark as "needs to be zeroed"
-				mstats.by_size[s->sizeclass].nfree++;
-				runtime·MCache_Free(c, p, s->sizeclass, size);
-			}
-			mstats.alloc -= size;
-			mstats.nfree++;
+	sg = runtime·mheap.sweepgen;
+	if(s->sweepgen == sg)
+		return;
+	if(runtime·cas(&s->sweepgen, sg-2, sg-1)) {
+		runtime·MSpan_Sweep(s);
+		return;
+	}
+	while(!runtime·cas(&s->sweepgen, sg, sg))
+		;
+}
+
+static void
+bgsweep(void)
+{
+	for(;;) {
+		while(runtime·sweepone() != -1) {
+			sweep.nbgsweep++;
+			runtime·gosched();
 		}
+		// Like runfinq, only the collector wakes us up
+		// and it runs when everyone else is stopped.
+		sweep.parked = 1;
+		g->status = Gwaiting;
+		runtime·gosched();
 	}
 }
 
-// Semaphore, not Lock, so that the goroutine
-// reschedules when there is contention rather
-// than spinning.
-static uint32 gcsema = 1;
+// Queuefinalizers callback: a block with a finalizer that was
+// not marked is kept for one more collection, for the finalizer
+// to run; what it points at was marked by markfin.
+static bool
+marktofinalize(void *v)
+{
+	uintptr off, *bitp, shift;
 
-// Initialized from $GOGC.  GOGC=off means no gc.
-//
-// Next gc is after we've allocated an extra amount of
-// memory proportional to the amount already in use.
-// If gcpercent=100 and we're using 4M, we'll gc again
-// when we get to 8M.  This keeps the gc cost in linear
-// proportion to the allocation cost.  Adjusting gcpercent
-// just changes the linear constant (and also the amount of
-// extra memory used).
-static int32 gcpercent = -2;
+	off = (uintptr*)v - (uintptr*)runtime·mheap.arena_start;
+	bitp = (uintptr*)runtime·mheap.arena_start - off/wordsPerBitmapWord - 1;
+	shift = off % wordsPerBitmapWord;
+	if((*bitp>>shift) & bitMarked)
+		return false;
+	*bitp |= bitMarked<<shift;
+	return true;
+}
 
 static void
 stealcache(void)
@@ -511,11 +982,17 @@ cachestats(void)
 	}
 }
 
+// Force is 0 when called because the heap reached next_gc, 1 to collect
+// regardless, 2 to collect and also sweep the whole heap in the pause.
+// Without force, the collection starts a concurrent mark when it can;
+// the next call, once the mark is done, finishes the collection.
 void
 runtime·gc(int32 force)
 {
-	int64 t0, t1, t2, t3;
-	uint64 heap0, heap1, obj0, obj1;
+	int64 t0, t1, t2, t3, us, pause0, tmark;
+	uint64 heap0, obj0, obj1;
+	int32 i;
+	bool again;
 	byte *p;
 	Finalizer *fp;
 
@@ -542,39 +1019,133 @@ runtime·gc(int32 force)
 		p = runtime·getenv("GOGCTRACE");
 		if(p != nil)
 			gctrace = runtime·atoi(p);
+		p = runtime·getenv("GOGCVERIFY");
+		if(p != nil)
+			gcverify = runtime·atoi(p);
 	}
 	if(gcpercent < 0)
 		return;
 
 	runtime·semacquire(&gcsema);
-	if(!force && mstats.heap_alloc < mstats.next_gc) {
-		runtime·semrelease(&gcsema);
-		return;
+	if(runtime·writebarrier) {
+		// A concurrent mark is running: finish it once it is done,
+		// or once the heap has outgrown it.
+		if(!force && !work.done && mstats.heap_alloc < mstats.next_gc) {
+			runtime·semrelease(&gcsema);
+			return;
+		}
+	} else {
+		if(!force && mstats.heap_alloc < mstats.next_gc) {
+			runtime·semrelease(&gcsema);
+			return;
+		}
+
+		// Finish the sweep of the last collection before stopping
+		// the world; it may free enough to make this one unnecessary.
+		while(runtime·sweepone() != -1)
+			sweep.npausesweep++;
+		if(!force && mstats.heap_alloc < mstats.next_gc) {
+			runtime·semrelease(&gcsema);
+			return;
+		}
+
+		nlookup = 0;
+		nsizelookup = 0;
+		naddrlookup = 0;
+		nscanwords = 0;
+		ntypedwords = 0;
 	}
 
 	t0 = runtime·nanotime();
-	nlookup = 0;
-	nsizelookup = 0;
-	naddrlookup = 0;
-
 	m->gcing = 1;
 	runtime·stoptheworld();
 	if(runtime·mheap.Lock.key != 0)
 		runtime·throw("runtime·mheap locked during gc");
 
-	cachestats();
-	heap0 = mstats.heap_alloc;
-	obj0 = mstats.nmalloc - mstats.nfree;
+	// A collection forced during a concurrent mark
+	// finishes it and then starts over.
+	again = false;
+	pause0 = 0;
+	tmark = 0;
+	if(runtime·writebarrier) {
+		again = force;
+		heap0 = work.heap0;
+		obj0 = work.obj0;
+		pause0 = work.pause0;
+		tmark = t0 - work.tstart;
+		markfinish();
+		if(gcverify)
+			verifymark();
+	} else {
+		// Spans claimed while we waited for the world to stop.
+		while(runtime·sweepone() != -1)
+			sweep.npausesweep++;
+
+		cachestats();
+		heap0 = mstats.heap_alloc;
+		obj0 = mstats.nmalloc - mstats.nfree;
+
+		if(thechar != '5' && !force && gcpercent > 0) {
+			markstart();
+			work.heap0 = heap0;
+			work.obj0 = obj0;
+			t1 = runtime·nanotime();
+			work.pause0 = t1 - t0;
+			work.tstart = t1;
+			mstats.pause_total_ns += t1 - t0;
+			us = (t1-t0)/1000;
+			for(i=0; us >= 2 && i < NumPauseHist-1; i++)
+				us >>= 1;
+			mstats.pause_hist[i]++;
+			if(mstats.debuggc)
+				runtime·printf("pause %D\n", t1-t0);
+			m->gcing = 0;
+
+			// kick off or wake up the background marker
+			m->locks++;
+			if(work.g == nil)
+				work.g = runtime·newproc1((byte*)bgmark, nil, 0, 0, runtime·gc);
+			else if(work.parked) {
+				work.parked = 0;
+				runtime·ready(work.g);
+			}
+			m->locks--;
 
-	mark();
+			runtime·semrelease(&gcsema);
+			runtime·starttheworld();
+			return;
+		}
+		mark();
+	}
 	t1 = runtime·nanotime();
-	sweep();
-	t2 = runtime·nanotime();
+
+	// Queue the finalizers of the unreachable blocks,
+	// keeping the blocks until the finalizers have run.
+	runtime·queuefinalizers(marktofinalize, &finq);
 	stealcache();
 
+	// Start the sweep: every span in use needs sweeping
+	// before its free blocks are reused.
+	runtime·mheap.sweepgen += 2;
+	sweep.spans = runtime·mheap.allspans;
+	for(i=0; i<NumSizeClasses; i++)
+		runtime·MCentral_StartSweep(&runtime·mheap.central[i]);
+
+	// The sweep moves next_gc down as it frees memory.
 	mstats.next_gc = mstats.heap_alloc+mstats.heap_alloc*gcpercent/100;
+
+	// runtime.GC sweeps the heap in the pause,
+	// so the statistics are settled when it returns.
+	if(force > 1 && !again)
+		while(runtime·sweepone() != -1)
+			sweep.npausesweep++;
+	t2 = runtime·nanotime();
 	m->gcing = 0;
 
+	// Release the stack segments kept for reuse.
+	// Not while gcing: they did not come from the fixed-size stack allocator.
+	runtime·stackshrink();
+
 	m->locks++;	// disable gc during the mallocs in newproc
 	fp = finq;
 	if(fp != nil) {
@@ -586,26 +1157,47 @@ runtime·gc(int32 force)
 			runtime·ready(fing);
 		}
 	}
+	// kick off or wake up the background sweeper
+	if(sweep.g == nil)
+		sweep.g = runtime·newproc1((byte*)bgsweep, nil, 0, 0, runtime·gc);
+	else if(sweep.parked) {
+		sweep.parked = 0;
+		runtime·ready(sweep.g);
+	}
+	// and the scavenger, which returns the idle heap to the OS
+	if(scvg == nil)
+		scvg = runtime·newproc1((byte*)runtime·MHeap_Scavenger, nil, 0, 0, runtime·gc);
 	m->locks--;
 
 	cachestats();
-	heap1 = mstats.heap_alloc;
 	obj1 = mstats.nmalloc - mstats.nfree;
 
+	// pause_ns holds both pauses of a concurrent collection,
+	// pause_hist and pause_total_ns each on its own.
 	t3 = runtime·nanotime();
-	mstats.pause_ns[mstats.numgc%nelem(mstats.pause_ns)] = t3 - t0;
+	mstats.last_gc = t3;
+	mstats.pause_ns[mstats.numgc%nelem(mstats.pause_ns)] = pause0 + t3 - t0;
 	mstats.pause_total_ns += t3 - t0;
+	us = (t3-t0)/1000;
+	for(i=0; us >= 2 && i < NumPauseHist-1; i++)
+		us >>= 1;
+	mstats.pause_hist[i]++;
 	mstats.numgc++;
 	if(mstats.debuggc)
 		runtime·printf("pause %D\n", t3-t0);
 	
 	if(gctrace) {
-		runtime·printf("gc%d: %D+%D+%D ms %D -> %D MB %D -> %D (%D-%D) objects %D pointer lookups (%D size, %D addr)\n",
-			mstats.numgc, (t1-t0)/1000000, (t2-t1)/1000000, (t3-t2)/1000000,
-			heap0>>20, heap1>>20, obj0, obj1,
+		runtime·printf("gc%d: %D+%D+%D+%D+%D ms %D MB %D -> %D (%D-%D) objects %d+%d spans swept (background+gc) %D pointer lookups (%D size, %D addr) %D words scanned (%D typed)\n",
+			mstats.numgc, pause0/1000000, tmark/1000000,
+			(t1-t0)/1000000, (t2-t1)/1000000, (t3-t2)/1000000,
+			heap0>>20, obj0, obj1,
 			mstats.nmalloc, mstats.nfree,
-			nlookup, nsizelookup, naddrlookup);
+			sweep.nbgsweep, sweep.npausesweep,
+			nlookup, nsizelookup, naddrlookup,
+			nscanwords, ntypedwords);
 	}
+	sweep.nbgsweep = 0;
+	sweep.npausesweep = 0;
 
 	runtime·semrelease(&gcsema);
 	runtime·starttheworld();
@@ -614,7 +1206,9 @@ runtime·gc(int32 force)
 	if(fp != nil)
 		runtime·gosched();
 	
-	if(gctrace > 1 && !force)
+	if(again)
+		runtime·gc(force);
+	else if(gctrace > 1 && !force)
 		runtime·gc(1);
 }
 
@@ -14,6 +14,7 @@
 
 #include "runtime.h"
 #include "malloc.h"
+#include "type.h"
 
 static MSpan *MHeap_AllocLocked(MHeap*, uintptr, int32);
 static bool MHeap_Grow(MHeap*, uintptr);
@@ -38,9 +39,16 @@ void
 runtime·MHeap_Init(MHeap *h, void *(*alloc)(uintptr))
 {
 	uint32 i;
+	uintptr n;
 
 	runtime·FixAlloc_Init(&h->spanalloc, sizeof(MSpan), alloc, RecordSpan, h);
 	runtime·FixAlloc_Init(&h->cachealloc, sizeof(MCache), alloc, nil, nil);
+	for(i=1; i<nelem(h->typesalloc); i++) {
+		n = (runtime·class_to_allocnpages[i]<<PageShift) >> runtime·class_to_typeshift[i];
+		n = (sizeof(MTypes) - 1 + n + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+		runtime·FixAlloc_Init(&h->typesalloc[i], n, alloc, nil, nil);
+	}
+	runtime·FixAlloc_Init(&h->typestaballoc, MTypesMax*sizeof(uintptr*), alloc, nil, nil);
 	// h->mapcache needs no init
 	for(i=0; i<nelem(h->free); i++)
 		runtime·MSpanList_Init(&h->free[i]);
@@ -55,6 +63,14 @@ MSpan*
 runtime·MHeap_Alloc(MHeap *h, uintptr npage, int32 sizeclass, int32 acct)
 {
 	MSpan *s;
+	uintptr n, swept;
+
+	// Sweep at least as many pages as we take from the heap,
+	// so the sweep after a collection keeps ahead of heap growth
+	// and the heap is refilled with garbage before it is grown.
+	for(swept = 0; swept < npage; swept += n)
+		if((n = runtime·sweepone()) == (uintptr)-1)
+			break;
 
 	runtime·lock(h);
 	mstats.heap_alloc += m->mcache->local_alloc;
@@ -103,7 +119,12 @@ HaveSpan:
 	if(s->npages < npage)
 		runtime·throw("MHeap_AllocLocked - bad npages");
 	runtime·MSpanList_Remove(s);
+	s->sweepgen = h->sweepgen;	// before state, for the sweepers
 	s->state = MSpanInUse;
+	s->types = 0;
+	mstats.heap_idle -= s->npages<<PageShift;
+	mstats.heap_released -= s->npreleased<<PageShift;
+	s->npreleased = 0;
 
 	if(s->npages > npage) {
 		// Trim extra and put it back in the heap.
@@ -122,6 +143,7 @@ HaveSpan:
 		*(uintptr*)(t->start<<PageShift) = *(uintptr*)(s->start<<PageShift);  // copy "needs zeroing" mark
 		t->state = MSpanInUse;
 		MHeap_FreeLocked(h, t);
+		t->unusedsince = s->unusedsince;	// preserve age
 	}
 
 	if(*(uintptr*)(s->start<<PageShift) != 0)
@@ -276,15 +298,27 @@ MHeap_FreeLocked(MHeap *h, MSpan *s)
 {
 	uintptr *sp, *tp;
 	MSpan *t;
+	MTypes *mt;
 	PageID p;
 
 	if(s->state != MSpanInUse || s->ref != 0) {
 		runtime·printf("MHeap_FreeLocked - span %p ptr %p state %d ref %d\n", s, s->start<<PageShift, s->state, s->ref);
 		runtime·throw("MHeap_FreeLocked - invalid free");
 	}
+	if(s->types & MTypesTable) {
+		mt = (MTypes*)(s->types & ~MTypesTable);
+		if(mt->gc != mt->tab)
+			runtime·FixAlloc_Free(&h->typestaballoc, mt->gc);
+		runtime·FixAlloc_Free(&h->typesalloc[s->sizeclass], mt);
+	}
+	s->types = 0;
 	s->state = MSpanFree;
 	runtime·MSpanList_Remove(s);
 	sp = (uintptr*)(s->start<<PageShift);
+	mstats.heap_idle += s->npages<<PageShift;
+	// Stamp the span for the scavenger, see MHeap_Scavenger.
+	s->unusedsince = runtime·nanotime();
+	s->npreleased = 0;
 
 	// Coalesce with earlier, later spans.
 	p = s->start;
@@ -295,6 +329,7 @@ MHeap_FreeLocked(MHeap *h, MSpan *s)
 		*tp |= *sp;	// propagate "needs zeroing" mark
 		s->start = t->start;
 		s->npages += t->npages;
+		s->npreleased += t->npreleased;
 		p -= t->npages;
 		h->map[p] = s;
 		runtime·MSpanList_Remove(t);
@@ -307,6 +342,7 @@ MHeap_FreeLocked(MHeap *h, MSpan *s)
 		tp = (uintptr*)(t->start<<PageShift);
 		*sp |= *tp;	// propagate "needs zeroing" mark
 		s->npages += t->npages;
+		s->npreleased += t->npreleased;
 		h->map[p + s->npages - 1] = s;
 		runtime·MSpanList_Remove(t);
 		t->state = MSpanDead;
@@ -320,8 +356,97 @@ MHeap_FreeLocked(MHeap *h, MSpan *s)
 		runtime·MSpanList_Insert(&h->free[s->npages], s);
 	else
 		runtime·MSpanList_Insert(&h->large, s);
+}
+
+// Release the pages of the spans in list free since before now-limit.
+// The "needs zeroing" mark survives: SysUnused either keeps the
+// pages or gives them back zeroed, and zeroed pages need no zeroing.
+static uintptr
+ScavengeList(MSpan *list, int64 now, int64 limit)
+{
+	uintptr released, sumreleased;
+	MSpan *s;
+
+	sumreleased = 0;
+	for(s=list->next; s != list; s=s->next) {
+		if(now - s->unusedsince > limit && s->npreleased != s->npages) {
+			released = (s->npages - s->npreleased) << PageShift;
+			mstats.heap_released += released;
+			sumreleased += released;
+			s->npreleased = s->npages;
+			runtime·SysUnused((void*)(s->start << PageShift), s->npages << PageShift);
+		}
+	}
+	return sumreleased;
+}
+
+static uintptr
+MHeap_Scavenge(MHeap *h, int64 now, int64 limit)
+{
+	uint32 i;
+	uintptr sumreleased;
+
+	runtime·lock(h);
+	sumreleased = 0;
+	for(i=0; i<nelem(h->free); i++)
+		sumreleased += ScavengeList(&h->free[i], now, limit);
+	sumreleased += ScavengeList(&h->large, now, limit);
+	runtime·unlock(h);
+	return sumreleased;
+}
+
+// The scavenger goroutine, started by the first collection, returns
+// to the OS the pages of the spans that stay free for limit after
+// they were freed.  A program that stops allocating stops collecting
+// too and would keep its garbage, so the scavenger collects itself
+// once no collection ran for forcegc.
+void
+runtime·MHeap_Scavenger(void)
+{
+	int64 tick, now, forcegc, limit;
+	uintptr sumreleased;
+	uint32 k;
+	bool trace;
+	byte *p;
+
+	g->isbackground = true;
+
+	forcegc = 2*60*1000000000LL;
+	limit = 5*60*1000000000LL;
+	// Wake up often enough to notice either in time.
+	tick = forcegc;
+	if(tick > limit)
+		tick = limit;
+	tick /= 2;
+
+	p = runtime·getenv("GOGCTRACE");
+	trace = p != nil && runtime·atoi(p) > 0;
+
+	for(k=0;; k++) {
+		runtime·entersyscall();
+		runtime·usleep(tick/1000);
+		runtime·exitsyscall();
+
+		now = runtime·nanotime();
+		if(now - mstats.last_gc > forcegc) {
+			runtime·gc(1);
+			now = runtime·nanotime();
+		}
+		sumreleased = MHeap_Scavenge(&runtime·mheap, now, limit);
+		if(trace)
+			runtime·printf("scvg%d: %D MB released, inuse: %D, idle: %D, sys: %D, released: %D, consumed: %D (MB)\n",
+				k, (uint64)sumreleased>>20,
+				mstats.heap_inuse>>20, mstats.heap_idle>>20, mstats.heap_sys>>20,
+				mstats.heap_released>>20, (mstats.heap_sys - mstats.heap_released)>>20);
+	}
+}
 
-	// TODO(rsc): IncrementalScavenge() to return memory to OS.
+// Release every free span now, for tests.
+void
+runtime·scavenge(void)
+{
+	runtime·gc(2);
+	MHeap_Scavenge(&runtime·mheap, runtime·nanotime(), -1);
 }
 
 // Initialize a new span with the given start and npages.
@@ -333,9 +458,101 @@ runtime·MSpan_Init(MSpan *span, PageID start, uintptr npages)
 	span->start = start;
 	span->npages = npages;
 	span->freelist = nil;
+	span->freebuf = nil;
 	span->ref = 0;
 	span->sizeclass = 0;
+	span->sweepgen = runtime·mheap.sweepgen;
 	span->state = 0;
+	span->types = 0;
+	span->unusedsince = 0;
+	span->npreleased = 0;
+}
+
+// The type of the objects allocated without one:
+// every word may be a pointer.
+static uintptr untyped[2] = {1, 1};
+
+// Return the index of gc in the table mt, adding it if need be,
+// or 0 if the table is full.
+static uintptr
+MTypes_Index(MTypes *mt, uintptr *gc)
+{
+	uintptr **tab;
+	uintptr j, n;
+
+	// Entries are only ever added, under the heap lock,
+	// so look for gc without it first.
+	n = mt->gc == mt->tab ? MTypesTab : MTypesMax;
+	for(j=1; j<n && mt->gc[j] != nil; j++)
+		if(mt->gc[j] == gc)
+			return j;
+
+	runtime·lock(&runtime·mheap);
+	n = mt->gc == mt->tab ? MTypesTab : MTypesMax;
+	for(j=1; j<n && mt->gc[j] != nil && mt->gc[j] != gc; j++)
+		;
+	if(j == MTypesTab && n == MTypesTab) {
+		tab = runtime·FixAlloc_Alloc(&runtime·mheap.typestaballoc);
+		runtime·memclr((byte*)tab, MTypesMax*sizeof tab[0]);
+		runtime·memmove(tab, mt->tab, sizeof mt->tab);
+		mt->gc = tab;
+		n = MTypesMax;
+	}
+	if(j == n)
+		j = 0;
+	else if(mt->gc[j] == nil)
+		mt->gc[j] = gc;
+	runtime·unlock(&runtime·mheap);
+	return j;
+}
+
+// Record gc as the pointer bitmap of the object v allocated from span;
+// nil if v was allocated without a type.
+void
+runtime·MSpan_SetType(MSpan *span, void *v, uintptr *gc)
+{
+	MTypes *mt;
+	uintptr types, j, n;
+
+	if(span->sizeclass == 0) {
+		span->types = (uintptr)gc;
+		return;
+	}
+	if(gc == nil)
+		gc = untyped;
+	types = span->types;
+	if(types == (uintptr)gc)
+		return;
+
+	if((types & MTypesTable) == 0) {
+		// The first object with pointers in the span, or the first
+		// of another type than the others: switch to a table.
+		runtime·lock(&runtime·mheap);
+		types = span->types;
+		if(types == 0)
+			span->types = types = (uintptr)gc;
+		else if(types != (uintptr)gc && (types & MTypesTable) == 0) {
+			mt = runtime·FixAlloc_Alloc(&runtime·mheap.typesalloc[span->sizeclass]);
+			runtime·memclr((byte*)mt, runtime·mheap.typesalloc[span->sizeclass].size);
+			mt->gc = mt->tab;
+			if(types != (uintptr)untyped) {
+				mt->tab[1] = (uintptr*)types;
+				n = (span->npages<<PageShift) >> runtime·class_to_typeshift[span->sizeclass];
+				for(j=0; j<n; j++)
+					mt->idx[j] = 1;
+			}
+			span->types = types = (uintptr)mt | MTypesTable;
+		}
+		runtime·unlock(&runtime·mheap);
+		if(types == (uintptr)gc)
+			return;
+	}
+
+	mt = (MTypes*)(types & ~MTypesTable);
+	j = 0;
+	if(gc != untyped)
+		j = MTypes_Index(mt, gc);
+	mt->idx[((byte*)v - (byte*)(span->start<<PageShift)) >> runtime·class_to_typeshift[span->sizeclass]] = j;
 }
 
 // Initialize an empty doubly-linked list.
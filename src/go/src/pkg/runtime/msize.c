@@ -30,7 +30,7 @@
 
 int32 runtime·class_to_size[NumSizeClasses];
 int32 runtime·class_to_allocnpages[NumSizeClasses];
-int32 runtime·class_to_transfercount[NumSizeClasses];
+int32 runtime·class_to_typeshift[NumSizeClasses];
 
 // The SizeToClass lookup is implemented using two arrays,
 // one mapping sizes <= 1024 to their class and one mapping
@@ -137,14 +137,11 @@ runtime·InitSizes(void)
 	for(i=0; i<nelem(runtime·class_to_size); i++)
 		mstats.by_size[i].size = runtime·class_to_size[i];
 
-	// Initialize the runtime·class_to_transfercount table.
+	// Initialize the runtime·class_to_typeshift table.
 	for(sizeclass = 1; sizeclass < NumSizeClasses; sizeclass++) {
-		n = 64*1024 / runtime·class_to_size[sizeclass];
-		if(n < 2)
-			n = 2;
-		if(n > 32)
-			n = 32;
-		runtime·class_to_transfercount[sizeclass] = n;
+		for(i=0; (runtime·class_to_size[sizeclass]>>i & 1) == 0; i++)
+			;
+		runtime·class_to_typeshift[sizeclass] = i;
 	}
 	return;
 
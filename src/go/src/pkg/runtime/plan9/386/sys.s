@@ -24,6 +24,11 @@ TEXT runtime·brk_(SB),7,$0
 	INT     $64
 	RET
 
+TEXT runtime·sleep(SB),7,$0
+	MOVL    $17, AX
+	INT     $64
+	RET
+
 TEXT runtime·plan9_semacquire(SB),7,$0
 	MOVL	$37, AX
 	INT	$64
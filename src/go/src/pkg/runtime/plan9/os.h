@@ -5,6 +5,7 @@
 extern int32 runtime·write(int32 fd, void* buffer, int32 nbytes);
 extern void runtime·exits(int8* msg);
 extern int32 runtime·brk_(void*);
+extern int32 runtime·sleep(int32 ms);
 
 /* rfork */
 enum
@@ -117,6 +117,15 @@ runtime·usemrelease(Usema *s)
 }
 
 
+void
+runtime·usleep(uint32 usec)
+{
+	usec /= 1000;
+	if(usec == 0)
+		usec = 1;
+	runtime·sleep(usec);
+}
+
 // Event notifications.
 void
 runtime·noteclear(Note *n)
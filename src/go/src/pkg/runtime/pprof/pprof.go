@@ -84,6 +84,7 @@ func WriteHeapProfile(w io.Writer) os.Error {
 	fmt.Fprintf(b, "# HeapSys = %d\n", s.HeapSys)
 	fmt.Fprintf(b, "# HeapIdle = %d\n", s.HeapIdle)
 	fmt.Fprintf(b, "# HeapInuse = %d\n", s.HeapInuse)
+	fmt.Fprintf(b, "# HeapReleased = %d\n", s.HeapReleased)
 
 	fmt.Fprintf(b, "# Stack = %d / %d\n", s.StackInuse, s.StackSys)
 	fmt.Fprintf(b, "# MSpan = %d / %d\n", s.MSpanInuse, s.MSpanSys)
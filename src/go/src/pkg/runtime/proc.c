@@ -48,6 +48,15 @@ int32	runtime·gcwaiting;
 // system calls, but that would limit the amount of parallel computation
 // that go would try to do.
 //
+// Each m has a bounded local run queue of gs.  The gs that a running m
+// readies or creates go to its own queue, and when the running g stops, the
+// m keeps its cpu and takes the next g from the queue, all without taking
+// the scheduler lock.  An m that runs out of work looks at the global queue,
+// then steals half of the queue of a random other m.  The global queue takes
+// the overflow of the local queues, the gs of ms that block in system calls
+// or go idle, and the gs wired to an m; it is polled every so often for
+// fairness.
+//
 // In general, one could imagine all sorts of refinements to the
 // scheduler, but the goal now is just to get something working on
 // Linux and OS X.
@@ -55,9 +64,9 @@ int32	runtime·gcwaiting;
 struct Sched {
 	Lock;
 
-	G *gfree;	// available gs (status == Gdead)
+	G *gfree;	// available gs (status == Gdead), under gflock
 
-	G *ghead;	// gs waiting to run
+	G *ghead;	// global queue of gs waiting to run
 	G *gtail;
 	int32 gwait;	// number of gs waiting to run
 	int32 gcount;	// number of gs that are alive
@@ -67,7 +76,8 @@ struct Sched {
 	int32 mcount;	// number of ms that have been created
 	int32 mcpu;	// number of ms executing on cpu
 	int32 mcpumax;	// max number of ms allowed on cpu
-	int32 msyscall;	// number of ms in system calls
+	int32 msyscall;	// number of ms in system calls, but for background gs
+	int32 stealing;	// an m was woken or started to steal from local queues
 
 	int32 predawn;	// running initialization, don't run new gs.
 
@@ -78,6 +88,8 @@ struct Sched {
 Sched runtime·sched;
 int32 gomaxprocs;
 
+static Lock gflock;
+
 // An m that is waiting for notewakeup(&m->havenextg).  This may be
 // only be accessed while the scheduler lock is held.  This is used to
 // minimize the number of times we call notewakeup while the scheduler
@@ -90,11 +102,21 @@ static void gput(G*);	// put/get on ghead/gtail
 static G* gget(void);
 static void mput(M*);	// put/get on mhead
 static M* mget(G*);
-static void gfput(G*);	// put/get on gfree
-static G* gfget(void);
 static void matchmg(void);	// match ms to gs
-static void readylocked(G*);	// ready, but sched is locked
 static void mnextg(M*, G*);
+static M* newm(void);
+
+// Local run queues.  Sched need not be locked.
+static void runqput(G*);	// put on the queue of m
+static G* runqget(M*);
+static G* runqsteal(void);	// get from the queue of m, or steal
+static bool runqwork(void);
+static void runqflush(void);	// move the queue of m to `g' queue, sched locked
+
+static void gfput(G*);	// put/get on gfree, local to m
+static G* gfget(void);
+static void putg(G*);
+static void wakem(void);
 
 // Scheduler loop.
 static void scheduler(void);
@@ -118,6 +140,8 @@ runtime·schedinit(void)
 	byte *p;
 
 	runtime·allm = m;
+	// Seeds the maps' hashes too (see hashmap.c), so vary it per run.
+	m->fastrand = 0x49f6428aUL ^ (uint32)runtime·nanotime() | 1;
 	m->nomemprof++;
 
 	runtime·mallocinit();
@@ -287,27 +311,200 @@ mget(G *g)
 	return m;
 }
 
-// Mark g ready to run.
-void
-runtime·ready(G *g)
+uint32
+runtime·fastrand1(void)
 {
+	uint32 x;
+
+	x = m->fastrand;
+	x += x;
+	if(x & 0x80000000L)
+		x ^= 0x88888eefUL;
+	m->fastrand = x;
+	return x;
+}
+
+// The local run queue of an m is a ring of gs.  Only its m puts gs
+// at the tail, and takes them from the head with a cas, as do other
+// ms stealing from it.  Head and tail only grow, so a cas on the head
+// fails if anybody took gs since it was read.
+
+// Put g on the local run queue of m.
+// If the queue is full, move half of it to `g' queue.
+static void
+runqput(G *g)
+{
+	G *batch[nelem(m->runq)/2+1];
+	uint32 h, t, i, n;
+
+	for(;;) {
+		h = m->runqhead;
+		t = m->runqtail;
+		if(t - h < nelem(m->runq)) {
+			m->runq[t%nelem(m->runq)] = g;
+			m->runqtail = t+1;
+			return;
+		}
+		n = (t - h)/2;
+		for(i=0; i<n; i++)
+			batch[i] = m->runq[(h+i)%nelem(m->runq)];
+		if(runtime·cas(&m->runqhead, h, h+n))
+			break;
+	}
+	batch[n] = g;
 	schedlock();
-	readylocked(g);
+	for(i=0; i<=n; i++)
+		gput(batch[i]);
+	matchmg();
 	schedunlock();
 }
 
-// Mark g ready to run.  Sched is already locked.
-// G might be running already and about to stop.
-// The sched lock protects g->status from changing underfoot.
+// Get from the local run queue of mp.
+static G*
+runqget(M *mp)
+{
+	G *g;
+	uint32 h;
+
+	for(;;) {
+		h = mp->runqhead;
+		if(h == mp->runqtail)
+			return nil;
+		g = mp->runq[h%nelem(mp->runq)];
+		if(runtime·cas(&mp->runqhead, h, h+1))
+			return g;
+	}
+}
+
+// Steal half of the local run queue of mp into the empty one of m.
+// Return one of the gs stolen.
+static G*
+runqgrab(M *mp)
+{
+	G *batch[nelem(m->runq)/2];
+	uint32 h, t, i, n;
+
+	for(;;) {
+		h = mp->runqhead;
+		t = mp->runqtail;
+		n = t - h;
+		n -= n/2;
+		if(n == 0)
+			return nil;
+		if(n > nelem(mp->runq)/2)	// read head and tail of different times
+			continue;
+		for(i=0; i<n; i++)
+			batch[i] = mp->runq[(h+i)%nelem(mp->runq)];
+		if(runtime·cas(&mp->runqhead, h, h+n))
+			break;
+	}
+	for(i=1; i<n; i++)
+		runqput(batch[i]);
+	return batch[0];
+}
+
+// Get from the local run queue of m, or steal from
+// the queue of another m, starting at a random one.
+static G*
+runqsteal(void)
+{
+	G *g;
+	M *mp;
+	int32 i, n;
+
+	if((g = runqget(m)) != nil)
+		return g;
+	n = runtime·fastrand1() % runtime·sched.mcount;
+	for(mp=runtime·allm; mp != nil && n > 0; mp=mp->alllink)
+		n--;
+	for(i=0; i<runtime·sched.mcount; i++) {
+		if(mp == nil)
+			mp = runtime·allm;
+		if(mp != m && (g = runqgrab(mp)) != nil)
+			return g;
+		mp = mp->alllink;
+	}
+	return nil;
+}
+
+// Is there any g in a local run queue?
+static bool
+runqwork(void)
+{
+	M *mp;
+
+	for(mp=runtime·allm; mp != nil; mp=mp->alllink)
+		if(mp->runqhead != mp->runqtail)
+			return true;
+	return false;
+}
+
+// Move the local run queue of m to `g' queue,
+// so that an m that waits or blocks holds no gs.
+// Sched must be locked.
 static void
-readylocked(G *g)
+runqflush(void)
 {
-	if(g->m){
-		// Running on another machine.
-		// Ready it when it stops.
-		g->readyonstop = 1;
+	G *g;
+
+	while((g = runqget(m)) != nil)
+		gput(g);
+}
+
+// Put g, which is runnable, on a run queue: the local one of m,
+// unless g needs a particular m or m can only run its wired g.
+static void
+putg(G *g)
+{
+	if(g->lockedm != nil || g->idlem != nil || m->lockedg != nil || runtime·sched.predawn) {
+		schedlock();
+		gput(g);
+		if(!runtime·sched.predawn)
+			matchmg();
+		schedunlock();
 		return;
 	}
+	runqput(g);
+}
+
+// There may be new gs in the local run queue of m:
+// if a cpu is free, get an m to steal them.
+static void
+wakem(void)
+{
+	if(runtime·sched.mcpu >= runtime·sched.mcpumax || runtime·sched.stealing || runtime·sched.predawn)
+		return;
+	schedlock();
+	matchmg();
+	schedunlock();
+}
+
+// Values of g->readyonstop, which is only changed with cas
+// once g may have stopped, so that runtime·ready and stopg
+// agree on who readies g.
+enum {
+	Gonm = 0,	// g runs on an m
+	Gready = 1,	// g was readied while running, ready it when it stops
+	Goffm = 2,	// g stopped and waits to be readied
+};
+
+// Mark g ready to run.
+// G might be running already and about to stop: then its m
+// readies it when it stops (see stopg).
+void
+runtime·ready(G *g)
+{
+	uint32 v;
+
+	for(;;) {
+		v = g->readyonstop;
+		if(v == Gready)
+			return;
+		if(v == Gonm && runtime·cas(&g->readyonstop, Gonm, Gready))
+			return;
+		if(v == Goffm && runtime·cas(&g->readyonstop, Goffm, Gonm))
+			break;
+	}
 
 	// Mark runnable.
 	if(g->status == Grunnable || g->status == Grunning) {
@@ -316,9 +513,8 @@ readylocked(G *g)
 	}
 	g->status = Grunnable;
 
-	gput(g);
-	if(!runtime·sched.predawn)
-		matchmg();
+	putg(g);
+	wakem();
 }
 
 static void
@@ -326,21 +522,25 @@ nop(void)
 {
 }
 
-// Same as readylocked but a different symbol so that
+// Same as ready but a different symbol so that
 // debuggers can set a breakpoint here and catch all
 // new goroutines.
 static void
-newprocreadylocked(G *g)
+newprocready(G *g)
 {
 	nop();	// avoid inlining in 6l
-	readylocked(g);
+	g->status = Grunnable;
+	putg(g);
+	wakem();
 }
 
 // Pass g to m for running.
+// A nil g wakes m up to look for work itself.
 static void
 mnextg(M *m, G *g)
 {
-	runtime·sched.mcpu++;
+	if(g != nil)
+		runtime·sched.mcpu++;
 	m->nextg = g;
 	if(m->waitnextg) {
 		m->waitnextg = 0;
@@ -362,6 +562,7 @@ nextgandunlock(void)
 	if(runtime·sched.mcpu < 0)
 		runtime·throw("negative runtime·sched.mcpu");
 
+top:
 	// If there is a g waiting as m->nextg,
 	// mnextg took care of the runtime·sched.mcpu++.
 	if(m->nextg != nil) {
@@ -375,6 +576,7 @@ nextgandunlock(void)
 		// We can only run one g, and it's not available.
 		// Make sure some other cpu is running to handle
 		// the ordinary run queue.
+		runqflush();
 		if(runtime·sched.gwait != 0)
 			matchmg();
 	} else {
@@ -388,7 +590,15 @@ nextgandunlock(void)
 			schedunlock();
 			return gp;
 		}
+		// Then on the local run queues.
+		if(runtime·sched.mcpu < runtime·sched.mcpumax && (gp=runqsteal()) != nil) {
+			runtime·sched.mcpu++;
+			matchmg();	// there may be more to steal
+			schedunlock();
+			return gp;
+		}
 		// Otherwise, wait on global m queue.
+		runqflush();
 		mput(m);
 	}
 	if(runtime·sched.mcpu == 0 && runtime·sched.msyscall == 0)
@@ -403,8 +613,12 @@ nextgandunlock(void)
 	schedunlock();
 
 	runtime·notesleep(&m->havenextg);
-	if((gp = m->nextg) == nil)
-		runtime·throw("bad m->nextg in nextgoroutine");
+	if((gp = m->nextg) == nil) {
+		// Woken up to steal from the local run queues.
+		schedlock();
+		runtime·sched.stealing = 0;
+		goto top;
+	}
 	m->nextg = nil;
 	return gp;
 }
@@ -490,38 +704,116 @@ matchmg(void)
 		M *m;
 
 		// Find the m that will run g.
-		if((m = mget(g)) == nil){
-			m = runtime·malloc(sizeof(M));
-			// Add to runtime·allm so garbage collector doesn't free m
-			// when it is just in a register or thread-local storage.
-			m->alllink = runtime·allm;
-			runtime·allm = m;
-			m->id = runtime·sched.mcount++;
-
-			if(runtime·iscgo) {
-				CgoThreadStart ts;
-
-				if(libcgo_thread_start == nil)
-					runtime·throw("libcgo_thread_start missing");
-				// pthread_create will make us a stack.
-				m->g0 = runtime·malg(-1);
-				ts.m = m;
-				ts.g = m->g0;
-				ts.fn = runtime·mstart;
-				runtime·asmcgocall(libcgo_thread_start, &ts);
-			} else {
-				if(Windows)
-					// windows will layout sched stack on os stack
-					m->g0 = runtime·malg(-1);
-				else
-					m->g0 = runtime·malg(8192);
-				runtime·newosproc(m, m->g0, m->g0->stackbase, runtime·mstart);
+		if((m = mget(g)) == nil)
+			m = newm();
+		mnextg(m, g);
+	}
+
+	// Get an idle m to steal the gs of the local run queues,
+	// unless one is on its way already.  Otherwise start
+	// a new m with one of the gs: like the ms started above,
+	// it holds a cpu from the start, so that the garbage
+	// collector waits for it to finish starting up.
+	if(runtime·sched.mcpu < runtime·sched.mcpumax && !runtime·sched.stealing && runqwork()) {
+		M *m, *mp;
+
+		if((m = runtime·sched.mhead) != nil) {
+			runtime·sched.mhead = m->schedlink;
+			runtime·sched.mwait--;
+			runtime·sched.stealing = 1;
+			mnextg(m, nil);
+		} else {
+			for(mp=runtime·allm; mp != nil; mp=mp->alllink) {
+				if((g = runqget(mp)) != nil) {
+					mnextg(newm(), g);
+					break;
+				}
 			}
 		}
-		mnextg(m, g);
 	}
 }
 
+// Create a new m.  Sched is locked.
+static M*
+newm(void)
+{
+	M *m;
+
+	m = runtime·malloc(sizeof(M));
+	// Add to runtime·allm so garbage collector doesn't free m
+	// when it is just in a register or thread-local storage.
+	m->alllink = runtime·allm;
+	runtime·allm = m;
+	m->id = runtime·sched.mcount++;
+	m->fastrand = runtime·fastrand1() + m->id | 1;
+
+	if(runtime·iscgo) {
+		CgoThreadStart ts;
+
+		if(libcgo_thread_start == nil)
+			runtime·throw("libcgo_thread_start missing");
+		// pthread_create will make us a stack.
+		m->g0 = runtime·malg(-1);
+		ts.m = m;
+		ts.g = m->g0;
+		ts.fn = runtime·mstart;
+		runtime·asmcgocall(libcgo_thread_start, &ts);
+	} else {
+		if(Windows)
+			// windows will layout sched stack on os stack
+			m->g0 = runtime·malg(-1);
+		else
+			m->g0 = runtime·malg(8192);
+		runtime·newosproc(m, m->g0, m->g0->stackbase, runtime·mstart);
+	}
+	return m;
+}
+
+// Finish running gp on m.  Returns whether gp is runnable
+// and must be put back on a run queue.
+static bool
+stopg(G *gp)
+{
+	bool runnable;
+
+	runnable = false;
+	switch(gp->status){
+	case Grunnable:
+	case Gdead:
+		// Shouldn't have been running!
+		runtime·throw("bad gp->status in sched");
+	case Grunning:
+		gp->status = Grunnable;
+		runnable = true;
+		break;
+	case Gmoribund:
+		gp->status = Gdead;
+		if(gp->lockedm) {
+			gp->lockedm = nil;
+			m->lockedg = nil;
+		}
+		gp->idlem = nil;
+		gp->m = nil;
+		unwindstack(gp, nil);
+		gfput(gp);
+		if(runtime·xadd((uint32*)&runtime·sched.gcount, -1) == 0)
+			runtime·exit(0);
+		return false;
+	}
+
+	// See runtime·ready.
+	gp->m = nil;
+	if(runnable) {
+		gp->readyonstop = Gonm;
+		return true;
+	}
+	if(runtime·cas(&gp->readyonstop, Gonm, Goffm))
+		return false;
+	gp->readyonstop = Gonm;
+	gp->status = Grunnable;
+	return true;
+}
+
 // One round of scheduler: find a goroutine and run it.
 // The argument is the goroutine that was running before
 // schedule was called, or nil if this is the first call.
@@ -529,48 +821,39 @@ matchmg(void)
 static void
 schedule(G *gp)
 {
-	schedlock();
 	if(gp != nil) {
 		if(runtime·sched.predawn)
 			runtime·throw("init rescheduling");
 
-		// Just finished running gp.
-		gp->m = nil;
-		runtime·sched.mcpu--;
-
+		if(m->lockedg == nil && gp->idlem == nil) {
+			// Just finished running gp.
+			if(stopg(gp))
+				runqput(gp);
+			// Keep the cpu and run the next g of the local
+			// run queue, unless the world is stopping, there
+			// are too many ms on cpus, or it is time to look
+			// at the global queue.
+			if(!runtime·gcwaiting && runtime·sched.mcpu <= runtime·sched.mcpumax
+			&& (++m->schedtick%61 != 0 || runtime·sched.gwait == 0)
+			&& (gp = runqget(m)) != nil)
+				goto run;
+			schedlock();
+			runtime·sched.mcpu--;
+		} else {
+			schedlock();
+			runtime·sched.mcpu--;
+			if(stopg(gp))
+				gput(gp);
+		}
 		if(runtime·sched.mcpu < 0)
 			runtime·throw("runtime·sched.mcpu < 0 in scheduler");
-		switch(gp->status){
-		case Grunnable:
-		case Gdead:
-			// Shouldn't have been running!
-			runtime·throw("bad gp->status in sched");
-		case Grunning:
-			gp->status = Grunnable;
-			gput(gp);
-			break;
-		case Gmoribund:
-			gp->status = Gdead;
-			if(gp->lockedm) {
-				gp->lockedm = nil;
-				m->lockedg = nil;
-			}
-			gp->idlem = nil;
-			unwindstack(gp, nil);
-			gfput(gp);
-			if(--runtime·sched.gcount == 0)
-				runtime·exit(0);
-			break;
-		}
-		if(gp->readyonstop){
-			gp->readyonstop = 0;
-			readylocked(gp);
-		}
-	}
+	} else
+		schedlock();
 
 	// Find (or wait for) g to run.  Unlocks runtime·sched.
 	gp = nextgandunlock();
-	gp->readyonstop = 0;
+run:
+	gp->readyonstop = Gonm;
 	gp->status = Grunning;
 	m->curg = gp;
 	gp->m = m;
@@ -616,7 +899,10 @@ runtime·entersyscall(void)
 	schedlock();
 	g->status = Gsyscall;
 	runtime·sched.mcpu--;
-	runtime·sched.msyscall++;
+	if(!g->isbackground)
+		runtime·sched.msyscall++;
+	// Other ms run the local gs of m while it is in the kernel.
+	runqflush();
 	if(runtime·sched.gwait != 0)
 		matchmg();
 	if(runtime·sched.waitstop && runtime·sched.mcpu <= runtime·sched.mcpumax) {
@@ -637,7 +923,8 @@ runtime·exitsyscall(void)
 		return;
 
 	schedlock();
-	runtime·sched.msyscall--;
+	if(!g->isbackground)
+		runtime·sched.msyscall--;
 	runtime·sched.mcpu++;
 	// Fast path - if there's room for this m, we're done.
 	if(runtime·sched.mcpu <= runtime·sched.mcpumax) {
@@ -649,7 +936,7 @@ runtime·exitsyscall(void)
 	// mostly equivalent to g->status = Grunning,
 	// but keeps the garbage collector from thinking
 	// that g is running right now, which it's not.
-	g->readyonstop = 1;
+	g->readyonstop = Gready;
 	schedunlock();
 
 	// Slow path - all the cpus are taken.
@@ -664,7 +951,7 @@ runtime·oldstack(void)
 {
 	Stktop *top, old;
 	uint32 argsize;
-	byte *sp;
+	byte *sp, *stk;
 	G *g1;
 	static int32 goid;
 
@@ -681,8 +968,19 @@ runtime·oldstack(void)
 	}
 	goid = old.gobuf.g->goid;	// fault if g is bad, before gogo
 
-	if(old.free != 0)
-		runtime·stackfree(g1->stackguard - StackGuard - StackSystem, old.free);
+	if(old.free != 0) {
+		// Keep the segment for the next split, so that a call
+		// looping across a segment boundary does not allocate
+		// and free a segment on every iteration.
+		// Segments used inside malloc and gc come from
+		// the fixed-size stack allocator and are freed as usual.
+		stk = g1->stackguard - StackGuard - StackSystem;
+		if(g1->stackcache == nil && !m->mallocing && !m->gcing) {
+			g1->stackcache = stk;
+			g1->stackcachesize = old.free;
+		} else
+			runtime·stackfree(stk, old.free);
+	}
 	g1->stackbase = old.stackbase;
 	g1->stackguard = old.stackguard;
 
@@ -698,7 +996,7 @@ runtime·newstack(void)
 	G *g1;
 	Gobuf label;
 	bool reflectcall;
-	uintptr free;
+	uintptr free, size;
 
 	framesize = m->moreframesize;
 	argsize = m->moreargsize;
@@ -733,7 +1031,24 @@ runtime·newstack(void)
 		if(framesize < StackMin)
 			framesize = StackMin;
 		framesize += StackSystem;
-		stk = runtime·stackalloc(framesize);
+		stk = g1->stackguard - StackGuard - StackSystem;
+		if(stk != g1->stack0 && !m->mallocing && !m->gcing) {
+			// Past the first split, grow geometrically:
+			// at least double the current segment.
+			size = g1->stackbase + sizeof(Stktop) - stk;
+			if(size > StackGrowMax)
+				size = StackGrowMax;
+			if(framesize < 2*size)
+				framesize = 2*size;
+		}
+		if(g1->stackcache != nil && g1->stackcachesize >= framesize && !m->mallocing && !m->gcing) {
+			// Reuse the segment oldstack kept.
+			stk = g1->stackcache;
+			framesize = g1->stackcachesize;
+			g1->stackcache = nil;
+			g1->stackcachesize = 0;
+		} else
+			stk = runtime·stackalloc(framesize);
 		top = (Stktop*)(stk+framesize-sizeof(*top));
 		free = framesize;
 	}
@@ -776,6 +1091,23 @@ runtime·newstack(void)
 	*(int32*)345 = 123;	// never return
 }
 
+// Stackshrink frees the segments that oldstack kept for reuse,
+// so that a goroutine that once ran deep does not hold on to
+// the memory.  The garbage collector calls it with the world stopped.
+void
+runtime·stackshrink(void)
+{
+	G *gp;
+
+	for(gp=runtime·allg; gp!=nil; gp=gp->alllink) {
+		if(gp->stackcache != nil) {
+			runtime·stackfree(gp->stackcache, gp->stackcachesize);
+			gp->stackcache = nil;
+			gp->stackcachesize = 0;
+		}
+	}
+}
+
 static void
 mstackalloc(G *gp)
 {
@@ -844,8 +1176,6 @@ runtime·newproc1(byte *fn, byte *argp, int32 narg, int32 nret, void *callerpc)
 	if(siz > 1024)
 		runtime·throw("runtime.newproc: too many args");
 
-	schedlock();
-
 	if((newg = gfget()) != nil){
 		newg->status = Gwaiting;
 		if(newg->stackguard - StackGuard - StackSystem != newg->stack0)
@@ -853,8 +1183,9 @@ runtime·newproc1(byte *fn, byte *argp, int32 narg, int32 nret, void *callerpc)
 	} else {
 		newg = runtime·malg(StackMin);
 		newg->status = Gwaiting;
-		newg->alllink = runtime·allg;
-		runtime·allg = newg;
+		do
+			newg->alllink = runtime·allg;
+		while(!runtime·casp((void**)&runtime·allg, newg->alllink, newg));
 	}
 
 	sp = newg->stackbase;
@@ -872,12 +1203,10 @@ runtime·newproc1(byte *fn, byte *argp, int32 narg, int32 nret, void *callerpc)
 	newg->entry = fn;
 	newg->gopc = (uintptr)callerpc;
 
-	runtime·sched.gcount++;
-	runtime·goidgen++;
-	newg->goid = runtime·goidgen;
+	runtime·xadd((uint32*)&runtime·sched.gcount, 1);
+	newg->goid = runtime·xadd((uint32*)&runtime·goidgen, 1);
 
-	newprocreadylocked(newg);
-	schedunlock();
+	newprocready(newg);
 
 	return newg;
 //printf(" goid=%d\n", newg->goid);
@@ -1129,25 +1458,49 @@ nomatch:
 }
 
 
-// Put on gfree list.  Sched must be locked.
+// Put on the gfree list of m.  If it gets long,
+// move half of it to the global list.
 static void
 gfput(G *g)
 {
 	if(g->stackguard - StackGuard - StackSystem != g->stack0)
 		runtime·throw("invalid stack in gfput");
-	g->schedlink = runtime·sched.gfree;
-	runtime·sched.gfree = g;
+	g->schedlink = m->gfree;
+	m->gfree = g;
+	if(++m->gfreecnt < 64)
+		return;
+	runtime·lock(&gflock);
+	while(m->gfreecnt > 32) {
+		g = m->gfree;
+		m->gfree = g->schedlink;
+		m->gfreecnt--;
+		g->schedlink = runtime·sched.gfree;
+		runtime·sched.gfree = g;
+	}
+	runtime·unlock(&gflock);
 }
 
-// Get from gfree list.  Sched must be locked.
+// Get from the gfree list of m, refilled from the global list.
 static G*
 gfget(void)
 {
 	G *g;
 
-	g = runtime·sched.gfree;
-	if(g)
-		runtime·sched.gfree = g->schedlink;
+	if(m->gfree == nil && runtime·sched.gfree != nil) {
+		runtime·lock(&gflock);
+		while(m->gfreecnt < 32 && (g = runtime·sched.gfree) != nil) {
+			runtime·sched.gfree = g->schedlink;
+			g->schedlink = m->gfree;
+			m->gfree = g;
+			m->gfreecnt++;
+		}
+		runtime·unlock(&gflock);
+	}
+	g = m->gfree;
+	if(g) {
+		m->gfree = g->schedlink;
+		m->gfreecnt--;
+	}
 	return g;
 }
 
@@ -82,25 +82,28 @@ class MapTypePrinter:
 		return str(self.val.type)
 
 	def children(self):
-		stab = self.val['st']
-		i = 0
-		for v in self.traverse_hash(stab):
-			yield ("[%d]" %  i, v['key'])
-			yield ("[%d]" % (i + 1), v['val'])
-			i += 2
-
-	def traverse_hash(self, stab):
-		ptr = stab['entry'].address
-		end = stab['end']
-		while ptr < end:
-			v = ptr.dereference()
-			ptr = ptr + 1
-			if v['hash'] == 0: continue
-			if v['hash'] & 63 == 63:   # subtable
-				for v in self.traverse_hash(v['key'].cast(self.val['st'].type)):
-					yield v
-			else:
-				yield v
+		B = self.val['b']
+		buckets = self.val['buckets']
+		oldbuckets = self.val['oldbuckets']
+		inttype = self.val['nevacuate'].type
+		cnt = 0
+		for bucket in xrange(2 ** B):
+			bp = buckets + bucket
+			if oldbuckets:
+				oldbp = oldbuckets + (bucket & (2 ** (B - 1) - 1))
+				if oldbp['overflow'].cast(inttype) & 1 == 0:
+					# old bucket not evacuated yet: list its
+					# entries once, with the lower new bucket
+					if bucket >= 2 ** (B - 1): continue
+					bp = oldbp
+			while bp:
+				b = bp.dereference()
+				for i in xrange(8):
+					if b['tophash'][i] != 0:
+						yield ("[%d]" % cnt, b['keys'][i])
+						yield ("[%d]" % (cnt + 1), b['values'][i])
+						cnt += 2
+				bp = (b['overflow'].cast(inttype) & ~1).cast(b['overflow'].type)
 
 
 class ChanTypePrinter:
@@ -122,10 +125,12 @@ class ChanTypePrinter:
 		return str(self.val.type)
 
 	def children(self):
-		ptr = self.val['recvdataq']
-		for idx in range(self.val["qcount"]):
-			yield ('[%d]' % idx, ptr['elem'])
-			ptr = ptr['link']
+		buf = self.val['buf']
+		mask = self.val['mask']
+		recvx = self.val['recvx']
+		qcount = (self.val['sendx'] - recvx) & 0xffffffff
+		for idx in range(min(qcount, self.val['dataqsiz'])):
+			yield ('[%d]' % idx, buf[(recvx + idx) & mask])
 
 #
 #  Register all the *Printer classes above.
@@ -340,16 +340,16 @@ runtime·check(void)
  * dealing with unknown types
  */
 static uintptr
-memhash(uint32 s, void *a)
+memhash(uint32 s, void *a, uintptr seed)
 {
 	byte *b;
 	uintptr hash;
 
 	b = a;
 	if(sizeof(hash) == 4)
-		hash = 2860486313U;
+		hash = 2860486313U ^ seed;
 	else
-		hash = 33054211828000289ULL;
+		hash = 33054211828000289ULL ^ seed;
 	while(s > 0) {
 		if(sizeof(hash) == 4)
 			hash = (hash ^ *b) * 3267000013UL;
@@ -418,6 +418,7 @@ memcopy(uint32 s, void *a, void *b)
 	}
 	for(i=0; i<s; i++)
 		ba[i] = bb[i];
+	runtime·markdirty(ba, s);
 }
 
 static uint32
@@ -436,13 +437,14 @@ memwordcopy(uint32 s, void *a, void *b)
 		return;
 	}
 	*(uintptr*)(a) = *(uintptr*)(b);
+	runtime·markdirty(a, sizeof(uintptr));
 }
 
 static uintptr
-strhash(uint32 s, String *a)
+strhash(uint32 s, String *a, uintptr seed)
 {
 	USED(s);
-	return memhash((*a).len, (*a).str);
+	return memhash((*a).len, (*a).str, seed);
 }
 
 static uint32
@@ -465,10 +467,10 @@ strprint(uint32 s, String *a)
 }
 
 static uintptr
-interhash(uint32 s, Iface *a)
+interhash(uint32 s, Iface *a, uintptr seed)
 {
 	USED(s);
-	return runtime·ifacehash(*a);
+	return runtime·ifacehash(*a, seed);
 }
 
 static void
@@ -486,10 +488,10 @@ interequal(uint32 s, Iface *a, Iface *b)
 }
 
 static uintptr
-nilinterhash(uint32 s, Eface *a)
+nilinterhash(uint32 s, Eface *a, uintptr seed)
 {
 	USED(s);
-	return runtime·efacehash(*a);
+	return runtime·efacehash(*a, seed);
 }
 
 static void
@@ -507,10 +509,11 @@ nilinterequal(uint32 s, Eface *a, Eface *b)
 }
 
 uintptr
-runtime·nohash(uint32 s, void *a)
+runtime·nohash(uint32 s, void *a, uintptr seed)
 {
 	USED(s);
 	USED(a);
+	USED(seed);
 	runtime·panicstring("hash of unhashable type");
 	return 0;
 }
@@ -61,6 +61,7 @@ typedef	struct	Iface		Iface;
 typedef	struct	Itab		Itab;
 typedef	struct	Eface		Eface;
 typedef	struct	Type		Type;
+typedef	struct	MapType		MapType;
 typedef	struct	Defer		Defer;
 typedef	struct	Panic		Panic;
 typedef	struct	Hmap		Hmap;
@@ -191,7 +192,7 @@ struct	G
 	int32	goid;
 	uint32	selgen;		// valid sudog pointer
 	G*	schedlink;
-	bool	readyonstop;
+	uint32	readyonstop;	// cas'ed, see runtime·ready
 	bool	ispanic;
 	M*	m;		// for debuggers, but offset not hard-coded
 	M*	lockedm;
@@ -201,6 +202,9 @@ struct	G
 	uintptr	sigcode1;
 	uintptr	sigpc;
 	uintptr	gopc;	// pc of go statement that created this goroutine
+	byte*	stackcache;	// segment released by oldstack, for the next split
+	uintptr	stackcachesize;
+	bool	isbackground;	// runtime helper, not counted by the deadlock check
 };
 struct	M
 {
@@ -236,6 +240,13 @@ struct	M
 	uint32	freglo[16];	// D[i] lsb and F[i]
 	uint32	freghi[16];	// D[i] msb and F[i+16]
 	uint32	fflag;		// floating point compare flags
+	uint32	runqhead;	// local run queue, see proc.c
+	uint32	runqtail;
+	G*	runq[256];
+	G*	gfree;		// local cache of dead gs
+	int32	gfreecnt;
+	uint32	schedtick;
+	uint32	fastrand;
 #ifdef __WINDOWS__
 	void*	sehframe;
 #endif
@@ -254,7 +265,7 @@ struct	Stktop
 };
 struct	Alg
 {
-	uintptr	(*hash)(uint32, void*);
+	uintptr	(*hash)(uint32, void*, uintptr);	// size, key, seed
 	uint32	(*equal)(uint32, void*, void*);
 	void	(*print)(uint32, void*);
 	void	(*copy)(uint32, void*, void*);
@@ -362,6 +373,7 @@ int32	runtime·goidgen;
 extern	int32	runtime·gomaxprocs;
 extern	uint32	runtime·panicking;
 extern	int32	runtime·gcwaiting;		// gc is waiting to run
+extern	uint32	runtime·writebarrier;	// the gc is marking concurrently, see mgc0.c
 int8*	runtime·goos;
 extern	bool	runtime·iscgo;
 
@@ -397,7 +409,9 @@ byte*	runtime·mchr(byte*, byte, byte*);
 void	runtime·mcpy(byte*, byte*, uint32);
 int32	runtime·mcmp(byte*, byte*, uint32);
 void	runtime·memmove(void*, void*, uint32);
+void	runtime·markdirty(void*, uintptr);
 void*	runtime·mal(uintptr);
+void*	runtime·malclosure(uintptr, uintptr);
 String	runtime·catstring(String, String);
 String	runtime·gostring(byte*);
 String  runtime·gostringn(byte*, int32);
@@ -424,13 +438,14 @@ Func*	runtime·findfunc(uintptr);
 int32	runtime·funcline(Func*, uintptr);
 void*	runtime·stackalloc(uint32);
 void	runtime·stackfree(void*, uintptr);
+void	runtime·stackshrink(void);
 MCache*	runtime·allocmcache(void);
 void	runtime·mallocinit(void);
 bool	runtime·ifaceeq_c(Iface, Iface);
 bool	runtime·efaceeq_c(Eface, Eface);
-uintptr	runtime·ifacehash(Iface);
-uintptr	runtime·efacehash(Eface);
-uintptr	runtime·nohash(uint32, void*);
+uintptr	runtime·ifacehash(Iface, uintptr);
+uintptr	runtime·efacehash(Eface, uintptr);
+uintptr	runtime·nohash(uint32, void*, uintptr);
 uint32	runtime·noequal(uint32, void*, void*);
 void*	runtime·malloc(uintptr size);
 void	runtime·free(void *v);
@@ -454,6 +469,8 @@ bool	runtime·sigsend(int32 sig);
 void	runtime·gettime(int64*, int32*);
 int32	runtime·callers(int32, uintptr*, int32);
 int64	runtime·nanotime(void);
+uint32	runtime·fastrand1(void);
+void	runtime·usleep(uint32);
 void	runtime·dopanic(int32);
 void	runtime·startpanic(void);
 
@@ -512,6 +529,7 @@ void	runtime·notewakeup(Note*);
  */
 uint8*	runtime·mmap(byte*, uintptr, int32, int32, int32, uint32);
 void	runtime·munmap(uint8*, uintptr);
+void	runtime·madvise(uint8*, uintptr, int32);
 void	runtime·memclr(byte*, uintptr);
 void	runtime·setcallerpc(void*, void*);
 void*	runtime·getcallerpc(void*);
@@ -579,7 +597,7 @@ struct hash_iter*	runtime·newmapiterinit(Hmap*);
 void	runtime·mapiternext(struct hash_iter*);
 bool	runtime·mapiterkey(struct hash_iter*, void*);
 void	runtime·mapiterkeyvalue(struct hash_iter*, void*, void*);
-Hmap*	runtime·makemap_c(Type*, Type*, int64);
+Hmap*	runtime·makemap_c(MapType*, int64);
 
 Hchan*	runtime·makechan_c(Type*, int64);
 void	runtime·chansend(Hchan*, void*, bool*);
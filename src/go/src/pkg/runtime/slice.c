@@ -32,18 +32,11 @@ runtime·makeslice(SliceType *t, int64 len, int64 cap, Slice ret)
 
 static void
 makeslice1(SliceType *t, int32 len, int32 cap, Slice *ret)
-{	
-	uintptr size;
-
-	size = cap*t->elem->size;
-
+{
 	ret->len = len;
 	ret->cap = cap;
 
-	if((t->elem->kind&KindNoPointers))
-		ret->array = runtime·mallocgc(size, FlagNoPointers, 1, 1);
-	else
-		ret->array = runtime·mal(size);
+	ret->array = runtime·cnew(t->elem, cap);
 }
 
 static void appendslice1(SliceType*, Slice, Slice, Slice*);
@@ -97,6 +90,7 @@ appendslice1(SliceType *t, Slice x, Slice y, Slice *ret)
 		x = newx;
 	}
 	runtime·memmove(x.array+x.len*w, y.array, y.len*w);
+	runtime·markdirty(x.array+x.len*w, y.len*w);
 	x.len += y.len;
 	*ret = x;
 }
@@ -263,6 +257,7 @@ runtime·slicecopy(Slice to, Slice fm, uintptr width, int32 ret)
 		*to.array = *fm.array;	// known to be a byte pointer
 	} else {
 		runtime·memmove(to.array, fm.array, ret*width);
+		runtime·markdirty(to.array, ret*width);
 	}
 
 out:
@@ -62,6 +62,11 @@ enum {
 	// is less than this number, the stack will have this size instead.
 	StackMin = 4096,
 
+	// Past the first split, each new segment is at least twice
+	// the size of the one it extends, up to this size, so that a
+	// deep recursion splits O(log n) times instead of O(n).
+	StackGrowMax = 256*1024,
+
 	// Functions that need frames bigger than this call morestack
 	// unconditionally.  That is, on entry to a function it is assumed
 	// that the amount of space available in the current stack segment
@@ -16,7 +16,6 @@ typedef struct UncommonType UncommonType;
 typedef struct InterfaceType InterfaceType;
 typedef struct Method Method;
 typedef struct IMethod IMethod;
-typedef struct MapType MapType;
 typedef struct ChanType ChanType;
 typedef struct SliceType SliceType;
 typedef struct FuncType FuncType;
@@ -32,6 +31,7 @@ struct CommonType
 	String *string;
 	UncommonType *x;
 	Type *ptrto;
+	uintptr *gc;
 };
 
 enum {
@@ -109,6 +109,7 @@ struct MapType
 	Type;
 	Type *key;
 	Type *elem;
+	uintptr *bucket;	// pointer bitmap of a Bucket, see hashmap.c
 };
 
 struct ChanType
@@ -20,6 +20,7 @@
 #pragma dynimport runtime·QueryPerformanceFrequency QueryPerformanceFrequency "kernel32.dll"
 #pragma dynimport runtime·SetConsoleCtrlHandler SetConsoleCtrlHandler "kernel32.dll"
 #pragma dynimport runtime·SetEvent SetEvent "kernel32.dll"
+#pragma dynimport runtime·Sleep Sleep "kernel32.dll"
 #pragma dynimport runtime·WaitForSingleObject WaitForSingleObject "kernel32.dll"
 #pragma dynimport runtime·WriteFile WriteFile "kernel32.dll"
 
@@ -36,6 +37,7 @@ extern void *runtime·QueryPerformanceCounter;
 extern void *runtime·QueryPerformanceFrequency;
 extern void *runtime·SetConsoleCtrlHandler;
 extern void *runtime·SetEvent;
+extern void *runtime·Sleep;
 extern void *runtime·WaitForSingleObject;
 extern void *runtime·WriteFile;
 
@@ -214,6 +216,15 @@ runtime·gettime(int64 *sec, int32 *usec)
 	*usec = count*1000000 / timerfreq;
 }
 
+void
+runtime·usleep(uint32 usec)
+{
+	usec /= 1000;
+	if(usec == 0)
+		usec = 1;
+	runtime·stdcall(runtime·Sleep, 1, (uintptr)usec);
+}
+
 // Calling stdcall on os stack.
 #pragma textflag 7
 void *
@@ -32,11 +32,10 @@ type Locker interface {
 // If the lock is already in use, the calling goroutine
 // blocks until the mutex is available.
 func (m *Mutex) Lock() {
-	if atomic.AddInt32(&m.key, 1) == 1 {
-		// changed from 0 to 1; we hold lock
-		return
+	if atomic.AddInt32(&m.key, 1) != 1 {
+		// did not change from 0 to 1; wait for the lock
+		runtime.Semacquire(&m.sema)
 	}
-	runtime.Semacquire(&m.sema)
 }
 
 // Unlock unlocks m.
@@ -46,11 +45,16 @@ func (m *Mutex) Lock() {
 // It is allowed for one goroutine to lock a Mutex and then
 // arrange for another goroutine to unlock it.
 func (m *Mutex) Unlock() {
-	switch v := atomic.AddInt32(&m.key, -1); {
-	case v == 0:
-		// changed from 1 to 0; no contention
-		return
-	case v == -1:
+	if v := atomic.AddInt32(&m.key, -1); v != 0 {
+		// did not change from 1 to 0: waiters, or not locked
+		m.unlockSlow(v)
+	}
+}
+
+// unlockSlow is split out so that Lock and Unlock stay small
+// enough to be inlined; see cmd/gc/inl.c.
+func (m *Mutex) unlockSlow(v int32) {
+	if v == -1 {
 		// changed from 0 to -1: wasn't locked
 		// (or there are 4 billion goroutines waiting)
 		panic("sync: unlock of unlocked mutex")
@@ -0,0 +1,83 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// gc-retain keeps n records of random words alive, in a list, a map
+// and a channel, while it builds and drops lists of garbage, and
+// reports on standard error how much heap the collector retains
+// beyond the live data.  A collector that takes the random words
+// for pointers keeps some of the garbage lists.
+
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+	"rand"
+	"runtime"
+)
+
+var n = flag.Int("n", 100000, "live records")
+
+type Record struct {
+	next *Record
+	vals [6]uint32
+}
+
+func list(n int, r *rand.Rand) *Record {
+	var l *Record
+	for i := 0; i < n; i++ {
+		p := &Record{next: l}
+		for j := range p.vals {
+			p.vals[j] = r.Uint32()
+		}
+		l = p
+	}
+	return l
+}
+
+func sum(l *Record) (s uint32) {
+	for ; l != nil; l = l.next {
+		for _, v := range l.vals {
+			s += v
+		}
+	}
+	return
+}
+
+func main() {
+	flag.Parse()
+	r := rand.New(rand.NewSource(1))
+
+	live := list(*n, r)
+	m := make(map[uint32]uint32)
+	for i := 0; i < *n; i++ {
+		m[r.Uint32()] = r.Uint32()
+	}
+	c := make(chan uint32, *n)
+	for i := 0; i < *n; i++ {
+		c <- r.Uint32()
+	}
+
+	var check uint32
+	for i := 0; i < 100; i++ {
+		check += sum(list(*n/10, r))
+	}
+	fmt.Printf("garbage check: %d\n", check)
+
+	runtime.GC()
+	runtime.GC()
+	st := &runtime.MemStats
+	fmt.Fprintf(os.Stderr, "heap %d KB after %d collections, %d objects\n",
+		st.HeapAlloc>>10, st.NumGC, st.HeapObjects)
+
+	check = sum(live)
+	for k, v := range m {
+		check += k + v
+	}
+	for i := 0; i < *n; i++ {
+		check += <-c
+	}
+	fmt.Printf("live check: %d\n", check)
+}
@@ -0,0 +1,47 @@
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Hot-split: a loop that calls a function with a large frame from
+// every stack depth in a range.  Wherever the loop runs near the
+// end of a stack segment, each call needs a new segment, and the
+// runtime used to allocate and free one on every iteration.
+
+package main
+
+import (
+	"flag"
+	"fmt"
+)
+
+var n = flag.Int("n", 1000, "calls per depth")
+
+// leaf has a frame of about 3kB, most of a minimum stack segment.
+func leaf(x int) int {
+	var buf [768]int32
+	for i := 0; i < len(buf); i += 64 {
+		buf[i] = int32(x + i)
+	}
+	return int(buf[(x*64)%len(buf)])
+}
+
+// descend recurses d levels and then calls leaf n times.
+func descend(d, n int) int {
+	if d > 0 {
+		return descend(d-1, n) + 1
+	}
+	s := 0
+	for i := 0; i < n; i++ {
+		s += leaf(i)
+	}
+	return s
+}
+
+func main() {
+	flag.Parse()
+	sum := 0
+	for d := 0; d < 256; d++ {
+		sum += descend(d, *n)
+	}
+	fmt.Printf("%d\n", sum)
+}
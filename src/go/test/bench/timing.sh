@@ -106,6 +106,7 @@ binarytree() {
 	run 'gccgo -O2 binary-tree-freelist.go' $O.out -n 15
 	run 'gc binary-tree' $O.out -n 15
 	run 'gc binary-tree-freelist' $O.out -n 15
+	run 'gc binary-tree-gcpause' $O.out -n 15
 }
 
 fannkuch() {
@@ -190,9 +191,19 @@ chameneos() {
 	run 'gc chameneosredux' $O.out 6000000
 }
 
+hotsplit() {
+	runonly echo 'hot-split 20000'
+	run 'gc hot-split' $O.out -n 20000
+}
+
+gcretain() {
+	runonly echo 'gc-retain -n 100000'
+	run 'gc gc-retain' $O.out -n 100000
+}
+
 case $# in
 0)
-	run="fasta revcomp nbody binarytree fannkuch regexdna spectralnorm knucleotide mandelbrot meteor pidigits threadring chameneos"
+	run="fasta revcomp nbody binarytree fannkuch regexdna spectralnorm knucleotide mandelbrot meteor pidigits threadring chameneos hotsplit gcretain"
 	;;
 *)
 	run=$*
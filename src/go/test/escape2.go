@@ -0,0 +1,92 @@
+// errchk -0 $G -m -l $D/$F.go
+
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Check the decisions of the escape analysis, see gc -m.
+
+package foo
+
+var gxx *int
+
+func foo1(x int) { // ERROR "moved to heap: x"
+	gxx = &x
+}
+
+func foo2(yy *int) { // ERROR "leaking param: yy"
+	gxx = yy
+}
+
+func foo3(x int) *int { // ERROR "moved to heap: x"
+	return &x
+}
+
+func foo4(xx, yy *int) {
+	xx = yy
+}
+
+func foo5(xx **int, yy *int) {
+	xx = &yy
+}
+
+func foo6(xx **int, yy *int) { // ERROR "leaking param: yy"
+	*xx = yy
+}
+
+type T struct{ a, b int }
+
+func foo7() int {
+	p := new(T) // ERROR "new.T. does not escape"
+	p.a = 1
+	return p.a
+}
+
+func foo8() *T {
+	return new(T)
+}
+
+func foo9() int {
+	p := &T{1, 2} // ERROR "&T literal does not escape"
+	return p.a + p.b
+}
+
+func foo10(x int) int {
+	p := &x
+	return *p
+}
+
+func foo11() int {
+	x, y := 0, 42
+	xx := &x
+	yy := &y
+	*xx = *yy
+	return x
+}
+
+func foo12(xx *int) int {
+	return *xx
+}
+
+func foo13() int {
+	x := 7
+	return foo12(&x)
+}
+
+func foo14() int {
+	x := 7 // ERROR "moved to heap: x"
+	foo2(&x)
+	return x
+}
+
+func foo15() {
+	for i := 0; i < 10; i++ {
+		x := i // ERROR "moved to heap: x"
+		defer func() { println(x) }()
+	}
+}
+
+func foo16() func() int {
+	x := 1 // ERROR "moved to heap: x"
+	return func() int { x++; return x }
+}
@@ -0,0 +1,74 @@
+// $G $D/$F.go && $L $F.$A && GOGC=5 GOGCVERIFY=1 ./$A.out
+
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Test that the pointers stored into the heap while the
+// collector marks concurrently are not lost: GOGCVERIFY
+// checks each mark against one with the world stopped.
+
+package main
+
+import (
+	"fmt"
+	"reflect"
+	"runtime"
+)
+
+type T struct {
+	n    int
+	next *T
+	s    []*T
+	m    map[int]*T
+	i    interface{}
+}
+
+var n int
+
+func two() (*T, *T) {
+	n++
+	return &T{n: n}, &T{n: -n}
+}
+
+func check(t *T, n int) {
+	if t == nil || t.n != n {
+		panic(fmt.Sprint("lost ", n))
+	}
+}
+
+func main() {
+	keep := &T{m: make(map[int]*T)}
+	ch := make(chan *T, 10)
+	var list *T
+	for i := 0; i < 100000; i++ {
+		keep.m[i%1000] = &T{n: i}
+		keep.s = append(keep.s, &T{n: i})
+		if len(keep.s) > 1000 {
+			keep.s = keep.s[500:]
+		}
+		keep.i = &T{n: i}
+		keep.next, list = two()
+		check(keep.next, n)
+		check(list, -n)
+		select {
+		case ch <- &T{n: i}:
+		default:
+			t := <-ch
+			check(t, t.n)
+		}
+		v := reflect.NewValue(keep).(*reflect.PtrValue).Elem().(*reflect.StructValue).Field(1).(*reflect.PtrValue)
+		v.PointTo(reflect.NewValue(&T{n: -i}).(*reflect.PtrValue).Elem())
+		check(keep.next, -i)
+	}
+	for k, t := range keep.m {
+		check(t, 99000+k)
+	}
+	for _, t := range keep.s {
+		check(t, t.n)
+	}
+	check(keep.i.(*T), 99999)
+	if runtime.MemStats.NumGC == 0 {
+		panic("no collections")
+	}
+}
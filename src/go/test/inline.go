@@ -0,0 +1,73 @@
+// errchk -0 $G -m $D/$F.go
+
+// Copyright 2011 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Test, using compiler diagnostic flags, that inlining is working.
+
+package foo
+
+import "runtime"
+
+type T struct {
+	a, b int
+}
+
+func add2(x int) int { // ERROR "can inline add2"
+	return x + 2
+}
+
+func (t T) sum() int { // ERROR "can inline T.*sum"
+	return t.a + t.b
+}
+
+func clamp(x int) (r int) { // ERROR "can inline clamp"
+	r = x
+	if r > 10 {
+		r = 10
+	}
+	return
+}
+
+func loop(n int) int {
+	s := 0
+	for i := 0; i < n; i++ {
+		s += i
+	}
+	return s
+}
+
+func calls(x int) int { // ERROR "can inline calls"
+	return add2(x) * loop(x) // ERROR "inlining call to add2"
+}
+
+func local(x int) *int { // ERROR "moved to heap: x"
+	return &x
+}
+
+func field(t *T) *int { // ERROR "can inline field"
+	return &t.a
+}
+
+//go:noinline
+func never(x int) int {
+	return x
+}
+
+// the frames runtime.Callers skips would be gone if inlined
+func depth(pc []uintptr) int { // ERROR "leaking param: pc"
+	return runtime.Callers(2, pc)
+}
+
+func depth1(pc []uintptr) int { // ERROR "leaking param: pc"
+	return depth(pc) + 1
+}
+
+func f(t T, x int) int {
+	y := add2(x) + t.sum() // ERROR "inlining call to add2" "inlining call to t.sum"
+	y = clamp(y)           // ERROR "inlining call to clamp"
+	y += loop(x) + never(y)
+	y += *local(x) + *field(&t) // ERROR "inlining call to field"
+	return add2(calls(y))       // ERROR "inlining call to add2" "inlining call to calls"
+}
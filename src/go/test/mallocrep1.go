@@ -101,6 +101,7 @@ func main() {
 	runtime.MemProfileRate = 0 // disable profiler
 	flag.Parse()
 	b = make([]*byte, 10000)
+	runtime.GC() // clean up garbage from init, which the sweep would free during the counts
 	if flag.NArg() > 0 {
 		AllocAndFree(atoi(flag.Arg(0)), atoi(flag.Arg(1)))
 		return
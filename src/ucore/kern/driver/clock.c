@@ -2,6 +2,7 @@
 #include <trap.h>
 #include <stdio.h>
 #include <picirq.h>
+#include <clock.h>
 
 /* *
  * Support for time-related hardware gadgets - the 8253 timer,
@@ -26,15 +27,15 @@
 volatile size_t ticks;
 
 /* *
- * clock_init - initialize 8253 clock to interrupt 100 times per second,
+ * clock_init - initialize 8253 clock to interrupt CLOCK_HZ times per second,
  * and then enable IRQ_TIMER.
  * */
 void
 clock_init(void) {
     // set 8253 timer-chip
     outb(TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT);
-    outb(IO_TIMER1, TIMER_DIV(100) % 256);
-    outb(IO_TIMER1, TIMER_DIV(100) / 256);
+    outb(IO_TIMER1, TIMER_DIV(CLOCK_HZ) % 256);
+    outb(IO_TIMER1, TIMER_DIV(CLOCK_HZ) / 256);
 
     // initialize time counter 'ticks' to zero
     ticks = 0;
@@ -3,6 +3,9 @@
 
 #include <types.h>
 
+#define CLOCK_HZ                100                     // clock ticks per second
+#define USEC_PER_TICK           (1000000 / CLOCK_HZ)
+
 extern volatile size_t ticks;
 
 void clock_init(void);
@@ -1,13 +1,33 @@
 #include <types.h>
 #include <stdio.h>
+#include <list.h>
 #include <trap.h>
 #include <picirq.h>
 #include <fs.h>
 #include <ide.h>
+#include <pci.h>
 #include <x86.h>
-#include <sem.h>
+#include <pmm.h>
+#include <wait.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
 #include <assert.h>
 
+/* *
+ * The ide requests are queued on their channel and served one batch at a
+ * time, the callers sleep until the interrupt of the channel completes their
+ * requests. A batch is picked by the C-LOOK elevator: the first request at or
+ * after the position where the last batch ended, or the lowest one if there
+ * is none, and the following requests which are adjacent on disk and in the
+ * same direction are merged into it. The batch is transferred by the PCI bus
+ * master dma if the controller and the buffers allow, otherwise by PIO, one
+ * sector per interrupt.
+ *
+ * The callers which can't sleep (before the interrupts are enabled at boot,
+ * or with the interrupts disabled) poll the channel instead.
+ * */
+
 #define ISA_DATA                0x00
 #define ISA_ERROR               0x01
 #define ISA_PRECOMP             0x01
@@ -28,6 +48,8 @@
 
 #define IDE_CMD_READ            0x20
 #define IDE_CMD_WRITE           0x30
+#define IDE_CMD_READ_DMA        0xC8
+#define IDE_CMD_WRITE_DMA       0xCA
 #define IDE_CMD_IDENTIFY        0xEC
 
 #define IDE_IDENT_SECTORS       20
@@ -37,40 +59,94 @@
 #define IDE_IDENT_MAX_LBA       120
 #define IDE_IDENT_MAX_LBA_EXT   200
 
+#define IDE_CAP_DMA             0x100
+#define IDE_CAP_LBA             0x200
+
 #define IO_BASE0                0x1F0
 #define IO_BASE1                0x170
 #define IO_CTRL0                0x3F4
 #define IO_CTRL1                0x374
 
+// bus master registers, offsets from the bus master base of a channel
+#define BM_CMD                  0x00
+#define BM_STATUS               0x02
+#define BM_PRDT                 0x04
+
+#define BM_CMD_START            0x01
+#define BM_CMD_READ             0x08    // the bus master writes to memory
+#define BM_STATUS_ACTIVE        0x01
+#define BM_STATUS_ERR           0x02
+#define BM_STATUS_IRQ           0x04
+
+#define BM_CHANNEL_SIZE         8
+#define PCI_INTERFACE_IDE_BM    0x80    // the ide controller is a bus master
+
 #define MAX_IDE                 4
-#define MAX_NSECS               128
+#define MAX_NSECS               256     // sector count 0 means 256
+#define MAX_NPRD                64
 #define MAX_DISK_NSECS          0x10000000U
 #define VALID_IDE(ideno)        (((ideno) >= 0) && ((ideno) < MAX_IDE) && (ide_devices[ideno].valid))
 
-static struct {
+// physical region descriptor, a piece of memory of the dma transfer
+struct ide_prd {
+    uint32_t addr;              // physical address
+    uint16_t len;               // byte count, 0 means 64KB
+    uint16_t flags;             // PRD_EOT on the last entry
+} __attribute__((packed));
+
+#define PRD_EOT                 0x8000
+#define PRD_BOUNDARY            0x10000 // a prd can't cross 64KB boundary
+
+/* *
+ * A request is nbufs buffers of nsecs sectors each, to the consecutive
+ * sectors from secno. Its total size fits in one batch, see ide_submit.
+ * */
+struct ide_request {
+    unsigned short ideno;
+    uint32_t secno;
+    size_t nsecs;               // sectors of each buffer
+    void **bufs;
+    int nbufs;
+    bool write;
+    bool dma;                   // buf can be reached by the bus master
+    bool done;
+    int ret;
+    wait_t wait;                // the caller sleeping on the channel
+    list_entry_t link;          // entry in the queue or the active batch
+};
+
+#define le2req(le, member)                          \
+    to_struct((le), struct ide_request, member)
+
+#define req_nsecs(req)          ((req)->nsecs * (req)->nbufs)
+
+// sort key of the requests, also the position of the elevator
+#define req_key(ideno, secno)   (((uint64_t)(ideno) << 32) | (secno))
+
+static struct ide_channel {
     const unsigned short base;  // I/O Base
     const unsigned short ctrl;  // Control Base
-    semaphore_t sem;
+    unsigned short bmbase;      // Bus Master Base, 0 if no dma
+    struct ide_prd *prdt;       // prd table of the dma transfer
+    list_entry_t queue;         // pending requests, sorted by req_key
+    list_entry_t active;        // the batch on the disk
+    bool dma;                   // the batch uses dma
+    uint64_t head;              // req_key at the end of the last batch
+    struct ide_request *pio_req;// the request of the next pio sector
+    size_t pio_done;            // sectors of pio_req transferred
+    size_t pio_left;            // sectors of the batch not transferred
+    wait_queue_t wait_queue;
 } channels[2] = {
     {IO_BASE0, IO_CTRL0},
     {IO_BASE1, IO_CTRL1},
 };
 
-static void
-lock_channel(unsigned short ideno) {
-    down(&(channels[ideno >> 1].sem));
-}
-
-static void
-unlock_channel(unsigned short ideno) {
-    up(&(channels[ideno >> 1].sem));
-}
-
 #define IO_BASE(ideno)          (channels[(ideno) >> 1].base)
 #define IO_CTRL(ideno)          (channels[(ideno) >> 1].ctrl)
 
 static struct ide_device {
     unsigned char valid;        // 0 or 1 (If Device Really Exists)
+    unsigned char dma;          // 0 or 1 (If Device Supports DMA)
     unsigned int sets;          // Commend Sets Supported
     unsigned int size;          // Size in Sectors
     unsigned char model[41];    // Model in String
@@ -87,9 +163,40 @@ ide_wait_ready(unsigned short iobase, bool check_error) {
     return 0;
 }
 
+// ide_dma_init - find the bus master of the PCI ide controller
+static void
+ide_dma_init(void) {
+    struct pci_func f;
+    if (!pci_find_class(PCI_CLASS_MASS_STORAGE, PCI_SUBCLASS_MASS_STORAGE_IDE, &f)) {
+        return;
+    }
+    if (!(PCI_INTERFACE(f.dev_class) & PCI_INTERFACE_IDE_BM)) {
+        return;
+    }
+    uint32_t bar = pci_conf_read(&f, PCI_BAR_REG(4));
+    if (!(bar & PCI_BAR_IO) || PCI_BAR_IO_ADDR(bar) == 0) {
+        return;
+    }
+    pci_conf_write(&f, PCI_COMMAND_STATUS_REG, pci_conf_read(&f, PCI_COMMAND_STATUS_REG)
+            | PCI_COMMAND_IO_ENABLE | PCI_COMMAND_MASTER_ENABLE);
+
+    int i;
+    for (i = 0; i < 2; i ++) {
+        struct Page *page;
+        if ((page = alloc_page()) == NULL) {
+            panic("ide: no memory for prd table.\n");
+        }
+        channels[i].prdt = page2kva(page);
+        channels[i].bmbase = PCI_BAR_IO_ADDR(bar) + i * BM_CHANNEL_SIZE;
+    }
+    cprintf("ide: bus master dma at 0x%04x (pci %04x:%04x).\n", PCI_BAR_IO_ADDR(bar),
+            f.dev_id & 0xFFFF, f.dev_id >> 16);
+}
+
 void
 ide_init(void) {
     static_assert((SECTSIZE % 4) == 0);
+    static_assert(MAX_NPRD * sizeof(struct ide_prd) <= PGSIZE);
     unsigned short ideno, iobase;
     for (ideno = 0; ideno < MAX_IDE; ideno ++) {
         /* assume that no device here */
@@ -134,7 +241,9 @@ ide_init(void) {
         ide_devices[ideno].size = sectors;
 
         /* check if supports LBA */
-        assert((*(unsigned short *)(ident + IDE_IDENT_CAPABILITIES) & 0x200) != 0);
+        unsigned short caps = *(unsigned short *)(ident + IDE_IDENT_CAPABILITIES);
+        assert((caps & IDE_CAP_LBA) != 0);
+        ide_devices[ideno].dma = ((caps & IDE_CAP_DMA) != 0);
 
         unsigned char *model = ide_devices[ideno].model, *data = ident + IDE_IDENT_MODEL;
         unsigned int i, length = 40;
@@ -148,12 +257,17 @@ ide_init(void) {
         cprintf("ide %d: %10u(sectors), '%s'.\n", ideno, ide_devices[ideno].size, ide_devices[ideno].model);
     }
 
+    int i;
+    for (i = 0; i < 2; i ++) {
+        list_init(&(channels[i].queue));
+        list_init(&(channels[i].active));
+        wait_queue_init(&(channels[i].wait_queue));
+    }
+    ide_dma_init();
+
     // enable ide interrupt
     pic_enable(IRQ_IDE1);
     pic_enable(IRQ_IDE2);
-
-    sem_init(&(channels[0].sem), 1);
-    sem_init(&(channels[1].sem), 1);
 }
 
 bool
@@ -169,67 +283,353 @@ ide_device_size(unsigned short ideno) {
     return 0;
 }
 
-int
-ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs) {
-    assert(nsecs <= MAX_NSECS && VALID_IDE(ideno));
-    assert(secno < MAX_DISK_NSECS && secno + nsecs <= MAX_DISK_NSECS);
-    unsigned short iobase = IO_BASE(ideno), ioctrl = IO_CTRL(ideno);
+// ide_dma_ok - check if the buffer is in the physical memory mapped at KERNBASE
+static bool
+ide_dma_ok(void *buf, size_t nsecs) {
+    uintptr_t start = (uintptr_t)buf, end = start + nsecs * SECTSIZE;
+    return (start & 1) == 0 && KERNBASE <= start && start < end && end <= KERNBASE + npage * PGSIZE;
+}
 
-    lock_channel(ideno);
+// ide_nprd - number of prds of a buffer of nsecs sectors
+static int
+ide_nprd(void *buf, size_t nsecs) {
+    uintptr_t pa = PADDR(buf), end = pa + nsecs * SECTSIZE;
+    return (ROUNDDOWN(end - 1, PRD_BOUNDARY) - ROUNDDOWN(pa, PRD_BOUNDARY)) / PRD_BOUNDARY + 1;
+}
 
-    ide_wait_ready(iobase, 0);
+// ide_req_nprd - number of prds of a request
+static int
+ide_req_nprd(struct ide_request *req) {
+    int i, nprd = 0;
+    for (i = 0; i < req->nbufs; i ++) {
+        nprd += ide_nprd(req->bufs[i], req->nsecs);
+    }
+    return nprd;
+}
 
-    // generate interrupt
-    outb(ioctrl + ISA_CTRL, 0);
-    outb(iobase + ISA_SECCNT, nsecs);
-    outb(iobase + ISA_SECTOR, secno & 0xFF);
-    outb(iobase + ISA_CYL_LO, (secno >> 8) & 0xFF);
-    outb(iobase + ISA_CYL_HI, (secno >> 16) & 0xFF);
-    outb(iobase + ISA_SDH, 0xE0 | ((ideno & 1) << 4) | ((secno >> 24) & 0xF));
-    outb(iobase + ISA_COMMAND, IDE_CMD_READ);
+static void
+ide_fill_prdt(struct ide_channel *ch) {
+    struct ide_prd *prd = ch->prdt;
+    list_entry_t *list = &(ch->active), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct ide_request *req = le2req(le, link);
+        int i;
+        for (i = 0; i < req->nbufs; i ++) {
+            uintptr_t pa = PADDR(req->bufs[i]), end = pa + req->nsecs * SECTSIZE;
+            while (pa < end) {
+                uintptr_t next = ROUNDDOWN(pa, PRD_BOUNDARY) + PRD_BOUNDARY;
+                if (next > end) {
+                    next = end;
+                }
+                prd->addr = pa, prd->len = (next - pa) & 0xFFFF, prd->flags = 0;
+                prd ++, pa = next;
+            }
+        }
+    }
+    assert(prd > ch->prdt && prd - ch->prdt <= MAX_NPRD);
+    prd[-1].flags = PRD_EOT;
+}
 
-    int ret = 0;
-    for (; nsecs > 0; nsecs --, dst += SECTSIZE) {
-        if ((ret = ide_wait_ready(iobase, 1)) != 0) {
-            goto out;
+// ide_complete - finish the active batch of ch with ret, and wake up the callers
+static void
+ide_complete(struct ide_channel *ch, int ret) {
+    list_entry_t *list = &(ch->active), *le;
+    while ((le = list_next(list)) != list) {
+        list_del_init(le);
+        struct ide_request *req = le2req(le, link);
+        req->ret = ret, req->done = 1;
+        if (wait_in_queue(&(req->wait))) {
+            wakeup_wait(&(ch->wait_queue), &(req->wait), WT_IDE, 1);
         }
-        insl(iobase, dst, SECTSIZE / sizeof(uint32_t));
     }
+}
 
-out:
-    unlock_channel(ideno);
-    return ret;
+// ide_pio_buf - the buffer of the next pio sector of the active batch
+static void *
+ide_pio_buf(struct ide_channel *ch) {
+    struct ide_request *req;
+    while (ch->pio_done == req_nsecs(ch->pio_req)) {
+        ch->pio_req = le2req(list_next(&(ch->pio_req->link)), link);
+        ch->pio_done = 0;
+    }
+    assert(ch->pio_left != 0);
+    ch->pio_left --, req = ch->pio_req;
+    size_t done = ch->pio_done ++;
+    return req->bufs[done / req->nsecs] + (done % req->nsecs) * SECTSIZE;
 }
 
-int
-ide_write_secs(unsigned short ideno, uint32_t secno, const void *src, size_t nsecs) {
-    assert(nsecs <= MAX_NSECS && VALID_IDE(ideno));
-    assert(secno < MAX_DISK_NSECS && secno + nsecs <= MAX_DISK_NSECS);
-    unsigned short iobase = IO_BASE(ideno), ioctrl = IO_CTRL(ideno);
+// ide_start - pick the next batch by C-LOOK and send it to the disk if ch is idle
+static void
+ide_start(struct ide_channel *ch) {
+again:
+    if (!list_empty(&(ch->active)) || list_empty(&(ch->queue))) {
+        return;
+    }
 
-    lock_channel(ideno);
+    list_entry_t *list = &(ch->queue), *le = list;
+    struct ide_request *req = NULL, *prev, *next;
+    while ((le = list_next(le)) != list) {
+        if (req_key(le2req(le, link)->ideno, le2req(le, link)->secno) >= ch->head) {
+            req = le2req(le, link);
+            break;
+        }
+    }
+    if (req == NULL) {
+        req = le2req(list_next(list), link);
+    }
+
+    // merge the adjacent requests in the same direction
+    bool dma = req->dma;
+    size_t nsecs = 0;
+    int nprd = 0;
+    for (next = req; ; ) {
+        prev = next, le = list_next(&(prev->link));
+        list_del(&(prev->link));
+        list_add_before(&(ch->active), &(prev->link));
+        nsecs += req_nsecs(prev);
+        if (dma) {
+            nprd += ide_req_nprd(prev);
+        }
+        if (le == list) {
+            break;
+        }
+        next = le2req(le, link);
+        if (next->ideno != req->ideno || next->write != req->write || next->dma != dma
+                || next->secno != prev->secno + req_nsecs(prev) || nsecs + req_nsecs(next) > MAX_NSECS) {
+            break;
+        }
+        if (dma && nprd + ide_req_nprd(next) > MAX_NPRD) {
+            break;
+        }
+    }
+
+    unsigned short ideno = req->ideno, iobase = ch->base;
+    uint32_t secno = req->secno;
+    ch->head = req_key(ideno, secno + nsecs);
+    ch->dma = dma;
 
     ide_wait_ready(iobase, 0);
 
+    if (dma) {
+        ide_fill_prdt(ch);
+        outl(ch->bmbase + BM_PRDT, PADDR(ch->prdt));
+        outb(ch->bmbase + BM_CMD, req->write ? 0 : BM_CMD_READ);
+        outb(ch->bmbase + BM_STATUS, inb(ch->bmbase + BM_STATUS) | BM_STATUS_ERR | BM_STATUS_IRQ);
+    }
+
     // generate interrupt
-    outb(ioctrl + ISA_CTRL, 0);
-    outb(iobase + ISA_SECCNT, nsecs);
+    outb(ch->ctrl + ISA_CTRL, 0);
+    outb(iobase + ISA_SECCNT, nsecs & 0xFF);
     outb(iobase + ISA_SECTOR, secno & 0xFF);
     outb(iobase + ISA_CYL_LO, (secno >> 8) & 0xFF);
     outb(iobase + ISA_CYL_HI, (secno >> 16) & 0xFF);
     outb(iobase + ISA_SDH, 0xE0 | ((ideno & 1) << 4) | ((secno >> 24) & 0xF));
+
+    if (dma) {
+        outb(iobase + ISA_COMMAND, req->write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA);
+        outb(ch->bmbase + BM_CMD, inb(ch->bmbase + BM_CMD) | BM_CMD_START);
+        return;
+    }
+
+    ch->pio_req = req, ch->pio_done = 0, ch->pio_left = nsecs;
+    if (!req->write) {
+        outb(iobase + ISA_COMMAND, IDE_CMD_READ);
+        return;
+    }
     outb(iobase + ISA_COMMAND, IDE_CMD_WRITE);
+    // the first sector is sent without interrupt
+    if (ide_wait_ready(iobase, 1) != 0) {
+        ide_complete(ch, -1);
+        goto again;
+    }
+    outsl(iobase + ISA_DATA, ide_pio_buf(ch), SECTSIZE / sizeof(uint32_t));
+}
 
-    int ret = 0;
-    for (; nsecs > 0; nsecs --, src += SECTSIZE) {
-        if ((ret = ide_wait_ready(iobase, 1)) != 0) {
-            goto out;
+/* *
+ * ide_service - make progress on the active batch of ch if the disk is ready,
+ * then start the next batch. called with interrupts disabled, from ide_intr or
+ * the polling callers, so it ignores the interrupts not for the active batch.
+ * */
+static void
+ide_service(struct ide_channel *ch) {
+    unsigned short iobase = ch->base;
+    int r;
+
+    if (list_empty(&(ch->active))) {
+        inb(iobase + ISA_STATUS);
+        return;
+    }
+
+    if (ch->dma) {
+        uint8_t bmstatus = inb(ch->bmbase + BM_STATUS);
+        if (!(bmstatus & BM_STATUS_IRQ)) {
+            return;
         }
-        outsl(iobase, src, SECTSIZE / sizeof(uint32_t));
+        outb(ch->bmbase + BM_CMD, inb(ch->bmbase + BM_CMD) & ~BM_CMD_START);
+        r = inb(iobase + ISA_STATUS);
+        outb(ch->bmbase + BM_STATUS, bmstatus | BM_STATUS_ERR | BM_STATUS_IRQ);
+        ide_complete(ch, ((bmstatus & BM_STATUS_ERR) || (r & (IDE_DF | IDE_ERR))) ? -1 : 0);
     }
+    else {
+        if ((r = inb(iobase + ISA_STATUS)) & IDE_BSY) {
+            return;
+        }
+        if (r & (IDE_DF | IDE_ERR)) {
+            ide_complete(ch, -1);
+        }
+        else if (ch->pio_left == 0) {
+            // the interrupt after the last written sector
+            ide_complete(ch, 0);
+        }
+        else {
+            if (!(r & IDE_DRQ)) {
+                return;
+            }
+            if (ch->pio_req->write) {
+                outsl(iobase + ISA_DATA, ide_pio_buf(ch), SECTSIZE / sizeof(uint32_t));
+                return;
+            }
+            insl(iobase + ISA_DATA, ide_pio_buf(ch), SECTSIZE / sizeof(uint32_t));
+            if (ch->pio_left != 0) {
+                return;
+            }
+            ide_complete(ch, 0);
+        }
+    }
+    ide_start(ch);
+}
+
+// ide_intr - the interrupt handler of IRQ_IDE1 and IRQ_IDE2
+void
+ide_intr(int irq) {
+    ide_service(channels + ((irq == IRQ_IDE1) ? 0 : 1));
+}
 
-out:
-    unlock_channel(ideno);
+/* *
+ * ide_submit_req - queue req and wait for it, called with interrupts disabled,
+ * intr_flag is the interrupt flag of the caller.
+ * */
+static int
+ide_submit_req(struct ide_channel *ch, struct ide_request *req, bool intr_flag) {
+    list_entry_t *list = &(ch->queue), *le = list;
+    uint64_t key = req_key(req->ideno, req->secno);
+    while ((le = list_next(le)) != list) {
+        if (key < req_key(le2req(le, link)->ideno, le2req(le, link)->secno)) {
+            break;
+        }
+    }
+    list_add_before(le, &(req->link));
+    ide_start(ch);
+
+    bool can_sleep = (intr_flag && current != NULL && current != idleproc);
+    while (!req->done) {
+        if (can_sleep) {
+            wait_current_set(&(ch->wait_queue), &(req->wait), WT_IDE);
+            local_intr_restore(intr_flag);
+            schedule();
+            local_intr_save(intr_flag);
+            wait_current_del(&(ch->wait_queue), &(req->wait));
+        }
+        else {
+            pause();
+            ide_service(ch);
+        }
+    }
+    return req->ret;
+}
+
+/* *
+ * ide_submit - transfer nsecs sectors from secno for each of the nbufs
+ * buffers, to the consecutive sectors, and wait for them. the buffers go
+ * in a request as many as fit in one batch, so the disk sees one transfer
+ * where it used to see a request per buffer, see ide_start.
+ * */
+static int
+ide_submit(unsigned short ideno, uint32_t secno, void *bufs[], int nbufs, size_t nsecs, bool write) {
+    assert(nbufs > 0 && nbufs <= IDE_MAX_NVEC && nsecs <= MAX_NSECS);
+    struct ide_channel *ch = channels + (ideno >> 1);
+    struct ide_request __req, *req = &__req;
+    bool dev_dma = (ch->bmbase != 0 && ide_devices[ideno].dma);
+    int i, n, ret = 0;
+
+    for (i = 0; ret == 0 && i < nbufs; i += n) {
+        bool dma = (dev_dma && ide_dma_ok(bufs[i], nsecs));
+        int nprd = 0, k;
+        for (n = 0; i + n < nbufs && (n + 1) * nsecs <= MAX_NSECS; n ++) {
+            void *buf = bufs[i + n];
+            if (dma != (dev_dma && ide_dma_ok(buf, nsecs))) {
+                break;
+            }
+            if (dma) {
+                if (nprd + (k = ide_nprd(buf, nsecs)) > MAX_NPRD) {
+                    break;
+                }
+                nprd += k;
+            }
+        }
+
+        req->ideno = ideno, req->secno = secno + i * nsecs, req->nsecs = nsecs;
+        req->bufs = bufs + i, req->nbufs = n;
+        req->write = write, req->dma = dma, req->done = 0, req->ret = 0;
+        wait_init(&(req->wait), current);
+
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        {
+            ret = ide_submit_req(ch, req, intr_flag);
+        }
+        local_intr_restore(intr_flag);
+    }
     return ret;
 }
 
+static int
+ide_rw_secs(unsigned short ideno, uint32_t secno, void *buf, size_t nsecs, bool write) {
+    assert(VALID_IDE(ideno));
+    assert(secno < MAX_DISK_NSECS && secno + nsecs <= MAX_DISK_NSECS);
+    int ret = 0;
+    while (nsecs != 0) {
+        size_t n = (nsecs < MAX_NSECS) ? nsecs : MAX_NSECS;
+        if ((ret = ide_submit(ideno, secno, &buf, 1, n, write)) != 0) {
+            break;
+        }
+        secno += n, nsecs -= n, buf += n * SECTSIZE;
+    }
+    return ret;
+}
+
+int
+ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs) {
+    return ide_rw_secs(ideno, secno, dst, nsecs, 0);
+}
+
+int
+ide_write_secs(unsigned short ideno, uint32_t secno, const void *src, size_t nsecs) {
+    return ide_rw_secs(ideno, secno, (void *)src, nsecs, 1);
+}
+
+/* *
+ * ide_read_secsv - read the consecutive sectors from secno, nsecs sectors into
+ * each of the nbufs buffers in dsts, see ide_write_secsv.
+ * */
+int
+ide_read_secsv(unsigned short ideno, uint32_t secno, void *dsts[], int nbufs, size_t nsecs) {
+    assert(VALID_IDE(ideno));
+    assert(secno < MAX_DISK_NSECS && secno + nbufs * nsecs <= MAX_DISK_NSECS);
+    assert(nsecs <= MAX_NSECS);
+    return ide_submit(ideno, secno, dsts, nbufs, nsecs, 0);
+}
+
+/* *
+ * ide_write_secsv - write nsecs sectors from each of the nbufs buffers in srcs
+ * to the consecutive sectors from secno, in one request if they fit in one
+ * batch, instead of a request per buffer.
+ * */
+int
+ide_write_secsv(unsigned short ideno, uint32_t secno, void *srcs[], int nbufs, size_t nsecs) {
+    assert(VALID_IDE(ideno));
+    assert(secno < MAX_DISK_NSECS && secno + nbufs * nsecs <= MAX_DISK_NSECS);
+    assert(nsecs <= MAX_NSECS);
+    return ide_submit(ideno, secno, srcs, nbufs, nsecs, 1);
+}
+
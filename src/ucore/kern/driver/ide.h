@@ -3,12 +3,17 @@
 
 #include <types.h>
 
+#define IDE_MAX_NVEC            32      // buffers of a vectored request at most, 32 pages fill a batch
+
 void ide_init(void);
+void ide_intr(int irq);
 bool ide_device_valid(unsigned short ideno);
 size_t ide_device_size(unsigned short ideno);
 
 int ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs);
 int ide_write_secs(unsigned short ideno, uint32_t secno, const void *src, size_t nsecs);
+int ide_read_secsv(unsigned short ideno, uint32_t secno, void *dsts[], int nbufs, size_t nsecs);
+int ide_write_secsv(unsigned short ideno, uint32_t secno, void *srcs[], int nbufs, size_t nsecs);
 
 #endif /* !__KERN_DRIVER_IDE_H__ */
 
@@ -0,0 +1,242 @@
+#include <types.h>
+#include <x86.h>
+#include <trap.h>
+#include <stdio.h>
+#include <clock.h>
+#include <pmm.h>
+#include <mp.h>
+#include <lapic.h>
+#include <assert.h>
+
+/* *
+ * The local APIC manages internal (non-I/O) interrupts of each processor,
+ * such as the timer and the inter-processor interrupts. See Chapter 8 & Appendix C
+ * of Intel processor manual volume 3.
+ * */
+
+// Local APIC registers, divided by 4 for use as uint32_t[] indices.
+#define ID                  (0x0020 / 4)    // ID
+#define VER                 (0x0030 / 4)    // Version
+#define TPR                 (0x0080 / 4)    // Task Priority
+#define EOI                 (0x00B0 / 4)    // EOI
+#define SVR                 (0x00F0 / 4)    // Spurious Interrupt Vector
+#define ENABLE              0x00000100      //   Unit Enable
+#define ESR                 (0x0280 / 4)    // Error Status
+#define ICRLO               (0x0300 / 4)    // Interrupt Command
+#define INIT                0x00000500      //   INIT/RESET
+#define STARTUP             0x00000600      //   Startup IPI
+#define DELIVS              0x00001000      //   Delivery status
+#define ASSERT              0x00004000      //   Assert interrupt (vs deassert)
+#define DEASSERT            0x00000000
+#define LEVEL               0x00008000      //   Level triggered
+#define BCAST               0x00080000      //   Send to all APICs, including self.
+#define ICRHI               (0x0310 / 4)    // Interrupt Command [63:32]
+#define TIMER               (0x0320 / 4)    // Local Vector Table 0 (TIMER)
+#define X1                  0x0000000B      //   divide counts by 1
+#define PERIODIC            0x00020000      //   Periodic
+#define PCINT               (0x0340 / 4)    // Performance Counter LVT
+#define LINT0               (0x0350 / 4)    // Local Vector Table 1 (LINT0)
+#define LINT1               (0x0360 / 4)    // Local Vector Table 2 (LINT1)
+#define ERROR               (0x0370 / 4)    // Local Vector Table 3 (ERROR)
+#define MASKED              0x00010000      //   Interrupt masked
+#define TICR                (0x0380 / 4)    // Timer Initial Count
+#define TCCR                (0x0390 / 4)    // Timer Current Count
+#define TDCR                (0x03E0 / 4)    // Timer Divide Configuration
+
+#define CALIBRATE_TICKS     10
+
+// initialized in mp_init, NULL if there is no local APIC
+volatile uint32_t *lapic;
+
+// timer counts per clock tick, measured by lapic_calibrate on the BSP
+static uint32_t lapic_timer_count = 0;
+
+// time-stamp counts per microsecond, 0 if the one-shot timer is not usable
+uint32_t tsc_per_usec = 0;
+
+static void
+lapicw(int index, int value) {
+    lapic[index] = value;
+    lapic[ID];  // wait for write to finish, by reading
+}
+
+static void
+microdelay(int us) {
+    volatile int i = us * 100;
+    while (i -- > 0) {
+        pause();
+    }
+}
+
+/* lapic_init - enable the local APIC of this cpu, called on every cpu */
+void
+lapic_init(void) {
+    if (lapic == NULL) {
+        return;
+    }
+
+    // enable local APIC; set spurious interrupt vector.
+    lapicw(SVR, ENABLE | (IRQ_OFFSET + IRQ_SPURIOUS));
+
+    // The BSP keeps ticking on the 8253 timer, which is routed by the 8259A
+    // to its LINT0 (the virtual wire mode set up by BIOS). The APs use their
+    // own timer, counting the same period as the 8253 (see lapic_calibrate).
+    lapicw(TDCR, X1);
+    if (mycpu()->id != 0 && lapic_timer_count != 0) {
+        lapicw(TIMER, PERIODIC | (IRQ_OFFSET + IRQ_TIMER));
+        lapicw(TICR, lapic_timer_count);
+    }
+    else {
+        lapicw(TIMER, MASKED | (IRQ_OFFSET + IRQ_TIMER));
+    }
+
+    // leave LINT0 of the BSP enabled so that it can get interrupts from the 8259A chip.
+    if (mycpu()->id != 0) {
+        lapicw(LINT0, MASKED);
+    }
+    // disable NMI (LINT1) on all CPUs
+    lapicw(LINT1, MASKED);
+
+    // disable performance counter overflow interrupts on machines that provide that interrupt entry.
+    if (((lapic[VER] >> 16) & 0xFF) >= 4) {
+        lapicw(PCINT, MASKED);
+    }
+
+    // map error interrupt to IRQ_ERROR.
+    lapicw(ERROR, IRQ_OFFSET + IRQ_ERROR);
+
+    // clear error status register (requires back-to-back writes).
+    lapicw(ESR, 0);
+    lapicw(ESR, 0);
+
+    // ack any outstanding interrupts.
+    lapicw(EOI, 0);
+
+    // send an Init Level De-Assert to synchronize arbitration ID's.
+    lapicw(ICRHI, 0);
+    lapicw(ICRLO, BCAST | INIT | LEVEL);
+    while (lapic[ICRLO] & DELIVS) {
+        /* do nothing */ ;
+    }
+
+    // enable interrupts on the APIC (but not on the processor).
+    lapicw(TPR, 0);
+}
+
+/* *
+ * lapic_calibrate - measure how many timer counts of the local APIC elapse
+ * in one tick of the 8253, so that the APs could schedule at the same rate.
+ * called on the BSP with the clock interrupt enabled.
+ * */
+void
+lapic_calibrate(void) {
+    if (lapic == NULL) {
+        return;
+    }
+    lapicw(TDCR, X1);
+    lapicw(TIMER, MASKED | (IRQ_OFFSET + IRQ_TIMER));
+
+    size_t start = ticks;
+    while (ticks == start) {
+        pause();
+    }
+    lapicw(TICR, 0xFFFFFFFF);
+    uint64_t tsc = rdtsc();
+    start = ticks;
+    while (ticks < start + CALIBRATE_TICKS) {
+        pause();
+    }
+    lapic_timer_count = (0xFFFFFFFF - lapic[TCCR]) / CALIBRATE_TICKS;
+    lapicw(TICR, 0);
+
+    tsc = rdtsc() - tsc;
+    do_div(tsc, CALIBRATE_TICKS * USEC_PER_TICK);
+    if (lapic_timer_count >= USEC_PER_TICK && tsc != 0 && tsc < 0x10000) {
+        tsc_per_usec = tsc;
+    }
+
+    cprintf("++ setup lapic timer: %u counts per tick, %u tsc per usec\n",
+            lapic_timer_count, tsc_per_usec);
+}
+
+/* *
+ * lapic_oneshot - raise IRQ_HRTIMER on this cpu after usecs microseconds,
+ * only used on the BSP, whose local timer is not used for the clock ticks.
+ * */
+void
+lapic_oneshot(uint32_t usecs) {
+    assert(tsc_per_usec != 0 && mycpu()->id == 0);
+    uint64_t count = (uint64_t)usecs * lapic_timer_count;
+    do_div(count, USEC_PER_TICK);
+    lapicw(TIMER, IRQ_OFFSET + IRQ_HRTIMER);
+    lapicw(TICR, (count != 0 && count < 0xFFFFFFFF) ? (uint32_t)count : 1);
+}
+
+/* lapic_id - get the local APIC ID of this cpu */
+int
+lapic_id(void) {
+    if (lapic == NULL) {
+        return 0;
+    }
+    return lapic[ID] >> 24;
+}
+
+/* lapic_eoi - acknowledge interrupt */
+void
+lapic_eoi(void) {
+    if (lapic != NULL) {
+        lapicw(EOI, 0);
+    }
+}
+
+#define IO_RTC              0x70
+
+/* *
+ * lapic_startap - start additional processor running entry code at addr.
+ * See Appendix B of MultiProcessor Specification.
+ * */
+void
+lapic_startap(uint8_t apicid, uintptr_t addr) {
+    // "The BSP must initialize CMOS shutdown code to 0AH and the warm reset
+    // vector (DWORD based at 40:67) to point at the AP startup code prior to
+    // the [universal startup algorithm]."
+    outb(IO_RTC, 0xF);  // offset 0xF is shutdown code
+    outb(IO_RTC + 1, 0x0A);
+    uint16_t *wrv = (uint16_t *)KADDR((0x40 << 4 | 0x67));  // Warm reset vector
+    wrv[0] = 0;
+    wrv[1] = addr >> 4;
+
+    // "Universal startup algorithm."
+    // send INIT (level-triggered) interrupt to reset other CPU.
+    lapicw(ICRHI, apicid << 24);
+    lapicw(ICRLO, INIT | LEVEL | ASSERT);
+    microdelay(200);
+    lapicw(ICRLO, INIT | LEVEL);
+    microdelay(100);    // should be 10ms, but too slow in Bochs!
+
+    // send startup IPI (twice!) to enter code.
+    // Regular hardware is supposed to only accept a STARTUP
+    // when it is in the halted state due to an INIT.  So the second
+    // should be ignored, but it is part of the official Intel algorithm.
+    // Bochs complains about the second one.  Too bad for Bochs.
+    int i;
+    for (i = 0; i < 2; i ++) {
+        lapicw(ICRHI, apicid << 24);
+        lapicw(ICRLO, STARTUP | (addr >> 12));
+        microdelay(200);
+    }
+}
+
+/* lapic_send_ipi - send a fixed inter-processor interrupt to the cpu with apicid */
+void
+lapic_send_ipi(uint8_t apicid, int vector) {
+    if (lapic == NULL) {
+        return;
+    }
+    lapicw(ICRHI, apicid << 24);
+    lapicw(ICRLO, ASSERT | vector);
+    while (lapic[ICRLO] & DELIVS) {
+        pause();
+    }
+}
+
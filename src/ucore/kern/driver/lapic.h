@@ -0,0 +1,18 @@
+#ifndef __KERN_DRIVER_LAPIC_H__
+#define __KERN_DRIVER_LAPIC_H__
+
+#include <types.h>
+
+extern volatile uint32_t *lapic;
+extern uint32_t tsc_per_usec;
+
+void lapic_init(void);
+void lapic_calibrate(void);
+void lapic_oneshot(uint32_t usecs);
+int lapic_id(void);
+void lapic_eoi(void);
+void lapic_startap(uint8_t apicid, uintptr_t addr);
+void lapic_send_ipi(uint8_t apicid, int vector);
+
+#endif /* !__KERN_DRIVER_LAPIC_H__ */
+
@@ -0,0 +1,363 @@
+#include <types.h>
+#include <x86.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <atomic.h>
+#include <trap.h>
+#include <pmm.h>
+#include <proc.h>
+#include <sync.h>
+#include <lapic.h>
+#include <mp.h>
+
+/* *
+ * Multiprocessor support, search memory for MP description structures.
+ * See MultiProcessor Specification Version 1.4 for the details.
+ *
+ * The BSP (bootstrap processor) always uses cpus[0], the APs (application
+ * processors) found in the MP configuration table are numbered in order.
+ * */
+
+struct cpu cpus[NCPU];
+int ncpu = 1;
+
+// floating pointer structure
+struct mp {
+    uint8_t signature[4];           // "_MP_"
+    uint32_t physaddr;              // phys addr of MP config table
+    uint8_t length;                 // 1
+    uint8_t specrev;                // [14]
+    uint8_t checksum;               // all bytes must add up to 0
+    uint8_t type;                   // MP system config type
+    uint8_t imcrp;
+    uint8_t reserved[3];
+} __attribute__((packed));
+
+// configuration table header
+struct mpconf {
+    uint8_t signature[4];           // "PCMP"
+    uint16_t length;                // total table length
+    uint8_t version;                // [14]
+    uint8_t checksum;               // all bytes must add up to 0
+    uint8_t product[20];            // product id
+    uint32_t oemtable;              // OEM table pointer
+    uint16_t oemlength;             // OEM table length
+    uint16_t entry;                 // entry count
+    uint32_t lapicaddr;             // address of local APIC
+    uint16_t xlength;               // extended table length
+    uint8_t xchecksum;              // extended table checksum
+    uint8_t reserved;
+    uint8_t entries[0];             // table entries
+} __attribute__((packed));
+
+// processor table entry
+struct mpproc {
+    uint8_t type;                   // entry type (0)
+    uint8_t apicid;                 // local APIC id
+    uint8_t version;                // local APIC version
+    uint8_t flags;                  // CPU flags
+    uint8_t signature[4];           // CPU signature
+    uint32_t feature;               // feature flags from CPUID instruction
+    uint8_t reserved[8];
+} __attribute__((packed));
+
+// mpproc flags
+#define MPPROC_BOOT         0x02    // This mpproc is the bootstrap processor
+
+// table entry types
+#define MPPROC              0x00    // one per processor
+#define MPBUS               0x01    // one per bus
+#define MPIOAPIC            0x02    // one per I/O APIC
+#define MPIOINTR            0x03    // one per bus interrupt source
+#define MPLINTR             0x04    // one per system interrupt source
+
+static uint8_t
+sum(void *addr, int len) {
+    int i, sum = 0;
+    for (i = 0; i < len; i ++) {
+        sum += ((uint8_t *)addr)[i];
+    }
+    return sum;
+}
+
+// mp_search1 - look for an MP structure in the len bytes at physical address a.
+static struct mp *
+mp_search1(uintptr_t a, int len) {
+    struct mp *mp = KADDR(a), *end = KADDR(a + len);
+    for (; mp < end; mp ++) {
+        if (memcmp(mp->signature, "_MP_", 4) == 0 && sum(mp, sizeof(*mp)) == 0) {
+            return mp;
+        }
+    }
+    return NULL;
+}
+
+// mp_search - search for the MP Floating Pointer Structure, which according to
+// [MP 4] is in one of the following three locations:
+// 1) in the first KB of the EBDA;
+// 2) if there is no EBDA, in the last KB of system base memory;
+// 3) in the BIOS ROM between 0xF0000 and 0xFFFFF.
+static struct mp *
+mp_search(void) {
+    uint8_t *bda = (uint8_t *)KADDR(0x400);
+    uint32_t p;
+    struct mp *mp;
+
+    if ((p = ((bda[0x0F] << 8) | bda[0x0E]) << 4) != 0) {
+        if ((mp = mp_search1(p, 1024)) != NULL) {
+            return mp;
+        }
+    }
+    else {
+        p = ((bda[0x14] << 8) | bda[0x13]) * 1024;
+        if ((mp = mp_search1(p - 1024, 1024)) != NULL) {
+            return mp;
+        }
+    }
+    return mp_search1(0xF0000, 0x10000);
+}
+
+// the local APIC of the default configurations, [MP 5.1]
+#define MP_DEFAULT_LAPICADDR    0xFEE00000
+
+// mp_config - check the MP configuration table of mp. mp has no table if it
+// describes one of the default configurations (mp->type != 0).
+static struct mpconf *
+mp_config(struct mp *mp) {
+    struct mpconf *conf;
+
+    if (mp->physaddr == 0) {
+        cprintf("SMP: No MP configuration table\n");
+        return NULL;
+    }
+    conf = (struct mpconf *)KADDR(mp->physaddr);
+    if (memcmp(conf, "PCMP", 4) != 0) {
+        cprintf("SMP: Incorrect MP configuration table signature\n");
+        return NULL;
+    }
+    if (sum(conf, conf->length) != 0) {
+        cprintf("SMP: Bad MP configuration checksum\n");
+        return NULL;
+    }
+    if (conf->version != 1 && conf->version != 4) {
+        cprintf("SMP: Unsupported MP version %d\n", conf->version);
+        return NULL;
+    }
+    return conf;
+}
+
+// mp_config_cpus - find the processors in the MP configuration table, returns
+// the address of the local APIC, or 0 if the table is not usable.
+static uintptr_t
+mp_config_cpus(struct mpconf *conf) {
+    struct mpproc *proc;
+    uint8_t *p;
+    int i;
+
+    bool found_boot = 0;
+    for (p = conf->entries, i = 0; i < conf->entry; i ++) {
+        switch (*p) {
+        case MPPROC:
+            proc = (struct mpproc *)p;
+            if (proc->flags & MPPROC_BOOT) {
+                cpus[0].apicid = proc->apicid;
+                found_boot = 1;
+            }
+            else if (ncpu < NCPU) {
+                cpus[ncpu].id = ncpu;
+                cpus[ncpu].apicid = proc->apicid;
+                ncpu ++;
+            }
+            else {
+                cprintf("SMP: too many CPUs, CPU %d disabled\n", proc->apicid);
+            }
+            p += sizeof(struct mpproc);
+            continue;
+        case MPBUS:
+        case MPIOAPIC:
+        case MPIOINTR:
+        case MPLINTR:
+            p += 8;
+            continue;
+        default:
+            cprintf("mp_init: unknown config type %x\n", *p);
+            return 0;
+        }
+    }
+    return found_boot ? conf->lapicaddr : 0;
+}
+
+/* *
+ * mp_default_cpus - the default configurations of [MP 5] have no table: there
+ * are two processors with local APIC IDs 0 and 1, and the local APIC is at
+ * MP_DEFAULT_LAPICADDR. Types 1-4 have a discrete 82489DX APIC, 5-7 the
+ * integrated one, which both work the same for us.
+ * */
+static uintptr_t
+mp_default_cpus(struct mp *mp) {
+    if (mp->type > 7) {
+        cprintf("SMP: Unknown default configuration %d\n", mp->type);
+        return 0;
+    }
+    cprintf("SMP: Default configuration %d\n", mp->type);
+    // which of the two is the BSP is only known from its own local APIC
+    lapic = mmio_map_region(MP_DEFAULT_LAPICADDR, PGSIZE);
+    cpus[0].apicid = lapic_id();
+    cpus[1].id = 1;
+    cpus[1].apicid = !cpus[0].apicid;
+    ncpu = 2;
+    return MP_DEFAULT_LAPICADDR;
+}
+
+/* *
+ * mp_init - find the processors and the local APIC from the MP configuration
+ * table, or from the default configuration named by the floating pointer.
+ * Keep running with only one cpu if there is neither, or the table is broken.
+ * */
+void
+mp_init(void) {
+    struct mp *mp;
+    struct mpconf *conf;
+    uintptr_t lapicaddr = 0;
+
+    cpus[0].started = 1;
+    if ((mp = mp_search()) == NULL) {
+        return;
+    }
+
+    ncpu = 1;
+    if (mp->type != 0) {
+        lapicaddr = mp_default_cpus(mp);
+    }
+    else if ((conf = mp_config(mp)) != NULL) {
+        lapicaddr = mp_config_cpus(conf);
+    }
+
+    if (lapicaddr == 0) {
+        // Didn't like what we found; fall back to no MP.
+        ncpu = 1;
+        cprintf("SMP: configuration not found, SMP disabled\n");
+        return;
+    }
+
+    if (lapic == NULL) {
+        lapic = mmio_map_region(lapicaddr, PGSIZE);
+    }
+    cprintf("SMP: CPU %d found %d CPU(s)\n", cpus[0].apicid, ncpu);
+
+    if (mp->imcrp) {
+        // [MP 3.2.6.1] If the hardware implements PIC mode,
+        // switch to getting interrupts from the LAPIC.
+        cprintf("SMP: Setting IMCR to switch from PIC mode to symmetric I/O mode\n");
+        outb(0x22, 0x70);               // Select IMCR
+        outb(0x23, inb(0x23) | 1);      // Mask external interrupts.
+    }
+}
+
+// the cpu and the stack top for mpentry.S
+static struct cpu *mp_booting;
+uintptr_t mpentry_kstack;
+
+/* mp_main - setup code for APs, jumped from mpentry.S */
+void
+mp_main(void) {
+    struct cpu *cpu = mp_booting;
+    gdt_init_cpu(cpu);
+    load_esp0(cpu->idle->kstack + KSTACKSIZE);
+    idt_init();
+    lapic_init();
+
+    cprintf("SMP: CPU %d starting\n", cpu->apicid);
+    cpu->started = 1;
+
+    intr_enable();
+    cpu_idle();
+}
+
+/* *
+ * mp_start_aps - copy the entry code of APs to MPENTRY_PADDR, and start the
+ * APs one by one, each on the kernel stack of its own idle process.
+ * */
+void
+mp_start_aps(void) {
+    extern unsigned char mpentry_start[], mpentry_end[];
+    struct cpu *cpu;
+
+    if (ncpu == 1) {
+        return;
+    }
+
+    memmove(KADDR(MPENTRY_PADDR), mpentry_start, mpentry_end - mpentry_start);
+
+    // mpentry.S turns on paging while running at MPENTRY_PADDR, so the low
+    // memory is mapped in place until all the APs have moved to KERNBASE.
+    boot_pgdir[0] = boot_pgdir[PDX(KERNBASE)];
+
+    for (cpu = cpus + 1; cpu < cpus + ncpu; cpu ++) {
+        proc_init_cpu(cpu);
+        mp_booting = cpu;
+        mpentry_kstack = cpu->idle->kstack + KSTACKSIZE;
+        lapic_startap(cpu->apicid, MPENTRY_PADDR);
+        while (!cpu->started) {
+            pause();
+        }
+    }
+
+    boot_pgdir[0] = 0;
+    lcr3(rcr3());
+}
+
+static volatile uintptr_t tlb_cr3, tlb_la;
+static atomic_t tlb_pending;
+
+/* *
+ * mp_tlb_shootdown - invalidate the tlb entry of la on the other cpus which
+ * are running with page directory cr3, and wait for them to finish.
+ * la is TLB_FLUSH_ALL after a change to the page directory itself.
+ * only called with the kernel lock held, so there is one shootdown at a time.
+ * */
+void
+mp_tlb_shootdown(uintptr_t cr3, uintptr_t la) {
+    bool target[NCPU];
+    struct cpu *self = mycpu(), *cpu;
+    int n = 0;
+
+    for (cpu = cpus; cpu < cpus + ncpu; cpu ++) {
+        target[cpu->id] = (cpu != self && cpu->started
+                && cpu->proc != NULL && cpu->proc->cr3 == cr3);
+        if (target[cpu->id]) {
+            n ++;
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+
+    tlb_cr3 = cr3, tlb_la = la;
+    atomic_set(&tlb_pending, n);
+    for (cpu = cpus; cpu < cpus + ncpu; cpu ++) {
+        if (target[cpu->id]) {
+            lapic_send_ipi(cpu->apicid, IRQ_OFFSET + IRQ_IPI_TLB);
+        }
+    }
+    while (atomic_read(&tlb_pending) != 0) {
+        pause();
+    }
+}
+
+/* mp_tlb_shootdown_ack - handler of IRQ_IPI_TLB, runs without the kernel lock */
+void
+mp_tlb_shootdown_ack(void) {
+    if (rcr3() == tlb_cr3) {
+        if (tlb_la == TLB_FLUSH_ALL) {
+            lcr3(tlb_cr3);
+        }
+        else {
+            invlpg((void *)tlb_la);
+        }
+    }
+    lapic_eoi();
+    atomic_dec(&tlb_pending);
+}
+
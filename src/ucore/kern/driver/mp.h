@@ -0,0 +1,60 @@
+#ifndef __KERN_DRIVER_MP_H__
+#define __KERN_DRIVER_MP_H__
+
+#include <types.h>
+#include <x86.h>
+#include <mmu.h>
+#include <memlayout.h>
+#include <spinlock.h>
+
+#define NCPU                8           // maximum number of cpus
+
+struct proc_struct;
+struct run_queue;
+
+/* *
+ * struct cpu - the per-cpu state of kernel.
+ *
+ * Each cpu loads its own gdt, in which the descriptor of SEG_KCPU has the
+ * base address of its struct cpu. The kernel keeps %fs loaded with that
+ * selector (see __alltraps), so mycpu() is one memory access. A process
+ * stays on its cpu only until it calls schedule: once it sleeps or yields,
+ * another cpu may steal it from the run queue (see sched_steal), so the
+ * result must not be kept across a call which may block.
+ * */
+struct cpu {
+    struct cpu *self;                   // must be the first field, see mycpu
+    struct proc_struct *proc;           // the process running on this cpu
+    struct proc_struct *idle;           // the idle process of this cpu
+    struct proc_struct *prev;           // the process switched out by proc_run
+    int id;                             // index into cpus[]
+    uint8_t apicid;                     // local APIC ID
+    volatile bool started;              // has the cpu started?
+    struct taskstate ts;                // used by x86 to find stack for interrupt
+    struct segdesc gdt[NSEGS];          // per-cpu global descriptor table
+    struct pseudodesc gdt_pd;           // the operand of lgdt
+    struct run_queue *rq;               // run queue of this cpu
+    spinlock_t rq_lock;                 // protects rq
+    unsigned int nr_running;            // number of procs in rq
+};
+
+extern struct cpu cpus[NCPU];
+extern int ncpu;
+
+static inline struct cpu *
+mycpu(void) {
+    struct cpu *cpu;
+    asm volatile ("movl %%fs:0, %0" : "=r" (cpu));
+    return cpu;
+}
+
+// mp_tlb_shootdown: flush the whole tlb instead of the entry of one page
+#define TLB_FLUSH_ALL                   ((uintptr_t)-1)
+
+void mp_init(void);
+void mp_start_aps(void);
+void mp_tlb_shootdown(uintptr_t cr3, uintptr_t la);
+void mp_tlb_shootdown_ack(void);
+
+#endif /* !__KERN_DRIVER_MP_H__ */
+
@@ -0,0 +1,49 @@
+#include <types.h>
+#include <x86.h>
+#include <pci.h>
+
+/* *
+ * PCI configuration space access through the configuration mechanism #1,
+ * only enough to find the IDE controller on bus 0.
+ * */
+
+#define PCI_CONF_ADDR               0xCF8
+#define PCI_CONF_DATA               0xCFC
+
+#define PCI_MAX_DEV                 32
+#define PCI_MAX_FUNC                8
+
+static uint32_t
+pci_conf_addr(uint32_t dev, uint32_t func, uint32_t off) {
+    return 0x80000000 | (dev << 11) | (func << 8) | (off & 0xFC);
+}
+
+uint32_t
+pci_conf_read(struct pci_func *f, uint32_t off) {
+    outl(PCI_CONF_ADDR, pci_conf_addr(f->dev, f->func, off));
+    return inl(PCI_CONF_DATA);
+}
+
+void
+pci_conf_write(struct pci_func *f, uint32_t off, uint32_t v) {
+    outl(PCI_CONF_ADDR, pci_conf_addr(f->dev, f->func, off));
+    outl(PCI_CONF_DATA, v);
+}
+
+// pci_find_class - find the first function of class/subclass on bus 0
+bool
+pci_find_class(uint32_t class, uint32_t subclass, struct pci_func *f) {
+    for (f->dev = 0; f->dev < PCI_MAX_DEV; f->dev ++) {
+        for (f->func = 0; f->func < PCI_MAX_FUNC; f->func ++) {
+            if (((f->dev_id = pci_conf_read(f, PCI_ID_REG)) & 0xFFFF) == 0xFFFF) {
+                continue;
+            }
+            f->dev_class = pci_conf_read(f, PCI_CLASS_REG);
+            if (PCI_CLASS(f->dev_class) == class && PCI_SUBCLASS(f->dev_class) == subclass) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
@@ -0,0 +1,39 @@
+#ifndef __KERN_DRIVER_PCI_H__
+#define __KERN_DRIVER_PCI_H__
+
+#include <types.h>
+
+// configuration space registers
+#define PCI_ID_REG                  0x00
+#define PCI_COMMAND_STATUS_REG      0x04
+#define PCI_CLASS_REG               0x08
+#define PCI_BAR_REG(n)              (0x10 + (n) * 4)
+
+#define PCI_COMMAND_IO_ENABLE       0x00000001
+#define PCI_COMMAND_MEM_ENABLE      0x00000002
+#define PCI_COMMAND_MASTER_ENABLE   0x00000004
+
+#define PCI_CLASS(x)                (((x) >> 24) & 0xFF)
+#define PCI_SUBCLASS(x)             (((x) >> 16) & 0xFF)
+#define PCI_INTERFACE(x)            (((x) >> 8) & 0xFF)
+
+#define PCI_CLASS_MASS_STORAGE      0x01
+#define PCI_SUBCLASS_MASS_STORAGE_IDE   0x01
+
+#define PCI_BAR_IO                  0x00000001
+#define PCI_BAR_IO_ADDR(x)          ((x) & 0xFFFFFFFC)
+
+// a function on bus 0, the only bus scanned
+struct pci_func {
+    uint32_t dev;
+    uint32_t func;
+    uint32_t dev_id;
+    uint32_t dev_class;
+};
+
+uint32_t pci_conf_read(struct pci_func *f, uint32_t off);
+void pci_conf_write(struct pci_func *f, uint32_t off, uint32_t v);
+bool pci_find_class(uint32_t class, uint32_t subclass, struct pci_func *f);
+
+#endif /* !__KERN_DRIVER_PCI_H__ */
+
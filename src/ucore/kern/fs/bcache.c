@@ -0,0 +1,395 @@
+#include <types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <list.h>
+#include <pmm.h>
+#include <sync.h>
+#include <wait.h>
+#include <sem.h>
+#include <proc.h>
+#include <dev.h>
+#include <iobuf.h>
+#include <bcache.h>
+#include <assert.h>
+
+#define BCACHE_HASH_SHIFT           8
+#define BCACHE_HASH_SIZE            (1 << BCACHE_HASH_SHIFT)
+#define buf_hashfn(dev, blkno)      (hash32((uintptr_t)(dev) ^ (blkno), BCACHE_HASH_SHIFT))
+
+static struct buf bufs[BCACHE_NBUF];
+static list_entry_t hash_list[BCACHE_HASH_SIZE];
+
+// unreferenced buffers, least recently used first
+static list_entry_t lru_list;
+
+// processes waiting for an unreferenced buffer
+static wait_queue_t bcache_wait_queue;
+
+void
+bcache_init(void) {
+    int i;
+    for (i = 0; i < BCACHE_HASH_SIZE; i ++) {
+        list_init(hash_list + i);
+    }
+    list_init(&lru_list);
+    wait_queue_init(&bcache_wait_queue);
+
+    for (i = 0; i < BCACHE_NBUF; i ++) {
+        struct buf *buf = bufs + i;
+        struct Page *page;
+        if ((page = alloc_page()) == NULL) {
+            panic("bcache: no memory for buffers.\n");
+        }
+        buf->dev = NULL;
+        buf->blkno = 0;
+        buf->data = page2kva(page);
+        buf->ref = 0;
+        buf->valid = buf->dirty = 0;
+        sem_init(&(buf->sem), 1);
+        list_init(&(buf->hash_link));
+        list_add_before(&lru_list, &(buf->lru_link));
+    }
+}
+
+static struct buf *
+lookup_buf(struct device *dev, uint32_t blkno) {
+    list_entry_t *list = hash_list + buf_hashfn(dev, blkno), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct buf *buf = le2buf(le, hash_link);
+        if (buf->dev == dev && buf->blkno == blkno) {
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+// buf_hold - take a reference of buf, must be called with interrupts disabled
+static void
+buf_hold(struct buf *buf) {
+    if (buf->ref ++ == 0) {
+        list_del(&(buf->lru_link));
+    }
+}
+
+// buf_unhold - drop a reference of buf, the buffer becomes the most recently used one
+static void
+buf_unhold(struct buf *buf) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        assert(buf->ref > 0);
+        if (-- buf->ref == 0) {
+            list_add_before(&lru_list, &(buf->lru_link));
+            if (!wait_queue_empty(&bcache_wait_queue)) {
+                wakeup_queue(&bcache_wait_queue, WT_BCACHE, 1);
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+// buf_writeback - write a locked dirty buffer to its device
+static int
+buf_writeback(struct buf *buf) {
+    int ret = 0;
+    if (buf->dirty) {
+        struct iobuf __iob, *iob = iobuf_init(&__iob, buf->data, BCACHE_BLKSIZE, buf->blkno * BCACHE_BLKSIZE);
+        if ((ret = dop_io(buf->dev, iob, 1)) == 0) {
+            buf->dirty = 0;
+        }
+    }
+    return ret;
+}
+
+/* *
+ * bcache_writeback_run - write back the dirty buffer of (dev, blkno) together
+ * with the dirty buffers of the blocks before and after it, BCACHE_MAX_RUN
+ * blocks at most, in one dop_iov. the buffers are locked in the order of
+ * their blocks, as bcache_readahead does.
+ * */
+static int
+bcache_writeback_run(struct device *dev, uint32_t blkno) {
+    struct buf *run[BCACHE_MAX_RUN], *buf;
+    void *datas[BCACHE_MAX_RUN];
+    int i, j, k, n = 0, ret = 0;
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        while (n < BCACHE_MAX_RUN - 1 && blkno > 0
+                && (buf = lookup_buf(dev, blkno - 1)) != NULL && buf->dirty) {
+            blkno --, n ++;
+        }
+        n = 0;
+        while (n < BCACHE_MAX_RUN && (buf = lookup_buf(dev, blkno + n)) != NULL && buf->dirty) {
+            buf_hold(buf);
+            run[n ++] = buf;
+        }
+    }
+    local_intr_restore(intr_flag);
+
+    for (i = 0; i < n; i ++) {
+        down(&(run[i]->sem));
+    }
+    for (i = 0; i < n; i = j) {
+        int err = 0;
+        if (dev->d_iov == NULL) {
+            err = buf_writeback(run[i]), j = i + 1;
+        }
+        else {
+            // the buffers written back meanwhile split the run
+            for (j = i; j < n && run[j]->dirty; j ++) {
+                datas[j - i] = run[j]->data;
+            }
+            if (j == i) {
+                j ++;
+            }
+            else if ((err = dop_iov(dev, run[i]->blkno, datas, j - i, 1)) == 0) {
+                for (k = i; k < j; k ++) {
+                    run[k]->dirty = 0;
+                }
+            }
+        }
+        if (err != 0 && ret == 0) {
+            ret = err;
+        }
+    }
+    for (i = 0; i < n; i ++) {
+        bcache_release(run[i]);
+    }
+    return ret;
+}
+
+static void
+bcache_wait(void) {
+    bool intr_flag;
+    wait_t __wait, *wait = &__wait;
+    local_intr_save(intr_flag);
+    wait_current_set(&bcache_wait_queue, wait, WT_BCACHE);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    wait_current_del(&bcache_wait_queue, wait);
+    local_intr_restore(intr_flag);
+}
+
+/* *
+ * bcache_get - get the locked buffer of (dev, blkno), whose content may not
+ * be valid yet. used directly by the callers which overwrite the whole block.
+ * */
+struct buf *
+bcache_get(struct device *dev, uint32_t blkno) {
+    assert(dev->d_blocksize == BCACHE_BLKSIZE);
+    struct buf *buf;
+    bool intr_flag;
+
+again:
+    local_intr_save(intr_flag);
+    if ((buf = lookup_buf(dev, blkno)) != NULL) {
+        buf_hold(buf);
+        local_intr_restore(intr_flag);
+        down(&(buf->sem));
+        return buf;
+    }
+
+    // recycle the least recently used buffer, prefer the clean ones
+    list_entry_t *le = &lru_list;
+    struct buf *victim = NULL;
+    while ((le = list_next(le)) != &lru_list) {
+        buf = le2buf(le, lru_link);
+        if (!buf->dirty) {
+            victim = buf;
+            break;
+        }
+        if (victim == NULL) {
+            victim = buf;
+        }
+    }
+    if (victim == NULL) {
+        local_intr_restore(intr_flag);
+        bcache_wait();
+        goto again;
+    }
+
+    if (victim->dirty) {
+        // may sleep in dop_iov, the block could be loaded by others meanwhile
+        struct device *victim_dev = victim->dev;
+        uint32_t victim_blkno = victim->blkno;
+        local_intr_restore(intr_flag);
+        int ret;
+        if ((ret = bcache_writeback_run(victim_dev, victim_blkno)) != 0) {
+            warn("bcache: write back block %u failed: %e.\n", victim_blkno, ret);
+        }
+        goto again;
+    }
+
+    buf_hold(victim);
+
+    list_del_init(&(victim->hash_link));
+    victim->dev = dev, victim->blkno = blkno, victim->valid = 0;
+    list_add(hash_list + buf_hashfn(dev, blkno), &(victim->hash_link));
+    local_intr_restore(intr_flag);
+
+    down(&(victim->sem));
+    return victim;
+}
+
+// bcache_read - get the locked buffer of (dev, blkno), read from dev if it is not cached
+int
+bcache_read(struct device *dev, uint32_t blkno, struct buf **buf_store) {
+    struct buf *buf = bcache_get(dev, blkno);
+    if (!buf->valid) {
+        int ret;
+        struct iobuf __iob, *iob = iobuf_init(&__iob, buf->data, BCACHE_BLKSIZE, blkno * BCACHE_BLKSIZE);
+        if ((ret = dop_io(dev, iob, 0)) != 0) {
+            bcache_release(buf);
+            return ret;
+        }
+        buf->valid = 1;
+    }
+    *buf_store = buf;
+    return 0;
+}
+
+// bcache_read_run - read the n locked buffers of consecutive blocks with one dop_iov, and release them
+static int
+bcache_read_run(struct device *dev, struct buf *run[], int n) {
+    void *datas[BCACHE_MAX_RUN];
+    int i, ret;
+    for (i = 0; i < n; i ++) {
+        datas[i] = run[i]->data;
+    }
+    ret = dop_iov(dev, run[0]->blkno, datas, n, 0);
+    for (i = 0; i < n; i ++) {
+        if (ret == 0) {
+            run[i]->valid = 1;
+        }
+        bcache_release(run[i]);
+    }
+    return ret;
+}
+
+/* *
+ * bcache_readahead - make the nblks blocks from blkno cached without holding
+ * them, the missing ones are read with a dop_iov per run of consecutive
+ * blocks, instead of a request per block by bcache_read. does nothing on
+ * the devices without d_iov.
+ * */
+int
+bcache_readahead(struct device *dev, uint32_t blkno, uint32_t nblks) {
+    if (dev->d_iov == NULL) {
+        return 0;
+    }
+    struct buf *run[BCACHE_MAX_RUN], *buf;
+    int n = 0, ret = 0;
+    for (; nblks != 0 && ret == 0; blkno ++, nblks --) {
+        bool intr_flag, cached;
+        local_intr_save(intr_flag);
+        {
+            cached = ((buf = lookup_buf(dev, blkno)) != NULL && buf->valid);
+        }
+        local_intr_restore(intr_flag);
+        if (!cached) {
+            if (!(buf = bcache_get(dev, blkno))->valid) {
+                run[n ++] = buf;
+                if (n < BCACHE_MAX_RUN) {
+                    continue;
+                }
+            }
+            else {
+                bcache_release(buf);
+            }
+        }
+        if (n != 0) {
+            ret = bcache_read_run(dev, run, n), n = 0;
+        }
+    }
+    if (n != 0) {
+        ret = bcache_read_run(dev, run, n);
+    }
+    return ret;
+}
+
+// bcache_dirty - mark a locked buffer modified, it will be written back later
+void
+bcache_dirty(struct buf *buf) {
+    buf->valid = buf->dirty = 1;
+}
+
+// bcache_release - unlock a buffer got from bcache_get/bcache_read
+void
+bcache_release(struct buf *buf) {
+    up(&(buf->sem));
+    buf_unhold(buf);
+}
+
+/* *
+ * bcache_sync - write back all dirty buffers of dev, or of all devices if
+ * dev is NULL. returns the first error, the failed buffers stay dirty.
+ * */
+int
+bcache_sync(struct device *dev) {
+    int i, ret = 0;
+    for (i = 0; i < BCACHE_NBUF; i ++) {
+        struct buf *buf = bufs + i;
+        struct device *buf_dev;
+        uint32_t blkno;
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        if (!buf->dirty || (dev != NULL && buf->dev != dev)) {
+            local_intr_restore(intr_flag);
+            continue;
+        }
+        buf_dev = buf->dev, blkno = buf->blkno;
+        local_intr_restore(intr_flag);
+
+        int err = bcache_writeback_run(buf_dev, blkno);
+        if (err != 0 && ret == 0) {
+            ret = err;
+        }
+    }
+    return ret;
+}
+
+/* *
+ * bcache_invalidate - drop all buffers of dev without writing them back,
+ * called after dev is synced and unmounted.
+ * */
+void
+bcache_invalidate(struct device *dev) {
+    int i;
+    for (i = 0; i < BCACHE_NBUF; i ++) {
+        struct buf *buf = bufs + i;
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        if (buf->dev != dev) {
+            local_intr_restore(intr_flag);
+            continue;
+        }
+        buf_hold(buf);
+        local_intr_restore(intr_flag);
+
+        // wait for the holders, e.g. bflushd
+        down(&(buf->sem));
+        local_intr_save(intr_flag);
+        {
+            list_del_init(&(buf->hash_link));
+            buf->dev = NULL, buf->blkno = 0;
+            buf->valid = buf->dirty = 0;
+        }
+        local_intr_restore(intr_flag);
+        bcache_release(buf);
+    }
+}
+
+// bflushd_main - kernel thread which writes back dirty buffers periodically
+int
+bflushd_main(void *arg) {
+    while (1) {
+        do_sleep(BCACHE_FLUSH_INTERVAL);
+        bcache_sync(NULL);
+    }
+}
+
@@ -0,0 +1,59 @@
+#ifndef __KERN_FS_BCACHE_H__
+#define __KERN_FS_BCACHE_H__
+
+#include <types.h>
+#include <list.h>
+#include <sem.h>
+
+/* *
+ * bcache - the block buffer cache shared by the block devices.
+ *
+ * Blocks are cached in a fixed pool of BCACHE_NBUF buffers, looked up by
+ * (device, blkno) through a hash table. Unreferenced buffers are kept on
+ * an lru list, the least recently used one is recycled on a miss. Writes
+ * only mark the buffer dirty, dirty buffers are written back when they are
+ * recycled, when a fs syncs, or periodically by the kernel thread bflushd.
+ *
+ * On the devices with d_iov, runs of consecutive blocks are read and written
+ * with one request, up to BCACHE_MAX_RUN blocks: bcache_readahead reads the
+ * missing blocks of a run, and a dirty buffer is written back together with
+ * the dirty buffers of the blocks around it.
+ * */
+
+#define BCACHE_NBUF                 512                 // number of buffers
+#define BCACHE_BLKSIZE              PGSIZE              // size of each buffer
+#define BCACHE_FLUSH_INTERVAL       500                 // ticks between runs of bflushd
+#define BCACHE_MAX_RUN              32                  // blocks of a dop_iov at most
+
+struct device;
+
+struct buf {
+    struct device *dev;             // device of the block, NULL if unused
+    uint32_t blkno;                 // block number on dev
+    void *data;                     // content of the block
+    int ref;                        // number of holders, see bcache_get/bcache_release
+    bool valid;                     // true if data has been read from or written to
+    bool dirty;                     // true if data should be written back
+    semaphore_t sem;                // lock of data, held by the holder
+    list_entry_t hash_link;         // entry for the hash list
+    list_entry_t lru_link;          // entry for the lru list, valid only if ref == 0
+};
+
+#define le2buf(le, member)                          \
+    to_struct((le), struct buf, member)
+
+void bcache_init(void);
+
+struct buf *bcache_get(struct device *dev, uint32_t blkno);
+int bcache_read(struct device *dev, uint32_t blkno, struct buf **buf_store);
+void bcache_dirty(struct buf *buf);
+void bcache_release(struct buf *buf);
+int bcache_readahead(struct device *dev, uint32_t blkno, uint32_t nblks);
+
+int bcache_sync(struct device *dev);
+void bcache_invalidate(struct device *dev);
+
+int bflushd_main(void *arg) __attribute__((noreturn));
+
+#endif /* !__KERN_FS_BCACHE_H__ */
+
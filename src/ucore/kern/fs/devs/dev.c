@@ -103,6 +103,7 @@ static const struct inode_ops dev_node_ops = {
     .vop_gettype                    = dev_gettype,
     .vop_tryseek                    = dev_tryseek,
     .vop_truncate                   = NULL_VOP_INVAL,
+    .vop_fallocate                  = NULL_VOP_INVAL,
     .vop_create                     = NULL_VOP_NOTDIR,
     .vop_unlink                     = NULL_VOP_NOTDIR,
     .vop_lookup                     = dev_lookup,
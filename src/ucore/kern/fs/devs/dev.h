@@ -13,12 +13,16 @@ struct device {
     int (*d_close)(struct device *dev);
     int (*d_io)(struct device *dev, struct iobuf *iob, bool write);
     int (*d_ioctl)(struct device *dev, int op, void *data);
+    // optional, block io of the nbufs blocks from blkno, a block per buffer
+    int (*d_iov)(struct device *dev, uint32_t blkno, void *bufs[], int nbufs, bool write);
 };
 
 #define dop_open(dev, open_flags)           ((dev)->d_open(dev, open_flags))
 #define dop_close(dev)                      ((dev)->d_close(dev))
 #define dop_io(dev, iob, write)             ((dev)->d_io(dev, iob, write))
 #define dop_ioctl(dev, op, data)            ((dev)->d_ioctl(dev, op, data))
+#define dop_iov(dev, blkno, bufs, nbufs, write)                         \
+    ((dev)->d_iov(dev, blkno, bufs, nbufs, write))
 
 void dev_init(void);
 struct inode *dev_create_inode(void);
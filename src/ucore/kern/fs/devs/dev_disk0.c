@@ -1,5 +1,7 @@
 #include <types.h>
 #include <mmu.h>
+#include <memlayout.h>
+#include <pmm.h>
 #include <slab.h>
 #include <sem.h>
 #include <ide.h>
@@ -7,6 +9,7 @@
 #include <dev.h>
 #include <vfs.h>
 #include <iobuf.h>
+#include <bcache.h>
 #include <error.h>
 #include <assert.h>
 
@@ -79,6 +82,25 @@ disk0_io(struct device *dev, struct iobuf *iob, bool write) {
         return 0;
     }
 
+    /* the buffers in the kernel are passed to ide directly, see ide_dma_ok */
+    uintptr_t base = (uintptr_t)(iob->io_base);
+    if (KERNBASE <= base && base + resid <= KERNBASE + npage * PGSIZE) {
+        uint32_t sectno = blkno * DISK0_BLK_NSECT, nsecs = nblks * DISK0_BLK_NSECT;
+        int ret;
+        if (write) {
+            ret = ide_write_secs(DISK0_DEV_NO, sectno, iob->io_base, nsecs);
+        }
+        else {
+            ret = ide_read_secs(DISK0_DEV_NO, sectno, iob->io_base, nsecs);
+        }
+        if (ret != 0) {
+            panic("disk0: %s blkno = %d (sectno = %d), nblks = %d (nsecs = %d): 0x%08x.\n",
+                    write ? "write" : "read", blkno, sectno, nblks, nsecs, ret);
+        }
+        iobuf_skip(iob, resid);
+        return 0;
+    }
+
     lock_disk0();
     while (resid != 0) {
         size_t copied, alen = DISK0_BUFSIZE;
@@ -103,6 +125,30 @@ disk0_io(struct device *dev, struct iobuf *iob, bool write) {
     return 0;
 }
 
+/* *
+ * disk0_iov - read or write the nbufs blocks from blkno, each to or from its
+ * own buffer in the kernel, as one batch of ide requests, see ide_start.
+ * */
+static int
+disk0_iov(struct device *dev, uint32_t blkno, void *bufs[], int nbufs, bool write) {
+    if (nbufs <= 0 || nbufs > IDE_MAX_NVEC || blkno + nbufs > dev->d_blocks) {
+        return -E_INVAL;
+    }
+    uint32_t sectno = blkno * DISK0_BLK_NSECT;
+    int ret;
+    if (write) {
+        ret = ide_write_secsv(DISK0_DEV_NO, sectno, bufs, nbufs, DISK0_BLK_NSECT);
+    }
+    else {
+        ret = ide_read_secsv(DISK0_DEV_NO, sectno, bufs, nbufs, DISK0_BLK_NSECT);
+    }
+    if (ret != 0) {
+        panic("disk0: %s blkno = %d (sectno = %d), nbufs = %d: 0x%08x.\n",
+                write ? "write" : "read", blkno, sectno, nbufs, ret);
+    }
+    return 0;
+}
+
 static int
 disk0_ioctl(struct device *dev, int op, void *data) {
     return -E_UNIMP;
@@ -111,6 +157,7 @@ disk0_ioctl(struct device *dev, int op, void *data) {
 static void
 disk0_device_init(struct device *dev) {
     static_assert(DISK0_BLKSIZE % SECTSIZE == 0);
+    static_assert(BCACHE_MAX_RUN <= IDE_MAX_NVEC);
     if (!ide_device_valid(DISK0_DEV_NO)) {
         panic("disk0 device isn't available.\n");
     }
@@ -120,6 +167,7 @@ disk0_device_init(struct device *dev) {
     dev->d_close = disk0_close;
     dev->d_io = disk0_io;
     dev->d_ioctl = disk0_ioctl;
+    dev->d_iov = disk0_iov;
     sem_init(&(disk0_sem), 1);
 
     static_assert(DISK0_BUFSIZE % DISK0_BLKSIZE == 0);
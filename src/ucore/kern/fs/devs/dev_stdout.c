@@ -46,6 +46,7 @@ stdout_device_init(struct device *dev) {
     dev->d_close = stdout_close;
     dev->d_io = stdout_io;
     dev->d_ioctl = stdout_ioctl;
+    dev->d_iov = NULL;
 }
 
 void
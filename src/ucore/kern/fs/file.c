@@ -1,6 +1,7 @@
 #include <types.h>
 #include <string.h>
 #include <slab.h>
+#include <pmm.h>
 #include <vfs.h>
 #include <proc.h>
 #include <file.h>
@@ -9,51 +10,164 @@
 #include <inode.h>
 #include <stat.h>
 #include <dirent.h>
+#include <pagecache.h>
+#include <pipe_state.h>
 #include <error.h>
 #include <assert.h>
 
-#define testfd(fd)                          ((fd) >= 0 && (fd) < FS_STRUCT_NENTRY)
-
-static struct file *
+static struct filemap *
 get_filemap(void) {
     struct fs_struct *fs_struct = current->fs_struct;
     assert(fs_struct != NULL && fs_count(fs_struct) > 0);
     return fs_struct->filemap;
 }
 
+/* *
+ * filemap_alloc_nentry - allocate a table of nentry fds, whose chunks from
+ * the first one are new, the ones before are set by the caller
+ * */
+static struct filemap *
+filemap_alloc_nentry(struct fs_struct *fs_struct, int nentry, int first) {
+    assert(nentry % FILEMAP_CHUNK_NENTRY == 0 && nentry <= FILEMAP_MAX_NENTRY);
+    int nchunk = nentry / FILEMAP_CHUNK_NENTRY, nword = nentry / FILEMAP_WORD_NBITS;
+    struct filemap *map;
+    if ((map = kmalloc(sizeof(struct filemap) + nchunk * sizeof(struct file *) + nword * sizeof(uint32_t))) == NULL) {
+        return NULL;
+    }
+    map->nentry = nentry, map->next_fd = 0;
+    map->chunks = (struct file **)(map + 1);
+    map->used = (uint32_t *)(map->chunks + nchunk);
+    memset(map->used, 0, nword * sizeof(uint32_t));
+
+    int i, fd;
+    for (i = first; i < nchunk; i ++) {
+        struct file *file;
+        if ((file = kmalloc(FILEMAP_CHUNK_NENTRY * sizeof(struct file))) == NULL) {
+            goto failed_cleanup;
+        }
+        map->chunks[i] = file;
+        for (fd = i * FILEMAP_CHUNK_NENTRY; fd < (i + 1) * FILEMAP_CHUNK_NENTRY; fd ++, file ++) {
+            atomic_set(&(file->open_count), 0);
+            file->status = FD_NONE, file->fd = fd;
+            file->fs_struct = fs_struct;
+        }
+    }
+    return map;
+
+failed_cleanup:
+    while (-- i >= first) {
+        kfree(map->chunks[i]);
+    }
+    kfree(map);
+    return NULL;
+}
+
+// filemap_create - allocate the table of a new fs_struct, with a chunk of fds
+struct filemap *
+filemap_create(struct fs_struct *fs_struct) {
+    static_assert(FILEMAP_CHUNK_NENTRY % FILEMAP_WORD_NBITS == 0);
+    static_assert(FILEMAP_MAX_NENTRY % FILEMAP_CHUNK_NENTRY == 0);
+    return filemap_alloc_nentry(fs_struct, FILEMAP_CHUNK_NENTRY, 0);
+}
+
+// filemap_destroy - free the table and its files, which must be all FD_NONE
 void
-filemap_init(struct file *filemap) {
-    int fd;
-    struct file *file = filemap;
-    for (fd = 0; fd < FS_STRUCT_NENTRY; fd ++, file ++) {
-        atomic_set(&(file->open_count), 0);
-        file->status = FD_NONE, file->fd = fd;
+filemap_destroy(struct filemap *map) {
+    int i;
+    for (i = 0; i < map->nentry / FILEMAP_CHUNK_NENTRY; i ++) {
+        kfree(map->chunks[i]);
+    }
+    kfree(map);
+}
+
+/* *
+ * filemap_grow - make the table of fs_struct have nentry fds at least, at
+ * least doubling it. the new table takes over the chunks and the bits of
+ * the old one at once after the allocations, which may sleep, so the fds
+ * allocated meanwhile are kept. fs_sem keeps the others from growing it
+ * at the same time.
+ * */
+int
+filemap_grow(struct fs_struct *fs_struct, int nentry) {
+    if (nentry > FILEMAP_MAX_NENTRY) {
+        return -E_MAX_OPEN;
+    }
+    int ret = 0;
+    lock_fs(fs_struct);
+    struct filemap *old = fs_struct->filemap, *map;
+    if (old->nentry < nentry) {
+        if (nentry < old->nentry * 2) {
+            nentry = old->nentry * 2;
+        }
+        if (nentry > FILEMAP_MAX_NENTRY) {
+            nentry = FILEMAP_MAX_NENTRY;
+        }
+        nentry = ROUNDUP(nentry, FILEMAP_CHUNK_NENTRY);
+        if ((map = filemap_alloc_nentry(fs_struct, nentry, old->nentry / FILEMAP_CHUNK_NENTRY)) == NULL) {
+            ret = -E_NO_MEM;
+        }
+        else {
+            memcpy(map->chunks, old->chunks, old->nentry / FILEMAP_CHUNK_NENTRY * sizeof(struct file *));
+            memcpy(map->used, old->used, old->nentry / FILEMAP_WORD_NBITS * sizeof(uint32_t));
+            map->next_fd = old->next_fd;
+            fs_struct->filemap = map;
+            kfree(old);
+        }
+    }
+    unlock_fs(fs_struct);
+    return ret;
+}
+
+// filemap_find - the lowest free fd of map, -1 if there is none
+static int
+filemap_find(struct filemap *map) {
+    int i;
+    for (i = map->next_fd / FILEMAP_WORD_NBITS; i < map->nentry / FILEMAP_WORD_NBITS; i ++) {
+        if (map->used[i] != ~0U) {
+            return i * FILEMAP_WORD_NBITS + __builtin_ctz(~map->used[i]);
+        }
     }
+    return -1;
 }
 
 static int
 filemap_alloc(int fd, struct file **file_store) {
-    struct file *file = get_filemap();
+    struct fs_struct *fs_struct = current->fs_struct;
+    struct filemap *map;
+    struct file *file;
+    int ret;
+
+again:
+    map = get_filemap();
     if (fd == NO_FD) {
-        for (fd = 0; fd < FS_STRUCT_NENTRY; fd ++, file ++) {
-            if (file->status == FD_NONE) {
-                goto found;
+        int free_fd;
+        if ((free_fd = filemap_find(map)) < 0) {
+            if ((ret = filemap_grow(fs_struct, map->nentry + 1)) != 0) {
+                return ret;
             }
+            goto again;
         }
-        return -E_MAX_OPEN;
+        file = filemap_file(map, free_fd);
+        assert(file->status == FD_NONE);
+        map->next_fd = free_fd + 1;
     }
     else {
-        if (testfd(fd)) {
-            file += fd;
-            if (file->status == FD_NONE) {
-                goto found;
+        if (fd < 0 || fd >= FILEMAP_MAX_NENTRY) {
+            return -E_INVAL;
+        }
+        if (fd >= map->nentry) {
+            if ((ret = filemap_grow(fs_struct, fd + 1)) != 0) {
+                return ret;
             }
+            goto again;
+        }
+        file = filemap_file(map, fd);
+        if (file->status != FD_NONE) {
             return -E_BUSY;
         }
-        return -E_INVAL;
     }
-found:
     assert(fopen_count(file) == 0);
+    map->used[file->fd / FILEMAP_WORD_NBITS] |= (1U << (file->fd % FILEMAP_WORD_NBITS));
     file->status = FD_INIT, file->node = NULL;
     *file_store = file;
     return 0;
@@ -67,6 +181,12 @@ filemap_free(struct file *file) {
         vfs_close(file->node);
     }
     file->status = FD_NONE;
+
+    struct filemap *map = file->fs_struct->filemap;
+    map->used[file->fd / FILEMAP_WORD_NBITS] &= ~(1U << (file->fd % FILEMAP_WORD_NBITS));
+    if (map->next_fd > file->fd) {
+        map->next_fd = file->fd;
+    }
 }
 
 static void
@@ -115,8 +235,9 @@ filemap_dup(struct file *to, struct file *from) {
 
 static inline int
 fd2file(int fd, struct file **file_store) {
-    if (testfd(fd)) {
-        struct file *file = get_filemap() + fd;
+    struct filemap *map = get_filemap();
+    if (fd >= 0 && fd < map->nentry) {
+        struct file *file = filemap_file(map, fd);
         if (file->status == FD_OPENED && file->fd == fd) {
             *file_store = file;
             return 0;
@@ -141,6 +262,22 @@ file_testfd(int fd, bool readable, bool writable) {
     return 1;
 }
 
+// file_getnode - get the inode of fd with a reference held, released by vop_ref_dec
+int
+file_getnode(int fd, bool readable, bool writable, struct inode **node_store) {
+    int ret;
+    struct file *file;
+    if ((ret = fd2file(fd, &file)) != 0) {
+        return ret;
+    }
+    if ((readable && !file->readable) || (writable && !file->writable)) {
+        return -E_INVAL;
+    }
+    vop_ref_inc(file->node);
+    *node_store = file->node;
+    return 0;
+}
+
 int
 file_open(char *path, uint32_t open_flags) {
     bool readable = 0, writable = 0;
@@ -208,6 +345,12 @@ file_read(int fd, void *base, size_t len, size_t *copied_store) {
     }
     filemap_acquire(file);
 
+    // the shared mappings may have modified the file
+    if ((ret = pagecache_sync(file->node)) != 0) {
+        filemap_release(file);
+        return ret;
+    }
+
     struct iobuf __iob, *iob = iobuf_init(&__iob, base, len, file->pos);
     ret = vop_read(file->node, iob);
 
@@ -233,10 +376,16 @@ file_write(int fd, void *base, size_t len, size_t *copied_store) {
     }
     filemap_acquire(file);
 
+    if ((ret = pagecache_sync(file->node)) != 0) {
+        filemap_release(file);
+        return ret;
+    }
+
     struct iobuf __iob, *iob = iobuf_init(&__iob, base, len, file->pos);
     ret = vop_write(file->node, iob);
 
     size_t copied = iobuf_used(iob);
+    pagecache_update(file->node, file->pos, copied);
     if (file->status == FD_OPENED) {
         file->pos += copied;
     }
@@ -296,7 +445,38 @@ file_fsync(int fd) {
         return ret;
     }
     filemap_acquire(file);
-    ret = vop_fsync(file->node);
+    if ((ret = pagecache_sync(file->node)) == 0) {
+        ret = vop_fsync(file->node);
+    }
+    filemap_release(file);
+    return ret;
+}
+
+int
+file_fallocate(int fd, off_t len) {
+    int ret;
+    struct file *file;
+    if ((ret = fd2file(fd, &file)) != 0) {
+        return ret;
+    }
+    if (!file->writable) {
+        return -E_INVAL;
+    }
+    filemap_acquire(file);
+    ret = vop_fallocate(file->node, len);
+    filemap_release(file);
+    return ret;
+}
+
+int
+file_ioctl(int fd, int op, void *data) {
+    int ret;
+    struct file *file;
+    if ((ret = fd2file(fd, &file)) != 0) {
+        return ret;
+    }
+    filemap_acquire(file);
+    ret = vop_ioctl(file->node, op, data);
     filemap_release(file);
     return ret;
 }
@@ -409,3 +589,195 @@ failed_cleanup_file:
     return ret;
 }
 
+/* *
+ * splice - move data between a pipe and another file without the bounce
+ * through the user space. the pages of a pipe are passed to the other pipe
+ * by reference, a file is read into a new page which is put into the pipe,
+ * or written from the pages of the pipe directly.
+ * */
+
+#define SPLICE_BATCH                        16
+
+struct splice_pages {
+    int nr_pages;
+    struct {
+        struct Page *page;
+        size_t offset;
+        size_t len;
+    } pages[SPLICE_BATCH];
+};
+
+// splice_get_page - the actor of pipe to pipe, take a reference of the page to put into the other pipe
+static int
+splice_get_page(struct Page *page, size_t offset, size_t len, void *arg) {
+    struct splice_pages *sp = arg;
+    if (sp->nr_pages == SPLICE_BATCH) {
+        return 0;
+    }
+    page_ref_inc(page);
+    sp->pages[sp->nr_pages].page = page;
+    sp->pages[sp->nr_pages].offset = offset;
+    sp->pages[sp->nr_pages].len = len;
+    sp->nr_pages ++;
+    return len;
+}
+
+static int
+splice_pipe_to_pipe(struct pipe_state *in, struct pipe_state *out, size_t len, size_t *copied_store) {
+    int ret = 0, i;
+    size_t copied = 0;
+    while (copied < len) {
+        // never hold the locks of both pipes, wait for room and then move the pages
+        if (!pipe_state_wait_room(out)) {
+            break;
+        }
+        struct splice_pages __sp, *sp = &__sp;
+        sp->nr_pages = 0;
+        if ((ret = pipe_state_splice_out(in, len - copied, splice_get_page, sp)) <= 0) {
+            break;
+        }
+        ret = 0;
+        for (i = 0; i < sp->nr_pages; i ++) {
+            struct Page *page = sp->pages[i].page;
+            if (ret == 0 && (ret = pipe_state_add_page(out, page, sp->pages[i].offset, sp->pages[i].len, 0)) == 0) {
+                copied += sp->pages[i].len;
+                continue;
+            }
+            if (page_ref_dec(page) == 0 && !PageSwap(page)) {
+                free_page(page);
+            }
+        }
+        // the input pipe is drained unless the batch is full
+        if (ret != 0 || sp->nr_pages < SPLICE_BATCH) {
+            break;
+        }
+    }
+    *copied_store = copied;
+    return ret;
+}
+
+static int
+splice_file_to_pipe(struct file *file, struct pipe_state *out, size_t len, size_t *copied_store) {
+    int ret;
+    size_t copied = 0;
+    if ((ret = pagecache_sync(file->node)) != 0) {
+        goto out;
+    }
+    while (copied < len) {
+        if (!pipe_state_wait_room(out)) {
+            break;
+        }
+        struct Page *page;
+        if ((page = alloc_page()) == NULL) {
+            ret = -E_NO_MEM;
+            break;
+        }
+        page_ref_inc(page);
+        size_t alen = len - copied;
+        if (alen > PGSIZE) {
+            alen = PGSIZE;
+        }
+        struct iobuf __iob, *iob = iobuf_init(&__iob, page2kva(page), alen, file->pos);
+        ret = vop_read(file->node, iob);
+        if ((alen = iobuf_used(iob)) == 0 || pipe_state_add_page(out, page, 0, alen, 0) != 0) {
+            page_ref_dec(page);
+            free_page(page);
+            break;
+        }
+        if (file->status == FD_OPENED) {
+            file->pos += alen;
+        }
+        copied += alen;
+        if (ret != 0) {
+            break;
+        }
+    }
+
+out:
+    *copied_store = copied;
+    return ret;
+}
+
+struct splice_desc {
+    struct file *file;
+    off_t pos;
+};
+
+// splice_write_page - the actor of pipe to file, write the data of page to the file
+static int
+splice_write_page(struct Page *page, size_t offset, size_t len, void *arg) {
+    struct splice_desc *sd = arg;
+    struct iobuf __iob, *iob = iobuf_init(&__iob, page2kva(page) + offset, len, sd->pos);
+    int ret = vop_write(sd->file->node, iob);
+    size_t copied = iobuf_used(iob);
+    sd->pos += copied;
+    return (copied != 0) ? copied : ret;
+}
+
+static int
+splice_pipe_to_file(struct pipe_state *in, struct file *file, size_t len, size_t *copied_store) {
+    int ret;
+    *copied_store = 0;
+    if ((ret = pagecache_sync(file->node)) != 0) {
+        return ret;
+    }
+    struct splice_desc __sd, *sd = &__sd;
+    sd->file = file, sd->pos = file->pos;
+    if ((ret = pipe_state_splice_out(in, len, splice_write_page, sd)) > 0) {
+        pagecache_update(file->node, file->pos, ret);
+        if (file->status == FD_OPENED) {
+            file->pos += ret;
+        }
+        *copied_store = ret, ret = 0;
+    }
+    return ret;
+}
+
+// file_splice - move at most len bytes from fd_in to fd_out, one of which must be a pipe
+int
+file_splice(int fd_in, int fd_out, size_t len, size_t *copied_store) {
+    int ret;
+    struct file *file_in, *file_out;
+    *copied_store = 0;
+    if ((ret = fd2file(fd_in, &file_in)) != 0 || (ret = fd2file(fd_out, &file_out)) != 0) {
+        return ret;
+    }
+    if (!file_in->readable || !file_out->writable) {
+        return -E_INVAL;
+    }
+    struct pipe_state *in = pipe_get_state(file_in->node), *out = pipe_get_state(file_out->node);
+    if ((in == NULL && out == NULL) || in == out) {
+        return -E_INVAL;
+    }
+    filemap_acquire(file_in), filemap_acquire(file_out);
+    if (in != NULL && out != NULL) {
+        ret = splice_pipe_to_pipe(in, out, len, copied_store);
+    }
+    else if (in != NULL) {
+        ret = splice_pipe_to_file(in, file_out, len, copied_store);
+    }
+    else {
+        ret = splice_file_to_pipe(file_in, out, len, copied_store);
+    }
+    filemap_release(file_out), filemap_release(file_in);
+    return ret;
+}
+
+// file_splice_page - put len bytes at offset of page into the pipe fd, which takes over a reference of page
+int
+file_splice_page(int fd, struct Page *page, size_t offset, size_t len) {
+    int ret;
+    struct file *file;
+    if ((ret = fd2file(fd, &file)) != 0) {
+        return ret;
+    }
+    struct pipe_state *state;
+    if (!file->writable || (state = pipe_get_state(file->node)) == NULL) {
+        return -E_INVAL;
+    }
+    filemap_acquire(file);
+    ret = pipe_state_add_page(state, page, offset, len, 0);
+    filemap_release(file);
+    return ret;
+}
+
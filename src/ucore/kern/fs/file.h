@@ -10,6 +10,7 @@
 struct inode;
 struct stat;
 struct dirent;
+struct Page;
 
 struct file {
     enum {
@@ -21,13 +22,45 @@ struct file {
     off_t pos;
     struct inode *node;
     atomic_t open_count;
+    struct fs_struct *fs_struct;        // the fs_struct whose table the file is in
 };
 
-void filemap_init(struct file *filemap);
+#define FILEMAP_CHUNK_SHIFT                 7
+#define FILEMAP_CHUNK_NENTRY                (1 << FILEMAP_CHUNK_SHIFT)      // files in a chunk
+#define FILEMAP_MAX_NENTRY                  8192                            // fds of a process at most
+#define FILEMAP_WORD_NBITS                  (sizeof(uint32_t) * CHAR_BIT)   // fds in a word of used
+
+/* *
+ * filemap - the fd table of a fs_struct.
+ *
+ * The files are allocated in chunks of FILEMAP_CHUNK_NENTRY, which never
+ * move: the table grows by replacing the filemap with a larger one which
+ * takes over the chunks, so a struct file found by fd2file stays valid,
+ * and fd2file reads the table without taking fs_sem. The old filemap is
+ * freed at once, so a walk over the table must read fs_struct->filemap
+ * again after anything which may sleep. used has a bit per fd which is
+ * not FD_NONE, the lowest free fd is found from next_fd a word at a time.
+ * */
+struct filemap {
+    int nentry;                         // # of fds, a multiple of FILEMAP_CHUNK_NENTRY
+    int next_fd;                        // no fd below it is free
+    struct file **chunks;               // the nentry / FILEMAP_CHUNK_NENTRY chunks
+    uint32_t *used;                     // a bit per fd, set if the file is in use
+};
+
+static inline struct file *
+filemap_file(struct filemap *map, int fd) {
+    return map->chunks[fd >> FILEMAP_CHUNK_SHIFT] + (fd & (FILEMAP_CHUNK_NENTRY - 1));
+}
+
+struct filemap *filemap_create(struct fs_struct *fs_struct);
+void filemap_destroy(struct filemap *map);
+int filemap_grow(struct fs_struct *fs_struct, int nentry);
 void filemap_open(struct file *file);
 void filemap_close(struct file *file);
 void filemap_dup(struct file *to, struct file *from);
 bool file_testfd(int fd, bool readable, bool writable);
+int file_getnode(int fd, bool readable, bool writable, struct inode **node_store);
 
 int file_open(char *path, uint32_t open_flags);
 int file_close(int fd);
@@ -36,10 +69,14 @@ int file_write(int fd, void *base, size_t len, size_t *copied_store);
 int file_seek(int fd, off_t pos, int whence);
 int file_fstat(int fd, struct stat *stat);
 int file_fsync(int fd);
+int file_fallocate(int fd, off_t len);
+int file_ioctl(int fd, int op, void *data);
 int file_getdirentry(int fd, struct dirent *dirent);
 int file_dup(int fd1, int fd2);
 int file_pipe(int fd[]);
 int file_mkfifo(const char *name, uint32_t open_flags);
+int file_splice(int fd_in, int fd_out, size_t len, size_t *copied_store);
+int file_splice_page(int fd, struct Page *page, size_t offset, size_t len);
 
 static inline int
 fopen_count(struct file *file) {
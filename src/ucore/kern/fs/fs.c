@@ -7,10 +7,14 @@
 #include <pipe.h>
 #include <sfs.h>
 #include <inode.h>
+#include <bcache.h>
+#include <pagecache.h>
 #include <assert.h>
 
 void
 fs_init(void) {
+    bcache_init();
+    pagecache_init();
     vfs_init();
     dev_init();
     pipe_init();
@@ -34,14 +38,15 @@ unlock_fs(struct fs_struct *fs_struct) {
 
 struct fs_struct *
 fs_create(void) {
-    static_assert((int)FS_STRUCT_NENTRY > 128);
     struct fs_struct *fs_struct;
-    if ((fs_struct = kmalloc(sizeof(struct fs_struct) + FS_STRUCT_BUFSIZE)) != NULL) {
+    if ((fs_struct = kmalloc(sizeof(struct fs_struct))) != NULL) {
         fs_struct->pwd = NULL;
-        fs_struct->filemap = (void *)(fs_struct + 1);
         atomic_set(&(fs_struct->fs_count), 0);
         sem_init(&(fs_struct->fs_sem), 1);
-        filemap_init(fs_struct->filemap);
+        if ((fs_struct->filemap = filemap_create(fs_struct)) == NULL) {
+            kfree(fs_struct);
+            return NULL;
+        }
     }
     return fs_struct;
 }
@@ -53,13 +58,14 @@ fs_destroy(struct fs_struct *fs_struct) {
         vop_ref_dec(fs_struct->pwd);
     }
     int i;
-    struct file *file = fs_struct->filemap;
-    for (i = 0; i < FS_STRUCT_NENTRY; i ++, file ++) {
+    for (i = 0; i < fs_struct->filemap->nentry; i ++) {
+        struct file *file = filemap_file(fs_struct->filemap, i);
         if (file->status == FD_OPENED) {
             filemap_close(file);
         }
         assert(file->status == FD_NONE);
     }
+    filemap_destroy(fs_struct->filemap);
     kfree(fs_struct);
 }
 
@@ -67,8 +73,9 @@ void
 fs_closeall(struct fs_struct *fs_struct) {
     assert(fs_struct != NULL && fs_count(fs_struct) > 0);
     int i;
-    struct file *file = fs_struct->filemap;
-    for (i = 2, file += 2; i < FS_STRUCT_NENTRY; i ++, file ++) {
+    // filemap_close may sleep while another thread grows the table, read it again each time
+    for (i = 2; i < fs_struct->filemap->nentry; i ++) {
+        struct file *file = filemap_file(fs_struct->filemap, i);
         if (file->status == FD_OPENED) {
             filemap_close(file);
         }
@@ -79,14 +86,20 @@ int
 dup_fs(struct fs_struct *to, struct fs_struct *from) {
     assert(to != NULL && from != NULL);
     assert(fs_count(to) == 0 && fs_count(from) > 0);
+    int i, ret;
+    while (to->filemap->nentry < from->filemap->nentry) {
+        if ((ret = filemap_grow(to, from->filemap->nentry)) != 0) {
+            return ret;
+        }
+    }
     if ((to->pwd = from->pwd) != NULL) {
         vop_ref_inc(to->pwd);
     }
-    int i;
-    struct file *to_file = to->filemap, *from_file = from->filemap;
-    for (i = 0; i < FS_STRUCT_NENTRY; i ++, to_file ++, from_file ++) {
+    for (i = 0; i < from->filemap->nentry; i ++) {
+        struct file *to_file = filemap_file(to->filemap, i), *from_file = filemap_file(from->filemap, i);
         if (from_file->status == FD_OPENED) {
             /* alloc_fd first */
+            to->filemap->used[i / FILEMAP_WORD_NBITS] |= (1U << (i % FILEMAP_WORD_NBITS));
             to_file->status = FD_INIT;
             filemap_dup(to_file, from_file);
         }
@@ -16,18 +16,15 @@ void fs_init(void);
 void fs_cleanup(void);
 
 struct inode;
-struct file;
+struct filemap;
 
 struct fs_struct {
     struct inode *pwd;
-    struct file *filemap;
+    struct filemap *filemap;        // the fd table, replaced when it grows, see file.c
     atomic_t fs_count;
     semaphore_t fs_sem;
 };
 
-#define FS_STRUCT_BUFSIZE                       (PGSIZE - sizeof(struct fs_struct))
-#define FS_STRUCT_NENTRY                        (FS_STRUCT_BUFSIZE / sizeof(struct file))
-
 void lock_fs(struct fs_struct *fs_struct);
 void unlock_fs(struct fs_struct *fs_struct);
 
@@ -0,0 +1,276 @@
+#include <types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <slab.h>
+#include <list.h>
+#include <pmm.h>
+#include <sem.h>
+#include <vfs.h>
+#include <inode.h>
+#include <iobuf.h>
+#include <stat.h>
+#include <pagecache.h>
+#include <error.h>
+#include <assert.h>
+
+#define page_hashfn(index)          (hash32(index, PAGECACHE_HASH_SHIFT))
+
+// all page caches, in the order pagecache_reclaim visits them
+static list_entry_t pagecache_list;
+
+void
+pagecache_init(void) {
+    list_init(&pagecache_list);
+}
+
+static struct pagecache *
+pagecache_create(void) {
+    struct pagecache *cache;
+    if ((cache = kmalloc(sizeof(struct pagecache))) != NULL) {
+        int i;
+        for (i = 0; i < PAGECACHE_HASH_SIZE; i ++) {
+            list_init(cache->hash_list + i);
+        }
+        cache->nr_pages = 0;
+        sem_init(&(cache->sem), 1);
+        list_add_before(&pagecache_list, &(cache->cache_link));
+    }
+    return cache;
+}
+
+/* *
+ * pagecache_drop_page - take page out of cache and drop the reference of the
+ * cache. a page still mapped is left to its mappings, and freed when the last
+ * of them is removed.
+ * */
+static void
+pagecache_drop_page(struct pagecache *cache, struct Page *page) {
+    list_del(&(page->page_link));
+    cache->nr_pages --;
+    ClearPageCache(page), ClearPageDirty(page);
+    page->index = 0;
+    if (page_ref_dec(page) == 0) {
+        free_page(page);
+    }
+}
+
+static struct Page *
+lookup_page(struct pagecache *cache, uint32_t index) {
+    list_entry_t *list = cache->hash_list + page_hashfn(index), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct Page *page = le2page(le, page_link);
+        if (page->index == index) {
+            return page;
+        }
+    }
+    return NULL;
+}
+
+// pagecache_rw_page - read or write the file data of page at offset, never beyond the end of file
+static int
+pagecache_rw_page(struct inode *node, struct Page *page, off_t offset, bool write) {
+    int ret;
+    struct stat __stat, *stat = &__stat;
+    if ((ret = vop_fstat(node, stat)) != 0) {
+        return ret;
+    }
+    if (offset >= stat->st_size) {
+        return 0;
+    }
+    size_t len = stat->st_size - offset;
+    if (len > PGSIZE) {
+        len = PGSIZE;
+    }
+    struct iobuf __iob, *iob = iobuf_init(&__iob, page2kva(page), len, offset);
+    return write ? vop_write(node, iob) : vop_read(node, iob);
+}
+
+/* *
+ * pagecache_get_page - find the page at page aligned offset in the cache of
+ * node, read it from the file if not cached. the caller gets a reference of
+ * the page, which keeps it from pagecache_reclaim until the caller has
+ * mapped it, and drops it with pagecache_put_page.
+ * */
+int
+pagecache_get_page(struct inode *node, off_t offset, struct Page **page_store) {
+    assert(offset >= 0 && offset % PGSIZE == 0);
+    struct pagecache *cache;
+    if ((cache = node->in_pagecache) == NULL) {
+        if ((cache = pagecache_create()) == NULL) {
+            return -E_NO_MEM;
+        }
+        node->in_pagecache = cache;
+    }
+
+    int ret = 0;
+    uint32_t index = offset / PGSIZE;
+    struct Page *page;
+    down(&(cache->sem));
+    if ((page = lookup_page(cache, index)) == NULL) {
+        if ((page = alloc_page()) == NULL) {
+            ret = -E_NO_MEM;
+            goto out;
+        }
+        memset(page2kva(page), 0, PGSIZE);
+        if ((ret = pagecache_rw_page(node, page, offset, 0)) != 0) {
+            free_page(page);
+            goto out;
+        }
+        page->index = index;
+        SetPageCache(page);
+        page_ref_inc(page);
+        list_add(cache->hash_list + page_hashfn(index), &(page->page_link));
+        cache->nr_pages ++;
+    }
+    page_ref_inc(page);
+    *page_store = page;
+out:
+    up(&(cache->sem));
+    return ret;
+}
+
+// pagecache_put_page - drop the reference taken by pagecache_get_page
+void
+pagecache_put_page(struct Page *page) {
+    if (page_ref_dec(page) == 0) {
+        free_page(page);
+    }
+}
+
+// pagecache_sync - write back the dirty pages of node
+int
+pagecache_sync(struct inode *node) {
+    struct pagecache *cache;
+    if ((cache = node->in_pagecache) == NULL) {
+        return 0;
+    }
+    int i, ret = 0;
+    down(&(cache->sem));
+    for (i = 0; i < PAGECACHE_HASH_SIZE; i ++) {
+        list_entry_t *list = cache->hash_list + i, *le = list;
+        while ((le = list_next(le)) != list) {
+            struct Page *page = le2page(le, page_link);
+            if (PageDirty(page)) {
+                ClearPageDirty(page);
+                int err;
+                if ((err = pagecache_rw_page(node, page, page->index * PGSIZE, 1)) != 0) {
+                    SetPageDirty(page);
+                    if (ret == 0) {
+                        ret = err;
+                    }
+                }
+            }
+        }
+    }
+    up(&(cache->sem));
+    return ret;
+}
+
+// pagecache_update - reload the cached pages in [offset, offset + len) after the file is written
+void
+pagecache_update(struct inode *node, off_t offset, size_t len) {
+    struct pagecache *cache;
+    if ((cache = node->in_pagecache) == NULL || len == 0) {
+        return;
+    }
+    uint32_t index = offset / PGSIZE, end = (offset + len + PGSIZE - 1) / PGSIZE;
+    down(&(cache->sem));
+    for (; index < end && cache->nr_pages != 0; index ++) {
+        struct Page *page;
+        if ((page = lookup_page(cache, index)) != NULL) {
+            pagecache_rw_page(node, page, index * PGSIZE, 0);
+        }
+    }
+    up(&(cache->sem));
+}
+
+// pagecache_truncate - drop the cached pages past len and zero the tail of the last one, called after node is truncated to len
+void
+pagecache_truncate(struct inode *node, off_t len) {
+    struct pagecache *cache;
+    if ((cache = node->in_pagecache) == NULL) {
+        return;
+    }
+    uint32_t end = (len + PGSIZE - 1) / PGSIZE;
+    int i;
+    down(&(cache->sem));
+    for (i = 0; i < PAGECACHE_HASH_SIZE && cache->nr_pages != 0; i ++) {
+        list_entry_t *list = cache->hash_list + i, *le = list_next(list);
+        while (le != list) {
+            struct Page *page = le2page(le, page_link);
+            le = list_next(le);
+            if (page->index >= end) {
+                pagecache_drop_page(cache, page);
+            }
+        }
+    }
+    struct Page *page;
+    if (len % PGSIZE != 0 && (page = lookup_page(cache, len / PGSIZE)) != NULL) {
+        memset(page2kva(page) + len % PGSIZE, 0, PGSIZE - len % PGSIZE);
+    }
+    up(&(cache->sem));
+}
+
+// pagecache_destroy - write back and free the cache of node, called when node is released
+void
+pagecache_destroy(struct inode *node) {
+    struct pagecache *cache;
+    if ((cache = node->in_pagecache) == NULL) {
+        return;
+    }
+    int ret;
+    if ((ret = pagecache_sync(node)) != 0) {
+        warn("pagecache: write back failed: %e.\n", ret);
+    }
+    int i;
+    for (i = 0; i < PAGECACHE_HASH_SIZE; i ++) {
+        list_entry_t *list = cache->hash_list + i, *le;
+        while ((le = list_next(list)) != list) {
+            struct Page *page = le2page(le, page_link);
+            assert(page_ref(page) == 1);
+            pagecache_drop_page(cache, page);
+        }
+    }
+    list_del(&(cache->cache_link));
+    node->in_pagecache = NULL;
+    kfree(cache);
+}
+
+/* *
+ * pagecache_reclaim - free at most nr_pages clean pages which are not mapped,
+ * visiting the caches from the one after the last visited. a cache in use is
+ * skipped, it may be in the middle of a read or a write back. returns the
+ * number of pages freed.
+ * */
+size_t
+pagecache_reclaim(size_t nr_pages) {
+    size_t free_count = 0;
+    list_entry_t *list = &pagecache_list, *le;
+    int ncaches = 0, i;
+    for (le = list_next(list); le != list; le = list_next(le)) {
+        ncaches ++;
+    }
+    while (ncaches -- > 0 && free_count < nr_pages) {
+        le = list_next(list);
+        list_del(le);
+        list_add_before(list, le);
+        struct pagecache *cache = le2pagecache(le, cache_link);
+        if (cache->nr_pages == 0 || !try_down(&(cache->sem))) {
+            continue ;
+        }
+        for (i = 0; i < PAGECACHE_HASH_SIZE && free_count < nr_pages; i ++) {
+            list_entry_t *hash = cache->hash_list + i, *hle = list_next(hash);
+            while (hle != hash && free_count < nr_pages) {
+                struct Page *page = le2page(hle, page_link);
+                hle = list_next(hle);
+                if (page_ref(page) == 1 && !PageDirty(page)) {
+                    pagecache_drop_page(cache, page);
+                    free_count ++;
+                }
+            }
+        }
+        up(&(cache->sem));
+    }
+    return free_count;
+}
+
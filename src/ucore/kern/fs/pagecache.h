@@ -0,0 +1,49 @@
+#ifndef __KERN_FS_PAGECACHE_H__
+#define __KERN_FS_PAGECACHE_H__
+
+#include <types.h>
+#include <list.h>
+#include <sem.h>
+
+/* *
+ * pagecache - the pages of a file mapped into the user space.
+ *
+ * Each inode mapped by mm_map_file gets a page cache on the first page
+ * fault, the file pages are read into it on demand and shared by all the
+ * mappings of the file, each page holds a reference for the cache. The
+ * pages written through the shared mappings are marked PG_dirty and written
+ * back by pagecache_sync, on fsync or when the inode is released.
+ *
+ * Under memory pressure kswapd unmaps the file pages not accessed since its
+ * last pass (see swap_out_vma), and pagecache_reclaim frees the clean pages
+ * no longer mapped, which are read again on the next fault. The pages past
+ * the end of a truncated file are dropped by pagecache_truncate.
+ * */
+
+#define PAGECACHE_HASH_SHIFT        8
+#define PAGECACHE_HASH_SIZE         (1 << PAGECACHE_HASH_SHIFT)
+
+struct inode;
+struct Page;
+
+struct pagecache {
+    list_entry_t hash_list[PAGECACHE_HASH_SIZE];    // pages linked by page_link, keyed by index
+    size_t nr_pages;                                // number of cached pages
+    semaphore_t sem;                                // lock of the cache
+    list_entry_t cache_link;                        // entry in the list of all caches
+};
+
+#define le2pagecache(le, member)                    \
+    to_struct((le), struct pagecache, member)
+
+void pagecache_init(void);
+int pagecache_get_page(struct inode *node, off_t offset, struct Page **page_store);
+void pagecache_put_page(struct Page *page);
+int pagecache_sync(struct inode *node);
+void pagecache_update(struct inode *node, off_t offset, size_t len);
+void pagecache_truncate(struct inode *node, off_t len);
+void pagecache_destroy(struct inode *node);
+size_t pagecache_reclaim(size_t nr_pages);
+
+#endif /* !__KERN_FS_PAGECACHE_H__ */
+
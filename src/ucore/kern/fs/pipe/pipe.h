@@ -39,6 +39,7 @@ struct pipe_inode {
 struct inode *pipe_create_root(struct fs *fs);
 struct inode *pipe_create_inode(struct fs *fs, const char *name, struct pipe_state *state, bool readonly);
 int pipe_open(struct inode **rnode_store, struct inode **wnode_store);
+struct pipe_state *pipe_get_state(struct inode *node);
 
 #endif /* !__KERN_FS_PIPE_PIPE_H__ */
 
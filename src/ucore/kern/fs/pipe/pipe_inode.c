@@ -1,6 +1,7 @@
 #include <types.h>
 #include <string.h>
 #include <slab.h>
+#include <mmu.h>
 #include <vfs.h>
 #include <inode.h>
 #include <pipe.h>
@@ -109,6 +110,32 @@ pipe_inode_reclaim(struct inode *node) {
     return 0;
 }
 
+/* *
+ * pipe_inode_ioctl - PIPE_IOC_GETSIZE returns the capacity of the pipe in
+ * bytes, PIPE_IOC_SETSIZE resizes it to (size_t)data bytes rounded up to
+ * pages and returns the new capacity.
+ * */
+static int
+pipe_inode_ioctl(struct inode *node, int op, void *data) {
+    struct pipe_inode *pin = vop_info(node, pipe_inode);
+    switch (op) {
+    case PIPE_IOC_GETSIZE:
+        return pipe_state_capacity(pin->state);
+    case PIPE_IOC_SETSIZE: {
+            size_t size = (size_t)data;
+            if (size > PIPE_MAX_PAGES * PGSIZE) {
+                return -E_INVAL;
+            }
+            int ret;
+            if ((ret = pipe_state_resize(pin->state, (size + PGSIZE - 1) / PGSIZE)) != 0) {
+                return ret;
+            }
+            return pipe_state_capacity(pin->state);
+        }
+    }
+    return -E_INVAL;
+}
+
 static int
 pipe_inode_gettype(struct inode *node, uint32_t *type_store) {
     *type_store = S_IFCHR;
@@ -131,10 +158,11 @@ static const struct inode_ops pipe_node_ops = {
     .vop_namefile                   = pipe_inode_namefile,
     .vop_getdirentry                = NULL_VOP_INVAL,
     .vop_reclaim                    = pipe_inode_reclaim,
-    .vop_ioctl                      = NULL_VOP_INVAL,
+    .vop_ioctl                      = pipe_inode_ioctl,
     .vop_gettype                    = pipe_inode_gettype,
     .vop_tryseek                    = NULL_VOP_INVAL,
     .vop_truncate                   = NULL_VOP_INVAL,
+    .vop_fallocate                  = NULL_VOP_INVAL,
     .vop_create                     = NULL_VOP_NOTDIR,
     .vop_unlink                     = NULL_VOP_NOTDIR,
     .vop_lookup                     = NULL_VOP_NOTDIR,
@@ -166,6 +194,15 @@ pipe_create_inode(struct fs *fs, const char *__name, struct pipe_state *state, b
     return NULL;
 }
 
+// pipe_get_state - the pipe_state of node, or NULL if node is not a pipe
+struct pipe_state *
+pipe_get_state(struct inode *node) {
+    if (check_inode_type(node, pipe_inode)) {
+        return vop_info(node, pipe_inode)->state;
+    }
+    return NULL;
+}
+
 int
 pipe_open(struct inode **rnode_store, struct inode **wnode_store) {
     int ret;
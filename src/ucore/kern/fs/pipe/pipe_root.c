@@ -140,6 +140,7 @@ static const struct inode_ops pipe_root_ops = {
     .vop_gettype                    = NULL_VOP_INVAL,
     .vop_tryseek                    = NULL_VOP_INVAL,
     .vop_truncate                   = NULL_VOP_INVAL,
+    .vop_fallocate                  = NULL_VOP_INVAL,
     .vop_create                     = pipe_root_create,
     .vop_unlink                     = NULL_VOP_INVAL,
     .vop_lookup                     = pipe_root_lookup,
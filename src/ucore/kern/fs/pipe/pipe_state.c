@@ -1,7 +1,9 @@
 #include <types.h>
+#include <string.h>
 #include <wait.h>
 #include <slab.h>
 #include <mmu.h>
+#include <pmm.h>
 #include <sync.h>
 #include <proc.h>
 #include <sched.h>
@@ -12,10 +14,27 @@
 #include <error.h>
 #include <assert.h>
 
+/* *
+ * The data of a pipe is kept in a ring of pages. Each slot holds one page
+ * and the range of valid data in it. write and read memcpy whole runs into
+ * or out of the pages, and splice moves pages in or out of the ring without
+ * copying them. A page got from elsewhere (e.g. by vmsplice) is not
+ * mergeable, no more data is appended to it.
+ * */
+
+struct pipe_buffer {
+    struct Page *page;
+    size_t offset;
+    size_t len;
+    bool mergeable;
+};
+
 struct pipe_state {
-    off_t p_rpos;
-    off_t p_wpos;
-    uint8_t *buf;
+    struct pipe_buffer *bufs;       // ring of nr_bufs slots
+    size_t nr_bufs;
+    size_t head;                    // the first slot with data
+    size_t nr_used;                 // number of slots with data
+    size_t size;                    // bytes of data in the pipe
     bool isclosed;
     int ref_count;
     semaphore_t sem;
@@ -23,15 +42,19 @@ struct pipe_state {
     wait_queue_t writer_queue;
 };
 
-#define PIPE_BUFSIZE                            (PGSIZE - sizeof(struct pipe_state))
+#define slot(state, i)                              ((state)->bufs + (((state)->head + (i)) % (state)->nr_bufs))
+#define tail_slot(state)                            slot(state, (state)->nr_used - 1)
 
 struct pipe_state *
 pipe_state_create(void) {
-    static_assert((int)PIPE_BUFSIZE > 128);
     struct pipe_state *state;
-    if ((state = kmalloc(sizeof(struct pipe_state) + PIPE_BUFSIZE)) != NULL) {
-        state->p_rpos = state->p_wpos = 0;
-        state->buf = (uint8_t *)(state + 1);
+    if ((state = kmalloc(sizeof(struct pipe_state))) != NULL) {
+        if ((state->bufs = kmalloc(sizeof(struct pipe_buffer) * PIPE_DEF_PAGES)) == NULL) {
+            kfree(state);
+            return NULL;
+        }
+        state->nr_bufs = PIPE_DEF_PAGES;
+        state->head = state->nr_used = state->size = 0;
         state->isclosed = 0;
         state->ref_count = 1;
         sem_init(&(state->sem), 1);
@@ -53,12 +76,33 @@ unlock_state(struct pipe_state *state) {
 
 static inline bool
 is_empty(struct pipe_state *state) {
-    return state->p_rpos == state->p_wpos;
+    return state->nr_used == 0;
 }
 
 static inline bool
 is_full(struct pipe_state *state) {
-    return state->p_wpos - state->p_rpos >= PIPE_BUFSIZE;
+    return state->nr_used == state->nr_bufs;
+}
+
+// pipe_put_page - drop a reference of page, which may be mapped and swapped by a process as well
+static void
+pipe_put_page(struct Page *page) {
+    if (page_ref_dec(page) == 0 && !PageSwap(page)) {
+        free_page(page);
+    }
+}
+
+// pipe_buffer_consume - drop len bytes at the head of the pipe, and the page if it is empty
+static void
+pipe_buffer_consume(struct pipe_state *state, struct pipe_buffer *buf, size_t len) {
+    assert(buf == slot(state, 0) && len <= buf->len);
+    buf->offset += len, buf->len -= len;
+    state->size -= len;
+    if (buf->len == 0) {
+        pipe_put_page(buf->page);
+        state->head = (state->head + 1) % state->nr_bufs;
+        state->nr_used --;
+    }
 }
 
 static bool
@@ -106,6 +150,11 @@ pipe_state_release(struct pipe_state *state) {
     if (-- state->ref_count == 0) {
         assert(wait_queue_empty(&(state->reader_queue)));
         assert(wait_queue_empty(&(state->writer_queue)));
+        for (; state->nr_used != 0; state->nr_used --) {
+            pipe_put_page(state->bufs[state->head].page);
+            state->head = (state->head + 1) % state->nr_bufs;
+        }
+        kfree(state->bufs);
         kfree(state);
     }
 }
@@ -120,14 +169,56 @@ pipe_state_close(struct pipe_state *state) {
 
 size_t
 pipe_state_size(struct pipe_state *state, bool write) {
-    size_t size = state->p_wpos - state->p_rpos;
     if (write) {
         if (state->isclosed) {
             return 0;
         }
-        return PIPE_BUFSIZE - size;
+        size_t room = (state->nr_bufs - state->nr_used) * PGSIZE;
+        if (!is_empty(state) && tail_slot(state)->mergeable) {
+            struct pipe_buffer *buf = tail_slot(state);
+            room += PGSIZE - (buf->offset + buf->len);
+        }
+        return room;
+    }
+    return state->size;
+}
+
+// pipe_state_capacity - the size of the buffer of pipe in bytes
+size_t
+pipe_state_capacity(struct pipe_state *state) {
+    return state->nr_bufs * PGSIZE;
+}
+
+/* *
+ * pipe_state_resize - change the buffer of pipe to nr_pages pages, fails with
+ * -E_BUSY if the data in the pipe does not fit in.
+ * */
+int
+pipe_state_resize(struct pipe_state *state, size_t nr_pages) {
+    if (nr_pages < PIPE_MIN_PAGES || nr_pages > PIPE_MAX_PAGES) {
+        return -E_INVAL;
+    }
+    struct pipe_buffer *bufs;
+    if ((bufs = kmalloc(sizeof(struct pipe_buffer) * nr_pages)) == NULL) {
+        return -E_NO_MEM;
+    }
+    int ret = -E_BUSY;
+    lock_state(state);
+    if (state->nr_used <= nr_pages) {
+        size_t i;
+        for (i = 0; i < state->nr_used; i ++) {
+            bufs[i] = *slot(state, i);
+        }
+        kfree(state->bufs);
+        state->bufs = bufs, state->nr_bufs = nr_pages, state->head = 0;
+        bufs = NULL, ret = 0;
+        wakeup_writer(state);
+    }
+    unlock_state(state);
+    if (bufs != NULL) {
+        kfree(bufs);
     }
-    return size;
+    return ret;
 }
 
 size_t
@@ -147,8 +238,15 @@ try_again:
             goto try_again;
         }
     }
-    for (; ret < n && !is_empty(state); ret ++, state->p_rpos ++) {
-        *(uint8_t *)(buf + ret) = state->buf[state->p_rpos % PIPE_BUFSIZE];
+    while (ret < n && !is_empty(state)) {
+        struct pipe_buffer *pbuf = slot(state, 0);
+        size_t len = n - ret;
+        if (len > pbuf->len) {
+            len = pbuf->len;
+        }
+        memcpy(buf + ret, page2kva(pbuf->page) + pbuf->offset, len);
+        pipe_buffer_consume(state, pbuf, len);
+        ret += len;
     }
     if (ret != 0) {
         wakeup_writer(state);
@@ -168,18 +266,43 @@ try_again:
     if (state->isclosed) {
         goto out_unlock;
     }
-    for (step = 0; ret < n; ret ++, step ++, state->p_wpos ++) {
-        if (is_full(state)) {
-            wakeup_reader(state);
+    for (step = 0; ret < n; ret += step) {
+        struct pipe_buffer *pbuf;
+        size_t len = n - ret, off;
+        if (!is_empty(state) && (pbuf = tail_slot(state))->mergeable
+                && (off = pbuf->offset + pbuf->len) < PGSIZE) {
+            if (len > PGSIZE - off) {
+                len = PGSIZE - off;
+            }
+        }
+        else if (!is_full(state)) {
+            struct Page *page;
+            if ((page = alloc_page()) == NULL) {
+                break;
+            }
+            page_ref_inc(page);
+            pbuf = slot(state, state->nr_used ++);
+            pbuf->page = page, pbuf->offset = pbuf->len = 0, pbuf->mergeable = 1;
+            off = 0;
+            if (len > PGSIZE) {
+                len = PGSIZE;
+            }
+        }
+        else {
+            if (ret != 0) {
+                wakeup_reader(state);
+            }
             unlock_state(state);
             if (!wait_reader(state)) {
                 goto out;
             }
             goto try_again;
         }
-        state->buf[state->p_wpos % PIPE_BUFSIZE] = *(uint8_t *)(buf + ret);
+        memcpy(page2kva(pbuf->page) + off, buf + ret, len);
+        pbuf->len += len, state->size += len;
+        step = len;
     }
-    if (step != 0) {
+    if (ret != 0) {
         wakeup_reader(state);
     }
 
@@ -189,3 +312,97 @@ out:
     return ret;
 }
 
+/* *
+ * pipe_state_add_page - append len bytes at offset of page to the pipe as
+ * a whole slot, the pipe takes over a reference of page on success. waits
+ * for a free slot unless nonblock is set, in which case -E_AGAIN is
+ * returned if the pipe is full.
+ * */
+int
+pipe_state_add_page(struct pipe_state *state, struct Page *page, size_t offset, size_t len, bool nonblock) {
+    assert(len != 0 && offset + len <= PGSIZE);
+try_again:
+    lock_state(state);
+    if (state->isclosed) {
+        unlock_state(state);
+        return -E_INVAL;
+    }
+    if (is_full(state)) {
+        unlock_state(state);
+        if (nonblock) {
+            return -E_AGAIN;
+        }
+        if (!wait_reader(state)) {
+            return -E_KILLED;
+        }
+        goto try_again;
+    }
+    struct pipe_buffer *pbuf = slot(state, state->nr_used ++);
+    pbuf->page = page, pbuf->offset = offset, pbuf->len = len, pbuf->mergeable = 0;
+    state->size += len;
+    wakeup_reader(state);
+    unlock_state(state);
+    return 0;
+}
+
+// pipe_state_wait_room - wait until the pipe has a free slot, false if the pipe is closed or the wait is interrupted
+bool
+pipe_state_wait_room(struct pipe_state *state) {
+    while (1) {
+        lock_state(state);
+        bool closed = state->isclosed, full = is_full(state);
+        unlock_state(state);
+        if (closed || !full) {
+            return !closed;
+        }
+        if (!wait_reader(state)) {
+            return 0;
+        }
+    }
+}
+
+/* *
+ * pipe_state_splice_out - wait for data in the pipe, then pass the data of
+ * at most n bytes to actor slot by slot, without copying. actor returns the
+ * number of bytes it consumed, or an error. stops at the first short or
+ * failed actor. returns the bytes consumed, or the error if there is none.
+ * */
+int
+pipe_state_splice_out(struct pipe_state *state, size_t n, pipe_actor_t actor, void *arg) {
+    int ret = 0;
+    size_t copied = 0;
+try_again:
+    lock_state(state);
+    if (is_empty(state)) {
+        unlock_state(state);
+        if (state->isclosed) {
+            return 0;
+        }
+        if (!wait_writer(state)) {
+            return -E_KILLED;
+        }
+        goto try_again;
+    }
+    while (copied < n && !is_empty(state)) {
+        struct pipe_buffer *pbuf = slot(state, 0);
+        size_t len = n - copied;
+        if (len > pbuf->len) {
+            len = pbuf->len;
+        }
+        if ((ret = actor(pbuf->page, pbuf->offset, len, arg)) <= 0) {
+            break;
+        }
+        assert(ret <= len);
+        pipe_buffer_consume(state, pbuf, ret);
+        copied += ret;
+        if (ret < len) {
+            break;
+        }
+    }
+    if (copied != 0) {
+        wakeup_writer(state);
+    }
+    unlock_state(state);
+    return (copied != 0) ? copied : ret;
+}
+
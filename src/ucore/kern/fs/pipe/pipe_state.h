@@ -1,7 +1,15 @@
 #ifndef __KERN_FS_PIPE_PIPE_STATE_H__
 #define __KERN_FS_PIPE_PIPE_STATE_H__
 
+#define PIPE_DEF_PAGES                              16          // default capacity of a pipe, in pages
+#define PIPE_MIN_PAGES                              1
+#define PIPE_MAX_PAGES                              256
+
 struct pipe_state;
+struct Page;
+
+// the consumer of pipe_state_splice_out, returns the bytes consumed or an error
+typedef int (*pipe_actor_t)(struct Page *page, size_t offset, size_t len, void *arg);
 
 struct pipe_state *pipe_state_create(void);
 void pipe_state_acquire(struct pipe_state *state);
@@ -9,8 +17,14 @@ void pipe_state_release(struct pipe_state *state);
 void pipe_state_close(struct pipe_state *state);
 
 size_t pipe_state_size(struct pipe_state *state, bool write);
+size_t pipe_state_capacity(struct pipe_state *state);
+int pipe_state_resize(struct pipe_state *state, size_t nr_pages);
 size_t pipe_state_read(struct pipe_state *state, void *buf, size_t n);
 size_t pipe_state_write(struct pipe_state *state, void *buf, size_t n);
 
+int pipe_state_add_page(struct pipe_state *state, struct Page *page, size_t offset, size_t len, bool nonblock);
+bool pipe_state_wait_room(struct pipe_state *state);
+int pipe_state_splice_out(struct pipe_state *state, size_t n, pipe_actor_t actor, void *arg);
+
 #endif /* !__KERN_FS_PIPE_PIPE_STATE_H__ */
 
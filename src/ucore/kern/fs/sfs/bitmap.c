@@ -68,6 +68,65 @@ bitmap_alloc(struct bitmap *bitmap, uint32_t *index_store) {
     return -E_NO_MEM;
 }
 
+// bitmap_free_run - the # of free bits from index on, up to max
+static uint32_t
+bitmap_free_run(struct bitmap *bitmap, uint32_t index, uint32_t max) {
+    uint32_t n = 0;
+    while (n < max && index + n < bitmap->nbits) {
+        if (!(bitmap->map[(index + n) / WORD_BITS] & (1 << ((index + n) % WORD_BITS)))) {
+            break;
+        }
+        n ++;
+    }
+    return n;
+}
+
+/* *
+ * bitmap_alloc_run - allocate up to nbits free bits in a row: the ones from
+ * goal on if goal is free, even if they are fewer than nbits, so that the
+ * caller can extend what ends at goal; or else the first run of nbits found
+ * searching from goal on, or the longest run if there is none that long.
+ * */
+int
+bitmap_alloc_run(struct bitmap *bitmap, uint32_t goal, uint32_t nbits, uint32_t *index_store, uint32_t *nbits_store) {
+    assert(nbits != 0);
+    WORD_TYPE *map = bitmap->map;
+    uint32_t index, len, total = bitmap->nbits, scanned = 0, best = 0, best_len = 0;
+    if ((index = goal) >= total) {
+        index = 0;
+    }
+    else if ((best_len = bitmap_free_run(bitmap, goal, nbits)) != 0) {
+        best = goal;
+        goto found;
+    }
+    while (scanned < total && best_len < nbits) {
+        WORD_TYPE word = map[index / WORD_BITS] >> (index % WORD_BITS);
+        if (word == 0) {
+            len = WORD_BITS - index % WORD_BITS;
+        }
+        else if (!(word & 1)) {
+            len = 1;
+        }
+        else if ((len = bitmap_free_run(bitmap, index, nbits)) > best_len) {
+            best = index, best_len = len;
+        }
+        scanned += len;
+        if ((index += len) >= total) {
+            index = 0;
+        }
+    }
+    if (best_len == 0) {
+        return -E_NO_MEM;
+    }
+
+found:
+    for (index = best; index < best + best_len; index ++) {
+        map[index / WORD_BITS] ^= (1 << (index % WORD_BITS));
+    }
+    *index_store = best, *nbits_store = best_len;
+    return 0;
+}
+
 static void
 bitmap_translate(struct bitmap *bitmap, uint32_t index, WORD_TYPE **word, WORD_TYPE *mask) {
     assert(index < bitmap->nbits);
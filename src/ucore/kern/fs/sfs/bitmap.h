@@ -7,6 +7,7 @@ struct bitmap;
 
 struct bitmap *bitmap_create(uint32_t nbits);
 int bitmap_alloc(struct bitmap *bitmap, uint32_t *index_store);
+int bitmap_alloc_run(struct bitmap *bitmap, uint32_t goal, uint32_t nbits, uint32_t *index_store, uint32_t *nbits_store);
 bool bitmap_test(struct bitmap *bitmap, uint32_t index);
 void bitmap_free(struct bitmap *bitmap, uint32_t index);
 void bitmap_destroy(struct bitmap *bitmap);
@@ -7,7 +7,7 @@
 #include <sem.h>
 #include <unistd.h>
 
-#define SFS_MAGIC                                   0x2f8dbe2a              /* magic number for sfs */
+#define SFS_MAGIC                                   0x2f8dbe2b              /* magic number for sfs, 0x2f8dbe2a before the features */
 #define SFS_BLKSIZE                                 PGSIZE                  /* size of block */
 #define SFS_NDIRECT                                 12                      /* # of direct blocks in inode */
 #define SFS_MAX_INFO_LEN                            31                      /* max length of infomation */
@@ -16,6 +16,8 @@
 #define SFS_BLKN_SUPER                              0                       /* block the superblock lives in */
 #define SFS_BLKN_ROOT                               1                       /* location of the root dir inode */
 #define SFS_BLKN_FREEMAP                            2                       /* 1st block of the freemap */
+#define SFS_RA_MIN                                  4                       /* blocks read ahead at first */
+#define SFS_RA_MAX                                  64                      /* blocks read ahead at most */
 
 /* # of bits in a block */
 #define SFS_BLKBITS                                 (SFS_BLKSIZE * CHAR_BIT)
@@ -31,12 +33,24 @@
 
 /*
  * On-disk superblock
+ *
+ * features has a bit for each change of the on-disk format which a kernel
+ * must know to use the fs: files mapped by extents keep extent records in
+ * direct[], indirect and db_indirect instead of block numbers, and the
+ * hashed indexes of the directories must be kept up to date. A kernel
+ * refuses to mount a fs with a feature it does not know. The old magic is
+ * kept from the kernels older than the features.
  */
+#define SFS_FEATURE_EXTENTS                         0x00000001              /* files are mapped by extents */
+#define SFS_FEATURE_DIRINDEX                        0x00000002              /* directories have hashed indexes */
+#define SFS_FEATURE_SUPP                            (SFS_FEATURE_EXTENTS | SFS_FEATURE_DIRINDEX)
+
 struct sfs_super {
     uint32_t magic;                                 /* magic number, should be SFS_MAGIC */
     uint32_t blocks;                                /* # of blocks in fs */
     uint32_t unused_blocks;                         /* # of unused blocks in fs */
     char info[SFS_MAX_INFO_LEN + 1];                /* infomation for sfs  */
+    uint32_t features;                              /* SFS_FEATURE_* of the fs */
 };
 
 /* inode (on disk) */
@@ -48,8 +62,33 @@ struct sfs_disk_inode {
     uint32_t direct[SFS_NDIRECT];                   /* direct blocks */
     uint32_t indirect;                              /* indirect blocks */
     uint32_t db_indirect;                           /* double indirect blocks */
+    uint32_t dirindex;                              /* root of the hashed index of a directory, 0 if none */
+    uint32_t nextents;                              /* # of extents of a file mapped by extents */
+    uint32_t dirgen;                                /* # of changes to the entries of a directory */
+};
+
+/*
+ * Extents of a file (on disk).
+ *
+ * Regular files are mapped by extents: extent k maps the blocks of the
+ * file from index up to the index of extent k + 1 (up to din->blocks for
+ * the last one) to the disk blocks from blkno on. The first
+ * SFS_NEXTENT_INLINE extents are kept in direct[], the next SFS_BLK_NEXTENT
+ * ones in the block indirect, and the others in the blocks listed in
+ * db_indirect. A file having blocks but no extents is mapped by blocks as
+ * the directories and links are.
+ */
+struct sfs_extent {
+    uint32_t index;                                 /* first block of the file in the extent */
+    uint32_t blkno;                                 /* disk block it is in */
 };
 
+#define SFS_NEXTENT_INLINE                          (SFS_NDIRECT * sizeof(uint32_t) / sizeof(struct sfs_extent))
+#define SFS_BLK_NEXTENT                             (SFS_BLKSIZE / sizeof(struct sfs_extent))
+
+#define sfs_extent_mapped(din)                      \
+    ((din)->type == SFS_TYPE_FILE && ((din)->nextents != 0 || (din)->blocks == 0))
+
 /* file entry (on disk) */
 struct sfs_disk_entry {
     uint32_t ino;                                   /* inode number */
@@ -59,11 +98,50 @@ struct sfs_disk_entry {
 #define sfs_dentry_size                             \
     sizeof(((struct sfs_disk_entry *)0)->name)
 
+/*
+ * Hashed index of a directory (on disk), rooted at din->dirindex.
+ *
+ * The names are hashed to 16 bits and kept in an open addressing table of
+ * nhash blocks of SFS_BLK_NENTRY entries, probed linearly from the hash.
+ * An entry holds the hash in its high half and the slot + 1 of the name in
+ * the low half, 0 if unused. Below the header, the root block keeps a
+ * stack of up to SFS_DIRINDEX_NFREE of the unused slots of the directory.
+ *
+ * Every change to an entry of a directory increases din->dirgen. The index
+ * is only trusted while its gen and size match the ones of the directory,
+ * otherwise it is dropped and built again, so a writer which changed the
+ * entries without updating the index can't make it hide names.
+ */
+#define SFS_DIRINDEX_MAGIC                          0x8e2a1d3c              /* magic number for the index */
+#define SFS_DIRINDEX_NHASH                          64                      /* max # of hash blocks */
+#define SFS_DIRINDEX_MIN_SLOTS                      16                      /* smaller directories are scanned */
+#define SFS_DIRINDEX_MAX_SLOTS                      0xFFFF                  /* larger directories are scanned */
+
+struct sfs_dirindex {
+    uint32_t magic;                                 /* magic number, should be SFS_DIRINDEX_MAGIC */
+    uint32_t size;                                  /* size of the directory when the index was written */
+    uint32_t gen;                                   /* dirgen of the directory when the index was written */
+    uint32_t nhash;                                 /* # of hash blocks, a power of 2 */
+    uint32_t nnames;                                /* # of names in the hash blocks */
+    uint32_t nfree;                                 /* # of unused slots in the directory */
+    uint32_t nstack;                                /* # of them in the stack */
+    uint32_t hash[SFS_DIRINDEX_NHASH];              /* hash blocks */
+};
+
+#define SFS_DIRINDEX_NFREE                          \
+    ((SFS_BLKSIZE - sizeof(struct sfs_dirindex)) / sizeof(uint16_t))
+
 /* inode for sfs */
 struct sfs_inode {
     struct sfs_disk_inode *din;                     /* on-disk inode */
     uint32_t ino;                                   /* inode number */
     bool dirty;                                     /* true if inode modified */
+    uint32_t alloc_goal;                            /* disk block to append to the file next, 0 if unknown */
+    struct sfs_extent ext_cache;                    /* extent found last */
+    uint32_t ext_cache_nblks;                       /* # of blocks of ext_cache, 0 if none */
+    uint32_t ra_next;                               /* block a sequential read starts in */
+    uint32_t ra_end;                                /* first block after the ones read ahead */
+    uint32_t ra_window;                             /* # of blocks to read ahead, 0 if reads are random */
     int reclaim_count;                              /* kill inode if it hits zero */
     semaphore_t sem;                                /* semaphore for din */
     list_entry_t inode_link;                        /* entry for linked-list in sfs_fs */
@@ -79,9 +157,8 @@ struct sfs_fs {
     struct device *dev;                             /* device mounted on */
     struct bitmap *freemap;                         /* blocks in use are mared 0 */
     bool super_dirty;                               /* true if super/freemap modified */
-    void *sfs_buffer;                               /* buffer for non-block aligned io */
+    void *sfs_buffer;                               /* buffer for loading super and freemap */
     semaphore_t fs_sem;                             /* semaphore for fs */
-    semaphore_t io_sem;                             /* semaphore for io */
     semaphore_t mutex_sem;                          /* semaphore for link/unlink and rename */
     list_entry_t inode_list;                        /* inode linked-list */
     list_entry_t *hash_list;                        /* inode hash linked-list */
@@ -105,14 +182,13 @@ void sfs_init(void);
 int sfs_mount(const char *devname);
 
 void lock_sfs_fs(struct sfs_fs *sfs);
-void lock_sfs_io(struct sfs_fs *sfs);
 void lock_sfs_mutex(struct sfs_fs *sfs);
 void unlock_sfs_fs(struct sfs_fs *sfs);
-void unlock_sfs_io(struct sfs_fs *sfs);
 void unlock_sfs_mutex(struct sfs_fs *sfs);
 
 int sfs_rblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks);
 int sfs_wblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks);
+int sfs_rablock(struct sfs_fs *sfs, uint32_t blkno, uint32_t nblks);
 int sfs_rbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset);
 int sfs_wbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset);
 int sfs_sync_super(struct sfs_fs *sfs);
@@ -120,6 +196,7 @@ int sfs_sync_freemap(struct sfs_fs *sfs);
 int sfs_clear_block(struct sfs_fs *sfs, uint32_t blkno, uint32_t nblks);
 
 int sfs_load_inode(struct sfs_fs *sfs, struct inode **node_store, uint32_t ino);
+int sfs_sync_inode(struct sfs_fs *sfs, struct sfs_inode *sin);
 
 #endif /* !__KERN_FS_SFS_SFS_H__ */
 
@@ -9,6 +9,7 @@
 #include <sfs.h>
 #include <inode.h>
 #include <iobuf.h>
+#include <bcache.h>
 #include <bitmap.h>
 #include <error.h>
 #include <assert.h>
@@ -20,8 +21,7 @@ sfs_sync(struct fs *fs) {
     {
         list_entry_t *list = &(sfs->inode_list), *le = list;
         while ((le = list_next(le)) != list) {
-            struct sfs_inode *sin = le2sin(le, inode_link);
-            vop_fsync(info2node(sin, sfs_inode));
+            sfs_sync_inode(sfs, le2sin(le, inode_link));
         }
     }
     unlock_sfs_fs(sfs);
@@ -38,7 +38,7 @@ sfs_sync(struct fs *fs) {
             return ret;
         }
     }
-    return 0;
+    return bcache_sync(sfs->dev);
 }
 
 static struct inode *
@@ -58,6 +58,7 @@ sfs_unmount(struct fs *fs) {
         return -E_BUSY;
     }
     assert(!sfs->super_dirty);
+    bcache_invalidate(sfs->dev);
     bitmap_destroy(sfs->freemap);
     kfree(sfs->sfs_buffer);
     kfree(sfs->hash_list);
@@ -141,6 +142,10 @@ sfs_do_mount(struct device *dev, struct fs **fs_store) {
                 super->magic, SFS_MAGIC);
         goto failed_cleanup_sfs_buffer;
     }
+    if ((super->features & ~SFS_FEATURE_SUPP) != 0) {
+        cprintf("sfs: unsupported features %08x.\n", super->features & ~SFS_FEATURE_SUPP);
+        goto failed_cleanup_sfs_buffer;
+    }
     if (super->blocks > dev->d_blocks) {
         cprintf("sfs: fs has %u blocks, device has %u blocks.\n",
                 super->blocks, dev->d_blocks);
@@ -184,7 +189,6 @@ sfs_do_mount(struct device *dev, struct fs **fs_store) {
     /* and other fields */
     sfs->super_dirty = 0;
     sem_init(&(sfs->fs_sem), 1);
-    sem_init(&(sfs->io_sem), 1);
     sem_init(&(sfs->mutex_sem), 1);
     list_init(&(sfs->inode_list));
     cprintf("sfs: mount: '%s' (%d/%d/%d)\n", sfs->super.info,
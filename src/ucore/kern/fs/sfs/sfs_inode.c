@@ -9,6 +9,8 @@
 #include <sfs.h>
 #include <inode.h>
 #include <iobuf.h>
+#include <bcache.h>
+#include <dcache.h>
 #include <bitmap.h>
 #include <error.h>
 #include <assert.h>
@@ -88,6 +90,8 @@ sfs_create_inode(struct sfs_fs *sfs, struct sfs_disk_inode *din, uint32_t ino, s
         vop_init(node, sfs_get_ops(din->type), info2fs(sfs, sfs));
         struct sfs_inode *sin = vop_info(node, sfs_inode);
         sin->din = din, sin->ino = ino, sin->dirty = 0, sin->reclaim_count = 1;
+        sin->alloc_goal = 0, sin->ext_cache_nblks = 0;
+        sin->ra_next = sin->ra_end = sin->ra_window = 0;
         sem_init(&(sin->sem), 1);
         *node_store = node;
         return 0;
@@ -302,14 +306,237 @@ sfs_bmap_free_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index)
     return 0;
 }
 
+/* *
+ * sfs_block_alloc_run - allocate up to nblks disk blocks in a row, from goal
+ * on if goal is free, see bitmap_alloc_run.
+ * */
+static int
+sfs_block_alloc_run(struct sfs_fs *sfs, uint32_t goal, uint32_t nblks, uint32_t *ino_store, uint32_t *nblks_store) {
+    int ret;
+    if ((ret = bitmap_alloc_run(sfs->freemap, goal, nblks, ino_store, nblks_store)) != 0) {
+        return ret;
+    }
+    assert(sfs->super.unused_blocks >= *nblks_store);
+    sfs->super.unused_blocks -= *nblks_store, sfs->super_dirty = 1;
+    assert(sfs_block_inuse(sfs, *ino_store));
+    return sfs_clear_block(sfs, *ino_store, *nblks_store);
+}
+
+// sfs_extent_rw_nolock - read or write extent pos of sin, the blocks to keep it are allocated on write
+static int
+sfs_extent_rw_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t pos, struct sfs_extent *ext, bool write) {
+    static_assert(SFS_NEXTENT_INLINE * sizeof(struct sfs_extent) <= sizeof(sin->din->direct));
+    struct sfs_disk_inode *din = sin->din;
+    if (pos < SFS_NEXTENT_INLINE) {
+        struct sfs_extent *inline_ext = (struct sfs_extent *)(din->direct) + pos;
+        if (write) {
+            *inline_ext = *ext, sin->dirty = 1;
+        }
+        else {
+            *ext = *inline_ext;
+        }
+        return 0;
+    }
+
+    int ret;
+    uint32_t ent;
+    pos -= SFS_NEXTENT_INLINE;
+    if (pos < SFS_BLK_NEXTENT) {
+        if ((ent = din->indirect) == 0) {
+            assert(write);
+            if ((ret = sfs_block_alloc(sfs, &ent)) != 0) {
+                return ret;
+            }
+            din->indirect = ent, sin->dirty = 1;
+        }
+    }
+    else {
+        pos -= SFS_BLK_NEXTENT;
+        if (pos / SFS_BLK_NEXTENT >= SFS_BLK_NENTRY) {
+            return -E_TOO_BIG;
+        }
+        uint32_t db_ent = din->db_indirect;
+        if ((ret = sfs_bmap_get_sub_nolock(sfs, &db_ent, pos / SFS_BLK_NEXTENT, write, &ent)) != 0) {
+            return ret;
+        }
+        if (db_ent != din->db_indirect) {
+            assert(din->db_indirect == 0);
+            din->db_indirect = db_ent, sin->dirty = 1;
+        }
+        assert(ent != 0);
+        pos %= SFS_BLK_NEXTENT;
+    }
+    if (write) {
+        return sfs_wbuf(sfs, ext, sizeof(struct sfs_extent), ent, pos * sizeof(struct sfs_extent));
+    }
+    return sfs_rbuf(sfs, ext, sizeof(struct sfs_extent), ent, pos * sizeof(struct sfs_extent));
+}
+
+// sfs_extent_release_nolock - extent pos of sin is gone, free the block keeping it if it was the first one there
+static int
+sfs_extent_release_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t pos) {
+    struct sfs_disk_inode *din = sin->din;
+    int ret, i;
+    if (pos == SFS_NEXTENT_INLINE) {
+        if (din->indirect != 0) {
+            sfs_block_free(sfs, din->indirect);
+            din->indirect = 0, sin->dirty = 1;
+        }
+    }
+    else if (pos >= SFS_NEXTENT_INLINE + SFS_BLK_NEXTENT) {
+        pos -= SFS_NEXTENT_INLINE + SFS_BLK_NEXTENT;
+        if (pos % SFS_BLK_NEXTENT != 0) {
+            return 0;
+        }
+        if ((ret = sfs_bmap_free_sub_nolock(sfs, din->db_indirect, pos / SFS_BLK_NEXTENT)) != 0) {
+            return ret;
+        }
+        if (pos == 0) {
+            // a file once mapped by blocks may have left more of them
+            for (i = 1; i < SFS_BLK_NENTRY; i ++) {
+                if ((ret = sfs_bmap_free_sub_nolock(sfs, din->db_indirect, i)) != 0) {
+                    return ret;
+                }
+            }
+            sfs_block_free(sfs, din->db_indirect);
+            din->db_indirect = 0, sin->dirty = 1;
+        }
+    }
+    return 0;
+}
+
+/* *
+ * sfs_extent_lookup_nolock - find the extent of sin holding block index of
+ * the file with a binary search, store its disk block, and the # of blocks
+ * of the extent from it on if nblks_store is not NULL. sequential accesses
+ * mostly hit sin->ext_cache.
+ * */
+static int
+sfs_extent_lookup_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, uint32_t *ino_store, uint32_t *nblks_store) {
+    struct sfs_disk_inode *din = sin->din;
+    struct sfs_extent *cache = &(sin->ext_cache);
+    assert(index < din->blocks && din->nextents != 0);
+    if (index - cache->index >= sin->ext_cache_nblks) {
+        struct sfs_extent ext;
+        uint32_t lo = 0, hi = din->nextents, mid, end = din->blocks;
+        int ret;
+        while (hi - lo > 1) {
+            mid = (lo + hi) / 2;
+            if ((ret = sfs_extent_rw_nolock(sfs, sin, mid, &ext, 0)) != 0) {
+                return ret;
+            }
+            if (ext.index <= index) {
+                lo = mid;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        if (lo + 1 < din->nextents) {
+            if ((ret = sfs_extent_rw_nolock(sfs, sin, lo + 1, &ext, 0)) != 0) {
+                return ret;
+            }
+            end = ext.index;
+        }
+        sin->ext_cache_nblks = 0;
+        if ((ret = sfs_extent_rw_nolock(sfs, sin, lo, cache, 0)) != 0) {
+            return ret;
+        }
+        assert(cache->index <= index && index < end);
+        sin->ext_cache_nblks = end - cache->index;
+    }
+    *ino_store = cache->blkno + (index - cache->index);
+    if (nblks_store != NULL) {
+        *nblks_store = sin->ext_cache_nblks - (index - cache->index);
+    }
+    return 0;
+}
+
+/* *
+ * sfs_extent_append_nolock - allocate up to nblks disk blocks in a row for
+ * the end of the file, after its last block if they are free, or else near
+ * its inode for an empty file, or anywhere a run of nblks is free. the
+ * caller adds the # of blocks got to din->blocks.
+ * */
+static int
+sfs_extent_append_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t nblks, uint32_t *ino_store, uint32_t *nblks_store) {
+    struct sfs_disk_inode *din = sin->din;
+    uint32_t goal, ino, n, pos = din->nextents;
+    int ret;
+    if ((goal = sin->alloc_goal) == 0) {
+        goal = sin->ino + 1;
+        if (pos != 0) {
+            if ((ret = sfs_extent_lookup_nolock(sfs, sin, din->blocks - 1, &ino, NULL)) != 0) {
+                return ret;
+            }
+            goal = ino + 1;
+        }
+    }
+    if ((ret = sfs_block_alloc_run(sfs, goal, nblks, &ino, &n)) != 0) {
+        return ret;
+    }
+    if (pos != 0 && ino == goal) {
+        if (sin->ext_cache_nblks != 0 && sin->ext_cache.index + sin->ext_cache_nblks == din->blocks) {
+            sin->ext_cache_nblks += n;
+        }
+    }
+    else {
+        struct sfs_extent ext = {din->blocks, ino};
+        if ((ret = sfs_extent_rw_nolock(sfs, sin, pos, &ext, 1)) != 0) {
+            while (n != 0) {
+                sfs_block_free(sfs, ino + (-- n));
+            }
+            return ret;
+        }
+        din->nextents ++, sin->dirty = 1;
+        sin->ext_cache = ext, sin->ext_cache_nblks = n;
+    }
+    sin->alloc_goal = ino + n;
+    *ino_store = ino, *nblks_store = n;
+    return 0;
+}
+
+// sfs_extent_truncate_nolock - free the last block of the file, and its extent if nothing else is left in it
+static int
+sfs_extent_truncate_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
+    struct sfs_disk_inode *din = sin->din;
+    uint32_t pos = din->nextents - 1, index = din->blocks - 1;
+    struct sfs_extent ext;
+    int ret;
+    assert(din->nextents != 0);
+    if ((ret = sfs_extent_rw_nolock(sfs, sin, pos, &ext, 0)) != 0) {
+        return ret;
+    }
+    if (ext.index == index) {
+        if ((ret = sfs_extent_release_nolock(sfs, sin, pos)) != 0) {
+            return ret;
+        }
+        din->nextents = pos, sin->dirty = 1;
+    }
+    sfs_block_free(sfs, ext.blkno + (index - ext.index));
+    sin->alloc_goal = 0, sin->ext_cache_nblks = 0;
+    return 0;
+}
+
 static int
 sfs_bmap_load_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, uint32_t *ino_store) {
     struct sfs_disk_inode *din = sin->din;
     assert(index <= din->blocks);
     int ret;
-    uint32_t ino;
+    uint32_t ino, nblks;
     bool create = (index == din->blocks);
-    if ((ret = sfs_bmap_get_nolock(sfs, sin, index, create, &ino)) != 0) {
+    if (sfs_extent_mapped(din)) {
+        if (create) {
+            ret = sfs_extent_append_nolock(sfs, sin, 1, &ino, &nblks);
+        }
+        else {
+            ret = sfs_extent_lookup_nolock(sfs, sin, index, &ino, NULL);
+        }
+    }
+    else {
+        ret = sfs_bmap_get_nolock(sfs, sin, index, create, &ino);
+    }
+    if (ret != 0) {
         return ret;
     }
     assert(sfs_block_inuse(sfs, ino));
@@ -327,7 +554,13 @@ sfs_bmap_truncate_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
     struct sfs_disk_inode *din = sin->din;
     assert(din->blocks != 0);
     int ret;
-    if ((ret = sfs_bmap_free_nolock(sfs, sin, din->blocks - 1)) != 0) {
+    if (sfs_extent_mapped(din)) {
+        ret = sfs_extent_truncate_nolock(sfs, sin);
+    }
+    else {
+        ret = sfs_bmap_free_nolock(sfs, sin, din->blocks - 1);
+    }
+    if (ret != 0) {
         return ret;
     }
     din->blocks --;
@@ -335,6 +568,41 @@ sfs_bmap_truncate_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
     return 0;
 }
 
+/* *
+ * sfs_bmap_grow_nolock - append blocks to sin up to nblks, a file mapped by
+ * extents gets them in as few runs as the free blocks allow.
+ * */
+static int
+sfs_bmap_grow_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t nblks) {
+    struct sfs_disk_inode *din = sin->din;
+    int ret;
+    uint32_t ino, n;
+    while (din->blocks < nblks) {
+        if (sfs_extent_mapped(din)) {
+            if ((ret = sfs_extent_append_nolock(sfs, sin, nblks - din->blocks, &ino, &n)) != 0) {
+                return ret;
+            }
+            din->blocks += n, sin->dirty = 1;
+        }
+        else if ((ret = sfs_bmap_load_nolock(sfs, sin, din->blocks, NULL)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+// sfs_bmap_trim_nolock - free the blocks of sin past its size
+static int
+sfs_bmap_trim_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
+    int ret;
+    while (sin->din->blocks > ROUNDUP_DIV(sin->din->size, SFS_BLKSIZE)) {
+        if ((ret = sfs_bmap_truncate_nolock(sfs, sin)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
 static int
 sfs_dirent_read_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, struct sfs_disk_entry *entry) {
     assert(sin->din->type == SFS_TYPE_DIR && (slot >= 0 && slot < sin->din->blocks));
@@ -369,15 +637,433 @@ sfs_dirent_write_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, uin
         goto out;
     }
     assert(sfs_block_inuse(sfs, ino));
-    ret = sfs_wbuf(sfs, entry, sizeof(struct sfs_disk_entry), ino, 0);
+    if ((ret = sfs_wbuf(sfs, entry, sizeof(struct sfs_disk_entry), ino, 0)) == 0) {
+        sin->din->dirgen ++, sin->dirty = 1;
+    }
 out:
     kfree(entry);
     return ret;
 }
 
+/* *
+ * sfs_dirindex_hash - the 16 bits hash of a name in the index of a directory,
+ * tools/mksfs.c hashes the names the same way.
+ * */
+static uint16_t
+sfs_dirindex_hash(const char *name) {
+    uint32_t hash = 2166136261U;
+    while (*name != '\0') {
+        hash = (hash ^ (unsigned char)(*name ++)) * 16777619U;
+    }
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+#define sfs_dirindex_entry(hash, slot)              (((uint32_t)(hash) << 16) | ((slot) + 1))
+#define sfs_dirindex_entry_hash(ent)                ((ent) >> 16)
+#define sfs_dirindex_entry_slot(ent)                ((int)((ent) & 0xFFFF) - 1)
+#define sfs_dirindex_mask(idx)                      ((idx)->nhash * SFS_BLK_NENTRY - 1)
+#define sfs_dirindex_stack(i)                       (sizeof(struct sfs_dirindex) + (i) * sizeof(uint16_t))
+
 static int
-sfs_dirent_link_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, struct sfs_inode *lnksin, const char *name) {
+sfs_dirindex_rent(struct sfs_fs *sfs, struct sfs_dirindex *idx, uint32_t i, uint32_t *entp) {
+    uint32_t blkno = idx->hash[i / SFS_BLK_NENTRY];
+    return sfs_rbuf(sfs, entp, sizeof(uint32_t), blkno, (i % SFS_BLK_NENTRY) * sizeof(uint32_t));
+}
+
+static int
+sfs_dirindex_went(struct sfs_fs *sfs, struct sfs_dirindex *idx, uint32_t i, uint32_t ent) {
+    uint32_t blkno = idx->hash[i / SFS_BLK_NENTRY];
+    return sfs_wbuf(sfs, &ent, sizeof(uint32_t), blkno, (i % SFS_BLK_NENTRY) * sizeof(uint32_t));
+}
+
+// sfs_dirindex_free_nolock - free the blocks of idx, the index of sin, and let sin be scanned
+static void
+sfs_dirindex_free_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx) {
+    uint32_t i, blkno;
+    for (i = 0; i < SFS_DIRINDEX_NHASH && i < idx->nhash; i ++) {
+        if ((blkno = idx->hash[i]) != 0 && blkno < sfs->super.blocks && sfs_block_inuse(sfs, blkno)) {
+            sfs_block_free(sfs, blkno);
+        }
+    }
+    sfs_block_free(sfs, sin->din->dirindex);
+    sin->din->dirindex = 0, sin->dirty = 1;
+}
+
+// sfs_dirindex_drop_nolock - free the index of sin as found on disk
+static void
+sfs_dirindex_drop_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
+    struct sfs_dirindex idx;
+    if (sfs_rbuf(sfs, &idx, sizeof(struct sfs_dirindex), sin->din->dirindex, 0) != 0
+            || idx.magic != SFS_DIRINDEX_MAGIC) {
+        idx.nhash = 0;
+    }
+    sfs_dirindex_free_nolock(sfs, sin, &idx);
+}
+
+static int sfs_dirindex_build_nolock(struct sfs_fs *sfs, struct sfs_inode *sin);
+
+/* *
+ * sfs_dirindex_load_nolock - read the header of the index of sin, returns
+ * -E_NOENT if sin has no index. an index left out of date by a change to
+ * the entries which did not update it is dropped and built again.
+ * */
+static int
+sfs_dirindex_load_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx) {
+    struct sfs_disk_inode *din = sin->din;
+    if (din->dirindex == 0) {
+        return -E_NOENT;
+    }
     int ret;
+    if ((ret = sfs_rbuf(sfs, idx, sizeof(struct sfs_dirindex), din->dirindex, 0)) != 0) {
+        return ret;
+    }
+    if (idx->magic != SFS_DIRINDEX_MAGIC || idx->size != din->size || idx->gen != din->dirgen) {
+        sfs_dirindex_drop_nolock(sfs, sin);
+        if (din->blocks < SFS_DIRINDEX_MIN_SLOTS || sfs_dirindex_build_nolock(sfs, sin) != 0) {
+            return -E_NOENT;
+        }
+        return sfs_rbuf(sfs, idx, sizeof(struct sfs_dirindex), din->dirindex, 0);
+    }
+    return 0;
+}
+
+static int
+sfs_dirindex_save_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx) {
+    idx->size = sin->din->size, idx->gen = sin->din->dirgen;
+    return sfs_wbuf(sfs, idx, sizeof(struct sfs_dirindex), sin->din->dirindex, 0);
+}
+
+// sfs_dirindex_lookup_nolock - find the slot of name with the index, entry is used as the buffer
+static int
+sfs_dirindex_lookup_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx,
+        const char *name, struct sfs_disk_entry *entry, int *slot_store) {
+    uint16_t hash = sfs_dirindex_hash(name);
+    uint32_t mask = sfs_dirindex_mask(idx), i = hash & mask, n, ent;
+    int ret, slot;
+    for (n = 0; n <= mask; n ++, i = (i + 1) & mask) {
+        if ((ret = sfs_dirindex_rent(sfs, idx, i, &ent)) != 0) {
+            return ret;
+        }
+        if (ent == 0) {
+            break;
+        }
+        if (sfs_dirindex_entry_hash(ent) != hash || (slot = sfs_dirindex_entry_slot(ent)) >= sin->din->blocks) {
+            continue ;
+        }
+        if ((ret = sfs_dirent_read_nolock(sfs, sin, slot, entry)) != 0) {
+            return ret;
+        }
+        if (entry->ino != 0 && strcmp(name, entry->name) == 0) {
+            *slot_store = slot;
+            return 0;
+        }
+    }
+    return -E_NOENT;
+}
+
+static int
+sfs_dirindex_insert_nolock(struct sfs_fs *sfs, struct sfs_dirindex *idx, uint32_t ent) {
+    uint32_t mask = sfs_dirindex_mask(idx), i = sfs_dirindex_entry_hash(ent) & mask, n, cur;
+    int ret;
+    for (n = 0; n <= mask; n ++, i = (i + 1) & mask) {
+        if ((ret = sfs_dirindex_rent(sfs, idx, i, &cur)) != 0) {
+            return ret;
+        }
+        if (cur == 0) {
+            if ((ret = sfs_dirindex_went(sfs, idx, i, ent)) == 0) {
+                idx->nnames ++;
+            }
+            return ret;
+        }
+    }
+    return -E_NO_MEM;
+}
+
+/* *
+ * sfs_dirindex_remove_nolock - remove entry ent from the table, the entries
+ * after it are shifted back so that no probe stops at the hole.
+ * */
+static int
+sfs_dirindex_remove_nolock(struct sfs_fs *sfs, struct sfs_dirindex *idx, uint32_t ent) {
+    uint32_t mask = sfs_dirindex_mask(idx), i = sfs_dirindex_entry_hash(ent) & mask, j, n, cur;
+    int ret;
+    for (n = 0; ; n ++, i = (i + 1) & mask) {
+        if (n > mask) {
+            return -E_NOENT;
+        }
+        if ((ret = sfs_dirindex_rent(sfs, idx, i, &cur)) != 0) {
+            return ret;
+        }
+        if (cur == 0) {
+            return -E_NOENT;
+        }
+        if (cur == ent) {
+            break;
+        }
+    }
+    for (j = (i + 1) & mask; j != i; j = (j + 1) & mask) {
+        if ((ret = sfs_dirindex_rent(sfs, idx, j, &cur)) != 0) {
+            return ret;
+        }
+        if (cur == 0) {
+            break;
+        }
+        // cur may fill the hole unless its home is between the hole and j
+        uint32_t home = sfs_dirindex_entry_hash(cur) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            if ((ret = sfs_dirindex_went(sfs, idx, i, cur)) != 0) {
+                return ret;
+            }
+            i = j;
+        }
+    }
+    if ((ret = sfs_dirindex_went(sfs, idx, i, 0)) == 0) {
+        idx->nnames --;
+    }
+    return ret;
+}
+
+// sfs_dirindex_grow_nolock - double the hash blocks of the index, and move the entries
+static int
+sfs_dirindex_grow_nolock(struct sfs_fs *sfs, struct sfs_dirindex *idx) {
+    uint32_t *buf;
+    if ((buf = kmalloc(SFS_BLKSIZE)) == NULL) {
+        return -E_NO_MEM;
+    }
+
+    struct sfs_dirindex old = *idx;
+    uint32_t i, j;
+    int ret;
+    memset(idx->hash, 0, sizeof(idx->hash));
+    idx->nhash = old.nhash * 2, idx->nnames = 0;
+    for (i = 0; i < idx->nhash; i ++) {
+        if ((ret = sfs_block_alloc(sfs, idx->hash + i)) != 0) {
+            goto failed_cleanup;
+        }
+    }
+    for (i = 0; i < old.nhash; i ++) {
+        if ((ret = sfs_rblock(sfs, buf, old.hash[i], 1)) != 0) {
+            goto failed_cleanup;
+        }
+        for (j = 0; j < SFS_BLK_NENTRY; j ++) {
+            if (buf[j] != 0 && (ret = sfs_dirindex_insert_nolock(sfs, idx, buf[j])) != 0) {
+                goto failed_cleanup;
+            }
+        }
+    }
+    for (i = 0; i < old.nhash; i ++) {
+        sfs_block_free(sfs, old.hash[i]);
+    }
+    kfree(buf);
+    return 0;
+
+failed_cleanup:
+    for (i = 0; i < idx->nhash; i ++) {
+        if (idx->hash[i] != 0) {
+            sfs_block_free(sfs, idx->hash[i]);
+        }
+    }
+    *idx = old;
+    kfree(buf);
+    return ret;
+}
+
+static int
+sfs_dirindex_push_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx, int slot) {
+    idx->nfree ++;
+    if (idx->nstack < SFS_DIRINDEX_NFREE) {
+        uint16_t s = slot;
+        idx->nstack ++;
+        return sfs_wbuf(sfs, &s, sizeof(uint16_t), sin->din->dirindex, sfs_dirindex_stack(idx->nstack - 1));
+    }
+    return 0;
+}
+
+/* *
+ * sfs_dirindex_free_slot_nolock - an unused slot of the directory, or the
+ * slot after the last one if there is none. the stack is refilled with a
+ * scan of the directory when it runs out.
+ * */
+static int
+sfs_dirindex_free_slot_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx,
+        struct sfs_disk_entry *entry, int *slot_store) {
+    int ret, slot, nslots = sin->din->blocks;
+    uint16_t s;
+    if (idx->nfree != 0 && idx->nstack == 0) {
+        idx->nfree = 0;
+        for (slot = nslots - 1; slot >= 0; slot --) {
+            if ((ret = sfs_dirent_read_nolock(sfs, sin, slot, entry)) != 0) {
+                return ret;
+            }
+            if (entry->ino == 0 && (ret = sfs_dirindex_push_nolock(sfs, sin, idx, slot)) != 0) {
+                return ret;
+            }
+        }
+        if ((ret = sfs_dirindex_save_nolock(sfs, sin, idx)) != 0) {
+            return ret;
+        }
+    }
+    while (idx->nstack != 0) {
+        if ((ret = sfs_rbuf(sfs, &s, sizeof(uint16_t), sin->din->dirindex, sfs_dirindex_stack(idx->nstack - 1))) != 0) {
+            return ret;
+        }
+        if ((slot = s) < nslots) {
+            if ((ret = sfs_dirent_read_nolock(sfs, sin, slot, entry)) != 0) {
+                return ret;
+            }
+            if (entry->ino == 0) {
+                *slot_store = slot;
+                return 0;
+            }
+        }
+        // not free any more, forget it
+        idx->nstack --, idx->nfree --;
+        if ((ret = sfs_dirindex_save_nolock(sfs, sin, idx)) != 0) {
+            return ret;
+        }
+    }
+    *slot_store = nslots;
+    return 0;
+}
+
+// sfs_dirindex_take_slot_nolock - slot of the stack is in use now
+static int
+sfs_dirindex_take_slot_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx, int slot) {
+    int ret, i;
+    uint16_t s;
+    idx->nfree --;
+    for (i = idx->nstack - 1; i >= 0; i --) {
+        if ((ret = sfs_rbuf(sfs, &s, sizeof(uint16_t), sin->din->dirindex, sfs_dirindex_stack(i))) != 0) {
+            return ret;
+        }
+        if (s == slot) {
+            if (i != idx->nstack - 1) {
+                if ((ret = sfs_rbuf(sfs, &s, sizeof(uint16_t), sin->din->dirindex, sfs_dirindex_stack(idx->nstack - 1))) != 0) {
+                    return ret;
+                }
+                if ((ret = sfs_wbuf(sfs, &s, sizeof(uint16_t), sin->din->dirindex, sfs_dirindex_stack(i))) != 0) {
+                    return ret;
+                }
+            }
+            idx->nstack --;
+            break;
+        }
+    }
+    return 0;
+}
+
+// sfs_dirindex_link_nolock - add name in slot to the index, slot was a free one unless append
+static int
+sfs_dirindex_link_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx,
+        int slot, const char *name, bool append) {
+    int ret;
+    if (slot >= SFS_DIRINDEX_MAX_SLOTS) {
+        return -E_TOO_BIG;
+    }
+    if (!append && (ret = sfs_dirindex_take_slot_nolock(sfs, sin, idx, slot)) != 0) {
+        return ret;
+    }
+    if ((idx->nnames + 1) * 4 > idx->nhash * SFS_BLK_NENTRY * 3 && idx->nhash < SFS_DIRINDEX_NHASH) {
+        if ((ret = sfs_dirindex_grow_nolock(sfs, idx)) != 0) {
+            return ret;
+        }
+    }
+    if ((ret = sfs_dirindex_insert_nolock(sfs, idx, sfs_dirindex_entry(sfs_dirindex_hash(name), slot))) != 0) {
+        return ret;
+    }
+    return sfs_dirindex_save_nolock(sfs, sin, idx);
+}
+
+// sfs_dirindex_unlink_nolock - remove name in slot from the index, slot is free now
+static int
+sfs_dirindex_unlink_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, struct sfs_dirindex *idx,
+        int slot, const char *name) {
+    int ret;
+    if ((ret = sfs_dirindex_remove_nolock(sfs, idx, sfs_dirindex_entry(sfs_dirindex_hash(name), slot))) != 0) {
+        return ret;
+    }
+    if ((ret = sfs_dirindex_push_nolock(sfs, sin, idx, slot)) != 0) {
+        return ret;
+    }
+    return sfs_dirindex_save_nolock(sfs, sin, idx);
+}
+
+/* *
+ * sfs_dirindex_build_nolock - index the names of a directory grown to
+ * SFS_DIRINDEX_MIN_SLOTS slots, or whose index was dropped.
+ * */
+static int
+sfs_dirindex_build_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
+    struct sfs_disk_inode *din = sin->din;
+    int ret, slot, nslots = din->blocks;
+    assert(din->dirindex == 0);
+    if (nslots >= SFS_DIRINDEX_MAX_SLOTS) {
+        return -E_TOO_BIG;
+    }
+
+    struct sfs_disk_entry *entry;
+    if ((entry = kmalloc(sizeof(struct sfs_disk_entry))) == NULL) {
+        return -E_NO_MEM;
+    }
+
+    struct sfs_dirindex idx;
+    memset(&idx, 0, sizeof(struct sfs_dirindex));
+    idx.magic = SFS_DIRINDEX_MAGIC, idx.nhash = 1;
+    while (nslots * 4 > idx.nhash * SFS_BLK_NENTRY * 3 && idx.nhash < SFS_DIRINDEX_NHASH) {
+        idx.nhash *= 2;
+    }
+
+    if ((ret = sfs_block_alloc(sfs, &(din->dirindex))) != 0) {
+        goto out;
+    }
+    sin->dirty = 1;
+
+    uint32_t i;
+    for (i = 0; i < idx.nhash; i ++) {
+        if ((ret = sfs_block_alloc(sfs, idx.hash + i)) != 0) {
+            goto failed_cleanup;
+        }
+    }
+    for (slot = nslots - 1; slot >= 0; slot --) {
+        if ((ret = sfs_dirent_read_nolock(sfs, sin, slot, entry)) != 0) {
+            goto failed_cleanup;
+        }
+        if (entry->ino == 0) {
+            ret = sfs_dirindex_push_nolock(sfs, sin, &idx, slot);
+        }
+        else {
+            ret = sfs_dirindex_insert_nolock(sfs, &idx, sfs_dirindex_entry(sfs_dirindex_hash(entry->name), slot));
+        }
+        if (ret != 0) {
+            goto failed_cleanup;
+        }
+    }
+    if ((ret = sfs_dirindex_save_nolock(sfs, sin, &idx)) != 0) {
+        goto failed_cleanup;
+    }
+
+out:
+    kfree(entry);
+    return ret;
+
+failed_cleanup:
+    sfs_dirindex_free_nolock(sfs, sin, &idx);
+    goto out;
+}
+
+/* *
+ * sfs_dirent_link_nolock - link lnksin as name in slot of sin, and keep the
+ * index of sin up to date. a failure of the index only drops it, the
+ * directory is scanned again then.
+ * */
+static int
+sfs_dirent_link_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, struct sfs_inode *lnksin, const char *name) {
+    struct sfs_dirindex idx;
+    bool append = (slot == sin->din->blocks);
+    int ret, index;
+    if ((index = sfs_dirindex_load_nolock(sfs, sin, &idx)) != 0 && index != -E_NOENT) {
+        return index;
+    }
     if ((ret = sfs_dirent_write_nolock(sfs, sin, slot, lnksin->ino, name)) != 0) {
         return ret;
     }
@@ -385,20 +1071,71 @@ sfs_dirent_link_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, stru
     sin->dirty = 1;
     lnksin->din->nlinks ++;
     lnksin->dirty = 1;
+    dcache_invalidate(info2node(sin, sfs_inode), name);
+    if (index == 0) {
+        if (sfs_dirindex_link_nolock(sfs, sin, &idx, slot, name, append) != 0) {
+            sfs_dirindex_free_nolock(sfs, sin, &idx);
+        }
+    }
+    else if (sin->din->blocks >= SFS_DIRINDEX_MIN_SLOTS) {
+        sfs_dirindex_build_nolock(sfs, sin);
+    }
     return 0;
 }
 
 static int
 sfs_dirent_unlink_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, struct sfs_inode *lnksin) {
-    int ret;
+    struct sfs_disk_entry *entry;
+    if ((entry = kmalloc(sizeof(struct sfs_disk_entry))) == NULL) {
+        return -E_NO_MEM;
+    }
+
+    struct sfs_dirindex idx;
+    int ret, index;
+    if ((index = sfs_dirindex_load_nolock(sfs, sin, &idx)) != 0 && index != -E_NOENT) {
+        ret = index;
+        goto out;
+    }
+    if ((ret = sfs_dirent_read_nolock(sfs, sin, slot, entry)) != 0) {
+        goto out;
+    }
     if ((ret = sfs_dirent_write_nolock(sfs, sin, slot, 0, NULL)) != 0) {
-        return ret;
+        goto out;
     }
     assert(lnksin->din->nlinks > 0);
     sin->din->size -= sfs_dentry_size;
     sin->dirty = 1;
     lnksin->din->nlinks --;
     lnksin->dirty = 1;
+    dcache_invalidate(info2node(sin, sfs_inode), entry->name);
+    if (index == 0 && sfs_dirindex_unlink_nolock(sfs, sin, &idx, slot, entry->name) != 0) {
+        sfs_dirindex_free_nolock(sfs, sin, &idx);
+    }
+out:
+    kfree(entry);
+    return ret;
+}
+
+// sfs_dirent_rename_nolock - rename the entry name in slot of sin to new_name
+static int
+sfs_dirent_rename_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, int slot, uint32_t ino, const char *name, const char *new_name) {
+    struct sfs_dirindex idx;
+    int ret, index;
+    if ((index = sfs_dirindex_load_nolock(sfs, sin, &idx)) != 0 && index != -E_NOENT) {
+        return index;
+    }
+    if ((ret = sfs_dirent_write_nolock(sfs, sin, slot, ino, new_name)) != 0) {
+        return ret;
+    }
+    dcache_invalidate(info2node(sin, sfs_inode), name);
+    dcache_invalidate(info2node(sin, sfs_inode), new_name);
+    if (index == 0) {
+        if ((ret = sfs_dirindex_remove_nolock(sfs, &idx, sfs_dirindex_entry(sfs_dirindex_hash(name), slot))) != 0
+                || (ret = sfs_dirindex_insert_nolock(sfs, &idx, sfs_dirindex_entry(sfs_dirindex_hash(new_name), slot))) != 0
+                || (ret = sfs_dirindex_save_nolock(sfs, sin, &idx)) != 0) {
+            sfs_dirindex_free_nolock(sfs, sin, &idx);
+        }
+    }
     return 0;
 }
 
@@ -427,7 +1164,23 @@ sfs_dirent_search_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, const char *
     }
 
 #define set_pvalue(x, v)            do { if ((x) != NULL) { *(x) = (v); } } while (0)
+    struct sfs_dirindex idx;
     int ret, i, nslots = sin->din->blocks;
+    if ((ret = sfs_dirindex_load_nolock(sfs, sin, &idx)) != -E_NOENT) {
+        if (ret != 0) {
+            goto out;
+        }
+        if ((ret = sfs_dirindex_lookup_nolock(sfs, sin, &idx, name, entry, &i)) == 0) {
+            set_pvalue(slot, i);
+            set_pvalue(ino_store, entry->ino);
+        }
+        else if (ret == -E_NOENT && empty_slot != NULL) {
+            if ((ret = sfs_dirindex_free_slot_nolock(sfs, sin, &idx, entry, empty_slot)) == 0) {
+                ret = -E_NOENT;
+            }
+        }
+        goto out;
+    }
     set_pvalue(empty_slot, nslots);
     for (i = 0; i < nslots; i ++) {
         if ((ret = sfs_dirent_read_nolock(sfs, sin, i, entry)) != 0) {
@@ -497,18 +1250,29 @@ failed_cleanup_din:
     return ret;
 }
 
+/* *
+ * sfs_lookup_once - look name up in the directory sin, in the dcache first.
+ * what is found is cached with sin locked, as the changes of the names in
+ * sin invalidate them, see sfs_dirent_link_nolock.
+ * */
 static int
 sfs_lookup_once(struct sfs_fs *sfs, struct sfs_inode *sin, const char *name, struct inode **node_store, int *slot) {
+    struct inode *node = info2node(sin, sfs_inode);
+    if (slot == NULL && dcache_lookup(node, name, node_store)) {
+        return (*node_store != NULL) ? 0 : -E_NOENT;
+    }
     int ret;
     uint32_t ino;
     lock_sin(sin);
     {
-        ret = sfs_dirent_search_nolock(sfs, sin, name, &ino, slot, NULL);
+        if ((ret = sfs_dirent_search_nolock(sfs, sin, name, &ino, slot, NULL)) == 0) {
+            ret = sfs_load_inode(sfs, node_store, ino);
+        }
+        if (ret == 0 || ret == -E_NOENT) {
+            dcache_insert(node, name, (ret == 0) ? *node_store : NULL);
+        }
     }
     unlock_sin(sin);
-    if (ret == 0) {
-        ret = sfs_load_inode(sfs, node_store, ino);
-    }
     return ret;
 }
 
@@ -535,7 +1299,83 @@ sfs_openfile(struct inode *node, uint32_t open_flags) {
 
 static int
 sfs_close(struct inode *node) {
-    return vop_fsync(node);
+    return sfs_sync_inode(fsop_info(vop_fs(node), sfs), vop_info(node, sfs_inode));
+}
+
+/* *
+ * sfs_bmap_run_nolock - the disk block of the block index of the file, below
+ * din->blocks, and the # of blocks from index, max at most, which are on the
+ * consecutive disk blocks, so that they can be read in one request.
+ * */
+static int
+sfs_bmap_run_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, uint32_t max,
+        uint32_t *ino_store, uint32_t *nblks_store) {
+    struct sfs_disk_inode *din = sin->din;
+    assert(index < din->blocks && max != 0);
+    uint32_t ino, next, n = 1;
+    int ret;
+    if (sfs_extent_mapped(din)) {
+        if ((ret = sfs_extent_lookup_nolock(sfs, sin, index, &ino, &n)) != 0) {
+            return ret;
+        }
+    }
+    else {
+        if ((ret = sfs_bmap_load_nolock(sfs, sin, index, &ino)) != 0) {
+            return ret;
+        }
+        while (n < max && index + n < din->blocks) {
+            if ((ret = sfs_bmap_load_nolock(sfs, sin, index + n, &next)) != 0) {
+                return ret;
+            }
+            if (next != ino + n) {
+                break;
+            }
+            n ++;
+        }
+    }
+    *ino_store = ino, *nblks_store = (n < max) ? n : max;
+    return 0;
+}
+
+/* *
+ * sfs_readahead_nolock - called before a read of the blocks [blkno, endblk)
+ * of the file. a read starting in the block the last one ended in is taken
+ * as sequential, and doubles the window of readahead from SFS_RA_MIN up to
+ * SFS_RA_MAX blocks, any other read closes it. with the window open, the
+ * blocks up to endblk + window are read into the cache once the ones read
+ * ahead before are half consumed, a request per run of disk blocks.
+ * */
+static void
+sfs_readahead_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t blkno, uint32_t endblk) {
+    struct sfs_disk_inode *din = sin->din;
+    if (blkno != sin->ra_next) {
+        sin->ra_window = 0;
+        return;
+    }
+    if (sin->ra_window == 0) {
+        sin->ra_window = SFS_RA_MIN;
+    }
+    else if ((sin->ra_window *= 2) > SFS_RA_MAX) {
+        sin->ra_window = SFS_RA_MAX;
+    }
+
+    uint32_t end = endblk + sin->ra_window, ino, n;
+    if (end > din->blocks) {
+        end = din->blocks;
+    }
+    if (sin->ra_end < endblk || sin->ra_end > din->blocks) {
+        sin->ra_end = endblk;
+    }
+    if (sin->ra_end > endblk + sin->ra_window / 2) {
+        return;
+    }
+    while (sin->ra_end < end) {
+        if (sfs_bmap_run_nolock(sfs, sin, sin->ra_end, end - sin->ra_end, &ino, &n) != 0
+                || sfs_rablock(sfs, ino, n) != 0) {
+            break;
+        }
+        sin->ra_end += n;
+    }
 }
 
 static int
@@ -573,10 +1413,20 @@ sfs_io_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, void *buf, off_t offset
 
     int ret = 0;
     size_t size, alen = 0;
-    uint32_t ino;
+    uint32_t ino, n;
     uint32_t blkno = offset / SFS_BLKSIZE;
     uint32_t nblks = endpos / SFS_BLKSIZE - blkno;
 
+    if (write) {
+        // allocate the blocks past the end at once to keep them together, the
+        // ones the disk has no room for fail below as a short write
+        sfs_bmap_grow_nolock(sfs, sin, ROUNDUP_DIV(endpos, SFS_BLKSIZE));
+    }
+    else {
+        sfs_readahead_nolock(sfs, sin, blkno, ROUNDUP_DIV(endpos, SFS_BLKSIZE));
+        sin->ra_next = endpos / SFS_BLKSIZE;
+    }
+
     if ((blkoff = offset % SFS_BLKSIZE) != 0) {
         size = (nblks != 0) ? (SFS_BLKSIZE - blkoff) : (endpos - offset);
         if ((ret = sfs_bmap_load_nolock(sfs, sin, blkno, &ino)) != 0) {
@@ -592,15 +1442,22 @@ sfs_io_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, void *buf, off_t offset
         buf += size, blkno ++, nblks --;
     }
 
-    size = SFS_BLKSIZE;
     while (nblks != 0) {
-        if ((ret = sfs_bmap_load_nolock(sfs, sin, blkno, &ino)) != 0) {
+        n = 1;
+        if (blkno < din->blocks) {
+            ret = sfs_bmap_run_nolock(sfs, sin, blkno, nblks, &ino, &n);
+        }
+        else {
+            ret = sfs_bmap_load_nolock(sfs, sin, blkno, &ino);
+        }
+        if (ret != 0) {
             goto out;
         }
-        if ((ret = sfs_block_op(sfs, buf, ino, 1)) != 0) {
+        if ((ret = sfs_block_op(sfs, buf, ino, n)) != 0) {
             goto out;
         }
-        alen += size, buf += size, blkno ++, nblks --;
+        size = n * SFS_BLKSIZE;
+        alen += size, buf += size, blkno += n, nblks -= n;
     }
 
     if ((size = endpos % SFS_BLKSIZE) != 0) {
@@ -619,6 +1476,9 @@ out:
         sin->din->size = offset + alen;
         sin->dirty = 1;
     }
+    if (write) {
+        sfs_bmap_trim_nolock(sfs, sin);
+    }
     return ret;
 }
 
@@ -663,10 +1523,12 @@ sfs_fstat(struct inode *node, struct stat *stat) {
     return 0;
 }
 
-static int
-sfs_fsync(struct inode *node) {
-    struct sfs_fs *sfs = fsop_info(vop_fs(node), sfs);
-    struct sfs_inode *sin = vop_info(node, sfs_inode);
+/* *
+ * sfs_sync_inode - write the on-disk inode of sin into the buffer cache if it
+ * is modified, the block is written back to disk later by the cache.
+ * */
+int
+sfs_sync_inode(struct sfs_fs *sfs, struct sfs_inode *sin) {
     int ret = 0;
     if (sin->dirty) {
         lock_sin(sin);
@@ -683,6 +1545,16 @@ sfs_fsync(struct inode *node) {
     return ret;
 }
 
+static int
+sfs_fsync(struct inode *node) {
+    struct sfs_fs *sfs = fsop_info(vop_fs(node), sfs);
+    int ret;
+    if ((ret = sfs_sync_inode(sfs, vop_info(node, sfs_inode))) != 0) {
+        return ret;
+    }
+    return bcache_sync(sfs->dev);
+}
+
 static int
 sfs_mkdir_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, const char *name) {
     int ret, slot;
@@ -782,7 +1654,7 @@ sfs_rename1_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, const char *name,
     if ((ret = sfs_dirent_search_nolock(sfs, sin, new_name, NULL, NULL, NULL)) != -E_NOENT) {
         return (ret != 0) ? ret : -E_EXISTS;
     }
-    return sfs_dirent_write_nolock(sfs, sin, slot, ino, new_name);
+    return sfs_dirent_rename_nolock(sfs, sin, slot, ino, name, new_name);
 }
 
 static int
@@ -981,7 +1853,7 @@ sfs_reclaim(struct inode *node) {
         }
     }
     if (sin->dirty) {
-        if ((ret = vop_fsync(node)) != 0) {
+        if ((ret = sfs_sync_inode(sfs, sin)) != 0) {
             goto failed_unlock;
         }
     }
@@ -1048,6 +1920,9 @@ sfs_truncdir(struct inode *node, off_t len) {
     lock_sin(sin);
     uint32_t nblks = din->blocks;
     assert(len == 0 && din->nlinks == 0 && din->size == 0);
+    if (din->dirindex != 0) {
+        sfs_dirindex_drop_nolock(sfs, sin);
+    }
     while (nblks != 0) {
         if ((ret = sfs_bmap_truncate_nolock(sfs, sin)) != 0) {
             goto out_unlock;
@@ -1082,11 +1957,8 @@ sfs_truncfile(struct inode *node, off_t len) {
     lock_sin(sin);
     nblks = din->blocks;
     if (nblks < tblks) {
-        while (nblks != tblks) {
-            if ((ret = sfs_bmap_load_nolock(sfs, sin, nblks, NULL)) != 0) {
-                goto out_unlock;
-            }
-            nblks ++;
+        if ((ret = sfs_bmap_grow_nolock(sfs, sin, tblks)) != 0) {
+            goto out_unlock;
         }
     }
     else if (tblks < nblks) {
@@ -1106,6 +1978,34 @@ out_unlock:
     return ret;
 }
 
+/* *
+ * sfs_fallocate - allocate the blocks of a file up to len at once, and grow
+ * its size to len if it is shorter. a file mapped by extents gets them in
+ * as few runs as the free blocks allow, see sfs_extent_append_nolock.
+ * */
+static int
+sfs_fallocate(struct inode *node, off_t len) {
+    if (len < 0 || len > SFS_MAX_FILE_SIZE) {
+        return -E_INVAL;
+    }
+    struct sfs_fs *sfs = fsop_info(vop_fs(node), sfs);
+    struct sfs_inode *sin = vop_info(node, sfs_inode);
+    struct sfs_disk_inode *din = sin->din;
+
+    int ret = 0;
+    lock_sin(sin);
+    if (len > din->size) {
+        if ((ret = sfs_bmap_grow_nolock(sfs, sin, ROUNDUP_DIV(len, SFS_BLKSIZE))) == 0) {
+            din->size = len, sin->dirty = 1;
+        }
+        else {
+            sfs_bmap_trim_nolock(sfs, sin);
+        }
+    }
+    unlock_sin(sin);
+    return ret;
+}
+
 static int
 sfs_create_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, const char *name, bool excl, struct inode **node_store) {
     int ret, slot;
@@ -1186,6 +2086,7 @@ sfs_unlink_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, const char *name) {
                 if ((ret = sfs_dirent_unlink_nolock(sfs, sin, slot, lnksin)) == 0) {
                     sfs_dirent_unlink_nolock_check(sfs, lnksin, 0, lnksin);
                     sfs_dirent_unlink_nolock_check(sfs, lnksin, 1, sin);
+                    dcache_invalidate_dir(link_node);
                 }
             }
         }
@@ -1316,6 +2217,7 @@ static const struct inode_ops sfs_node_dirops = {
     .vop_gettype                    = sfs_gettype,
     .vop_tryseek                    = NULL_VOP_ISDIR,
     .vop_truncate                   = sfs_truncdir,
+    .vop_fallocate                  = NULL_VOP_ISDIR,
     .vop_create                     = sfs_create,
     .vop_unlink                     = sfs_unlink,
     .vop_lookup                     = sfs_lookup,
@@ -1342,6 +2244,7 @@ static const struct inode_ops sfs_node_fileops = {
     .vop_gettype                    = sfs_gettype,
     .vop_tryseek                    = sfs_tryseek,
     .vop_truncate                   = sfs_truncfile,
+    .vop_fallocate                  = sfs_fallocate,
     .vop_create                     = NULL_VOP_NOTDIR,
     .vop_unlink                     = NULL_VOP_NOTDIR,
     .vop_lookup                     = NULL_VOP_NOTDIR,
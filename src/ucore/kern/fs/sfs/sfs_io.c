@@ -2,55 +2,79 @@
 #include <string.h>
 #include <dev.h>
 #include <sfs.h>
-#include <iobuf.h>
+#include <bcache.h>
 #include <bitmap.h>
 #include <assert.h>
 
+/* *
+ * All the io of sfs goes through the block buffer cache (see bcache.c), the
+ * writes are delayed until the cache writes back the buffers, sfs_sync/fsync
+ * call bcache_sync to make them persistent.
+ * */
+
 static int
-sfs_rwblock_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno, bool write, bool check) {
-    assert((blkno != 0 || !check) && blkno < sfs->super.blocks);
-    struct iobuf __iob, *iob = iobuf_init(&__iob, buf, SFS_BLKSIZE, blkno * SFS_BLKSIZE);
-    return dop_io(sfs->dev, iob, write);
+sfs_bread(struct sfs_fs *sfs, uint32_t blkno, struct buf **buf_store) {
+    assert(blkno != 0 && blkno < sfs->super.blocks);
+    return bcache_read(sfs->dev, blkno, buf_store);
 }
 
-static int
-sfs_rwblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks, bool write) {
-    int ret = 0;
-    lock_sfs_io(sfs);
-    {
-        while (nblks != 0) {
-            if ((ret = sfs_rwblock_nolock(sfs, buf, blkno, write, 1)) != 0) {
-                break;
-            }
-            blkno ++, nblks --;
-            buf += SFS_BLKSIZE;
-        }
-    }
-    unlock_sfs_io(sfs);
-    return ret;
+static struct buf *
+sfs_bget(struct sfs_fs *sfs, uint32_t blkno) {
+    assert(blkno != 0 && blkno < sfs->super.blocks);
+    return bcache_get(sfs->dev, blkno);
 }
 
 int
 sfs_rblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks) {
-    return sfs_rwblock(sfs, buf, blkno, nblks, 0);
+    int ret;
+    uint32_t i;
+    struct buf *bp;
+    for (i = 0; nblks != 0; i ++) {
+        // the missing blocks of the next BCACHE_MAX_RUN ones in a request,
+        // not in a request per block by sfs_bread
+        if (i % BCACHE_MAX_RUN == 0 && nblks > 1) {
+            sfs_rablock(sfs, blkno, (nblks < BCACHE_MAX_RUN) ? nblks : BCACHE_MAX_RUN);
+        }
+        if ((ret = sfs_bread(sfs, blkno, &bp)) != 0) {
+            return ret;
+        }
+        memcpy(buf, bp->data, SFS_BLKSIZE);
+        bcache_release(bp);
+        blkno ++, nblks --;
+        buf += SFS_BLKSIZE;
+    }
+    return 0;
 }
 
 int
 sfs_wblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks) {
-    return sfs_rwblock(sfs, buf, blkno, nblks, 1);
+    while (nblks != 0) {
+        struct buf *bp = sfs_bget(sfs, blkno);
+        memcpy(bp->data, buf, SFS_BLKSIZE);
+        bcache_dirty(bp);
+        bcache_release(bp);
+        blkno ++, nblks --;
+        buf += SFS_BLKSIZE;
+    }
+    return 0;
+}
+
+// sfs_rablock - read the nblks blocks from blkno into the cache, see bcache_readahead
+int
+sfs_rablock(struct sfs_fs *sfs, uint32_t blkno, uint32_t nblks) {
+    assert(blkno != 0 && blkno + nblks <= sfs->super.blocks);
+    return bcache_readahead(sfs->dev, blkno, nblks);
 }
 
 int
 sfs_rbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset) {
     assert(offset >= 0 && offset < SFS_BLKSIZE && offset + len <= SFS_BLKSIZE);
     int ret;
-    lock_sfs_io(sfs);
-    {
-        if ((ret = sfs_rwblock_nolock(sfs, sfs->sfs_buffer, blkno, 0, 1)) == 0) {
-            memcpy(buf, sfs->sfs_buffer + offset, len);
-        }
+    struct buf *bp;
+    if ((ret = sfs_bread(sfs, blkno, &bp)) == 0) {
+        memcpy(buf, bp->data + offset, len);
+        bcache_release(bp);
     }
-    unlock_sfs_io(sfs);
     return ret;
 }
 
@@ -58,28 +82,23 @@ int
 sfs_wbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset) {
     assert(offset >= 0 && offset < SFS_BLKSIZE && offset + len <= SFS_BLKSIZE);
     int ret;
-    lock_sfs_io(sfs);
-    {
-        if ((ret = sfs_rwblock_nolock(sfs, sfs->sfs_buffer, blkno, 0, 1)) == 0) {
-            memcpy(sfs->sfs_buffer + offset, buf, len);
-            ret = sfs_rwblock_nolock(sfs, sfs->sfs_buffer, blkno, 1, 1);
-        }
+    struct buf *bp;
+    if ((ret = sfs_bread(sfs, blkno, &bp)) == 0) {
+        memcpy(bp->data + offset, buf, len);
+        bcache_dirty(bp);
+        bcache_release(bp);
     }
-    unlock_sfs_io(sfs);
     return ret;
 }
 
 int
 sfs_sync_super(struct sfs_fs *sfs) {
-    int ret;
-    lock_sfs_io(sfs);
-    {
-        memset(sfs->sfs_buffer, 0, SFS_BLKSIZE);
-        memcpy(sfs->sfs_buffer, &(sfs->super), sizeof(sfs->super));
-        ret = sfs_rwblock_nolock(sfs, sfs->sfs_buffer, SFS_BLKN_SUPER, 1, 0);
-    }
-    unlock_sfs_io(sfs);
-    return ret;
+    struct buf *bp = bcache_get(sfs->dev, SFS_BLKN_SUPER);
+    memset(bp->data, 0, SFS_BLKSIZE);
+    memcpy(bp->data, &(sfs->super), sizeof(sfs->super));
+    bcache_dirty(bp);
+    bcache_release(bp);
+    return 0;
 }
 
 int
@@ -90,18 +109,13 @@ sfs_sync_freemap(struct sfs_fs *sfs) {
 
 int
 sfs_clear_block(struct sfs_fs *sfs, uint32_t blkno, uint32_t nblks) {
-    int ret;
-    lock_sfs_io(sfs);
-    {
-        memset(sfs->sfs_buffer, 0, SFS_BLKSIZE);
-        while (nblks != 0) {
-            if ((ret = sfs_rwblock_nolock(sfs, sfs->sfs_buffer, blkno, 1, 1)) != 0) {
-                break;
-            }
-            blkno ++, nblks --;
-        }
+    while (nblks != 0) {
+        struct buf *bp = sfs_bget(sfs, blkno);
+        memset(bp->data, 0, SFS_BLKSIZE);
+        bcache_dirty(bp);
+        bcache_release(bp);
+        blkno ++, nblks --;
     }
-    unlock_sfs_io(sfs);
-    return ret;
+    return 0;
 }
 
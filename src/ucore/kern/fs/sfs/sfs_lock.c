@@ -7,11 +7,6 @@ lock_sfs_fs(struct sfs_fs *sfs) {
     down(&(sfs->fs_sem));
 }
 
-void
-lock_sfs_io(struct sfs_fs *sfs) {
-    down(&(sfs->io_sem));
-}
-
 void
 lock_sfs_mutex(struct sfs_fs *sfs) {
     down(&(sfs->mutex_sem));
@@ -22,11 +17,6 @@ unlock_sfs_fs(struct sfs_fs *sfs) {
     up(&(sfs->fs_sem));
 }
 
-void
-unlock_sfs_io(struct sfs_fs *sfs) {
-    up(&(sfs->io_sem));
-}
-
 void
 unlock_sfs_mutex(struct sfs_fs *sfs) {
     up(&(sfs->mutex_sem));
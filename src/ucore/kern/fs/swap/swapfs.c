@@ -25,3 +25,19 @@ swapfs_write(swap_entry_t entry, struct Page *page) {
     return ide_write_secs(SWAP_DEV_NO, swap_offset(entry) * PAGE_NSECT, page2kva(page), PAGE_NSECT);
 }
 
+
+// swapfs_write_cluster - write the n pages to the consecutive swap slots from entry, in one request
+int
+swapfs_write_cluster(swap_entry_t entry, struct Page **pages, int n) {
+    static_assert(MAX_SWAP_CLUSTER <= IDE_MAX_NVEC);
+    assert(n > 0 && n <= MAX_SWAP_CLUSTER);
+    size_t offset = swap_offset(entry);
+    assert(offset + n <= max_swap_offset);
+
+    void *bufs[MAX_SWAP_CLUSTER];
+    int i;
+    for (i = 0; i < n; i ++) {
+        bufs[i] = page2kva(pages[i]);
+    }
+    return ide_write_secsv(SWAP_DEV_NO, offset * PAGE_NSECT, bufs, n, PAGE_NSECT);
+}
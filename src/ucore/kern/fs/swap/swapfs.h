@@ -4,9 +4,12 @@
 #include <memlayout.h>
 #include <swap.h>
 
+#define MAX_SWAP_CLUSTER                        16  // pages of a swapfs_write_cluster at most
+
 void swapfs_init(void);
 int swapfs_read(swap_entry_t entry, struct Page *page);
 int swapfs_write(swap_entry_t entry, struct Page *page);
+int swapfs_write_cluster(swap_entry_t entry, struct Page **pages, int n);
 
 #endif /* !__KERN_FS_SWAP_SWAPFS_H__ */
 
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <slab.h>
 #include <vmm.h>
+#include <pmm.h>
 #include <proc.h>
 #include <vfs.h>
 #include <file.h>
@@ -9,6 +10,7 @@
 #include <sysfile.h>
 #include <stat.h>
 #include <dirent.h>
+#include <dcache.h>
 #include <unistd.h>
 #include <error.h>
 #include <assert.h>
@@ -176,6 +178,16 @@ sysfile_fsync(int fd) {
     return file_fsync(fd);
 }
 
+int
+sysfile_fallocate(int fd, off_t len) {
+    return file_fallocate(fd, len);
+}
+
+int
+sysfile_ioctl(int fd, int op, uint32_t arg) {
+    return file_ioctl(fd, op, (void *)arg);
+}
+
 int
 sysfile_chdir(const char *__path) {
     int ret;
@@ -297,6 +309,24 @@ out:
     return ret;
 }
 
+// sysfile_dcachestat - copy the counters of the dcache to store
+int
+sysfile_dcachestat(struct dcachestat *__store) {
+    struct mm_struct *mm = current->mm;
+    struct dcachestat store;
+    dcache_stat(&store);
+
+    int ret = 0;
+    lock_mm(mm);
+    {
+        if (!copy_to_user(mm, __store, &store, sizeof(struct dcachestat))) {
+            ret = -E_INVAL;
+        }
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
 int
 sysfile_dup(int fd1, int fd2) {
     return file_dup(fd1, fd2);
@@ -336,3 +366,80 @@ sysfile_mkfifo(const char *__name, uint32_t open_flags) {
     return ret;
 }
 
+int
+sysfile_splice(int fd_in, int fd_out, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    int ret;
+    size_t copied;
+    ret = file_splice(fd_in, fd_out, len, &copied);
+    if (copied != 0) {
+        return copied;
+    }
+    return ret;
+}
+
+/* *
+ * sysfile_vmsplice - put len bytes at base into the pipe fd. a whole page is
+ * shared with the pipe and write protected, the process copies it on the
+ * next write, others are copied into new pages.
+ * */
+int
+sysfile_vmsplice(int fd, void *base, size_t len) {
+    struct mm_struct *mm = current->mm;
+    if (len == 0) {
+        return 0;
+    }
+    if (!file_testfd(fd, 0, 1)) {
+        return -E_INVAL;
+    }
+
+    int ret = 0;
+    size_t copied = 0, offset, alen;
+    while (len != 0) {
+        offset = (uintptr_t)base % PGSIZE;
+        if ((alen = PGSIZE - offset) > len) {
+            alen = len;
+        }
+        struct Page *page = NULL;
+        lock_mm(mm);
+        {
+            if (!user_mem_check(mm, (uintptr_t)base, alen, 0)) {
+                ret = -E_INVAL;
+            }
+            else if (alen == PGSIZE) {
+                page = mm_get_cow_page(mm, (uintptr_t)base);
+            }
+            if (ret == 0 && page == NULL) {
+                if ((page = alloc_page()) == NULL) {
+                    ret = -E_NO_MEM;
+                }
+                else if (!copy_from_user(mm, page2kva(page) + offset, base, alen, 0)) {
+                    free_page(page), page = NULL;
+                    ret = -E_INVAL;
+                }
+                else {
+                    page_ref_inc(page);
+                }
+            }
+        }
+        unlock_mm(mm);
+        if (ret != 0) {
+            break;
+        }
+        // may wait for the reader, without the lock of mm
+        if ((ret = file_splice_page(fd, page, offset, alen)) != 0) {
+            if (page_ref_dec(page) == 0 && !PageSwap(page)) {
+                free_page(page);
+            }
+            break;
+        }
+        base += alen, len -= alen, copied += alen;
+    }
+    if (copied != 0) {
+        return copied;
+    }
+    return ret;
+}
+
@@ -0,0 +1,250 @@
+#include <types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <list.h>
+#include <slab.h>
+#include <sync.h>
+#include <vfs.h>
+#include <inode.h>
+#include <dcache.h>
+#include <assert.h>
+
+#define DCACHE_HASH_SHIFT           10
+#define DCACHE_HASH_SIZE            (1 << DCACHE_HASH_SHIFT)
+
+static list_entry_t hash_list[DCACHE_HASH_SIZE];
+
+// all entries, least recently used first
+static list_entry_t lru_list;
+
+static struct dcachestat dcstat;
+
+// entries dcache_trim should reclaim for memory pressure
+static size_t shrink_count;
+
+void
+dcache_init(void) {
+    int i;
+    for (i = 0; i < DCACHE_HASH_SIZE; i ++) {
+        list_init(hash_list + i);
+    }
+    list_init(&lru_list);
+}
+
+static uint32_t
+dcache_hashfn(struct inode *dir, const char *name) {
+    uint32_t hash = (uintptr_t)dir;
+    while (*name != '\0') {
+        hash = hash * 31 + (unsigned char)*name ++;
+    }
+    return hash32(hash, DCACHE_HASH_SHIFT);
+}
+
+// lookup_dentry - find the entry of (dir, name), must be called with interrupts disabled
+static struct dentry *
+lookup_dentry(struct inode *dir, const char *name) {
+    list_entry_t *list = hash_list + dcache_hashfn(dir, name), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct dentry *dentry = le2dentry(le, hash_link);
+        if (dentry->dir == dir && strcmp(dentry->name, name) == 0) {
+            return dentry;
+        }
+    }
+    return NULL;
+}
+
+/* *
+ * dentry_unlink - take dentry out of the cache and put it on the list
+ * to free, must be called with interrupts disabled
+ * */
+static void
+dentry_unlink(struct dentry *dentry, list_entry_t *free_list) {
+    list_del(&(dentry->hash_link));
+    list_del(&(dentry->lru_link));
+    list_add(free_list, &(dentry->lru_link));
+    dcstat.nentries --;
+}
+
+// dentry_free_list - drop the references of the entries on free_list and free them
+static void
+dentry_free_list(list_entry_t *free_list) {
+    list_entry_t *le;
+    while ((le = list_next(free_list)) != free_list) {
+        list_del(le);
+        struct dentry *dentry = le2dentry(le, lru_link);
+        if (dentry->node != NULL) {
+            vop_ref_dec(dentry->node);
+        }
+        vop_ref_dec(dentry->dir);
+        kfree(dentry);
+    }
+}
+
+/* *
+ * dcache_lookup - look (dir, name) up in the cache. returns false if it is
+ * not cached, otherwise *node_store is the inode of the name with a new
+ * reference, or NULL if the name does not exist.
+ * */
+bool
+dcache_lookup(struct inode *dir, const char *name, struct inode **node_store) {
+    struct dentry *dentry;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        dcstat.lookups ++;
+        if ((dentry = lookup_dentry(dir, name)) != NULL) {
+            list_del(&(dentry->lru_link));
+            list_add_before(&lru_list, &(dentry->lru_link));
+            if ((*node_store = dentry->node) != NULL) {
+                vop_ref_inc(dentry->node);
+                dcstat.hits ++;
+            }
+            else {
+                dcstat.neg_hits ++;
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+    return dentry != NULL;
+}
+
+// dcache_insert - cache node as the inode of name in dir, NULL if the name does not exist
+void
+dcache_insert(struct inode *dir, const char *name, struct inode *node) {
+    struct dentry *dentry, *old;
+    if ((dentry = kmalloc(sizeof(struct dentry) + strlen(name) + 1)) == NULL) {
+        return;
+    }
+    dentry->dir = dir, dentry->node = node;
+    strcpy(dentry->name, name);
+    vop_ref_inc(dir);
+    if (node != NULL) {
+        vop_ref_inc(node);
+    }
+
+    list_entry_t free_list;
+    list_init(&free_list);
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if ((old = lookup_dentry(dir, name)) != NULL) {
+            dentry_unlink(old, &free_list);
+        }
+        list_add(hash_list + dcache_hashfn(dir, name), &(dentry->hash_link));
+        list_add_before(&lru_list, &(dentry->lru_link));
+        dcstat.nentries ++;
+    }
+    local_intr_restore(intr_flag);
+    dentry_free_list(&free_list);
+}
+
+// dcache_invalidate - drop the entry of (dir, name), called when name is created, removed or renamed
+void
+dcache_invalidate(struct inode *dir, const char *name) {
+    struct dentry *dentry;
+    list_entry_t free_list;
+    list_init(&free_list);
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if ((dentry = lookup_dentry(dir, name)) != NULL) {
+            dentry_unlink(dentry, &free_list);
+            dcstat.invalidates ++;
+        }
+    }
+    local_intr_restore(intr_flag);
+    dentry_free_list(&free_list);
+}
+
+// dcache_drop - drop the entries in the directories for which match(dir, arg) is true
+static void
+dcache_drop(bool (*match)(struct inode *dir, void *arg), void *arg) {
+    list_entry_t free_list;
+    list_init(&free_list);
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        list_entry_t *le = list_next(&lru_list);
+        while (le != &lru_list) {
+            struct dentry *dentry = le2dentry(le, lru_link);
+            le = list_next(le);
+            if (match(dentry->dir, arg)) {
+                dentry_unlink(dentry, &free_list);
+                dcstat.invalidates ++;
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+    dentry_free_list(&free_list);
+}
+
+static bool
+dcache_match_dir(struct inode *dir, void *arg) {
+    return dir == (struct inode *)arg;
+}
+
+static bool
+dcache_match_fs(struct inode *dir, void *arg) {
+    return arg == NULL || dir->in_fs == (struct fs *)arg;
+}
+
+// dcache_invalidate_dir - drop all entries in dir, called when dir is removed
+void
+dcache_invalidate_dir(struct inode *dir) {
+    dcache_drop(dcache_match_dir, dir);
+}
+
+// dcache_purge - drop all entries of fs, or of all fs if fs is NULL, called before fs is unmounted
+void
+dcache_purge(struct fs *fs) {
+    dcache_drop(dcache_match_fs, fs);
+}
+
+// dcache_trim - reclaim the least recently used entries over DCACHE_MAX_ENTRY, and the ones asked by dcache_shrink
+void
+dcache_trim(void) {
+    list_entry_t free_list, *le;
+    list_init(&free_list);
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        while ((le = list_next(&lru_list)) != &lru_list
+                && (dcstat.nentries > DCACHE_MAX_ENTRY || shrink_count != 0)) {
+            dentry_unlink(le2dentry(le, lru_link), &free_list);
+            dcstat.reclaims ++;
+            if (shrink_count != 0) {
+                shrink_count --;
+            }
+        }
+        shrink_count = 0;
+    }
+    local_intr_restore(intr_flag);
+    dentry_free_list(&free_list);
+}
+
+// dcache_shrink - called by kswapd under memory pressure, the next dcache_trim reclaims half of the entries
+void
+dcache_shrink(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        shrink_count = dcstat.nentries / 2;
+    }
+    local_intr_restore(intr_flag);
+}
+
+// dcache_stat - copy the counters of the cache to stat
+void
+dcache_stat(struct dcachestat *stat) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        *stat = dcstat;
+    }
+    local_intr_restore(intr_flag);
+}
+
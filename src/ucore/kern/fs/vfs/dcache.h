@@ -0,0 +1,53 @@
+#ifndef __KERN_FS_VFS_DCACHE_H__
+#define __KERN_FS_VFS_DCACHE_H__
+
+#include <types.h>
+#include <list.h>
+#include <dcachestat.h>
+
+/* *
+ * dcache - the cache of the names looked up in the directories.
+ *
+ * An entry maps (directory inode, name) to the inode of the name, or to
+ * nothing if the name does not exist (a negative entry), and holds a
+ * reference of both inodes. A fs looks the names up in the cache before
+ * it scans its directories, inserts what it found, and must invalidate
+ * the names it creates, removes or renames, with the directory locked.
+ *
+ * The entries are reclaimed in lru order when there are more than
+ * DCACHE_MAX_ENTRY of them, and half of them under memory pressure, see
+ * dcache_shrink. Dropping the references may reclaim the inodes, which
+ * may need the locks of their fs, so it is done by dcache_trim, called
+ * from vfs_lookup without any lock held.
+ * */
+
+#define DCACHE_MAX_ENTRY            2048                // entries in the cache at most
+
+struct inode;
+struct fs;
+
+struct dentry {
+    struct inode *dir;              // the directory the name is in
+    struct inode *node;             // the inode of the name, NULL if it does not exist
+    list_entry_t hash_link;         // entry for the hash list
+    list_entry_t lru_link;          // entry for the lru list
+    char name[0];                   // the name, nul terminated
+};
+
+#define le2dentry(le, member)                       \
+    to_struct((le), struct dentry, member)
+
+void dcache_init(void);
+
+bool dcache_lookup(struct inode *dir, const char *name, struct inode **node_store);
+void dcache_insert(struct inode *dir, const char *name, struct inode *node);
+void dcache_invalidate(struct inode *dir, const char *name);
+void dcache_invalidate_dir(struct inode *dir);
+void dcache_purge(struct fs *fs);
+
+void dcache_trim(void);
+void dcache_shrink(void);
+void dcache_stat(struct dcachestat *stat);
+
+#endif /* !__KERN_FS_VFS_DCACHE_H__ */
+
@@ -5,6 +5,7 @@
 #include <slab.h>
 #include <vfs.h>
 #include <inode.h>
+#include <pagecache.h>
 #include <error.h>
 #include <assert.h>
 
@@ -29,6 +30,7 @@ inode_init(struct inode *node, const struct inode_ops *ops, struct fs *fs) {
     atomic_set(&(node->ref_count), 0);
     atomic_set(&(node->open_count), 0);
     node->in_ops = ops, node->in_fs = fs;
+    node->in_pagecache = NULL;
     vop_ref_inc(node);
 }
 
@@ -55,13 +57,14 @@ inode_ref_inc(struct inode *node) {
 /* *
  * inode_ref_dec - decrement ref_count
  * invoked by vop_ref_dec
- * calls vop_reclaim if the ref_count hits zero
+ * releases the page cache and calls vop_reclaim if the ref_count hits zero
  * */
 int
 inode_ref_dec(struct inode *node) {
     assert(inode_ref_count(node) > 0);
     int ref_count, ret;
     if ((ref_count = atomic_sub_return(&(node->ref_count), 1)) == 0) {
+        pagecache_destroy(node);
         if ((ret = vop_reclaim(node)) != 0 && ret != -E_BUSY) {
             cprintf("vfs: warning: vop_reclaim: %e.\n", ret);
         }
@@ -10,6 +10,7 @@
 
 struct stat;
 struct iobuf;
+struct pagecache;
 
 /*
  * A struct inode is an abstract representation of a file.
@@ -44,6 +45,7 @@ struct inode {
     atomic_t open_count;
     struct fs *in_fs;
     const struct inode_ops *in_ops;
+    struct pagecache *in_pagecache;
 };
 
 #define __in_type(type)                                             inode_type_##type##_info
@@ -154,6 +156,10 @@ void inode_kill(struct inode *node);
  *    vop_truncate    - Forcibly set size of file to the length passed
  *                      in, discarding any excess blocks.
  *
+ *    vop_fallocate   - Allocate the blocks of file up to the length
+ *                      passed in, growing its size to it if the file is
+ *                      shorter. Never shrinks the file.
+ *
  *    vop_namefile    - Compute pathname relative to filesystem root
  *                      of the file and copy to the specified
  *                      uio. Need not work on objects that are not
@@ -218,6 +224,7 @@ struct inode_ops {
     int (*vop_gettype)(struct inode *node, uint32_t *type_store);
     int (*vop_tryseek)(struct inode *node, off_t pos);
     int (*vop_truncate)(struct inode *node, off_t len);
+    int (*vop_fallocate)(struct inode *node, off_t len);
     int (*vop_create)(struct inode *node, const char *name, bool excl, struct inode **node_store);
     int (*vop_unlink)(struct inode *node, const char *name);
     int (*vop_lookup)(struct inode *node, char *path, struct inode **node_store);
@@ -261,6 +268,7 @@ void inode_check(struct inode *node, const char *opstr);
 #define vop_gettype(node, type_store)                               (__vop_op(node, gettype)(node, type_store))
 #define vop_tryseek(node, pos)                                      (__vop_op(node, tryseek)(node, pos))
 #define vop_truncate(node, len)                                     (__vop_op(node, truncate)(node, len))
+#define vop_fallocate(node, len)                                    (__vop_op(node, fallocate)(node, len))
 #define vop_create(node, name, excl, node_store)                    (__vop_op(node, create)(node, name, excl, node_store))
 #define vop_unlink(node, name)                                      (__vop_op(node, unlink)(node, name))
 #define vop_lookup(node, path, node_store)                          (__vop_op(node, lookup)(node, path, node_store))
@@ -4,6 +4,7 @@
 #include <slab.h>
 #include <vfs.h>
 #include <inode.h>
+#include <dcache.h>
 #include <sem.h>
 #include <error.h>
 
@@ -25,6 +26,7 @@ void
 vfs_init(void) {
     sem_init(&bootfs_sem, 1);
     vfs_devlist_init();
+    dcache_init();
 }
 
 static void
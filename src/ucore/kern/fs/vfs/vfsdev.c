@@ -4,6 +4,7 @@
 #include <vfs.h>
 #include <dev.h>
 #include <inode.h>
+#include <dcache.h>
 #include <sem.h>
 #include <list.h>
 #include <slab.h>
@@ -239,6 +240,7 @@ vfs_unmount(const char *devname) {
     }
     assert(vdev->devname != NULL && vdev->mountable);
 
+    dcache_purge(vdev->fs);
     if ((ret = fsop_sync(vdev->fs)) != 0) {
         goto out;
     }
@@ -262,6 +264,7 @@ vfs_unmount_all(void) {
                 vfs_dev_t *vdev = le2vdev(le, vdev_link);
                 if (vdev->mountable && vdev->fs != NULL) {
                     int ret;
+                    dcache_purge(vdev->fs);
                     if ((ret = fsop_sync(vdev->fs)) != 0) {
                         cprintf("vfs: warning: sync failed for %s: %e.\n", vdev->devname, ret);
                         continue ;
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <vfs.h>
 #include <inode.h>
+#include <pagecache.h>
 #include <unistd.h>
 #include <error.h>
 #include <assert.h>
@@ -58,6 +59,7 @@ vfs_open(char *path, uint32_t open_flags, struct inode **node_store) {
             vop_ref_dec(node);
             return ret;
         }
+        pagecache_truncate(node, 0);
     }
     *node_store = node;
     return 0;
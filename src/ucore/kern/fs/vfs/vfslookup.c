@@ -2,6 +2,7 @@
 #include <string.h>
 #include <vfs.h>
 #include <inode.h>
+#include <dcache.h>
 #include <error.h>
 #include <assert.h>
 
@@ -64,6 +65,7 @@ int
 vfs_lookup(char *path, struct inode **node_store) {
     int ret;
     struct inode *node;
+    dcache_trim();
     if ((ret = get_device(path, &path, &node)) != 0) {
         return ret;
     }
@@ -80,6 +82,7 @@ int
 vfs_lookup_parent(char *path, struct inode **node_store, char **endp) {
     int ret;
     struct inode *node;
+    dcache_trim();
     if ((ret = get_device(path, &path, &node)) != 0) {
         return ret;
     }
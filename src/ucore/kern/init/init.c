@@ -14,6 +14,8 @@
 #include <swap.h>
 #include <proc.h>
 #include <sched.h>
+#include <mp.h>
+#include <lapic.h>
 
 int kern_init(void) __attribute__((noreturn));
 
@@ -31,6 +33,8 @@ kern_init(void) {
 
     debug_init();               // init debug registers
     pmm_init();                 // init physical memory management
+    mp_init();                  // find the other processors
+    lapic_init();               // init local APIC of the boot processor
 
     pic_init();                 // init interrupt controller
     idt_init();                 // init interrupt descriptor table
@@ -47,6 +51,9 @@ kern_init(void) {
     clock_init();               // init clock interrupt
     intr_enable();              // enable irq interrupt
 
+    lapic_calibrate();          // measure local APIC timer against the clock
+    mp_start_aps();             // start the other processors
+
     cpu_idle();                 // run idle process
 }
 
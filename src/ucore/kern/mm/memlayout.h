@@ -10,6 +10,9 @@
 #define SEG_UDATA   4
 #define SEG_TSS     5
 #define SEG_TLS		6
+#define SEG_KCPU    7
+
+#define NSEGS       8                       // number of segments in the per-cpu gdt
 
 /* global descrptor numbers */
 #define GD_KTEXT    ((SEG_KTEXT) << 3)      // kernel text
@@ -17,6 +20,7 @@
 #define GD_UTEXT    ((SEG_UTEXT) << 3)      // user text
 #define GD_UDATA    ((SEG_UDATA) << 3)      // user data
 #define GD_TSS      ((SEG_TSS) << 3)        // task segment selector
+#define GD_KCPU     ((SEG_KCPU) << 3)       // per-cpu data of kernel
 
 #define DPL_KERNEL  (0)
 #define DPL_USER    (3)
@@ -25,6 +29,7 @@
 #define KERNEL_DS   ((GD_KDATA) | DPL_KERNEL)
 #define USER_CS     ((GD_UTEXT) | DPL_USER)
 #define USER_DS     ((GD_UDATA) | DPL_USER)
+#define KERNEL_CPU  ((GD_KCPU) | DPL_KERNEL)
 
 /* *
  * Virtual memory map:                                          Permissions
@@ -34,7 +39,9 @@
  *                            |                                 |
  *                            |         Empty Memory (*)        |
  *                            |                                 |
- *                            +---------------------------------+ 0xFB000000
+ *                            +---------------------------------+ 0xFB400000
+ *                            |    Memory-mapped I/O (Kern)     | RW/-- PTSIZE
+ *     MMIOBASE ------------> +---------------------------------+ 0xFB000000
  *                            |   Cur. Page Table (Kern, RW)    | RW/-- PTSIZE
  *     VPT -----------------> +---------------------------------+ 0xFAC00000
  *                            |        Invalid Memory (*)       | --/--
@@ -80,6 +87,13 @@
  * */
 #define VPT                 0xFAC00000
 
+/* Memory-mapped I/O region, such as the local APIC registers */
+#define MMIOBASE            0xFB000000
+#define MMIOLIM             (MMIOBASE + PTSIZE)
+
+/* Physical address where the application processors start executing */
+#define MPENTRY_PADDR       0x7000
+
 #define KSTACKPAGE          2                           // # of pages in kernel stack
 #define KSTACKSIZE          (KSTACKPAGE * PGSIZE)       // sizeof kernel stack
 
@@ -135,6 +149,7 @@ struct Page {
     list_entry_t page_link;         // free list link
     swap_entry_t index;             // stores a swapped-out page identifier
     list_entry_t swap_link;         // swap hash link
+    unsigned int lru_seq;           // the generation in which the page was last seen accessed, see swap.c
 };
 
 /* Flags describing the status of a page frame */
@@ -142,8 +157,9 @@ struct Page {
 #define PG_property                 1       // the member 'property' is valid
 #define PG_slab                     2       // page frame is included in a slab
 #define PG_dirty                    3       // the page has been modified
-#define PG_swap                     4       // the page is in the active or inactive page list (and swap hash table)
-#define PG_active                   5       // the page is in the active page list
+#define PG_swap                     4       // the page is in a generation list (and swap hash table)
+#define PG_writeback                5       // the page is being written to the swap device
+#define PG_cache                    6       // the page is in the page cache of a file, see pagecache.c
 
 #define SetPageReserved(page)       set_bit(PG_reserved, &((page)->flags))
 #define ClearPageReserved(page)     clear_bit(PG_reserved, &((page)->flags))
@@ -160,9 +176,12 @@ struct Page {
 #define SetPageSwap(page)           set_bit(PG_swap, &((page)->flags))
 #define ClearPageSwap(page)         clear_bit(PG_swap, &((page)->flags))
 #define PageSwap(page)              test_bit(PG_swap, &((page)->flags))
-#define SetPageActive(page)         set_bit(PG_active, &((page)->flags))
-#define ClearPageActive(page)       clear_bit(PG_active, &((page)->flags))
-#define PageActive(page)            test_bit(PG_active, &((page)->flags))
+#define SetPageWriteback(page)      set_bit(PG_writeback, &((page)->flags))
+#define ClearPageWriteback(page)    clear_bit(PG_writeback, &((page)->flags))
+#define PageWriteback(page)         test_bit(PG_writeback, &((page)->flags))
+#define SetPageCache(page)          set_bit(PG_cache, &((page)->flags))
+#define ClearPageCache(page)        clear_bit(PG_cache, &((page)->flags))
+#define PageCache(page)             test_bit(PG_cache, &((page)->flags))
 
 // convert list entry to page
 #define le2page(le, member)                 \
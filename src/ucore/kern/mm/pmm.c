@@ -10,6 +10,7 @@
 #include <slab.h>
 #include <swap.h>
 #include <error.h>
+#include <mp.h>
 
 /* *
  * Task State Segment:
@@ -30,8 +31,9 @@
  * contains the new ESP value for CPL = 0. When an interrupt happens in protected
  * mode, the x86 CPU will look in the TSS for SS0 and ESP0 and load their value
  * into SS and ESP respectively.
+ *
+ * Each cpu has its own TSS and GDT in struct cpu (see mp.h).
  * */
-static struct taskstate ts = {0};
 
 // virtual address of physicall page array
 struct Page *pages;
@@ -46,6 +48,9 @@ uintptr_t boot_cr3;
 // physical memory management
 const struct pmm_manager *pmm_manager;
 
+// lock of pmm_manager, so that allocating pages does not need the kernel lock
+static spinlock_t pmm_lock;
+
 /* *
  * The page directory entry corresponding to the virtual address range
  * [VPT, VPT + PTSIZE) points to the page directory itself. Thus, the page
@@ -73,9 +78,13 @@ pde_t * const vpd = (pde_t *)PGADDR(PDX(VPT), PDX(VPT), 0);
  *   - 0x10:  kernel data segment
  *   - 0x18:  user code segment
  *   - 0x20:  user data segment
- *   - 0x28:  defined for tss, initialized in gdt_init
+ *   - 0x28:  defined for tss, initialized in gdt_init_cpu
+ *   - 0x30:  user thread local storage, see set_ldt
+ *   - 0x38:  per-cpu data of kernel, initialized in gdt_init_cpu
+ *
+ * This is the template copied into the gdt of each cpu.
  * */
-static struct segdesc gdt[] = {
+static struct segdesc gdt[NSEGS] = {
 	SEG_NULL,
 	[SEG_KTEXT] = SEG(STA_X | STA_R, 0x0, 0xFFFFFFFF, DPL_KERNEL),
 	[SEG_KDATA] = SEG(STA_W, 0x0, 0xFFFFFFFF, DPL_KERNEL),
@@ -83,11 +92,11 @@ static struct segdesc gdt[] = {
 	[SEG_UDATA] = SEG(STA_W, 0x0, 0xFFFFFFFF, DPL_USER),
 	[SEG_TSS]	= SEG_NULL,
 	[SEG_TLS]	= SEG(STA_W | STA_R, 0x0, 0xFFFFFFFF, DPL_USER),
+	[SEG_KCPU]	= SEG_NULL,
 };
 
-static struct pseudodesc gdt_pd = {
-    sizeof(gdt) - 1, (uintptr_t)gdt
-};
+// next free virtual address in [MMIOBASE, MMIOLIM)
+static uintptr_t mmio_base = MMIOBASE;
 
 static void check_alloc_page(void);
 static void check_pgdir(void);
@@ -110,52 +119,73 @@ lgdt(struct pseudodesc *pd) {
 }
 
 /* *
- * load_esp0 - change the ESP0 in default task state segment,
+ * load_esp0 - change the ESP0 in task state segment of this cpu,
  * so that we can use different kernel stack when we trap frame
  * user to kernel.
  * */
 void
 load_esp0(uintptr_t esp0) {
-    ts.ts_esp0 = esp0;
+    mycpu()->ts.ts_esp0 = esp0;
 }
 
-/* gdt_init - initialize the default GDT and TSS */
-static void
-gdt_init(void) {
+/* *
+ * gdt_init_cpu - initialize the GDT and TSS of cpu, and load them.
+ * called by the BSP in pmm_init and by each AP in mp_main.
+ * */
+void
+gdt_init_cpu(struct cpu *cpu) {
+    cpu->self = cpu;
+    memcpy(cpu->gdt, gdt, sizeof(gdt));
+    cpu->gdt_pd.pd_lim = sizeof(cpu->gdt) - 1;
+    cpu->gdt_pd.pd_base = (uintptr_t)(cpu->gdt);
+
     // set boot kernel stack and default SS0
-    load_esp0((uintptr_t)bootstacktop);
-    ts.ts_ss0 = KERNEL_DS;
+    cpu->ts.ts_esp0 = (uintptr_t)bootstacktop;
+    cpu->ts.ts_ss0 = KERNEL_DS;
 
-    // initialize the TSS filed of the gdt
-    gdt[SEG_TSS] = SEGTSS(STS_T32A, (uintptr_t)&ts, sizeof(ts), DPL_KERNEL);
+    // initialize the TSS filed and the per-cpu segment of the gdt
+    cpu->gdt[SEG_TSS] = SEGTSS(STS_T32A, (uintptr_t)&(cpu->ts), sizeof(cpu->ts), DPL_KERNEL);
+    cpu->gdt[SEG_KCPU] = SEG(STA_W, (uintptr_t)cpu, 0xFFFFFFFF, DPL_KERNEL);
 
     // reload all segment registers
-    lgdt(&gdt_pd);
+    lgdt(&(cpu->gdt_pd));
 
     // load the TSS
     ltr(GD_TSS);
+
+    // %fs points to struct cpu in kernel, see mycpu
+    asm volatile ("movw %%ax, %%fs" :: "a" (KERNEL_CPU));
+}
+
+/* gdt_init - initialize the GDT and TSS of the boot cpu */
+static void
+gdt_init(void) {
+    gdt_init_cpu(cpus);
 }
 
 void pad_ldt(struct segdesc* pseg)
 {
-	gdt[SEG_TLS] = *pseg;
-	asm volatile ("lgdt (%0)" :: "r" (&gdt_pd));
+	struct cpu *cpu = mycpu();
+	cpu->gdt[SEG_TLS] = *pseg;
+	asm volatile ("lgdt (%0)" :: "r" (&(cpu->gdt_pd)));
 }
 
 void set_ldt(uint64_t base, uint32_t limit)
 {
+	struct cpu *cpu = mycpu();
 #ifdef DEBUG_PRINT_SET_LDT
 	cprintf("set_ldt: entry = SEG_TLS base = 0x%16x ", base);
 	cprintf("limit = 0x%08x.\n", limit);
 #endif
-	gdt[SEG_TLS] = SEG(STA_W | STA_R, base, limit, DPL_USER);
-	asm volatile ("lgdt (%0)" :: "r" (&gdt_pd));
+	cpu->gdt[SEG_TLS] = SEG(STA_W | STA_R, base, limit, DPL_USER);
+	asm volatile ("lgdt (%0)" :: "r" (&(cpu->gdt_pd)));
 }
 
 //init_pmm_manager - initialize a pmm_manager instance
 static void
 init_pmm_manager(void) {
     pmm_manager = &buddy_pmm_manager;
+    spinlock_init(&pmm_lock);
     cprintf("memory managment: %s\n", pmm_manager->name);
     pmm_manager->init();
 }
@@ -172,11 +202,11 @@ alloc_pages(size_t n) {
     bool intr_flag;
     struct Page *page;
 try_again:
-    local_intr_save(intr_flag);
+    spin_lock_irqsave(&pmm_lock, intr_flag);
     {
         page = pmm_manager->alloc_pages(n);
     }
-    local_intr_restore(intr_flag);
+    spin_unlock_irqrestore(&pmm_lock, intr_flag);
     if (page == NULL && try_free_pages(n)) {
         goto try_again;
     }
@@ -187,11 +217,11 @@ try_again:
 void
 free_pages(struct Page *base, size_t n) {
     bool intr_flag;
-    local_intr_save(intr_flag);
+    spin_lock_irqsave(&pmm_lock, intr_flag);
     {
         pmm_manager->free_pages(base, n);
     }
-    local_intr_restore(intr_flag);
+    spin_unlock_irqrestore(&pmm_lock, intr_flag);
 }
 
 //nr_free_pages - call pmm->nr_free_pages to get the size (nr*PAGESIZE) 
@@ -200,11 +230,11 @@ size_t
 nr_free_pages(void) {
     size_t ret;
     bool intr_flag;
-    local_intr_save(intr_flag);
+    spin_lock_irqsave(&pmm_lock, intr_flag);
     {
         ret = pmm_manager->nr_free_pages();
     }
-    local_intr_restore(intr_flag);
+    spin_unlock_irqrestore(&pmm_lock, intr_flag);
     return ret;
 }
 
@@ -291,6 +321,25 @@ boot_map_segment(pde_t *pgdir, uintptr_t la, size_t size, uintptr_t pa, uint32_t
     }
 }
 
+/* *
+ * mmio_map_region - reserve size bytes in [MMIOBASE, MMIOLIM), map the
+ * device memory at physical address pa there without caching, and return
+ * the virtual address of pa.
+ * must be called before the first user page directory is copied from
+ * boot_pgdir, as the page table of MMIOBASE is shared through it.
+ * */
+void *
+mmio_map_region(uintptr_t pa, size_t size) {
+    uintptr_t base = mmio_base + PGOFF(pa);
+    size = ROUNDUP(size + PGOFF(pa), PGSIZE);
+    if (mmio_base + size > MMIOLIM) {
+        panic("mmio_map_region: out of MMIO space.\n");
+    }
+    boot_map_segment(boot_pgdir, mmio_base, size, ROUNDDOWN(pa, PGSIZE), PTE_W | PTE_PCD | PTE_PWT);
+    mmio_base += size;
+    return (void *)base;
+}
+
 //boot_alloc_page - allocate one page using pmm->alloc_pages(1) 
 // return value: the kernel virtual address of this allocated page
 //note: this function is used to get the memory for PDT(Page Directory Table)&PT(Page Table)
@@ -457,17 +506,35 @@ page_insert(pde_t *pgdir, struct Page *page, uintptr_t la, uint32_t perm) {
 
 out:
     *ptep = page2pa(page) | PTE_P | perm;
+    lru_gen_touch(page);
     tlb_invalidate(pgdir, la);
     return 0;
 }
 
 // invalidate a TLB entry, but only if the page tables being
 // edited are the ones currently in use by the processor.
+// the other cpus running with the same page tables are asked to do so
+// through an inter-processor interrupt.
 void
 tlb_invalidate(pde_t *pgdir, uintptr_t la) {
     if (rcr3() == PADDR(pgdir)) {
         invlpg((void *)la);
     }
+    if (ncpu > 1) {
+        mp_tlb_shootdown(PADDR(pgdir), la);
+    }
+}
+
+// invalidate the whole TLB after a change to the page directory pgdir,
+// the same way as tlb_invalidate.
+void
+tlb_invalidate_all(pde_t *pgdir) {
+    if (rcr3() == PADDR(pgdir)) {
+        lcr3(PADDR(pgdir));
+    }
+    if (ncpu > 1) {
+        mp_tlb_shootdown(PADDR(pgdir), TLB_FLUSH_ALL);
+    }
 }
 
 // pgdir_alloc_page - call alloc_page & page_insert functions to 
@@ -519,42 +586,28 @@ exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end) {
     } while (start != 0 && start < end);
 }
 
-int
-copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end, bool share) {
+/* *
+ * share_range - make to use the page tables of from which cover [start, end),
+ * instead of copying their entries. the shared tables are mapped read only by
+ * both page directories, and count their users in their page ref: the first
+ * write through one of them gives that mm its own copy, see mm_unshare_pt in
+ * vmm.c. the caller flushes the tlb of from.
+ * */
+void
+share_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end) {
     assert(start % PGSIZE == 0 && end % PGSIZE == 0);
     assert(USER_ACCESS(start, end));
 
+    start = ROUNDDOWN(start, PTSIZE);
     do {
-        pte_t *ptep = get_pte(from, start, 0), *nptep;
-        if (ptep == NULL) {
-            start = ROUNDDOWN(start + PTSIZE, PTSIZE);
-            continue ;
-        }
-        if (*ptep != 0) {
-            if ((nptep = get_pte(to, start, 1)) == NULL) {
-                return -E_NO_MEM;
-            }
-            int ret;
-            assert(*ptep != 0 && *nptep == 0);
-            if (*ptep & PTE_P) {
-                uint32_t perm = (*ptep & PTE_USER);
-                struct Page *page = pte2page(*ptep);
-                if (!share && (*ptep & PTE_W)) {
-                    perm &= ~PTE_W;
-                    page_insert(from, page, start, perm);
-                }
-                ret = page_insert(to, page, start, perm);
-                assert(ret == 0);
-            }
-            else {
-                swap_entry_t entry = *ptep;
-                swap_duplicate(entry);
-                *nptep = entry;
-            }
+        int pde_idx = PDX(start);
+        if ((from[pde_idx] & PTE_P) && !(to[pde_idx] & PTE_P)) {
+            from[pde_idx] &= ~PTE_W;
+            to[pde_idx] = from[pde_idx];
+            page_ref_inc(pde2page(from[pde_idx]));
         }
-        start += PGSIZE;
+        start += PTSIZE;
     } while (start != 0 && start < end);
-    return 0;
 }
 
 static void
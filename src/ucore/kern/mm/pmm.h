@@ -52,14 +52,19 @@ struct Page *get_page(pde_t *pgdir, uintptr_t la, pte_t **ptep_store);
 void page_remove(pde_t *pgdir, uintptr_t la);
 int page_insert(pde_t *pgdir, struct Page *page, uintptr_t la, uint32_t perm);
 
+struct cpu;
+void gdt_init_cpu(struct cpu *cpu);
+void *mmio_map_region(uintptr_t pa, size_t size);
+
 void pad_ldt(struct segdesc* pseg);
 void set_ldt(uint64_t base, uint32_t limit);
 void load_esp0(uintptr_t esp0);
 void tlb_invalidate(pde_t *pgdir, uintptr_t la);
+void tlb_invalidate_all(pde_t *pgdir);
 struct Page *pgdir_alloc_page(pde_t *pgdir, uintptr_t la, uint32_t perm);
 void unmap_range(pde_t *pgdir, uintptr_t start, uintptr_t end);
 void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end);
-int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end, bool share);
+void share_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end);
 
 void print_pgdir(void);
 
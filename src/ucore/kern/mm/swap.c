@@ -2,6 +2,8 @@
 #include <vmm.h>
 #include <swap.h>
 #include <swapfs.h>
+#include <dcache.h>
+#include <pagecache.h>
 #include <slab.h>
 #include <assert.h>
 #include <stdio.h>
@@ -39,15 +41,16 @@ Software Design Rule:
 
 Page Replacement algorithm:
 ----------------------------
-(an simplified Linux page replacement algorithm)
-  ucore implements a simple modified version of LRU, called the two-list strategy. Instead of maintaining one list, 
-the LRU list, ucore keeps two lists: the active list and the inactive list. Pages on the active list are considered “hot” 
-and are not available to evict. Pages on the inactive list are available to evict. Pages are placed on the active list 
-when ucore need more free pages or when they are accessed while already residing on the inactive list. Both lists are 
-maintained in a pseudo-LRU manner: Items are added to the tail and removed from the head, as with a queue. If there are no 
-enough free page to alloc, the page items from the active list are moved back to the inactive list, making them available 
-to evict. The two-list strategy solves the only-used-once failure in a classic LRU and also enables simpler, pseudo-LRU 
-semantics to perform well.This two-list approach is also known as LRU/2; it can be generalized to n-lists, called LRU/n. 
+(a simplified Linux multi-generational LRU)
+  Instead of an active and an inactive list, ucore sorts pages into NR_GENS generations by the time they were last seen
+accessed. A new generation is started every round of kswapd, the youngest one has the sequence number lru_max_seq and
+each page records in lru_seq the generation in which it was last seen accessed. The accessed bits of the ptes are
+harvested in batches, by walking the page tables of an mm one page table at a time and stamping the pages found
+accessed with lru_max_seq, which also tells how many pages of the mm were used in the last WSS_GENS generations, its
+working set. A page can only be swapped out after NR_GENS - 1 generations without being accessed, and the mm with
+the most pages out of its working set is asked first. The pages in the swap cache are kept in a list per generation
+in the same way: they are written to the swap device from the oldest generation, in clusters of consecutive swap
+entries, each cluster in one request to the disk.
 
 Implementation:
 ----------------------------
@@ -62,34 +65,39 @@ to process this exception:
   
   If there are no free page frame, then ucore will find&replace some used page frame to swap out to swap space. The key function of 
 swap implementation is in kswapd_main(swap.c::proj11::lab3), and the steps are shown below:
-  0 ucore first builds two page list (active_list & inactive_list) for active page(hot accessed) frames and inactive page frames
-    (not accessed in currently past). ucore wants to evict inactive page frames to produce more free page frames.
+  0 the swap cache pages are kept in the generation lists lru_lists, a page is on the list of the generation in which it
+    entered the swap cache or was found referenced by page_launder.
   1 try_free_pages(swap.c) will calculate pressure(swap.c) to estimate the number(pressure<<5) of needed page frames in ucore currently, 
      then call kswapd kernel thread.
   2 kswapd kernel thread (wake up by try_free_pages OR timer(sched.[ch]::proj10.4::lab3)) will call kswapd_main to evict N=pressure<<5 
     page frames.
-    2.1 call swap_out_mm to try to evict N page frames in inactive page list from each process's mm struct.
-    2.2 call page_launder & refill_inactive_scan to try to change some active page frames to inactive page frames and
-    swap out some inactive swap page frame to swap space(disk).
+    2.1 call swap_out_mm to unmap the old pages of the mm picked by lru_gen_pick_mm, and walk the page tables of every mm
+    with lru_gen_walk_all if that was not enough.
+    2.2 call page_launder to free the unreferenced pages of the older generations, writing the dirty ones to the swap
+    space(disk), and lru_gen_inc_seq to start a new generation.
 */
 
 // the max offset of swap entry
 size_t max_swap_offset;
 
-// the list of pages for swap
-typedef struct {
-    list_entry_t swap_list;
-    size_t nr_pages;
-} swap_list_t;
+// the number of generations, a page must not be accessed in NR_GENS - 1
+// of them to be swapped out
+#define NR_GENS                         4
+// the pages accessed in the last WSS_GENS generations are the working set of an mm
+#define WSS_GENS                        2
 
-// there are two swap list: active_list & inactive_list
-// active page list. Items in active_list may move to inactive_list.
-static swap_list_t active_list;
-// inactive page list, will be evicted if ucore need more free page frames
-static swap_list_t inactive_list;
+// the generation lists of the swap cache pages, from lru_min_seq to lru_max_seq
+static list_entry_t lru_lists[NR_GENS];
+static size_t nr_lru_pages;
 
-#define nr_active_pages                 (active_list.nr_pages)
-#define nr_inactive_pages               (inactive_list.nr_pages)
+// the youngest generation
+unsigned int lru_max_seq;
+
+#define lru_min_seq()                   (lru_max_seq - (NR_GENS - 1))
+#define lru_list(seq)                   (lru_lists + (seq) % NR_GENS)
+
+// the counters of the page replacement, see do_vmstat
+struct vmstat vmstat;
 
 // the array element is used to record the offset of swap entry
 // the value of array element is the reference number of swap out page
@@ -118,48 +126,33 @@ static semaphore_t swap_in_sem;
 static volatile int pressure = 0;
 static wait_queue_t kswapd_done;
 
-// swap_list_init - initialize the swap list
-static void
-swap_list_init(swap_list_t *list) {
-    list_init(&(list->swap_list));
-    list->nr_pages = 0;
-}
-
-// swap_active_list_add - add the page to active_list
+// lru_add - add the page to the list of generation seq
 static inline void
-swap_active_list_add(struct Page *page) {
+lru_add(struct Page *page, unsigned int seq) {
     assert(PageSwap(page));
-    SetPageActive(page);
-    swap_list_t *list = &active_list;
-    list->nr_pages ++;
-    list_add_before(&(list->swap_list), &(page->swap_link));
+    nr_lru_pages ++;
+    list_add_before(lru_list(seq), &(page->swap_link));
 }
 
-// swap_inactive_list_add - add the page to inactive_list
+// lru_del - delete page from its generation list
 static inline void
-swap_inactive_list_add(struct Page *page) {
+lru_del(struct Page *page) {
     assert(PageSwap(page));
-    ClearPageActive(page);
-    swap_list_t *list = &inactive_list;
-    list->nr_pages ++;
-    list_add_before(&(list->swap_list), &(page->swap_link));
-}
-
-// swap_list_del - delete page from the swap list
-static inline void
-swap_list_del(struct Page *page) {
-    assert(PageSwap(page));
-    (PageActive(page) ? &active_list : &inactive_list)->nr_pages --;
+    nr_lru_pages --;
     list_del(&(page->swap_link));
 }
 
-// swap_init - init swap fs, two swap lists, alloc memory & init for swap_entry record array mem_map
+// swap_init - init swap fs, the generation lists, alloc memory & init for swap_entry record array mem_map
 //           - init the hash list.
 void
 swap_init(void) {
     swapfs_init();
-    swap_list_init(&active_list);
-    swap_list_init(&inactive_list);
+
+    int i;
+    for (i = 0; i < NR_GENS; i ++) {
+        list_init(lru_lists + i);
+    }
+    nr_lru_pages = 0;
 
     if (!(1024 <= max_swap_offset && max_swap_offset < MAX_SWAP_OFFSET_LIMIT)) {
         panic("bad max_swap_offset %08x.\n", max_swap_offset);
@@ -173,7 +166,6 @@ swap_init(void) {
         mem_map[offset] = SWAP_UNUSED;
     }
 
-    int i;
     for (i = 0; i < HASH_LIST_SIZE; i ++) {
         list_init(hash_list + i);
     }
@@ -183,6 +175,7 @@ swap_init(void) {
     check_swap();
     check_mm_swap();
     check_mm_shm_swap();
+    memset(&vmstat, 0, sizeof(struct vmstat));
 
     wait_queue_init(&kswapd_done);
     swap_init_ok = 1;
@@ -295,7 +288,8 @@ try_alloc_swap_entry(void) {
             empty = next;
             break;
         case 0:
-            if (zero == 0) {
+            // not the one page_launder is writing to
+            if (zero == 0 && !PageWriteback(swap_hash_find(next << 8))) {
                 zero = next;
             }
             break;
@@ -313,7 +307,7 @@ try_alloc_swap_entry(void) {
         entry = (zero << 8);
         struct Page *page = swap_hash_find(entry);
         assert(page != NULL && PageSwap(page));
-        swap_list_del(page);
+        lru_del(page);
         if (page_ref(page) == 0) {
             swap_free_page(page);
         }
@@ -330,7 +324,7 @@ try_alloc_swap_entry(void) {
     return entry;
 }
 
-// swap_remove_entry - call swap_list_del to remove page from swap hash list,
+// swap_remove_entry - call lru_del to remove page from its generation list,
 //                   - and call swap_free_page to generate a free page 
 void
 swap_remove_entry(swap_entry_t entry) {
@@ -342,7 +336,7 @@ swap_remove_entry(swap_entry_t entry) {
             if (page_ref(page) != 0) {
                 return ;
             }
-            swap_list_del(page);
+            lru_del(page);
             swap_free_page(page);
         }
         mem_map[offset] = SWAP_UNUSED;
@@ -369,7 +363,7 @@ swap_duplicate(swap_entry_t entry) {
 }
 
 // swap_in_page - swap in a content of a page frame from swap space to memory
-//              - set the PG_swap flag in this page and add this page to swap active list
+//              - set the PG_swap flag in this page and add this page to the youngest generation
 int
 swap_in_page(swap_entry_t entry, struct Page **pagep) {
     if (pagep == NULL) {
@@ -403,8 +397,9 @@ swap_in_page(swap_entry_t entry, struct Page **pagep) {
         ret = -E_SWAP_FAULT;
         goto failed_unlock;
     }
+    vmstat.pgmajfault ++;
     swap_page_add(page, entry);
-    swap_active_list_add(page);
+    lru_add(page, lru_max_seq);
 
 found_unlock:
     up(&swap_in_sem);
@@ -418,7 +413,7 @@ failed_unlock:
 }
 
 // swap_copy_entry - copy a content of swap out page frame to a new page
-//                 - set this new page PG_swap flag and add to swap active list
+//                 - set this new page PG_swap flag and add to the youngest generation
 int
 swap_copy_entry(swap_entry_t entry, swap_entry_t *store) {
     if (store == NULL) {
@@ -438,7 +433,7 @@ swap_copy_entry(swap_entry_t entry, swap_entry_t *store) {
     if (!swap_page_add(newpage, 0)) {
         goto failed_free_page;
     }
-    swap_active_list_add(newpage);
+    lru_add(newpage, lru_max_seq);
     memcpy(page2kva(newpage), page2kva(page), PGSIZE);
     *store = newpage->index;
     ret = 0;
@@ -463,67 +458,179 @@ try_free_swap_entry(swap_entry_t entry) {
     return 0;
 }
 
-// page_launder - try to move page to swap_active_list OR swap_inactive_list, 
-//              - and call swap_fs_write to swap out pages in swap_inactive_list
+// swap_writeback - write the n pages page_launder took from the generation
+//                - lists to the swap device, a request per run of consecutive
+//                - swap entries, and free the pages nobody referenced meanwhile
 static int
-page_launder(void) {
-    size_t maxscan = nr_inactive_pages, free_count = 0;
-    list_entry_t *list = &(inactive_list.swap_list), *le = list_next(list);
-    while (maxscan -- > 0 && le != list) {
-        struct Page *page = le2page(le, swap_link);
-        le = list_next(le);
-        if (!(PageSwap(page) && !PageActive(page))) {
-            panic("inactive: wrong swap list.\n");
+swap_writeback(struct Page **cluster, int n) {
+    int i, j, k, free_count = 0;
+    for (i = 1; i < n; i ++) {
+        struct Page *page = cluster[i];
+        for (j = i; j > 0 && cluster[j - 1]->index > page->index; j --) {
+            cluster[j] = cluster[j - 1];
+        }
+        cluster[j] = page;
+    }
+    for (i = 0; i < n; i = j) {
+        size_t offset = swap_offset(cluster[i]->index);
+        for (j = i + 1; j < n && swap_offset(cluster[j]->index) == offset + (j - i); j ++) {
+            /* nothing */ ;
         }
-        swap_list_del(page);
-        if (page_ref(page) != 0) {
-            swap_active_list_add(page);
+        vmstat.swpwrite ++, vmstat.pswpout += j - i;
+        if (swapfs_write_cluster(cluster[i]->index, cluster + i, j - i) != 0) {
+            for (k = i; k < j; k ++) {
+                SetPageDirty(cluster[k]);
+            }
+        }
+    }
+    for (i = 0; i < n; i ++) {
+        struct Page *page = cluster[i];
+        ClearPageWriteback(page);
+        if (page_ref_dec(page) != 0 || PageDirty(page)) {
+            lru_add(page, lru_max_seq);
             continue ;
         }
-        swap_entry_t entry = page->index;
-        if (!try_free_swap_entry(entry)) {
-            if (PageDirty(page)) {
-                ClearPageDirty(page);
-                page_ref_inc(page);
-                if (swapfs_write(entry, page) != 0) {
-                    SetPageDirty(page);
+        try_free_swap_entry(page->index);
+        free_count ++;
+        swap_free_page(page);
+    }
+    return free_count;
+}
+
+// page_launder - free the unreferenced pages of the generations older than the youngest, from the oldest one,
+//              - the dirty ones are written to the swap device first, see swap_writeback. the pages referenced
+//              - again are moved to the youngest generation.
+static int
+page_launder(void) {
+    size_t maxscan = nr_lru_pages, free_count = 0;
+    unsigned int seq;
+    for (seq = lru_min_seq(); seq != lru_max_seq; seq ++) {
+        list_entry_t *list = lru_list(seq), *le;
+        while (maxscan > 0 && (le = list_next(list)) != list) {
+            struct Page *cluster[MAX_SWAP_CLUSTER];
+            int n = 0;
+            while (maxscan > 0 && le != list && n < MAX_SWAP_CLUSTER) {
+                struct Page *page = le2page(le, swap_link);
+                le = list_next(le), maxscan --;
+                if (!PageSwap(page)) {
+                    panic("lru: wrong swap list.\n");
                 }
-                if (page_ref_dec(page) != 0) {
-                    swap_active_list_add(page);
+                lru_del(page);
+                if (page_ref(page) != 0) {
+                    lru_add(page, lru_max_seq);
                     continue ;
                 }
-                if (PageDirty(page)) {
-                    swap_inactive_list_add(page);
+                if (!try_free_swap_entry(page->index) && PageDirty(page)) {
+                    ClearPageDirty(page);
+                    page_ref_inc(page);
+                    SetPageWriteback(page);
+                    cluster[n ++] = page;
                     continue ;
                 }
-                try_free_swap_entry(entry);
+                free_count ++;
+                swap_free_page(page);
+            }
+            // the list may change while writing, start again from its head
+            if (n != 0) {
+                free_count += swap_writeback(cluster, n);
             }
         }
-        free_count ++;
-        swap_free_page(page);
     }
     return free_count;
 }
 
-// refill_inactive_scan - try to move page in swap_active_list into swap_inactive_list
+// lru_gen_inc_seq - start a new generation, the oldest one is merged into the next
+static void
+lru_gen_inc_seq(void) {
+    list_entry_t *oldest = lru_list(lru_min_seq()), *next = lru_list(lru_min_seq() + 1), *le;
+    while ((le = list_prev(oldest)) != oldest) {
+        list_del(le);
+        list_add(next, le);
+    }
+    lru_max_seq ++;
+}
+
+// lru_gen_walk_mm - clear the accessed bits of the ptes of mm, a page table at a time, stamping the pages
+//                 - found accessed with the youngest generation, and count the pages mm has mapped and
+//                 - the ones of its working set. mm is skipped if it is locked, its vmas and page tables
+//                 - may be changing.
 static void
-refill_inactive_scan(void) {
-    size_t maxscan = nr_active_pages;
-    list_entry_t *list = &(active_list.swap_list), *le = list_next(list);
-    while (maxscan -- > 0 && le != list) {
-        struct Page *page = le2page(le, swap_link);
-        le = list_next(le);
-        if (!(PageSwap(page) && PageActive(page))) {
-            panic("active: wrong swap list.\n");
+lru_gen_walk_mm(struct mm_struct *mm) {
+    size_t rss = 0, wss = 0;
+    bool flush = 0;
+    if (!try_lock_mm(mm)) {
+        return ;
+    }
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct vma_struct *vma = le2vma(le, list_link);
+        uintptr_t addr = vma->vm_start, end;
+        while (addr < vma->vm_end) {
+            if ((end = ROUNDDOWN(addr + PTSIZE, PTSIZE)) > vma->vm_end) {
+                end = vma->vm_end;
+            }
+            pde_t pde = mm->pgdir[PDX(addr)];
+            // a page table shared since fork is left alone, see swap_out_vma
+            if (!(pde & PTE_P) || !(pde & PTE_W)) {
+                addr = end;
+                continue ;
+            }
+            pte_t *ptep = (pte_t *)KADDR(PDE_ADDR(pde)) + PTX(addr);
+            for (; addr < end; addr += PGSIZE, ptep ++) {
+                if (!(*ptep & PTE_P)) {
+                    continue ;
+                }
+                struct Page *page = pte2page(*ptep);
+                if (PageReserved(page) || PageCache(page)) {
+                    continue ;
+                }
+                vmstat.pgscan ++, rss ++;
+                if (*ptep & PTE_A) {
+                    *ptep &= ~PTE_A;
+                    lru_gen_touch(page);
+                    flush = 1;
+                }
+                if (lru_max_seq - page->lru_seq < WSS_GENS) {
+                    wss ++;
+                }
+            }
         }
-        if (page_ref(page) == 0) {
-            swap_list_del(page);
-            swap_inactive_list_add(page);
+    }
+    if (flush) {
+        tlb_invalidate_all(mm->pgdir);
+    }
+    mm->lru_rss = rss, mm->lru_wss = wss;
+    unlock_mm(mm);
+}
+
+// lru_gen_walk_all - call lru_gen_walk_mm on every mm
+static void
+lru_gen_walk_all(void) {
+    list_entry_t *list = &proc_mm_list, *le = list;
+    while ((le = list_next(le)) != list) {
+        lru_gen_walk_mm(le2mm(le, proc_mm_link));
+    }
+}
+
+// lru_gen_pick_mm - pick the mm with the most pages out of its working set at the last walk,
+//                 - or the first one, and move it to the tail of proc_mm_list
+static struct mm_struct *
+lru_gen_pick_mm(void) {
+    list_entry_t *list = &proc_mm_list, *le = list, *pick = list_next(list);
+    size_t max_cold = 0;
+    while ((le = list_next(le)) != list) {
+        struct mm_struct *mm = le2mm(le, proc_mm_link);
+        if (mm->lru_rss > mm->lru_wss + max_cold) {
+            max_cold = mm->lru_rss - mm->lru_wss, pick = le;
         }
     }
+    list_del(pick);
+    list_add_before(list, pick);
+    return le2mm(pick, proc_mm_link);
 }
 
-// swap_out_vma - try unmap pte & move pages into swap active list.
+// swap_out_vma - try unmap pte & move pages into the swap cache.
+//              - only the pages not accessed in the last NR_GENS - 1 generations are unmapped.
 static int
 swap_out_vma(struct mm_struct *mm, struct vma_struct *vma, uintptr_t addr, size_t require) {
     if (require == 0 || !(addr >= vma->vm_start && addr < vma->vm_end)) {
@@ -531,26 +638,52 @@ swap_out_vma(struct mm_struct *mm, struct vma_struct *vma, uintptr_t addr, size_
     }
     uintptr_t end;
     size_t free_count = 0;
+    bool flush = 0;
     addr = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(vma->vm_end, PGSIZE);
     while (addr < end && require != 0) {
         pte_t *ptep = get_pte(mm->pgdir, addr, 0);
-        if (ptep == NULL) {
+        // a page table shared since fork is only flushed from the tlb of
+        // mm here, leave it to the others, see share_range in pmm.c
+        if (ptep == NULL || !(mm->pgdir[PDX(addr)] & PTE_W)) {
             addr = ROUNDDOWN(addr + PTSIZE, PTSIZE);
             continue ;
         }
         if (*ptep & PTE_P) {
             struct Page *page = pte2page(*ptep);
             assert(!PageReserved(page));
+            if (PageCache(page)) {
+                // a file page not accessed since the last pass is only
+                // unmapped, pagecache_reclaim frees it if it is clean
+                if (*ptep & PTE_A) {
+                    *ptep &= ~PTE_A;
+                    flush = 1;
+                }
+                else {
+                    if (*ptep & PTE_D) {
+                        SetPageDirty(page);
+                    }
+                    page_ref_dec(page);
+                    *ptep = 0;
+                    tlb_invalidate(mm->pgdir, addr);
+                }
+                goto try_next_entry;
+            }
+            // a stale accessed bit in the tlb only makes the page look
+            // older, flush once for the whole vma
             if (*ptep & PTE_A) {
                 *ptep &= ~PTE_A;
-                tlb_invalidate(mm->pgdir, addr);
+                lru_gen_touch(page);
+                flush = 1;
+                goto try_next_entry;
+            }
+            if (lru_max_seq - page->lru_seq < NR_GENS - 1) {
                 goto try_next_entry;
             }
             if (!PageSwap(page)) {
                 if (!swap_page_add(page, 0)) {
                     goto try_next_entry;
                 }
-                swap_active_list_add(page);
+                lru_add(page, lru_min_seq());
             }
             else if (*ptep & PTE_D) {
                 SetPageDirty(page);
@@ -562,6 +695,10 @@ swap_out_vma(struct mm_struct *mm, struct vma_struct *vma, uintptr_t addr, size_
             tlb_invalidate(mm->pgdir, addr);
             mm->swap_address = addr + PGSIZE;
             free_count ++, require --;
+            vmstat.pgsteal ++;
+            if (mm->lru_rss > 0) {
+                mm->lru_rss --;
+            }
             if ((vma->vm_flags & VM_SHARE) && page_ref(page) == 1) {
                 uintptr_t shmem_addr = addr - vma->vm_start + vma->shmem_off;
                 pte_t *sh_ptep = shmem_get_entry(vma->shmem, shmem_addr, 0);
@@ -574,6 +711,9 @@ swap_out_vma(struct mm_struct *mm, struct vma_struct *vma, uintptr_t addr, size_
     try_next_entry:
         addr += PGSIZE;
     }
+    if (flush) {
+        tlb_invalidate_all(mm->pgdir);
+    }
     return free_count;
 }
 
@@ -623,18 +763,30 @@ kswapd_main(void *arg) {
     while (1) {
         if (pressure > 0) {
             int needs = (pressure << 5), rounds = 16;
-            list_entry_t *list = &proc_mm_list;
-            assert(!list_empty(list));
+            dcache_shrink();
+            assert(!list_empty(&proc_mm_list));
             while (needs > 0 && rounds -- > 0) {
-                list_entry_t *le = list_next(list);
-                list_del(le);
-                list_add_before(list, le);
-                struct mm_struct *mm = le2mm(le, proc_mm_link);
-                needs -= swap_out_mm(mm, (needs < 32) ? needs : 32);
+                struct mm_struct *mm = lru_gen_pick_mm();
+                int require = (needs < 32) ? needs : 32, ret;
+                if (!try_lock_mm(mm)) {
+                    continue ;
+                }
+                if ((ret = swap_out_mm(mm, require)) < require) {
+                    // nothing old enough left in mm until the next walk
+                    mm->lru_rss = mm->lru_wss;
+                }
+                unlock_mm(mm);
+                needs -= ret;
+            }
+            if (needs > 0) {
+                lru_gen_walk_all();
             }
         }
         pressure -= page_launder();
-        refill_inactive_scan();
+        if (pressure > 0) {
+            pressure -= pagecache_reclaim(pressure << 5);
+        }
+        lru_gen_inc_seq();
         if (pressure > 0) {
             if ((++ guard) >= 1000) {
                 guard = 0;
@@ -648,6 +800,42 @@ kswapd_main(void *arg) {
     }
 }
 
+// do_vmstat - copy the counters of the page replacement to store
+int
+do_vmstat(struct vmstat *store) {
+    struct mm_struct *mm = current->mm;
+    vmstat.lru_seq = lru_max_seq;
+
+    int ret;
+    lock_mm(mm);
+    {
+        ret = (copy_to_user(mm, store, &vmstat, sizeof(struct vmstat))) ? 0 : -E_INVAL;
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
+// check_lru_age - make the pages not accessed meanwhile old enough for swap_out_mm
+static void
+check_lru_age(void) {
+    int i;
+    for (i = 0; i < NR_GENS - 1; i ++) {
+        lru_gen_inc_seq();
+    }
+}
+
+// check_lru_list - is the page on the list of generation seq
+static bool
+check_lru_list(struct Page *page, unsigned int seq) {
+    list_entry_t *list = lru_list(seq), *le = list;
+    while ((le = list_next(le)) != list) {
+        if (le == &(page->swap_link)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 // check_swap - check the correctness of swap & page replacement algorithm
 static void
 check_swap(void) {
@@ -693,10 +881,10 @@ check_swap(void) {
     mem_map[1] = 1;
     assert(try_alloc_swap_entry() == 0);
 
-    // set rp1, Swap, Active, add to hash_list, active_list
+    // set rp1, Swap, add to hash_list, the youngest generation
 
     swap_page_add(rp1, entry);
-    swap_active_list_add(rp1);
+    lru_add(rp1, lru_max_seq);
     assert(PageSwap(rp1));
 
     mem_map[1] = 0;
@@ -712,39 +900,40 @@ check_swap(void) {
     assert(mem_map[1] == 1);
 
     swap_page_add(rp1, entry);
-    swap_inactive_list_add(rp1);
+    lru_add(rp1, lru_max_seq);
+    lru_gen_inc_seq();
     swap_remove_entry(entry);
     assert(PageSwap(rp1));
     assert(rp1->index == entry && mem_map[1] == 0);
 
-    // check page_launder, move page from inactive_list to active_list
+    // check page_launder, move the referenced page to the youngest generation
 
     assert(page_ref(rp1) == 1);
-    assert(nr_active_pages == 0 && nr_inactive_pages == 1);
-    assert(list_next(&(inactive_list.swap_list)) == &(rp1->swap_link));
+    assert(nr_lru_pages == 1 && list_empty(lru_list(lru_max_seq)));
+    assert(list_next(lru_list(lru_max_seq - 1)) == &(rp1->swap_link));
 
     page_launder();
-    assert(nr_active_pages == 1 && nr_inactive_pages == 0);
-    assert(PageSwap(rp1) && PageActive(rp1));
+    assert(nr_lru_pages == 1 && list_empty(lru_list(lru_max_seq - 1)));
+    assert(PageSwap(rp1) && check_lru_list(rp1, lru_max_seq));
 
     entry = try_alloc_swap_entry();
     assert(swap_offset(entry) == 1);
-    assert(!PageSwap(rp1) && nr_active_pages == 0);
-    assert(list_empty(&(active_list.swap_list)));
+    assert(!PageSwap(rp1) && nr_lru_pages == 0);
+    assert(list_empty(lru_list(lru_max_seq)));
 
-    // set rp1 inactive again
+    // set rp1 old again
 
     assert(page_ref(rp1) == 1);
     swap_page_add(rp1, 0);
     assert(PageSwap(rp1) && swap_offset(rp1->index) == 1);
-    swap_inactive_list_add(rp1);
+    lru_add(rp1, lru_min_seq());
     mem_map[1] = 1;
-    assert(nr_inactive_pages == 1);
+    assert(nr_lru_pages == 1);
     page_ref_dec(rp1);
 
     size_t count = nr_free_pages();
     swap_remove_entry(entry);
-    assert(nr_inactive_pages == 0 && nr_free_pages() == count + 1);
+    assert(nr_lru_pages == 0 && nr_free_pages() == count + 1);
 
     // check swap_out_mm
 
@@ -754,28 +943,34 @@ check_swap(void) {
     ret = swap_out_mm(mm, 0);
     assert(ret == 0);
 
+    // rp0 was mapped recently
+
+    ret = swap_out_mm(mm, 10);
+    assert(ret == 0 && (*ptep0 & PTE_P));
+
+    check_lru_age();
     ret = swap_out_mm(mm, 10);
     assert(ret == 1 && mm->swap_address == PGSIZE);
 
     ret = swap_out_mm(mm, 10);
     assert(ret == 0 && *ptep0 == entry && mem_map[1] == 1);
-    assert(PageDirty(rp0) && PageActive(rp0) && page_ref(rp0) == 0);
-    assert(nr_active_pages == 1 && list_next(&(active_list.swap_list)) == &(rp0->swap_link));
+    assert(PageDirty(rp0) && page_ref(rp0) == 0);
+    assert(nr_lru_pages == 1 && list_next(lru_list(lru_min_seq())) == &(rp0->swap_link));
 
-    // check refill_inactive_scan()
+    // check lru_gen_inc_seq()
 
-    refill_inactive_scan();
-    assert(!PageActive(rp0) && page_ref(rp0) == 0);
-    assert(nr_inactive_pages == 1 && list_next(&(inactive_list.swap_list)) == &(rp0->swap_link));
+    lru_gen_inc_seq();
+    assert(page_ref(rp0) == 0 && list_empty(lru_list(lru_max_seq)));
+    assert(nr_lru_pages == 1 && list_next(lru_list(lru_min_seq())) == &(rp0->swap_link));
 
     page_ref_inc(rp0);
     page_launder();
-    assert(PageActive(rp0) && page_ref(rp0) == 1);
-    assert(nr_active_pages == 1 && list_next(&(active_list.swap_list)) == &(rp0->swap_link));
+    assert(page_ref(rp0) == 1);
+    assert(nr_lru_pages == 1 && list_next(lru_list(lru_max_seq)) == &(rp0->swap_link));
 
     page_ref_dec(rp0);
-    refill_inactive_scan();
-    assert(!PageActive(rp0));
+    lru_gen_inc_seq();
+    assert(!check_lru_list(rp0, lru_max_seq));
 
     // save data in rp0
 
@@ -785,7 +980,7 @@ check_swap(void) {
     }
 
     page_launder();
-    assert(nr_inactive_pages == 0 && list_empty(&(inactive_list.swap_list)));
+    assert(nr_lru_pages == 0 && list_empty(lru_list(lru_max_seq - 1)));
     assert(mem_map[1] == 1);
 
     rp1 = alloc_page();
@@ -803,11 +998,11 @@ check_swap(void) {
 
     rp0 = pte2page(*ptep0);
     assert(page_ref(rp0) == 1);
-    assert(PageSwap(rp0) && PageActive(rp0));
+    assert(PageSwap(rp0) && check_lru_list(rp0, lru_max_seq));
 
     entry = try_alloc_swap_entry();
     assert(swap_offset(entry) == 1 && mem_map[1] == SWAP_UNUSED);
-    assert(!PageSwap(rp0) && nr_active_pages == 0 && nr_inactive_pages == 0);
+    assert(!PageSwap(rp0) && nr_lru_pages == 0);
 
     // clear accessed flag
 
@@ -820,12 +1015,12 @@ check_swap(void) {
 
     // change page table
 
+    check_lru_age();
     ret = swap_out_mm(mm, 10);
     assert(ret == 1);
     assert(*ptep0 == entry && page_ref(rp0) == 0 && mem_map[1] == 1);
 
     count = nr_free_pages();
-    refill_inactive_scan();
     page_launder();
     assert(count + 1 == nr_free_pages());
 
@@ -854,13 +1049,12 @@ check_swap(void) {
 
     rp0 = pte2page(*ptep0);
     rp1 = pte2page(*ptep1);
-    assert(!PageSwap(rp0) && PageSwap(rp1) && PageActive(rp1));
+    assert(!PageSwap(rp0) && PageSwap(rp1) && check_lru_list(rp1, lru_max_seq));
 
     entry = try_alloc_swap_entry();
     assert(!PageSwap(rp0) && !PageSwap(rp1));
     assert(swap_offset(entry) == 1 && mem_map[1] == SWAP_UNUSED);
-    assert(list_empty(&(active_list.swap_list)));
-    assert(list_empty(&(inactive_list.swap_list)));
+    assert(nr_lru_pages == 0);
 
     page_insert(pgdir, rp0, PGSIZE, perm | PTE_A);
 
@@ -873,11 +1067,11 @@ check_swap(void) {
     assert((*ptep0 & PTE_P) && !(*ptep0 & PTE_A));
     assert((*ptep1 & PTE_P) && !(*ptep1 & PTE_A));
 
+    check_lru_age();
     ret = swap_out_mm(mm, 2);
     assert(ret == 2);
     assert(mem_map[1] == 2 && page_ref(rp0) == 0);
 
-    refill_inactive_scan();
     page_launder();
     assert(mem_map[1] == 2 && swap_hash_find(entry) == NULL);
 
@@ -910,13 +1104,15 @@ check_swap(void) {
 
     // free memory
 
-    swap_list_del(rp0), swap_list_del(rp1);
+    lru_del(rp0), lru_del(rp1);
     swap_page_del(rp0), swap_page_del(rp1);
 
     assert(page_ref(rp0) == 1 && page_ref(rp1) == 1);
-    assert(nr_active_pages == 0 && list_empty(&(active_list.swap_list)));
-    assert(nr_inactive_pages == 0 && list_empty(&(inactive_list.swap_list)));
+    assert(nr_lru_pages == 0);
 
+    for (i = 0; i < NR_GENS; i ++) {
+        assert(list_empty(lru_lists + i));
+    }
     for (i = 0; i < HASH_LIST_SIZE; i ++) {
         assert(list_empty(hash_list + i));
     }
@@ -931,7 +1127,7 @@ check_swap(void) {
     mm_destroy(mm);
     check_mm_struct = NULL;
 
-    assert(nr_active_pages == 0 && nr_inactive_pages == 0);
+    assert(nr_lru_pages == 0);
     for (offset = 0; offset < max_swap_offset; offset ++) {
         mem_map[offset] = SWAP_UNUSED;
     }
@@ -1144,8 +1340,8 @@ check_mm_swap(void) {
         *(char *)addr1 = (char)(i * i);
     }
 
-    ret = 0;
-    ret += swap_out_mm(mm0, 10);
+    ret = swap_out_mm(mm0, 10);
+    check_lru_age();
     ret += swap_out_mm(mm0, 10);
     assert(ret == 4);
 
@@ -1206,7 +1402,7 @@ check_mm_swap(void) {
 
     cprintf("check_mm_swap: step4, dup_mmap ok.\n");
 
-    refill_inactive_scan();
+    lru_gen_inc_seq();
     page_launder();
     for (i = 0; i < max_swap_offset; i ++) {
         assert(mem_map[i] == SWAP_UNUSED);
@@ -1294,11 +1490,13 @@ check_mm_shm_swap(void) {
 
     // check swap
 
-    ret = swap_out_mm(mm0, 8) + swap_out_mm(mm0, 8);
-    assert(ret == 8 && nr_active_pages == 4 && nr_inactive_pages == 0);
+    ret = swap_out_mm(mm0, 8);
+    check_lru_age();
+    ret += swap_out_mm(mm0, 8);
+    assert(ret == 8 && nr_lru_pages == 4);
 
-    refill_inactive_scan();
-    assert(nr_active_pages == 0 && nr_inactive_pages == 4);
+    lru_gen_inc_seq();
+    assert(nr_lru_pages == 4 && list_empty(lru_list(lru_max_seq)));
 
     // write & read again
 
@@ -1376,7 +1574,7 @@ check_mm_shm_swap(void) {
     free_page(kva2page(mm0->pgdir));
     mm_destroy(mm0);
 
-    refill_inactive_scan();
+    lru_gen_inc_seq();
     page_launder();
     for (i = 0; i < max_swap_offset; i ++) {
         assert(mem_map[i] == SWAP_UNUSED);
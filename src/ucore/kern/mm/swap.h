@@ -3,6 +3,7 @@
 
 #include <types.h>
 #include <memlayout.h>
+#include <vmstat.h>
 
 /* *
  * swap_entry_t
@@ -28,6 +29,12 @@ extern size_t max_swap_offset;
             __offset;                                               \
         })
 
+extern unsigned int lru_max_seq;
+extern struct vmstat vmstat;
+
+// lru_gen_touch - the page was accessed in the youngest generation
+#define lru_gen_touch(page)                 ((page)->lru_seq = lru_max_seq)
+
 void swap_init(void);
 bool try_free_pages(size_t n);
 
@@ -37,6 +44,8 @@ void swap_duplicate(swap_entry_t entry);
 int swap_in_page(swap_entry_t entry, struct Page **pagep);
 int swap_copy_entry(swap_entry_t entry, swap_entry_t *store);
 
+int do_vmstat(struct vmstat *store);
+
 int kswapd_main(void *arg) __attribute__((noreturn));
 
 #endif /* !__KERN_MM_SWAP_H__ */
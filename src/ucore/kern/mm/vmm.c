@@ -11,6 +11,8 @@
 #include <shmem.h>
 #include <proc.h>
 #include <sem.h>
+#include <inode.h>
+#include <pagecache.h>
 
 /* 
   vmm design include two parts: mm_struct (mm) & vma_struct (vma)
@@ -87,6 +89,7 @@ mm_create(void) {
         mm->pgdir = NULL;
         mm->map_count = 0;
         mm->swap_address = 0;
+        mm->lru_rss = mm->lru_wss = 0;
         set_mm_count(mm, 0);
         mm->locked_by = 0;
         mm->brk_start = mm->brk = 0;
@@ -106,6 +109,9 @@ vma_create(uintptr_t vm_start, uintptr_t vm_end, uint32_t vm_flags) {
         vma->vm_flags = vm_flags;
         vma->shmem = NULL;
         vma->shmem_off = 0;
+        vma->file = NULL;
+        vma->file_off = 0;
+        vma->file_end = 0;
     }
     return vma;
 }
@@ -118,9 +124,32 @@ vma_destroy(struct vma_struct *vma) {
             shmem_destroy(vma->shmem);
         }
     }
+    if (vma->vm_flags & VM_FILE) {
+        vop_ref_dec(vma->file);
+    }
     kfree(vma);
 }
 
+// vma_dup - create a vma of range start~end, sharing the shmem or file of vma
+static struct vma_struct *
+vma_dup(struct vma_struct *vma, uintptr_t start, uintptr_t end) {
+    struct vma_struct *nvma = vma_create(start, end, vma->vm_flags);
+    if (nvma != NULL) {
+        if (vma->vm_flags & VM_SHARE) {
+            nvma->shmem = vma->shmem;
+            nvma->shmem_off = vma->shmem_off + (start - vma->vm_start);
+            shmem_ref_inc(vma->shmem);
+        }
+        if (vma->vm_flags & VM_FILE) {
+            nvma->file = vma->file;
+            nvma->file_off = vma->file_off + (start - vma->vm_start);
+            nvma->file_end = vma->file_end;
+            vop_ref_inc(vma->file);
+        }
+    }
+    return nvma;
+}
+
 // find_vma_rb - find a vma  (vma->vm_start <= addr <= vma_vm_end) in rb tree
 static inline struct vma_struct *
 find_vma_rb(rb_tree *tree, uintptr_t addr) {
@@ -353,6 +382,33 @@ mm_map_shmem(struct mm_struct *mm, uintptr_t addr, uint32_t vm_flags,
     return 0;
 }
 
+/* *
+ * mm_map_file - map [addr, addr + len) to the file node, the filesz bytes of
+ * the file at offset appear at addr and the rest reads as zeros. the pages
+ * are read into the page cache of node on page fault, see file_pgfault.
+ * */
+int
+mm_map_file(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags,
+        struct inode *node, off_t offset, size_t filesz, struct vma_struct **vma_store) {
+    if (offset < 0 || PGOFF(addr) != PGOFF(offset) || filesz > len || node == NULL) {
+        return -E_INVAL;
+    }
+    int ret;
+    struct vma_struct *vma;
+    if ((ret = mm_map(mm, addr, len, vm_flags & ~VM_FILE_SHARE, &vma)) != 0) {
+        return ret;
+    }
+    vop_ref_inc(node);
+    vma->file = node;
+    vma->file_off = offset - PGOFF(offset);
+    vma->file_end = addr + filesz;
+    vma->vm_flags |= VM_FILE | (vm_flags & VM_FILE_SHARE);
+    if (vma_store != NULL) {
+        *vma_store = vma;
+    }
+    return 0;
+}
+
 static void
 vma_resize(struct vma_struct *vma, uintptr_t start, uintptr_t end) {
     assert(start % PGSIZE == 0 && end % PGSIZE == 0);
@@ -360,9 +416,84 @@ vma_resize(struct vma_struct *vma, uintptr_t start, uintptr_t end) {
     if (vma->vm_flags & VM_SHARE) {
         vma->shmem_off += start - vma->vm_start;
     }
+    if (vma->vm_flags & VM_FILE) {
+        vma->file_off += start - vma->vm_start;
+    }
     vma->vm_start = start, vma->vm_end = end;
 }
 
+/* *
+ * mm_unshare_pt - give mm back a page table of its own at la, if it shares
+ * the one there with other mms since fork, see share_range in pmm.c. the last
+ * user just takes the table back, the others copy it. in the copy, the private
+ * pages are write protected in both tables, so the next write to them through
+ * any of the mms copies them, as copy_range did before. called with mm locked.
+ * */
+static int
+mm_unshare_pt(struct mm_struct *mm, uintptr_t la) {
+    pde_t *pdep = &(mm->pgdir[PDX(la)]);
+    if (!(*pdep & PTE_P) || (*pdep & PTE_W)) {
+        return 0;
+    }
+
+    struct Page *ptpage = pde2page(*pdep), *page = NULL;
+    if (page_ref(ptpage) > 1) {
+        if ((page = alloc_page()) == NULL) {
+            return -E_NO_MEM;
+        }
+        // alloc_page may sleep while the other users let the table go
+        if (page_ref(ptpage) == 1) {
+            free_page(page);
+            page = NULL;
+        }
+    }
+    if (page == NULL) {
+        *pdep |= PTE_W;
+        tlb_invalidate_all(mm->pgdir);
+        return 0;
+    }
+
+    pte_t *ptep = page2kva(ptpage), *nptep = page2kva(page);
+    uintptr_t start = ROUNDDOWN(la, PTSIZE);
+    struct vma_struct *vma = NULL;
+    int i;
+    for (i = 0; i < NPTEENTRY; i ++) {
+        if (ptep[i] & PTE_P) {
+            uintptr_t addr = start + i * PGSIZE;
+            if (ptep[i] & PTE_W) {
+                if (vma == NULL || addr >= vma->vm_end) {
+                    vma = find_vma(mm, addr);
+                }
+                if (vma != NULL && vma->vm_start <= addr && !(vma->vm_flags & (VM_SHARE | VM_FILE_SHARE))) {
+                    ptep[i] &= ~PTE_W;
+                }
+            }
+            page_ref_inc(pte2page(ptep[i]));
+        }
+        else if (ptep[i] != 0) {
+            swap_duplicate(ptep[i]);
+        }
+        nptep[i] = ptep[i];
+    }
+    set_page_ref(page, 1);
+    page_ref_dec(ptpage);
+    *pdep = page2pa(page) | PTE_U | PTE_W | PTE_P;
+    tlb_invalidate_all(mm->pgdir);
+    return 0;
+}
+
+// mm_unshare_range - mm_unshare_pt for the page tables covering [start, end)
+static int
+mm_unshare_range(struct mm_struct *mm, uintptr_t start, uintptr_t end) {
+    int ret;
+    for (start = ROUNDDOWN(start, PTSIZE); start != 0 && start < end; start += PTSIZE) {
+        if ((ret = mm_unshare_pt(mm, start)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
 int
 mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len) {
     uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
@@ -377,9 +508,14 @@ mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len) {
         return 0;
     }
 
+    int ret;
+    if ((ret = mm_unshare_range(mm, start, end)) != 0) {
+        return ret;
+    }
+
     if (vma->vm_start < start && end < vma->vm_end) {
         struct vma_struct *nvma;
-        if ((nvma = vma_create(vma->vm_start, start, vma->vm_flags)) == NULL) {
+        if ((nvma = vma_dup(vma, vma->vm_start, start)) == NULL) {
             return -E_NO_MEM;
         }
         vma_resize(vma, end, vma->vm_end);
@@ -418,7 +554,10 @@ mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len) {
                 insert_vma_struct(mm, vma);
             }
             else {
+                // unmap first, vma may hold the last reference of the file and its pages
+                unmap_range(mm->pgdir, un_start, un_end);
                 vma_destroy(vma);
+                continue;
             }
         }
         unmap_range(mm->pgdir, un_start, un_end);
@@ -426,6 +565,66 @@ mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len) {
     return 0;
 }
 
+/* *
+ * mm_madvise - give advice about the use of [addr, addr + len), which must be
+ * covered by vmas. MADV_DONTNEED drops the pages and swap entries of the range
+ * but keeps the vmas, so the next touch faults in zeroed anonymous pages, or
+ * the shared memory and file data again. MADV_FREE does the same for private
+ * anonymous memory only. MADV_WILLNEED reads in the swapped out pages.
+ * */
+int
+mm_madvise(struct mm_struct *mm, uintptr_t addr, size_t len, int advice) {
+    uintptr_t start = addr, end = ROUNDUP(addr + len, PGSIZE);
+    if (start % PGSIZE != 0 || !USER_ACCESS(start, end)) {
+        return -E_INVAL;
+    }
+    if (advice != MADV_DONTNEED && advice != MADV_WILLNEED && advice != MADV_FREE) {
+        return -E_INVAL;
+    }
+
+    assert(mm != NULL);
+
+    struct vma_struct *vma;
+    uintptr_t la;
+    for (la = start; la < end; la = vma->vm_end) {
+        if ((vma = find_vma(mm, la)) == NULL || la < vma->vm_start) {
+            return -E_NO_MEM;
+        }
+        if (advice == MADV_FREE && (vma->vm_flags & (VM_SHARE | VM_FILE))) {
+            return -E_INVAL;
+        }
+    }
+
+    if (advice != MADV_WILLNEED) {
+        int ret;
+        if ((ret = mm_unshare_range(mm, start, end)) != 0) {
+            return ret;
+        }
+    }
+
+    for (la = start; la < end; la = vma->vm_end) {
+        vma = find_vma(mm, la);
+        uintptr_t un_end = (end < vma->vm_end) ? end : vma->vm_end;
+        if (advice != MADV_WILLNEED) {
+            unmap_range(mm->pgdir, la, un_end);
+            continue;
+        }
+        if (!(vma->vm_flags & VM_READ)) {
+            continue;
+        }
+        for (; la < un_end; la += PGSIZE) {
+            pte_t *ptep = get_pte(mm->pgdir, la, 0);
+            if (ptep != NULL && *ptep != 0 && !(*ptep & PTE_P)) {
+                int ret;
+                if ((ret = do_pgfault(mm, 0, la)) != 0) {
+                    return ret;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
 int
 dup_mmap(struct mm_struct *to, struct mm_struct *from) {
     assert(to != NULL && from != NULL);
@@ -433,23 +632,13 @@ dup_mmap(struct mm_struct *to, struct mm_struct *from) {
     while ((le = list_prev(le)) != list) {
         struct vma_struct *vma, *nvma;
         vma = le2vma(le, list_link);
-        nvma = vma_create(vma->vm_start, vma->vm_end, vma->vm_flags);
-        if (nvma == NULL) {
+        if ((nvma = vma_dup(vma, vma->vm_start, vma->vm_end)) == NULL) {
             return -E_NO_MEM;
         }
-        else {
-            if (vma->vm_flags & VM_SHARE) {
-                nvma->shmem = vma->shmem;
-                nvma->shmem_off = vma->shmem_off;
-                shmem_ref_inc(vma->shmem);
-            }
-        }
         insert_vma_struct(to, nvma);
-        bool share = (vma->vm_flags & VM_SHARE);
-        if (copy_range(to->pgdir, from->pgdir, vma->vm_start, vma->vm_end, share) != 0) {
-            return -E_NO_MEM;
-        }
+        share_range(to->pgdir, from->pgdir, vma->vm_start, vma->vm_end);
     }
+    tlb_invalidate_all(from->pgdir);
     return 0;
 }
 
@@ -458,6 +647,21 @@ exit_mmap(struct mm_struct *mm) {
     assert(mm != NULL && mm_count(mm) == 0);
     pde_t *pgdir = mm->pgdir;
     list_entry_t *list = &(mm->mmap_list), *le = list;
+    // let go of the page tables still shared with others, see share_range
+    uintptr_t la;
+    for (la = ROUNDDOWN(USERBASE, PTSIZE); la < USERTOP; la += PTSIZE) {
+        pde_t *pdep = &(pgdir[PDX(la)]);
+        if ((*pdep & PTE_P) && !(*pdep & PTE_W)) {
+            struct Page *ptpage = pde2page(*pdep);
+            if (page_ref(ptpage) > 1) {
+                page_ref_dec(ptpage);
+                *pdep = 0;
+            }
+            else {
+                *pdep |= PTE_W;
+            }
+        }
+    }
     while ((le = list_next(le)) != list) {
         struct vma_struct *vma = le2vma(le, list_link);
         unmap_range(pgdir, vma->vm_start, vma->vm_end);
@@ -564,6 +768,33 @@ mm_brk(struct mm_struct *mm, uintptr_t addr, size_t len) {
     return 0;
 }
 
+/* *
+ * mm_get_cow_page - get a reference of the private page present at addr, and
+ * write protect it, so the next write to it through mm copies it first.
+ * returns NULL if there is no such page. the caller holds the lock of mm.
+ * */
+struct Page *
+mm_get_cow_page(struct mm_struct *mm, uintptr_t addr) {
+    struct vma_struct *vma = find_vma(mm, addr);
+    if (vma == NULL || vma->vm_start > addr || (vma->vm_flags & (VM_SHARE | VM_FILE_SHARE))) {
+        return NULL;
+    }
+    pte_t *ptep;
+    if ((ptep = get_pte(mm->pgdir, addr, 0)) == NULL || !(*ptep & PTE_P)) {
+        return NULL;
+    }
+    struct Page *page = pte2page(*ptep);
+    if (PageReserved(page) || PageSwap(page) || PageCache(page)) {
+        return NULL;
+    }
+    page_ref_inc(page);
+    if (*ptep & PTE_W) {
+        *ptep &= ~PTE_W;
+        tlb_invalidate(mm->pgdir, addr);
+    }
+    return page;
+}
+
 bool
 user_mem_check(struct mm_struct *mm, uintptr_t addr, size_t len, bool write) {
     if (mm != NULL) {
@@ -744,6 +975,56 @@ check_pgfault(void) {
     cprintf("check_pgfault() succeeded!\n");
 }
 
+/* *
+ * file_pgfault - map the page at addr of the file vma, addr is page aligned.
+ * the shared mappings and the read faults of private mappings map the page
+ * cache directly, so that the text of a program is shared by its instances.
+ * a private write fault gets a copy, the page beyond file_end is zeroed.
+ * */
+static int
+file_pgfault(struct mm_struct *mm, struct vma_struct *vma, uint32_t error_code, uintptr_t addr, uint32_t perm) {
+    if (addr >= vma->file_end) {
+        return (pgdir_alloc_page(mm->pgdir, addr, perm) != NULL) ? 0 : -E_NO_MEM;
+    }
+
+    int ret;
+    struct Page *page, *newpage;
+    if ((ret = pagecache_get_page(vma->file, vma->file_off + (addr - vma->vm_start), &page)) != 0) {
+        return ret;
+    }
+    if (vma->vm_flags & VM_FILE_SHARE) {
+        if (error_code & 2) {
+            SetPageDirty(page);
+        }
+        else {
+            perm &= ~PTE_W;
+        }
+        ret = page_insert(mm->pgdir, page, addr, perm);
+        goto out;
+    }
+    if (!(error_code & 2) && addr + PGSIZE <= vma->file_end) {
+        ret = page_insert(mm->pgdir, page, addr, perm & ~PTE_W);
+        goto out;
+    }
+
+    if ((newpage = alloc_page()) == NULL) {
+        ret = -E_NO_MEM;
+        goto out;
+    }
+    size_t len = vma->file_end - addr;
+    if (len > PGSIZE) {
+        len = PGSIZE;
+    }
+    memcpy(page2kva(newpage), page2kva(page), len);
+    memset(page2kva(newpage) + len, 0, PGSIZE - len);
+    if ((ret = page_insert(mm->pgdir, newpage, addr, perm)) != 0) {
+        free_page(newpage);
+    }
+out:
+    pagecache_put_page(page);
+    return ret;
+}
+
 // do_pgfault - interrupt handler to process the page fault execption
 int
 do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
@@ -753,6 +1034,8 @@ do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
                 current->pid, error_code, addr);
     }
 
+    vmstat.pgfault ++;
+
     bool need_unlock = 1;
     if (!try_lock_mm(mm)) {
         if (current != NULL && mm->locked_by == current->pid) {
@@ -796,14 +1079,26 @@ do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
     }
     addr = ROUNDDOWN(addr, PGSIZE);
 
-    ret = -E_NO_MEM;
     pte_t *ptep;
-
+    if ((ret = mm_unshare_pt(mm, addr)) != 0) {
+        goto failed;
+    }
+    ret = -E_NO_MEM;
     if ((ptep = get_pte(mm->pgdir, addr, 1)) == NULL) {
         goto failed;
     }
+    if ((error_code & 2) && (*ptep & PTE_P) && (*ptep & PTE_W)) {
+        // the write only hit the shared page table, or a stale tlb entry
+        ret = 0;
+        goto failed;
+    }
     if (*ptep == 0) {
-        if (!(vma->vm_flags & VM_SHARE)) {
+        if (vma->vm_flags & VM_FILE) {
+            if ((ret = file_pgfault(mm, vma, error_code, addr, perm)) != 0) {
+                goto failed;
+            }
+        }
+        else if (!(vma->vm_flags & VM_SHARE)) {
             if (pgdir_alloc_page(mm->pgdir, addr, perm) == NULL) {
                 goto failed;
             }
@@ -826,9 +1121,16 @@ do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
             }
         }
     }
+    else if ((*ptep & PTE_P) && (vma->vm_flags & VM_FILE_SHARE)) {
+        // write to a shared file page mapped by a read fault
+        assert((error_code & 2) && !(*ptep & PTE_W));
+        struct Page *page = pte2page(*ptep);
+        SetPageDirty(page);
+        page_insert(mm->pgdir, page, addr, perm);
+    }
     else {
         struct Page *page, *newpage = NULL;
-        bool cow = ((vma->vm_flags & (VM_SHARE | VM_WRITE)) == VM_WRITE), may_copy = 1;
+        bool cow = ((vma->vm_flags & (VM_SHARE | VM_FILE_SHARE | VM_WRITE)) == VM_WRITE), may_copy = 1;
 
         assert(!(*ptep & PTE_P) || ((error_code & 2) && !(*ptep & PTE_W) && cow));
         if (cow) {
@@ -12,6 +12,7 @@
 
 //pre define
 struct mm_struct;
+struct inode;
 
 // the virtual continuous memory area(vma)
 struct vma_struct {
@@ -23,6 +24,9 @@ struct vma_struct {
     list_entry_t list_link;  // linear list link which sorted by start addr of vma
     struct shmem_struct *shmem;
     size_t shmem_off;
+    struct inode *file;      // the file mapped if VM_FILE
+    off_t file_off;          // offset in file of vm_start
+    uintptr_t file_end;      // end addr of the file data, zeros after it
 };
 
 #define le2vma(le, member)                  \
@@ -36,6 +40,8 @@ struct vma_struct {
 #define VM_EXEC                 0x00000004
 #define VM_STACK                0x00000008
 #define VM_SHARE                0x00000010
+#define VM_FILE                 0x00000020  // mapping of a file, see mm_map_file
+#define VM_FILE_SHARE           0x00000040  // writes go to the file, or private copy-on-write
 
 // the control struct for a set of vma using the same PDT
 struct mm_struct {
@@ -45,6 +51,7 @@ struct mm_struct {
     pde_t *pgdir;                  // the PDT of these vma
     int map_count;                 // the count of these vma
     uintptr_t swap_address;
+    size_t lru_rss, lru_wss;       // pages mapped and pages of the working set at the last walk, see swap.c
     atomic_t mm_count;
     int locked_by;
     uintptr_t brk_start, brk;
@@ -74,7 +81,10 @@ int mm_map(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags,
         struct vma_struct **vma_store);
 int mm_map_shmem(struct mm_struct *mm, uintptr_t addr, uint32_t vm_flags,
         struct shmem_struct *shmem, struct vma_struct **vma_store);
+int mm_map_file(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags,
+        struct inode *node, off_t offset, size_t filesz, struct vma_struct **vma_store);
 int mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len);
+int mm_madvise(struct mm_struct *mm, uintptr_t addr, size_t len, int advice);
 int dup_mmap(struct mm_struct *to, struct mm_struct *from);
 void exit_mmap(struct mm_struct *mm);
 uintptr_t get_unmapped_area_with_hint(struct mm_struct *mm, uintptr_t addr, size_t len);
@@ -82,6 +92,7 @@ uintptr_t get_unmapped_area(struct mm_struct *mm, size_t len);
 int mm_brk(struct mm_struct *mm, uintptr_t addr, size_t len);
 
 int do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr);
+struct Page *mm_get_cow_page(struct mm_struct *mm, uintptr_t addr);
 bool user_mem_check(struct mm_struct *mm, uintptr_t start, size_t len, bool write);
 
 bool copy_from_user(struct mm_struct *mm, void *dst, const void *src, size_t len, bool writable);
@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <sched.h>
+#include <sched_CFS.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <elf.h>
@@ -20,6 +21,9 @@
 #include <sysfile.h>
 #include <swap.h>
 #include <mbox.h>
+#include <bcache.h>
+#include <file.h>
+#include <inode.h>
 
 /* ------------- process/thread mechanism design&implementation -------------
 (an simplified Linux process/thread mechanism )
@@ -79,12 +83,8 @@ list_entry_t proc_mm_list;
 // has list for process set based on pid
 static list_entry_t hash_list[HASH_LIST_SIZE];
 
-// idle proc
-struct proc_struct *idleproc = NULL;
 // init proc
 struct proc_struct *initproc = NULL;
-// current proc
-struct proc_struct *current = NULL;
 // swap daemon proc
 struct proc_struct *kswapd = NULL;
 
@@ -117,9 +117,14 @@ alloc_proc(void) {
         proc->rq = NULL;
         list_init(&(proc->run_link));
         proc->time_slice = 0;
+        proc->vruntime = 0;
+        proc->nice = 0;
+        proc->cpu = -1;
+        proc->on_cpu = 0;
         proc->sem_queue = NULL;
         event_box_init(&(proc->event_box));
         proc->fs_struct = NULL;
+        proc->vfork_ret = 0;
     }
     return proc;
 }
@@ -202,6 +207,14 @@ get_pid(void) {
     return last_pid;
 }
 
+// finish_switch - the first thing to do after switch_to, on the stack of the
+// new current: the context of the previous process is saved now, so it may
+// run on another cpu, or be freed by do_wait.
+static void
+finish_switch(void) {
+    mycpu()->prev->on_cpu = 0;
+}
+
 // proc_run - make process "proc" running on cpu
 // NOTE: before call switch_to, should load  base addr of "proc"'s new PDT
 void
@@ -212,10 +225,13 @@ proc_run(struct proc_struct *proc) {
         local_intr_save(intr_flag);
         {
             current = proc;
+            next->on_cpu = 1;
+            mycpu()->prev = prev;
 			pad_ldt(&next->tls);
             load_esp0(next->kstack + KSTACKSIZE);
             lcr3(next->cr3);
 			switch_to(&(prev->context), &(next->context));
+            finish_switch();
         }
         local_intr_restore(intr_flag);
     }
@@ -226,6 +242,11 @@ proc_run(struct proc_struct *proc) {
 //       after switch_to, the current proc will execute here.
 static void
 forkret(void) {
+    finish_switch();
+    // a kernel thread runs with the kernel lock, see trap
+    if (trap_in_kernel(current->tf)) {
+        kernel_lock();
+    }
     forkrets(current->tf);
 }
 
@@ -266,6 +287,7 @@ kernel_thread(int (*fn)(void *), void *arg, uint32_t clone_flags) {
     memset(&tf_struct, 0, sizeof(struct trapframe));
     tf_struct.tf_cs = KERNEL_CS;
     tf_struct.tf_ds = tf_struct.tf_es = tf_struct.tf_ss = KERNEL_DS;
+    tf_struct.tf_fs = KERNEL_CPU;
     tf_struct.tf_regs.reg_ebx = (uint32_t)fn;
     tf_struct.tf_regs.reg_edx = (uint32_t)arg;
     tf_struct.tf_eip = (uint32_t)kernel_thread_entry;
@@ -388,14 +410,14 @@ bad_mm:
 // copy_thread - setup the trapframe on the  process's kernel stack top and
 //             - setup the kernel entry point and stack of process
 static void
-copy_thread(struct proc_struct *proc, uintptr_t esp, struct trapframe *tf) {
+copy_thread(struct proc_struct *proc, uintptr_t esp, struct trapframe *tf, void (*entry)(void)) {
     proc->tf = (struct trapframe *)(proc->kstack + KSTACKSIZE) - 1;
     *(proc->tf) = *tf;
     proc->tf->tf_regs.reg_eax = 0;
     proc->tf->tf_esp = esp;
     proc->tf->tf_eflags |= FL_IF;
 
-    proc->context.eip = (uintptr_t)forkret;
+    proc->context.eip = (uintptr_t)entry;
     proc->context.esp = (uintptr_t)(proc->tf);
 }
 
@@ -489,13 +511,33 @@ put_fs(struct proc_struct *proc) {
     }
 }
 
-// do_fork - parent process for a new child process
+// vfork_done - the CLONE_VFORK child current leaves the mm of its parent by
+// exec or exit, let the parent blocked in fork_proc go on
+static void
+vfork_done(int error_code) {
+    if (current->flags & PF_VFORK) {
+        struct proc_struct *parent = current->parent;
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        {
+            current->flags &= ~PF_VFORK;
+            parent->vfork_ret = (error_code < 0) ? error_code : 0;
+            if (parent->wait_state == WT_VFORK) {
+                wakeup_proc(parent);
+            }
+        }
+        local_intr_restore(intr_flag);
+    }
+}
+
+// fork_proc - parent process for a new child process, which starts at entry
 //    1. call alloc_proc to allocate a proc_struct
 //    2. call setup_kstack to allocate a kernel stack for child process
 //    3. call copy_mm to dup OR share mm according clone_flag
 //    4. call wakup_proc to make the new child process RUNNABLE 
-int
-do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf) {
+//    5. with CLONE_VFORK, sleep until the child execs or exits, or current is killed
+static int
+fork_proc(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf, void (*entry)(void)) {
     int ret = -E_NO_FREE_PROC;
     struct proc_struct *proc;
     if (nr_process >= MAX_PROCESS) {
@@ -516,6 +558,8 @@ do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf) {
     assert(current->time_slice >= 0);
     proc->time_slice = current->time_slice / 2;
     current->time_slice -= proc->time_slice;
+    proc->vruntime = current->vruntime;
+    proc->nice = current->nice;
 
     if (setup_kstack(proc) != 0) {
         goto bad_fork_cleanup_proc;
@@ -529,7 +573,11 @@ do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf) {
     if (copy_mm(clone_flags, proc) != 0) {
         goto bad_fork_cleanup_fs;
     }
-    copy_thread(proc, stack, tf);
+    copy_thread(proc, stack, tf, entry);
+    if (clone_flags & CLONE_VFORK) {
+        proc->flags |= PF_VFORK;
+        current->vfork_ret = VFORK_PENDING;
+    }
 
     bool intr_flag;
     local_intr_save(intr_flag);
@@ -546,6 +594,24 @@ do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf) {
     wakeup_proc(proc);
 
     ret = proc->pid;
+    if (clone_flags & CLONE_VFORK) {
+        local_intr_save(intr_flag);
+        while (current->vfork_ret == VFORK_PENDING) {
+            current->state = PROC_SLEEPING;
+            current->wait_state = WT_VFORK;
+            schedule();
+            if (current->flags & PF_EXITING) {
+                // leave the child alone, it keeps our mm until it execs or exits
+                if (current->vfork_ret == VFORK_PENDING) {
+                    proc->flags &= ~PF_VFORK;
+                    current->vfork_ret = 0;
+                }
+                ret = -E_KILLED;
+                break;
+            }
+        }
+        local_intr_restore(intr_flag);
+    }
 fork_out:
     return ret;
 
@@ -560,6 +626,11 @@ bad_fork_cleanup_proc:
     goto fork_out;
 }
 
+int
+do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf) {
+    return fork_proc(clone_flags, stack, tf, forkret);
+}
+
 int
 do_exit_group(int error_code) {
     bool intr_flag;
@@ -598,6 +669,8 @@ do_exit(int error_code) {
         panic("initproc exit.\n");
     }
 
+    vfork_done(error_code);
+
     struct mm_struct *mm = current->mm;
     if (mm != NULL) {
         lcr3(boot_cr3);
@@ -693,6 +766,12 @@ load_icode(int fd, int argc, char **kargv, int envc, char **kenv) {
 
     mm->brk_start = 0;
 
+    // map the segments to the page cache of the file if possible, see mm_map_file
+    struct inode *node;
+    if (file_getnode(fd, 1, 0, &node) != 0) {
+        node = NULL;
+    }
+
     struct Page *page;
 
     struct elfhdr __elf, *elf = &__elf;
@@ -727,12 +806,20 @@ load_icode(int fd, int argc, char **kargv, int envc, char **kenv) {
         if (ph->p_flags & ELF_PF_R) vm_flags |= VM_READ;
         if (vm_flags & VM_WRITE) perm |= PTE_W;
 
-        if ((ret = mm_map(mm, ph->p_va, ph->p_memsz, vm_flags, NULL)) != 0) {
-            goto bad_cleanup_mmap;
-        }
         if (mm->brk_start < ph->p_va + ph->p_memsz) {
             mm->brk_start = ph->p_va + ph->p_memsz;
         }
+        if (node != NULL && PGOFF(ph->p_va) == PGOFF(ph->p_offset)) {
+            if ((ret = mm_map_file(mm, ph->p_va, ph->p_memsz, vm_flags,
+                            node, ph->p_offset, ph->p_filesz, NULL)) != 0) {
+                goto bad_cleanup_mmap;
+            }
+            continue ;
+        }
+
+        if ((ret = mm_map(mm, ph->p_va, ph->p_memsz, vm_flags, NULL)) != 0) {
+            goto bad_cleanup_mmap;
+        }
 
         off_t offset = ph->p_offset;
         size_t off, size;
@@ -783,6 +870,10 @@ load_icode(int fd, int argc, char **kargv, int envc, char **kenv) {
             start += size;
         }
     }
+    if (node != NULL) {
+        vop_ref_dec(node);
+        node = NULL;
+    }
     sysfile_close(fd);
 
     mm->brk_start = mm->brk = ROUNDUP(mm->brk_start, PGSIZE);
@@ -853,6 +944,9 @@ out:
 bad_cleanup_mmap:
     exit_mmap(mm);
 bad_elf_cleanup_pgdir:
+    if (node != NULL) {
+        vop_ref_dec(node);
+    }
     put_pgdir(mm);
 bad_pgdir_cleanup_mm:
     mm_destroy(mm);
@@ -909,7 +1003,7 @@ do_execve(const char *name, int argc, const char **argv, const char **env) {
     const char *path;
 
 	int envc = 0;
-	while (env[envc] != NULL)
+	while (env != NULL && env[envc] != NULL)
 		++envc;
 	
     int ret = -E_INVAL;
@@ -975,6 +1069,7 @@ do_execve(const char *name, int argc, const char **argv, const char **env) {
 	put_kargv(envc, kenv);
     de_thread(current);
     set_proc_name(current, local_name);
+    vfork_done(0);
     return 0;
 
 execve_exit:
@@ -984,6 +1079,91 @@ execve_exit:
     panic("already exit: %e.\n", ret);
 }
 
+struct spawn_args {
+    const char *name;
+    int argc;
+    const char **argv;
+    const char **env;
+    int fds[2];
+};
+
+// spawnret - the first kernel entry point of the child of do_spawn, which
+// still runs on the mm of its parent: set up the files and exec. the child
+// owns the spawn_args, its parent may be killed and return first.
+static void
+spawnret(void) {
+    finish_switch();
+    kernel_lock();
+    struct spawn_args *kargs = (struct spawn_args *)(current->tf->tf_regs.reg_ebx), __args = *kargs, *args = &__args;
+    kfree(kargs);
+    int i, ret = 0, tmp[2] = {-1, -1};
+    // dup the files aside first, fds[1] may be 0 or fds[0] may be 1
+    for (i = 0; i < 2 && ret >= 0; i ++) {
+        if (args->fds[i] >= 0 && args->fds[i] != i) {
+            ret = tmp[i] = sysfile_dup(args->fds[i], NO_FD);
+        }
+    }
+    for (i = 0; i < 2 && ret >= 0; i ++) {
+        if (tmp[i] >= 0) {
+            sysfile_close(i);
+            ret = sysfile_dup(tmp[i], i);
+        }
+    }
+    for (i = 0; i < 2; i ++) {
+        if (tmp[i] >= 0) {
+            sysfile_close(tmp[i]);
+        }
+    }
+    if (ret >= 0) {
+        ret = do_execve(args->name, args->argc, args->argv, args->env);
+    }
+    if (ret != 0) {
+        do_exit(ret);
+    }
+    kernel_unlock();
+    forkrets(current->tf);
+}
+
+// do_spawn - start argv[0] in a new child process, as a CLONE_VFORK child
+// that execs at once would, but without going back to user mode in between.
+// the child borrows the mm of current until the program is loaded, so fork
+// copies nothing, and a failed exec is returned here instead of as the exit
+// code of the child. fds, if not NULL, are the new stdin and stdout of the
+// child, -1 to keep ours.
+int
+do_spawn(const char *name, int argc, const char **argv, const char **env, const int *fds) {
+    struct mm_struct *mm = current->mm;
+    struct spawn_args *args;
+    if ((args = kmalloc(sizeof(struct spawn_args))) == NULL) {
+        return -E_NO_MEM;
+    }
+    args->name = name, args->argc = argc, args->argv = argv, args->env = env;
+    args->fds[0] = args->fds[1] = -1;
+    if (fds != NULL) {
+        lock_mm(mm);
+        if (!copy_from_user(mm, args->fds, fds, sizeof(args->fds), 0)) {
+            unlock_mm(mm);
+            kfree(args);
+            return -E_INVAL;
+        }
+        unlock_mm(mm);
+    }
+
+    struct trapframe tf = *(current->tf);
+    tf.tf_regs.reg_ebx = (uint32_t)args;
+    int ret = fork_proc(CLONE_VM | CLONE_VFORK, tf.tf_esp, &tf, spawnret);
+    // the child frees args, unless fork_proc failed before making it
+    if (ret < 0 && ret != -E_KILLED) {
+        kfree(args);
+    }
+    if (ret > 0 && current->vfork_ret != 0) {
+        int pid = ret;
+        ret = current->vfork_ret;
+        do_wait(pid, NULL);
+    }
+    return ret;
+}
+
 // do_yield - ask the scheduler to reschedule
 int
 do_yield(void) {
@@ -1057,6 +1237,10 @@ found:
         remove_links(proc);
     }
     local_intr_restore(intr_flag);
+    // the cpu which ran it may not have left its kernel stack yet
+    while (proc->on_cpu) {
+        pause();
+    }
     put_kstack(proc);
     kfree(proc);
 
@@ -1157,6 +1341,37 @@ do_sleep(unsigned int time) {
     return 0;
 }
 
+// do_usleep - like do_sleep, but for usecs microseconds, the sub-tick sleeps
+//           - use the high resolution timer, see add_hrtimer.
+int
+do_usleep(unsigned int usecs) {
+    if (usecs == 0) {
+        return 0;
+    }
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    timer_t __timer, *timer = timer_init(&__timer, current, 0);
+    current->state = PROC_SLEEPING;
+    current->wait_state = WT_TIMER;
+    add_hrtimer(timer, usecs);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    del_timer(timer);
+    return 0;
+}
+
+// do_nice - set the nice value of current process, used by CFS
+int
+do_nice(int nice) {
+    if (nice < NICE_MIN || nice > NICE_MAX) {
+        return -E_INVAL;
+    }
+    current->nice = nice;
+    return 0;
+}
+
 // do_mmap - add a vma with addr, len and flags(VM_READ/M_WRITE/VM_STACK)
 int
 do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
@@ -1206,6 +1421,58 @@ out_unlock:
     return ret;
 }
 
+/* *
+ * do_mmap_file - map len bytes of the file fd at offset, flags(MMAP_WRITE/MMAP_SHARED).
+ * the writes to a shared mapping go back to the file, the writes to a private
+ * mapping are copied on write. offset must be page aligned.
+ * */
+int
+do_mmap_file(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset) {
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL) {
+        panic("kernel thread call mmap!!.\n");
+    }
+    if (addr_store == NULL || len == 0 || offset < 0 || offset % PGSIZE != 0) {
+        return -E_INVAL;
+    }
+
+    bool shared = (mmap_flags & MMAP_SHARED), writable = (mmap_flags & MMAP_WRITE);
+    int ret;
+    struct inode *node;
+    if ((ret = file_getnode(fd, 1, shared && writable, &node)) != 0) {
+        return ret;
+    }
+
+    uintptr_t addr;
+
+    lock_mm(mm);
+    ret = -E_INVAL;
+    if (!copy_from_user(mm, &addr, addr_store, sizeof(uintptr_t), 1)) {
+        goto out_unlock;
+    }
+
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    addr = start, len = end - start;
+
+    uint32_t vm_flags = VM_READ;
+    if (writable) vm_flags |= VM_WRITE;
+    if (shared) vm_flags |= VM_FILE_SHARE;
+
+    ret = -E_NO_MEM;
+    if (addr == 0) {
+        if ((addr = get_unmapped_area(mm, len)) == 0) {
+            goto out_unlock;
+        }
+    }
+    if ((ret = mm_map_file(mm, addr, len, vm_flags, node, offset, len, NULL)) == 0) {
+        *addr_store = addr;
+    }
+out_unlock:
+    unlock_mm(mm);
+    vop_ref_dec(node);
+    return ret;
+}
+
 // do_munmap - delete vma with addr & len
 int
 do_munmap(uintptr_t addr, size_t len) {
@@ -1225,6 +1492,25 @@ do_munmap(uintptr_t addr, size_t len) {
     return ret;
 }
 
+// do_madvise - give advice about the use of the memory in [addr, addr + len)
+int
+do_madvise(uintptr_t addr, size_t len, int advice) {
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL) {
+        panic("kernel thread call madvise!!.\n");
+    }
+    if (len == 0) {
+        return 0;
+    }
+    int ret;
+    lock_mm(mm);
+    {
+        ret = mm_madvise(mm, addr, len, advice);
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
 // do_shmem - create a share memory with addr, len, flags(VM_READ/M_WRITE/VM_STACK)
 int
 do_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
@@ -1341,7 +1627,7 @@ user_main(void *arg) {
     panic("user_main execve failed.\n");
 }
 
-// init_main - the second kernel thread used to create kswapd_main & user_main kernel threads
+// init_main - the second kernel thread used to create kswapd_main, bflushd_main & user_main kernel threads
 static int
 init_main(void *arg) {
     int pid;
@@ -1351,6 +1637,13 @@ init_main(void *arg) {
     kswapd = find_proc(pid);
     set_proc_name(kswapd, "kswapd");
 
+    struct proc_struct *bflushd;
+    if ((pid = kernel_thread(bflushd_main, NULL, 0)) <= 0) {
+        panic("bflushd init failed.\n");
+    }
+    bflushd = find_proc(pid);
+    set_proc_name(bflushd, "bflushd");
+
     int ret;
     if ((ret = vfs_set_bootfs("disk0:")) != 0) {
         panic("set boot fs failed: %e.\n", ret);
@@ -1387,9 +1680,10 @@ init_main(void *arg) {
     fs_cleanup();
 
     cprintf("all user-mode processes have quit.\n");
-    assert(initproc->cptr == kswapd && initproc->yptr == NULL && initproc->optr == NULL);
-    assert(kswapd->cptr == NULL && kswapd->yptr == NULL && kswapd->optr == NULL);
-    assert(nr_process == 3);
+    assert(initproc->cptr == bflushd && initproc->yptr == NULL && initproc->optr == NULL);
+    assert(bflushd->cptr == NULL && bflushd->yptr == NULL && bflushd->optr == kswapd);
+    assert(kswapd->cptr == NULL && kswapd->yptr == bflushd && kswapd->optr == NULL);
+    assert(nr_process == 4);
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
     cprintf("init check memory pass.\n");
@@ -1415,6 +1709,7 @@ proc_init(void) {
 	idleproc->tls = SEG(STA_W | STA_R, 0x0, 0xFFFFFFFF, DPL_USER);
 	
     idleproc->pid = 0;
+    idleproc->cpu = 0;
     idleproc->state = PROC_RUNNABLE;
     idleproc->kstack = (uintptr_t)bootstack;
     idleproc->need_resched = 1;
@@ -1440,7 +1735,31 @@ proc_init(void) {
     assert(initproc != NULL && initproc->pid == 1);
 }
 
-// cpu_idle - at the end of kern_init, the first kernel thread idleproc will do below works
+// proc_init_cpu - set up the idle kernel thread of an application processor.
+//               - it's not in proc hash list, and shares the fs_struct of the first idleproc
+void
+proc_init_cpu(struct cpu *cpu) {
+    struct proc_struct *idle;
+    if ((idle = alloc_proc()) == NULL || setup_kstack(idle) != 0) {
+        panic("cannot alloc idleproc of cpu %d.\n", cpu->id);
+    }
+
+	idle->tls = SEG(STA_W | STA_R, 0x0, 0xFFFFFFFF, DPL_USER);
+
+    idle->pid = 0;
+    idle->cpu = cpu->id;
+    idle->state = PROC_RUNNABLE;
+    idle->need_resched = 1;
+    idle->fs_struct = cpus[0].idle->fs_struct;
+    fs_count_inc(idle->fs_struct);
+
+    set_proc_name(idle, "idle");
+
+    cpu->idle = cpu->proc = idle;
+}
+
+// cpu_idle - at the end of kern_init, the first kernel thread idleproc will do below works.
+//          - each application processor also ends up here, with its own idleproc.
 void
 cpu_idle(void) {
     while (1) {
@@ -9,6 +9,8 @@
 #include <sem.h>
 #include <event.h>
 #include <mmu.h>
+#include <mp.h>
+#include <rb_tree.h>
 
 // process's state in his life cycle
 enum proc_state {
@@ -68,13 +70,22 @@ struct proc_struct {
     struct run_queue *rq;                       // running queue contains Process
     list_entry_t run_link;                      // the entry linked in run queue
     int time_slice;                             // time slice for occupying the CPU
+    rb_node run_node;                           // the node in the run queue of CFS
+    uint64_t vruntime;                          // the weighted running time, see sched_CFS.c
+    int nice;                                   // the nice value, from -20 (highest) to 19
+    int cpu;                                    // the cpu which Process runs on last time, or -1
+    volatile bool on_cpu;                       // still on its cpu, until switch_to has saved the context
     sem_queue_t *sem_queue;                     // the user semaphore queue which process waits
     event_t event_box;                          // the event which process waits   
     struct fs_struct *fs_struct;                // the file related info(pwd, files_count, files_array, fs_semaphore) of process
+    int vfork_ret;                              // set by the CLONE_VFORK child when it execs or exits, see do_fork
 	struct segdesc tls;							// Thread local storage: the per-thread segdesc;
 };
 
 #define PF_EXITING                  0x00000001      // getting shutdown
+#define PF_VFORK                    0x00000002      // the parent waits until this CLONE_VFORK child execs or exits
+
+#define VFORK_PENDING               1               // vfork_ret of the parent while the child runs
 
 //the wait state
 #define WT_CHILD                    (0x00000001 | WT_INTERRUPTED)  // wait child process
@@ -88,15 +99,24 @@ struct proc_struct {
 #define WT_MBOX_SEND                (0x00000120 | WT_INTERRUPTED)  // wait the sending mbox
 #define WT_MBOX_RECV                (0x00000121 | WT_INTERRUPTED)  // wait the recving mbox
 #define WT_PIPE                     (0x00000200 | WT_INTERRUPTED)  // wait the pipe
+#define WT_FUTEX                    (0x00000300 | WT_INTERRUPTED)  // wait the futex
+#define WT_BCACHE                    0x00000400                    // wait a free block buffer
+#define WT_IDE                       0x00000500                    // wait the ide request
+#define WT_VFORK                    (0x00000600 | WT_INTERRUPTED)  // wait the CLONE_VFORK child to exec or exit
 #define WT_INTERRUPTED               0x80000000                    // the wait state could be interrupted
 
 #define le2proc(le, member)         \
     to_struct((le), struct proc_struct, member)
 
-extern struct proc_struct *idleproc, *initproc, *current;
+extern struct proc_struct *initproc;
+
+// the process running on this cpu, and the idle process of this cpu
+#define current                     (mycpu()->proc)
+#define idleproc                    (mycpu()->idle)
 extern struct proc_struct *kswapd;
 
 void proc_init(void);
+void proc_init_cpu(struct cpu *cpu);
 void proc_run(struct proc_struct *proc);
 int kernel_thread(int (*fn)(void *), void *arg, uint32_t clone_flags);
 
@@ -109,13 +129,18 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf);
 int do_exit(int error_code);
 int do_exit_group(int error_code);
 int do_execve(const char *name, int argc, const char **argv, const char **env);
+int do_spawn(const char *name, int argc, const char **argv, const char **env, const int *fds);
 int do_yield(void);
 int do_wait(int pid, int *code_store);
 int do_kill(int pid);
 int do_brk(uintptr_t *brk_store);
 int do_sleep(unsigned int time);
+int do_usleep(unsigned int usecs);
+int do_nice(int nice);
 int do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int do_mmap_file(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset);
 int do_munmap(uintptr_t addr, size_t len);
+int do_madvise(uintptr_t addr, size_t len, int advice);
 int do_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int do_modify_ldt(int func, void* ptr, uint32_t bytecount);
 
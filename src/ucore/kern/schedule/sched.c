@@ -5,187 +5,469 @@
 #include <stdio.h>
 #include <assert.h>
 #include <sched_MLFQ.h>
+#include <sched_CFS.h>
+#include <mp.h>
+#include <lapic.h>
+#include <trap.h>
+#include <x86.h>
+#include <clock.h>
 
-static list_entry_t timer_list;
+/* *
+ * Each cpu has its own run queue, protected by cpu->rq_lock. A process is
+ * woken up on the cpu where it ran last time, and a new process goes to the
+ * cpu with the fewest runnable processes. A cpu with an empty run queue
+ * steals from the others in schedule.
+ *
+ * schedule does not need the kernel lock (see sync.h), and drops it while
+ * current is switched out. A process which is woken up before its cpu has
+ * saved its context in switch_to is left in the run queue of that cpu, and
+ * it is not stolen until proc->on_cpu is cleared, see finish_switch.
+ * */
+
+/* *
+ * The timers live in a hierarchical timing wheel, as the one of Linux. tv1
+ * has a bucket for each of the next TVR_SIZE ticks, and each bucket of tvN
+ * (N > 1) covers TVR_SIZE * TVN_SIZE^(N-2) ticks, whose timers are cascaded
+ * into the lower wheel when the index of that wheel wraps. So adding and
+ * deleting a timer is O(1), and a tick only runs the timers in one bucket.
+ * Each cpu has its own wheel and lock, runs it on its own clock tick, and
+ * adds the timers of the processes running on it, so the cpus don't contend
+ * for the timers. A timer stays in its wheel if the process moves away, it
+ * keeps the lock of the wheel to be deleted from there.
+ *
+ * The sub-tick timers of add_hrtimer are kept in hrtimer_list, sorted by the
+ * deadline, and expire on the one-shot local APIC timer of the BSP.
+ * */
+
+#define TVN_BITS                6
+#define TVR_BITS                8
+#define TVN_SIZE                (1 << TVN_BITS)
+#define TVR_SIZE                (1 << TVR_BITS)
+#define TVN_MASK                (TVN_SIZE - 1)
+#define TVR_MASK                (TVR_SIZE - 1)
+
+// the index of the wheel tv(n + 2) at the next tick to run
+#define TV_INDEX(wheel, n)      (((wheel)->timer_ticks >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+// timeouts beyond this are treated as expired by timer_wheel_add
+#define MAX_TIMER_TICKS         0x7FFFFFFF
+
+struct timer_wheel {
+    spinlock_t lock;
+    unsigned int timer_ticks;           // the next tick to run
+    list_entry_t tv1[TVR_SIZE];
+    list_entry_t tv2[TVN_SIZE];
+    list_entry_t tv3[TVN_SIZE];
+    list_entry_t tv4[TVN_SIZE];
+    list_entry_t tv5[TVN_SIZE];
+};
+
+static struct timer_wheel timer_wheels[NCPU];
+
+static list_entry_t hrtimer_list;
+static spinlock_t hrtimer_lock;
 
 static struct sched_class *sched_class;
 
-static struct run_queue *rq;
+static inline void
+sched_class_enqueue(struct cpu *cpu, struct proc_struct *proc) {
+    if (proc != cpu->idle) {
+        sched_class->enqueue(cpu->rq, proc);
+        cpu->nr_running ++;
+    }
+}
 
 static inline void
-sched_class_enqueue(struct proc_struct *proc) {
-    if (proc != idleproc) {
-        sched_class->enqueue(rq, proc);
+sched_class_dequeue(struct cpu *cpu, struct proc_struct *proc) {
+    sched_class->dequeue(cpu->rq, proc);
+    cpu->nr_running --;
+}
+
+static inline void
+sched_class_migrate_out(struct cpu *cpu, struct proc_struct *proc) {
+    if (sched_class->migrate_out != NULL) {
+        sched_class->migrate_out(cpu->rq, proc);
     }
 }
 
 static inline void
-sched_class_dequeue(struct proc_struct *proc) {
-    sched_class->dequeue(rq, proc);
+sched_class_migrate_in(struct cpu *cpu, struct proc_struct *proc) {
+    if (sched_class->migrate_in != NULL) {
+        sched_class->migrate_in(cpu->rq, proc);
+    }
 }
 
 static inline struct proc_struct *
-sched_class_pick_next(void) {
-    return sched_class->pick_next(rq);
+sched_class_pick_next(struct cpu *cpu) {
+    return sched_class->pick_next(cpu->rq);
 }
 
 static void
 sched_class_proc_tick(struct proc_struct *proc) {
     if (proc != idleproc) {
-        sched_class->proc_tick(rq, proc);
+        sched_class->proc_tick(mycpu()->rq, proc);
     }
     else {
         proc->need_resched = 1;
     }
 }
 
-static struct run_queue __rq[4];
+static struct run_queue __rq[NCPU][4];
+
+static void
+timer_wheel_init(struct timer_wheel *wheel) {
+    int i;
+    for (i = 0; i < TVR_SIZE; i ++) {
+        list_init(wheel->tv1 + i);
+    }
+    for (i = 0; i < TVN_SIZE; i ++) {
+        list_init(wheel->tv2 + i);
+        list_init(wheel->tv3 + i);
+        list_init(wheel->tv4 + i);
+        list_init(wheel->tv5 + i);
+    }
+    wheel->timer_ticks = 0;
+    spinlock_init(&(wheel->lock));
+}
 
 void
 sched_init(void) {
-    list_init(&timer_list);
-
-    rq = __rq;
-    list_init(&(rq->rq_link));
-    rq->max_time_slice = 8;
+    int i, j;
+    for (i = 0; i < NCPU; i ++) {
+        timer_wheel_init(timer_wheels + i);
+    }
+    list_init(&hrtimer_list);
+    spinlock_init(&hrtimer_lock);
 
-    int i;
-    for (i = 1; i < sizeof(__rq) / sizeof(__rq[0]); i ++) {
-        list_add_before(&(rq->rq_link), &(__rq[i].rq_link));
-        __rq[i].max_time_slice = rq->max_time_slice * (1 << i);
+    for (i = 0; i < NCPU; i ++) {
+        struct run_queue *rq = __rq[i];
+        list_init(&(rq->rq_link));
+        rq->max_time_slice = 8;
+        for (j = 1; j < sizeof(__rq[i]) / sizeof(__rq[i][0]); j ++) {
+            list_add_before(&(rq->rq_link), &(__rq[i][j].rq_link));
+            __rq[i][j].max_time_slice = rq->max_time_slice * (1 << j);
+        }
+        cpus[i].rq = rq;
+        cpus[i].nr_running = 0;
+        spinlock_init(&(cpus[i].rq_lock));
     }
 
+    // build with DEFS+=-DSCHED_CFS to boot with the completely fair scheduler
+#ifdef SCHED_CFS
+    sched_class = &CFS_sched_class;
+#else
     sched_class = &MLFQ_sched_class;
-    sched_class->init(rq);
+#endif
+    for (i = 0; i < NCPU; i ++) {
+        sched_class->init(cpus[i].rq);
+    }
 
     cprintf("sched class: %s\n", sched_class->name);
 }
 
-void
-wakeup_proc(struct proc_struct *proc) {
+// sched_select_cpu - the started cpu with the fewest runnable processes
+static struct cpu *
+sched_select_cpu(void) {
+    struct cpu *cpu, *best = mycpu();
+    for (cpu = cpus; cpu < cpus + ncpu; cpu ++) {
+        if (cpu->started && cpu->nr_running < best->nr_running) {
+            best = cpu;
+        }
+    }
+    return best;
+}
+
+// __wakeup_proc - make proc runnable, returns 0 if it is runnable already
+static bool
+__wakeup_proc(struct proc_struct *proc) {
     assert(proc->state != PROC_ZOMBIE);
-    bool intr_flag;
+    bool intr_flag, woken = 0, kick = 0;
+    struct cpu *cpu;
     local_intr_save(intr_flag);
     {
+        cpu = (proc->cpu < 0) ? sched_select_cpu() : cpus + proc->cpu;
+        spin_lock(&(cpu->rq_lock));
         if (proc->state != PROC_RUNNABLE) {
             proc->state = PROC_RUNNABLE;
             proc->wait_state = 0;
-            sched_class_enqueue(proc);
-        }
-        else {
-            warn("wakeup runnable process.\n");
+            proc->cpu = cpu->id;
+            if (list_empty(&(proc->run_link))) {
+                sched_class_enqueue(cpu, proc);
+            }
+            kick = (cpu != mycpu() && cpu->proc == cpu->idle);
+            woken = 1;
         }
+        spin_unlock(&(cpu->rq_lock));
     }
     local_intr_restore(intr_flag);
+    if (kick) {
+        lapic_send_ipi(cpu->apicid, IRQ_OFFSET + IRQ_IPI_RESCHED);
+    }
+    return woken;
+}
+
+void
+wakeup_proc(struct proc_struct *proc) {
+    if (!__wakeup_proc(proc)) {
+        warn("wakeup runnable process.\n");
+    }
+}
+
+/* *
+ * sched_steal - take a runnable process from the run queue of another cpu.
+ * the two run queues are never locked together, the process is taken out
+ * of the old one and then handed to the new one, see migrate_out and
+ * migrate_in of sched_class. a process whose context is still being saved
+ * by its old cpu is left there.
+ * */
+static struct proc_struct *
+sched_steal(struct cpu *self) {
+    struct cpu *cpu;
+    struct proc_struct *next = NULL;
+    for (cpu = cpus; next == NULL && cpu < cpus + ncpu; cpu ++) {
+        if (cpu == self || cpu->nr_running == 0) {
+            continue;
+        }
+        if (spin_trylock(&(cpu->rq_lock))) {
+            if ((next = sched_class_pick_next(cpu)) != NULL && next->on_cpu) {
+                next = NULL;
+            }
+            if (next != NULL) {
+                sched_class_dequeue(cpu, next);
+                sched_class_migrate_out(cpu, next);
+            }
+            spin_unlock(&(cpu->rq_lock));
+        }
+    }
+    if (next != NULL) {
+        spin_lock(&(self->rq_lock));
+        sched_class_migrate_in(self, next);
+        spin_unlock(&(self->rq_lock));
+    }
+    return next;
 }
 
 void
 schedule(void) {
     bool intr_flag;
     struct proc_struct *next;
+    // the others may take the kernel lock while current sleeps, current
+    // takes it back when it runs again
+    bool locked = kernel_lock_held();
+    if (locked) {
+        kernel_unlock();
+    }
+    struct cpu *cpu = mycpu();
     local_intr_save(intr_flag);
     {
+        spin_lock(&(cpu->rq_lock));
         current->need_resched = 0;
-        if (current->state == PROC_RUNNABLE) {
-            sched_class_enqueue(current);
+        // current may have been woken up before it gets here
+        if (current->state == PROC_RUNNABLE && list_empty(&(current->run_link))) {
+            sched_class_enqueue(cpu, current);
+        }
+        if ((next = sched_class_pick_next(cpu)) != NULL) {
+            sched_class_dequeue(cpu, next);
         }
-        if ((next = sched_class_pick_next()) != NULL) {
-            sched_class_dequeue(next);
+        spin_unlock(&(cpu->rq_lock));
+        if (next == NULL && ncpu > 1) {
+            next = sched_steal(cpu);
         }
     }
     local_intr_restore(intr_flag);
     if (next == NULL) {
         next = idleproc;
     }
+    next->cpu = cpu->id;
     next->runs ++;
     if (next != current) {
         proc_run(next);
     }
+    if (locked) {
+        kernel_lock();
+    }
 }
 
+// timer_wheel_add - put timer into the bucket of its absolute expires tick
+static void
+timer_wheel_add(struct timer_wheel *wheel, timer_t *timer) {
+    unsigned int expires = timer->expires, idx = expires - wheel->timer_ticks;
+    list_entry_t *vec;
+    if (idx < TVR_SIZE) {
+        vec = wheel->tv1 + (expires & TVR_MASK);
+    }
+    else if (idx < (1 << (TVR_BITS + TVN_BITS))) {
+        vec = wheel->tv2 + ((expires >> TVR_BITS) & TVN_MASK);
+    }
+    else if (idx < (1 << (TVR_BITS + 2 * TVN_BITS))) {
+        vec = wheel->tv3 + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+    }
+    else if (idx < (1 << (TVR_BITS + 3 * TVN_BITS))) {
+        vec = wheel->tv4 + ((expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK);
+    }
+    else if ((int)idx < 0) {
+        // already expired, run it at the next tick
+        vec = wheel->tv1 + (wheel->timer_ticks & TVR_MASK);
+    }
+    else {
+        vec = wheel->tv5 + ((expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK);
+    }
+    list_add_before(vec, &(timer->timer_link));
+}
+
+// timer_wheel_cascade - move the timers of tv[index] into the lower wheels
+static int
+timer_wheel_cascade(struct timer_wheel *wheel, list_entry_t *tv, int index) {
+    list_entry_t *list = tv + index, *le;
+    while ((le = list_next(list)) != list) {
+        list_del(le);
+        timer_wheel_add(wheel, le2timer(le, timer_link));
+    }
+    return index;
+}
+
+// timer_expire - wake up the owner of an expired timer, which has been unlinked.
+// the owner may be woken up at the same time on another cpu, by what it waits
+// for along with the timer, so it is no error to find it runnable.
+static void
+timer_expire(timer_t *timer) {
+    __wakeup_proc(timer->proc);
+}
+
+// add_timer - start timer, which expires after timer->expires ticks
 void
 add_timer(timer_t *timer) {
     bool intr_flag;
     local_intr_save(intr_flag);
     {
+        struct timer_wheel *wheel = timer_wheels + mycpu()->id;
+        spin_lock(&(wheel->lock));
         assert(timer->expires > 0 && timer->proc != NULL);
         assert(list_empty(&(timer->timer_link)));
-        list_entry_t *le = list_next(&timer_list);
-        while (le != &timer_list) {
-            timer_t *next = le2timer(le, timer_link);
-            if (timer->expires < next->expires) {
-                next->expires -= timer->expires;
+        if (timer->expires > MAX_TIMER_TICKS) {
+            timer->expires = MAX_TIMER_TICKS;
+        }
+        timer->expires += wheel->timer_ticks - 1;
+        timer->lock = &(wheel->lock);
+        timer_wheel_add(wheel, timer);
+        spin_unlock(&(wheel->lock));
+    }
+    local_intr_restore(intr_flag);
+}
+
+/* *
+ * add_hrtimer - start timer, which expires after usecs microseconds. falls
+ * back to the timer wheel if usecs is not below one tick, or if there is no
+ * usable one-shot timer, in which case usecs is rounded up to ticks.
+ * */
+void
+add_hrtimer(timer_t *timer, unsigned int usecs) {
+    if (usecs >= USEC_PER_TICK || tsc_per_usec == 0) {
+        timer->expires = (usecs + USEC_PER_TICK - 1) / USEC_PER_TICK;
+        if (timer->expires == 0) {
+            timer->expires = 1;
+        }
+        add_timer(timer);
+        return;
+    }
+
+    bool intr_flag, kick = 0;
+    spin_lock_irqsave(&hrtimer_lock, intr_flag);
+    {
+        assert(timer->proc != NULL && list_empty(&(timer->timer_link)));
+        timer->lock = &hrtimer_lock;
+        timer->deadline = rdtsc() + (uint64_t)usecs * tsc_per_usec;
+        list_entry_t *le = &hrtimer_list;
+        while ((le = list_next(le)) != &hrtimer_list) {
+            if (timer->deadline < le2timer(le, timer_link)->deadline) {
                 break;
             }
-            timer->expires -= next->expires;
-            le = list_next(le);
         }
         list_add_before(le, &(timer->timer_link));
+        // reprogram the one-shot timer of the BSP for the new earliest deadline
+        if (list_next(&hrtimer_list) == &(timer->timer_link)) {
+            if (mycpu()->id == 0) {
+                lapic_oneshot(usecs);
+            }
+            else {
+                kick = 1;
+            }
+        }
+    }
+    spin_unlock_irqrestore(&hrtimer_lock, intr_flag);
+    if (kick) {
+        lapic_send_ipi(cpus[0].apicid, IRQ_OFFSET + IRQ_HRTIMER);
     }
-    local_intr_restore(intr_flag);
 }
 
+// del_timer - stop timer if it has not expired, a stopped hrtimer may cause a spurious IRQ_HRTIMER
 void
 del_timer(timer_t *timer) {
     bool intr_flag;
-    local_intr_save(intr_flag);
+    if (timer->lock == NULL) {
+        return;
+    }
+    spin_lock_irqsave(timer->lock, intr_flag);
     {
         if (!list_empty(&(timer->timer_link))) {
-            if (timer->expires != 0) {
-                list_entry_t *le = list_next(&(timer->timer_link));
-                if (le != &timer_list) {
-                    timer_t *next = le2timer(le, timer_link);
-                    next->expires += timer->expires;
-                }
-            }
             list_del_init(&(timer->timer_link));
         }
     }
-    local_intr_restore(intr_flag);
+    spin_unlock_irqrestore(timer->lock, intr_flag);
 }
 
-// Interrupt is off on access;
+// run_timer_list - called on every clock tick of each cpu, runs the timer
+// wheel of the cpu and ticks current.
 void
-del_proc_timer(struct proc_struct *proc) {
-	list_entry_t *le = &timer_list;
-	while ((le = list_next(le)) != &timer_list) {
-		timer_t *timer = le2timer(le, timer_link);
-		if (timer->proc == proc) {
-			le = list_prev(le);
-			list_del_init(&(timer->timer_link));
-		}
-	}
+run_timer_list(void) {
+    bool intr_flag;
+    struct cpu *cpu = mycpu();
+    struct timer_wheel *wheel = timer_wheels + cpu->id;
+    local_intr_save(intr_flag);
+    {
+        spin_lock(&(wheel->lock));
+        int index = wheel->timer_ticks & TVR_MASK;
+        if (index == 0 && timer_wheel_cascade(wheel, wheel->tv2, TV_INDEX(wheel, 0)) == 0
+                && timer_wheel_cascade(wheel, wheel->tv3, TV_INDEX(wheel, 1)) == 0
+                && timer_wheel_cascade(wheel, wheel->tv4, TV_INDEX(wheel, 2)) == 0) {
+            timer_wheel_cascade(wheel, wheel->tv5, TV_INDEX(wheel, 3));
+        }
+        wheel->timer_ticks ++;
+
+        list_entry_t *list = wheel->tv1 + index, *le;
+        while ((le = list_next(list)) != list) {
+            list_del_init(le);
+            timer_expire(le2timer(le, timer_link));
+        }
+        spin_unlock(&(wheel->lock));
+
+        spin_lock(&(cpu->rq_lock));
+        sched_class_proc_tick(current);
+        spin_unlock(&(cpu->rq_lock));
+    }
+    local_intr_restore(intr_flag);
 }
 
+// run_hrtimer_list - handler of IRQ_HRTIMER on the BSP, runs the expired
+// hrtimers and reprograms the one-shot timer for the next one.
 void
-run_timer_list(void) {
+run_hrtimer_list(void) {
     bool intr_flag;
-    local_intr_save(intr_flag);
+    spin_lock_irqsave(&hrtimer_lock, intr_flag);
     {
-        list_entry_t *le = list_next(&timer_list);
-        if (le != &timer_list) {
+        uint64_t now = rdtsc();
+        list_entry_t *le;
+        while ((le = list_next(&hrtimer_list)) != &hrtimer_list) {
             timer_t *timer = le2timer(le, timer_link);
-            assert(timer->expires != 0);
-            timer->expires --;
-            while (timer->expires == 0) {
-                le = list_next(le);
-                struct proc_struct *proc = timer->proc;
-                if (proc->wait_state != 0) {
-                    assert(proc->wait_state & WT_INTERRUPTED);
-                }
-                else {
-                    warn("process %d's wait_state == 0.\n", proc->pid);
-                }
-                wakeup_proc(proc);
-                del_timer(timer);
-                if (le == &timer_list) {
-                    break;
-                }
-                timer = le2timer(le, timer_link);
+            if (timer->deadline > now) {
+                // less than one tick away, see add_hrtimer
+                lapic_oneshot((uint32_t)(timer->deadline - now) / tsc_per_usec + 1);
+                break;
             }
+            list_del_init(le);
+            timer_expire(timer);
         }
-        sched_class_proc_tick(current);
     }
-    local_intr_restore(intr_flag);
+    spin_unlock_irqrestore(&hrtimer_lock, intr_flag);
 }
 
@@ -3,13 +3,23 @@
 
 #include <types.h>
 #include <list.h>
+#include <rb_tree.h>
+#include <spinlock.h>
 
 struct proc_struct;
 
+/* *
+ * timer_t - wake up proc when the timer expires. expires is the timeout in
+ * ticks given to timer_init, add_timer turns it into the absolute tick of the
+ * timer wheel of the cpu which adds it. the timers added by add_hrtimer
+ * expire at deadline instead, counted by the time-stamp counter.
+ * */
 typedef struct {
     unsigned int expires;
+    uint64_t deadline;
     struct proc_struct *proc;
     list_entry_t timer_link;
+    spinlock_t *lock;           // lock of the list holding timer_link, for del_timer
 } timer_t;
 
 #define le2timer(le, member)            \
@@ -18,8 +28,10 @@ typedef struct {
 static inline timer_t *
 timer_init(timer_t *timer, struct proc_struct *proc, int expires) {
     timer->expires = expires;
+    timer->deadline = 0;
     timer->proc = proc;
     list_init(&(timer->timer_link));
+    timer->lock = NULL;
     return timer;
 }
 
@@ -41,6 +53,10 @@ struct sched_class {
     struct proc_struct *(*pick_next)(struct run_queue *rq);
     // dealer of the time-tick
     void (*proc_tick)(struct run_queue *rq, struct proc_struct *proc);
+    // proc dequeued from rq is moving to another cpu, called with the rq_lock of rq, may be NULL
+    void (*migrate_out)(struct run_queue *rq, struct proc_struct *proc);
+    // proc from another cpu is going to run on the cpu of rq, called with the rq_lock of rq, may be NULL
+    void (*migrate_in)(struct run_queue *rq, struct proc_struct *proc);
      /* for SMP support in the future
       *  load_balance
       *	 void (*load_balance)(struct rq* rq);
@@ -55,18 +71,23 @@ struct run_queue {
     unsigned int proc_num;
     int max_time_slice;
     list_entry_t rq_link;
+    // for CFS only
+    rb_tree *cfs_tree;
+    uint64_t min_vruntime;
+    unsigned int cfs_load;
 };
 
 #define le2rq(le, member)           \
     to_struct((le), struct run_queue, member)
 
-void del_proc_timer(struct proc_struct *proc);
 void sched_init(void);
 void wakeup_proc(struct proc_struct *proc);
 void schedule(void);
 void add_timer(timer_t *timer);
+void add_hrtimer(timer_t *timer, unsigned int usecs);
 void del_timer(timer_t *timer);
 void run_timer_list(void);
+void run_hrtimer_list(void);
 
 #endif /* !__KERN_SCHEDULE_SCHED_H__ */
 
@@ -0,0 +1,179 @@
+#include <types.h>
+#include <list.h>
+#include <proc.h>
+#include <rb_tree.h>
+#include <assert.h>
+#include <sched.h>
+#include <sched_CFS.h>
+
+/* *
+ * Completely fair scheduler, after the one of Linux.
+ *
+ * Each process accumulates vruntime, its running time in ticks scaled by
+ * NICE_0_WEIGHT / weight, so a process of higher weight (lower nice) ages
+ * slower. The runnable processes are kept in an rb_tree keyed by vruntime,
+ * and the leftmost one, which got the least cpu so far, runs next. The
+ * running process is not in the tree. It runs for its share of
+ * CFS_LATENCY, or until some process in the tree is CFS_WAKEUP_GRAN behind.
+ *
+ * min_vruntime follows the smallest vruntime of the run queue and never
+ * goes back. A process woken up is placed no lower than CFS_SLEEPER_BONUS
+ * before it, so a sleeper runs soon without hoarding the time it slept.
+ * The run queues of the cpus age apart, so a process stolen by another cpu
+ * keeps its vruntime relative to min_vruntime, not the absolute value.
+ * */
+
+#define NICE_0_WEIGHT               1024
+#define CFS_TICK_VRUNTIME           (1 << 16)                       // vruntime of one tick at nice 0
+#define CFS_LATENCY                 6                               // ticks to run every process once
+#define CFS_WAKEUP_GRAN             CFS_TICK_VRUNTIME
+#define CFS_SLEEPER_BONUS           (CFS_LATENCY * CFS_TICK_VRUNTIME / 2)
+
+#define rbn2proc(node)              (to_struct(node, struct proc_struct, run_node))
+
+// the weight of nice -20 ... 19, each nice level is about 10% of cpu
+static const unsigned int nice_to_weight[NICE_MAX - NICE_MIN + 1] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+};
+
+static inline unsigned int
+proc_weight(struct proc_struct *proc) {
+    return nice_to_weight[proc->nice - NICE_MIN];
+}
+
+static int
+CFS_compare(rb_node *node1, rb_node *node2) {
+    uint64_t vruntime1 = rbn2proc(node1)->vruntime, vruntime2 = rbn2proc(node2)->vruntime;
+    if (vruntime1 < vruntime2) {
+        return -1;
+    }
+    return (vruntime1 > vruntime2) ? 1 : 0;
+}
+
+static struct proc_struct *
+CFS_leftmost(struct run_queue *rq) {
+    rb_node *node, *left;
+    if ((node = rb_node_root(rq->cfs_tree)) == NULL) {
+        return NULL;
+    }
+    while ((left = rb_node_left(rq->cfs_tree, node)) != NULL) {
+        node = left;
+    }
+    return rbn2proc(node);
+}
+
+// CFS_update_min_vruntime - move min_vruntime forward to the smallest vruntime of rq and curr
+static void
+CFS_update_min_vruntime(struct run_queue *rq, struct proc_struct *curr) {
+    struct proc_struct *left = CFS_leftmost(rq);
+    uint64_t vruntime;
+    if (left != NULL) {
+        vruntime = left->vruntime;
+        if (curr != NULL && curr->vruntime < vruntime) {
+            vruntime = curr->vruntime;
+        }
+    }
+    else if (curr != NULL) {
+        vruntime = curr->vruntime;
+    }
+    else {
+        return;
+    }
+    if (rq->min_vruntime < vruntime) {
+        rq->min_vruntime = vruntime;
+    }
+}
+
+static void
+CFS_init(struct run_queue *rq) {
+    list_init(&(rq->run_list));
+    rq->proc_num = 0;
+    if ((rq->cfs_tree = rb_tree_create(CFS_compare)) == NULL) {
+        panic("CFS: no memory for run queue.\n");
+    }
+    rq->min_vruntime = 0;
+    rq->cfs_load = 0;
+}
+
+static void
+CFS_enqueue(struct run_queue *rq, struct proc_struct *proc) {
+    assert(list_empty(&(proc->run_link)));
+    if (proc->vruntime + CFS_SLEEPER_BONUS < rq->min_vruntime) {
+        proc->vruntime = rq->min_vruntime - CFS_SLEEPER_BONUS;
+    }
+    // run_link tells sched.c whether proc is in a run queue
+    list_add_before(&(rq->run_list), &(proc->run_link));
+    rb_insert(rq->cfs_tree, &(proc->run_node));
+    proc->rq = rq;
+    rq->proc_num ++;
+    rq->cfs_load += proc_weight(proc);
+}
+
+static void
+CFS_dequeue(struct run_queue *rq, struct proc_struct *proc) {
+    assert(!list_empty(&(proc->run_link)) && proc->rq == rq);
+    list_del_init(&(proc->run_link));
+    rb_delete(rq->cfs_tree, &(proc->run_node));
+    rq->proc_num --;
+    rq->cfs_load -= proc_weight(proc);
+
+    // the slice of proc if it runs next, in proportion to its weight
+    unsigned int weight = proc_weight(proc);
+    proc->time_slice = CFS_LATENCY * weight / (rq->cfs_load + weight);
+    if (proc->time_slice == 0) {
+        proc->time_slice = 1;
+    }
+    CFS_update_min_vruntime(rq, NULL);
+}
+
+// CFS_migrate_out - make the vruntime of proc relative to rq it leaves, the unsigned wrap is undone by CFS_migrate_in
+static void
+CFS_migrate_out(struct run_queue *rq, struct proc_struct *proc) {
+    proc->vruntime -= rq->min_vruntime;
+}
+
+// CFS_migrate_in - make the relative vruntime of proc absolute on rq
+static void
+CFS_migrate_in(struct run_queue *rq, struct proc_struct *proc) {
+    proc->vruntime += rq->min_vruntime;
+}
+
+static struct proc_struct *
+CFS_pick_next(struct run_queue *rq) {
+    return CFS_leftmost(rq);
+}
+
+static void
+CFS_proc_tick(struct run_queue *rq, struct proc_struct *proc) {
+    proc->vruntime += NICE_0_WEIGHT * CFS_TICK_VRUNTIME / proc_weight(proc);
+    CFS_update_min_vruntime(rq, proc);
+    if (proc->time_slice > 0) {
+        proc->time_slice --;
+    }
+    struct proc_struct *left;
+    if (proc->time_slice == 0) {
+        proc->need_resched = 1;
+    }
+    else if ((left = CFS_leftmost(rq)) != NULL && left->vruntime + CFS_WAKEUP_GRAN < proc->vruntime) {
+        proc->need_resched = 1;
+    }
+}
+
+struct sched_class CFS_sched_class = {
+    .name = "CFS_scheduler",
+    .init = CFS_init,
+    .enqueue = CFS_enqueue,
+    .dequeue = CFS_dequeue,
+    .pick_next = CFS_pick_next,
+    .proc_tick = CFS_proc_tick,
+    .migrate_out = CFS_migrate_out,
+    .migrate_in = CFS_migrate_in,
+};
+
@@ -0,0 +1,12 @@
+#ifndef __KERN_SCHEDULE_SCHED_CFS_H__
+#define __KERN_SCHEDULE_SCHED_CFS_H__
+
+#include <sched.h>
+
+#define NICE_MIN                    (-20)
+#define NICE_MAX                    19
+
+extern struct sched_class CFS_sched_class;
+
+#endif /* !__KERN_SCHEDULE_SCHED_CFS_H__ */
+
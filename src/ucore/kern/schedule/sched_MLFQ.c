@@ -18,11 +18,26 @@ MLFQ_init(struct run_queue *rq) {
     } while (le != list);
 }
 
+// MLFQ_level - the level in rq with the same time slice as prq, which may
+// belong to the run queue of another cpu if the process has migrated.
+static struct run_queue *
+MLFQ_level(struct run_queue *rq, struct run_queue *prq) {
+    list_entry_t *list = &(rq->rq_link), *le = list;
+    do {
+        if (le2rq(le, rq_link)->max_time_slice == prq->max_time_slice) {
+            return le2rq(le, rq_link);
+        }
+        le = list_next(le);
+    } while (le != list);
+    return rq;
+}
+
 static void
 MLFQ_enqueue(struct run_queue *rq, struct proc_struct *proc) {
     assert(list_empty(&(proc->run_link)));
     struct run_queue *nrq = rq;
     if (proc->rq != NULL && proc->time_slice == 0) {
+        proc->rq = MLFQ_level(rq, proc->rq);
         nrq = le2rq(list_next(&(proc->rq->rq_link)), rq_link);
         if (nrq == rq) {
             nrq = proc->rq;
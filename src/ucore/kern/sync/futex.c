@@ -0,0 +1,137 @@
+#include <types.h>
+#include <list.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sync.h>
+#include <wait.h>
+#include <ipc.h>
+#include <proc.h>
+#include <vmm.h>
+#include <error.h>
+#include <futex.h>
+
+/* *
+ * Futex - fast user-space mutex.
+ *
+ * A futex is just an aligned int in user memory; the kernel keeps no object
+ * for it. Threads sleeping on a futex are kept in a hashed table of wait
+ * queues keyed on (mm, uaddr), so the user-space lock only enters the kernel
+ * when it is contended, and a wakeup only scans the threads hashed to the
+ * same bucket.
+ *
+ * FUTEX_WAIT checks *uaddr == val and goes to sleep atomically with respect
+ * to FUTEX_WAKE: the value is read after the page is faulted in, then no
+ * schedule happens until the thread is in the queue, and the kernel lock
+ * keeps the other cpus out meanwhile.
+ * */
+
+#define FUTEX_HASH_SHIFT        8
+#define FUTEX_HASH_SIZE         (1 << FUTEX_HASH_SHIFT)
+#define futex_hashfn(mm, uaddr) (hash32((uint32_t)(mm) ^ (uint32_t)(uaddr), FUTEX_HASH_SHIFT))
+
+typedef struct {
+    struct mm_struct *mm;
+    uintptr_t uaddr;
+    wait_t wait;
+} futex_q_t;
+
+#define le2futex_q(le, member)          \
+    to_struct(le2wait(le, wait_link), futex_q_t, member)
+
+static wait_queue_t futex_hash[FUTEX_HASH_SIZE];
+
+void
+futex_init(void) {
+    int i;
+    for (i = 0; i < FUTEX_HASH_SIZE; i ++) {
+        wait_queue_init(futex_hash + i);
+    }
+}
+
+static int
+futex_wait(struct mm_struct *mm, uintptr_t uaddr, int val, unsigned int timeout) {
+    int cur;
+    lock_mm(mm);
+    if (!copy_from_user(mm, &cur, (void *)uaddr, sizeof(int), 0)) {
+        unlock_mm(mm);
+        return -E_INVAL;
+    }
+    unlock_mm(mm);
+
+    unsigned long saved_ticks;
+    timer_t __timer, *timer = ipc_timer_init(timeout, &saved_ticks, &__timer);
+
+    wait_queue_t *queue = futex_hash + futex_hashfn(mm, uaddr);
+    futex_q_t __q, *q = &__q;
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (cur != val) {
+        local_intr_restore(intr_flag);
+        return -E_AGAIN;
+    }
+    q->mm = mm, q->uaddr = uaddr;
+    wait_current_set(queue, &(q->wait), WT_FUTEX);
+    ipc_add_timer(timer);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    ipc_del_timer(timer);
+    wait_current_del(queue, &(q->wait));
+    local_intr_restore(intr_flag);
+
+    if (q->wait.wakeup_flags == WT_FUTEX) {
+        return 0;
+    }
+    int ret = ipc_check_timeout(timeout, saved_ticks);
+    return (ret == -E_TIMEOUT) ? ret : -E_KILLED;
+}
+
+static int
+futex_wake(struct mm_struct *mm, uintptr_t uaddr, int nr_wake) {
+    wait_queue_t *queue = futex_hash + futex_hashfn(mm, uaddr);
+    int ret = 0;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        list_entry_t *list = &(queue->wait_head), *le = list_next(list);
+        while (ret < nr_wake && le != list) {
+            futex_q_t *q = le2futex_q(le, wait);
+            le = list_next(le);
+            if (q->mm == mm && q->uaddr == uaddr) {
+                wakeup_wait(queue, &(q->wait), WT_FUTEX, 1);
+                ret ++;
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+    return ret;
+}
+
+/* *
+ * do_futex - wait on or wake up the futex at user address uaddr
+ * @op:      FUTEX_WAIT, sleep if *uaddr == val, return -E_AGAIN if not
+ *           FUTEX_WAKE, wake up one thread waiting on uaddr
+ *           FUTEX_WAKE_N, wake up at most val threads waiting on uaddr
+ * @timeout: ticks to wait for FUTEX_WAIT, 0 for no timeout
+ * the wake operations return the number of threads woken up.
+ * */
+int
+do_futex(uintptr_t uaddr, int op, int val, unsigned int timeout) {
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL || uaddr % sizeof(int) != 0) {
+        return -E_INVAL;
+    }
+    switch (op) {
+    case FUTEX_WAIT:
+        return futex_wait(mm, uaddr, val, timeout);
+    case FUTEX_WAKE:
+        return futex_wake(mm, uaddr, 1);
+    case FUTEX_WAKE_N:
+        return futex_wake(mm, uaddr, val);
+    }
+    return -E_INVAL;
+}
+
@@ -0,0 +1,10 @@
+#ifndef __KERN_SYNC_FUTEX_H__
+#define __KERN_SYNC_FUTEX_H__
+
+#include <types.h>
+
+void futex_init(void);
+int do_futex(uintptr_t uaddr, int op, int val, unsigned int timeout);
+
+#endif /* !__KERN_SYNC_FUTEX_H__ */
+
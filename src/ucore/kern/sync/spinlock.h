@@ -0,0 +1,49 @@
+#ifndef __KERN_SYNC_SPINLOCK_H__
+#define __KERN_SYNC_SPINLOCK_H__
+
+#include <types.h>
+#include <x86.h>
+
+/* *
+ * spinlock_t - mutual exclusion between processors.
+ *
+ * A spinlock never sleeps, so it could be taken in interrupt context. If the
+ * same lock is also taken by an interrupt handler, the holder must disable the
+ * local interrupts first (see spin_lock_irqsave in sync.h), otherwise the
+ * handler would spin on a lock owned by the code it interrupted.
+ * */
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+static inline void
+spinlock_init(spinlock_t *lock) {
+    lock->locked = 0;
+}
+
+static inline bool
+spin_trylock(spinlock_t *lock) {
+    return xchg(&(lock->locked), 1) == 0;
+}
+
+static inline void
+spin_lock(spinlock_t *lock) {
+    while (!spin_trylock(lock)) {
+        while (lock->locked) {
+            pause();
+        }
+    }
+}
+
+static inline void
+spin_unlock(spinlock_t *lock) {
+    xchg(&(lock->locked), 0);
+}
+
+static inline bool
+spin_is_locked(spinlock_t *lock) {
+    return lock->locked != 0;
+}
+
+#endif /* !__KERN_SYNC_SPINLOCK_H__ */
+
@@ -1,8 +1,50 @@
 #include <sync.h>
 #include <mbox.h>
+#include <mp.h>
+#include <futex.h>
+
+static spinlock_t kernel_lock_lock;
+static volatile int kernel_lock_owner = -1;
+
+void
+kernel_lock(void) {
+    bool intr_flag;
+    int id = mycpu()->id;
+    assert(kernel_lock_owner != id);
+    local_intr_save(intr_flag);
+    while (!spin_trylock(&kernel_lock_lock)) {
+        // spin with interrupts on, even if they were off before a schedule:
+        // the holder may be waiting for this cpu in mp_tlb_shootdown
+        intr_enable();
+        while (spin_is_locked(&kernel_lock_lock)) {
+            pause();
+        }
+        intr_disable();
+    }
+    kernel_lock_owner = id;
+    local_intr_restore(intr_flag);
+}
+
+void
+kernel_unlock(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        assert(kernel_lock_owner == mycpu()->id);
+        kernel_lock_owner = -1;
+        spin_unlock(&kernel_lock_lock);
+    }
+    local_intr_restore(intr_flag);
+}
+
+bool
+kernel_lock_held(void) {
+    return kernel_lock_owner == mycpu()->id;
+}
 
 void
 sync_init(void) {
     mbox_init();
+    futex_init();
 }
 
@@ -6,6 +6,7 @@
 #include <mmu.h>
 #include <assert.h>
 #include <atomic.h>
+#include <spinlock.h>
 #include <sched.h>
 
 static inline bool
@@ -27,6 +28,25 @@ __intr_restore(bool flag) {
 #define local_intr_save(x)      do { x = __intr_save(); } while (0)
 #define local_intr_restore(x)   __intr_restore(x);
 
+#define spin_lock_irqsave(lock, x)          do { local_intr_save(x); spin_lock(lock); } while (0)
+#define spin_unlock_irqrestore(lock, x)     do { spin_unlock(lock); local_intr_restore(x); } while (0)
+
+/* *
+ * The kernel lock covers what is not SMP safe yet: the syscalls on files,
+ * processes, memory and ipc, the page faults, and the device interrupts. It
+ * is taken on entry of those traps and released on return to user mode, and
+ * kernel threads hold it while they run. schedule releases it while the
+ * process is switched out, so a sleeping process does not hold up the others.
+ *
+ * The run queues (cpu->rq_lock), the timer wheels (in sched.c), the page
+ * allocator (pmm_lock) and the slab caches have their own spinlocks, so the
+ * clock, the reschedule IPI, the idle loop, the context switch and the
+ * syscalls of syscall_nolock run on all cpus at once, without the kernel lock.
+ * */
+void kernel_lock(void);
+void kernel_unlock(void);
+bool kernel_lock_held(void);
+
 void sync_init(void);
 
 #endif /* !__KERN_SYNC_SYNC_H__ */
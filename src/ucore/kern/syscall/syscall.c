@@ -8,9 +8,11 @@
 #include <sem.h>
 #include <event.h>
 #include <mbox.h>
+#include <futex.h>
 #include <stat.h>
 #include <dirent.h>
 #include <sysfile.h>
+#include <swap.h>
 
 static uint32_t
 sys_modify_ldt(uint32_t arg[])
@@ -62,6 +64,16 @@ sys_exec(uint32_t arg[]) {
     return do_execve(name, argc, argv, env);
 }
 
+static uint32_t
+sys_spawn(uint32_t arg[]) {
+    const char *name = (const char *)arg[0];
+    int argc = (int)arg[1];
+    const char **argv = (const char **)arg[2];
+    const char **env = (const char **)arg[3];
+    const int *fds = (const int *)arg[4];
+    return do_spawn(name, argc, argv, env, fds);
+}
+
 static uint32_t
 sys_clone(uint32_t arg[]) {
     struct trapframe *tf = current->tf;
@@ -91,6 +103,18 @@ sys_sleep(uint32_t arg[]) {
     return do_sleep(time);
 }
 
+static uint32_t
+sys_nice(uint32_t arg[]) {
+    int nice = (int)arg[0];
+    return do_nice(nice);
+}
+
+static uint32_t
+sys_usleep(uint32_t arg[]) {
+    unsigned int usecs = (unsigned int)arg[0];
+    return do_usleep(usecs);
+}
+
 static uint32_t
 sys_kill(uint32_t arg[]) {
     int pid = (int)arg[0];
@@ -132,6 +156,16 @@ sys_mmap(uint32_t arg[]) {
     return do_mmap(addr_store, len, mmap_flags);
 }
 
+static uint32_t
+sys_mmap_file(uint32_t arg[]) {
+    uintptr_t *addr_store = (uintptr_t *)arg[0];
+    size_t len = (size_t)arg[1];
+    uint32_t mmap_flags = (uint32_t)arg[2];
+    int fd = (int)arg[3];
+    off_t offset = (off_t)arg[4];
+    return do_mmap_file(addr_store, len, mmap_flags, fd, offset);
+}
+
 static uint32_t
 sys_munmap(uint32_t arg[]) {
     uintptr_t addr = (uintptr_t)arg[0];
@@ -139,6 +173,20 @@ sys_munmap(uint32_t arg[]) {
     return do_munmap(addr, len);
 }
 
+static uint32_t
+sys_madvise(uint32_t arg[]) {
+    uintptr_t addr = (uintptr_t)arg[0];
+    size_t len = (size_t)arg[1];
+    int advice = (int)arg[2];
+    return do_madvise(addr, len, advice);
+}
+
+static uint32_t
+sys_vmstat(uint32_t arg[]) {
+    struct vmstat *store = (struct vmstat *)arg[0];
+    return do_vmstat(store);
+}
+
 static uint32_t
 sys_shmem(uint32_t arg[]) {
     uintptr_t *addr_store = (uintptr_t *)arg[0];
@@ -259,6 +307,15 @@ sys_mbox_info(uint32_t arg[]) {
     return ipc_mbox_info(id, info);
 }
 
+static uint32_t
+sys_futex(uint32_t arg[]) {
+    uintptr_t uaddr = (uintptr_t)arg[0];
+    int op = (int)arg[1];
+    int val = (int)arg[2];
+    unsigned int timeout = (unsigned int)arg[3];
+    return do_futex(uaddr, op, val, timeout);
+}
+
 static uint32_t
 sys_open(uint32_t arg[]) {
     const char *path = (const char *)arg[0];
@@ -309,6 +366,21 @@ sys_fsync(uint32_t arg[]) {
     return sysfile_fsync(fd);
 }
 
+static uint32_t
+sys_fallocate(uint32_t arg[]) {
+    int fd = (int)arg[0];
+    off_t len = (off_t)arg[1];
+    return sysfile_fallocate(fd, len);
+}
+
+static uint32_t
+sys_ioctl(uint32_t arg[]) {
+    int fd = (int)arg[0];
+    int op = (int)arg[1];
+    uint32_t data = (uint32_t)arg[2];
+    return sysfile_ioctl(fd, op, data);
+}
+
 static uint32_t
 sys_chdir(uint32_t arg[]) {
     const char *path = (const char *)arg[0];
@@ -355,6 +427,12 @@ sys_getdirentry(uint32_t arg[]) {
     return sysfile_getdirentry(fd, direntp);
 }
 
+static uint32_t
+sys_dcachestat(uint32_t arg[]) {
+    struct dcachestat *store = (struct dcachestat *)arg[0];
+    return sysfile_dcachestat(store);
+}
+
 static uint32_t
 sys_dup(uint32_t arg[]) {
     int fd1 = (int)arg[0];
@@ -375,21 +453,43 @@ sys_mkfifo(uint32_t arg[]) {
     return sysfile_mkfifo(name, open_flags);
 }
 
+static uint32_t
+sys_splice(uint32_t arg[]) {
+    int fd_in = (int)arg[0];
+    int fd_out = (int)arg[1];
+    size_t len = (size_t)arg[2];
+    return sysfile_splice(fd_in, fd_out, len);
+}
+
+static uint32_t
+sys_vmsplice(uint32_t arg[]) {
+    int fd = (int)arg[0];
+    void *base = (void *)arg[1];
+    size_t len = (size_t)arg[2];
+    return sysfile_vmsplice(fd, base, len);
+}
+
 static uint32_t (*syscalls[])(uint32_t arg[]) = {
     [SYS_exit]              sys_exit,
     [SYS_fork]              sys_fork,
     [SYS_wait]              sys_wait,
     [SYS_exec]              sys_exec,
     [SYS_clone]             sys_clone,
+    [SYS_spawn]             sys_spawn,
     [SYS_yield]             sys_yield,
     [SYS_kill]              sys_kill,
     [SYS_sleep]             sys_sleep,
+    [SYS_usleep]            sys_usleep,
+    [SYS_nice]              sys_nice,
     [SYS_gettime]           sys_gettime,
     [SYS_getpid]            sys_getpid,
     [SYS_brk]               sys_brk,
     [SYS_mmap]              sys_mmap,
     [SYS_munmap]            sys_munmap,
     [SYS_shmem]             sys_shmem,
+    [SYS_mmap_file]         sys_mmap_file,
+    [SYS_madvise]           sys_madvise,
+    [SYS_vmstat]            sys_vmstat,
     [SYS_putc]              sys_putc,
     [SYS_pgdir]             sys_pgdir,
     [SYS_sem_init]          sys_sem_init,
@@ -404,6 +504,7 @@ static uint32_t (*syscalls[])(uint32_t arg[]) = {
     [SYS_mbox_recv]         sys_mbox_recv,
     [SYS_mbox_free]         sys_mbox_free,
     [SYS_mbox_info]         sys_mbox_info,
+    [SYS_futex]             sys_futex,
     [SYS_open]              sys_open,
     [SYS_close]             sys_close,
     [SYS_read]              sys_read,
@@ -411,6 +512,8 @@ static uint32_t (*syscalls[])(uint32_t arg[]) = {
     [SYS_seek]              sys_seek,
     [SYS_fstat]             sys_fstat,
     [SYS_fsync]             sys_fsync,
+    [SYS_ioctl]             sys_ioctl,
+    [SYS_fallocate]         sys_fallocate,
     [SYS_chdir]             sys_chdir,
     [SYS_getcwd]            sys_getcwd,
     [SYS_mkdir]             sys_mkdir,
@@ -418,9 +521,12 @@ static uint32_t (*syscalls[])(uint32_t arg[]) = {
     [SYS_rename]            sys_rename,
     [SYS_unlink]            sys_unlink,
     [SYS_getdirentry]       sys_getdirentry,
+    [SYS_dcachestat]        sys_dcachestat,
     [SYS_dup]               sys_dup,
     [SYS_pipe]              sys_pipe,
     [SYS_mkfifo]            sys_mkfifo,
+    [SYS_splice]            sys_splice,
+    [SYS_vmsplice]          sys_vmsplice,
 	[SYS_modify_ldt]		sys_modify_ldt,
 	[SYS_gettimeofday]		sys_gettimeofday,
 	[SYS_exit_group]		sys_exit_group,
@@ -449,3 +555,19 @@ syscall(void) {
             num, current->pid, current->name);
 }
 
+// syscall_nolock - the syscalls which only touch current, the clock and the
+// timers, so trap runs them without the kernel lock
+bool
+syscall_nolock(int num) {
+    switch (num) {
+    case SYS_yield:
+    case SYS_sleep:
+    case SYS_usleep:
+    case SYS_gettime:
+    case SYS_gettimeofday:
+    case SYS_getpid:
+        return 1;
+    }
+    return 0;
+}
+
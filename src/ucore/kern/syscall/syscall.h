@@ -1,7 +1,10 @@
 #ifndef __KERN_SYSCALL_SYSCALL_H__
 #define __KERN_SYSCALL_SYSCALL_H__
 
+#include <types.h>
+
 void syscall(void);
+bool syscall_nolock(int num);
 
 #endif /* !__KERN_SYSCALL_SYSCALL_H__ */
 
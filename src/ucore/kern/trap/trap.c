@@ -16,6 +16,9 @@
 #include <unistd.h>
 #include <syscall.h>
 #include <error.h>
+#include <mp.h>
+#include <lapic.h>
+#include <ide.h>
 
 #define TICK_NUM 30
 
@@ -187,6 +190,7 @@ trap_dispatch(struct trapframe *tf) {
 		[SYS_mbox_recv]         "sys_mbox_recv",
 		[SYS_mbox_free]         "sys_mbox_free",
 		[SYS_mbox_info]         "sys_mbox_info",
+		[SYS_futex]             "sys_futex",
 		[SYS_open]              "sys_open",
 		[SYS_close]             "sys_close",
 		[SYS_read]              "sys_read",
@@ -244,10 +248,33 @@ trap_dispatch(struct trapframe *tf) {
         syscall();
         break;
     case IRQ_OFFSET + IRQ_TIMER:
-        ticks ++;
+        // the BSP keeps the global clock, the APs tick on their local APIC timers
+        if (mycpu()->id == 0) {
+            ticks ++;
+        }
+        else {
+            lapic_eoi();
+        }
         assert(current != NULL);
         run_timer_list();
         break;
+    case IRQ_OFFSET + IRQ_HRTIMER:
+        lapic_eoi();
+        run_hrtimer_list();
+        break;
+    case IRQ_OFFSET + IRQ_IPI_RESCHED:
+        lapic_eoi();
+        if (current != NULL) {
+            current->need_resched = 1;
+        }
+        break;
+    case IRQ_OFFSET + IRQ_SPURIOUS:
+        /* do nothing, no eoi for the spurious interrupts */
+        break;
+    case IRQ_OFFSET + IRQ_ERROR:
+        cprintf("cpu %d: lapic error.\n", mycpu()->id);
+        lapic_eoi();
+        break;
     case IRQ_OFFSET + IRQ_COM1:
     case IRQ_OFFSET + IRQ_KBD:
         if ((c = cons_getc()) == 13) {
@@ -260,7 +287,7 @@ trap_dispatch(struct trapframe *tf) {
         break;
     case IRQ_OFFSET + IRQ_IDE1:
     case IRQ_OFFSET + IRQ_IDE2:
-        /* do nothing */
+        ide_intr(tf->tf_trapno - IRQ_OFFSET);
         break;
     default:
         print_trapframe(tf);
@@ -272,8 +299,36 @@ trap_dispatch(struct trapframe *tf) {
     }
 }
 
+// trap_nolock - the traps handled without the kernel lock: the clock and the
+// reschedule IPI only touch the run queues and the timers, which have their
+// own locks, and so do the syscalls of syscall_nolock.
+static bool
+trap_nolock(struct trapframe *tf) {
+    switch (tf->tf_trapno) {
+    case IRQ_OFFSET + IRQ_TIMER:
+    case IRQ_OFFSET + IRQ_HRTIMER:
+    case IRQ_OFFSET + IRQ_IPI_RESCHED:
+    case IRQ_OFFSET + IRQ_SPURIOUS:
+        return 1;
+    case T_SYSCALL:
+        return syscall_nolock(tf->tf_regs.reg_eax);
+    }
+    return 0;
+}
+
 void
 trap(struct trapframe *tf) {
+    // the shootdown is waited by the cpu holding the kernel lock
+    if (tf->tf_trapno == IRQ_OFFSET + IRQ_IPI_TLB) {
+        mp_tlb_shootdown_ack();
+        return;
+    }
+
+    bool locked = !kernel_lock_held() && !trap_nolock(tf);
+    if (locked) {
+        kernel_lock();
+    }
+
     // used for previous projects
     if (current == NULL) {
         trap_dispatch(tf);
@@ -290,6 +345,9 @@ trap(struct trapframe *tf) {
         current->tf = otf;
         if (!in_kernel) {
             if (current->flags & PF_EXITING) {
+                if (!kernel_lock_held()) {
+                    kernel_lock();
+                }
 				if (current->exit_code == -E_KILLED)
 					do_exit(-E_KILLED);
 				else
@@ -300,5 +358,10 @@ trap(struct trapframe *tf) {
             }
         }
     }
+
+    // a kernel thread which has called execve returns to user mode here too
+    if (kernel_lock_held() && (locked || !trap_in_kernel(tf))) {
+        kernel_unlock();
+    }
 }
 
@@ -36,6 +36,9 @@
 #define IRQ_IDE1                14
 #define IRQ_IDE2                15
 #define IRQ_ERROR               19
+#define IRQ_IPI_RESCHED         20  // inter-processor interrupt, see wakeup_proc
+#define IRQ_IPI_TLB             21  // inter-processor interrupt, see mp_tlb_shootdown
+#define IRQ_HRTIMER             22  // one-shot local APIC timer of the BSP, see add_hrtimer
 #define IRQ_SPURIOUS            31
 
 /* registers as pushed by pushal */
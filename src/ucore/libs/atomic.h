@@ -3,6 +3,9 @@
 
 /* Atomic operations that C can't guarantee us. Useful for resource counting etc.. */
 
+/* the lock prefix makes the read-modify-write operations atomic across processors */
+#define LOCK_PREFIX     "lock; "
+
 typedef struct {
     volatile int counter;
 } atomic_t;
@@ -51,7 +54,7 @@ atomic_set(atomic_t *v, int i) {
  * */
 static inline void
 atomic_add(atomic_t *v, int i) {
-    asm volatile ("addl %1, %0" : "+m" (v->counter) : "ir" (i));
+    asm volatile (LOCK_PREFIX "addl %1, %0" : "+m" (v->counter) : "ir" (i));
 }
 
 /* *
@@ -63,7 +66,7 @@ atomic_add(atomic_t *v, int i) {
  * */
 static inline void
 atomic_sub(atomic_t *v, int i) {
-    asm volatile("subl %1, %0" : "+m" (v->counter) : "ir" (i));
+    asm volatile(LOCK_PREFIX "subl %1, %0" : "+m" (v->counter) : "ir" (i));
 }
 
 /* *
@@ -77,7 +80,7 @@ atomic_sub(atomic_t *v, int i) {
 static inline bool
 atomic_sub_test_zero(atomic_t *v, int i) {
     unsigned char c;
-    asm volatile("subl %2, %0; sete %1" : "+m" (v->counter), "=qm" (c) : "ir" (i) : "memory");
+    asm volatile(LOCK_PREFIX "subl %2, %0; sete %1" : "+m" (v->counter), "=qm" (c) : "ir" (i) : "memory");
     return c != 0;
 }
 
@@ -89,7 +92,7 @@ atomic_sub_test_zero(atomic_t *v, int i) {
  * */
 static inline void
 atomic_inc(atomic_t *v) {
-    asm volatile("incl %0" : "+m" (v->counter));
+    asm volatile(LOCK_PREFIX "incl %0" : "+m" (v->counter));
 }
 
 /* *
@@ -100,7 +103,7 @@ atomic_inc(atomic_t *v) {
  * */
 static inline void
 atomic_dec(atomic_t *v) {
-    asm volatile("decl %0" : "+m" (v->counter));
+    asm volatile(LOCK_PREFIX "decl %0" : "+m" (v->counter));
 }
 
 /* *
@@ -113,7 +116,7 @@ atomic_dec(atomic_t *v) {
 static inline bool
 atomic_inc_test_zero(atomic_t *v) {
     unsigned char c;
-    asm volatile("incl %0; sete %1" : "+m" (v->counter), "=qm" (c) :: "memory");
+    asm volatile(LOCK_PREFIX "incl %0; sete %1" : "+m" (v->counter), "=qm" (c) :: "memory");
     return c != 0;
 }
 
@@ -127,7 +130,7 @@ atomic_inc_test_zero(atomic_t *v) {
 static inline bool
 atomic_dec_test_zero(atomic_t *v) {
     unsigned char c;
-    asm volatile("decl %0; sete %1" : "+m" (v->counter), "=qm" (c) :: "memory");
+    asm volatile(LOCK_PREFIX "decl %0; sete %1" : "+m" (v->counter), "=qm" (c) :: "memory");
     return c != 0;
 }
 
@@ -142,7 +145,7 @@ atomic_dec_test_zero(atomic_t *v) {
 static inline int
 atomic_add_return(atomic_t *v, int i) {
     int __i = i;
-    asm volatile("xaddl %0, %1" : "+r" (i), "+m" (v->counter) :: "memory");
+    asm volatile(LOCK_PREFIX "xaddl %0, %1" : "+r" (i), "+m" (v->counter) :: "memory");
     return i + __i;
 }
 
@@ -176,7 +179,7 @@ static inline bool test_bit(int nr, volatile void *addr) __attribute__((always_i
  * */
 static inline void
 set_bit(int nr, volatile void *addr) {
-    asm volatile ("btsl %1, %0" :"=m" (*(volatile long *)addr) : "Ir" (nr));
+    asm volatile (LOCK_PREFIX "btsl %1, %0" :"=m" (*(volatile long *)addr) : "Ir" (nr));
 }
 
 /* *
@@ -186,7 +189,7 @@ set_bit(int nr, volatile void *addr) {
  * */
 static inline void
 clear_bit(int nr, volatile void *addr) {
-    asm volatile ("btrl %1, %0" :"=m" (*(volatile long *)addr) : "Ir" (nr));
+    asm volatile (LOCK_PREFIX "btrl %1, %0" :"=m" (*(volatile long *)addr) : "Ir" (nr));
 }
 
 /* *
@@ -196,7 +199,7 @@ clear_bit(int nr, volatile void *addr) {
  * */
 static inline void
 change_bit(int nr, volatile void *addr) {
-    asm volatile ("btcl %1, %0" :"=m" (*(volatile long *)addr) : "Ir" (nr));
+    asm volatile (LOCK_PREFIX "btcl %1, %0" :"=m" (*(volatile long *)addr) : "Ir" (nr));
 }
 
 /* *
@@ -207,7 +210,7 @@ change_bit(int nr, volatile void *addr) {
 static inline bool
 test_and_set_bit(int nr, volatile void *addr) {
     int oldbit;
-    asm volatile ("btsl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr));
+    asm volatile (LOCK_PREFIX "btsl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr));
     return oldbit != 0;
 }
 
@@ -219,7 +222,7 @@ test_and_set_bit(int nr, volatile void *addr) {
 static inline bool
 test_and_clear_bit(int nr, volatile void *addr) {
     int oldbit;
-    asm volatile ("btrl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr));
+    asm volatile (LOCK_PREFIX "btrl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr));
     return oldbit != 0;
 }
 
@@ -231,7 +234,7 @@ test_and_clear_bit(int nr, volatile void *addr) {
 static inline bool
 test_and_change_bit(int nr, volatile void *addr) {
     int oldbit;
-    asm volatile ("btcl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr));
+    asm volatile (LOCK_PREFIX "btcl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr));
     return oldbit != 0;
 }
 
@@ -0,0 +1,17 @@
+#ifndef __LIBS_DCACHESTAT_H__
+#define __LIBS_DCACHESTAT_H__
+
+#include <types.h>
+
+// counters of the name lookup cache, since boot
+struct dcachestat {
+    size_t lookups;                 // names looked up in the cache
+    size_t hits;                    // lookups which found the inode
+    size_t neg_hits;                // lookups which found the name does not exist
+    size_t invalidates;             // entries dropped by changes of their directory
+    size_t reclaims;                // entries dropped by the lru
+    size_t nentries;                // entries in the cache now
+};
+
+#endif /* !__LIBS_DCACHESTAT_H__ */
+
@@ -26,8 +26,9 @@
 #define E_MAX_OPEN          22  // Too Many Files are Open
 #define E_EXISTS            23  // File/Directory Already Exists
 #define E_NOTEMPTY          24  // Directory is Not Empty
+#define E_AGAIN             25  // Try Again
 /* the maximum allowed */
-#define MAXERROR            24
+#define MAXERROR            25
 
 #endif /* !__LIBS_ERROR_H__ */
 
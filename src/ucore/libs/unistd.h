@@ -9,15 +9,21 @@
 #define SYS_wait            3
 #define SYS_exec            4
 #define SYS_clone           5
+#define SYS_spawn           6
 #define SYS_yield           10
 #define SYS_sleep           11
 #define SYS_kill            12
+#define SYS_usleep          13
+#define SYS_nice            14
 #define SYS_gettime         17
 #define SYS_getpid          18
 #define SYS_brk             19
 #define SYS_mmap            20
 #define SYS_munmap          21
 #define SYS_shmem           22
+#define SYS_mmap_file       23
+#define SYS_madvise         24
+#define SYS_vmstat          25
 #define SYS_putc            30
 #define SYS_pgdir           31
 #define SYS_sem_init        40
@@ -32,6 +38,7 @@
 #define SYS_mbox_recv       52
 #define SYS_mbox_free       53
 #define SYS_mbox_info       54
+#define SYS_futex           55
 #define SYS_open            100
 #define SYS_close           101
 #define SYS_read            102
@@ -39,6 +46,8 @@
 #define SYS_seek            104
 #define SYS_fstat           110
 #define SYS_fsync           111
+#define SYS_ioctl           112
+#define SYS_fallocate       113
 #define SYS_chdir           120
 #define SYS_getcwd          121
 #define SYS_mkdir           122
@@ -48,9 +57,12 @@
 #define SYS_symlink         126
 #define SYS_unlink          127
 #define SYS_getdirentry     128
+#define SYS_dcachestat      129
 #define SYS_dup             130
 #define SYS_pipe            140
 #define SYS_mkfifo          141
+#define SYS_splice          142
+#define SYS_vmsplice        143
 #define SYS_modify_ldt		147
 #define SYS_gettimeofday	148
 #define SYS_exit_group		149
@@ -60,10 +72,26 @@
 #define CLONE_THREAD        0x00000200  // thread group
 #define CLONE_SEM           0x00000400  // set if shared between processes
 #define CLONE_FS            0x00000800  // set if shared between processes
+#define CLONE_VFORK         0x00001000  // set if the parent sleeps until the child execs or exits
+
+/* SYS_futex operations */
+#define FUTEX_WAIT          0           // sleep if *uaddr == val
+#define FUTEX_WAKE          1           // wake up one waiter on uaddr
+#define FUTEX_WAKE_N        2           // wake up at most val waiters on uaddr
 
 /* SYS_mmap flags */
 #define MMAP_WRITE          0x00000100
 #define MMAP_STACK          0x00000200
+#define MMAP_SHARED         0x00000400  // SYS_mmap_file only, write back to the file
+
+/* SYS_madvise advice */
+#define MADV_WILLNEED       3           // read in the swapped out pages
+#define MADV_DONTNEED       4           // drop the pages, zero-fill or refault on next touch
+#define MADV_FREE           8           // like MADV_DONTNEED, private anonymous memory only
+
+/* SYS_ioctl operations on pipes */
+#define PIPE_IOC_GETSIZE    0x00000001  // get the capacity of the pipe in bytes
+#define PIPE_IOC_SETSIZE    0x00000002  // resize the pipe to arg bytes, rounded up to pages
 
 /* VFS flags */
 // flags for open: choose one of these
@@ -0,0 +1,17 @@
+#ifndef __LIBS_VMSTAT_H__
+#define __LIBS_VMSTAT_H__
+
+#include <types.h>
+
+// counters of the page replacement, since boot
+struct vmstat {
+    size_t pgfault;                 // page faults
+    size_t pgmajfault;              // page faults which read the swap device
+    size_t pgscan;                  // ptes scanned by the generation walks
+    size_t pgsteal;                 // pages unmapped to the swap cache
+    size_t pswpout;                 // pages written to the swap device
+    size_t swpwrite;                // requests to write the swap device
+    unsigned int lru_seq;           // the youngest generation
+};
+
+#endif /* !__LIBS_VMSTAT_H__ */
@@ -19,9 +19,11 @@
         })
 
 static inline uint8_t inb(uint16_t port) __attribute__((always_inline));
+static inline uint32_t inl(uint16_t port) __attribute__((always_inline));
 static inline void insl(uint32_t port, void *addr, int cnt) __attribute__((always_inline));
 static inline void outb(uint16_t port, uint8_t data) __attribute__((always_inline));
 static inline void outw(uint16_t port, uint16_t data) __attribute__((always_inline));
+static inline void outl(uint16_t port, uint32_t data) __attribute__((always_inline));
 static inline void outsl(uint32_t port, const void *addr, int cnt) __attribute__((always_inline));
 static inline uint32_t read_ebp(void) __attribute__((always_inline));
 static inline void breakpoint(void) __attribute__((always_inline));
@@ -47,6 +49,9 @@ static inline uintptr_t rcr1(void) __attribute__((always_inline));
 static inline uintptr_t rcr2(void) __attribute__((always_inline));
 static inline uintptr_t rcr3(void) __attribute__((always_inline));
 static inline void invlpg(void *addr) __attribute__((always_inline));
+static inline uint32_t xchg(volatile uint32_t *addr, uint32_t newval) __attribute__((always_inline));
+static inline void pause(void) __attribute__((always_inline));
+static inline uint64_t rdtsc(void) __attribute__((always_inline));
 
 static inline uint8_t
 inb(uint16_t port) {
@@ -55,6 +60,13 @@ inb(uint16_t port) {
     return data;
 }
 
+static inline uint32_t
+inl(uint16_t port) {
+    uint32_t data;
+    asm volatile ("inl %1, %0" : "=a" (data) : "d" (port));
+    return data;
+}
+
 static inline void
 insl(uint32_t port, void *addr, int cnt) {
     asm volatile (
@@ -75,6 +87,11 @@ outw(uint16_t port, uint16_t data) {
     asm volatile ("outw %0, %1" :: "a" (data), "d" (port));
 }
 
+static inline void
+outl(uint16_t port, uint32_t data) {
+    asm volatile ("outl %0, %1" :: "a" (data), "d" (port));
+}
+
 static inline void
 outsl(uint32_t port, const void *addr, int cnt) {
     asm volatile (
@@ -198,6 +215,28 @@ invlpg(void *addr) {
     asm volatile ("invlpg (%0)" :: "r" (addr) : "memory");
 }
 
+/* xchg - atomically exchange *addr with newval and return the old value */
+static inline uint32_t
+xchg(volatile uint32_t *addr, uint32_t newval) {
+    uint32_t result;
+    asm volatile ("lock; xchgl %0, %1" : "+m" (*addr), "=a" (result) : "1" (newval) : "cc", "memory");
+    return result;
+}
+
+/* pause - spin-wait hint, keeps a busy loop from starving the sibling cpu */
+static inline void
+pause(void) {
+    asm volatile ("pause" ::: "memory");
+}
+
+/* rdtsc - read the time-stamp counter */
+static inline uint64_t
+rdtsc(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
 static inline int __strcmp(const char *s1, const char *s2) __attribute__((always_inline));
 static inline char *__strcpy(char *dst, const char *src) __attribute__((always_inline));
 static inline void *__memset(void *s, char c, size_t n) __attribute__((always_inline));
@@ -107,7 +107,9 @@ safe_fchdir(int fd) {
     }
 }
 
-#define SFS_MAGIC                               0x2f8dbe2a
+#define SFS_MAGIC                               0x2f8dbe2b
+#define SFS_FEATURE_EXTENTS                     0x00000001
+#define SFS_FEATURE_DIRINDEX                    0x00000002
 #define SFS_NDIRECT                             12
 #define SFS_BLKSIZE                             4096                                    // 4K
 #define SFS_MAX_NBLKS                           (1024UL * 512)                          // 4K * 512K
@@ -139,11 +141,16 @@ struct cache_inode {
         uint32_t direct[SFS_NDIRECT];
         uint32_t indirect;
         uint32_t db_indirect;
+        uint32_t dirindex;
+        uint32_t nextents;
+        uint32_t dirgen;
     } inode;
     ino_t real;
     uint32_t ino;
     uint32_t nblks;
     struct cache_block *l1, *l2;
+    uint16_t *tags;
+    uint32_t ntags, maxtags;
     struct cache_inode *hash_next;
 };
 
@@ -153,6 +160,7 @@ struct sfs_fs {
         uint32_t blocks;
         uint32_t unused_blocks;
         char info[SFS_MAX_INFO_LEN + 1];
+        uint32_t features;
     } super;
     struct subpath {
         struct subpath *next, *prev;
@@ -170,6 +178,39 @@ struct sfs_entry {
     char name[SFS_MAX_FNAME_LEN + 1];
 };
 
+struct sfs_extent {
+    uint32_t index;
+    uint32_t blkno;
+};
+
+#define SFS_NEXTENT_INLINE                      (SFS_NDIRECT * sizeof(uint32_t) / sizeof(struct sfs_extent))
+
+#define SFS_DIRINDEX_MAGIC                      0x8e2a1d3c
+#define SFS_DIRINDEX_NHASH                      64
+#define SFS_DIRINDEX_MIN_SLOTS                  16
+#define SFS_DIRINDEX_MAX_SLOTS                  0xFFFF
+
+struct sfs_dirindex {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t gen;
+    uint32_t nhash;
+    uint32_t nnames;
+    uint32_t nfree;
+    uint32_t nstack;
+    uint32_t hash[SFS_DIRINDEX_NHASH];
+};
+
+/* the same hash as sfs_dirindex_hash in kern/fs/sfs/sfs_inode.c */
+static uint16_t
+sfs_dirindex_hash(const char *name) {
+    uint32_t hash = 2166136261U;
+    while (*name != '\0') {
+        hash = (hash ^ (unsigned char)(*name ++)) * 16777619U;
+    }
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
 static uint32_t
 sfs_alloc_ino(struct sfs_fs *sfs) {
     if (sfs->next_ino < sfs->ninos) {
@@ -203,6 +244,7 @@ alloc_cache_inode(struct sfs_fs *sfs, ino_t real, uint32_t ino, uint16_t type) {
     struct cache_inode *ci = safe_malloc(sizeof(struct cache_inode));
     ci->ino = (ino != 0) ? ino : sfs_alloc_ino(sfs);
     ci->real = real, ci->nblks = 0, ci->l1 = ci->l2 = NULL;
+    ci->tags = NULL, ci->ntags = ci->maxtags = 0;
     struct inode *inode = &(ci->inode);
     memset(inode, 0, sizeof(struct inode));
     inode->type = type;
@@ -238,6 +280,7 @@ create_sfs(int imgfd) {
     sfs->super.magic = SFS_MAGIC;
     sfs->super.blocks = ninos, sfs->super.unused_blocks = ninos - next_ino;
     snprintf(sfs->super.info, SFS_MAX_INFO_LEN, "simple file system");
+    sfs->super.features = SFS_FEATURE_EXTENTS | SFS_FEATURE_DIRINDEX;
 
     sfs->ninos = ninos, sfs->next_ino = next_ino, sfs->imgfd = imgfd;
     sfs->sp_root = sfs->sp_end = &(sfs->__sp_nil);
@@ -394,12 +437,36 @@ update_cache(struct sfs_fs *sfs, struct cache_block **cbp, uint32_t *inop) {
     *cbp = cb, *inop = ino;
 }
 
+static void
+append_extent(struct sfs_fs *sfs, struct cache_inode *file, size_t size, uint32_t ino, const char *filename) {
+    struct inode *inode = &(file->inode);
+    struct sfs_extent *ext = (struct sfs_extent *)(inode->direct), *last = ext + inode->nextents - 1;
+    if (inode->blocks >= SFS_LN_NBLKS) {
+        open_bug(sfs, filename, "file is too big.\n");
+    }
+    if (inode->nextents == 0 || last->blkno + (inode->blocks - last->index) != ino) {
+        if (inode->nextents == SFS_NEXTENT_INLINE) {
+            open_bug(sfs, filename, "file is too fragmented.\n");
+        }
+        last ++, inode->nextents ++;
+        last->index = inode->blocks, last->blkno = ino;
+    }
+    file->nblks ++;
+    inode->size += size;
+    inode->blocks ++;
+}
+
 static void
 append_block(struct sfs_fs *sfs, struct cache_inode *file, size_t size, uint32_t ino, const char *filename) {
     static_assert(SFS_LN_NBLKS <= SFS_L2_NBLKS);
     assert(size <= SFS_BLKSIZE);
     uint32_t nblks = file->nblks;
     struct inode *inode = &(file->inode);
+    if (inode->type == SFS_TYPE_FILE) {
+        // files are mapped by extents, their blocks are allocated in a row
+        append_extent(sfs, file, size, ino, filename);
+        return ;
+    }
     if (nblks >= SFS_LN_NBLKS) {
         open_bug(sfs, filename, "file is too big.\n");
     }
@@ -434,6 +501,45 @@ add_entry(struct sfs_fs *sfs, struct cache_inode *current, struct cache_inode *f
     write_block(sfs, entry, sizeof(entry->name), entry_ino);
     append_block(sfs, current, sizeof(entry->name), entry_ino, name);
     file->inode.nlinks ++;
+    if (current->ntags == current->maxtags) {
+        uint32_t maxtags = (current->maxtags != 0) ? current->maxtags * 2 : 64;
+        uint16_t *tags = safe_malloc(maxtags * sizeof(uint16_t));
+        if (current->ntags != 0) {
+            memcpy(tags, current->tags, current->ntags * sizeof(uint16_t));
+        }
+        free(current->tags);
+        current->tags = tags, current->maxtags = maxtags;
+    }
+    current->tags[current->ntags ++] = sfs_dirindex_hash(name);
+}
+
+static void
+add_dirindex(struct sfs_fs *sfs, struct cache_inode *current) {
+    uint32_t n = current->ntags, i, j;
+    if (n >= SFS_DIRINDEX_MIN_SLOTS && n <= SFS_DIRINDEX_MAX_SLOTS) {
+        static_assert(sizeof(struct sfs_dirindex) <= SFS_BLKSIZE);
+        struct cache_block *root = alloc_cache_block(sfs, 0);
+        struct sfs_dirindex *idx = root->cache;
+        idx->magic = SFS_DIRINDEX_MAGIC, idx->size = current->inode.size, idx->gen = current->inode.dirgen;
+        idx->nhash = 1, idx->nnames = n;
+        while (n * 4 > idx->nhash * SFS_BLK_NENTRY * 3 && idx->nhash < SFS_DIRINDEX_NHASH) {
+            idx->nhash *= 2;
+        }
+        uint32_t *hash[SFS_DIRINDEX_NHASH], mask = idx->nhash * SFS_BLK_NENTRY - 1;
+        for (i = 0; i < idx->nhash; i ++) {
+            struct cache_block *cb = alloc_cache_block(sfs, 0);
+            idx->hash[i] = cb->ino, hash[i] = cb->cache;
+        }
+        for (j = 0; j < n; j ++) {
+            for (i = current->tags[j] & mask; hash[i / SFS_BLK_NENTRY][i % SFS_BLK_NENTRY] != 0; i = (i + 1) & mask) {
+                /* nothing */ ;
+            }
+            hash[i / SFS_BLK_NENTRY][i % SFS_BLK_NENTRY] = ((uint32_t)current->tags[j] << 16) | (j + 1);
+        }
+        current->inode.dirindex = root->ino;
+    }
+    free(current->tags);
+    current->tags = NULL, current->ntags = current->maxtags = 0;
 }
 
 static void
@@ -511,6 +617,7 @@ open_dir(struct sfs_fs *sfs, struct cache_inode *current, struct cache_inode *pa
         }
     }
     closedir(dir);
+    add_dirindex(sfs, current);
 }
 
 void
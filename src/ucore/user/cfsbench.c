@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <ulib.h>
+
+/* *
+ * cfsbench - fairness and wakeup latency of the scheduler.
+ *
+ * NHOG cpu bound processes with different nice values spin for RUNTIME
+ * msecs, and report how many loops they got. Meanwhile a sleeper sleeps one
+ * tick at a time and measures how late it is woken up. Build the kernel
+ * with DEFS+=-DSCHED_CFS to compare CFS with the default MLFQ.
+ * */
+
+#define NHOG                    4
+#define RUNTIME                 3000
+#define NSLEEP                  100
+#define MSEC_PER_TICK           10
+
+static const int hog_nice[NHOG] = {0, 0, 5, -5};
+
+static void
+hog(int n) {
+    nice(hog_nice[n]);
+    unsigned int start = gettime_msec(), loops = 0;
+    while (gettime_msec() - start < RUNTIME) {
+        volatile int i;
+        for (i = 0; i < 10000; i ++) {
+            /* do nothing */ ;
+        }
+        loops ++;
+    }
+    exit(loops);
+}
+
+static void
+sleeper(void) {
+    int i, total = 0, worst = 0;
+    for (i = 0; i < NSLEEP; i ++) {
+        unsigned int start = gettime_msec();
+        sleep(1);
+        int late = (int)(gettime_msec() - start) - MSEC_PER_TICK;
+        if (late < 0) {
+            late = 0;
+        }
+        total += late;
+        if (worst < late) {
+            worst = late;
+        }
+    }
+    cprintf("sleeper: average latency %d msecs, worst %d msecs.\n", total / NSLEEP, worst);
+    exit(0);
+}
+
+int
+main(void) {
+    int i, pids[NHOG + 1];
+    for (i = 0; i < NHOG; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            hog(i);
+        }
+        assert(pids[i] > 0);
+    }
+    if ((pids[NHOG] = fork()) == 0) {
+        sleeper();
+    }
+    assert(pids[NHOG] > 0);
+
+    int loops[NHOG], total = 0;
+    for (i = 0; i < NHOG; i ++) {
+        assert(waitpid(pids[i], loops + i) == 0);
+        total += loops[i];
+    }
+    assert(waitpid(pids[NHOG], NULL) == 0);
+
+    for (i = 0; i < NHOG; i ++) {
+        cprintf("hog %d (nice %d): %d loops, %d%% of cpu.\n",
+                i, hog_nice[i], loops[i], (total != 0) ? loops[i] * 100 / total : 0);
+    }
+    cprintf("cfsbench pass.\n");
+    return 0;
+}
+
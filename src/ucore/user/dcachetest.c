@@ -0,0 +1,119 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <dir.h>
+#include <unistd.h>
+
+#define printf(...)                 fprintf(1, __VA_ARGS__)
+
+/* *
+ * dcachetest - the name lookup cache.
+ *
+ * Checks that names created, removed and renamed are seen at once by the
+ * lookups which cached them before, positive or negative, then opens the
+ * same NFILES paths NROUNDS times, and a missing one as often, and prints
+ * the time and the hit rate of the cache.
+ * */
+
+#define NFILES                      64
+#define NROUNDS                     50
+
+static void
+name_of(char *buf, int i) {
+    snprintf(buf, 64, "dctest/sub/../sub/f%d", i);
+}
+
+static bool
+exists(const char *path) {
+    int fd;
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return 0;
+    }
+    close(fd);
+    return 1;
+}
+
+static void
+create(const char *path) {
+    int fd;
+    assert((fd = open(path, O_CREAT | O_EXCL | O_WRONLY)) >= 0);
+    close(fd);
+}
+
+static size_t
+percent(size_t part, size_t total) {
+    return (total != 0) ? part * 100 / total : 0;
+}
+
+int
+main(void) {
+    char name[64];
+    int i, round;
+
+    assert(mkdir("dctest") == 0 && mkdir("dctest/sub") == 0);
+
+    // negative entries
+    assert(!exists("dctest/sub/a") && !exists("dctest/sub/a"));
+    create("dctest/sub/a");
+    assert(exists("dctest/sub/a") && exists("dctest/sub/../sub/a"));
+
+    // positive entries
+    assert(unlink("dctest/sub/a") == 0);
+    assert(!exists("dctest/sub/a"));
+    create("dctest/sub/a");
+    assert(rename("dctest/sub/a", "dctest/sub/b") == 0);
+    assert(!exists("dctest/sub/a") && exists("dctest/sub/b"));
+    assert(link("dctest/sub/b", "dctest/sub/a") == 0);
+    assert(exists("dctest/sub/a"));
+    assert(unlink("dctest/sub/a") == 0 && unlink("dctest/sub/b") == 0);
+
+    // .. of a directory moved to another one
+    assert(mkdir("dctest/other") == 0 && mkdir("dctest/sub/dir") == 0);
+    create("dctest/other/c");
+    assert(!exists("dctest/sub/dir/../c"));
+    assert(rename("dctest/sub/dir", "dctest/other/dir") == 0);
+    assert(exists("dctest/other/dir/../c") && !exists("dctest/sub/dir"));
+    assert(unlink("dctest/other/dir") == 0 && unlink("dctest/other/c") == 0);
+    assert(!exists("dctest/other/dir/.."));
+    assert(unlink("dctest/other") == 0);
+    printf("dcache invalidation ok.\n");
+
+    for (i = 0; i < NFILES; i ++) {
+        name_of(name, i);
+        create(name);
+    }
+
+    struct dcachestat before, after;
+    assert(dcachestat(&before) == 0);
+    unsigned int start = gettime_msec();
+    for (round = 0; round < NROUNDS; round ++) {
+        for (i = 0; i < NFILES; i ++) {
+            name_of(name, i);
+            assert(exists(name));
+            name_of(name, NFILES + i);
+            assert(!exists(name));
+        }
+    }
+    unsigned int msecs = gettime_msec() - start;
+    assert(dcachestat(&after) == 0);
+    if (msecs == 0) {
+        msecs = 1;
+    }
+
+    size_t lookups = after.lookups - before.lookups;
+    size_t hits = after.hits - before.hits, neg_hits = after.neg_hits - before.neg_hits;
+    printf("%d opens in %d msecs, %d opens/sec.\n", 2 * NFILES * NROUNDS, msecs, 2 * NFILES * NROUNDS * 1000 / msecs);
+    printf("%d lookups, %d%% hits, %d%% negative hits, %d entries.\n",
+            lookups, percent(hits, lookups), percent(neg_hits, lookups), after.nentries);
+
+    for (i = 0; i < NFILES; i ++) {
+        name_of(name, i);
+        assert(unlink(name) == 0);
+        assert(!exists(name));
+    }
+    assert(unlink("dctest/sub") == 0 && unlink("dctest") == 0);
+    printf("dcachetest pass.\n");
+    return 0;
+}
+
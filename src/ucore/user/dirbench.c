@@ -0,0 +1,76 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <dir.h>
+#include <unistd.h>
+
+#define printf(...)                 fprintf(1, __VA_ARGS__)
+
+/* *
+ * dirbench - creates, opens and removes n files in one directory.
+ *
+ * With a linear scan of the slots each of these costs O(n), so the time
+ * per operation grows with n; with the hashed index of sfs it should stay
+ * about the same for every n.
+ * */
+
+static const int sizes[] = {100, 1000, 2000};
+
+static void
+name_of(char *buf, int i) {
+    snprintf(buf, 32, "dirbench/f%d", i);
+}
+
+static unsigned int
+elapsed(unsigned int start) {
+    unsigned int msecs = gettime_msec() - start;
+    return (msecs != 0) ? msecs : 1;
+}
+
+static void
+bench(int n) {
+    char name[32];
+    int i, fd;
+    unsigned int start, create, lookup, remove;
+
+    start = gettime_msec();
+    for (i = 0; i < n; i ++) {
+        name_of(name, i);
+        assert((fd = open(name, O_CREAT | O_EXCL | O_WRONLY)) >= 0);
+        close(fd);
+    }
+    create = elapsed(start);
+
+    start = gettime_msec();
+    for (i = n - 1; i >= 0; i --) {
+        name_of(name, i);
+        assert((fd = open(name, O_RDONLY)) >= 0);
+        close(fd);
+    }
+    name_of(name, n);
+    assert(open(name, O_RDONLY) < 0);
+    lookup = elapsed(start);
+
+    start = gettime_msec();
+    for (i = 0; i < n; i ++) {
+        name_of(name, i);
+        assert(unlink(name) == 0);
+    }
+    remove = elapsed(start);
+
+    printf("%5d files: create %5d/sec, open %5d/sec, unlink %5d/sec.\n",
+            n, n * 1000 / create, n * 1000 / lookup, n * 1000 / remove);
+}
+
+int
+main(void) {
+    int i;
+    assert(mkdir("dirbench") == 0);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i ++) {
+        bench(sizes[i]);
+    }
+    assert(unlink("dirbench") == 0);
+    printf("dirbench pass.\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <dir.h>
+#include <unistd.h>
+
+#define printf(...)                 fprintf(1, __VA_ARGS__)
+
+/* *
+ * fdbench - opening and closing many files.
+ *
+ * Opens the same file NFILES times, far more than the fixed table of a
+ * process used to hold, checks that the fds are the lowest free ones and
+ * that a closed fd is reused first, dups one to a high fd and back, and
+ * then times NROUNDS rounds of opening and closing NFILES files, from the
+ * lowest fd and from the highest one, and a child forked with them open.
+ * */
+
+#define NFILES                      1000
+#define NROUNDS                     20
+#define HIGH_FD                     4000
+
+static int fds[NFILES];
+
+static unsigned int
+elapsed(unsigned int start) {
+    unsigned int msecs = gettime_msec() - start;
+    return (msecs != 0) ? msecs : 1;
+}
+
+static void
+report(const char *what, int nops, unsigned int msecs) {
+    printf("%-24s %5d msecs, %7d ops/sec.\n", what, msecs, nops * 1000 / msecs);
+}
+
+static void
+open_all(void) {
+    int i;
+    for (i = 0; i < NFILES; i ++) {
+        assert((fds[i] = open("fdbench", O_RDONLY)) >= 0);
+    }
+}
+
+int
+main(void) {
+    int i, round, fd, pid, exit_code;
+    unsigned int start;
+
+    assert((fd = open("fdbench", O_RDWR | O_CREAT | O_TRUNC)) >= 0);
+    assert(write(fd, "fdbench", 7) == 7);
+    close(fd);
+
+    open_all();
+    for (i = 1; i < NFILES; i ++) {
+        assert(fds[i] == fds[i - 1] + 1);
+    }
+    close(fds[NFILES / 2]);
+    assert((fd = open("fdbench", O_RDONLY)) == fds[NFILES / 2]);
+
+    char buf[8];
+    assert(dup2(fds[NFILES - 1], HIGH_FD) == HIGH_FD);
+    assert(read(HIGH_FD, buf, 7) == 7 && memcmp(buf, "fdbench", 7) == 0);
+    assert(dup2(fds[0], HIGH_FD) < 0);
+    close(HIGH_FD);
+    assert(read(HIGH_FD, buf, 7) < 0);
+
+    if ((pid = fork()) == 0) {
+        assert(read(fds[NFILES - 1], buf, 7) == 0);
+        for (i = 0; i < NFILES; i ++) {
+            close(fds[i]);
+        }
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    for (i = 0; i < NFILES; i ++) {
+        close(fds[i]);
+    }
+    printf("fd table ok.\n");
+
+    start = gettime_msec();
+    for (round = 0; round < NROUNDS; round ++) {
+        open_all();
+        for (i = 0; i < NFILES; i ++) {
+            close(fds[i]);
+        }
+    }
+    report("open + close, in order", 2 * NFILES * NROUNDS, elapsed(start));
+
+    start = gettime_msec();
+    for (round = 0; round < NROUNDS; round ++) {
+        open_all();
+        for (i = NFILES - 1; i >= 0; i --) {
+            close(fds[i]);
+        }
+    }
+    report("open + close, reversed", 2 * NFILES * NROUNDS, elapsed(start));
+
+    open_all();
+    start = gettime_msec();
+    for (round = 0; round < NROUNDS; round ++) {
+        if ((pid = fork()) == 0) {
+            exit(0);
+        }
+        assert(pid > 0 && waitpid(pid, &exit_code) == 0);
+    }
+    report("fork with files open", NROUNDS, elapsed(start));
+    for (i = 0; i < NFILES; i ++) {
+        close(fds[i]);
+    }
+
+    assert(unlink("fdbench") == 0);
+    printf("fdbench pass.\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <error.h>
+#include <thread.h>
+
+#define NTHREAD                 4
+#define NLOOP                   200
+
+// 0: unlocked, 1: locked, 2: locked with waiters
+static volatile int mutex = 0;
+static volatile int counter = 0;
+
+static inline int
+cmpxchg(volatile int *addr, int old, int new) {
+    int ret;
+    asm volatile ("lock; cmpxchgl %2, %1" : "=a" (ret), "+m" (*addr) : "r" (new), "0" (old) : "memory");
+    return ret;
+}
+
+static inline int
+xchg(volatile int *addr, int new) {
+    asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*addr) :: "memory");
+    return new;
+}
+
+static void
+mutex_lock(volatile int *m) {
+    int c;
+    if ((c = cmpxchg(m, 0, 1)) != 0) {
+        if (c != 2) {
+            c = xchg(m, 2);
+        }
+        while (c != 0) {
+            futex_wait((int *)m, 2);
+            c = xchg(m, 2);
+        }
+    }
+}
+
+static void
+mutex_unlock(volatile int *m) {
+    if (xchg(m, 0) != 1) {
+        futex_wake((int *)m, 1);
+    }
+}
+
+int
+worker(void *arg) {
+    int i;
+    for (i = 0; i < NLOOP; i ++) {
+        mutex_lock(&mutex);
+        int c = counter;
+        if (i % 16 == 0) {
+            yield();
+        }
+        counter = c + 1;
+        mutex_unlock(&mutex);
+    }
+    return 0;
+}
+
+int
+main(void) {
+    int val = 0;
+    assert(futex_wait(&val, 1) == -E_AGAIN);
+    assert(futex_wait_timeout(&val, 0, 10) == -E_TIMEOUT);
+    assert(futex_wake(&val, 1) == 0);
+    cprintf("futex basic ok.\n");
+
+    thread_t tids[NTHREAD];
+    int i, exit_code;
+    for (i = 0; i < NTHREAD; i ++) {
+        assert(thread(worker, NULL, tids + i) == 0);
+    }
+    for (i = 0; i < NTHREAD; i ++) {
+        assert(thread_wait(tids + i, &exit_code) == 0 && exit_code == 0);
+    }
+    assert(counter == NTHREAD * NLOOP);
+
+    cprintf("futextest pass.\n");
+    return 0;
+}
+
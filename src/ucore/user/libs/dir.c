@@ -74,3 +74,8 @@ unlink(const char *path) {
     return sys_unlink(path);
 }
 
+int
+dcachestat(struct dcachestat *store) {
+    return sys_dcachestat(store);
+}
+
@@ -3,6 +3,7 @@
 
 #include <types.h>
 #include <dirent.h>
+#include <dcachestat.h>
 
 typedef struct {
     int fd;
@@ -18,6 +19,7 @@ int mkdir(const char *path);
 int link(const char *old_path, const char *new_path);
 int rename(const char *old_path, const char *new_path);
 int unlink(const char *path);
+int dcachestat(struct dcachestat *store);
 
 #endif /* !__USER_LIBS_DIR_H__ */
 
@@ -42,6 +42,16 @@ fsync(int fd) {
     return sys_fsync(fd);
 }
 
+int
+fallocate(int fd, off_t len) {
+    return sys_fallocate(fd, len);
+}
+
+int
+ioctl(int fd, int op, uint32_t arg) {
+    return sys_ioctl(fd, op, arg);
+}
+
 int
 dup(int fd) {
     return sys_dup(fd, NO_FD);
@@ -62,6 +72,16 @@ mkfifo(const char *name, uint32_t open_flags) {
     return sys_mkfifo(name, open_flags);
 }
 
+int
+splice(int fd_in, int fd_out, size_t len) {
+    return sys_splice(fd_in, fd_out, len);
+}
+
+int
+vmsplice(int fd, void *base, size_t len) {
+    return sys_vmsplice(fd, base, len);
+}
+
 static char
 transmode(struct stat *stat) {
     uint32_t mode = stat->st_mode;
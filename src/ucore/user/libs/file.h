@@ -12,10 +12,14 @@ int write(int fd, void *base, size_t len);
 int seek(int fd, off_t pos, int whence);
 int fstat(int fd, struct stat *stat);
 int fsync(int fd);
+int fallocate(int fd, off_t len);
+int ioctl(int fd, int op, uint32_t arg);
 int dup(int fd);
 int dup2(int fd1, int fd2);
 int pipe(int *fd_store);
 int mkfifo(const char *name, uint32_t open_flags);
+int splice(int fd_in, int fd_out, size_t len);
+int vmsplice(int fd, void *base, size_t len);
 
 void print_stat(const char *name, int fd, struct stat *stat);
 
@@ -59,6 +59,11 @@ sys_exec(const char *name, int argc, const char **argv, const char **env) {
     return syscall(SYS_exec, name, argc, argv, env);
 }
 
+int
+sys_spawn(const char *name, int argc, const char **argv, const char **env, const int *fds) {
+    return syscall(SYS_spawn, name, argc, argv, env, fds);
+}
+
 int
 sys_yield(void) {
     return syscall(SYS_yield);
@@ -69,6 +74,16 @@ sys_sleep(unsigned int time) {
     return syscall(SYS_sleep, time);
 }
 
+int
+sys_nice(int nice) {
+    return syscall(SYS_nice, nice);
+}
+
+int
+sys_usleep(unsigned int usecs) {
+    return syscall(SYS_usleep, usecs);
+}
+
 int
 sys_kill(int pid) {
     return syscall(SYS_kill, pid);
@@ -94,11 +109,26 @@ sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
     return syscall(SYS_mmap, addr_store, len, mmap_flags);
 }
 
+int
+sys_mmap_file(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset) {
+    return syscall(SYS_mmap_file, addr_store, len, mmap_flags, fd, offset);
+}
+
 int
 sys_munmap(uintptr_t addr, size_t len) {
     return syscall(SYS_munmap, addr, len);
 }
 
+int
+sys_madvise(uintptr_t addr, size_t len, int advice) {
+    return syscall(SYS_madvise, addr, len, advice);
+}
+
+int
+sys_vmstat(struct vmstat *store) {
+    return syscall(SYS_vmstat, store);
+}
+
 int
 sys_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
     return syscall(SYS_shmem, addr_store, len, mmap_flags);
@@ -139,6 +169,11 @@ sys_sem_get_value(sem_t sem_id, int *value_store) {
     return syscall(SYS_sem_get_value, sem_id, value_store);
 }
 
+int
+sys_futex(int *uaddr, int op, int val, unsigned int timeout) {
+    return syscall(SYS_futex, uaddr, op, val, timeout);
+}
+
 int
 sys_send_event(int pid, int event, unsigned int timeout) {
     return syscall(SYS_event_send, pid, event, timeout);
@@ -209,6 +244,16 @@ sys_fsync(int fd) {
     return syscall(SYS_fsync, fd);
 }
 
+int
+sys_fallocate(int fd, off_t len) {
+    return syscall(SYS_fallocate, fd, len);
+}
+
+int
+sys_ioctl(int fd, int op, uint32_t arg) {
+    return syscall(SYS_ioctl, fd, op, arg);
+}
+
 int
 sys_chdir(const char *path) {
     return syscall(SYS_chdir, path);
@@ -244,6 +289,11 @@ sys_getdirentry(int fd, struct dirent *dirent) {
     return syscall(SYS_getdirentry, fd, dirent);
 }
 
+int
+sys_dcachestat(struct dcachestat *store) {
+    return syscall(SYS_dcachestat, store);
+}
+
 int
 sys_dup(int fd1, int fd2) {
     return syscall(SYS_dup, fd1, fd2);
@@ -259,3 +309,13 @@ sys_mkfifo(const char *name, uint32_t open_flags) {
     return syscall(SYS_mkfifo, name, open_flags);
 }
 
+int
+sys_splice(int fd_in, int fd_out, size_t len) {
+    return syscall(SYS_splice, fd_in, fd_out, len);
+}
+
+int
+sys_vmsplice(int fd, void *base, size_t len) {
+    return syscall(SYS_vmsplice, fd, base, len);
+}
+
@@ -7,14 +7,23 @@ int sys_exit(int error_code);
 int sys_fork(void);
 int sys_wait(int pid, int *store);
 int sys_exec(const char *name, int argc, const char **argv, const char **env);
+int sys_spawn(const char *name, int argc, const char **argv, const char **env, const int *fds);
 int sys_yield(void);
 int sys_sleep(unsigned int time);
+int sys_usleep(unsigned int usecs);
+int sys_nice(int nice);
 int sys_kill(int pid);
 size_t sys_gettime(void);
 int sys_getpid(void);
 int sys_brk(uintptr_t *brk_store);
 int sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int sys_mmap_file(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset);
 int sys_munmap(uintptr_t addr, size_t len);
+int sys_madvise(uintptr_t addr, size_t len, int advice);
+
+struct vmstat;
+
+int sys_vmstat(struct vmstat *store);
 int sys_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int sys_putc(int c);
 int sys_pgdir(void);
@@ -23,6 +32,7 @@ int sys_sem_post(sem_t sem_id);
 int sys_sem_wait(sem_t sem_id, unsigned int timeout);
 int sys_sem_free(sem_t sem_id);
 int sys_sem_get_value(sem_t sem_id, int *value_store);
+int sys_futex(int *uaddr, int op, int val, unsigned int timeout);
 int sys_send_event(int pid, int event, unsigned int timeout);
 int sys_recv_event(int *pid_store, int *event_store, unsigned int timeout);
 
@@ -37,6 +47,7 @@ int sys_mbox_info(int id, struct mboxinfo *info);
 
 struct stat;
 struct dirent;
+struct dcachestat;
 
 int sys_modify_ldt(int func, void* ptr, uint32_t bytecount);
 int sys_open(const char *path, uint32_t open_flags);
@@ -46,6 +57,8 @@ int sys_write(int fd, void *base, size_t len);
 int sys_seek(int fd, off_t pos, int whence);
 int sys_fstat(int fd, struct stat *stat);
 int sys_fsync(int fd);
+int sys_fallocate(int fd, off_t len);
+int sys_ioctl(int fd, int op, uint32_t arg);
 int sys_chdir(const char *path);
 int sys_getcwd(char *buffer, size_t len);
 int sys_mkdir(const char *path);
@@ -53,9 +66,12 @@ int sys_link(const char *path1, const char *path2);
 int sys_rename(const char *path1, const char *path2);
 int sys_unlink(const char *path);
 int sys_getdirentry(int fd, struct dirent *dirent);
+int sys_dcachestat(struct dcachestat *store);
 int sys_dup(int fd1, int fd2);
 int sys_pipe(int *fd_store);
 int sys_mkfifo(const char *name, uint32_t open_flags);
+int sys_splice(int fd_in, int fd_out, size_t len);
+int sys_vmsplice(int fd, void *base, size_t len);
 
 #endif /* !__USER_LIBS_SYSCALL_H__ */
 
@@ -1,4 +1,5 @@
 #include <types.h>
+#include <unistd.h>
 #include <string.h>
 #include <syscall.h>
 #include <stdio.h>
@@ -54,6 +55,16 @@ sleep(unsigned int time) {
     return sys_sleep(time);
 }
 
+int
+usleep(unsigned int usecs) {
+    return sys_usleep(usecs);
+}
+
+int
+nice(int nice) {
+    return sys_nice(nice);
+}
+
 int
 kill(int pid) {
     return sys_kill(pid);
@@ -80,11 +91,26 @@ mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
     return sys_mmap(addr_store, len, mmap_flags);
 }
 
+int
+mmap_file(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset) {
+    return sys_mmap_file(addr_store, len, mmap_flags, fd, offset);
+}
+
 int
 munmap(uintptr_t addr, size_t len) {
     return sys_munmap(addr, len);
 }
 
+int
+madvise(uintptr_t addr, size_t len, int advice) {
+    return sys_madvise(addr, len, advice);
+}
+
+int
+vmstat(struct vmstat *store) {
+    return sys_vmstat(store);
+}
+
 int
 shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
     return sys_shmem(addr_store, len, mmap_flags);
@@ -120,6 +146,21 @@ sem_get_value(sem_t sem_id, int *value_store) {
     return sys_sem_get_value(sem_id, value_store);
 }
 
+int
+futex_wait(int *uaddr, int val) {
+    return sys_futex(uaddr, FUTEX_WAIT, val, 0);
+}
+
+int
+futex_wait_timeout(int *uaddr, int val, unsigned int timeout) {
+    return sys_futex(uaddr, FUTEX_WAIT, val, timeout);
+}
+
+int
+futex_wake(int *uaddr, int nr_wake) {
+    return sys_futex(uaddr, FUTEX_WAKE_N, nr_wake, 0);
+}
+
 int
 send_event(int pid, int event) {
     return sys_send_event(pid, event, 0);
@@ -184,6 +225,18 @@ __exec(const char *name, const char **argv, const char **env) {
     return sys_exec(name, argc, argv, env);
 }
 
+int
+__spawn(const char *name, const char **argv, const char **env, const int *fds) {
+    int argc = 0, ret;
+    while (argv[argc] != NULL) {
+        argc ++;
+    }
+    lock_fork();
+    ret = sys_spawn(name, argc, argv, env, fds);
+    unlock_fork();
+    return ret;
+}
+
 int __clone(uint32_t clone_flags, uintptr_t stack, int (*fn)(void *), void *arg);
 
 int
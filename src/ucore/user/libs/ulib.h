@@ -32,12 +32,20 @@ int wait(void);
 int waitpid(int pid, int *store);
 void yield(void);
 int sleep(unsigned int time);
+int usleep(unsigned int usecs);
+int nice(int nice);
 int kill(int pid);
 unsigned int gettime_msec(void);
 int getpid(void);
 void print_pgdir(void);
 int mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int mmap_file(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset);
 int munmap(uintptr_t addr, size_t len);
+int madvise(uintptr_t addr, size_t len, int advice);
+
+struct vmstat;
+
+int vmstat(struct vmstat *store);
 int shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int clone(uint32_t clone_flags, uintptr_t stack, int (*fn)(void *), void *arg);
 sem_t sem_init(int value);
@@ -46,6 +54,9 @@ int sem_wait(sem_t sem_id);
 int sem_wait_timeout(sem_t sem_id, unsigned int timeout);
 int sem_free(sem_t sem_id);
 int sem_get_value(sem_t sem_id, int *value_store);
+int futex_wait(int *uaddr, int val);
+int futex_wait_timeout(int *uaddr, int val, unsigned int timeout);
+int futex_wake(int *uaddr, int nr_wake);
 int send_event(int pid, int event);
 int send_event_timeout(int pid, int event, unsigned int timeout);
 int recv_event(int *pid_store, int *event_store);
@@ -71,5 +82,13 @@ int __exec(const char *name, const char **argv, const char **env);
 #define exec(path, ...)                         __exec0(NULL, path, ##__VA_ARGS__)
 #define nexec(name, path, ...)                  __exec0(name, path, ##__VA_ARGS__)
 
+int __spawn(const char *name, const char **argv, const char **env, const int *fds);
+
+#define __spawn0(name, path, ...)               \
+	({ const char *argv[] = {path, ##__VA_ARGS__, NULL}, *envp[] = {NULL}; \
+	__spawn(name, argv, envp, NULL); })
+
+#define spawn(path, ...)                        __spawn0(NULL, path, ##__VA_ARGS__)
+
 #endif /* !__USER_LIBS_ULIB_H__ */
 
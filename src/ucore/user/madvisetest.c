@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <ulib.h>
+#include <unistd.h>
+
+#define PGSIZE      4096
+#define NPAGES      16
+
+static void
+fill(char *buf, int from, int to, char c) {
+    int i;
+    for (i = from * PGSIZE; i < to * PGSIZE; i ++) {
+        buf[i] = c + (char)(i / PGSIZE);
+    }
+}
+
+static void
+check(char *buf, int from, int to, char c) {
+    int i;
+    for (i = from * PGSIZE; i < to * PGSIZE; i ++) {
+        assert(buf[i] == (c == 0 ? 0 : c + (char)(i / PGSIZE)));
+    }
+}
+
+int
+main(void) {
+    uintptr_t addr = 0, shaddr = 0;
+    assert(mmap(&addr, NPAGES * PGSIZE, MMAP_WRITE) == 0 && addr != 0);
+    char *buf = (char *)addr;
+
+    assert(madvise(addr + 1, PGSIZE, MADV_DONTNEED) != 0);
+    assert(madvise(addr, PGSIZE, 0x7f) != 0);
+    assert(madvise(addr, (NPAGES + 1) * PGSIZE, MADV_DONTNEED) != 0);
+    assert(madvise(addr, 0, MADV_DONTNEED) == 0);
+    cprintf("madvise step1 ok.\n");
+
+    fill(buf, 0, NPAGES, 'a');
+    assert(madvise(addr + 4 * PGSIZE, 8 * PGSIZE, MADV_DONTNEED) == 0);
+    check(buf, 0, 4, 'a');
+    check(buf, 4, 12, 0);
+    check(buf, 12, NPAGES, 'a');
+    cprintf("madvise step2 ok.\n");
+
+    fill(buf, 0, NPAGES, 'A');
+    assert(madvise(addr, NPAGES * PGSIZE - 100, MADV_FREE) == 0);
+    check(buf, 0, NPAGES, 0);
+    fill(buf, 0, NPAGES, 'a');
+    assert(madvise(addr, NPAGES * PGSIZE, MADV_WILLNEED) == 0);
+    check(buf, 0, NPAGES, 'a');
+    cprintf("madvise step3 ok.\n");
+
+    assert(shmem(&shaddr, PGSIZE, MMAP_WRITE) == 0 && shaddr != 0);
+    char *shbuf = (char *)shaddr;
+    fill(shbuf, 0, 1, 'x');
+    assert(madvise(shaddr, PGSIZE, MADV_FREE) != 0);
+    assert(madvise(shaddr, PGSIZE, MADV_DONTNEED) == 0);
+    check(shbuf, 0, 1, 'x');
+    cprintf("madvise step4 ok.\n");
+
+    assert(munmap(addr, NPAGES * PGSIZE) == 0);
+    assert(munmap(shaddr, PGSIZE) == 0);
+    cprintf("madvisetest pass.\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <unistd.h>
+
+#define FILENAME                "mmapfile.dat"
+#define NPAGES                  3
+#define FILESIZE                (NPAGES * 4096 - 100)
+
+static char buffer[FILESIZE];
+
+int
+main(void) {
+    int fd, i;
+    assert((fd = open(FILENAME, O_RDWR | O_CREAT | O_TRUNC)) >= 0);
+    for (i = 0; i < FILESIZE; i ++) {
+        buffer[i] = (char)i;
+    }
+    assert(write(fd, buffer, FILESIZE) == FILESIZE);
+
+    uintptr_t addr = 0;
+    assert(mmap_file(&addr, FILESIZE, 0, fd, 1) != 0);
+    assert(mmap_file(&addr, FILESIZE, 0, fd, 0) == 0 && addr != 0);
+    char *private = (char *)addr;
+    for (i = 0; i < FILESIZE; i ++) {
+        assert(private[i] == (char)i);
+    }
+    cprintf("mmap_file read ok.\n");
+
+    addr = 0;
+    assert(mmap_file(&addr, FILESIZE, MMAP_WRITE | MMAP_SHARED, fd, 0) == 0 && addr != 0);
+    char *shared = (char *)addr;
+    for (i = 0; i < FILESIZE; i += 7) {
+        shared[i] = 'x';
+    }
+    // the private read-only mapping shares the page cache with the shared one
+    assert(private[0] == 'x' && private[1] == (char)1);
+
+    int pid;
+    if ((pid = fork()) == 0) {
+        shared[1] = 'y';
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, NULL) == 0);
+    assert(shared[1] == 'y');
+
+    assert(munmap((uintptr_t)shared, FILESIZE) == 0);
+    assert(munmap((uintptr_t)private, FILESIZE) == 0);
+    cprintf("mmap_file shared write ok.\n");
+
+    assert(seek(fd, 0, LSEEK_SET) == 0);
+    memset(buffer, 0, sizeof(buffer));
+    assert(read(fd, buffer, FILESIZE) == FILESIZE);
+    for (i = 0; i < FILESIZE; i ++) {
+        char c = (i == 1) ? 'y' : ((i % 7 == 0) ? 'x' : (char)i);
+        assert(buffer[i] == c);
+    }
+
+    // the pages cached past the end of a truncated file are dropped
+    addr = 0;
+    assert(mmap_file(&addr, FILESIZE, 0, fd, 0) == 0 && addr != 0);
+    private = (char *)addr;
+    assert(private[FILESIZE - 1] == (char)(FILESIZE - 1));
+    assert(munmap((uintptr_t)private, FILESIZE) == 0);
+    int fd2;
+    assert((fd2 = open(FILENAME, O_RDWR | O_TRUNC)) >= 0);
+    assert(write(fd2, "zz", 2) == 2);
+    assert(seek(fd2, FILESIZE - 1, LSEEK_SET) == 0 && write(fd2, "z", 1) == 1);
+    addr = 0;
+    assert(mmap_file(&addr, FILESIZE, 0, fd2, 0) == 0 && addr != 0);
+    private = (char *)addr;
+    assert(private[0] == 'z' && private[FILESIZE - 1] == 'z');
+    for (i = 2; i < FILESIZE - 1; i ++) {
+        assert(private[i] == 0);
+    }
+    assert(munmap((uintptr_t)private, FILESIZE) == 0);
+    close(fd2);
+    cprintf("mmap_file truncate ok.\n");
+    close(fd);
+
+    cprintf("mmapfiletest pass.\n");
+    return 0;
+}
+
@@ -0,0 +1,97 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <file.h>
+#include <dir.h>
+#include <unistd.h>
+
+#define printf(...)                 fprintf(1, __VA_ARGS__)
+
+/* *
+ * seqbench - sequential throughput of a file larger than the block cache.
+ *
+ * Writes FILE_SIZE bytes in WRITE_CHUNK pieces and fsyncs them, then reads
+ * them back in READ_CHUNK pieces, from the start to the end and at random
+ * blocks with a fixed seed. Block by block, each of these is a request to
+ * the disk per block; with the writes clustered on fsync and the reads
+ * coalesced and read ahead, the sequential ones should go to the disk in
+ * requests of many blocks and run several times faster, while the random
+ * reads stay about the same.
+ * */
+
+#define BLKSIZE                     4096
+#define FILE_SIZE                   (16 * 1024 * 1024)
+#define WRITE_CHUNK                 (16 * BLKSIZE)
+#define READ_CHUNK                  BLKSIZE
+#define SEED                        0x5eed
+
+static char buffer[WRITE_CHUNK];
+
+static unsigned int
+elapsed(unsigned int start) {
+    unsigned int msecs = gettime_msec() - start;
+    return (msecs != 0) ? msecs : 1;
+}
+
+static void
+report(const char *what, unsigned int msecs) {
+    printf("%-16s %5d msecs, %5d KB/sec.\n", what, msecs, (FILE_SIZE / 1024) * 1000 / msecs);
+}
+
+static void
+fill(size_t off, size_t len) {
+    size_t i;
+    for (i = 0; i < len; i += sizeof(uint32_t)) {
+        *(uint32_t *)(buffer + i) = off + i;
+    }
+}
+
+static void
+check(size_t off, size_t len) {
+    size_t i;
+    for (i = 0; i < len; i += sizeof(uint32_t)) {
+        assert(*(uint32_t *)(buffer + i) == off + i);
+    }
+}
+
+int
+main(void) {
+    size_t off, i, nblks = FILE_SIZE / BLKSIZE;
+    unsigned int start;
+    int fd;
+
+    assert((fd = open("seqbench", O_RDWR | O_CREAT | O_TRUNC)) >= 0);
+    start = gettime_msec();
+    for (off = 0; off < FILE_SIZE; off += WRITE_CHUNK) {
+        fill(off, WRITE_CHUNK);
+        assert(write(fd, buffer, WRITE_CHUNK) == WRITE_CHUNK);
+    }
+    assert(fsync(fd) == 0);
+    report("write + fsync", elapsed(start));
+    close(fd);
+
+    assert((fd = open("seqbench", O_RDONLY)) >= 0);
+    start = gettime_msec();
+    for (off = 0; off < FILE_SIZE; off += READ_CHUNK) {
+        assert(read(fd, buffer, READ_CHUNK) == READ_CHUNK);
+        check(off, READ_CHUNK);
+    }
+    assert(read(fd, buffer, READ_CHUNK) == 0);
+    report("sequential read", elapsed(start));
+
+    srand(SEED);
+    start = gettime_msec();
+    for (i = 0; i < nblks; i ++) {
+        off = (rand() % nblks) * BLKSIZE;
+        assert(seek(fd, off, LSEEK_SET) == 0);
+        assert(read(fd, buffer, READ_CHUNK) == READ_CHUNK);
+        check(off, READ_CHUNK);
+    }
+    report("random read", elapsed(start));
+    close(fd);
+
+    assert(unlink("seqbench") == 0);
+    printf("seqbench pass.\n");
+    return 0;
+}
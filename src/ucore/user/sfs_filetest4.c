@@ -0,0 +1,115 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stat.h>
+#include <file.h>
+#include <dir.h>
+#include <unistd.h>
+
+#define BLKSIZE                     4096
+#define NBLKS                       64
+#define CHUNK                       3000
+
+static int
+safe_open(const char *path, int open_flags) {
+    int fd = open(path, open_flags);
+    assert(fd >= 0);
+    return fd;
+}
+
+static struct stat *
+safe_fstat(int fd) {
+    static struct stat __stat, *stat = &__stat;
+    int ret = fstat(fd, stat);
+    assert(ret == 0);
+    return stat;
+}
+
+static void
+safe_read(int fd, void *data, size_t len) {
+    int ret = read(fd, data, len);
+    assert(ret == len);
+}
+
+static void
+safe_write(int fd, void *data, size_t len) {
+    int ret = write(fd, data, len);
+    assert(ret == len);
+}
+
+static char buffer[CHUNK];
+
+static void
+fill(int id, size_t off) {
+    int i;
+    for (i = 0; i < CHUNK; i ++) {
+        buffer[i] = (char)(id * 31 + (off + i) / 7);
+    }
+}
+
+static void
+check(int fd, int id, size_t size) {
+    static char data[CHUNK];
+    size_t off, len;
+    assert(seek(fd, 0, LSEEK_SET) == 0);
+    for (off = 0; off < size; off += len) {
+        len = (size - off < CHUNK) ? size - off : CHUNK;
+        safe_read(fd, data, len);
+        fill(id, off);
+        assert(memcmp(data, buffer, len) == 0);
+    }
+}
+
+int
+main(void) {
+    int fd1, fd2;
+    struct stat *stat;
+    size_t off, size = NBLKS * BLKSIZE;
+
+    assert(chdir("/test") == 0);
+    fd1 = safe_open("extent1", O_RDWR | O_CREAT | O_TRUNC);
+    fd2 = safe_open("extent2", O_RDWR | O_CREAT | O_TRUNC);
+
+    // preallocated blocks read as zeros
+    assert(fallocate(fd1, 3 * BLKSIZE + 100) == 0);
+    stat = safe_fstat(fd1);
+    assert(stat->st_size == 3 * BLKSIZE + 100 && stat->st_blocks == 4);
+    memset(buffer, 0xFF, sizeof(buffer));
+    safe_read(fd1, buffer, 100);
+    for (off = 0; off < 100; off ++) {
+        assert(buffer[off] == 0);
+    }
+    assert(fallocate(fd1, 100) == 0 && safe_fstat(fd1)->st_size == 3 * BLKSIZE + 100);
+    assert(fallocate(fd1, -1) != 0);
+    cprintf("fallocate test ok.\n");
+
+    // appends to two files at once, in unaligned chunks
+    assert(seek(fd1, 0, LSEEK_SET) == 0);
+    for (off = 0; off < size; off += CHUNK) {
+        fill(1, off), safe_write(fd1, buffer, CHUNK);
+        fill(2, off), safe_write(fd2, buffer, CHUNK);
+    }
+    size = off;
+    check(fd1, 1, size);
+    check(fd2, 2, size);
+    stat = safe_fstat(fd2);
+    assert(stat->st_size == size && stat->st_blocks == ROUNDUP_DIV(size, BLKSIZE));
+    cprintf("append test ok.\n");
+
+    close(fd1);
+    fd1 = safe_open("extent1", O_RDWR | O_TRUNC);
+    assert(safe_fstat(fd1)->st_size == 0 && safe_fstat(fd1)->st_blocks == 0);
+    assert(fallocate(fd1, size) == 0);
+    for (off = 0; off < size; off += CHUNK) {
+        fill(3, off), safe_write(fd1, buffer, CHUNK);
+    }
+    check(fd1, 3, size);
+    check(fd2, 2, size);
+    assert(safe_fstat(fd1)->st_blocks == ROUNDUP_DIV(size, BLKSIZE));
+    cprintf("truncate test ok.\n");
+
+    close(fd1), close(fd2);
+    assert(unlink("extent1") == 0 && unlink("extent2") == 0);
+    cprintf("sfs_filetest4 pass.\n");
+    return 0;
+}
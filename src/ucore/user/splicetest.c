@@ -0,0 +1,127 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <unistd.h>
+#include <dir.h>
+
+#define FILENAME                "splice.dat"
+#define NPAGES                  8
+#define DATASIZE                (NPAGES * 4096)
+#define BENCH_ROUNDS            256
+
+static char data[DATASIZE] __attribute__((aligned(4096)));
+static char buffer[DATASIZE];
+
+static void
+fill(char *buf, size_t len, int seed) {
+    size_t i;
+    for (i = 0; i < len; i ++) {
+        buf[i] = (char)(i * 13 + seed);
+    }
+}
+
+// vmsplice shares the pages with the pipe, the writer copies them on write
+static void
+test_vmsplice(void) {
+    int fd[2];
+    assert(pipe(fd) == 0);
+    fill(data, DATASIZE, 1);
+    assert(vmsplice(fd[1], data, DATASIZE) == DATASIZE);
+    fill(data, DATASIZE, 2);
+
+    assert(read(fd[0], buffer, DATASIZE) == DATASIZE);
+    fill(data, DATASIZE, 1);
+    assert(memcmp(buffer, data, DATASIZE) == 0);
+
+    // not page aligned
+    assert(vmsplice(fd[1], data + 100, 5000) == 5000);
+    assert(read(fd[0], buffer, DATASIZE) == 5000);
+    assert(memcmp(buffer, data + 100, 5000) == 0);
+
+    close(fd[0]), close(fd[1]);
+    cprintf("vmsplice ok.\n");
+}
+
+static void
+test_ioctl(void) {
+    int fd[2];
+    assert(pipe(fd) == 0);
+    assert(ioctl(fd[0], PIPE_IOC_GETSIZE, 0) == 16 * 4096);
+    assert(ioctl(fd[1], PIPE_IOC_SETSIZE, 3 * 4096 + 1) == 4 * 4096);
+    assert(ioctl(fd[0], PIPE_IOC_GETSIZE, 0) == 4 * 4096);
+    assert(ioctl(fd[1], PIPE_IOC_SETSIZE, 0) != 0);
+
+    fill(buffer, 3 * 4096, 3);
+    assert(write(fd[1], buffer, 3 * 4096) == 3 * 4096);
+    assert(ioctl(fd[1], PIPE_IOC_SETSIZE, 4096) != 0);
+    assert(ioctl(fd[1], PIPE_IOC_SETSIZE, 64 * 4096) == 64 * 4096);
+    assert(read(fd[0], data, DATASIZE) == 3 * 4096);
+    assert(memcmp(buffer, data, 3 * 4096) == 0);
+
+    assert(ioctl(0, PIPE_IOC_GETSIZE, 0) != 0);
+    close(fd[0]), close(fd[1]);
+    cprintf("pipe ioctl ok.\n");
+}
+
+// file -> pipe -> pipe -> file
+static void
+test_splice(void) {
+    int file, in[2], out[2];
+    assert((file = open(FILENAME, O_RDWR | O_CREAT | O_TRUNC)) >= 0);
+    fill(data, DATASIZE, 4);
+    assert(write(file, data, DATASIZE) == DATASIZE);
+    assert(seek(file, 0, LSEEK_SET) == 0);
+    assert(pipe(in) == 0 && pipe(out) == 0);
+    assert(splice(file, file, 4096) != 0);
+
+    assert(splice(file, in[1], DATASIZE) == DATASIZE);
+    assert(splice(in[0], out[1], DATASIZE) == DATASIZE);
+    assert(splice(out[0], file, DATASIZE) == DATASIZE);
+    close(in[0]), close(in[1]), close(out[0]), close(out[1]);
+
+    assert(seek(file, 0, LSEEK_SET) == 0);
+    assert(read(file, buffer, DATASIZE) == DATASIZE && memcmp(buffer, data, DATASIZE) == 0);
+    assert(read(file, buffer, DATASIZE) == DATASIZE && memcmp(buffer, data, DATASIZE) == 0);
+    close(file);
+    assert(unlink(FILENAME) == 0);
+    cprintf("splice ok.\n");
+}
+
+// bench_pipe - move BENCH_ROUNDS * DATASIZE bytes through a pipe by write or vmsplice
+static unsigned int
+bench_pipe(bool zerocopy) {
+    int fd[2], pid, i;
+    assert(pipe(fd) == 0);
+    unsigned int start = gettime_msec();
+    if ((pid = fork()) == 0) {
+        close(fd[0]);
+        for (i = 0; i < BENCH_ROUNDS; i ++) {
+            int ret = zerocopy ? vmsplice(fd[1], data, DATASIZE) : write(fd[1], data, DATASIZE);
+            assert(ret == DATASIZE);
+        }
+        exit(0);
+    }
+    assert(pid > 0);
+    close(fd[1]);
+    int ret;
+    size_t total = 0;
+    while ((ret = read(fd[0], buffer, DATASIZE)) > 0) {
+        total += ret;
+    }
+    assert(waitpid(pid, NULL) == 0 && total == BENCH_ROUNDS * DATASIZE);
+    close(fd[0]);
+    return gettime_msec() - start;
+}
+
+int
+main(void) {
+    test_vmsplice();
+    test_ioctl();
+    test_splice();
+    cprintf("%d KB through pipe: write %d msecs, vmsplice %d msecs.\n",
+            BENCH_ROUNDS * DATASIZE / 1024, bench_pipe(0), bench_pipe(1));
+    cprintf("splicetest pass.\n");
+    return 0;
+}
+
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <ulib.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vmstat.h>
+
+/* *
+ * thrashbench - page replacement under memory pressure.
+ *
+ * Maps a hot region and a cold region which are together larger than the
+ * memory of the machine (qemu -m 768), then touches pages at random with a
+ * fixed seed, HOT_PERCENT of them in the hot region, writing to every other
+ * one. A good replacement keeps the hot region in memory: compare the
+ * number of faults, major faults, and of pages written per request to the
+ * swap device between kernels.
+ * */
+
+#define PGSIZE                  4096
+#define HOT_PAGES               (256 * 1024 * 1024 / PGSIZE)
+#define COLD_PAGES              (768 * 1024 * 1024 / PGSIZE)
+#define HOT_PERCENT             90
+#define NACCESS                 200000
+#define SEED                    0x1234
+
+static uint32_t *
+region(size_t npages) {
+    uintptr_t addr = 0;
+    assert(mmap(&addr, npages * PGSIZE, MMAP_WRITE) == 0 && addr != 0);
+    return (uint32_t *)addr;
+}
+
+static void
+touch(uint32_t *base, size_t page, bool write) {
+    uint32_t *p = base + page * (PGSIZE / sizeof(uint32_t));
+    if (write) {
+        p[0] = (uint32_t)page, p[1] ++;
+    }
+    else {
+        assert(p[0] == (uint32_t)page);
+    }
+}
+
+int
+main(void) {
+    uint32_t *hot = region(HOT_PAGES), *cold = region(COLD_PAGES);
+    size_t i;
+
+    // fault everything in once, the cold region last
+    for (i = 0; i < HOT_PAGES; i ++) {
+        touch(hot, i, 1);
+    }
+    for (i = 0; i < COLD_PAGES; i ++) {
+        touch(cold, i, 1);
+    }
+    cprintf("thrashbench: %d hot pages, %d cold pages.\n", HOT_PAGES, COLD_PAGES);
+
+    struct vmstat before, after;
+    assert(vmstat(&before) == 0);
+    unsigned int start = gettime_msec();
+
+    srand(SEED);
+    for (i = 0; i < NACCESS; i ++) {
+        bool write = (i & 1);
+        if (rand() % 100 < HOT_PERCENT) {
+            touch(hot, rand() % HOT_PAGES, write);
+        }
+        else {
+            touch(cold, rand() % COLD_PAGES, write);
+        }
+    }
+
+    unsigned int msecs = gettime_msec() - start;
+    assert(vmstat(&after) == 0);
+
+    size_t faults = after.pgfault - before.pgfault;
+    size_t majfaults = after.pgmajfault - before.pgmajfault;
+    size_t pswpout = after.pswpout - before.pswpout;
+    size_t swpwrite = after.swpwrite - before.swpwrite;
+    if (msecs == 0) {
+        msecs = 1;
+    }
+
+    cprintf("%d accesses in %d msecs, %d generations.\n", NACCESS, msecs, after.lru_seq - before.lru_seq);
+    cprintf("faults %d, major %d, %d faults/sec.\n", faults, majfaults, faults * 1000 / msecs);
+    cprintf("scanned %d, stolen %d.\n", after.pgscan - before.pgscan, after.pgsteal - before.pgsteal);
+    cprintf("swapped out %d pages in %d writes, %d pages per write.\n",
+            pswpout, swpwrite, (swpwrite != 0) ? pswpout / swpwrite : 0);
+    cprintf("thrashbench pass.\n");
+    return 0;
+}
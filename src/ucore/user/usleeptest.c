@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <ulib.h>
+
+#define NCHILD                  16
+#define NLOOP                   20
+
+// many sleepers with spread timeouts, to exercise the buckets of the timer wheel
+static void
+sleeper(int n) {
+    int i;
+    for (i = 0; i < NLOOP; i ++) {
+        sleep(1 + (n * 37 + i * 11) % 300);
+    }
+    exit(0);
+}
+
+int
+main(void) {
+    int i, pids[NCHILD];
+    for (i = 0; i < NCHILD; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            sleeper(i);
+        }
+        assert(pids[i] > 0);
+    }
+
+    unsigned int start = gettime_msec();
+    for (i = 0; i < 100; i ++) {
+        assert(usleep(500) == 0);
+    }
+    cprintf("100 usleep(500) take %d msecs.\n", gettime_msec() - start);
+
+    for (i = 0; i < NCHILD; i ++) {
+        assert(waitpid(pids[i], NULL) == 0);
+    }
+    cprintf("usleeptest pass.\n");
+    return 0;
+}
+
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <ulib.h>
+#include <unistd.h>
+
+#define PGSIZE      4096
+#define NPAGES      1024
+
+static char buf[NPAGES * PGSIZE];
+static volatile int done;
+
+static void
+fill(char c) {
+    int i;
+    for (i = 0; i < NPAGES; i ++) {
+        buf[i * PGSIZE] = c + (char)i;
+    }
+}
+
+static void
+check(char c) {
+    int i;
+    for (i = 0; i < NPAGES; i ++) {
+        assert(buf[i * PGSIZE] == c + (char)i);
+    }
+}
+
+static int
+borrower(void *arg) {
+    sleep(10);
+    done = (int)arg;
+    return 0;
+}
+
+int
+main(void) {
+    int pid, exit_code;
+
+    // the page tables are shared after fork, each side copies them on write
+    fill('a');
+    if ((pid = fork()) == 0) {
+        check('a');
+        fill('b');
+        check('b');
+        exit(0xbeaf);
+    }
+    assert(pid > 0);
+    fill('c');
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0xbeaf);
+    check('c');
+    cprintf("vfork step1 ok.\n");
+
+    uintptr_t stack = 0;
+    assert(mmap(&stack, 4 * PGSIZE, MMAP_WRITE | MMAP_STACK) == 0 && stack != 0);
+    pid = clone(CLONE_VM | CLONE_VFORK, stack + 4 * PGSIZE, borrower, (void *)0x1234);
+    assert(pid > 0 && done == 0x1234);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    assert(munmap(stack, 4 * PGSIZE) == 0);
+    cprintf("vfork step2 ok.\n");
+
+    assert((pid = spawn("bin/hello")) > 0);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    assert(spawn("bin/nonexistent") < 0);
+    check('c');
+    cprintf("vfork step3 ok.\n");
+
+    cprintf("vforktest pass.\n");
+    return 0;
+}